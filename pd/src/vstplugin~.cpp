@@ -113,35 +113,14 @@ t_workqueue::t_workqueue(){
     w_instance = pd_this;
 #endif
 
-    w_thread = std::thread([this]{
-        LOG_DEBUG("worker thread started");
-
-        vst::setThreadPriority(Priority::Low);
-
-        gWorkerThread = true; // mark as worker thread
-
-    #ifdef PDINSTANCE
-        pd_setinstance(w_instance);
-    #endif
-        w_running.store(true);
-
-        while (w_running.load()) {
-            w_event.wait();
-
-            std::unique_lock lock(w_mutex); // for cancellation
-            t_item item;
-            while (w_nrt_queue.pop(item)){
-                if (item.workfn){
-                    item.workfn(item.data);
-                }
-                w_rt_queue.push(item);
-                // temporarily release lock in case someone is blocking on cancel()!
-                lock.unlock();
-                lock.lock();
-            }
-        }
-        LOG_DEBUG("worker thread finished");
-    });
+    // most commands are I/O bound or wait for other threads/processes
+    // (UI thread, plugin subprocess), so we don't need many workers.
+    int numThreads = std::max<int>(2, std::min<int>(std::thread::hardware_concurrency(),
+                                                    max_num_workers));
+    for (int i = 0; i < numThreads; ++i) {
+        w_threads.emplace_back(&t_workqueue::run, this);
+    }
+    LOG_DEBUG("started " << numThreads << " worker threads");
 
     w_clock = clock_new(this, (t_method)clockmethod);
     clock_setunit(w_clock, 1, 1); // use samples
@@ -149,19 +128,63 @@ t_workqueue::t_workqueue(){
 }
 
 t_workqueue::~t_workqueue() {
-    w_running.store(false);
-    // wake up and join thread
-    w_event.set();
-    if (w_thread.joinable()){
-        w_thread.join();
+    {
+        std::lock_guard lock(w_mutex);
+        w_running = false;
+    }
+    // wake up and join threads
+    w_cond.notify_all();
+    for (auto& thread : w_threads) {
+        thread.join();
     }
-    LOG_DEBUG("worker thread joined");
+    LOG_DEBUG("worker threads joined");
     // The workqueue is either leaked or destroyed in the class free function,
     // so we can safely free the clock! With PDINSTANCE this is even less of a
     // problem because the workqueue is reference counted.
     clock_free(w_clock);
 }
 
+void t_workqueue::run() {
+    vst::setThreadPriority(Priority::Low);
+
+    gWorkerThread = true; // mark as worker thread
+
+#ifdef PDINSTANCE
+    pd_setinstance(w_instance);
+#endif
+
+    std::unique_lock lock(w_mutex);
+    while (w_running) {
+        if (w_ready.empty()) {
+            w_cond.wait(lock);
+            continue;
+        }
+        auto owner = w_ready.front();
+        w_ready.pop_front();
+        // NB: references to unordered_map elements are stable; only
+        // the worker which is running a command may erase the owner.
+        auto& o = w_owners[owner];
+        auto item = o.items.front();
+        o.items.pop_front();
+        if (item.workfn) {
+            o.busy = true;
+            // don't hold the lock while running the command!
+            lock.unlock();
+            item.workfn(item.data);
+            lock.lock();
+            o.busy = false;
+        }
+        // NB: push while holding the lock, see cancel()
+        w_rt_queue.push(item);
+        if (!o.items.empty()) {
+            w_ready.push_back(owner); // keep the order!
+        } else {
+            w_owners.erase(owner);
+        }
+        w_done.notify_all();
+    }
+}
+
 void t_workqueue::clockmethod(t_workqueue *w){
     w->poll();
     clock_delay(w->w_clock, 64); // once per DSP tick
@@ -175,20 +198,35 @@ void t_workqueue::dopush(void *owner, void *data, t_fun<void> workfn,
     item.workfn = workfn;
     item.cb = cb;
     item.cleanup = cleanup;
-    w_nrt_queue.push(item);
-    w_event.set();
+    {
+        std::lock_guard lock(w_mutex);
+        auto& o = w_owners[owner];
+        o.items.push_back(item);
+        // only schedule the owner if it isn't already scheduled or running
+        if (!o.busy && o.items.size() == 1) {
+            w_ready.push_back(owner);
+        }
+    }
+    w_cond.notify_one();
 }
 
-// cancel all running commands belonging to owner
+// cancel all running commands belonging to owner.
+// NB: this only waits for the owner's current command (if any),
+// commands of other owners may continue to run.
 void t_workqueue::cancel(void *owner){
-    std::lock_guard lock(w_mutex);
-    // NRT queue
-    w_nrt_queue.forEach([&](t_item& i){
-        if (i.owner == owner) {
+    std::unique_lock lock(w_mutex);
+    // pending commands
+    if (auto it = w_owners.find(owner); it != w_owners.end()) {
+        for (auto& i : it->second.items) {
             i.workfn = nullptr;
             i.cb = nullptr;
         }
-    });
+        // wait for the current command to finish
+        w_done.wait(lock, [&](){
+            auto it = w_owners.find(owner);
+            return it == w_owners.end() || !it->second.busy;
+        });
+    }
     // RT queue
     w_rt_queue.forEach([&](t_item& i){
         if (i.owner == owner) {
@@ -338,6 +376,7 @@ public:
                 *this << "crashed!";
                 break;
             case Error::SystemError:
+            case Error::Timeout:
                 *this << "error! " << result.error.what();
                 break;
             case Error::ModuleError:
@@ -370,6 +409,10 @@ SharedMutex gPresetMutex;
 static std::string gSettingsDir = userSettingsPath() + "/pd";
 
 static std::string gCacheFileName = std::string("cache_")
+        + cpuArchToString(getHostCpuArchitecture()) + ".bin";
+
+// text cache file of previous versions, see readCacheFile()
+static std::string gTextCacheFileName = std::string("cache_")
         + cpuArchToString(getHostCpuArchitecture()) + ".ini";
 
 static Mutex gFileLock;
@@ -377,17 +420,28 @@ static Mutex gFileLock;
 static void readCacheFile(const std::string& dir, bool loud){
     std::lock_guard lock(gFileLock);
     auto path = dir + "/" + gCacheFileName;
-    if (pathExists(path)){
-        logpost(nullptr, PdDebug, "read cache file %s", path.c_str());
+    // if there is no binary cache file yet, import the text cache file
+    auto textPath = dir + "/" + gTextCacheFileName;
+    bool convert = !pathExists(path) && pathExists(textPath);
+    if (convert || pathExists(path)){
+        auto& file = convert ? textPath : path;
+        logpost(nullptr, PdDebug, "read cache file %s", file.c_str());
         try {
-            gPluginDict.read(path);
+            gPluginDict.read(file, !convert);
+            if (convert) {
+                gPluginDict.write(path, PluginDictionary::CacheFormat::Binary);
+            }
         } catch (const Error& e){
             pd_error(nullptr, "couldn't read cache file: %s", e.what());
         } catch (const std::exception& e){
             pd_error(nullptr, "couldn't read cache file: unexpected exception (%s)", e.what());
         }
-    } else if (loud) {
-        pd_error(nullptr, "could not find cache file in %s", dir.c_str());
+    } else {
+        // the probe index might still exist
+        gPluginDict.readIndex(path);
+        if (loud) {
+            pd_error(nullptr, "could not find cache file in %s", dir.c_str());
+        }
     }
 }
 
@@ -424,15 +478,16 @@ static void writeCacheFile() {
 }
 
 // load factory and probe plugins
+// 'retry': probe black-listed plugins, see PluginDictionary::retryException()
 template<bool async>
-static IFactory::ptr loadFactory(const std::string& path){
+static IFactory::ptr loadFactory(const std::string& path, bool retry = false){
     IFactory::ptr factory;
 
     if (gPluginDict.findFactory(path)){
         PdLog<async>(PdError) << "bug: couldn't find factory '" << path << "'";
         return nullptr;
     }
-    if (gPluginDict.isException(path)){
+    if (!retry && gPluginDict.isException(path)){
         PdLog<async>(PdDebug) << "'" << path << "' is black-listed";
         return nullptr;
     }
@@ -441,7 +496,7 @@ static IFactory::ptr loadFactory(const std::string& path){
         factory = IFactory::load(path);
     } catch (const Error& e){
         PdLog<async>(PdError) << "couldn't load '" << path << "': " << e.what();
-        gPluginDict.addException(path);
+        gPluginDict.addException(path, e.code());
         return nullptr;
     }
 
@@ -461,9 +516,9 @@ static void addFactory(const std::string& path, IFactory::ptr factory){
     for (int i = 0; i < factory->numPlugins(); ++i){
         auto plugin = factory->getPlugin(i);
         // also map bashed parameter names
-        int num = plugin->parameters.size();
+        int num = plugin->parameters().size();
         for (int j = 0; j < num; ++j){
-            auto key = plugin->parameters[j].name;
+            auto key = plugin->parameters()[j].name;
             bash_name(key);
             const_cast<PluginDesc&>(*plugin).addParamAlias(j, key);
         }
@@ -495,16 +550,26 @@ static void postProbeResult(const std::string& path, const ProbeResult& result){
     }
 }
 
+// get the reason for black-listing a module; timeouts take precedence,
+// so that the module can be retried.
+static void updateErrorCode(Error::ErrorCode& code, const Error& error){
+    if (error.code() != Error::NoError && code != Error::Timeout){
+        code = error.code();
+    }
+}
+
 template<bool async>
-static IFactory::ptr probePlugin(const std::string& path, float timeout){
-    auto factory = loadFactory<async>(path);
+static IFactory::ptr probePlugin(const std::string& path, float timeout, bool retry = false){
+    auto factory = loadFactory<async>(path, retry);
     if (!factory){
         return nullptr;
     }
 
+    auto code = Error::UnknownError;
     try {
         factory->probe([&](const ProbeResult& result){
             postProbeResult<async>(path, result);
+            updateErrorCode(code, result.error);
         }, timeout);
         if (factory->valid()){
             addFactory(path, factory);
@@ -514,8 +579,9 @@ static IFactory::ptr probePlugin(const std::string& path, float timeout){
         ProbeResult result;
         result.error = e;
         postProbeResult<async>(path, result);
+        updateErrorCode(code, e);
     }
-    gPluginDict.addException(path);
+    gPluginDict.addException(path, code);
     return nullptr;
 }
 
@@ -523,8 +589,8 @@ using FactoryFutureResult = std::pair<bool, IFactory::ptr>;
 using FactoryFuture = std::function<FactoryFutureResult()>;
 
 template<bool async>
-static FactoryFuture probePluginAsync(const std::string& path, float timeout){
-    auto factory = loadFactory<async>(path);
+static FactoryFuture probePluginAsync(const std::string& path, float timeout, bool retry = false){
+    auto factory = loadFactory<async>(path, retry);
     if (!factory) {
         return []() -> FactoryFutureResult {
             return { true, nullptr };
@@ -534,10 +600,11 @@ static FactoryFuture probePluginAsync(const std::string& path, float timeout){
         // start probing process
         auto future = factory->probeAsync(timeout, true);
         // return future
-        return [=]() -> FactoryFutureResult {
+        return [=, code = Error::UnknownError]() mutable -> FactoryFutureResult {
             // wait for results
             bool done = future([&](const ProbeResult& result){
                 postProbeResult<async>(path, result);
+                updateErrorCode(code, result.error);
             }); // collect result(s)
 
             if (done) {
@@ -545,7 +612,7 @@ static FactoryFuture probePluginAsync(const std::string& path, float timeout){
                     addFactory(path, factory);
                     return { true, factory }; // success
                 } else {
-                    gPluginDict.addException(path);
+                    gPluginDict.addException(path, code);
                     return { true, nullptr };
                 }
             } else {
@@ -558,7 +625,7 @@ static FactoryFuture probePluginAsync(const std::string& path, float timeout){
             ProbeResult result;
             result.error = e;
             postProbeResult<async>(path, result);
-            gPluginDict.addException(path);
+            gPluginDict.addException(path, e.code());
             return { true, nullptr };
         };
     }
@@ -581,11 +648,10 @@ std::vector<t_symbol *> makePluginList(const std::vector<PluginDesc::const_ptr>&
     return result;
 }
 
-#define PROBE_FUTURES 8
-
 template<bool async>
 static void searchPlugins(const std::string& path, t_search_data *data){
     bool parallel = data ? data->parallel : true;
+    bool incremental = data ? data->incremental : false;
     float timeout = data ? data->timeout : 0.f;
     int count = 0;
 
@@ -593,6 +659,9 @@ static void searchPlugins(const std::string& path, t_search_data *data){
     sys_unbashfilename(&bashPath[0], &bashPath[0]);
     PdLog<async>() << "searching in '" << bashPath << "' ...";
 
+    // publish all updates at the end of the search
+    PluginDictionary::UpdateScope scope(gPluginDict);
+
     auto addPlugin = [&](PluginDesc::const_ptr plugin){
         if (data){
             data->plugins.push_back(plugin);
@@ -600,55 +669,36 @@ static void searchPlugins(const std::string& path, t_search_data *data){
         count++;
     };
 
-    std::vector<std::pair<FactoryFuture, std::string>> futures;
-
-    auto last = std::chrono::system_clock::now();
-
-    auto processFutures = [&](int limit){
-        while (futures.size() > limit){
-            bool didSomething = false;
-            for (auto it = futures.begin(); it != futures.end(); ){
-                if (auto [done, factory] = it->first(); done) {
-                    // future finished
-                    if (factory){
-                        for (int i = 0; i < factory->numPlugins(); ++i){
-                            auto plugin = factory->getPlugin(i);
-                            addPlugin(plugin);
-                        #if WARN_VST3_PARAMETERS
-                            if (data && plugin->warnParameters) {
-                                data->warn_plugins.push_back(plugin);
-                            }
-                        #endif
-                        }
-                    }
-                    // remove future
-                    it = futures.erase(it);
-                    didSomething = true;
-                } else {
-                    it++;
-                }
-            }
-            auto now = std::chrono::system_clock::now();
-            if (didSomething){
-                last = now;
-            } else {
-                using seconds = std::chrono::duration<double>;
-                auto elapsed = std::chrono::duration_cast<seconds>(now - last).count();
-                if (elapsed > 4.0){
-                    for (auto& x : futures){
-                        PdLog<async>() << "waiting for '" << x.second << "'...";
-                    }
-                    // PdLog<async> log(PD_NORMAL, "...");
-                    last = now;
-                }
+    auto addFactoryPlugins = [&](IFactory::ptr factory){
+        for (int i = 0; i < factory->numPlugins(); ++i){
+            auto plugin = factory->getPlugin(i);
+            addPlugin(plugin);
+        #if WARN_VST3_PARAMETERS
+            if (data && plugin->warnParameters) {
+                data->warn_plugins.push_back(plugin);
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        #endif
         }
     };
 
-    vst::search(path, [&](const std::string& absPath){
-        if (data && data->cancel){
-            return; // cancel search
+    // with 'parallel' we probe as many plugins at once as we have CPUs
+    SearchEngine engine(parallel ? 0 : 1);
+
+    engine.setWaitCallback([](const std::string& pluginPath){
+        PdLog<async>() << "waiting for '" << pluginPath << "'...";
+    });
+
+    // black-listed plugins which have timed out, see PluginDictionary::retryException()
+    std::vector<std::string> retryList;
+
+    if (data){
+        // stop the directory traversal as soon as possible
+        engine.setCancelCallback([data](){ return data->cancel.load(); });
+    }
+
+    engine.search(path, [&](const std::string& absPath) -> SearchEngine::Job {
+        if (engine.cancelled()){
+            return nullptr;
         }
         LOG_DEBUG("found " << absPath);
         std::string pluginPath = absPath;
@@ -677,29 +727,62 @@ static void searchPlugins(const std::string& path, t_search_data *data){
                 bash_name(key); // also add bashed version!
                 gPluginDict.addPlugin(key, plugin);
             }
-        } else {
+            return nullptr;
+        } else if (incremental && !gPluginDict.isException(pluginPath)) {
+            // try to restore unchanged (or moved) plugins from the probe index
+            if (auto factory = gPluginDict.restoreFactory(pluginPath)) {
+                PdLog<async>(PdDebug) << "restored '" << pluginPath << "' from probe index";
+                addFactory(pluginPath, factory);
+                addFactoryPlugins(factory);
+                return nullptr;
+            }
+        }
+        bool retry = false;
+        if (gPluginDict.isException(pluginPath)){
+            switch (gPluginDict.retryException(pluginPath)){
+            case PluginDictionary::Retry::Now:
+                retry = true; // the plugin has changed
+                break;
+            case PluginDictionary::Retry::Later:
+                retryList.push_back(pluginPath);
+                return nullptr;
+            default:
+                PdLog<async>(PdDebug) << "'" << pluginPath << "' is black-listed";
+                return nullptr;
+            }
+        }
+        if (parallel){
             // probe (will post results and add plugins)
-            if (parallel){
-                futures.emplace_back(probePluginAsync<async>(pluginPath, timeout), pluginPath);
-                processFutures(PROBE_FUTURES);
-            } else {
-                if (auto factory = probePlugin<async>(pluginPath, timeout)) {
-                    int numPlugins = factory->numPlugins();
-                    for (int i = 0; i < numPlugins; ++i) {
-                        auto plugin = factory->getPlugin(i);
-                        addPlugin(plugin);
-                    #if WARN_VST3_PARAMETERS
-                        if (data && plugin->warnParameters) {
-                            data->warn_plugins.push_back(plugin);
-                        }
-                    #endif
+            return [&addFactoryPlugins, future = probePluginAsync<async>(pluginPath, timeout, retry)](){
+                if (auto [done, factory] = future(); done) {
+                    if (factory){
+                        addFactoryPlugins(factory);
                     }
+                    return true;
+                } else {
+                    return false;
                 }
+            };
+        } else {
+            if (auto factory = probePlugin<async>(pluginPath, timeout, retry)) {
+                addFactoryPlugins(factory);
             }
+            return nullptr;
         }
-    }, true, data->exclude);
+    }, true, data ? data->exclude : std::vector<std::string>{});
 
-    processFutures(0);
+    // probe plugins which have timed out in a previous search again, with a longer timeout
+    float retryTimeout = timeout * PROBE_RETRY_TIMEOUT_FACTOR;
+    for (auto& pluginPath : retryList){
+        if (engine.cancelled()){
+            break;
+        }
+        PdLog<async>() << "retrying '" << pluginPath << "' with a timeout of "
+                       << retryTimeout << " seconds";
+        if (auto factory = probePlugin<async>(pluginPath, retryTimeout, true)) {
+            addFactoryPlugins(factory);
+        }
+    }
 
     if (count == 1){
         PdLog<async>() << "found 1 plugin";
@@ -723,6 +806,15 @@ static const PluginDesc * queryPlugin(const std::string& path) {
             }
         }
    }
+   if (desc){
+       // make sure that the plugin info is available, see PluginDesc::loadTables()
+       try {
+           desc->loadTables();
+       } catch (const Error& e){
+           PdLog<async>(PdError) << e.what();
+           return nullptr;
+       }
+   }
    return desc.get();
 }
 
@@ -956,7 +1048,7 @@ void t_vsteditor::sysexEvent(const SysexEvent &event){
     post_event(e);
 }
 
-static void vstplugin_close(t_vstplugin *x);
+static void vstplugin_close(t_vstplugin *x, bool crossfade = false);
 
 void t_vsteditor::tick(t_vsteditor *x){
     t_outlet *outlet = x->e_owner->x_messout;
@@ -1012,10 +1104,7 @@ void t_vsteditor::tick(t_vsteditor *x){
         case t_event::Latency:
         {
             t_atom a;
-            int latency = e.latency;
-            if (x->e_owner->x_threaded){
-                latency += x->e_owner->x_blocksize;
-            }
+            int latency = e.latency + x->e_owner->extra_latency();
             SETFLOAT(&a, latency);
             outlet_anything(outlet, gensym("latency"), 1, &a);
             break;
@@ -1156,14 +1245,14 @@ void t_vsteditor::setup() {
         SETSYMBOL(slider+9, e_params[i].p_slider);
         SETSYMBOL(slider+10, e_params[i].p_slider);
         char param_name[64];
-        snprintf(param_name, sizeof(param_name), "%d: %s", i, info.parameters[i].name.c_str());
+        snprintf(param_name, sizeof(param_name), "%d: %s", i, info.parameters()[i].name.c_str());
         substitute_whitespace(param_name);
         SETSYMBOL(slider+11, gensym(param_name));
         send_mess(gensym("obj"), 21, slider);
         // create display
         SETFLOAT(display, xpos + slider_width + slider_xmargin);
         SETFLOAT(display+1, ypos);
-        SETSYMBOL(display+6, gensym(info.parameters[i].label.c_str()));
+        SETSYMBOL(display+6, gensym(info.parameters()[i].label.c_str()));
         SETSYMBOL(display+7, e_params[i].p_display_rcv);
         SETSYMBOL(display+8, e_params[i].p_display_snd);
         send_mess(gensym("symbolatom"), 9, display);
@@ -1361,6 +1450,7 @@ static void vstplugin_search(t_vstplugin *x, t_symbol *s, int argc, t_atom *argv
     bool async = false;
     bool parallel = true; // for now, always do a parallel search
     bool update = true; // update cache file
+    bool incremental = false; // only probe new or changed plugins
     std::string cachefiledir;
     std::vector<std::string> paths;
     std::vector<std::string> exclude;
@@ -1377,6 +1467,8 @@ static void vstplugin_search(t_vstplugin *x, t_symbol *s, int argc, t_atom *argv
                 async = true;
             } else if (!strcmp(flag, "-n")){
                 update = false;
+            } else if (!strcmp(flag, "-i")){
+                incremental = true;
             } else if (!strcmp(flag, "-t")){
                 argc--; argv++;
                 if (argc > 0 && argv->a_type == A_FLOAT){
@@ -1439,6 +1531,7 @@ static void vstplugin_search(t_vstplugin *x, t_symbol *s, int argc, t_atom *argv
         data->cachefiledir = cachefiledir;
         data->timeout = timeout;
         data->parallel = parallel;
+        data->incremental = incremental;
         data->update = update;
         x->x_search_data = data;
         t_workqueue::get()->push(x, data, vstplugin_search_do<true>, vstplugin_search_done);
@@ -1450,6 +1543,7 @@ static void vstplugin_search(t_vstplugin *x, t_symbol *s, int argc, t_atom *argv
         data.cachefiledir = cachefiledir;
         data.timeout = timeout;
         data.parallel = parallel;
+        data.incremental = incremental;
         data.update = update;
         vstplugin_search_do<false>(&data);
         vstplugin_search_done(&data);
@@ -1471,6 +1565,9 @@ static void vstplugin_cache_clear(t_vstplugin *x, t_floatarg f){
     // unloading plugins might crash, so we first delete the cache file
     if (f != 0){
         removeFile(gSettingsDir + "/" + gCacheFileName);
+        if (pathExists(gSettingsDir + "/" + gTextCacheFileName)) {
+            removeFile(gSettingsDir + "/" + gTextCacheFileName);
+        }
     }
     // clear the plugin description dictionary
     gPluginDict.clear();
@@ -1488,10 +1585,75 @@ static void vstplugin_cache_read(t_vstplugin *x, t_symbol *s){
     }
 }
 
+/*----------------------- "cache_export" -----------------------*/
+
+// write the plugin cache as a (human readable) text file
+static void vstplugin_cache_export(t_vstplugin *x, t_symbol *s){
+    char path[MAXPDSTRING];
+    canvas_makefilename(x->x_canvas, s->s_name, path, MAXPDSTRING);
+    std::lock_guard lock(gFileLock);
+    try {
+        gPluginDict.write(path, PluginDictionary::CacheFormat::Text);
+    } catch (const Error& e) {
+        pd_error(x, "%s: couldn't export cache file: %s", classname(x), e.what());
+    }
+}
+
 /*----------------------- "plugin_list" -------------------------*/
 
-static void vstplugin_plugin_list(t_vstplugin *x){
-    auto plugins = gPluginDict.pluginList();
+// plugin_list [-n <prefix>] [-f <pattern>] [-v <vendor>] [-c <category>] [-t vst2|vst3] [-l <limit>]
+static void vstplugin_plugin_list(t_vstplugin *x, t_symbol *s, int argc, t_atom *argv){
+    PluginQuery query;
+    bool haveQuery = false;
+    int limit = 0;
+
+    while (argc && argv->a_type == A_SYMBOL){
+        auto flag = argv->a_w.w_symbol->s_name;
+        if (*flag != '-' || !flag[1] || flag[2]){
+            pd_error(x, "%s: unknown flag '%s'", classname(x), flag);
+            return;
+        }
+        argc--; argv++;
+        if (argc <= 0){
+            pd_error(x, "%s: missing argument for %s flag", classname(x), flag);
+            return;
+        }
+        if (flag[1] == 'l'){
+            limit = atom_getfloat(argv);
+        } else {
+            std::string arg = atom_getsymbol(argv)->s_name;
+            switch (flag[1]){
+            case 'n':
+            case 'f':
+                query.name = std::move(arg);
+                query.match = (flag[1] == 'f') ? PluginQuery::Fuzzy : PluginQuery::Prefix;
+                break;
+            case 'v':
+                query.vendor = std::move(arg);
+                break;
+            case 'c':
+                query.category = std::move(arg);
+                break;
+            case 't':
+                if (arg == "vst2" || arg == "VST2"){
+                    query.type = PluginType::VST2;
+                } else if (arg == "vst3" || arg == "VST3"){
+                    query.type = PluginType::VST3;
+                } else {
+                    pd_error(x, "%s: bad plugin type '%s'", classname(x), arg.c_str());
+                    return;
+                }
+                break;
+            default:
+                pd_error(x, "%s: unknown flag '%s'", classname(x), flag);
+                return;
+            }
+        }
+        haveQuery = true;
+        argc--; argv++;
+    }
+
+    auto plugins = haveQuery ? gPluginDict.query(query, limit) : gPluginDict.pluginList();
     for (auto& plugin : makePluginList(plugins)){
         t_atom msg;
         SETSYMBOL(&msg, plugin);
@@ -1506,21 +1668,11 @@ struct t_close_data : t_command_data<t_close_data> {
     bool uithread;
 };
 
-static void vstplugin_close(t_vstplugin *x){
-    if (!x->x_plugin){
-        return;
-    }
-    if (x->x_suspended){
-        pd_error(x, "%s: can't close plugin - temporarily suspended!",
-                 classname(x));
-        return;
-    }
-#if 0
-    x->x_plugin->setListener(nullptr);
-#endif
-    // make sure to release the plugin on the same thread where it was opened!
-    // this is necessary to avoid crashes or deadlocks with certain plugins.
-    if (x->x_async){
+// release a plugin on the same thread where it was opened!
+// this is necessary to avoid crashes or deadlocks with certain plugins.
+static void vstplugin_release(t_vstplugin *x, IPlugin::ptr plugin,
+                              bool async, bool uithread){
+    if (async){
         // NOTE: if we close the plugin asynchronously and the plugin editor
         // is opened, it can happen that an event is sent from the UI thread,
         // e.g. when automating parameters in the plugin UI.
@@ -1535,14 +1687,14 @@ static void vstplugin_close(t_vstplugin *x){
         // to finish, but that would be overkill. Instead we close the editor
         // *here* and sync with the UI thread in ~t_vstplugin, assuming that
         // the plugin can't send UI events without the editor.
-        auto window = x->x_plugin->getWindow();
+        auto window = plugin->getWindow();
         if (window){
             window->close(); // see above
         }
 
         auto data = new t_close_data();
-        data->plugin = std::move(x->x_plugin);
-        data->uithread = x->x_uithread;
+        data->plugin = std::move(plugin);
+        data->uithread = uithread;
         t_workqueue::get()->push(x, data,
             [](t_close_data *x){
                 defer([&](){
@@ -1551,8 +1703,143 @@ static void vstplugin_close(t_vstplugin *x){
             }, nullptr);
     } else {
         defer([&](){
-            x->x_plugin = nullptr;
-        }, x->x_uithread);
+            plugin = nullptr;
+        }, uithread);
+    }
+}
+
+// Calls fn(index, bus, channel) for every plugin channel, where 'index' is the
+// flat channel index and (bus, channel) is the associated inlet resp. outlet
+// channel, or (-1, -1) if there is none. See setup_plugin() and update_buffers().
+template<typename Fn>
+static void vstplugin_map_channels(const std::vector<t_vstplugin::t_signalbus>& ugenbusses,
+                                   const std::vector<Bus>& pluginbusses, Fn&& fn){
+    int index = 0;
+    if (ugenbusses.size() == 1 && pluginbusses.size() > 1){
+        // distributed
+        for (auto& bus : pluginbusses){
+            for (int j = 0; j < bus.numChannels; ++j, ++index){
+                if (index < ugenbusses[0].b_n){
+                    fn(index, 0, index);
+                } else {
+                    fn(index, -1, -1);
+                }
+            }
+        }
+    } else {
+        // associated
+        for (int i = 0; i < (int)pluginbusses.size(); ++i){
+            for (int j = 0; j < pluginbusses[i].numChannels; ++j, ++index){
+                if (i < (int)ugenbusses.size() && j < ugenbusses[i].b_n){
+                    fn(index, i, j);
+                } else {
+                    fn(index, -1, -1);
+                }
+            }
+        }
+    }
+}
+
+// stop the crossfade and release the previous plugin
+static void vstplugin_fade_stop(t_vstplugin *x){
+    if (x->x_fade){
+        auto fade = std::move(x->x_fade);
+        vstplugin_release(x, std::move(fade->f_plugin), fade->f_async, fade->f_uithread);
+    }
+}
+
+// release the previous plugin after the crossfade has finished.
+// NOTE: we must not do this in the perform routine because releasing
+// the plugin (and the fade buffers) is not realtime safe!
+static void vstplugin_fade_tick(t_vstplugin *x){
+    if (x->x_fade && x->x_fade->f_done){
+        vstplugin_fade_stop(x);
+    }
+}
+
+// Try to crossfade from the current plugin to the next plugin; the current
+// plugin is moved into x_fade. Returns false if we can't (or shouldn't) crossfade.
+// NOTE: we don't crossfade with reblocking because the plugin buffers
+// also serve as FIFOs, see update_buffers().
+static bool vstplugin_fade_start(t_vstplugin *x){
+    if (x->x_fadetime <= 0 || !x->x_process || x->reblocking()
+            || x->x_blocksize <= 0 || x->x_sr <= 0){
+        return false;
+    }
+    vstplugin_fade_stop(x); // previous crossfade still running
+
+    auto fade = std::make_unique<t_fade>();
+    fade->f_length = std::max<int>(x->x_fadetime * 0.001 * x->x_sr, 1);
+    fade->f_async = x->x_async;
+    fade->f_uithread = x->x_uithread;
+    fade->f_precision = x->x_realprecision;
+    // channel maps
+    fade->f_inmap.resize(x->x_input_channels);
+    vstplugin_map_channels(x->x_inlets, x->x_inputs, [&](int index, int bus, int chn){
+        fade->f_inmap[index] = { bus, chn };
+    });
+    fade->f_outmap.resize(x->x_outlets.size());
+    for (int i = 0; i < (int)x->x_outlets.size(); ++i){
+        fade->f_outmap[i].assign(x->x_outlets[i].b_n, -1);
+    }
+    vstplugin_map_channels(x->x_outlets, x->x_outputs, [&](int index, int bus, int chn){
+        if (bus >= 0){
+            fade->f_outmap[bus][chn] = index;
+        }
+    });
+    // private buffers for all plugin channels + scratch buffer
+    int blocksize = x->x_blocksize;
+    int samplesize = (fade->f_precision == ProcessPrecision::Double) ?
+                sizeof(double) : sizeof(float);
+    int nchannels = x->x_input_channels + x->x_output_channels;
+    fade->f_buffer.resize(nchannels * blocksize * samplesize
+                          + blocksize * sizeof(t_sample));
+    auto buf = fade->f_buffer.data();
+    auto setupBusses = [&](auto& busses){
+        for (auto& bus : busses){
+            for (int i = 0; i < bus.numChannels; ++i, buf += blocksize * samplesize){
+                bus.channelData32[i] = (float *)buf;
+            }
+        }
+    };
+    fade->f_inputs = std::move(x->x_inputs);
+    fade->f_outputs = std::move(x->x_outputs);
+    setupBusses(fade->f_inputs);
+    setupBusses(fade->f_outputs);
+    fade->f_scratch = buf;
+    // close the editor window to avoid UI events, see vstplugin_close()
+    auto window = x->x_plugin->getWindow();
+    if (window){
+        window->close();
+    }
+    fade->f_plugin = std::move(x->x_plugin);
+    x->x_fade = std::move(fade);
+    return true;
+}
+
+// If 'crossfade' is true, the plugin keeps running until the next plugin
+// has faded in, see vstplugin_open_done().
+static void vstplugin_close(t_vstplugin *x, bool crossfade){
+    if (!x->x_plugin){
+        return;
+    }
+    if (x->x_suspended){
+        pd_error(x, "%s: can't close plugin - temporarily suspended!",
+                 classname(x));
+        return;
+    }
+#if 0
+    x->x_plugin->setListener(nullptr);
+#endif
+    // the plugin might be released after ~t_vstplugin, see below
+    x->x_plugin->setDSPLoadMeter(nullptr);
+    x->x_dspload_host = false;
+    if (!(crossfade && vstplugin_fade_start(x))){
+        // explicit close -> stop a running crossfade
+        if (!crossfade){
+            vstplugin_fade_stop(x);
+        }
+        vstplugin_release(x, std::move(x->x_plugin), x->x_async, x->x_uithread);
     }
 
     x->x_plugin = nullptr;
@@ -1578,7 +1865,9 @@ struct t_open_data : t_command_data<t_open_data> {
     IPlugin::ptr plugin;
     bool editor;
     bool threaded;
+    bool async;
     RunMode mode;
+    t_plugin_setup setup;
     std::string errmsg;
 };
 
@@ -1605,9 +1894,12 @@ static void vstplugin_open_do(t_open_data *data){
                 // create plugin
                 data->plugin = info->create(data->editor, data->threaded, data->mode);
                 // setup plugin
-                // protect against concurrent vstplugin_dsp() and vstplugin_save()
+                // protect against concurrent vstplugin_dsp()
+                // NOTE: the current plugin keeps running until vstplugin_open_done()!
                 std::lock_guard lock(x->x_mutex);
-                x->setup_plugin(*data->plugin);
+                data->setup.s_samplerate = x->x_sr;
+                data->setup.s_blocksize = x->x_blocksize;
+                x->configure_plugin(*data->plugin, data->setup);
             }, data->editor);
             LOG_DEBUG("done");
         } catch (const Error & e) {
@@ -1619,11 +1911,27 @@ static void vstplugin_open_do(t_open_data *data){
 
 static void vstplugin_open_done(t_open_data *data){
     auto x = data->owner;
+    x->x_loading = false;
     if (data->plugin){
+        // retire the old plugin; it might keep running while
+        // the new plugin fades in, see "crossfade" method.
+        if (x->x_plugin){
+            vstplugin_close(x, true);
+        }
         x->x_plugin = std::move(data->plugin);
+        x->x_async = data->async; // remember *how* we openend the plugin
         x->x_uithread = data->editor; // remember *where* we opened the plugin
         x->x_threaded = data->threaded;
         x->x_runmode = data->mode;
+        // samplerate or blocksize might have changed in the meantime
+        bool stale = x->x_sr != data->setup.s_samplerate
+                || x->x_blocksize != data->setup.s_blocksize;
+        x->apply_setup(std::move(data->setup));
+        if (stale){
+            x->x_editor->defer_safe<false>([&](){
+                x->setup_plugin(*x->x_plugin);
+            }, x->x_uithread);
+        }
 
         auto& info = x->x_plugin->info();
 
@@ -1651,6 +1959,15 @@ static void vstplugin_open_done(t_open_data *data){
         if (x->x_bypass != Bypass::Off){
             x->x_plugin->setBypass(x->x_bypass);
         }
+        if (x->x_silence != SilenceMode::Off){
+            x->x_plugin->setSilenceMode(x->x_silence);
+        }
+        if (x->x_coalesce){
+            x->x_plugin->setParameterCoalescing(true);
+        }
+        x->setup_dspload();
+        // snapshots belong to the previous plugin
+        x->x_snapshots.clearAll();
 
         // store key (mainly needed for preset change notification)
         x->x_key = gensym(info.key().c_str());
@@ -1663,6 +1980,9 @@ static void vstplugin_open_done(t_open_data *data){
 
         logpost(x, PdDebug, "opened '%s'", info.name.c_str());
     } else {
+        // close the old plugin, so that we have a consistent state.
+        vstplugin_close(x);
+
         if (!data->errmsg.empty()) {
             pd_error(x, "%s", data->errmsg.c_str());
         }
@@ -1687,10 +2007,7 @@ static void vstplugin_open_notify(t_vstplugin *x) {
     if (success) {
         // report initial latency
         t_atom a;
-        int latency = x->x_plugin->getLatencySamples();
-        if (x->x_threaded){
-            latency += x->x_blocksize;
-        }
+        int latency = x->x_plugin->getLatencySamples() + x->extra_latency();
         SETFLOAT(&a, latency);
         outlet_anything(x->x_messout, gensym("latency"), 1, &a);
     }
@@ -1750,14 +2067,21 @@ static void vstplugin_open(t_vstplugin *x, t_symbol *s, int argc, t_atom *argv){
                  classname(x));
         return;
     }
-    // close the old plugin
-    vstplugin_close(x);
+    if (x->x_loading){
+        pd_error(x, "%s: can't open plugin - already loading!",
+                 classname(x));
+        return;
+    }
+    // NOTE: the old plugin is only closed in vstplugin_open_done(),
+    // so that it can keep running while the new plugin is being loaded.
 
     // for editor or plugin bridge/sandbox
     initEventLoop();
 
     auto abspath = x->resolve_plugin_path(pathsym->s_name);
     if (abspath.empty()) {
+        // close the old plugin
+        vstplugin_close(x);
         pd_error(x, "%s: cannot open '%s'", classname(x), pathsym->s_name);
         // output failure!
         vstplugin_open_notify(x);
@@ -1772,7 +2096,9 @@ static void vstplugin_open(t_vstplugin *x, t_symbol *s, int argc, t_atom *argv){
         data->abspath = abspath;
         data->editor = editor;
         data->threaded = threaded;
+        data->async = true;
         data->mode = mode;
+        x->x_loading = true;
         t_workqueue::get()->push(
             x, data, vstplugin_open_do<true>,
             [](t_open_data *x){
@@ -1786,13 +2112,12 @@ static void vstplugin_open(t_vstplugin *x, t_symbol *s, int argc, t_atom *argv){
         data.abspath = abspath;
         data.editor = editor;
         data.threaded = threaded;
+        data.async = false;
         data.mode = mode;
         vstplugin_open_do<false>(&data);
         vstplugin_open_done(&data);
         vstplugin_open_notify(x);
     }
-    x->x_async = async; // remember *how* we openend the plugin
-    // NOTE: don't set 'x_uithread' already because 'editor' value might change
 }
 
 /*-------------------------- "info" -------------------------*/
@@ -1834,13 +2159,13 @@ static void vstplugin_info(t_vstplugin *x, t_symbol *s, int argc, t_atom *argv){
     // deprecated
 #if 1
     sendInfo(x, "inputs", info->numInputs() > 0 ?
-                 info->inputs[0].numChannels : 0);
+                 info->inputs()[0].numChannels : 0);
     sendInfo(x, "outputs", info->numOutputs() > 0 ?
-                 info->outputs[0].numChannels : 0);
+                 info->outputs()[0].numChannels : 0);
     sendInfo(x, "auxinputs", info->numInputs() > 1 ?
-                 info->inputs[1].numChannels : 0);
+                 info->inputs()[1].numChannels : 0);
     sendInfo(x, "auxoutputs", info->numOutputs() > 1 ?
-                 info->outputs[1].numChannels : 0);
+                 info->outputs()[1].numChannels : 0);
 #endif
     sendInfo(x, "id", ("0x"+info->uniqueID));
     sendInfo(x, "editor", info->editor());
@@ -1954,8 +2279,8 @@ static void vstplugin_print(t_vstplugin *x){
             post("%s: none", what);
         }
     };
-    postBusses(info.inputs, "inputs", vst3);
-    postBusses(info.outputs, "outputs", vst3);
+    postBusses(info.inputs(), "inputs", vst3);
+    postBusses(info.outputs(), "outputs", vst3);
 
     post("parameters: %d", info.numParameters());
     post("programs: %d", info.numPrograms());
@@ -2006,6 +2331,87 @@ static void vstplugin_bypass(t_vstplugin *x, t_floatarg f){
     x->x_bypass = bypass;
 }
 
+/*-------------------------- "silence" ----------------------------*/
+
+// 0: off, 1: detect silent input (VST3), 2: sleep while idle
+static void vstplugin_silence(t_vstplugin *x, t_floatarg f){
+    int arg = f;
+    SilenceMode mode;
+    switch (arg){
+    case 0:
+        mode = SilenceMode::Off;
+        break;
+    case 1:
+        mode = SilenceMode::Detect;
+        break;
+    case 2:
+        mode = SilenceMode::Sleep;
+        break;
+    default:
+        pd_error(x, "%s: bad argument for 'silence' message (%d)", classname(x), arg);
+        return;
+    }
+    if (x->x_plugin && (mode != x->x_silence)){
+        x->x_plugin->setSilenceMode(mode);
+    }
+    x->x_silence = mode;
+}
+
+/*-------------------------- "coalesce" ----------------------------*/
+
+// only send the last parameter change per block (threaded/bridged plugins)
+static void vstplugin_coalesce(t_vstplugin *x, t_floatarg f){
+    bool enable = f != 0;
+    if (x->x_plugin && (enable != x->x_coalesce)){
+        x->x_plugin->setParameterCoalescing(enable);
+    }
+    x->x_coalesce = enable;
+}
+
+/*-------------------------- "crossfade" ----------------------------*/
+
+// crossfade time (ms) when opening a new plugin while another plugin is running;
+// 0: off (default). NOTE: has no effect with reblocking (-B flag).
+static void vstplugin_crossfade(t_vstplugin *x, t_floatarg f){
+    x->x_fadetime = std::max<t_float>(f, 0);
+}
+
+/*-------------------------- "cpu" ----------------------------*/
+
+// cpu <f>: enable/disable DSP load metering
+// cpu reset: reset the meter
+// cpu: output [cpu <last> <average> <peak> <load> <wait>( in milliseconds
+// resp. percent (load).
+static void vstplugin_cpu(t_vstplugin *x, t_symbol *s, int argc, t_atom *argv){
+    if (argc > 0){
+        if (argv->a_type == A_FLOAT){
+            x->x_dspload_enabled = argv->a_w.w_float != 0;
+            x->x_dspload.reset();
+            if (x->x_plugin){
+                x->setup_dspload();
+            }
+        } else if (atom_getsymbol(argv) == gensym("reset")){
+            x->x_dspload.reset();
+        } else {
+            pd_error(x, "%s: bad argument '%s' for 'cpu' method",
+                     classname(x), atom_getsymbol(argv)->s_name);
+        }
+        return;
+    }
+    if (!x->x_dspload_enabled){
+        pd_error(x, "%s: DSP load metering is disabled (see 'cpu' method)", classname(x));
+        return;
+    }
+    auto load = x->x_dspload.get();
+    t_atom msg[5];
+    SETFLOAT(&msg[0], load.last * 1000.0);
+    SETFLOAT(&msg[1], load.average * 1000.0);
+    SETFLOAT(&msg[2], load.peak * 1000.0);
+    SETFLOAT(&msg[3], load.load);
+    SETFLOAT(&msg[4], load.wait * 1000.0);
+    outlet_anything(x->x_messout, gensym("cpu"), 5, msg);
+}
+
 /*-------------------------- "reset" ----------------------------*/
 
 struct t_reset_data : t_command_data<t_reset_data> {};
@@ -2055,7 +2461,7 @@ static void vstplugin_offline(t_vstplugin *x, t_floatarg f){
         x->x_editor->defer_safe<false>([&](){
             std::lock_guard lock(x->x_mutex);
             x->x_plugin->suspend();
-            x->x_plugin->setupProcessing(x->x_sr, x->x_blocksize,
+            x->x_plugin->setupProcessing(x->x_sr, x->plugin_blocksize(),
                                          x->x_realprecision, mode);
             x->x_plugin->resume();
         }, x->x_uithread);
@@ -2155,7 +2561,7 @@ enum class t_direction {
 template<t_direction dir>
 static void vstplugin_bus_doinfo(const PluginDesc& info, int index, t_outlet *outlet){
     auto& bus = (dir == t_direction::out) ?
-                info.outputs[index] : info.inputs[index];
+                info.outputs()[index] : info.inputs()[index];
     auto vst3 = info.type() == PluginType::VST3;
     t_atom msg[4];
     SETFLOAT(&msg[0], index);
@@ -2278,7 +2684,7 @@ static void vstplugin_param_get(t_vstplugin *x, t_symbol *s, int argc, t_atom *a
 
 // get parameter info (name + label + automatable)
 static void vstplugin_param_doinfo(const PluginDesc& info, int index, t_outlet *outlet){
-    auto& param = info.parameters[index];
+    auto& param = info.parameters()[index];
     t_atom msg[4];
     SETFLOAT(&msg[0], index);
     SETSYMBOL(&msg[1], gensym(param.name.c_str()));
@@ -2328,14 +2734,24 @@ static void vstplugin_param_list(t_vstplugin *x, t_symbol *s){
     }
 }
 
-// list parameter states (index + value)
+// list parameter states (index + value + display)
 static void vstplugin_param_dump(t_vstplugin *x){
     if (!x->check_plugin()) return;
     int n = x->x_plugin->info().numParameters();
-    for (int i = 0; i < n; ++i){
-        t_atom a;
-        SETFLOAT(&a, i);
-        vstplugin_param_get(x, 0, 1, &a);
+    // query the parameters in chunks
+    const int chunkSize = 64;
+    float values[chunkSize];
+    ParamStringBuffer strings[chunkSize];
+    for (int i = 0; i < n; i += chunkSize){
+        int count = std::min(chunkSize, n - i);
+        x->x_plugin->getParameters(i, count, values, strings);
+        for (int j = 0; j < count; ++j){
+            t_atom msg[3];
+            SETFLOAT(&msg[0], i + j);
+            SETFLOAT(&msg[1], values[j]);
+            SETSYMBOL(&msg[2], gensym(strings[j].data()));
+            outlet_anything(x->x_messout, gensym("param_state"), 3, msg);
+        }
     }
 }
 
@@ -2481,7 +2897,7 @@ static void vstplugin_program_list(t_vstplugin *x,  t_symbol *s){
     t_atom msg[2];
     for (int i = 0; i < n; ++i){
         t_symbol *name = gensym(local ? x->x_plugin->getProgramNameIndexed(i).c_str()
-                                            : info->programs[i].c_str());
+                                            : info->programs()[i].c_str());
         SETFLOAT(&msg[0], i);
         SETSYMBOL(&msg[1], name);
         outlet_anything(x->x_messout, gensym("program_name"), 2, msg);
@@ -2567,6 +2983,93 @@ static void vstplugin_preset_data_get(t_vstplugin *x){
                     n, atoms.data());
 }
 
+/*----------------------- "snapshot_save" ----------------------------*/
+
+// store the current plugin state in a snapshot slot
+static void vstplugin_snapshot_save(t_vstplugin *x, t_floatarg f){
+    if (!x->check_plugin()) return;
+    int slot = f;
+    if (slot < 0 || slot >= SnapshotStore::maxNumSlots){
+        pd_error(x, "%s: snapshot slot %d out of range", classname(x), slot);
+        return;
+    }
+    // also try to get the program data, so we can do a full recall
+    std::string buffer;
+    try {
+        x->x_editor->defer_safe<false>([&](){
+            std::lock_guard lock(x->x_mutex); // avoid concurrent reads/writes
+            x->x_plugin->writeProgramData(buffer);
+        }, x->x_uithread);
+    } catch (const Error& e){
+        logpost(x, PdDebug, "%s: snapshot %d: couldn't get program data (%s)",
+                classname(x), slot, e.what());
+        buffer.clear(); // only save parameters
+    }
+    x->x_snapshots.save(slot, *x->x_plugin, std::move(buffer));
+}
+
+/*----------------------- "snapshot_recall" --------------------------*/
+
+// recall a snapshot; only the parameters which differ from the current
+// state are sent to the plugin. With the optional 'full' argument, we
+// restore the program data instead (if available).
+static void vstplugin_snapshot_recall(t_vstplugin *x, t_floatarg f1, t_floatarg f2){
+    if (!x->check_plugin()) return;
+    int slot = f1;
+    bool full = f2 != 0;
+    if (!x->x_snapshots.valid(slot)){
+        pd_error(x, "%s: snapshot %d is empty", classname(x), slot);
+        return;
+    }
+    if (full){
+        auto chunk = x->x_snapshots.chunk(slot);
+        if (!chunk.empty()){
+            try {
+                x->x_editor->defer_safe<false>([&](){
+                    std::lock_guard lock(x->x_mutex); // avoid concurrent reads/writes
+                    x->x_plugin->readProgramData(chunk);
+                }, x->x_uithread);
+                x->x_editor->update(false);
+                return;
+            } catch (const Error& e) {
+                pd_error(x, "%s: couldn't recall snapshot %d: %s",
+                         classname(x), slot, e.what());
+                // fall back to parameters
+            }
+        }
+    }
+    auto count = x->x_snapshots.recall(slot, *x->x_plugin, [&](int index, float value){
+        x->set_param(index, value, false);
+    });
+    if (count < 0){
+        pd_error(x, "%s: couldn't recall snapshot %d", classname(x), slot);
+    }
+}
+
+/*----------------------- "snapshot_morph" ---------------------------*/
+
+// interpolate between two snapshots
+static void vstplugin_snapshot_morph(t_vstplugin *x, t_floatarg a, t_floatarg b, t_floatarg f){
+    if (!x->check_plugin()) return;
+    auto count = x->x_snapshots.morph((int)a, (int)b, f, *x->x_plugin, [&](int index, float value){
+        x->set_param(index, value, false);
+    });
+    if (count < 0){
+        pd_error(x, "%s: couldn't morph snapshots %d and %d", classname(x), (int)a, (int)b);
+    }
+}
+
+/*----------------------- "snapshot_clear" ---------------------------*/
+
+// clear a snapshot slot or all slots (no argument)
+static void vstplugin_snapshot_clear(t_vstplugin *x, t_symbol *s, int argc, t_atom *argv){
+    if (argc > 0){
+        x->x_snapshots.clear(atom_getfloat(argv));
+    } else {
+        x->x_snapshots.clearAll();
+    }
+}
+
 /*-------------------------- "program_read" ----------------------------*/
 
 // read program/bank file (.FXP/.FXB)
@@ -2574,21 +3077,11 @@ template<t_preset type, bool async>
 static void vstplugin_preset_read_do(t_preset_data *data){
     try {
         auto x = data->owner;
-        // NOTE: avoid readProgramFile() to minimize the critical section
-        std::string buffer;
-        vst::File file(data->path);
-        if (!file.is_open()){
-            throw Error("couldn't open file");
-        }
-        file.seekg(0, std::ios_base::end);
-        buffer.resize(file.tellg());
-        file.seekg(0, std::ios_base::beg);
-        file.read(&buffer[0], buffer.size());
-        if (file){
-            LOG_DEBUG("successfully read " << buffer.size() << " bytes");
-        } else {
-            throw Error("couldn't read file");
-        }
+        // NOTE: avoid readProgramFile() to minimize the critical section.
+        // The file is memory mapped, so we don't need to copy the data.
+        vst::MappedFile file(data->path); // throws on failure
+        std::string_view buffer(file.data(), file.size());
+        LOG_DEBUG("successfully mapped " << buffer.size() << " bytes");
 
         x->x_editor->defer_safe<async>([&](){
             // protect against vstplugin_dsp() and vstplugin_save()
@@ -3176,8 +3669,8 @@ static t_class *vstplugin_class;
 void t_vstplugin::set_param(int index, float value, bool automated){
     if (index >= 0 && index < x_plugin->info().numParameters()){
         value = std::max(0.f, std::min(1.f, value));
-        int offset = x_plugin->info().type() == PluginType::VST3 ? get_sample_offset() : 0;
-        x_plugin->setParameter(index, value, offset);
+        // NB: VST2 plugins do sub-block processing
+        x_plugin->setParameter(index, value, get_sample_offset());
         if (deferred()) {
             x_editor->param_changed_deferred(index, automated);
         } else {
@@ -3206,7 +3699,9 @@ void t_vstplugin::set_param(int index, const char *s, bool automated){
 }
 
 bool t_vstplugin::check_plugin(){
-    if (x_plugin){
+    if (x_loading){
+        pd_error(this, "%s: plugin is being (re)opened!", classname(this));
+    } else if (x_plugin){
         if (!x_suspended){
             return true;
         } else {
@@ -3219,25 +3714,43 @@ bool t_vstplugin::check_plugin(){
 }
 
 void t_vstplugin::setup_plugin(IPlugin& plugin){
+    t_plugin_setup setup;
+    configure_plugin(plugin, setup);
+    apply_setup(std::move(setup));
+}
+
+void t_vstplugin::apply_setup(t_plugin_setup&& setup){
+    x_realprecision = setup.s_precision;
+    x_process = setup.s_process;
+    x_inputs = std::move(setup.s_inputs);
+    x_outputs = std::move(setup.s_outputs);
+    x_input_channels = setup.s_input_channels;
+    x_output_channels = setup.s_output_channels;
+}
+
+// set up the plugin, but don't touch the current processing state;
+// see apply_setup() and vstplugin_open_do().
+void t_vstplugin::configure_plugin(IPlugin& plugin, t_plugin_setup& setup) const {
     // check processing precision before calling setupProcessing()!
     // (only post warnings in vstplugin_open_done())
     if (plugin.info().hasPrecision(x_wantprecision)){
-        x_realprecision = x_wantprecision;
-        x_process = true;
+        setup.s_precision = x_wantprecision;
+        setup.s_process = true;
     } else {
         if (plugin.info().hasPrecision(ProcessPrecision::Single)){
-            x_realprecision = ProcessPrecision::Single;
-            x_process = true;
+            setup.s_precision = ProcessPrecision::Single;
+            setup.s_process = true;
         } else if (plugin.info().hasPrecision(ProcessPrecision::Double)){
-            x_realprecision = ProcessPrecision::Double;
-            x_process = true;
+            setup.s_precision = ProcessPrecision::Double;
+            setup.s_process = true;
         } else {
-            x_process = false; // bypass
+            setup.s_precision = x_wantprecision; // doesn't matter
+            setup.s_process = false; // bypass
         }
     }
 
     plugin.suspend();
-    plugin.setupProcessing(x_sr, x_blocksize, x_realprecision, x_mode);
+    plugin.setupProcessing(x_sr, plugin_blocksize(), setup.s_precision, x_mode);
 
     auto setupSpeakers = [](const auto& pluginBusses,
             const auto& ugenBusses, auto& result, const char *what) {
@@ -3276,27 +3789,27 @@ void t_vstplugin::setup_plugin(IPlugin& plugin){
 
     // prepare input busses
     std::vector<int> inputs;
-    setupSpeakers(plugin.info().inputs, x_inlets, inputs, "inputs");
+    setupSpeakers(plugin.info().inputs(), x_inlets, inputs, "inputs");
 
     // prepare output busses
     std::vector<int> outputs;
-    setupSpeakers(plugin.info().outputs, x_outlets, outputs, "outputs");
+    setupSpeakers(plugin.info().outputs(), x_outlets, outputs, "outputs");
 
     plugin.setNumSpeakers(inputs.data(), inputs.size(),
                            outputs.data(), outputs.size());
 
-    x_inputs.resize(inputs.size());
-    x_input_channels = 0;
+    setup.s_inputs.resize(inputs.size());
+    setup.s_input_channels = 0;
     for (int i = 0; i < (int)inputs.size(); ++i){
-        x_input_channels += inputs[i];
-        x_inputs[i] = Bus(inputs[i]);
+        setup.s_input_channels += inputs[i];
+        setup.s_inputs[i] = Bus(inputs[i]);
     }
 
-    x_outputs.resize(outputs.size());
-    x_output_channels = 0;
+    setup.s_outputs.resize(outputs.size());
+    setup.s_output_channels = 0;
     for (int i = 0; i < (int)outputs.size(); ++i){
-        x_output_channels += outputs[i];
-        x_outputs[i] = Bus(outputs[i]);
+        setup.s_output_channels += outputs[i];
+        setup.s_outputs[i] = Bus(outputs[i]);
     }
 
     plugin.resume();
@@ -3310,10 +3823,18 @@ void t_vstplugin::update_buffers(){
     } else {
         samplesize = sizeof(t_sample);
     }
-    int channelsize = samplesize * x_blocksize;
+    // NOTE: with reblocking, the inlet and outlet buffers
+    // serve as input and output FIFOs for the plugin.
+    bool reblock = reblocking();
+    if (reblock){
+        x_reblocker.init(x_reblocksize, x_blocksize);
+    }
+    int channelsize = samplesize * plugin_blocksize();
 
     // prepare inlets
-    // NOTE: we always have to buffer the inlets!
+    // NOTE: we have to buffer the inlets if Pd and VST plugin use a
+    // different float size or if any inlet aliases an outlet; the buffers
+    // are always allocated because we also need them for bypassing.
     int ninchannels = 0;
     for (int i = 0; i < (int)x_inlets.size(); ++i){
         ninchannels += x_inlets[i].b_n;
@@ -3333,8 +3854,8 @@ void t_vstplugin::update_buffers(){
 
     // prepare outlets
     // NOTE: only buffer the outlets if Pd and VST plugin
-    // use a different float size!
-    bool needbuffer = (samplesize != sizeof(t_sample));
+    // use a different float size or if we are reblocking!
+    bool needbuffer = (samplesize != sizeof(t_sample)) || reblock;
     int noutchannels = 0;
     if (needbuffer){
         for (int i = 0; i < (int)x_outlets.size(); ++i){
@@ -3425,8 +3946,30 @@ void t_vstplugin::update_buffers(){
         }
     };
 
+    // Pd may reuse inlet signal vectors for outlets, in which case the plugin
+    // would overwrite its own input. This is checked once per DSP graph update,
+    // so the common case (e.g. multichannel connections) avoids the extra copy.
+    auto aliased = [this](){
+        for (auto& inlets : x_inlets){
+            for (int i = 0; i < inlets.b_n; ++i){
+                auto in = inlets.b_signals[i];
+                for (auto& outlets : x_outlets){
+                    for (int j = 0; j < outlets.b_n; ++j){
+                        auto out = outlets.b_signals[j];
+                        if (in && out && (in < out + x_blocksize) && (out < in + x_blocksize)){
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    };
+    x_direct_inputs = (samplesize == sizeof(t_sample)) && !reblock && !aliased();
+    LOG_DEBUG("direct inputs: " << (x_direct_inputs ? "yes" : "no"));
+
     // setup plugin inputs
-    setupBusses(x_inlets, x_inputs, indummy, true, "inlets"); // always buffer!
+    setupBusses(x_inlets, x_inputs, indummy, !x_direct_inputs, "inlets");
     // setup plugin outputs
     setupBusses(x_outlets, x_outputs, outdummy, needbuffer, "outlets");
 }
@@ -3434,7 +3977,31 @@ void t_vstplugin::update_buffers(){
 int t_vstplugin::get_sample_offset(){
     int offset = clock_gettimesincewithunits(x_lastdsptime, 1, true);
     // LOG_DEBUG("sample offset: " << offset);
-    return offset % x_blocksize;
+    offset %= x_blocksize;
+    if (reblocking()){
+        // relative to the current plugin block
+        offset = std::min(x_reblocker.phase() + offset, x_reblocksize - 1);
+    }
+    return offset;
+}
+
+void t_vstplugin::setup_dspload(){
+    // threaded and bridged plugins measure themselves,
+    // otherwise we measure in the perform routine.
+    if (x_dspload_enabled){
+        x_dspload_host = !x_plugin->setDSPLoadMeter(&x_dspload);
+    } else {
+        x_plugin->setDSPLoadMeter(nullptr);
+        x_dspload_host = false;
+    }
+}
+
+int t_vstplugin::extra_latency() const {
+    int latency = reblocking() ? x_reblocker.latency() : 0;
+    if (x_threaded){
+        latency += plugin_blocksize();
+    }
+    return latency;
 }
 
 std::string t_vstplugin::resolve_plugin_path(const char *s) {
@@ -3609,6 +4176,19 @@ t_vstplugin::t_vstplugin(int argc, t_atom *argv){
                 mode = RunMode::Sandbox;
             } else if (!strcmp(flag, "-b")){
                 mode = RunMode::Bridge;
+            } else if (!strcmp(flag, "-B")){
+                if (argc > 1 && argv[1].a_type == A_FLOAT){
+                    int blocksize = argv[1].a_w.w_float;
+                    if (blocksize > 0){
+                        x_reblocksize = blocksize;
+                    } else {
+                        pd_error(this, "%s: bad block size %d for '-B' flag",
+                                 classname(this), blocksize);
+                    }
+                    argc--; argv++;
+                } else {
+                    pd_error(this, "%s: missing argument for '-B' flag", classname(this));
+                }
             } else {
                 pd_error(this, "%s: unknown flag '%s'", classname(this), flag);
             }
@@ -3693,6 +4273,8 @@ t_vstplugin::t_vstplugin(int argc, t_atom *argv){
     }
     // additional message outlet
     x_messout = outlet_new(&x_obj, 0);
+    // release the previous plugin after a crossfade
+    x_fadeclock = clock_new(this, (t_method)vstplugin_fade_tick);
 
     if (search && !gDidSearch){
         for (auto& path : getDefaultSearchPaths()){
@@ -3760,8 +4342,14 @@ t_vstplugin::~t_vstplugin() {
         t_workqueue::get()->cancel(this);
         x_suspended = false; // for vstplugin_close()!
     }
+    // the same goes for a pending "open" command
+    if (x_loading){
+        t_workqueue::get()->cancel(this);
+        x_loading = false;
+    }
 
-    if (x_plugin) {
+    if (x_plugin || x_fade) {
+        vstplugin_fade_stop(this);
         vstplugin_close(this);
 
         // Sync with UI thread if we're closing asynchronously,
@@ -3773,6 +4361,8 @@ t_vstplugin::~t_vstplugin() {
 
     LOG_DEBUG("vstplugin free");
 
+    clock_free(x_fadeclock);
+
     pd_unbind(&x_obj.ob_pd, gensym(glob_recv_name));
 
     t_workqueue::release();
@@ -3784,28 +4374,7 @@ static void vstplugin_free(t_vstplugin *x){
 
 /*-------------------------- perform routine ----------------------------*/
 
-// TFloat: processing float type
-// this templated method makes some optimization based on whether T and U are equal
-template<typename TFloat>
-static void vstplugin_doperform(t_vstplugin *x, int n){
-    auto plugin = x->x_plugin.get();
-
-    // first copy inlets into buffer
-    // we have to do this even if the plugin uses the same float type
-    // because inlets and outlets can alias!
-    for (auto& inlets : x->x_inlets){
-        for (int i = 0; i < inlets.b_n; ++i){
-            auto src = inlets.b_signals[i];
-            auto dst = (TFloat *)inlets.b_buffers[i];
-            // NOTE: use a plain for-loop because we might need to
-            // convert from t_sample to TFloat!
-            for (int j = 0; j < n; ++j){
-                dst[j] = src[j];
-            }
-        }
-    }
-
-    // process
+static void vstplugin_process(t_vstplugin *x, IPlugin *plugin, int n){
     ProcessData data;
     data.numSamples = n;
     data.precision = x->x_realprecision;
@@ -3814,7 +4383,71 @@ static void vstplugin_doperform(t_vstplugin *x, int n){
     data.numInputs = x->x_inputs.size();
     data.outputs = x->x_outputs.empty() ? nullptr :  x->x_outputs.data();
     data.numOutputs = x->x_outputs.size();
-    plugin->process(data);
+    if (x->x_dspload_host){
+        auto start = DSPLoadMeter::clock::now();
+        plugin->process(data);
+        x->x_dspload.addProcessTime(DSPLoadMeter::elapsed(start), n);
+    } else {
+        plugin->process(data);
+    }
+}
+
+// Run the plugin at a fixed block size (see "-B" flag), using the inlet
+// and outlet buffers as input and output FIFOs. If 'plugin' is NULL,
+// we bypass from the input FIFOs to the output FIFOs.
+template<typename TFloat>
+static void vstplugin_reblock(t_vstplugin *x, IPlugin *plugin, int n){
+    int blocksize = x->x_reblocksize;
+    x->x_reblocker.perform(n, [&](int phase, int offset, int count){
+        for (auto& inlets : x->x_inlets){
+            for (int i = 0; i < inlets.b_n; ++i){
+                kernels::copy((TFloat *)inlets.b_buffers[i] + phase,
+                              inlets.b_signals[i] + offset, count);
+            }
+        }
+    }, [&](int phase, int offset, int count){
+        for (auto& outlets : x->x_outlets){
+            for (int i = 0; i < outlets.b_n; ++i){
+                kernels::copy(outlets.b_signals[i] + offset,
+                              (const TFloat *)outlets.b_buffers[i] + phase, count);
+            }
+        }
+    }, [&](){
+        if (plugin){
+            vstplugin_process(x, plugin, blocksize);
+            return;
+        }
+        for (int i = 0; i < (int)x->x_outlets.size(); ++i){
+            auto& outlets = x->x_outlets[i];
+            for (int j = 0; j < outlets.b_n; ++j){
+                auto dst = (TFloat *)outlets.b_buffers[j];
+                if (i < (int)x->x_inlets.size() && j < x->x_inlets[i].b_n){
+                    kernels::copy(dst, (const TFloat *)x->x_inlets[i].b_buffers[j], blocksize);
+                } else {
+                    kernels::clear(dst, blocksize);
+                }
+            }
+        }
+    });
+}
+
+template<typename TFloat>
+static void vstplugin_doperform_block(t_vstplugin *x, IPlugin *plugin, int n){
+    // first copy inlets into buffer
+    // we have to do this even if the plugin uses the same float type
+    // if inlets and outlets alias, see t_vstplugin::update_buffers()
+    if (!x->x_direct_inputs){
+        for (auto& inlets : x->x_inlets){
+            for (int i = 0; i < inlets.b_n; ++i){
+                auto src = inlets.b_signals[i];
+                auto dst = (TFloat *)inlets.b_buffers[i];
+                // NOTE: we might need to convert from t_sample to TFloat!
+                kernels::copy(dst, src, n);
+            }
+        }
+    }
+
+    vstplugin_process(x, plugin, n);
 
     if (!std::is_same<t_sample, TFloat>::value){
         // copy output buffer to Pd outlets
@@ -3822,13 +4455,23 @@ static void vstplugin_doperform(t_vstplugin *x, int n){
             for (int i = 0; i < outlets.b_n; ++i){
                 auto src = (TFloat *)outlets.b_buffers[i];
                 auto dst = outlets.b_signals[i];
-                // NOTE: use a plain for-loop!
-                for (int j = 0; j < n; ++j){
-                    dst[j] = src[j];
-                }
+                kernels::copy(dst, src, n);
             }
         }
     }
+}
+
+// TFloat: processing float type
+// this templated method makes some optimization based on whether T and U are equal
+template<typename TFloat>
+static void vstplugin_doperform(t_vstplugin *x, int n){
+    auto plugin = x->x_plugin.get();
+
+    if (x->reblocking()){
+        vstplugin_reblock<TFloat>(x, plugin, n);
+    } else {
+        vstplugin_doperform_block<TFloat>(x, plugin, n);
+    }
 
     // zero remaining outlets
     int noutlets = x->x_outlets.size();
@@ -3837,8 +4480,7 @@ static void vstplugin_doperform(t_vstplugin *x, int n){
         // plugin outputs might be destributed
         auto& outlets = x->x_outlets[0];
         for (int i = x->x_output_channels; i < outlets.b_n; ++i){
-            auto out = outlets.b_signals[i];
-            std::fill(out, out + n, 0);
+            kernels::clear(outlets.b_signals[i], n);
         }
     } else {
         for (int i = 0; i < noutlets; ++i){
@@ -3846,18 +4488,101 @@ static void vstplugin_doperform(t_vstplugin *x, int n){
             int onset = (i < noutputs) ?
                         x->x_outputs[i].numChannels : 0;
             for (int j = onset; j < outlets.b_n; ++j){
-                auto out = outlets.b_signals[j];
-                std::fill(out, out + n, 0);
+                kernels::clear(outlets.b_signals[j], n);
             }
         }
     }
 }
 
+// run the previous plugin during a crossfade, see vstplugin_fade_start().
+// NOTE: we must do this before the current plugin writes to the outlets,
+// because inlets and outlets can alias!
+template<typename TFloat>
+static void vstplugin_fade_process(t_vstplugin *x, int n){
+    auto& fade = *x->x_fade;
+    int index = 0;
+    for (auto& bus : fade.f_inputs){
+        for (int i = 0; i < bus.numChannels; ++i, ++index){
+            auto dst = (TFloat *)bus.channelData32[i];
+            auto [inlet, chn] = fade.f_inmap[index];
+            if (inlet >= 0){
+                kernels::copy(dst, x->x_inlets[inlet].b_signals[chn], n);
+            } else {
+                kernels::clear(dst, n);
+            }
+        }
+    }
+
+    ProcessData data;
+    data.numSamples = n;
+    data.precision = fade.f_precision;
+    data.mode = x->x_mode;
+    data.inputs = fade.f_inputs.empty() ? nullptr : fade.f_inputs.data();
+    data.numInputs = fade.f_inputs.size();
+    data.outputs = fade.f_outputs.empty() ? nullptr : fade.f_outputs.data();
+    data.numOutputs = fade.f_outputs.size();
+    fade.f_plugin->process(data);
+}
+
+// mix the output of the previous plugin into the outlets; afterwards
+// the outlets only contain the output of the current plugin.
+template<typename TFloat>
+static void vstplugin_fade_mix(t_vstplugin *x, int n){
+    auto& fade = *x->x_fade;
+    int k = std::min<int>(n, fade.f_length - fade.f_pos);
+    t_sample gain = (t_sample)fade.f_pos / (t_sample)fade.f_length;
+    t_sample inc = (t_sample)1 / (t_sample)fade.f_length;
+    // flat plugin channel -> output buffer
+    auto channel = [&](int index) -> const TFloat * {
+        for (auto& bus : fade.f_outputs){
+            if (index < bus.numChannels){
+                return (const TFloat *)bus.channelData32[index];
+            }
+            index -= bus.numChannels;
+        }
+        return nullptr;
+    };
+    for (int i = 0; i < (int)x->x_outlets.size(); ++i){
+        auto& outlets = x->x_outlets[i];
+        for (int j = 0; j < outlets.b_n; ++j){
+            auto sig = outlets.b_signals[j];
+            int index = fade.f_outmap[i][j];
+            if (index >= 0){
+                auto src = channel(index);
+                if (!std::is_same<t_sample, TFloat>::value){
+                    auto tmp = (t_sample *)fade.f_scratch;
+                    kernels::copy(tmp, src, k);
+                    kernels::crossfade(sig, sig, tmp, k, gain, inc);
+                } else {
+                    kernels::crossfade(sig, sig, (const t_sample *)src, k, gain, inc);
+                }
+            } else {
+                // fade in current plugin
+                kernels::fade(sig, sig, k, gain, inc);
+            }
+        }
+    }
+    fade.f_pos += k;
+    if (fade.f_pos >= fade.f_length){
+        // release the plugin in the clock method, see vstplugin_fade_tick()
+        fade.f_done = true;
+        clock_delay(x->x_fadeclock, 0);
+    }
+}
+
 static t_int *vstplugin_perform(t_int *w){
     t_vstplugin *x = (t_vstplugin *)(w[1]);
     int n = (int)(w[2]);
     x->x_lastdsptime = clock_getlogicaltime();
 
+    if (x->x_fade && !x->x_fade->f_done){
+        if (x->x_fade->f_precision == ProcessPrecision::Double){
+            vstplugin_fade_process<double>(x, n);
+        } else {
+            vstplugin_fade_process<float>(x, n);
+        }
+    }
+
     // checking only x_process wouldn't be thread-safe!
     auto process = (x->x_plugin != nullptr) && x->x_process;
     // if async command is running, try to lock the mutex or bypass on failure
@@ -3876,14 +4601,23 @@ static t_int *vstplugin_perform(t_int *w){
         if (x->x_suspended){
             x->x_mutex.unlock();
         }
+    } else if (x->reblocking()){
+        // bypass through the FIFOs, so that the latency stays the same.
+        // NOTE: the buffers use the plugin float type, see update_buffers()
+        if (x->x_plugin && x->x_realprecision == ProcessPrecision::Double){
+            vstplugin_reblock<double>(x, nullptr, n);
+        } else if (x->x_plugin){
+            vstplugin_reblock<float>(x, nullptr, n);
+        } else {
+            vstplugin_reblock<t_sample>(x, nullptr, n);
+        }
     } else {
         // bypass/zero
         // first copy all inlets into temporary buffer
         // because inlets and outlets can alias!
         for (auto& inlets : x->x_inlets){
             for (int i = 0; i < inlets.b_n; ++i){
-                auto chn = inlets.b_signals[i];
-                std::copy(chn, chn + n, (t_sample *)inlets.b_buffers[i]);
+                kernels::copy((t_sample *)inlets.b_buffers[i], inlets.b_signals[i], n);
             }
         }
         // now copy inlets to corresponding outlets
@@ -3894,24 +4628,29 @@ static t_int *vstplugin_perform(t_int *w){
                 for (int j = 0; j < outlets.b_n; ++j){
                     if (j < inlets.b_n){
                         // copy buffer to outlet
-                        auto chn = (const t_sample *)inlets.b_buffers[j];
-                        std::copy(chn, chn + n, outlets.b_signals[j]);
+                        kernels::copy(outlets.b_signals[j], (const t_sample *)inlets.b_buffers[j], n);
                     } else {
                         // zero outlet
-                        auto chn = outlets.b_signals[j];
-                        std::fill(chn, chn + n, 0);
+                        kernels::clear(outlets.b_signals[j], n);
                     }
                 }
             } else {
                 // zero whole bus
                 for (int j = 0; j < outlets.b_n; ++j){
-                    auto chn = outlets.b_signals[j];
-                    std::fill(chn, chn + n, 0);
+                    kernels::clear(outlets.b_signals[j], n);
                 }
             }
         }
     }
 
+    if (x->x_fade && !x->x_fade->f_done){
+        if (x->x_fade->f_precision == ProcessPrecision::Double){
+            vstplugin_fade_mix<double>(x, n);
+        } else {
+            vstplugin_fade_mix<float>(x, n);
+        }
+    }
+
     x->x_editor->flush_queues();
 
     return (w+3);
@@ -4012,8 +4751,12 @@ static void vstplugin_channels(t_vstplugin *x, t_symbol *s, int argc, t_atom *ar
 /*-------------------------- dsp method ----------------------------*/
 
 static void vstplugin_dsp(t_vstplugin *x, t_signal **sp){
+    // the crossfade buffers and channel maps would be stale
+    vstplugin_fade_stop(x);
+
     int oldblocksize = std::exchange(x->x_blocksize, sp[0]->s_n);
     int oldsr = std::exchange(x->x_sr, sp[0]->s_sr);
+    x->x_dspload.setSampleRate(x->x_sr);
     int channels_changed = std::exchange(x->x_outchannels_changed, false);
 
     dsp_add(vstplugin_perform, 2, (t_int)x, (t_int)x->x_blocksize);
@@ -4077,7 +4820,7 @@ static void vstplugin_dsp(t_vstplugin *x, t_signal **sp){
         x->x_editor->defer_safe<false>([&](){
             x->setup_plugin(*x->x_plugin);
         }, x->x_uithread);
-        if (x->x_threaded && (x->x_blocksize != oldblocksize)){
+        if ((x->x_threaded || x->x_reblocksize > 0) && (x->x_blocksize != oldblocksize)){
             // queue(!) latency change notification
             x->x_editor->latencyChanged(x->x_plugin->getLatencySamples());
         }
@@ -4088,11 +4831,130 @@ static void vstplugin_dsp(t_vstplugin *x, t_signal **sp){
 
 /*-------------------------- global methods ----------------------------*/
 
-void vstplugin_dsp_threads(t_vstplugin *x, t_floatarg f) {
+// parse a single CPU index (float) or a CPU range (symbol, e.g. "2-5")
+static bool parse_cpus(const t_atom *a, std::vector<int>& cpus) {
+    if (a->a_type == A_FLOAT) {
+        cpus.push_back(a->a_w.w_float);
+        return true;
+    } else if (a->a_type == A_SYMBOL) {
+        int first, last;
+        if (sscanf(a->a_w.w_symbol->s_name, "%d-%d", &first, &last) == 2 && first <= last) {
+            for (int i = first; i <= last; ++i) {
+                cpus.push_back(i);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void vstplugin_dsp_threads(t_vstplugin *x, t_symbol *s, int argc, t_atom *argv) {
+    DSPThreadAffinity affinity;
+    bool have_affinity = false;
+    t_float wait_spin = 0, wait_yield = 0;
+    bool have_wait = false, adaptive = false;
+    while (argc && argv->a_type == A_SYMBOL){
+        auto flag = argv->a_w.w_symbol->s_name;
+        if (*flag == '-'){
+            if (!strcmp(flag, "-s")){
+                argc--; argv++;
+                if (argc > 0 && argv->a_type == A_SYMBOL){
+                    auto name = argv->a_w.w_symbol->s_name;
+                    if (!strcmp(name, "shared")){
+                        setDSPScheduler(DSPScheduler::Shared);
+                    } else if (!strcmp(name, "roundrobin")){
+                        setDSPScheduler(DSPScheduler::RoundRobin);
+                    } else if (!strcmp(name, "affinity")){
+                        setDSPScheduler(DSPScheduler::Affinity);
+                    } else {
+                        pd_error(x, "%s: unknown scheduler '%s'", classname(x), name);
+                        return;
+                    }
+                } else {
+                    pd_error(x, "%s: missing argument for -s flag", classname(x));
+                    return;
+                }
+            } else if (!strcmp(flag, "-c") || !strcmp(flag, "-x")){
+                auto& cpus = (flag[1] == 'c') ? affinity.cpus : affinity.exclude;
+                argc--; argv++;
+                if (!(argc > 0 && parse_cpus(argv, cpus))){
+                    pd_error(x, "%s: missing or bad argument for %s flag", classname(x), flag);
+                    return;
+                }
+                have_affinity = true;
+            } else if (!strcmp(flag, "-p")){
+                affinity.skipSMT = true;
+                have_affinity = true;
+            } else if (!strcmp(flag, "-N")){
+                affinity.numaPools = true;
+                have_affinity = true;
+            } else if (!strcmp(flag, "-n")){
+                argc--; argv++;
+                if (argc > 0 && argv->a_type == A_FLOAT){
+                    affinity.numaNode = argv->a_w.w_float;
+                } else {
+                    pd_error(x, "%s: missing argument for -n flag", classname(x));
+                    return;
+                }
+                have_affinity = true;
+            } else if (!strcmp(flag, "-w")){
+                if (argc > 2 && argv[1].a_type == A_FLOAT && argv[2].a_type == A_FLOAT){
+                    wait_spin = argv[1].a_w.w_float;
+                    wait_yield = argv[2].a_w.w_float;
+                    argc -= 2; argv += 2;
+                } else {
+                    pd_error(x, "%s: missing arguments for -w flag", classname(x));
+                    return;
+                }
+                have_wait = true;
+            } else if (!strcmp(flag, "-a")){
+                adaptive = true;
+            } else {
+                pd_error(x, "%s: unknown flag '%s'", classname(x), flag);
+                return;
+            }
+            argv++; argc--;
+        } else {
+            break;
+        }
+    }
+    if (have_affinity){
+        setDSPThreadAffinity(affinity);
+    }
+    if (have_wait){
+        // -w is in milliseconds resp. percent of the block period (-a)
+        auto scale = adaptive ? 0.01 : 0.001;
+        setDSPWaitPolicy(wait_spin * scale, wait_yield * scale, adaptive);
+    } else if (adaptive){
+        pd_error(x, "%s: -a flag requires -w flag", classname(x));
+    }
+    t_float f = atom_getfloatarg(0, argc, argv);
     int numthreads = f > 0 ? f : 0;
     setNumDSPThreads(numthreads);
 }
 
+void vstplugin_dsp_wait_stats(t_vstplugin *x, t_symbol *s, int argc, t_atom *argv) {
+    bool reset = argc > 0 && atom_getsymbol(argv) == gensym("reset");
+    auto stats = getDSPWaitStats(reset);
+    t_atom msg[3];
+    SETFLOAT(&msg[0], stats.spins);
+    SETFLOAT(&msg[1], stats.yields);
+    SETFLOAT(&msg[2], stats.sleeps);
+    outlet_anything(x->x_messout, gensym("dsp_wait_stats"), 3, msg);
+}
+
+void vstplugin_bridge_pool(t_vstplugin *x, t_floatarg f) {
+    setBridgePoolSize(f > 0 ? f : 0);
+}
+
+void vstplugin_bridge_spin(t_vstplugin *x, t_floatarg f) {
+    setBridgeSpinCount(f > 0 ? f : 0);
+}
+
+void vstplugin_module_cache(t_vstplugin *x, t_floatarg f) {
+    setModuleCacheSize(f > 0 ? f : 0);
+}
+
 /*-------------------------- private methods ---------------------------*/
 
 void vstplugin_multichannel(t_vstplugin *x)
@@ -4153,11 +5015,16 @@ EXPORT void vstplugin_tilde_setup(void) {
     class_addmethod(vstplugin_class, (t_method)vstplugin_cache_clear, gensym("search_clear"), A_DEFFLOAT, A_NULL); // deprecated
     class_addmethod(vstplugin_class, (t_method)vstplugin_cache_clear, gensym("cache_clear"), A_DEFFLOAT, A_NULL);
     class_addmethod(vstplugin_class, (t_method)vstplugin_cache_read, gensym("cache_read"), A_DEFSYM, A_NULL);
-    class_addmethod(vstplugin_class, (t_method)vstplugin_plugin_list, gensym("plugin_list"), A_NULL);
+    class_addmethod(vstplugin_class, (t_method)vstplugin_cache_export, gensym("cache_export"), A_SYMBOL, A_NULL);
+    class_addmethod(vstplugin_class, (t_method)vstplugin_plugin_list, gensym("plugin_list"), A_GIMME, A_NULL);
 
     class_addmethod(vstplugin_class, (t_method)vstplugin_bypass, gensym("bypass"), A_FLOAT, A_NULL);
+    class_addmethod(vstplugin_class, (t_method)vstplugin_silence, gensym("silence"), A_FLOAT, A_NULL);
+    class_addmethod(vstplugin_class, (t_method)vstplugin_coalesce, gensym("coalesce"), A_FLOAT, A_NULL);
+    class_addmethod(vstplugin_class, (t_method)vstplugin_crossfade, gensym("crossfade"), A_FLOAT, A_NULL);
     class_addmethod(vstplugin_class, (t_method)vstplugin_reset, gensym("reset"), A_DEFFLOAT, A_NULL);
     class_addmethod(vstplugin_class, (t_method)vstplugin_offline, gensym("offline"), A_FLOAT, A_NULL);
+    class_addmethod(vstplugin_class, (t_method)vstplugin_cpu, gensym("cpu"), A_GIMME, A_NULL);
     class_addmethod(vstplugin_class, (t_method)vstplugin_vis, gensym("vis"), A_FLOAT, A_NULL);
     class_addmethod(vstplugin_class, (t_method)vstplugin_pos, gensym("pos"), A_FLOAT, A_FLOAT, A_NULL);
     class_addmethod(vstplugin_class, (t_method)vstplugin_size, gensym("size"), A_FLOAT, A_FLOAT, A_NULL);
@@ -4227,8 +5094,17 @@ EXPORT void vstplugin_tilde_setup(void) {
     class_addmethod(vstplugin_class, (t_method)vstplugin_preset_data_get<BANK>, gensym("bank_data_get"), A_NULL);
     class_addmethod(vstplugin_class, (t_method)vstplugin_preset_read<BANK>, gensym("bank_read"), A_SYMBOL, A_DEFFLOAT, A_NULL);
     class_addmethod(vstplugin_class, (t_method)vstplugin_preset_write<BANK>, gensym("bank_write"), A_SYMBOL, A_DEFFLOAT, A_NULL);
+    // snapshots
+    class_addmethod(vstplugin_class, (t_method)vstplugin_snapshot_save, gensym("snapshot_save"), A_FLOAT, A_NULL);
+    class_addmethod(vstplugin_class, (t_method)vstplugin_snapshot_recall, gensym("snapshot_recall"), A_FLOAT, A_DEFFLOAT, A_NULL);
+    class_addmethod(vstplugin_class, (t_method)vstplugin_snapshot_morph, gensym("snapshot_morph"), A_FLOAT, A_FLOAT, A_FLOAT, A_NULL);
+    class_addmethod(vstplugin_class, (t_method)vstplugin_snapshot_clear, gensym("snapshot_clear"), A_GIMME, A_NULL);
     // global messages
-    class_addmethod(vstplugin_class, (t_method)vstplugin_dsp_threads, gensym("dsp_threads"), A_DEFFLOAT, A_NULL);
+    class_addmethod(vstplugin_class, (t_method)vstplugin_dsp_threads, gensym("dsp_threads"), A_GIMME, A_NULL);
+    class_addmethod(vstplugin_class, (t_method)vstplugin_dsp_wait_stats, gensym("dsp_wait_stats"), A_GIMME, A_NULL);
+    class_addmethod(vstplugin_class, (t_method)vstplugin_bridge_pool, gensym("bridge_pool"), A_FLOAT, A_NULL);
+    class_addmethod(vstplugin_class, (t_method)vstplugin_bridge_spin, gensym("bridge_spin"), A_FLOAT, A_NULL);
+    class_addmethod(vstplugin_class, (t_method)vstplugin_module_cache, gensym("module_cache"), A_FLOAT, A_NULL);
     // private messages
     class_addmethod(vstplugin_class, (t_method)vstplugin_preset_change, gensym("preset_change"), A_SYMBOL, A_NULL);
     class_addmethod(vstplugin_class, (t_method)vstplugin_multichannel, gensym("multichannel"), A_NULL);
@@ -4,10 +4,15 @@
 
 #include "Interface.h"
 #include "PluginDictionary.h"
+#include "SearchEngine.h"
 #include "Lockfree.h"
 #include "Log.h"
 #include "Bus.h"
 #include "FileUtils.h"
+#include "Kernels.h"
+#include "DSPLoad.h"
+#include "Reblocker.h"
+#include "Snapshot.h"
 #include "MiscUtils.h"
 #include "Sync.h"
 #include "CpuArch.h"
@@ -27,6 +32,7 @@ using namespace vst;
 #include <type_traits>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <fcntl.h>
 
 // only try to poll event loop for macOS Pd standalone version
@@ -79,10 +85,48 @@ struct t_search_data : t_command_data<t_search_data> {
     std::string cachefiledir;
     float timeout;
     bool parallel;
+    bool incremental;
     bool update;
     std::atomic_bool cancel {false};
 };
 
+// plugin processing setup, computed by t_vstplugin::configure_plugin().
+// NOTE: this is kept separately from t_vstplugin, so that a new plugin can be
+// set up in the background while the current plugin is still running.
+struct t_plugin_setup {
+    ProcessPrecision s_precision = ProcessPrecision::Single;
+    bool s_process = false;
+    std::vector<Bus> s_inputs;
+    std::vector<Bus> s_outputs;
+    int s_input_channels = 0;
+    int s_output_channels = 0;
+    // only used by vstplugin_open_do()
+    t_float s_samplerate = 0;
+    int s_blocksize = 0;
+};
+
+// crossfade from the previous plugin after reopening, see "crossfade" method.
+// The plugin processes the inlets into its own buffers until the fade
+// has finished and is then released like in vstplugin_close().
+struct t_fade {
+    IPlugin::ptr f_plugin;
+    bool f_async = false;
+    bool f_uithread = false;
+    ProcessPrecision f_precision = ProcessPrecision::Single;
+    std::vector<Bus> f_inputs;
+    std::vector<Bus> f_outputs;
+    // inlet resp. outlet (bus, channel) for each (flat) plugin channel; -1: none
+    std::vector<std::pair<int, int>> f_inmap;
+    std::vector<std::vector<int>> f_outmap; // outlet channel -> plugin channel
+    std::vector<char> f_buffer;
+    void *f_scratch = nullptr; // for converting to t_sample
+    int f_length = 0; // in samples
+    int f_pos = 0;
+    // set by the perform routine when the fade has finished;
+    // the plugin is released in x_fadeclock, see vstplugin_fade_tick()
+    bool f_done = false;
+};
+
 // vstplugin~ object (everything public and no virtual methods!)
 class t_vstplugin {
 public:
@@ -123,6 +167,10 @@ public:
     int x_output_channels = 0;
     std::vector<char> x_inbuffer;
     std::vector<char> x_outbuffer;
+    bool x_direct_inputs = false; // pass inlet signals directly, see update_buffers()
+    // reblocking, see "-B" flag
+    int x_reblocksize = 0; // 0: use Pd's block size
+    Reblocker x_reblocker;
     // VST plugin
     IPlugin::ptr x_plugin;
     std::unique_ptr<t_vsteditor> x_editor;
@@ -135,7 +183,19 @@ public:
     bool x_threaded = false;
     bool x_keep = false;
     bool x_suspended = false;
+    bool x_loading = false; // asynchronous "open" in progress
+    // crossfade on reopening, see "crossfade" method
+    t_float x_fadetime = 0; // ms
+    std::unique_ptr<t_fade> x_fade;
+    t_clock *x_fadeclock = nullptr;
     Bypass x_bypass = Bypass::Off;
+    SilenceMode x_silence = SilenceMode::Off;
+    bool x_coalesce = false;
+    SnapshotStore x_snapshots;
+    // DSP load metering, see "cpu" method
+    DSPLoadMeter x_dspload;
+    bool x_dspload_enabled = false;
+    bool x_dspload_host = false; // measure in the perform routine
     ProcessPrecision x_wantprecision; // single/double precision
     ProcessPrecision x_realprecision;
     ProcessMode x_mode = ProcessMode::Realtime;
@@ -157,10 +217,27 @@ public:
 
     void setup_plugin(IPlugin& plugin);
 
+    void configure_plugin(IPlugin& plugin, t_plugin_setup& setup) const;
+
+    void apply_setup(t_plugin_setup&& setup);
+
     void update_buffers();
 
+    void setup_dspload();
+
     int get_sample_offset();
 
+    bool reblocking() const {
+        return x_reblocksize > 0 && x_reblocksize != x_blocksize;
+    }
+
+    int plugin_blocksize() const {
+        return x_reblocksize > 0 ? x_reblocksize : x_blocksize;
+    }
+
+    // additional latency caused by threading and/or reblocking
+    int extra_latency() const;
+
     std::string resolve_plugin_path(const char *s);
 
     bool deferred() const {
@@ -294,6 +371,9 @@ private:
     int e_param_bitset_size = 0;
 };
 
+// Runs asynchronous commands on a small pool of worker threads.
+// Commands of the same owner are executed in order, commands of
+// different owners can run concurrently.
 class t_workqueue {
 public:
     template<typename T>
@@ -334,15 +414,24 @@ private:
     };
     void dopush(void *owner, void *data, t_fun<void> workfn,
                 t_fun<void> cb, t_fun<void> cleanup);
-    // queues from RT to NRT
-    UnboundedMPSCQueue<t_item> w_nrt_queue;
+    void run(); // worker thread function
+    static constexpr int max_num_workers = 8;
+    // pending commands of a single owner
+    struct t_owner {
+        std::deque<t_item> items;
+        bool busy = false; // a command is currently running
+    };
+    // NB: the following members are protected by w_mutex
+    std::unordered_map<void *, t_owner> w_owners;
+    std::deque<void *> w_ready; // owners with pending commands which are not busy
+    bool w_running = true;
+    std::mutex w_mutex;
+    std::condition_variable w_cond; // wake up workers
+    std::condition_variable w_done; // a command has finished, see cancel()
     // queue from NRT to RT
     UnboundedMPSCQueue<t_item> w_rt_queue;
-    // worker thread
-    std::thread w_thread;
-    std::mutex w_mutex; // for cancellation
-    Event w_event;
-    std::atomic<bool> w_running{false};
+    // worker threads
+    std::vector<std::thread> w_threads;
     // logging
     struct t_logmsg {
         PdLogLevel level;
@@ -99,7 +99,7 @@ VSTPlugin : MultiOutUGen {
 		{ this.prSearchRemote(server, dir, options, verbose, wait, action) };
 	}
 	*searchMsg { arg dir, options, verbose=false, dest=nil;
-		var flags = 0, timeout, save = true, parallel = true, exclude, cacheFileDir;
+		var flags = 0, timeout, save = true, parallel = true, incremental = false, exclude, cacheFileDir;
 		// search directories
 		dir.isString.if { dir = [dir] };
 		(dir.isNil or: dir.isArray).not.if { MethodError("bad type % for 'dir' argument!".format(dir.class), this).throw };
@@ -116,6 +116,7 @@ VSTPlugin : MultiOutUGen {
 				switch(key,
 					\save, { save = value.asBoolean },
 					\parallel, { parallel = value.asBoolean },
+					\incremental, { incremental = value.asBoolean },
 					\timeout, { timeout = value !? { value.asFloat } },
 					\exclude, { exclude = value },
 					\cacheFileDir, { cacheFileDir = value },
@@ -129,7 +130,7 @@ VSTPlugin : MultiOutUGen {
 		exclude = exclude.collect({ arg p; p.asString.standardizePath });
 		cacheFileDir = cacheFileDir !? [cacheFileDir];
 		// make flag from options
-		flags = [verbose, save, parallel].sum { arg x, i; x.asInteger << i };
+		flags = [verbose, save, parallel, incremental].sum { arg x, i; x.asInteger << i };
 		dest = this.prMakeDest(dest); // nil -> -1 = don't write results
 		^['/cmd', '/vst_search', flags, dest, timeout ?? 0.0, dir.size] ++ dir ++ exclude.size ++ exclude ++ cacheFileDir
 	}
@@ -380,16 +381,76 @@ VSTPlugin : MultiOutUGen {
 		^-1; // invalid bufnum: don't write results
 	}
 
-	*initDSPThreads { arg server, numThreads;
+	*initDSPThreads { arg server, numThreads, scheduler, affinity, wait;
 		server = server ?? Server.default;
 		server.serverRunning.not.if {
 			"VSTPlugin.initDSPThreads requires the Server to be running!".warn;
 			^this;
 		};
-		server.listSendMsg(this.initDSPThreadsMsg(numThreads));
+		server.listSendMsg(this.initDSPThreadsMsg(numThreads, scheduler, affinity, wait));
+	}
+	*initDSPThreadsMsg { arg numThreads, scheduler, affinity, wait;
+		var msg = ['/cmd', '/vst_dsp_threads', numThreads ?? 0 ];
+		scheduler.notNil.if {
+			var index = [\shared, \roundrobin, \affinity].indexOf(scheduler.asSymbol);
+			index ?? { MethodError("unknown scheduler '%'".format(scheduler), this).throw };
+			msg = msg.add(index);
+		} { msg = msg.add(-1) };
+		wait.notNil.if {
+			msg = msg ++ [wait[\adaptive].asBoolean.asInteger,
+				(wait[\spin] ?? 0).asFloat, (wait[\yield] ?? 0).asFloat];
+		} { msg = msg.add(-1) };
+		affinity !? {
+			var cpus = affinity[\cpus].asArray, exclude = affinity[\exclude].asArray;
+			msg = msg ++ [affinity[\physical].asBoolean.asInteger, affinity[\node] ?? -1,
+				cpus.size] ++ cpus ++ [exclude.size] ++ exclude
+				++ [affinity[\pools].asBoolean.asInteger];
+		};
+		^msg;
+	}
+	*initBridgePool { arg server, size;
+		server = server ?? Server.default;
+		server.serverRunning.not.if {
+			"VSTPlugin.initBridgePool requires the Server to be running!".warn;
+			^this;
+		};
+		server.listSendMsg(this.initBridgePoolMsg(size));
+	}
+	*initBridgePoolMsg { arg size;
+		^['/cmd', '/vst_bridge_pool', size ?? 0 ];
+	}
+	*initBridgeSpin { arg server, count;
+		server = server ?? Server.default;
+		server.serverRunning.not.if {
+			"VSTPlugin.initBridgeSpin requires the Server to be running!".warn;
+			^this;
+		};
+		server.listSendMsg(this.initBridgeSpinMsg(count));
+	}
+	*initBridgeSpinMsg { arg count;
+		^['/cmd', '/vst_bridge_spin', count ?? 0 ];
+	}
+	*initModuleCache { arg server, size;
+		server = server ?? Server.default;
+		server.serverRunning.not.if {
+			"VSTPlugin.initModuleCache requires the Server to be running!".warn;
+			^this;
+		};
+		server.listSendMsg(this.initModuleCacheMsg(size));
+	}
+	*initModuleCacheMsg { arg size;
+		^['/cmd', '/vst_module_cache', size ?? 8 ];
+	}
+	*initAsyncThreads { arg server, numThreads;
+		server = server ?? Server.default;
+		server.serverRunning.not.if {
+			"VSTPlugin.initAsyncThreads requires the Server to be running!".warn;
+			^this;
+		};
+		server.listSendMsg(this.initAsyncThreadsMsg(numThreads));
 	}
-	*initDSPThreadsMsg { arg numThreads;
-		^['/cmd', '/vst_dsp_threads', numThreads ?? 0 ];
+	*initAsyncThreadsMsg { arg numThreads;
+		^['/cmd', '/vst_async_threads', numThreads ?? 0 ];
 	}
 
 	// instance methods
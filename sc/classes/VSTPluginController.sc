@@ -466,6 +466,51 @@ VSTPluginController {
 	resetMsg { arg async = false;
 		^this.makeMsg('/reset', async.asInteger);
 	}
+	// 0: off, 1: detect silent input (VST3), 2: sleep while idle
+	silence { arg mode = 0;
+		this.sendMsg('/silence', mode.asInteger);
+	}
+	silenceMsg { arg mode = 0;
+		^this.makeMsg('/silence', mode.asInteger);
+	}
+	// only send the last parameter change per block (threaded/bridged plugins)
+	coalesce { arg bool = true;
+		this.sendMsg('/coalesce', bool.asInteger);
+	}
+	coalesceMsg { arg bool = true;
+		^this.makeMsg('/coalesce', bool.asInteger);
+	}
+	// crossfade time (ms) when opening a new plugin while another plugin is running
+	crossfade { arg ms = 0;
+		this.sendMsg('/crossfade', ms.asFloat);
+	}
+	crossfadeMsg { arg ms = 0;
+		^this.makeMsg('/crossfade', ms.asFloat);
+	}
+	cpuMeter { arg bool = true;
+		this.sendMsg('/cpu_meter', bool.asInteger);
+	}
+	cpuMeterMsg { arg bool = true;
+		^this.makeMsg('/cpu_meter', bool.asInteger);
+	}
+	getCPULoad { arg action, reset = false;
+		this.prMakeOscFunc({ arg msg;
+			// last, average, peak (ms), load (%), wait (ms)
+			(msg.size > 3).if {
+				action.value(this, msg[3], msg[4], msg[5], msg[6], msg[7]);
+			} {
+				action.value(this);
+			};
+		}, '/vst_cpu').oneShot;
+		this.sendMsg('/cpu', reset.asInteger);
+	}
+	getDSPWaitStats { arg action, reset = false;
+		this.prMakeOscFunc({ arg msg;
+			// spins, yields, sleeps (global)
+			action.value(this, msg[3].asInteger, msg[4].asInteger, msg[5].asInteger);
+		}, '/vst_dsp_wait_stats').oneShot;
+		this.sendMsg('/dsp_wait_stats', reset.asInteger);
+	}
 	// deprecated
 	setOffline { arg bool;
 		this.deprecated(thisMethod);
@@ -575,6 +620,13 @@ VSTPluginController {
 	unmapMsg { arg ...args;
 		^this.makeMsg('/unmap', *args);
 	}
+	// decimate audio rate automation to every n-th sample (0: once per block)
+	automationInterval { arg samples = 16;
+		this.sendMsg('/automation_interval', samples.asInteger);
+	}
+	automationIntervalMsg { arg samples = 16;
+		^this.makeMsg('/automation_interval', samples.asInteger);
+	}
 	// preset management
 	preset {
 		^currentPreset;
@@ -794,6 +846,40 @@ VSTPluginController {
 	writeBankMsg { arg dest, async=true;
 		^this.makeMsg('/bank_write', VSTPlugin.prMakeDest(dest), async.asInteger);
 	}
+	// snapshots
+	saveSnapshot { arg slot, action;
+		this.prMakeOscFunc({ arg msg;
+			var success = msg[3].asBoolean;
+			action.value(this, success);
+		}, '/vst_snapshot_save').oneShot;
+		this.sendMsg('/snapshot_save', slot.asInteger);
+	}
+	saveSnapshotMsg { arg slot;
+		^this.makeMsg('/snapshot_save', slot.asInteger);
+	}
+	recallSnapshot { arg slot, action, full=false;
+		this.prMakeOscFunc({ arg msg;
+			var success = msg[3].asBoolean;
+			action.value(this, success);
+			full.if { this.prQueryParams };
+		}, '/vst_snapshot_recall').oneShot;
+		this.sendMsg('/snapshot_recall', slot.asInteger, full.asInteger);
+	}
+	recallSnapshotMsg { arg slot, full=false;
+		^this.makeMsg('/snapshot_recall', slot.asInteger, full.asInteger);
+	}
+	morphSnapshots { arg slotA, slotB, x;
+		this.sendMsg('/snapshot_morph', slotA.asInteger, slotB.asInteger, x.asFloat);
+	}
+	morphSnapshotsMsg { arg slotA, slotB, x;
+		^this.makeMsg('/snapshot_morph', slotA.asInteger, slotB.asInteger, x.asFloat);
+	}
+	clearSnapshot { arg slot = -1;
+		this.sendMsg('/snapshot_clear', slot.asInteger);
+	}
+	clearSnapshotMsg { arg slot = -1;
+		^this.makeMsg('/snapshot_clear', slot.asInteger);
+	}
 	setProgramData { arg data, action, async=true;
 		this.prCheckLocal(thisMethod);
 		(data.class != Int8Array).if { MethodError("'%' expects Int8Array!".format(thisMethod.name), this).throw};
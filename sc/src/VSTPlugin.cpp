@@ -110,6 +110,7 @@ PresetCmdData* PresetCmdData::create(World* world, const char* path, bool async)
         data->bufnum = -1;
         memcpy(data->path, path, len);
         data->async = async;
+        data->offload = true; // doesn't touch any buffers
     }
     return data;
 }
@@ -198,6 +199,10 @@ static PluginDictionary gPluginDict;
 static std::string gSettingsDir = userSettingsPath() + "/sc";
 
 static std::string gCacheFileName = std::string("cache_")
+        + cpuArchToString(getHostCpuArchitecture()) + ".bin";
+
+// text cache file of previous versions, see readCacheFile()
+static std::string gTextCacheFileName = std::string("cache_")
         + cpuArchToString(getHostCpuArchitecture()) + ".ini";
 
 static Mutex gFileLock;
@@ -205,17 +210,28 @@ static Mutex gFileLock;
 static void readCacheFile(const std::string& dir, bool loud) {
     std::lock_guard lock(gFileLock);
     auto path = dir + "/" + gCacheFileName;
-    if (pathExists(path)){
-        LOG_VERBOSE("read cache file " << path);
+    // if there is no binary cache file yet, import the text cache file
+    auto textPath = dir + "/" + gTextCacheFileName;
+    bool convert = !pathExists(path) && pathExists(textPath);
+    if (convert || pathExists(path)){
+        auto& file = convert ? textPath : path;
+        LOG_VERBOSE("read cache file " << file);
         try {
-            gPluginDict.read(path);
+            gPluginDict.read(file, !convert);
+            if (convert) {
+                gPluginDict.write(path, PluginDictionary::CacheFormat::Binary);
+            }
         } catch (const Error& e){
             LOG_ERROR("couldn't read cache file: " << e.what());
         } catch (const std::exception& e){
             LOG_ERROR("couldn't read cache file: unexpected exception (" << e.what() << ")");
         }
-    } else if (loud) {
-        LOG_ERROR("could not find cache file in " << dir);
+    } else {
+        // the probe index might still exist
+        gPluginDict.readIndex(path);
+        if (loud) {
+            LOG_ERROR("could not find cache file in " << dir);
+        }
     }
 }
 
@@ -268,7 +284,9 @@ void serializePlugin(std::ostream& os, const PluginDesc& desc) {
 
 // load factory and probe plugins
 
-static IFactory::ptr loadFactory(const std::string& path, bool verbose = false){
+// 'retry': probe black-listed plugins, see PluginDictionary::retryException()
+static IFactory::ptr loadFactory(const std::string& path, bool verbose = false,
+                                 bool retry = false){
     IFactory::ptr factory;
     auto& dict = getPluginDict();
 
@@ -276,7 +294,7 @@ static IFactory::ptr loadFactory(const std::string& path, bool verbose = false){
         LOG_ERROR("bug in 'loadFactory'");
         return nullptr;
     }
-    if (dict.isException(path)) {
+    if (!retry && dict.isException(path)) {
         if (verbose) {
             Print("'%s' is black-listed.\n", path.c_str());
         }
@@ -288,7 +306,7 @@ static IFactory::ptr loadFactory(const std::string& path, bool verbose = false){
     } catch (const Error& e){
         // always print error
         LOG_ERROR("couldn't load '" << path << "': " << e.what());
-        dict.addException(path);
+        dict.addException(path, e.code());
         return nullptr;
     }
 
@@ -323,6 +341,7 @@ static void postResult(const Error& e){
         Print("crashed!\n");
         break;
     case Error::SystemError:
+    case Error::Timeout:
         Print("error! %s\n", e.what());
         break;
     case Error::ModuleError:
@@ -337,9 +356,17 @@ static void postResult(const Error& e){
     }
 }
 
-static IFactory::ptr probePlugin(const std::string& path,
-                                 float timeout, bool verbose) {
-    auto factory = loadFactory(path, verbose);
+// get the reason for black-listing a module; timeouts take precedence,
+// so that the module can be retried.
+static void updateErrorCode(Error::ErrorCode& code, const Error& error){
+    if (error.code() != Error::NoError && code != Error::Timeout){
+        code = error.code();
+    }
+}
+
+static IFactory::ptr probePlugin(const std::string& path, float timeout,
+                                 bool verbose, bool retry = false) {
+    auto factory = loadFactory(path, verbose, retry);
     if (!factory){
         return nullptr;
     }
@@ -348,8 +375,10 @@ static IFactory::ptr probePlugin(const std::string& path,
         Print("probing %s... ", path.c_str());
     }
 
+    auto code = Error::UnknownError;
     try {
         factory->probe([&](const ProbeResult& result) {
+            updateErrorCode(code, result.error);
             if (verbose) {
                 if (result.total > 1) {
                     if (result.index == 0) {
@@ -371,17 +400,18 @@ static IFactory::ptr probePlugin(const std::string& path,
         }
     } catch (const Error& e){
         if (verbose) postResult(e);
+        updateErrorCode(code, e);
     }
-    getPluginDict().addException(path);
+    getPluginDict().addException(path, code);
     return nullptr;
 }
 
 using FactoryFutureResult = std::pair<bool, IFactory::ptr>;
 using FactoryFuture = std::function<FactoryFutureResult()>;
 
-static FactoryFuture probePluginAsync(const std::string& path,
-                                      float timeout, bool verbose) {
-    auto factory = loadFactory(path, verbose);
+static FactoryFuture probePluginAsync(const std::string& path, float timeout,
+                                      bool verbose, bool retry = false) {
+    auto factory = loadFactory(path, verbose, retry);
     if (!factory){
         return []() -> FactoryFutureResult {
             return { true, nullptr };
@@ -391,9 +421,10 @@ static FactoryFuture probePluginAsync(const std::string& path,
     try {
         auto future = factory->probeAsync(timeout, true);
         // return future
-        return [=]() -> FactoryFutureResult {
+        return [=, code = Error::UnknownError]() mutable -> FactoryFutureResult {
             // wait for results
             bool done = future([&](const ProbeResult& result) {
+                updateErrorCode(code, result.error);
                 if (verbose) {
                     if (result.total > 1) {
                         // several subplugins
@@ -420,7 +451,7 @@ static FactoryFuture probePluginAsync(const std::string& path,
                     addFactory(path, factory);
                     return { true, factory }; // success
                 } else {
-                    getPluginDict().addException(path);
+                    getPluginDict().addException(path, code);
                     return { true, nullptr };
                 }
             } else {
@@ -434,7 +465,7 @@ static FactoryFuture probePluginAsync(const std::string& path,
                 Print("probing %s... ", path.c_str());
                 postResult(e);
             }
-            getPluginDict().addException(path);
+            getPluginDict().addException(path, e.code());
             return { true, nullptr };
         };
     }
@@ -501,11 +532,18 @@ static const PluginDesc* queryPlugin(const std::string& path) {
             LOG_WARNING("'" << path << "' is neither an existing plugin name nor a valid file path.");
         }
     }
+    if (desc) {
+        // make sure that the plugin info is available, see PluginDesc::loadTables()
+        try {
+            desc->loadTables();
+        } catch (const Error& e) {
+            LOG_ERROR(e.what());
+            return nullptr;
+        }
+    }
     return desc.get();
 }
 
-#define PROBE_FUTURES 8
-
 #if WARN_VST3_PARAMETERS
 // HACK
 static thread_local std::vector<PluginDesc::const_ptr> gWarnPlugins;
@@ -513,11 +551,15 @@ static thread_local std::vector<PluginDesc::const_ptr> gWarnPlugins;
 
 std::vector<PluginDesc::const_ptr> searchPlugins(const std::string& path,
                                                  const std::vector<std::string>& exclude,
-                                                 float timeout, bool parallel, bool verbose) {
+                                                 float timeout, bool parallel, bool incremental,
+                                                 bool verbose) {
     LOG_VERBOSE("searching in '" << path << "'...");
 
     std::vector<PluginDesc::const_ptr> results;
 
+    // publish all updates at the end of the search
+    PluginDictionary::UpdateScope scope(getPluginDict());
+
     auto addPlugin = [&](PluginDesc::const_ptr plugin, int which = 0, int n = 0){
         if (verbose && n > 0) {
             Print("\t[%d/%d] %s\n", which + 1, n, plugin->name.c_str());
@@ -525,56 +567,36 @@ std::vector<PluginDesc::const_ptr> searchPlugins(const std::string& path,
         results.push_back(plugin);
     };
 
-    std::vector<std::pair<FactoryFuture, std::string>> futures;
-
-    auto last = std::chrono::system_clock::now();
-
-    auto processFutures = [&](int limit){
-        while (futures.size() > limit){
-            bool didSomething = false;
-            for (auto it = futures.begin(); it != futures.end(); ){
-                if (auto [done, factory] = it->first(); done) {
-                    // future finished
-                    if (factory){
-                        for (int i = 0; i < factory->numPlugins(); ++i){
-                            auto plugin = factory->getPlugin(i);
-                            addPlugin(plugin);
-                        #if WARN_VST3_PARAMETERS
-                            if (plugin->warnParameters) {
-                                gWarnPlugins.push_back(plugin);
-                            }
-                        #endif
-                        }
-                    }
-                    // remove future
-                    it = futures.erase(it);
-                    didSomething = true;
-                } else {
-                    it++;
-                }
-            }
-            auto now = std::chrono::system_clock::now();
-            if (didSomething){
-                last = now;
-            } else {
-                using seconds = std::chrono::duration<double>;
-                auto elapsed = std::chrono::duration_cast<seconds>(now - last).count();
-                if (elapsed > 4.0){
-                    for (auto& x : futures){
-                        LOG_VERBOSE("waiting for '" << x.second << "'...");
-                    }
-                    last = now;
-                }
+    auto addFactoryPlugins = [&](IFactory::ptr factory){
+        for (int i = 0; i < factory->numPlugins(); ++i){
+            auto plugin = factory->getPlugin(i);
+            addPlugin(plugin);
+        #if WARN_VST3_PARAMETERS
+            if (plugin->warnParameters) {
+                gWarnPlugins.push_back(plugin);
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        #endif
         }
     };
 
+    // with 'parallel' we probe as many plugins at once as we have CPUs
+    SearchEngine engine(parallel ? 0 : 1);
+
+    engine.setWaitCallback([](const std::string& pluginPath){
+        LOG_VERBOSE("waiting for '" << pluginPath << "'...");
+    });
+
     auto& dict = getPluginDict();
 
-    vst::search(path, [&](const std::string & absPath) {
-        if (!gSearching){
-            return;
+    // stop the directory traversal as soon as possible
+    engine.setCancelCallback([](){ return !gSearching; });
+
+    // black-listed plugins which have timed out, see PluginDictionary::retryException()
+    std::vector<std::string> retryList;
+
+    engine.search(path, [&](const std::string & absPath) -> SearchEngine::Job {
+        if (engine.cancelled()){
+            return nullptr;
         }
         std::string pluginPath = absPath;
 #ifdef _WIN32
@@ -603,29 +625,64 @@ std::vector<PluginDesc::const_ptr> searchPlugins(const std::string& path,
                 auto plugin = factory->getPlugin(i);
                 dict.addPlugin(plugin->key(), plugin);
             }
-        } else {
+            return nullptr;
+        } else if (incremental && !dict.isException(pluginPath)) {
+            // try to restore unchanged (or moved) plugins from the probe index
+            if (auto factory = dict.restoreFactory(pluginPath)) {
+                LOG_DEBUG("restored '" << pluginPath << "' from probe index");
+                addFactory(pluginPath, factory);
+                addFactoryPlugins(factory);
+                return nullptr;
+            }
+        }
+        bool retry = false;
+        if (dict.isException(pluginPath)) {
+            switch (dict.retryException(pluginPath)) {
+            case PluginDictionary::Retry::Now:
+                retry = true; // the plugin has changed
+                break;
+            case PluginDictionary::Retry::Later:
+                retryList.push_back(pluginPath);
+                return nullptr;
+            default:
+                if (verbose) {
+                    Print("'%s' is black-listed.\n", pluginPath.c_str());
+                }
+                return nullptr;
+            }
+        }
+        if (parallel){
             // probe (will post results and add plugins)
-            if (parallel){
-                futures.emplace_back(probePluginAsync(pluginPath, timeout, verbose), pluginPath);
-                processFutures(PROBE_FUTURES);
-            } else {
-                if (auto factory = probePlugin(pluginPath, timeout, verbose)) {
-                    int numPlugins = factory->numPlugins();
-                    for (int i = 0; i < numPlugins; ++i) {
-                        auto plugin = factory->getPlugin(i);
-                        addPlugin(plugin);
-                    #if WARN_VST3_PARAMETERS
-                        if (plugin->warnParameters) {
-                            gWarnPlugins.push_back(plugin);
-                        }
-                    #endif
+            return [&addFactoryPlugins, future = probePluginAsync(pluginPath, timeout, verbose, retry)](){
+                if (auto [done, factory] = future(); done) {
+                    if (factory){
+                        addFactoryPlugins(factory);
                     }
+                    return true;
+                } else {
+                    return false;
                 }
+            };
+        } else {
+            if (auto factory = probePlugin(pluginPath, timeout, verbose, retry)) {
+                addFactoryPlugins(factory);
             }
+            return nullptr;
         }
     }, true, exclude);
 
-    processFutures(0);
+    // probe plugins which have timed out in a previous search again, with a longer timeout
+    float retryTimeout = timeout * PROBE_RETRY_TIMEOUT_FACTOR;
+    for (auto& pluginPath : retryList) {
+        if (engine.cancelled()) {
+            break;
+        }
+        LOG_VERBOSE("retrying '" << pluginPath << "' with a timeout of "
+                    << retryTimeout << " seconds");
+        if (auto factory = probePlugin(pluginPath, retryTimeout, verbose, true)) {
+            addFactoryPlugins(factory);
+        }
+    }
 
     int numResults = results.size();
     if (numResults == 1){
@@ -647,6 +704,7 @@ thread_local bool gCurrentThreadRT;
 // this is simpler and faster than saving and checking thread IDs.
 void setCurrentThreadRT() {
     gCurrentThreadRT = true;
+    setLogThreadRealtime(true); // see Log.h
 }
 
 bool isCurrentThreadRT() {
@@ -766,12 +824,12 @@ VSTPlugin::VSTPlugin(){
     }
 
     // create reblocker (if needed)
-    if (valid() && reblockSize > bufferSize()){
+    if (valid() && reblockSize > 0 && reblockSize != bufferSize()){
         initReblocker(reblockSize);
     }
 
     // create dummy input/output buffer
-    size_t dummyBlocksize = reblock_ ? reblock_->blockSize : bufferSize();
+    size_t dummyBlocksize = blockSize();
     auto dummyBufsize = dummyBlocksize * 2 * sizeof(float);
     dummyBuffer_ = (float *)RTAlloc(mWorld, dummyBufsize);
     if (dummyBuffer_){
@@ -837,6 +895,9 @@ VSTPlugin::~VSTPlugin(){
 
     freeReblocker();
 
+    // release the previous plugin (if crossfading)
+    delegate_->stopFade();
+
     // tell the delegate that we've been destroyed!
     delegate_->setOwner(nullptr);
     delegate_ = nullptr; // release our reference
@@ -993,8 +1054,9 @@ void VSTPlugin::initReblocker(int reblockSize){
     if (reblock_){
         memset(reblock_, 0, sizeof(Reblock)); // init!
 
-        // make sure that block size is power of 2
-        reblock_->blockSize = NEXTPOWEROFTWO(reblockSize);
+        // NB: the block size can be arbitrary, see Reblocker
+        reblock_->reblocker.init(reblockSize, bufferSize());
+        int blockSize = reblock_->reblocker.blockSize();
 
         // allocate input/output busses
         // NOTE: we always have at least one input and output bus!
@@ -1030,7 +1092,7 @@ void VSTPlugin::initReblocker(int reblockSize){
         }
 
         // allocate buffer
-        int bufsize = sizeof(float) * totalNumChannels * reblock_->blockSize;
+        int bufsize = sizeof(float) * totalNumChannels * blockSize;
         reblock_->buffer = (float *)RTAlloc(mWorld, bufsize);
 
         if (reblock_->buffer){
@@ -1055,13 +1117,9 @@ void VSTPlugin::initReblocker(int reblockSize){
                 }
                 return true;
             };
-            if (initBusses(reblock_->inputs, reblock_->numInputs, reblock_->blockSize)
-                && initBusses(reblock_->outputs, reblock_->numOutputs, reblock_->blockSize))
+            if (!(initBusses(reblock_->inputs, reblock_->numInputs, blockSize)
+                  && initBusses(reblock_->outputs, reblock_->numOutputs, blockSize)))
             {
-                // start phase at one block before end, so that the first call
-                // to the perform routine will trigger plugin processing.
-                reblock_->phase = reblock_->blockSize - bufferSize();
-            } else {
                 LOG_ERROR("RTAlloc failed!");
                 freeReblocker();
             }
@@ -1074,27 +1132,77 @@ void VSTPlugin::initReblocker(int reblockSize){
     }
 }
 
-bool VSTPlugin::updateReblocker(int numSamples){
-    // read input
-    for (int i = 0; i < numUgenInputs_; ++i){
-        auto& inputs = ugenInputs_[i];
-        auto reblockInputs = reblock_->inputs[i].channelData;
-        for (int j = 0; j < inputs.numChannels; ++j){
-            auto src = inputs.channelData[j];
-            auto dst = reblockInputs[j] + reblock_->phase;
-            std::copy(src, src + numSamples, dst);
-        }
+void VSTPlugin::processPlugin(IPlugin *plugin, ProcessData& data){
+    auto& delegate = this->delegate();
+    if (delegate.measureDSPLoad()){
+        auto start = DSPLoadMeter::clock::now();
+        plugin->process(data);
+        delegate.dspLoadMeter().addProcessTime(DSPLoadMeter::elapsed(start), data.numSamples);
+    } else {
+        plugin->process(data);
     }
+}
 
-    reblock_->phase += numSamples;
+// process with the reblocker; if 'plugin' is NULL, we bypass.
+void VSTPlugin::performReblock(IPlugin *plugin, ProcessData *data, int numSamples){
+    auto& reblocker = reblock_->reblocker;
+    auto reblockInputs = reblock_->inputs;
+    auto reblockOutputs = reblock_->outputs;
+    // when bypassing, the plugin outputs are not touched
+    int numOutputs = plugin ? std::min(numUgenOutputs_, numPluginOutputs_) : 0;
 
-    if (reblock_->phase >= reblock_->blockSize){
-        assert(reblock_->phase == reblock_->blockSize);
-        reblock_->phase = 0;
-        return true;
-    } else {
-        return false;
-    }
+    reblocker.perform(numSamples, [&](int phase, int offset, int n){
+        // write reblocker input
+        for (int i = 0; i < numUgenInputs_; ++i){
+            auto& inputs = ugenInputs_[i];
+            for (int j = 0; j < inputs.numChannels; ++j){
+                auto src = inputs.channelData[j] + offset;
+                auto dst = reblockInputs[i].channelData[j] + phase;
+                kernels::copy(dst, src, n);
+            }
+        }
+    }, [&](int phase, int offset, int n){
+        if (plugin){
+            // read reblocker output
+            for (int i = 0; i < numOutputs; ++i){
+                int ugenChannels = ugenOutputs_[i].numChannels;
+                int pluginChannels = pluginOutputs_[i].numChannels;
+                for (int j = 0; j < ugenChannels && j < pluginChannels; ++j){
+                    auto src = reblockOutputs[i].channelData[j] + phase;
+                    auto dst = ugenOutputs_[i].channelData[j] + offset;
+                    kernels::copy(dst, src, n);
+                }
+            }
+        } else {
+            // NB: without plugin, the output FIFO contains a copy of the input.
+            for (int i = 0; i < numUgenOutputs_; ++i){
+                auto& outputs = ugenOutputs_[i];
+                for (int j = 0; j < outputs.numChannels; ++j){
+                    auto src = reblockOutputs[i].channelData[j] + phase;
+                    kernels::copy(outputs.channelData[j] + offset, src, n);
+                }
+            }
+        }
+    }, [&](){
+        if (plugin){
+            data->numSamples = reblocker.blockSize();
+            processPlugin(plugin, *data);
+        } else {
+            // copy the input FIFO to the output FIFO, so that we get the same latency
+            // (and can stop bypassing anytime). See also performBypass().
+            int blockSize = reblocker.blockSize();
+            for (int i = 0; i < reblock_->numOutputs; ++i){
+                auto& outputs = reblockOutputs[i];
+                for (int j = 0; j < outputs.numChannels; ++j){
+                    if (i < reblock_->numInputs && j < reblockInputs[i].numChannels){
+                        kernels::copy(outputs.channelData[j], reblockInputs[i].channelData[j], blockSize);
+                    } else {
+                        kernels::clear(outputs.channelData[j], blockSize);
+                    }
+                }
+            }
+        }
+    });
 }
 
 void VSTPlugin::freeReblocker(){
@@ -1107,10 +1215,126 @@ void VSTPlugin::freeReblocker(){
         }
         RTFree(mWorld, reblock_->inputs);
         RTFree(mWorld, reblock_->outputs);
+        RTFree(mWorld, reblock_->buffer);
         RTFree(mWorld, reblock_);
+        reblock_ = nullptr;
     }
 }
 
+// Take over the current plugin busses for a crossfade (before calling setupPlugin()
+// for the next plugin!) and redirect the plugin outputs to private buffers.
+// NOTE: we don't crossfade with reblocking because the plugin busses point to
+// the reblocker buffers.
+bool VSTPlugin::beginFade(int length){
+    assert(fade_ == nullptr);
+    if (reblock_ || length <= 0){
+        return false;
+    }
+    int numUgenOutputChannels = 0;
+    for (int i = 0; i < numUgenOutputs_; ++i){
+        numUgenOutputChannels += ugenOutputs_[i].numChannels;
+    }
+    auto fade = (Fade *)RTAlloc(mWorld, sizeof(Fade));
+    if (!fade){
+        LOG_ERROR("RTAlloc failed!");
+        return false;
+    }
+    fade->sources = (const float **)RTAlloc(mWorld,
+        std::max(numUgenOutputChannels, 1) * sizeof(float *));
+    fade->buffer = (float *)RTAlloc(mWorld,
+        std::max(numPluginOutputChannels_, 1) * bufferSize() * sizeof(float));
+    if (!(fade->sources && fade->buffer)){
+        LOG_ERROR("RTAlloc failed!");
+        RTFree(mWorld, fade->sources);
+        RTFree(mWorld, fade->buffer);
+        RTFree(mWorld, fade);
+        return false;
+    }
+    fade->length = length;
+    fade->pos = 0;
+    // steal the plugin busses; setupPlugin() will allocate new ones.
+    fade->inputs = std::exchange(pluginInputs_, nullptr);
+    fade->numInputs = std::exchange(numPluginInputs_, 0);
+    fade->outputs = std::exchange(pluginOutputs_, nullptr);
+    fade->numOutputs = std::exchange(numPluginOutputs_, 0);
+    numPluginInputChannels_ = 0;
+    numPluginOutputChannels_ = 0;
+    // find the source for each UGen output and redirect the plugin output
+    std::fill(fade->sources, fade->sources + numUgenOutputChannels, nullptr);
+    auto buf = fade->buffer;
+    for (int i = 0; i < fade->numOutputs; ++i){
+        auto& bus = fade->outputs[i];
+        for (int j = 0; j < bus.numChannels; ++j, buf += bufferSize()){
+            int index = 0;
+            for (int k = 0; k < numUgenOutputs_; ++k){
+                auto& outputs = ugenOutputs_[k];
+                for (int l = 0; l < outputs.numChannels; ++l, ++index){
+                    if (outputs.channelData[l] == bus.channelData32[j]){
+                        fade->sources[index] = buf;
+                    }
+                }
+            }
+            bus.channelData32[j] = buf;
+        }
+    }
+    fade_ = fade;
+    return true;
+}
+
+void VSTPlugin::freeFade(){
+    if (fade_){
+        for (int i = 0; i < fade_->numInputs; ++i){
+            RTFree(mWorld, fade_->inputs[i].channelData32);
+        }
+        RTFree(mWorld, fade_->inputs);
+        for (int i = 0; i < fade_->numOutputs; ++i){
+            RTFree(mWorld, fade_->outputs[i].channelData32);
+        }
+        RTFree(mWorld, fade_->outputs);
+        RTFree(mWorld, fade_->sources);
+        RTFree(mWorld, fade_->buffer);
+        RTFree(mWorld, fade_);
+        fade_ = nullptr;
+    }
+}
+
+// run the previous plugin; must be called before the current plugin
+// writes to the UGen outputs, because UGen inputs and outputs can alias!
+void VSTPlugin::performFade(IPlugin *plugin, int numSamples){
+    ProcessData data;
+    data.precision = ProcessPrecision::Single;
+    data.mode = mWorld->mRealTime ? ProcessMode::Realtime : ProcessMode::Offline;
+    data.numSamples = numSamples;
+    data.numInputs = fade_->numInputs;
+    data.inputs = fade_->inputs;
+    data.numOutputs = fade_->numOutputs;
+    data.outputs = fade_->outputs;
+    plugin->process(data);
+}
+
+// mix the output of the previous plugin into the UGen outputs;
+// returns true when the crossfade has finished.
+bool VSTPlugin::mixFade(int numSamples){
+    int n = std::min(numSamples, fade_->length - fade_->pos);
+    float gain = (float)fade_->pos / (float)fade_->length;
+    float inc = 1.f / (float)fade_->length;
+    int index = 0;
+    for (int i = 0; i < numUgenOutputs_; ++i){
+        auto& outputs = ugenOutputs_[i];
+        for (int j = 0; j < outputs.numChannels; ++j, ++index){
+            auto out = outputs.channelData[j];
+            if (auto src = fade_->sources[index]){
+                kernels::crossfade(out, out, src, n, gain, inc);
+            } else {
+                // fade in current plugin
+                kernels::fade(out, out, n, gain, inc);
+            }
+        }
+    }
+    fade_->pos += n;
+    return fade_->pos >= fade_->length;
+}
+
 // update data (after loading a new plugin)
 void VSTPlugin::setupPlugin(const int *inputs, int numInputs,
                             const int *outputs, int numOutputs)
@@ -1118,8 +1342,7 @@ void VSTPlugin::setupPlugin(const int *inputs, int numInputs,
     delegate().update();
 
     auto inDummy = dummyBuffer_;
-    auto outDummy = dummyBuffer_ +
-            (reblock_ ? reblock_->blockSize : bufferSize());
+    auto outDummy = dummyBuffer_ + blockSize();
 
     // setup buffers
     if (reblock_){
@@ -1258,6 +1481,12 @@ void VSTPlugin::next(int inNumSamples) {
         return;
     }
 
+    // previous plugin during a crossfade, see VSTPluginDelegate::doneOpen()
+    auto fadePlugin = fade_ ? delegate_->fadePlugin() : nullptr;
+    if (fadePlugin){
+        performFade(fadePlugin, inNumSamples);
+    }
+
     auto plugin = delegate_->plugin();
     bool process = plugin && plugin->info().hasPrecision(ProcessPrecision::Single);
     bool suspended = delegate_->isSuspended();
@@ -1273,8 +1502,6 @@ void VSTPlugin::next(int inNumSamples) {
     }
 
     if (process) {
-        auto vst3 = plugin->info().type() == PluginType::VST3;
-
         // check bypass state
         Bypass bypass;
         int inBypass = getBypass();
@@ -1314,23 +1541,7 @@ void VSTPlugin::next(int inNumSamples) {
                     float last = paramState_[index];
                     float* bus = &mWorld->mAudioBus[mWorld->mBufLength * num];
                     ACQUIRE_BUS_AUDIO_SHARED(num);
-                    if (vst3) {
-                        // VST3: sample accurate
-                        for (int i = 0; i < inNumSamples; ++i) {
-                            float value = bus[i];
-                            if (value != last) {
-                                plugin->setParameter(index, value, sampleOffset + i);
-                                last = value;
-                            }
-                        }
-                    } else {
-                        // VST2: pick the first sample
-                        float value = *bus;
-                        if (value != last) {
-                            plugin->setParameter(index, value); // no offset
-                            last = value;
-                        }
-                    }
+                    last = automateAudioRate(plugin, index, bus, inNumSamples, sampleOffset, last);
                     RELEASE_BUS_AUDIO_SHARED(num);
                     paramState_[index] = last;
                 #undef unit
@@ -1348,25 +1559,8 @@ void VSTPlugin::next(int inNumSamples) {
                     auto buffer = control[1]->mBuffer;
                     if (calcRate == calc_FullRate) {
                         // audio rate
-                        float last = paramState_[index];
-                        // VST3: sample accurate
-                        if (vst3) {
-                            for (int i = 0; i < inNumSamples; ++i) {
-                                float value = buffer[i];
-                                if (value != last) {
-                                    plugin->setParameter(index, value, sampleOffset + i);
-                                    last = value;
-                                }
-                            }
-                        } else {
-                            // VST2: pick the first sample
-                            float value = buffer[0];
-                            if (value != last) {
-                                plugin->setParameter(index, value); // no offset
-                                last = value;
-                            }
-                        }
-                        paramState_[index] = last;
+                        paramState_[index] = automateAudioRate(plugin, index, buffer, inNumSamples,
+                                                               sampleOffset, paramState_[index]);
                     } else {
                         // control rate
                         float value = buffer[0];
@@ -1388,26 +1582,11 @@ void VSTPlugin::next(int inNumSamples) {
         data.outputs = pluginOutputs_;
 
         if (reblock_){
-            if (updateReblocker(inNumSamples)){
-                data.numSamples = reblock_->blockSize;
-
-                plugin->process(data);
-            }
-
-            // write reblocker output
-            for (int i = 0; i < numUgenOutputs_ && i < numPluginOutputs_; ++i){
-                int ugenChannels = ugenOutputs_[i].numChannels;
-                int pluginChannels = pluginOutputs_[i].numChannels;
-                for (int j = 0; j < ugenChannels && j < pluginChannels; ++j){
-                    auto src = reblock_->outputs[i].channelData[j] + reblock_->phase;
-                    auto dst = ugenOutputs_[i].channelData[j];
-                    std::copy(src, src + inNumSamples, dst);
-                }
-            }
+            performReblock(plugin, &data, inNumSamples);
         } else {
             data.numSamples = inNumSamples;
 
-            plugin->process(data);
+            processPlugin(plugin, data);
         }
 
         // see VSTPluginDelegate::setParam(), setProgram and parameterAutomated()
@@ -1465,7 +1644,7 @@ void VSTPlugin::next(int inNumSamples) {
             auto& ugenOutputs = ugenOutputs_[0];
             for (int i = numPluginOutputChannels_; i < ugenOutputs.numChannels; ++i){
                 auto out = ugenOutputs.channelData[i];
-                std::fill(out, out + inNumSamples, 0);
+                kernels::clear(out, inNumSamples);
             }
         } else {
             for (int i = 0; i < numUgenOutputs_; ++i){
@@ -1474,7 +1653,7 @@ void VSTPlugin::next(int inNumSamples) {
                     pluginOutputs_[i].numChannels : 0;
                 for (int j = onset; j < ugenOutputs.numChannels; ++j){
                     auto out = ugenOutputs.channelData[j];
-                    std::fill(out, out + inNumSamples, 0);
+                    kernels::clear(out, inNumSamples);
                 }
             }
         }
@@ -1490,13 +1669,15 @@ void VSTPlugin::next(int inNumSamples) {
         if (reblock_){
             // we have to update the reblocker, so that we can stop bypassing
             // anytime and always have valid input data.
-            updateReblocker(inNumSamples);
-
-            performBypass(reblock_->inputs, reblock_->numInputs, inNumSamples, reblock_->phase);
+            performReblock(nullptr, nullptr, inNumSamples);
         } else {
             performBypass(ugenInputs_, numUgenInputs_, inNumSamples, 0);
         }
     }
+
+    if (fadePlugin && mixFade(inNumSamples)){
+        delegate_->stopFade();
+    }
 }
 
 void VSTPlugin::performBypass(const Bus *ugenInputs, int numInputs,
@@ -1510,29 +1691,53 @@ void VSTPlugin::performBypass(const Bus *ugenInputs, int numInputs,
                 if (j < inputs.numChannels){
                     // copy input to output
                     auto chn = inputs.channelData[j] + phase;
-                    std::copy(chn, chn + numSamples, outputs.channelData[j]);
+                    kernels::copy(outputs.channelData[j], chn, numSamples);
                 } else {
                     // zero outlet
                     auto chn = outputs.channelData[j];
-                    std::fill(chn, chn + numSamples, 0);
+                    kernels::clear(chn, numSamples);
                 }
             }
         } else {
             // zero whole bus
             for (int j = 0; j < outputs.numChannels; ++j){
                 auto chn = outputs.channelData[j];
-                std::fill(chn, chn + numSamples, 0);
+                kernels::clear(chn, numSamples);
             }
         }
     }
 }
 
+// Send (decimated) audio rate automation to the plugin. VST3 plugins receive a
+// multi-point automation ramp, VST2 plugins perform sub-block processing.
+// Returns the last value.
+float VSTPlugin::automateAudioRate(IPlugin *plugin, int index, const float *buf,
+                                   int numSamples, int sampleOffset, float last) {
+    int interval = automationInterval_ > 0 ? automationInterval_ : numSamples;
+    for (int i = 0; i < numSamples; i += interval) {
+        float value = buf[i];
+        if (value != last) {
+            plugin->setParameter(index, value, sampleOffset + i);
+            last = value;
+        }
+    }
+    return last;
+}
+
+void VSTPlugin::setAutomationInterval(int samples) {
+    automationInterval_ = std::max(0, samples);
+}
+
 int VSTPlugin::blockSize() const {
-    return reblock_ ? reblock_->blockSize : bufferSize();
+    return reblock_ ? reblock_->reblocker.blockSize() : bufferSize();
 }
 
 int VSTPlugin::reblockPhase() const {
-    return reblock_ ? reblock_->phase : 0;
+    return reblock_ ? reblock_->reblocker.phase() : 0;
+}
+
+int VSTPlugin::reblockLatency() const {
+    return reblock_ ? reblock_->reblocker.latency() : 0;
 }
 
 //------------------- VSTPluginDelegate ------------------------------//
@@ -1550,6 +1755,7 @@ VSTPluginDelegate::VSTPluginDelegate(VSTPlugin& owner) {
 
 VSTPluginDelegate::~VSTPluginDelegate() {
     assert(plugin_ == nullptr);
+    assert(fadePlugin_ == nullptr);
 
     if (paramQueue_) {
         if (paramQueue_->needRelease()) {
@@ -1583,6 +1789,7 @@ void VSTPluginDelegate::setOwner(VSTPlugin *owner) {
     if (owner) {
         // cache some members
         world_ = owner->mWorld;
+        dspLoad_.setSampleRate(world_->mSampleRate);
     }
     owner_ = owner;
 }
@@ -1665,6 +1872,12 @@ void VSTPluginDelegate::sysexEvent(const SysexEvent & sysex) {
 }
 
 bool VSTPluginDelegate::check(bool loud) const {
+    if (isLoading_){
+        if (loud){
+            LOG_WARNING("VSTPlugin: plugin is being (re)opened!");
+        }
+        return false;
+    }
     if (!plugin_){
         if (loud){
             LOG_WARNING("VSTPlugin: no plugin loaded!");
@@ -1746,34 +1959,86 @@ void VSTPluginDelegate::close() {
 
 void VSTPluginDelegate::doClose(){
     if (plugin_){
-        auto cmdData = CmdData::create<CloseCmdData>(world());
-        if (!cmdData) {
-            return;
+        // the plugin is released in the NRT thread
+        plugin_->setDSPLoadMeter(nullptr);
+        dspLoadHost_ = false;
+        if (releasePlugin(std::move(plugin_), std::move(snapshots_), editor_)) {
+            plugin_ = nullptr;
         }
-        cmdData->plugin = std::move(plugin_);
-        cmdData->editor = editor_;
-        // NOTE: the plugin might send an event between here and
-        // the NRT stage, e.g. when automating parameters in the
-        // plugin UI. Since the events come from the UI thread,
-        // we must not unset the listener in the audio thread,
-        // otherwise we have a race condition.
-        // Instead, we keep the delegate alive until the plugin
-        // has been closed. See VSTPluginDelegate::release()
-    #if 0
-        data->plugin->setListener(nullptr);
-    #endif
-        doCmd(cmdData, [](World *world, void* inData) {
-            auto data = (CloseCmdData*)inData;
-            // release plugin on the correct thread
-            defer([&](){
-                data->plugin = nullptr;
-            }, data->editor);
-            return false; // done
-        });
-        plugin_ = nullptr;
     }
 }
 
+// release the plugin in the NRT thread; returns false if
+// RTAlloc failed, in which case 'plugin' is left untouched.
+bool VSTPluginDelegate::releasePlugin(IPlugin::ptr&& plugin,
+                                      std::unique_ptr<SnapshotStore>&& snapshots,
+                                      bool editor) {
+    auto cmdData = CmdData::create<CloseCmdData>(world());
+    if (!cmdData) {
+        return false;
+    }
+    cmdData->plugin = std::move(plugin);
+    cmdData->snapshots = std::move(snapshots);
+    cmdData->editor = editor;
+    // NOTE: the plugin might send an event between here and
+    // the NRT stage, e.g. when automating parameters in the
+    // plugin UI. Since the events come from the UI thread,
+    // we must not unset the listener in the audio thread,
+    // otherwise we have a race condition.
+    // Instead, we keep the delegate alive until the plugin
+    // has been closed. See VSTPluginDelegate::release()
+#if 0
+    data->plugin->setListener(nullptr);
+#endif
+    doCmd(cmdData, [](World *world, void* inData) {
+        auto data = (CloseCmdData*)inData;
+        // release plugin on the correct thread
+        defer([&](){
+            data->plugin = nullptr;
+        }, data->editor);
+        data->snapshots = nullptr;
+        return false; // done
+    });
+    return true;
+}
+
+// try to crossfade from the current plugin to the next plugin;
+// returns false if we can't (or shouldn't) crossfade.
+bool VSTPluginDelegate::startFade() {
+    if (fadeTime_ <= 0 || !plugin_->info().hasPrecision(ProcessPrecision::Single)) {
+        return false;
+    }
+    stopFade(); // previous crossfade still running
+    int length = fadeTime_ * 0.001 * owner_->sampleRate();
+    if (!owner_->beginFade(std::max(length, 1))) {
+        return false;
+    }
+    plugin_->setDSPLoadMeter(nullptr);
+    dspLoadHost_ = false;
+    fadePlugin_ = std::move(plugin_);
+    fadeSnapshots_ = std::move(snapshots_);
+    fadeEditor_ = editor_;
+    return true;
+}
+
+// stop the crossfade and release the previous plugin
+void VSTPluginDelegate::stopFade() {
+    if (owner_) {
+        owner_->freeFade();
+    }
+    if (fadePlugin_) {
+        if (!releasePlugin(std::move(fadePlugin_), std::move(fadeSnapshots_), fadeEditor_)) {
+            LOG_ERROR("couldn't release previous plugin!");
+        }
+        fadePlugin_ = nullptr;
+        fadeSnapshots_ = nullptr;
+    }
+}
+
+void VSTPluginDelegate::setCrossfade(float ms) {
+    fadeTime_ = std::max(ms, 0.f);
+}
+
 bool cmdOpen(World *world, void* cmdData) {
     LOG_DEBUG("cmdOpen");
     // initialize GUI backend (if needed)
@@ -1854,10 +2119,10 @@ bool cmdOpen(World *world, void* cmdData) {
                 };
 
                 // prepare input busses
-                setupSpeakers(data->plugin->info().inputs, data->inputs, data->numInputs,
+                setupSpeakers(data->plugin->info().inputs(), data->inputs, data->numInputs,
                               data->pluginInputs, "inputs");
                 // prepare output busses
-                setupSpeakers(data->plugin->info().outputs, data->outputs, data->numOutputs,
+                setupSpeakers(data->plugin->info().outputs(), data->outputs, data->numOutputs,
                               data->pluginOutputs, "outputs");
 
                 data->plugin->setNumSpeakers(data->pluginInputs.data(), data->pluginInputs.size(),
@@ -1866,6 +2131,7 @@ bool cmdOpen(World *world, void* cmdData) {
                 LOG_DEBUG("resume");
                 data->plugin->resume();
             }, data->editor);
+            data->snapshots = std::make_unique<SnapshotStore>();
             LOG_DEBUG("done");
         } catch (const Error & e) {
             LOG_ERROR(e.what());
@@ -1889,13 +2155,8 @@ void VSTPluginDelegate::open(const char *path, bool editor,
         sendMsg("/vst_open", 0);
         return;
     }
-    doClose();
-    if (plugin_) {
-        // shouldn't happen...
-        LOG_ERROR("couldn't close current plugin!");
-        sendMsg("/vst_open", 0);
-        return;
-    }
+    // NOTE: the current plugin is only closed in doneOpen(),
+    // so that it can keep running while the new plugin is being loaded.
 #ifdef SUPERNOVA
     if (threaded){
         LOG_WARNING("multiprocessing option ignored on Supernova!");
@@ -1938,6 +2199,7 @@ void VSTPluginDelegate::open(const char *path, bool editor,
             LOG_ERROR("RTAlloc failed!");
         }
 
+        cmdData->offload = true;
         doCmd(cmdData, cmdOpen,
             [](World *world, void *cmdData){
                 auto data = (OpenCmdData*)cmdData;
@@ -1963,17 +2225,26 @@ void VSTPluginDelegate::open(const char *path, bool editor,
 // "/open" command succeeded/failed - called in the RT thread
 void VSTPluginDelegate::doneOpen(OpenCmdData& cmd){
     LOG_DEBUG("doneOpen");
-    editor_ = cmd.editor;
-    threaded_ = cmd.threaded;
     isLoading_ = false;
-    // move *before* calling alive(), so that doClose() can close it.
-    plugin_ = std::move(cmd.plugin);
     if (!alive()) {
         LOG_WARNING("VSTPlugin freed during 'open'");
-        // properly release the plugin
+        // properly release the old and the new plugin
+        doClose();
+        editor_ = cmd.editor;
+        plugin_ = std::move(cmd.plugin);
+        snapshots_ = std::move(cmd.snapshots);
         doClose();
         return; // !
     }
+    // retire the old plugin; it might keep running while
+    // the new plugin fades in, see setCrossfade().
+    if (plugin_ && !(cmd.plugin && startFade())) {
+        doClose();
+    }
+    editor_ = cmd.editor;
+    threaded_ = cmd.threaded;
+    plugin_ = std::move(cmd.plugin);
+    snapshots_ = std::move(cmd.snapshots);
     if (plugin_){
         if (!plugin_->info().hasPrecision(ProcessPrecision::Single)) {
             LOG_WARNING("'" << plugin_->info().name
@@ -1985,6 +2256,8 @@ void VSTPluginDelegate::doneOpen(OpenCmdData& cmd){
                             cmd.pluginOutputs.data(), cmd.pluginOutputs.size());
         // receive events from plugin
         plugin_->setListener(this);
+        setupDSPLoad();
+        dspLoad_.reset();
         // success, window, initial latency
         bool haveWindow = plugin_->getWindow() != nullptr;
         int latency = plugin_->getLatencySamples() + latencySamples();
@@ -2153,8 +2426,16 @@ void VSTPluginDelegate::queryParams(int32 index, int32 count) {
         int32 nparam = plugin_->info().numParameters();
         if (index >= 0 && index < nparam) {
             count = std::min<int32>(count, nparam - index);
-            for (int i = 0; i < count; ++i) {
-                sendParameter(index + i, plugin_->getParameter(index + i));
+            // query the parameters in chunks
+            const int chunkSize = 64;
+            float values[chunkSize];
+            ParamStringBuffer strings[chunkSize];
+            for (int i = 0; i < count; i += chunkSize) {
+                int n = std::min<int>(chunkSize, count - i);
+                plugin_->getParameters(index + i, n, values, strings);
+                for (int j = 0; j < n; ++j) {
+                    sendParameter(index + i + j, values[j], strings[j].data());
+                }
             }
         } else {
             LOG_WARNING("VSTPlugin: parameter index " << index << " out of range!");
@@ -2190,10 +2471,7 @@ void VSTPluginDelegate::getParams(int32 index, int32 count) {
                 float *buf = (float *)alloca(sizeof(float) * nargs);
                 buf[0] = index;
                 buf[1] = count;
-                for (int i = 0; i < count; ++i) {
-                    float value = plugin_->getParameter(i + index);
-                    buf[i + 2] = value;
-                }
+                plugin_->getParameters(index, count, buf + 2);
                 sendMsg("/vst_setn", nargs, buf);
                 return;
             } else {
@@ -2235,6 +2513,70 @@ void VSTPluginDelegate::unmapAll() {
     }
 }
 
+// 0: off, 1: detect silent input (VST3), 2: sleep while idle
+void VSTPluginDelegate::setSilenceMode(int mode) {
+    if (check()) {
+        if (mode >= 0 && mode <= 2) {
+            plugin_->setSilenceMode(static_cast<SilenceMode>(mode));
+        } else {
+            LOG_WARNING("VSTPlugin: bad silence mode " << mode);
+        }
+    }
+}
+
+// only send the last parameter change per block (threaded/bridged plugins)
+void VSTPluginDelegate::setParameterCoalescing(bool enable) {
+    if (check()) {
+        plugin_->setParameterCoalescing(enable);
+    }
+}
+
+// DSP load metering
+void VSTPluginDelegate::setupDSPLoad() {
+    // threaded and bridged plugins measure themselves,
+    // otherwise we measure in VSTPlugin::processPlugin().
+    if (dspLoadEnabled_) {
+        dspLoadHost_ = !plugin_->setDSPLoadMeter(&dspLoad_);
+    } else {
+        plugin_->setDSPLoadMeter(nullptr);
+        dspLoadHost_ = false;
+    }
+}
+
+void VSTPluginDelegate::setDSPLoadMetering(bool enable) {
+    dspLoadEnabled_ = enable;
+    dspLoad_.reset();
+    // NB: also works while the plugin is suspended
+    if (plugin_) {
+        setupDSPLoad();
+    }
+}
+
+// reply: last, average, peak (ms), load (%), wait (ms)
+void VSTPluginDelegate::getDSPLoad(bool reset) {
+    if (check() && dspLoadEnabled_) {
+        auto load = dspLoad_.get();
+        float data[5] = { (float)(load.last * 1000.0), (float)(load.average * 1000.0),
+                          (float)(load.peak * 1000.0), (float)load.load,
+                          (float)(load.wait * 1000.0) };
+        sendMsg("/vst_cpu", 5, data);
+        if (reset) {
+            dspLoad_.reset();
+        }
+    } else {
+        if (!dspLoadEnabled_) {
+            LOG_WARNING("VSTPlugin: DSP load metering is disabled");
+        }
+        sendMsg("/vst_cpu", 0, nullptr);
+    }
+}
+
+void VSTPluginDelegate::getDSPWaitStats(bool reset) {
+    auto stats = vst::getDSPWaitStats(reset);
+    float data[3] = { (float)stats.spins, (float)stats.yields, (float)stats.sleeps };
+    sendMsg("/vst_dsp_wait_stats", 3, data);
+}
+
 // program/bank
 void VSTPluginDelegate::setProgram(int32 index) {
     if (check()) {
@@ -2285,7 +2627,7 @@ void VSTPluginDelegate::queryPrograms(int32 index, int32 count) {
     }
 }
 
-void VSTPluginDelegate::doReadPreset(const std::string& data, bool bank) {
+void VSTPluginDelegate::doReadPreset(std::string_view data, bool bank) {
     // NB: readProgramData() can throw, hence the scope guard!
     isSettingState_ = true;
     ScopeGuard guard([this]() {
@@ -2306,34 +2648,32 @@ bool cmdReadPreset(World* world, void* cmdData) {
     bool async = data->async;
     bool result = true;
     try {
+        // NOTE: we avoid readProgram() to minimize the critical section
         if (data->bufnum < 0) {
-            // from file
-            vst::File file(data->path);
-            if (file.is_open()){
-                LOG_DEBUG("opened preset file " << data->path);
-            } else {
-                throw Error("couldn't open file " + std::string(data->path));
-            }
-            file.seekg(0, std::ios_base::end);
-            buffer.resize(file.tellg());
-            file.seekg(0, std::ios_base::beg);
-            file.read(&buffer[0], buffer.size());
-            if (file){
-                LOG_DEBUG("successfully read " << buffer.size() << " bytes");
+            // from file; the file is memory mapped, so we don't need
+            // to copy the data if we load the preset right away.
+            vst::MappedFile file(data->path); // throws on failure
+            LOG_DEBUG("mapped preset file " << data->path
+                      << " (" << file.size() << " bytes)");
+            if (async) {
+                // load preset now
+                defer([&]() {
+                    data->owner->doReadPreset({ file.data(), file.size() }, bank);
+                }, data->owner->hasEditor());
             } else {
-                throw Error("couldn't read preset data");
+                // the preset is loaded in the RT stage
+                buffer.assign(file.data(), file.size());
             }
         } else {
             // from buffer
             auto sndbuf = World_GetNRTBuf(world, data->bufnum);
             writeBuffer(sndbuf, buffer);
-        }
-        if (async) {
-            // load preset now
-            // NOTE: we avoid readProgram() to minimize the critical section
-            defer([&]() {
-                data->owner->doReadPreset(buffer, bank);
-            }, data->owner->hasEditor());
+            if (async) {
+                // load preset now
+                defer([&]() {
+                    data->owner->doReadPreset(buffer, bank);
+                }, data->owner->hasEditor());
+            }
         }
     } catch (const Error& e) {
         LOG_ERROR("couldn't read " << (bank ? "bank: " : "program: ") << e.what());
@@ -2506,6 +2846,130 @@ fail:
     }
 }
 
+// snapshots
+bool cmdSaveSnapshot(World *world, void *cmdData) {
+    auto data = (SnapshotCmdData *)cmdData;
+    auto owner = data->owner;
+    // also try to get the program data, so we can do a full recall
+    std::string buffer;
+    try {
+        defer([&](){
+            owner->doWritePreset(buffer, false);
+        }, owner->hasEditor());
+    } catch (const Error& e) {
+        LOG_DEBUG("snapshot " << data->slot << ": couldn't get program data ("
+                  << e.what() << ")");
+        buffer.clear(); // only save parameters
+    }
+    data->result = owner->snapshots()->save(data->slot, *owner->plugin(), std::move(buffer));
+    return true;
+}
+
+bool cmdSaveSnapshotDone(World *world, void *cmdData) {
+    auto data = (SnapshotCmdData *)cmdData;
+    if (!data->alive()) return false;
+    data->owner->sendMsg("/vst_snapshot_save", data->result);
+    return false; // done
+}
+
+void VSTPluginDelegate::saveSnapshot(int32 slot) {
+    if (check()) {
+        auto data = CmdData::create<SnapshotCmdData>(world());
+        if (data) {
+            data->slot = slot;
+            data->offload = true;
+            doCmd(data, cmdSaveSnapshot, cmdSaveSnapshotDone);
+            return;
+        }
+    }
+    sendMsg("/vst_snapshot_save", 0);
+}
+
+bool cmdRecallSnapshot(World *world, void *cmdData) {
+    auto data = (SnapshotCmdData *)cmdData;
+    auto owner = data->owner;
+    try {
+        auto chunk = owner->snapshots()->chunk(data->slot);
+        defer([&](){
+            owner->doReadPreset(chunk, false);
+        }, owner->hasEditor());
+        data->result = 1;
+    } catch (const Error& e) {
+        LOG_ERROR("couldn't recall snapshot " << data->slot << ": " << e.what());
+    }
+    return true;
+}
+
+bool cmdRecallSnapshotDone(World *world, void *cmdData) {
+    auto data = (SnapshotCmdData *)cmdData;
+    if (!data->alive()) return false;
+    data->owner->resume();
+    data->owner->sendMsg("/vst_snapshot_recall", data->result);
+    return false; // done
+}
+
+// Without 'full', only the parameters which differ from the current state
+// are set, directly on the RT thread. Otherwise the program data is restored
+// asynchronously in the NRT thread (like program_read).
+void VSTPluginDelegate::recallSnapshot(int32 slot, bool full) {
+    if (check()) {
+        if (!snapshots_->valid(slot)) {
+            LOG_WARNING("VSTPlugin: snapshot " << slot << " is empty");
+        } else if (full && !snapshots_->chunk(slot).empty()) {
+            auto data = CmdData::create<SnapshotCmdData>(world());
+            if (data) {
+                data->slot = slot;
+                data->offload = true;
+                suspend();
+                doCmd(data, cmdRecallSnapshot, cmdRecallSnapshotDone);
+                return;
+            }
+        } else {
+            auto count = snapshots_->recall(slot, *plugin_, [this](int index, float value) {
+                setParam(index, value);
+            });
+            if (count >= 0) {
+                sendMsg("/vst_snapshot_recall", 1);
+                return;
+            }
+            LOG_WARNING("VSTPlugin: couldn't recall snapshot " << slot);
+        }
+    }
+    sendMsg("/vst_snapshot_recall", 0);
+}
+
+void VSTPluginDelegate::morphSnapshots(int32 slotA, int32 slotB, float x) {
+    if (check()) {
+        auto count = snapshots_->morph(slotA, slotB, x, *plugin_, [this](int index, float value) {
+            setParam(index, value);
+        });
+        if (count < 0) {
+            LOG_WARNING("VSTPlugin: couldn't morph snapshots " << slotA << " and " << slotB);
+        }
+    }
+}
+
+// a negative slot number clears all slots
+void VSTPluginDelegate::clearSnapshot(int32 slot) {
+    if (check()) {
+        auto data = CmdData::create<SnapshotCmdData>(world());
+        if (data) {
+            data->slot = slot;
+            // free memory in the NRT thread
+            doCmd(data, [](World *world, void *cmdData) {
+                auto data = (SnapshotCmdData *)cmdData;
+                auto snapshots = data->owner->snapshots();
+                if (data->slot < 0) {
+                    snapshots->clearAll();
+                } else {
+                    snapshots->clear(data->slot);
+                }
+                return false; // done
+            });
+        }
+    }
+}
+
 // midi
 void VSTPluginDelegate::sendMidiMsg(int32 status, int32 data1, int32 data2, float detune) {
     if (check()) {
@@ -2598,6 +3062,7 @@ void VSTPluginDelegate::vendorSpecific(int32 index, int32 value, size_t size,
                 cmdData->opt = opt;
                 cmdData->size = size;
                 memcpy(cmdData->data, data, size);
+                cmdData->offload = true;
                 doCmd(cmdData, cmdVendorSpecific, cmdVendorSpecificDone);
             }
         } else {
@@ -2643,14 +3108,19 @@ void VSTPluginDelegate::sendCurrentProgramName() {
 
 // unchecked
 void VSTPluginDelegate::sendParameter(int32 index, float value) {
+    ParamStringBuffer str;
+    auto len = plugin_->getParameterString(index, str);
+    sendParameter(index, value, std::string_view{str.data(), len});
+}
+
+// unchecked
+void VSTPluginDelegate::sendParameter(int32 index, float value, std::string_view display) {
     const int maxSize = 64;
     float buf[maxSize];
     // msg format: index, value, display length, display chars...
     buf[0] = index;
     buf[1] = value;
-    ParamStringBuffer str;
-    auto len = plugin_->getParameterString(index, str);
-    int size = string2floatArray(std::string_view{str.data(), len}, buf + 2, maxSize - 2);
+    int size = string2floatArray(display, buf + 2, maxSize - 2);
     sendMsg("/vst_param", size + 2, buf);
 }
 
@@ -2663,7 +3133,7 @@ void VSTPluginDelegate::sendParameterAutomated(int32 index, float value) {
 
 int32 VSTPluginDelegate::latencySamples() const {
     int32 blockSize = owner_->blockSize();
-    int32 nsamples = blockSize - world_->mBufLength;
+    int32 nsamples = owner_->reblockLatency();
     if (threaded_){
         nsamples += blockSize;
     }
@@ -2698,14 +3168,155 @@ void VSTPluginDelegate::sendMsg(const char *cmd, int n, const float *data) {
     }
 }
 
+/*** CmdExecutor ***/
+
+// NB: intentionally leaked because the worker threads are never joined.
+CmdExecutor& CmdExecutor::instance() {
+    static CmdExecutor *executor = new CmdExecutor();
+    return *executor;
+}
+
+void CmdExecutor::setNumThreads(int numThreads) {
+    numThreads = std::max<int>(0, std::min<int>(numThreads, maxNumThreads));
+    std::lock_guard lock(mutex_);
+    // create missing threads; threads above the limit just stay idle.
+    for (int i = threads_.size(); i < numThreads; ++i) {
+        threads_.emplace_back(&CmdExecutor::threadFunction, this, i);
+    }
+    numThreads_.store(numThreads);
+    condition_.notify_all();
+    LOG_DEBUG("CmdExecutor: " << numThreads << " threads");
+}
+
+void CmdExecutor::threadFunction(int index) {
+    setThreadPriority(Priority::Low);
+
+    std::unique_lock lock(mutex_);
+    for (;;) {
+        if (!ready_.empty() && index < numThreads_.load()) {
+            auto owner = ready_.front();
+            ready_.pop_front();
+            run(owner, lock);
+        } else {
+            condition_.wait(lock);
+        }
+    }
+}
+
+void CmdExecutor::run(VSTPluginDelegate *owner, std::unique_lock<std::mutex>& lock) {
+    // NB: references to unordered_map elements are stable; the queue can only
+    // be removed by the thread which runs its first command.
+    auto& queue = queues_[owner];
+    auto cmd = queue.cmds.front();
+    queue.busy = true;
+    lock.unlock();
+    bool result = cmd->exec.stage2(owner->world(), cmd);
+    lock.lock();
+    queue.busy = false;
+    queue.cmds.pop_front();
+    cmd->exec.result = result;
+    // NB: the RT thread may free 'cmd' right after this!
+    cmd->exec.done.store(true, std::memory_order_release);
+    // schedule next command
+    if (queue.cmds.empty()) {
+        queues_.erase(owner);
+    } else if (queue.cmds.front()->offload && enabled()) {
+        ready_.push_back(owner);
+        // NB: wake up all threads, because some of them might be above the limit
+        condition_.notify_all();
+    } // else: run on the NRT thread, see poll()
+}
+
+void CmdExecutor::push(CmdData *cmd) {
+    auto owner = cmd->owner.get();
+    std::unique_lock lock(mutex_);
+    auto& queue = queues_[owner];
+    queue.cmds.push_back(cmd);
+    if (queue.cmds.size() == 1) {
+        if (cmd->offload && enabled()) {
+            ready_.push_back(owner);
+            condition_.notify_all(); // see above
+        } else {
+            run(owner, lock); // run now
+        }
+    }
+}
+
+void CmdExecutor::poll(CmdData *cmd) {
+    auto owner = cmd->owner.get();
+    std::unique_lock lock(mutex_);
+    auto it = queues_.find(owner);
+    if (it != queues_.end() && !it->second.busy) {
+        auto& cmds = it->second.cmds;
+        // run the first command on the NRT thread if it must not be offloaded;
+        // this is also a fallback in case the executor has been disabled.
+        auto first = cmds.front();
+        if (!first->offload || !enabled()) {
+            auto i = std::find(ready_.begin(), ready_.end(), owner);
+            if (i != ready_.end()) {
+                ready_.erase(i);
+            }
+            run(owner, lock);
+        }
+    }
+}
+
+// NRT stage: push command to the executor
+bool cmdExecPush(World *world, void *cmdData) {
+    CmdExecutor::instance().push((CmdData *)cmdData);
+    return true; // poll in the RT stage
+}
+
+// NRT stage: check if we can run a command on the NRT thread
+bool cmdExecPoll(World *world, void *cmdData) {
+    CmdExecutor::instance().poll((CmdData *)cmdData);
+    return true;
+}
+
+void cmdExecNoFree(World *world, void *cmdData) {}
+
+// RT stage
+bool cmdExecDone(World *world, void *cmdData) {
+    auto data = (CmdData *)cmdData;
+    auto& exec = data->exec;
+    if (exec.done.load(std::memory_order_acquire)) {
+        if (exec.result && (exec.stage3 || exec.stage4)) {
+            // continue with the remaining stages
+            DoAsynchronousCommand(world, 0, 0, data, nullptr,
+                exec.stage3, exec.stage4, exec.cleanup, 0, 0);
+        } else {
+            exec.cleanup(world, data);
+        }
+    } else {
+        // not finished yet; try again after a round trip to the NRT thread.
+        // NB: the RT thread only passes messages to the NRT thread once
+        // per block, so this doesn't spin.
+        DoAsynchronousCommand(world, 0, 0, data, cmdExecPoll,
+            cmdExecDone, nullptr, cmdExecNoFree, 0, 0);
+    }
+    return false; // done
+}
+
 template<typename T>
 void VSTPluginDelegate::doCmd(T *cmdData, AsyncStageFn stage2,
     AsyncStageFn stage3, AsyncStageFn stage4) {
     // so we don't have to always check the return value of makeCmdData
     if (cmdData) {
         cmdData->owner.reset(this);
-        DoAsynchronousCommand(world(),
-            0, 0, cmdData, stage2, stage3, stage4, cmdRTfree<T>, 0, 0);
+        // NB: in NRT synthesis, all commands are executed synchronously.
+        if (stage2 && world_->mRealTime && CmdExecutor::instance().enabled()) {
+            // run stage 2 with the executor, see CmdExecutor
+            auto& exec = cmdData->exec;
+            exec.stage2 = stage2;
+            exec.stage3 = stage3;
+            exec.stage4 = stage4;
+            exec.cleanup = cmdRTfree<T>;
+            DoAsynchronousCommand(world(),
+                0, 0, cmdData, cmdExecPush, cmdExecDone, nullptr, cmdExecNoFree, 0, 0);
+        } else {
+            DoAsynchronousCommand(world(),
+                0, 0, cmdData, stage2, stage3, stage4, cmdRTfree<T>, 0, 0);
+        }
     }
 }
 
@@ -2774,6 +3385,65 @@ void vst_reset(VSTPlugin *unit, sc_msg_iter *args) {
     unit->delegate().reset(async);
 }
 
+void vst_silence(VSTPlugin *unit, sc_msg_iter *args) {
+    int mode = args->geti();
+    unit->delegate().setSilenceMode(mode);
+}
+
+void vst_coalesce(VSTPlugin *unit, sc_msg_iter *args) {
+    bool enable = args->geti();
+    unit->delegate().setParameterCoalescing(enable);
+}
+
+void vst_crossfade(VSTPlugin *unit, sc_msg_iter *args) {
+    float ms = args->getf();
+    unit->delegate().setCrossfade(ms);
+}
+
+void vst_cpu_meter(VSTPlugin *unit, sc_msg_iter *args) {
+    bool enable = args->geti();
+    unit->delegate().setDSPLoadMetering(enable);
+}
+
+void vst_cpu(VSTPlugin *unit, sc_msg_iter *args) {
+    bool reset = args->geti();
+    unit->delegate().getDSPLoad(reset);
+}
+
+// reply: spins, yields, sleeps (global)
+void vst_dsp_wait_stats(VSTPlugin *unit, sc_msg_iter *args) {
+    bool reset = args->geti();
+    unit->delegate().getDSPWaitStats(reset);
+}
+
+void vst_snapshot_save(VSTPlugin *unit, sc_msg_iter *args) {
+    int slot = args->geti();
+    unit->delegate().saveSnapshot(slot);
+}
+
+void vst_snapshot_recall(VSTPlugin *unit, sc_msg_iter *args) {
+    int slot = args->geti();
+    bool full = args->geti();
+    unit->delegate().recallSnapshot(slot, full);
+}
+
+void vst_snapshot_morph(VSTPlugin *unit, sc_msg_iter *args) {
+    int slotA = args->geti();
+    int slotB = args->geti();
+    float x = args->getf();
+    unit->delegate().morphSnapshots(slotA, slotB, x);
+}
+
+void vst_snapshot_clear(VSTPlugin *unit, sc_msg_iter *args) {
+    int slot = args->geti(-1);
+    unit->delegate().clearSnapshot(slot);
+}
+
+void vst_automation_interval(VSTPlugin *unit, sc_msg_iter *args) {
+    int samples = args->geti();
+    unit->setAutomationInterval(samples);
+}
+
 void vst_mode(VSTPlugin *unit, sc_msg_iter *args) {
     LOG_WARNING("VSTPlugin: /mode command is deprecated and will be ignored");
 }
@@ -3105,6 +3775,7 @@ bool cmdSearch(World *inWorld, void* cmdData) {
     bool verbose = data->flags & SearchFlags::verbose;
     bool save = data->flags & SearchFlags::save;
     bool parallel = data->flags & SearchFlags::parallel;
+    bool incremental = data->flags & SearchFlags::incremental;
     std::vector<std::string> searchPaths;
     for (int i = 0; i < data->numSearchPaths; ++i){
         searchPaths.push_back(data->pathList[i]);
@@ -3126,7 +3797,7 @@ bool cmdSearch(World *inWorld, void* cmdData) {
     // search for plugins
     for (auto& path : searchPaths) {
         if (gSearching){
-            auto result = searchPlugins(path, excludePaths, timeout, parallel,
+            auto result = searchPlugins(path, excludePaths, timeout, parallel, incremental,
                                         (verbose && getVerbosity() >= 0));
             plugins.insert(plugins.end(), result.begin(), result.end());
         } else {
@@ -3164,6 +3835,20 @@ bool cmdSearch(World *inWorld, void* cmdData) {
         return getPluginDict().findPlugin(p->key()) != p;
     }), plugins.end());
 #endif
+    // serialize plugin info; skip plugins whose info can't be loaded
+    // from the cache file anymore, see PluginDesc::loadTables().
+    std::stringstream ss;
+    int numPlugins = 0;
+    if (data->path[0] || data->bufnum >= 0) {
+        for (auto& plugin : plugins) {
+            try {
+                serializePlugin(ss, *plugin);
+                numPlugins++;
+            } catch (const Error& e) {
+                LOG_ERROR(e.what());
+            }
+        }
+    }
     // write new info to file (only for local Servers) or buffer
     if (data->path[0]) {
         // write to file
@@ -3171,10 +3856,8 @@ bool cmdSearch(World *inWorld, void* cmdData) {
         if (file.is_open()) {
             LOG_DEBUG("writing plugin info to file");
             file << "[plugins]\n";
-            file << "n=" << plugins.size() << "\n";
-            for (auto& plugin : plugins) {
-                serializePlugin(file, *plugin);
-            }
+            file << "n=" << numPlugins << "\n";
+            file << ss.rdbuf();
         } else {
             LOG_ERROR("couldn't write plugin info file '" << data->path << "'!");
         }
@@ -3184,14 +3867,8 @@ bool cmdSearch(World *inWorld, void* cmdData) {
         // free old buffer data in stage 4.
         // usually, the buffer should be already empty.
         data->freeData = buf->data;
-        std::stringstream ss;
         LOG_DEBUG("writing plugin info to buffer");
-        ss << "[plugins]\n";
-        ss << "n=" << plugins.size() << "\n";
-        for (auto& plugin : plugins) {
-            serializePlugin(ss, *plugin);
-        }
-        allocReadBuffer(buf, ss.str());
+        allocReadBuffer(buf, "[plugins]\nn=" + std::to_string(numPlugins) + "\n" + ss.str());
     }
     // else do nothing
 
@@ -3324,6 +4001,9 @@ void vst_clear(World* inWorld, void* inUserData, struct sc_msg_iter* args, void*
             if (flags & 1) {
                 // remove cache file
                 removeFile(gSettingsDir + "/" + gCacheFileName);
+                if (pathExists(gSettingsDir + "/" + gTextCacheFileName)) {
+                    removeFile(gSettingsDir + "/" + gTextCacheFileName);
+                }
             }
             getPluginDict().clear();
             return false;
@@ -3445,9 +4125,71 @@ void vst_query(World *inWorld, void* inUserData, struct sc_msg_iter *args, void
 
 void vst_dsp_threads(World *inWorld, void* inUserData, struct sc_msg_iter *args, void *replyAddr) {
     int numThreads = args->geti();
+    // optional scheduler argument
+    int scheduler = args->geti(-1);
+    if (scheduler >= 0) {
+        if (scheduler <= (int)DSPScheduler::Affinity) {
+            setDSPScheduler(static_cast<DSPScheduler>(scheduler));
+        } else {
+            LOG_ERROR("vst_dsp_threads: unknown scheduler " << scheduler);
+        }
+    }
+    // optional wait policy arguments (-1 = don't change)
+    int waitMode = args->geti(-1);
+    if (waitMode >= 0) {
+        float spin = args->getf();
+        float yield = args->getf();
+        // seconds resp. fractions of the block period (adaptive)
+        setDSPWaitPolicy(spin, yield, waitMode > 0);
+    }
+    // optional affinity arguments
+    if (args->remain() > 0) {
+        DSPThreadAffinity affinity;
+        affinity.skipSMT = args->geti();
+        affinity.numaNode = args->geti(-1);
+        int numCpus = args->geti();
+        for (int i = 0; i < numCpus; ++i) {
+            affinity.cpus.push_back(args->geti());
+        }
+        int numExclude = args->geti();
+        for (int i = 0; i < numExclude; ++i) {
+            affinity.exclude.push_back(args->geti());
+        }
+        affinity.numaPools = args->geti(0);
+        setDSPThreadAffinity(affinity);
+    }
     setNumDSPThreads(numThreads);
 }
 
+void vst_bridge_pool(World *inWorld, void* inUserData, struct sc_msg_iter *args, void *replyAddr) {
+    int size = args->geti();
+    setBridgePoolSize(size > 0 ? size : 0);
+}
+
+void vst_bridge_spin(World *inWorld, void* inUserData, struct sc_msg_iter *args, void *replyAddr) {
+    int count = args->geti();
+    setBridgeSpinCount(count > 0 ? count : 0);
+}
+
+void vst_module_cache(World *inWorld, void* inUserData, struct sc_msg_iter *args, void *replyAddr) {
+    int size = args->geti();
+    setModuleCacheSize(size > 0 ? size : 0);
+}
+
+void vst_async_threads(World *inWorld, void* inUserData, struct sc_msg_iter *args, void *replyAddr) {
+    auto data = (int *)RTAlloc(inWorld, sizeof(int));
+    if (data) {
+        *data = args->geti();
+        // threads must be created on the NRT thread
+        DoAsynchronousCommand(inWorld, replyAddr, "vst_async_threads", data, [](World*, void* data) {
+            CmdExecutor::instance().setNumThreads(*static_cast<int *>(data));
+            return false;
+        }, 0, 0, RTFree, 0, 0);
+    } else {
+        LOG_ERROR("RTAlloc failed!");
+    }
+}
+
 /*** plugin entry point ***/
 
 using VSTUnitCmdFunc = void (*)(VSTPlugin*, sc_msg_iter*);
@@ -3507,6 +4249,12 @@ PluginLoad(VSTPlugin) {
     UnitCmd(close);
     UnitCmd(reset);
     UnitCmd(mode);
+    UnitCmd(silence);
+    UnitCmd(coalesce);
+    UnitCmd(crossfade);
+    UnitCmd(cpu_meter);
+    UnitCmd(cpu);
+    UnitCmd(dsp_wait_stats);
 
     UnitCmd(vis);
     UnitCmd(pos);
@@ -3520,6 +4268,7 @@ PluginLoad(VSTPlugin) {
     UnitCmd(map);
     UnitCmd(mapa);
     UnitCmd(unmap);
+    UnitCmd(automation_interval);
 
     UnitCmd(program_set);
     UnitCmd(program_query);
@@ -3528,6 +4277,10 @@ PluginLoad(VSTPlugin) {
     UnitCmd(program_write);
     UnitCmd(bank_read);
     UnitCmd(bank_write);
+    UnitCmd(snapshot_save);
+    UnitCmd(snapshot_recall);
+    UnitCmd(snapshot_morph);
+    UnitCmd(snapshot_clear);
 
     UnitCmd(midi_msg);
     UnitCmd(midi_sysex);
@@ -3548,6 +4301,10 @@ PluginLoad(VSTPlugin) {
     PluginCmd(vst_query);
 
     PluginCmd(vst_dsp_threads);
+    PluginCmd(vst_bridge_pool);
+    PluginCmd(vst_bridge_spin);
+    PluginCmd(vst_module_cache);
+    PluginCmd(vst_async_threads);
 
     setLogFunction(SCLog);
 
@@ -3566,6 +4323,8 @@ C_LINKAGE SC_API_EXPORT void unload() {
     // This makes sure that all plugin factories are released here and not
     // in the global object destructor (which can cause crashes or deadlocks!)
     gPluginDict.clear();
+    // also unload modules which are only kept alive by the module cache
+    setModuleCacheSize(0);
 }
 
 
@@ -4,7 +4,12 @@
 
 #include "Interface.h"
 #include "PluginDictionary.h"
+#include "SearchEngine.h"
 #include "FileUtils.h"
+#include "Kernels.h"
+#include "DSPLoad.h"
+#include "Reblocker.h"
+#include "Snapshot.h"
 #include "MiscUtils.h"
 #include "Lockfree.h"
 #include "Log.h"
@@ -13,12 +18,15 @@
 
 using namespace vst;
 
+#include <algorithm>
 #include <bitset>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <memory>
 #include <string>
 #include <vector>
+#include <deque>
 #include <unordered_map>
 #include <fstream>
 #include <sstream>
@@ -81,6 +89,22 @@ public:
     void reset(bool async);
     void doReset();
 
+    void setSilenceMode(int mode);
+    void setParameterCoalescing(bool enable);
+    void setCrossfade(float ms);
+    // previous plugin during a crossfade, see doneOpen()
+    IPlugin *fadePlugin() const { return fadePlugin_.get(); }
+    void stopFade();
+
+    // DSP load metering
+    void setDSPLoadMetering(bool enable);
+    void getDSPLoad(bool reset);
+    // global DSP wait statistics, see setDSPWaitPolicy()
+    void getDSPWaitStats(bool reset);
+    // true if the plugin doesn't measure itself, see IPlugin::setDSPLoadMeter()
+    bool measureDSPLoad() const { return dspLoadHost_; }
+    DSPLoadMeter& dspLoadMeter() { return dspLoad_; }
+
     // param
     void setParam(int32 index, float value);
     void setParam(int32 index, const char* display);
@@ -97,11 +121,18 @@ public:
     void queryPrograms(int32 index, int32 count);
     template<bool bank, typename T>
     void readPreset(T dest, bool async);
-    void doReadPreset(const std::string& data, bool bank);
+    void doReadPreset(std::string_view data, bool bank);
     template<bool bank, typename T>
     void writePreset(T dest, bool async);
     void doWritePreset(std::string& buffer, bool bank);
 
+    // snapshots
+    void saveSnapshot(int32 slot);
+    void recallSnapshot(int32 slot, bool full);
+    void morphSnapshots(int32 slotA, int32 slotB, float x);
+    void clearSnapshot(int32 slot);
+    SnapshotStore* snapshots() { return snapshots_.get(); }
+
     // midi
     void sendMidiMsg(int32 status, int32 data1, int32 data2, float detune = 0.f);
     void sendSysexMsg(const char* data, int32 n);
@@ -126,6 +157,7 @@ public:
     bool sendProgramName(int32 num); // unchecked
     void sendCurrentProgramName();
     void sendParameter(int32 index, float value); // unchecked
+    void sendParameter(int32 index, float value, std::string_view display); // unchecked
     void sendParameterAutomated(int32 index, float value); // unchecked
     int32 latencySamples() const;
     void sendLatencyChange(int nsamples);
@@ -148,6 +180,21 @@ private:
     VSTPlugin *owner_ = nullptr;
     World* world_ = nullptr;
     IPlugin::ptr plugin_;
+    // created/destroyed in the NRT thread together with the plugin
+    std::unique_ptr<SnapshotStore> snapshots_;
+    // crossfade on reopening, see doneOpen()
+    IPlugin::ptr fadePlugin_;
+    std::unique_ptr<SnapshotStore> fadeSnapshots_;
+    bool fadeEditor_ = false;
+    float fadeTime_ = 0; // ms
+    bool startFade();
+    bool releasePlugin(IPlugin::ptr&& plugin,
+                       std::unique_ptr<SnapshotStore>&& snapshots, bool editor);
+    // DSP load metering; NB: the meter is unset before the plugin is closed.
+    DSPLoadMeter dspLoad_;
+    bool dspLoadEnabled_ = false;
+    bool dspLoadHost_ = false;
+    void setupDSPLoad();
     bool editor_ = false;
     bool threaded_ = false;
     bool isLoading_ = false;
@@ -280,6 +327,8 @@ public:
 
     int reblockPhase() const;
 
+    int reblockLatency() const;
+
     struct Bus {
         float **channelData = nullptr;
         int numChannels = 0;
@@ -302,8 +351,13 @@ public:
     void unmap(int32 index);
     void clearMapping();
 
+    void setAutomationInterval(int samples);
+
     void setupPlugin(const int *inputs, int numInputs,
                      const int *outputs, int numOutputs);
+
+    bool beginFade(int length);
+    void freeFade();
 private:
     void setInvalid() { mSpecialIndex &= ~Valid; }
 
@@ -314,12 +368,19 @@ private:
                       const int *speakers, int numSpeakers, float *dummy);
 
     void initReblocker(int reblockSize);
-    bool updateReblocker(int numSamples);
+    void performReblock(IPlugin *plugin, ProcessData *data, int numSamples);
+    void processPlugin(IPlugin *plugin, ProcessData& data);
     void freeReblocker();
 
+    void performFade(IPlugin *plugin, int numSamples);
+    bool mixFade(int numSamples);
+
     void performBypass(const Bus *ugenInputs, int numInputs,
                        int numSamples, int phase);
 
+    float automateAudioRate(IPlugin *plugin, int index, const float *buf,
+                            int numSamples, int sampleOffset, float last);
+
     static const int Initialized = 1;
     static const int UnitCmdQueued = 2;
     static const int Valid = 4;
@@ -347,8 +408,7 @@ private:
     float *dummyBuffer_ = nullptr;
 
     struct Reblock {
-        int blockSize;
-        int phase;
+        Reblocker reblocker;
         int numInputs;
         int numOutputs;
         Bus *inputs;
@@ -358,6 +418,21 @@ private:
 
     Reblock *reblock_ = nullptr;
 
+    // The previous plugin keeps processing the UGen inputs into its own output
+    // buffers, which are then crossfaded with the outputs of the current plugin.
+    struct Fade {
+        AudioBus *inputs; // previous plugin input busses
+        int numInputs;
+        AudioBus *outputs; // previous plugin output busses
+        int numOutputs;
+        const float **sources; // previous plugin output per (flat) UGen output; NULL: none
+        float *buffer;
+        int length; // in samples
+        int pos;
+    };
+
+    Fade *fade_ = nullptr;
+
     int numParameterControls_ = 0;
     Wire ** parameterControls_ = nullptr;
 
@@ -385,6 +460,9 @@ private:
     Mapping* paramMappingList_ = nullptr;
     float* paramState_ = nullptr;
     Mapping** paramMapping_ = nullptr;
+    // audio rate automation is decimated to every n-th sample;
+    // 0 means one parameter change per block.
+    int automationInterval_ = 16;
     Bypass bypass_ = Bypass::Off;
 
     void printMapping();
@@ -398,10 +476,64 @@ struct CmdData {
 
     VSTPluginDelegatePtr owner;
     bool alive() const;
+    // stage 2 doesn't touch any NRT resources (e.g. buffers),
+    // so it may run on the CmdExecutor, see doCmd().
+    bool offload = false;
+    // CmdExecutor state
+    struct ExecState {
+        AsyncStageFn stage2 = nullptr;
+        AsyncStageFn stage3 = nullptr;
+        AsyncStageFn stage4 = nullptr;
+        AsyncFreeFn cleanup = nullptr;
+        bool result = false; // return value of stage 2
+        std::atomic<bool> done{false};
+    } exec;
+};
+
+// Optional background executor for the NRT stage of async commands.
+// Slow commands (e.g. opening a plugin) would otherwise block the NRT thread
+// and delay all other asynchronous commands of the Server (/b_alloc, /d_recv, etc.)
+//
+// Commands of the same VSTPlugin instance are executed in order. 'offload'
+// commands run on one of the worker threads, the others run on the NRT thread
+// once all preceding commands of the same instance have finished.
+// The RT thread polls for completion and then continues with the remaining stages.
+class CmdExecutor {
+public:
+    static constexpr int maxNumThreads = 16;
+
+    static CmdExecutor& instance();
+
+    // 0: disabled (default).
+    // NB: must be called on the NRT thread!
+    void setNumThreads(int numThreads);
+    bool enabled() const {
+        return numThreads_.load(std::memory_order_relaxed) > 0;
+    }
+    // NB: the following methods must be called on the NRT thread!
+    void push(CmdData* cmd);
+    void poll(CmdData* cmd);
+private:
+    void threadFunction(int index);
+    // NB: called with locked mutex
+    void run(VSTPluginDelegate* owner, std::unique_lock<std::mutex>& lock);
+
+    struct Queue {
+        std::deque<CmdData*> cmds;
+        bool busy = false; // the first command is currently running
+    };
+    std::unordered_map<VSTPluginDelegate*, Queue> queues_;
+    // instances whose first command is ready to run on a worker thread
+    std::deque<VSTPluginDelegate*> ready_;
+    std::vector<std::thread> threads_;
+    std::atomic<int> numThreads_{0}; // active threads
+    std::mutex mutex_;
+    std::condition_variable condition_;
 };
 
 struct CloseCmdData : CmdData {
     IPlugin::ptr plugin;
+    std::unique_ptr<SnapshotStore> snapshots;
     bool editor;
 };
 
@@ -409,6 +541,7 @@ struct CloseCmdData : CmdData {
 // the VSTPlugin instance during the async command.
 struct OpenCmdData : CmdData {
     IPlugin::ptr plugin;
+    std::unique_ptr<SnapshotStore> snapshots;
     bool editor;
     bool threaded;
     RunMode runMode;
@@ -458,6 +591,11 @@ struct VendorCmdData : CmdData {
     char data[1];
 };
 
+struct SnapshotCmdData : CmdData {
+    int32 slot;
+    int result = 0;
+};
+
 struct PresetCmdData : CmdData {
     static PresetCmdData* create(World* world, const char* path, bool async = false);
     static PresetCmdData* create(World* world, int bufnum, bool async = false);
@@ -475,6 +613,7 @@ namespace SearchFlags {
     const int verbose = 1;
     const int save = 2;
     const int parallel = 4;
+    const int incremental = 8;
 }
 
 struct SearchCmdData {
@@ -0,0 +1,573 @@
+#include "Interface.h"
+#include "PluginDesc.h"
+#include "Log.h"
+#include "MiscUtils.h"
+#include "FileUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// End-to-end benchmark for the different processing modes.
+//
+// Measures the cost of IPlugin::process() per block - as seen by the host -
+// for the built-in dummy plugin and any number of real plugins, across block
+// sizes, channel counts and sample precisions. Real plugins are run directly,
+// threaded (ThreadedPlugin on the DSP thread pool), bridged and sandboxed;
+// the dummy plugin only runs directly and threaded because it can't be
+// loaded in a subprocess.
+//
+// Results are printed to stdout; with -o <file> they are also written as JSON,
+// so that they can be compared between releases.
+
+using namespace vst;
+
+namespace vst {
+// see ThreadedPlugin.cpp
+IPlugin::ptr createThreadedPlugin(IPlugin::ptr plugin);
+} // vst
+
+constexpr double sampleRate = 48000;
+
+enum class Mode {
+    Direct,
+    Threaded,
+    Bridge,
+    Sandbox
+};
+
+const Mode allModes[] = { Mode::Direct, Mode::Threaded, Mode::Bridge, Mode::Sandbox };
+
+struct Options {
+    std::vector<int> blockSizes { 64, 256, 1024 };
+    std::vector<int> channels { 2, 8 };
+    std::vector<ProcessPrecision> precisions { ProcessPrecision::Single, ProcessPrecision::Double };
+    std::vector<Mode> modes { std::begin(allModes), std::end(allModes) };
+    int numBlocks = 2000;
+    int numWarmup = 64;
+    int numThreads = 0; // default
+    int work = 4; // dummy plugin: filter stages per sample
+    std::string output;
+    std::vector<std::string> plugins;
+};
+
+const char *modeName(Mode mode) {
+    switch (mode) {
+    case Mode::Direct:
+        return "direct";
+    case Mode::Threaded:
+        return "threaded";
+    case Mode::Bridge:
+        return "bridge";
+    case Mode::Sandbox:
+        return "sandbox";
+    default:
+        return "?";
+    }
+}
+
+const char *precisionName(ProcessPrecision precision) {
+    return precision == ProcessPrecision::Double ? "double" : "single";
+}
+
+/*//////////////////////// DummyPlugin ///////////////////////*/
+
+// a simple effect with a configurable amount of work per sample
+class DummyPlugin final : public IPlugin {
+ public:
+    DummyPlugin(const PluginDesc& desc, int work)
+        : desc_(desc), work_(work) {}
+
+    const PluginDesc& info() const override { return desc_; }
+
+    void setupProcessing(double sampleRate, int maxBlockSize,
+                         ProcessPrecision precision, ProcessMode mode) override {}
+
+    void process(ProcessData& data) override {
+        if (data.precision == ProcessPrecision::Double) {
+            doProcess<double>(data);
+        } else {
+            doProcess<float>(data);
+        }
+    }
+
+    void suspend() override {}
+    void resume() override {
+        std::fill(state_.begin(), state_.end(), 0.0);
+    }
+    void setBypass(Bypass state) override {}
+    void setSilenceMode(SilenceMode mode) override {}
+    void setNumSpeakers(int *input, int numInputs, int *output, int numOutputs) override {
+        int nin = numInputs > 0 ? input[0] : 0;
+        int nout = numOutputs > 0 ? output[0] : 0;
+        state_.assign(std::max(nin, nout) * work_, 0.0);
+    }
+    int getLatencySamples() override { return 0; }
+
+    void setListener(IPluginListener* listener) override {}
+
+    void setTempoBPM(double tempo) override {}
+    void setTimeSignature(int numerator, int denominator) override {}
+    void setTransportPlaying(bool play) override {}
+    void setTransportRecording(bool record) override {}
+    void setTransportAutomationWriting(bool writing) override {}
+    void setTransportAutomationReading(bool reading) override {}
+    void setTransportCycleActive(bool active) override {}
+    void setTransportCycleStart(double beat) override {}
+    void setTransportCycleEnd(double beat) override {}
+    void setTransportPosition(double beat) override {}
+    double getTransportPosition() const override { return 0; }
+
+    void sendMidiEvent(const MidiEvent& event) override {}
+    void sendSysexEvent(const SysexEvent& event) override {}
+
+    void setParameter(int index, float value, int sampleOffset) override {}
+    bool setParameter(int index, std::string_view str, int sampleOffset) override {
+        return false;
+    }
+    float getParameter(int index) const override { return 0; }
+    size_t getParameterString(int index, ParamStringBuffer& buffer) const override {
+        buffer[0] = '\0';
+        return 0;
+    }
+
+    void setProgram(int index) override {}
+    void setProgramName(std::string_view name) override {}
+    int getProgram() const override { return 0; }
+    std::string getProgramName() const override { return ""; }
+    std::string getProgramNameIndexed(int index) const override { return ""; }
+
+    void readProgramFile(const std::string& path) override { throw Error("not supported"); }
+    void readProgramData(const char *data, size_t size) override { throw Error("not supported"); }
+    void writeProgramFile(const std::string& path) override { throw Error("not supported"); }
+    void writeProgramData(std::string& buffer) override { throw Error("not supported"); }
+    void readBankFile(const std::string& path) override { throw Error("not supported"); }
+    void readBankData(const char *data, size_t size) override { throw Error("not supported"); }
+    void writeBankFile(const std::string& path) override { throw Error("not supported"); }
+    void writeBankData(std::string& buffer) override { throw Error("not supported"); }
+
+    void openEditor(void *window) override {}
+    void closeEditor() override {}
+    bool getEditorRect(Rect& rect) const override { return false; }
+    void updateEditor() override {}
+    void checkEditorSize(int& width, int& height) const override {}
+    void resizeEditor(int width, int height) override {}
+
+    IWindow* getWindow() const override { return nullptr; }
+ private:
+    template<typename T>
+    void doProcess(ProcessData& data) {
+        if (data.numOutputs < 1) {
+            return;
+        }
+        auto& out = data.outputs[0];
+        int nin = data.numInputs > 0 ? data.inputs[0].numChannels : 0;
+        for (int i = 0; i < out.numChannels; ++i) {
+            auto dst = (T *)out.channelData32[i];
+            auto src = i < nin ? (const T *)data.inputs[0].channelData32[i] : nullptr;
+            auto state = &state_[i * work_];
+            for (int j = 0; j < data.numSamples; ++j) {
+                // a cascade of one-pole lowpass filters
+                double x = src ? src[j] : 0.0;
+                for (int k = 0; k < work_; ++k) {
+                    x = state[k] = state[k] + (x - state[k]) * 0.5;
+                }
+                dst[j] = x;
+            }
+        }
+    }
+
+    const PluginDesc& desc_;
+    int work_;
+    std::vector<double> state_;
+};
+
+/*//////////////////////// Benchmark ///////////////////////*/
+
+struct Result {
+    std::string plugin;
+    Mode mode;
+    ProcessPrecision precision;
+    int blockSize;
+    int numInputs;
+    int numOutputs;
+    int numBlocks;
+    // all times in microseconds
+    double mean;
+    double min;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+    double load; // mean time in percent of the block period
+};
+
+// process buffers for a plugin with a single input and output bus
+class Buffers {
+ public:
+    Buffers(int numInputs, int numOutputs, int blockSize, ProcessPrecision precision) {
+        auto samplesize = precision == ProcessPrecision::Double ? sizeof(double) : sizeof(float);
+        auto chansize = samplesize * blockSize;
+        buffer_.resize((numInputs + numOutputs) * chansize);
+        auto buf = buffer_.data();
+        for (int i = 0; i < numInputs + numOutputs; ++i) {
+            ptrs_.push_back((float*)(buf + i * chansize));
+        }
+        // fill inputs with noise
+        uint32_t seed = 1;
+        for (int i = 0; i < numInputs; ++i) {
+            for (int j = 0; j < blockSize; ++j) {
+                seed = seed * 1664525 + 1013904223;
+                double x = (double)seed / 4294967296.0 * 2.0 - 1.0;
+                if (precision == ProcessPrecision::Double) {
+                    ((double *)ptrs_[i])[j] = x;
+                } else {
+                    ptrs_[i][j] = x;
+                }
+            }
+        }
+        input_.numChannels = numInputs;
+        input_.channelData32 = ptrs_.data();
+        output_.numChannels = numOutputs;
+        output_.channelData32 = ptrs_.data() + numInputs;
+
+        data_.inputs = &input_;
+        data_.outputs = &output_;
+        // NB: some plugins don't have an input bus at all
+        data_.numInputs = 1;
+        data_.numOutputs = 1;
+        data_.numSamples = blockSize;
+        data_.precision = precision;
+        data_.mode = ProcessMode::Realtime;
+    }
+
+    ProcessData& data() { return data_; }
+ private:
+    std::vector<char> buffer_;
+    std::vector<float *> ptrs_;
+    AudioBus input_;
+    AudioBus output_;
+    ProcessData data_;
+};
+
+double percentile(const std::vector<double>& sorted, double p) {
+    auto index = (size_t)std::round(p * 0.01 * (sorted.size() - 1));
+    return sorted[index];
+}
+
+Result runBenchmark(IPlugin& plugin, const std::string& name, Mode mode,
+                    ProcessPrecision precision, int blockSize, int channels,
+                    const Options& options) {
+    auto& info = plugin.info();
+    // request the given number of channels for the main busses
+    std::vector<int> inputs(std::max<int>(info.numInputs(), 1), 0);
+    std::vector<int> outputs(std::max<int>(info.numOutputs(), 1), 0);
+    inputs[0] = info.numInputs() > 0 ? channels : 0;
+    outputs[0] = channels;
+
+    plugin.suspend();
+    plugin.setupProcessing(sampleRate, blockSize, precision, ProcessMode::Realtime);
+    plugin.setNumSpeakers(inputs.data(), 1, outputs.data(), 1);
+    plugin.resume();
+
+    Buffers buffers(inputs[0], outputs[0], blockSize, precision);
+    auto& data = buffers.data();
+
+    using clock = std::chrono::high_resolution_clock;
+
+    std::vector<double> times;
+    times.reserve(options.numBlocks);
+
+    for (int i = 0; i < options.numWarmup + options.numBlocks; ++i) {
+        auto t1 = clock::now();
+        plugin.process(data);
+        auto t2 = clock::now();
+        if (i >= options.numWarmup) {
+            times.push_back(std::chrono::duration<double, std::micro>(t2 - t1).count());
+        }
+    }
+
+    plugin.suspend();
+
+    Result result;
+    result.plugin = name;
+    result.mode = mode;
+    result.precision = precision;
+    result.blockSize = blockSize;
+    result.numInputs = inputs[0];
+    result.numOutputs = outputs[0];
+    result.numBlocks = times.size();
+
+    double sum = 0;
+    for (auto& t : times) {
+        sum += t;
+    }
+    std::sort(times.begin(), times.end());
+    result.mean = sum / times.size();
+    result.min = times.front();
+    result.p50 = percentile(times, 50);
+    result.p90 = percentile(times, 90);
+    result.p99 = percentile(times, 99);
+    result.max = times.back();
+    auto period = blockSize / sampleRate * 1000000.0; // microseconds
+    result.load = result.mean / period * 100.0;
+
+    return result;
+}
+
+void printResult(const Result& r) {
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "%-20.20s %-8s %-6s %5d %3d/%-3d | mean %9.2f min %9.2f p50 %9.2f "
+             "p90 %9.2f p99 %9.2f max %9.2f us | %6.2f%%",
+             r.plugin.c_str(), modeName(r.mode), precisionName(r.precision),
+             r.blockSize, r.numInputs, r.numOutputs,
+             r.mean, r.min, r.p50, r.p90, r.p99, r.max, r.load);
+    std::cout << buf << std::endl;
+}
+
+std::string jsonString(const std::string& s) {
+    std::string result = "\"";
+    for (auto c : s) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            result += buf;
+        } else {
+            result += c;
+        }
+    }
+    result += "\"";
+    return result;
+}
+
+bool writeResults(const std::string& path, const std::vector<Result>& results,
+                  const Options& options) {
+    File file(path, File::WRITE);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << "{\n";
+    file << "  \"version\": \"" << getVersionString() << "\",\n";
+    file << "  \"samplerate\": " << sampleRate << ",\n";
+    file << "  \"threads\": " << options.numThreads << ",\n";
+    file << "  \"blocks\": " << options.numBlocks << ",\n";
+    file << "  \"unit\": \"us\",\n";
+    file << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        auto& r = results[i];
+        file << (i > 0 ? ",\n" : "\n")
+             << "    { \"plugin\": " << jsonString(r.plugin)
+             << ", \"mode\": \"" << modeName(r.mode) << "\""
+             << ", \"precision\": \"" << precisionName(r.precision) << "\""
+             << ", \"blocksize\": " << r.blockSize
+             << ", \"inputs\": " << r.numInputs
+             << ", \"outputs\": " << r.numOutputs
+             << ", \"mean\": " << r.mean
+             << ", \"min\": " << r.min
+             << ", \"p50\": " << r.p50
+             << ", \"p90\": " << r.p90
+             << ", \"p99\": " << r.p99
+             << ", \"max\": " << r.max
+             << ", \"load\": " << r.load << " }";
+    }
+    file << "\n  ]\n}\n";
+    return (bool)file;
+}
+
+/*//////////////////////// main ///////////////////////*/
+
+template<typename T, typename Fn>
+std::vector<T> parseList(const char *arg, Fn&& fn) {
+    std::vector<T> result;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            result.push_back(fn(item));
+        }
+    }
+    return result;
+}
+
+void usage() {
+    std::cout << "usage: benchmark [options] [plugin paths...]\n"
+              << "  -b <list>   block sizes (default: 64,256,1024)\n"
+              << "  -c <list>   channel counts (default: 2,8)\n"
+              << "  -p <list>   precisions: single, double (default: both)\n"
+              << "  -m <list>   modes: direct, threaded, bridge, sandbox (default: all)\n"
+              << "  -n <count>  number of blocks (default: 2000)\n"
+              << "  -t <count>  number of DSP threads (default: number of cores)\n"
+              << "  -w <count>  dummy plugin: filter stages per sample (default: 4)\n"
+              << "  -o <file>   write results as JSON\n";
+}
+
+bool parseOptions(int argc, const char *argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.size() == 2 && arg[0] == '-') {
+            if (++i >= argc) {
+                return false;
+            }
+            auto value = argv[i];
+            auto toInt = [](const std::string& s) { return std::stoi(s); };
+            switch (arg[1]) {
+            case 'b':
+                options.blockSizes = parseList<int>(value, toInt);
+                break;
+            case 'c':
+                options.channels = parseList<int>(value, toInt);
+                break;
+            case 'p':
+                options.precisions = parseList<ProcessPrecision>(value, [](const std::string& s) {
+                    if (s == "single") {
+                        return ProcessPrecision::Single;
+                    } else if (s == "double") {
+                        return ProcessPrecision::Double;
+                    } else {
+                        throw Error("bad precision '" + s + "'");
+                    }
+                });
+                break;
+            case 'm':
+                options.modes = parseList<Mode>(value, [](const std::string& s) {
+                    for (auto mode : allModes) {
+                        if (s == modeName(mode)) {
+                            return mode;
+                        }
+                    }
+                    throw Error("bad mode '" + s + "'");
+                });
+                break;
+            case 'n':
+                options.numBlocks = std::max(toInt(value), 1);
+                break;
+            case 't':
+                options.numThreads = std::max(toInt(value), 0);
+                break;
+            case 'w':
+                options.work = std::max(toInt(value), 0);
+                break;
+            case 'o':
+                options.output = value;
+                break;
+            default:
+                return false;
+            }
+        } else {
+            options.plugins.push_back(arg);
+        }
+    }
+    return true;
+}
+
+void runPlugin(IPlugin& plugin, const std::string& name, Mode mode,
+               const Options& options, std::vector<Result>& results) {
+    for (auto precision : options.precisions) {
+        if (!plugin.info().hasPrecision(precision)) {
+            LOG_VERBOSE(name << ": " << precisionName(precision)
+                        << " precision not supported");
+            continue;
+        }
+        for (auto blockSize : options.blockSizes) {
+            for (auto channels : options.channels) {
+                auto result = runBenchmark(plugin, name, mode, precision,
+                                           blockSize, channels, options);
+                printResult(result);
+                results.push_back(result);
+            }
+        }
+    }
+}
+
+int main(int argc, const char *argv[]) {
+    Options options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            usage();
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception& e) {
+        std::cout << "error: " << e.what() << std::endl;
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    // must be set before the DSP thread pool is created
+    if (options.numThreads > 0) {
+        setNumDSPThreads(options.numThreads);
+    }
+    setThreadPriority(Priority::High);
+
+    UIThread::setup();
+
+    std::vector<Result> results;
+
+    // built-in dummy plugin
+    PluginDesc dummyDesc(nullptr);
+    dummyDesc.name = "dummy";
+    dummyDesc.flags = PluginDesc::SinglePrecision | PluginDesc::DoublePrecision;
+    dummyDesc.inputs().push_back(PluginDesc::Bus());
+    dummyDesc.outputs().push_back(PluginDesc::Bus());
+
+    for (auto mode : options.modes) {
+        if (mode == Mode::Direct || mode == Mode::Threaded) {
+            IPlugin::ptr plugin = std::make_unique<DummyPlugin>(dummyDesc, options.work);
+            if (mode == Mode::Threaded) {
+                plugin = createThreadedPlugin(std::move(plugin));
+            }
+            runPlugin(*plugin, "dummy", mode, options, results);
+        }
+    }
+
+    // real plugins
+    for (auto& path : options.plugins) {
+        try {
+            auto factory = IFactory::load(path);
+            factory->probe([&](const ProbeResult& result) {
+                if (!result.valid()) {
+                    LOG_ERROR(path << ": probe failed: " << result.error.what());
+                }
+            }, 30.0);
+            if (!factory->valid()) {
+                continue;
+            }
+            auto desc = factory->getPlugin(0);
+            for (auto mode : options.modes) {
+                try {
+                    bool threaded = mode == Mode::Threaded;
+                    auto runMode = (mode == Mode::Bridge) ? RunMode::Bridge :
+                        (mode == Mode::Sandbox) ? RunMode::Sandbox : RunMode::Native;
+                    auto plugin = desc->create(false, threaded, runMode);
+                    runPlugin(*plugin, desc->name, mode, options, results);
+                } catch (const Error& e) {
+                    LOG_ERROR(desc->name << " (" << modeName(mode) << "): " << e.what());
+                }
+                UIThread::poll();
+            }
+        } catch (const Error& e) {
+            LOG_ERROR(path << ": " << e.what());
+        }
+    }
+
+    if (!options.output.empty()) {
+        if (writeResults(options.output, results, options)) {
+            LOG_VERBOSE("wrote results to " << options.output);
+        } else {
+            LOG_ERROR("couldn't write results to " << options.output);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
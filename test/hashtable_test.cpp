@@ -1,5 +1,6 @@
 #include "HashTable.h"
 
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
 #include <random>
@@ -74,7 +75,116 @@ int main(int argc, const char *argv[]) {
         }
     }
 
+    // test DenseHashTable with sequential, sparse and random keys
+    auto testDense = [&](const char *name, auto makeKey, bool expectFrozen) {
+        vst::DenseHashTable<uint32_t, int> table;
+        std::unordered_map<uint32_t, int> source;
+        for (int i = 0; i < (int)elementCount; ++i) {
+            auto key = makeKey(i);
+            source.emplace(key, i);
+            table.insert(key, i);
+        }
+        if (table.freeze() != expectFrozen) {
+            std::cout << name << ": unexpected freeze() result" << std::endl;
+            return false;
+        }
+        for (auto& [key, value] : source) {
+            auto result = table.find(key);
+            if (!result || *result != value) {
+                std::cout << name << ": could not find key " << key << "!" << std::endl;
+                return false;
+            }
+        }
+        for (size_t i = 0; i < elementCount; ++i) {
+            auto key = (uint32_t)randomInt(mt);
+            if (!source.count(key) && table.find(key)) {
+                std::cout << name << ": found key " << key << " that has not been inserted!" << std::endl;
+                return false;
+            }
+        }
+        // insert after freeze() must still work
+        uint32_t key;
+        do {
+            key = (uint32_t)randomInt(mt);
+        } while (source.count(key));
+        if (!table.insert(key, -1) || table.findOr(key, 0) != -1) {
+            std::cout << name << ": insert after freeze() failed!" << std::endl;
+            return false;
+        }
+        return true;
+    };
+
+    if (!testDense("sequential", [](int i) { return (uint32_t)i; }, true) ||
+        !testDense("offset", [](int i) { return (uint32_t)(i * 2 + 1000); }, true) ||
+        !testDense("random", [&](int) { return (uint32_t)randomInt(mt); }, false)) {
+        return EXIT_FAILURE;
+    }
+
     std::cout << "all tests succeeded!" << std::endl;
 
+    // benchmark lookups
+    using Clock = std::chrono::high_resolution_clock;
+    constexpr size_t lookupCount = 1000000;
+    constexpr size_t paramCount = 1000; // a typical (large) plugin
+
+    auto bench = [](const char *name, auto&& fn) {
+        auto t1 = Clock::now();
+        size_t found = 0;
+        for (size_t i = 0; i < lookupCount; ++i) {
+            found += fn(i);
+        }
+        auto t2 = Clock::now();
+        auto ns = std::chrono::duration<double, std::nano>(t2 - t1).count() / lookupCount;
+        std::cout << name << ": " << ns << " ns per lookup (" << found << " found)" << std::endl;
+    };
+
+    {
+        std::vector<std::string> keys;
+        std::unordered_map<std::string, int> stdMap;
+        vst::HashTable<std::string, int, std::string_view> table;
+        for (int i = 0; i < (int)paramCount; ++i) {
+            auto key = "Parameter " + std::to_string(i);
+            keys.push_back(key);
+            stdMap.emplace(key, i);
+            table.insert(key, i);
+        }
+        std::cout << "\nstring keys (" << paramCount << " parameters)" << std::endl;
+        bench("std::unordered_map", [&](size_t i) {
+            return stdMap.count(keys[i % paramCount]);
+        });
+        bench("vst::HashTable", [&](size_t i) {
+            return table.find(keys[i % paramCount]) != nullptr;
+        });
+    }
+
+    auto benchInt = [&](const char *name, auto makeKey) {
+        std::vector<uint32_t> keys;
+        std::unordered_map<uint32_t, int> stdMap;
+        vst::HashTable<uint32_t, int> table;
+        vst::DenseHashTable<uint32_t, int> dense;
+        for (int i = 0; i < (int)paramCount; ++i) {
+            auto key = makeKey(i);
+            keys.push_back(key);
+            stdMap.emplace(key, i);
+            table.insert(key, i);
+            dense.insert(key, i);
+        }
+        bool frozen = dense.freeze();
+        std::cout << "\n" << name << " integer keys (" << paramCount << " parameters, "
+                  << (frozen ? "dense" : "not dense") << ")" << std::endl;
+        bench("std::unordered_map", [&](size_t i) {
+            return stdMap.count(keys[i % paramCount]);
+        });
+        bench("vst::HashTable", [&](size_t i) {
+            return table.find(keys[i % paramCount]) != nullptr;
+        });
+        bench("vst::DenseHashTable", [&](size_t i) {
+            return dense.find(keys[i % paramCount]) != nullptr;
+        });
+    };
+
+    benchInt("sequential", [](int i) { return (uint32_t)i; });
+    benchInt("random", [&](int) { return (uint32_t)randomInt(mt); });
+
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,125 @@
+#include "Lockfree.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+constexpr int numProducers = 4;
+constexpr int itemsPerCycle = 200; // per producer, i.e. more than 64 items per cycle
+constexpr int cycleCount = 1000;
+constexpr size_t reserveCount = numProducers * itemsPerCycle;
+
+std::atomic<size_t> gNumAllocations{0};
+
+// counts allocations; NB: must not derive from std::allocator because
+// std::allocator<T>::rebind would drop the counting allocator!
+template<typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+    template<typename U>
+    CountingAllocator(const CountingAllocator<U>&) {}
+
+    T * allocate(size_t n) {
+        gNumAllocations.fetch_add(n, std::memory_order_relaxed);
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t) {
+        ::operator delete(p);
+    }
+
+    template<typename U>
+    bool operator==(const CountingAllocator<U>&) const { return true; }
+    template<typename U>
+    bool operator!=(const CountingAllocator<U>&) const { return false; }
+};
+
+struct Item {
+    int producer;
+    int index;
+};
+
+using Queue = vst::UnboundedMPSCQueue<Item, CountingAllocator<Item>>;
+
+// in every cycle, all producers push a burst of items concurrently,
+// then the consumer drains the queue and checks the FIFO order.
+bool runCycles(Queue& queue, const char *name) {
+    for (int cycle = 0; cycle < cycleCount; ++cycle) {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < numProducers; ++i) {
+            threads.emplace_back([&queue, i]() {
+                for (int j = 0; j < itemsPerCycle; ++j) {
+                    queue.push(Item { i, j });
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        int next[numProducers] = { 0 };
+        int count = 0;
+        Item item;
+        while (queue.pop(item)) {
+            if (item.index != next[item.producer]) {
+                std::cout << name << ": wrong order (producer " << item.producer
+                          << ", expected " << next[item.producer]
+                          << ", got " << item.index << ")" << std::endl;
+                return false;
+            }
+            next[item.producer]++;
+            count++;
+        }
+        if (count != numProducers * itemsPerCycle) {
+            std::cout << name << ": expected " << (numProducers * itemsPerCycle)
+                      << " items, got " << count << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, const char *argv[]) {
+    // 1. after reserve(), the queue must never allocate
+    {
+        Queue queue;
+        queue.reserve(reserveCount);
+        auto numAllocations = gNumAllocations.load();
+        if (numAllocations != reserveCount) {
+            std::cout << "reserve: expected " << reserveCount << " allocations, got "
+                      << numAllocations << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (!runCycles(queue, "reserve")) {
+            return EXIT_FAILURE;
+        }
+        numAllocations = gNumAllocations.load() - numAllocations;
+        if (numAllocations != 0) {
+            std::cout << "reserve: " << numAllocations << " allocations after reserve()!" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    // 2. without reserve(), recycled nodes must be reused, i.e. the
+    // number of nodes must not grow beyond the number of items in flight.
+    {
+        gNumAllocations.store(0);
+        Queue queue;
+        if (!runCycles(queue, "no reserve")) {
+            return EXIT_FAILURE;
+        }
+        auto numAllocations = gNumAllocations.load();
+        if (numAllocations > reserveCount) {
+            std::cout << "no reserve: " << numAllocations << " allocations for "
+                      << reserveCount << " items in flight!" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::cout << "all tests succeeded!" << std::endl;
+
+    return EXIT_SUCCESS;
+}
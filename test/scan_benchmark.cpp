@@ -0,0 +1,392 @@
+#include "Interface.h"
+#include "PluginDesc.h"
+#include "PluginDictionary.h"
+#include "ProbeWorker.h"
+#include "SearchEngine.h"
+#include "CpuArch.h"
+#include "FileUtils.h"
+#include "MiscUtils.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Plugin search benchmark
+//
+// Searches the given directories and probes all plugins - just like the
+// "search" method of [vstplugin~] resp. VSTPlugin.search - and reports where
+// the time goes:
+// - probe process launch overhead (spawn a probe worker and wait for the first reply)
+// - per-plugin factory load and probe latency, probe errors and timeouts
+// - serialization and cache file write/read times (binary and text format)
+//
+// The number of concurrent probe jobs can be set with -j, so the search
+// can be tuned for a specific machine.
+//
+// NB: the probe workers are spawned from the 'host' app, which must
+// be located in the same directory as this program!
+
+using namespace vst;
+
+using clock_type = std::chrono::steady_clock;
+
+double elapsedMs(clock_type::time_point start) {
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+struct Options {
+    std::vector<std::string> dirs;
+    int numJobs = 0; // default
+    float timeout = 10;
+    int numSpawns = 8;
+    std::string cachePath;
+    std::string output;
+};
+
+struct Stats {
+    double total = 0;
+    double min = 0;
+    double max = 0;
+    int count = 0;
+
+    void add(double t) {
+        min = count > 0 ? std::min(min, t) : t;
+        max = count > 0 ? std::max(max, t) : t;
+        total += t;
+        count++;
+    }
+
+    double mean() const {
+        return count > 0 ? total / count : 0;
+    }
+};
+
+// all times in milliseconds
+struct PluginResult {
+    std::string path;
+    double load = 0; // IFactory::load()
+    double probe = 0; // from IFactory::probeAsync() until the last probe result
+    int numPlugins = 0;
+    Error::ErrorCode error = Error::NoError;
+    std::string message;
+};
+
+struct Report {
+    Stats spawn;
+    std::vector<PluginResult> plugins;
+    double search = 0;
+    double writeBinary = 0;
+    double readBinary = 0;
+    double writeText = 0;
+    double readText = 0;
+    int numJobs = 0;
+};
+
+const char *errorName(Error::ErrorCode code) {
+    switch (code) {
+    case Error::NoError:
+        return "ok";
+    case Error::Crash:
+        return "crash";
+    case Error::SystemError:
+        return "system error";
+    case Error::ModuleError:
+        return "module error";
+    case Error::PluginError:
+        return "plugin error";
+    case Error::Timeout:
+        return "timeout";
+    default:
+        return "unknown error";
+    }
+}
+
+// spawn a probe worker and send a dummy request, so that we measure
+// the time until the process is actually up and running.
+void benchmarkSpawn(const Options& options, Report& report) {
+    for (int i = 0; i < options.numSpawns; ++i) {
+        try {
+            auto start = clock_type::now();
+            ProbeWorker worker(getHostCpuArchitecture());
+            worker.request("", PROBE_ALL_SUBPLUGINS); // fails immediately
+            auto [done, code] = worker.tryWait(options.timeout);
+            if (!done) {
+                throw Error(Error::Timeout, "probe worker timed out");
+            }
+            report.spawn.add(elapsedMs(start));
+            worker.terminate();
+        } catch (const Error& e) {
+            LOG_ERROR("couldn't spawn probe worker: " << e.what());
+            return;
+        }
+    }
+}
+
+void benchmarkSearch(const Options& options, PluginDictionary& dict, Report& report) {
+    ProbeWorkerPool::Session session; // keep workers alive during the search
+    SearchEngine engine(options.numJobs);
+    report.numJobs = engine.maxJobs();
+
+    auto start = clock_type::now();
+    {
+        // publish all updates at the end of the search
+        PluginDictionary::UpdateScope scope(dict);
+        for (auto& dir : options.dirs) {
+            engine.search(dir, [&](const std::string& path) -> SearchEngine::Job {
+                // NB: the index stays valid, but references to elements don't!
+                auto index = report.plugins.size();
+                report.plugins.emplace_back();
+                report.plugins[index].path = path;
+
+                auto t1 = clock_type::now();
+                IFactory::ptr factory;
+                ProbeFuture future;
+                try {
+                    factory = IFactory::load(path, true);
+                    report.plugins[index].load = elapsedMs(t1);
+                    t1 = clock_type::now();
+                    future = factory->probeAsync(options.timeout, true);
+                } catch (const Error& e) {
+                    auto& result = report.plugins[index];
+                    result.error = e.code();
+                    result.message = e.what();
+                    return nullptr;
+                }
+                return [&, path, index, t1, factory, future]() {
+                    auto& result = report.plugins[index];
+                    bool done = future([&](const ProbeResult& r) {
+                        if (!r.valid()) {
+                            result.error = r.error.code();
+                            result.message = r.error.what();
+                        }
+                    });
+                    if (done) {
+                        result.probe = elapsedMs(t1);
+                        result.numPlugins = factory->numPlugins();
+                        if (factory->valid()) {
+                            dict.addFactory(path, factory);
+                            for (int i = 0; i < factory->numPlugins(); ++i) {
+                                auto plugin = factory->getPlugin(i);
+                                dict.addPlugin(plugin->key(), plugin);
+                            }
+                        } else {
+                            dict.addException(path, result.error);
+                        }
+                    }
+                    return done;
+                };
+            });
+        }
+    }
+    report.search = elapsedMs(start);
+}
+
+void benchmarkCache(const Options& options, PluginDictionary& dict, Report& report) {
+    auto path = options.cachePath.empty() ?
+        getTmpDirectory() + "/vstplugin_scan_benchmark.cache" : options.cachePath;
+    auto textPath = path + ".txt";
+    try {
+        auto start = clock_type::now();
+        dict.write(path, PluginDictionary::CacheFormat::Binary);
+        report.writeBinary = elapsedMs(start);
+
+        start = clock_type::now();
+        PluginDictionary dict2;
+        dict2.read(path, false);
+        report.readBinary = elapsedMs(start);
+
+        start = clock_type::now();
+        dict.write(textPath, PluginDictionary::CacheFormat::Text);
+        report.writeText = elapsedMs(start);
+
+        start = clock_type::now();
+        PluginDictionary dict3;
+        dict3.read(textPath, false);
+        report.readText = elapsedMs(start);
+    } catch (const Error& e) {
+        LOG_ERROR("cache benchmark failed: " << e.what());
+    }
+    if (options.cachePath.empty()) {
+        removeFile(path);
+        removeFile(textPath);
+    }
+}
+
+void printReport(const Report& report) {
+    char buf[512];
+    std::cout << "--- probe process launch ---\n";
+    snprintf(buf, sizeof(buf), "%d spawns: mean %.2f ms, min %.2f ms, max %.2f ms",
+             report.spawn.count, report.spawn.mean(), report.spawn.min, report.spawn.max);
+    std::cout << buf << "\n";
+
+    std::cout << "--- plugins (sorted by probe time) ---\n";
+    auto plugins = report.plugins;
+    std::sort(plugins.begin(), plugins.end(), [](auto& a, auto& b) {
+        return (a.load + a.probe) > (b.load + b.probe);
+    });
+    Stats load, probe;
+    int numErrors = 0, numTimeouts = 0, numPlugins = 0;
+    for (auto& p : plugins) {
+        snprintf(buf, sizeof(buf), "%10.2f ms (load %8.2f ms) %3d plugin(s) %-13s %s",
+                 p.probe, p.load, p.numPlugins, errorName(p.error), p.path.c_str());
+        std::cout << buf << "\n";
+        load.add(p.load);
+        probe.add(p.probe);
+        numPlugins += p.numPlugins;
+        if (p.error == Error::Timeout) {
+            numTimeouts++;
+        } else if (p.error != Error::NoError) {
+            numErrors++;
+        }
+    }
+
+    std::cout << "--- summary ---\n";
+    snprintf(buf, sizeof(buf),
+             "%d module(s), %d plugin(s), %d error(s), %d timeout(s)\n"
+             "search: %.2f ms with %d job(s)\n"
+             "load: mean %.2f ms, max %.2f ms\n"
+             "probe: mean %.2f ms, max %.2f ms\n"
+             "binary cache: write %.2f ms, read %.2f ms\n"
+             "text cache: write %.2f ms, read %.2f ms",
+             (int)plugins.size(), numPlugins, numErrors, numTimeouts,
+             report.search, report.numJobs,
+             load.mean(), load.max, probe.mean(), probe.max,
+             report.writeBinary, report.readBinary,
+             report.writeText, report.readText);
+    std::cout << buf << std::endl;
+}
+
+std::string jsonString(const std::string& s) {
+    std::string result = "\"";
+    for (auto c : s) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            result += buf;
+        } else {
+            result += c;
+        }
+    }
+    result += "\"";
+    return result;
+}
+
+bool writeReport(const std::string& path, const Report& report) {
+    File file(path, File::WRITE);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << "{\n";
+    file << "  \"version\": \"" << getVersionString() << "\",\n";
+    file << "  \"unit\": \"ms\",\n";
+    file << "  \"jobs\": " << report.numJobs << ",\n";
+    file << "  \"spawn\": { \"count\": " << report.spawn.count
+         << ", \"mean\": " << report.spawn.mean()
+         << ", \"min\": " << report.spawn.min
+         << ", \"max\": " << report.spawn.max << " },\n";
+    file << "  \"search\": " << report.search << ",\n";
+    file << "  \"cache\": { \"write_binary\": " << report.writeBinary
+         << ", \"read_binary\": " << report.readBinary
+         << ", \"write_text\": " << report.writeText
+         << ", \"read_text\": " << report.readText << " },\n";
+    file << "  \"plugins\": [";
+    for (size_t i = 0; i < report.plugins.size(); ++i) {
+        auto& p = report.plugins[i];
+        file << (i > 0 ? ",\n" : "\n")
+             << "    { \"path\": " << jsonString(p.path)
+             << ", \"load\": " << p.load
+             << ", \"probe\": " << p.probe
+             << ", \"plugins\": " << p.numPlugins
+             << ", \"error\": \"" << errorName(p.error) << "\"";
+        if (!p.message.empty()) {
+            file << ", \"message\": " << jsonString(p.message);
+        }
+        file << " }";
+    }
+    file << "\n  ]\n}\n";
+    return (bool)file;
+}
+
+void usage() {
+    std::cout << "usage: scan_benchmark [options] <directories...>\n"
+              << "  -j <count>    number of concurrent probe jobs (default: number of cores)\n"
+              << "  -t <seconds>  probe timeout (default: 10)\n"
+              << "  -s <count>    number of probe process launches (default: 8)\n"
+              << "  -c <file>     cache file path (default: temporary file)\n"
+              << "  -o <file>     write results as JSON\n";
+}
+
+int main(int argc, const char *argv[]) {
+    Options options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.size() == 2 && arg[0] == '-') {
+                if (++i >= argc) {
+                    usage();
+                    return EXIT_FAILURE;
+                }
+                std::string value = argv[i];
+                switch (arg[1]) {
+                case 'j':
+                    options.numJobs = std::max(std::stoi(value), 0);
+                    break;
+                case 't':
+                    options.timeout = std::stof(value);
+                    break;
+                case 's':
+                    options.numSpawns = std::max(std::stoi(value), 0);
+                    break;
+                case 'c':
+                    options.cachePath = value;
+                    break;
+                case 'o':
+                    options.output = value;
+                    break;
+                default:
+                    usage();
+                    return EXIT_FAILURE;
+                }
+            } else {
+                options.dirs.push_back(arg);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cout << "error: bad argument" << std::endl;
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    if (options.dirs.empty()) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    Report report;
+    PluginDictionary dict;
+
+    benchmarkSpawn(options, report);
+    benchmarkSearch(options, dict, report);
+    benchmarkCache(options, dict, report);
+
+    printReport(report);
+
+    if (!options.output.empty()) {
+        if (writeReport(options.output, report)) {
+            LOG_VERBOSE("wrote results to " << options.output);
+        } else {
+            LOG_ERROR("couldn't write results to " << options.output);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -41,8 +41,11 @@ using namespace vst;
 #define TEST_BENCHMARK_DSP_COUNT 0
 #define TEST_BENCHMARK_AVG_OFFSET 1
 #define TEST_BENCHMARK_DEBUG 0
+// run the whole test again with spinning channels (0: don't)
+#define TEST_BENCHMARK_SPIN_COUNT 10000
 
 static volatile float gPhase = 0.0;
+static double gResult = 0.0; // average round trip time
 static volatile float gBuffer[64];
 
 void fake_dsp(int n){
@@ -250,6 +253,7 @@ void server_benchmark(ShmInterface& shm){
                 << (avg_outer / divisor) << " us");
     LOG_VERBOSE("server: average inner delta = "
                 << (avg_inner / divisor) << " us");
+    gResult = avg_inner / divisor;
 }
 
 void client_benchmark(ShmInterface& shm){
@@ -283,15 +287,15 @@ void client_benchmark(ShmInterface& shm){
     LOG_VERBOSE("client: done");
 }
 
-int server_run(){
+int server_run(uint32_t spinCount){
     LOG_VERBOSE("---");
-    LOG_VERBOSE("server: start");
+    LOG_VERBOSE("server: start (spin count: " << spinCount << ")");
     LOG_VERBOSE("---");
     ShmInterface shm;
     shm.addChannel(ShmChannel::Queue, TEST_QUEUE_BUFSIZE, "queue");
     shm.addChannel(ShmChannel::Request, TEST_REQUEST_BUFSIZE, "request");
     shm.addChannel(ShmChannel::Request, 0, "sync");
-    shm.create();
+    shm.create(spinCount);
 
     LOG_VERBOSE("server: created shared memory interface " << shm.path());
 
@@ -429,7 +433,17 @@ int main(int argc, const char *argv[]){
         if (argc > 1) {
             return client_run(argv[1]);
         } else {
-            return server_run();
+            auto result = server_run(0);
+        #if TEST_BENCHMARK && TEST_BENCHMARK_SPIN_COUNT > 0
+            if (result == EXIT_SUCCESS) {
+                auto blocking = gResult;
+                result = server_run(TEST_BENCHMARK_SPIN_COUNT);
+                LOG_VERBOSE("---");
+                LOG_VERBOSE("average round trip: " << blocking << " us (blocking), "
+                            << gResult << " us (spinning)");
+            }
+        #endif
+            return result;
         }
     } catch (const std::exception& e){
         LOG_ERROR(e.what());
@@ -3,6 +3,7 @@
 #include "Interface.h"
 #include "FileUtils.h"
 #include "Log.h"
+#include "Sync.h"
 
 #ifdef _WIN32
 # ifndef NOMINMAX
@@ -37,8 +38,9 @@
 # define IMAGE_FILE_DLL 0x2000
 #endif // USE_WINE
 
-#include <sstream>
+#include <algorithm>
 #include <cstring>
+#include <sstream>
 #include <unordered_map>
 
 namespace vst {
@@ -123,21 +125,18 @@ static void swap_bytes(T& i){
 
 #if defined(_WIN32) || USE_WINE
 
-CpuArch readPE(vst::File& file, bool onlyPlugins){
+CpuArch readPE(const char *data, int64_t nbytes, bool onlyPlugins){
     // read PE header
     // note: we don't have to worry about byte order (always LE)
     const uint16_t dos_signature = 0x5A4D;
     const char pe_signature[] = { 'P', 'E', 0, 0 };
     const auto header_size = 24; // PE signature + COFF header
-    char data[1024]; // should be large enough for DOS stub
-    file.read(data, sizeof(data));
-    int nbytes = file.gcount();
     // check DOS signature
-    if (nbytes > sizeof(dos_signature) && !memcmp(data, &dos_signature, sizeof(dos_signature))){
+    if (nbytes >= 0x40 && !memcmp(data, &dos_signature, sizeof(dos_signature))){
         int32_t offset;
         // get the file offset to the PE signature
         memcpy(&offset, &data[0x3C], sizeof(offset));
-        if (offset < (sizeof(data) - header_size)){
+        if (offset >= 0 && offset < (nbytes - header_size)){
             const char *header = data + offset;
             if (!memcmp(header, pe_signature, sizeof(pe_signature))){
                 header += sizeof(pe_signature);
@@ -195,11 +194,11 @@ CpuArch readPE(vst::File& file, bool onlyPlugins){
 
 #if !defined(_WIN32) && !defined(__APPLE__) // Linux, OpenBSD, FreeBSD, etc. (TODO handle Android?)
 
-CpuArch readELF(vst::File& file, bool onlyPlugins){
+CpuArch readELF(const char *data, int64_t nbytes, bool onlyPlugins){
     // read ELF header
     // check magic number
-    char data[64]; // ELF header size
-    if (file.read(data, sizeof(data)) && !memcmp(data, ELFMAG, SELFMAG)){
+    const auto header_size = 64;
+    if (nbytes >= header_size && !memcmp(data, ELFMAG, SELFMAG)){
         char endian = data[0x05];
         int byteorder;
         if (endian == ELFDATA2LSB){
@@ -254,13 +253,16 @@ CpuArch readELF(vst::File& file, bool onlyPlugins){
 
 #ifdef __APPLE__ // macOS (TODO handle iOS?)
 
-std::vector<CpuArch> readMach(vst::File& file, bool onlyPlugins){
+std::vector<CpuArch> readMach(const char *data, int64_t nbytes, bool onlyPlugins){
     // read Mach-O header
-    auto read_uint32 = [](std::fstream& f, bool swap){
+    int64_t pos = 0;
+    auto read_uint32 = [&](bool swap){
         uint32_t i;
-        if (!f.read((char *)&i, sizeof(i))){
+        if (pos + (int64_t)sizeof(i) > nbytes){
             throw Error(Error::ModuleError, "end of file reached");
         }
+        memcpy(&i, data + pos, sizeof(i));
+        pos += sizeof(i);
         if (swap){
             swap_bytes(i);
         }
@@ -287,11 +289,11 @@ std::vector<CpuArch> readMach(vst::File& file, bool onlyPlugins){
         }
     };
 
-    auto readMachHeader = [&](std::fstream& f, bool swap, bool wide){
+    auto readMachHeader = [&](bool swap, bool wide){
         LOG_DEBUG("reading mach-o header");
-        cpu_type_t cputype = read_uint32(f, swap);
-        uint32_t cpusubtype = read_uint32(f, swap); // ignored
-        uint32_t filetype = read_uint32(f, swap);
+        cpu_type_t cputype = read_uint32(swap);
+        uint32_t cpusubtype = read_uint32(swap); // ignored
+        uint32_t filetype = read_uint32(swap);
         // check if it is a dylib or Mach-bundle
         if (filetype != MH_DYLIB && filetype != MH_BUNDLE && onlyPlugins){
             throw Error(Error::ModuleError, "not a plugin");
@@ -299,53 +301,49 @@ std::vector<CpuArch> readMach(vst::File& file, bool onlyPlugins){
         return getCpuArch(cputype);
     };
 
-    auto readFatArchive = [&](std::fstream& f, bool swap, bool wide){
+    auto readFatArchive = [&](bool swap, bool wide){
         LOG_DEBUG("reading fat archive");
         std::vector<CpuArch> archs;
-        auto count = read_uint32(f, swap);
+        auto count = read_uint32(swap);
         for (auto i = 0; i < count; ++i){
             // fat_arch is 20 bytes and fat_arch_64 is 32 bytes
             // read CPU type
-            cpu_type_t arch = read_uint32(f, swap);
+            cpu_type_t arch = read_uint32(swap);
             // the archive should contain only plugins, so we don't
             // catch exepctions thrown by readMachHeader()
             archs.push_back(getCpuArch(arch));
             // skip remaining bytes. LATER also check file type.
-            if (wide){
-                char dummy[28];
-                f.read(dummy, sizeof(dummy));
-            } else {
-                char dummy[16];
-                f.read(dummy, sizeof(dummy));
-            }
+            pos += wide ? 28 : 16;
         }
         return archs;
     };
 
     uint32_t magic = 0;
-    file.read((char *)&magic, sizeof(magic));
+    if (nbytes >= (int64_t)sizeof(magic)){
+        magic = read_uint32(false);
+    }
 
     // *_CIGAM tells us to swap endianess
     switch (magic){
     case MH_MAGIC:
-        return { readMachHeader(file, false, false) };
+        return { readMachHeader(false, false) };
     case MH_CIGAM:
-        return { readMachHeader(file, true, false) };
+        return { readMachHeader(true, false) };
 #ifdef MH_MAGIC_64
     case MH_MAGIC_64:
-        return { readMachHeader(file, false, true) };
+        return { readMachHeader(false, true) };
     case MH_CIGAM_64:
-        return { readMachHeader(file, true, true) };
+        return { readMachHeader(true, true) };
 #endif
     case FAT_MAGIC:
-        return readFatArchive(file, false, false);
+        return readFatArchive(false, false);
     case FAT_CIGAM:
-        return readFatArchive(file, true, false);
+        return readFatArchive(true, false);
 #ifdef FAT_MAGIC_64
     case FAT_MAGIC_64:
-        return readFatArchive(file, false, true);
+        return readFatArchive(false, true);
     case FAT_CIGAM_64:
-        return readFatArchive(file, true, true);
+        return readFatArchive(true, true);
 #endif
     default:
         return {};
@@ -385,31 +383,34 @@ static const std::vector<const char *> gBundleBinaryExtensions = {
 #endif
 };
 
+// Large enough for the PE header (incl. DOS stub), the ELF header
+// and Mach-O fat archives with a reasonable number of architectures.
+#define CPUARCH_HEADER_SIZE 4096
+
 // try to get CPU architecture(s) from a file
 std::vector<CpuArch> doGetCpuArchitectures(const std::string& path, bool onlyPlugins){
     std::vector<CpuArch> results;
 
-    vst::File file(path);
-    if (file.is_open()){
+    // only read the header with a single system call
+    char data[CPUARCH_HEADER_SIZE];
+    auto nbytes = readFileHeader(path, data, sizeof(data));
+    if (nbytes >= 0){
     #if USE_WINE
         try {
     #endif
         #if defined(_WIN32) // Windows
-            results.push_back(readPE(file, onlyPlugins));
+            results.push_back(readPE(data, nbytes, onlyPlugins));
         #elif defined(__APPLE__)
-            auto archs = readMach(file, onlyPlugins);
+            auto archs = readMach(data, nbytes, onlyPlugins);
             results.insert(results.end(), archs.begin(), archs.end());
         #else
-            results.push_back(readELF(file, onlyPlugins));
+            results.push_back(readELF(data, nbytes, onlyPlugins));
         #endif
     #if USE_WINE
         } catch (const Error& e) {
-            // rewind file!
-            file.clear();
-            file.seekg(0);
             try {
                 // try to read as PE
-                results.push_back(readPE(file, onlyPlugins));
+                results.push_back(readPE(data, nbytes, onlyPlugins));
             } catch (const Error& e2) {
                 if (e2.code() == Error::NoError){
                     // not a PE, keep original error
@@ -425,12 +426,53 @@ std::vector<CpuArch> doGetCpuArchitectures(const std::string& path, bool onlyPlu
     return results;
 }
 
-// Check a file path or bundle for contained CPU architectures
-// If 'path' is a file, we throw an exception if it is not a library,
-// but if 'path' is a bundle (= directory), we ignore any non-library files
-// in the 'Contents' subfolder (so the resulting list might be empty).
-std::vector<CpuArch> getPluginCpuArchitectures(const std::string& path){
-    if (isDirectory(path)){
+/*//////////////////// CPU architecture cache ////////////////////*/
+
+// Plugin CPU architectures are memoized per path, so we don't have to read
+// the same binaries over and over again, e.g. when probing or loading plugins.
+// Entries are validated with the modification time of the plugin file resp.
+// the binary folders inside a plugin bundle. The latter change whenever a binary
+// is added, removed or replaced by a new file; binaries which are overwritten
+// in place keep their folder (and thus their CPU architecture).
+static std::unordered_map<std::string, CpuArchInfo> gCpuArchCache;
+static SharedMutex gCpuArchMutex;
+
+static bool getPluginTimestamp(const std::string& path, bool bundle, double& timestamp){
+    try {
+        if (bundle){
+            timestamp = 0;
+            for (auto& binaryPath : gBundleBinaryPaths){
+                auto dir = path + "/" + binaryPath;
+                if (isDirectory(dir)){
+                    timestamp = std::max<double>(timestamp, fileTimeLastModified(dir));
+                }
+            }
+        } else {
+            timestamp = fileTimeLastModified(path);
+        }
+        return true;
+    } catch (const Error&){
+        return false;
+    }
+}
+
+std::vector<CpuArchInfo> getCpuArchitectureCache(){
+    std::shared_lock lock(gCpuArchMutex);
+    std::vector<CpuArchInfo> result;
+    result.reserve(gCpuArchCache.size());
+    for (auto& [_, info] : gCpuArchCache){
+        result.push_back(info);
+    }
+    return result;
+}
+
+void addCpuArchitectureCache(const CpuArchInfo& info){
+    std::unique_lock lock(gCpuArchMutex);
+    gCpuArchCache[info.path] = info;
+}
+
+static std::vector<CpuArch> doGetPluginCpuArchitectures(const std::string& path, bool bundle){
+    if (bundle){
         // plugin bundle
         std::vector<CpuArch> results;
 
@@ -478,6 +520,29 @@ std::vector<CpuArch> getPluginCpuArchitectures(const std::string& path){
     }
 }
 
+// Check a file path or bundle for contained CPU architectures
+// If 'path' is a file, we throw an exception if it is not a library,
+// but if 'path' is a bundle (= directory), we ignore any non-library files
+// in the 'Contents' subfolder (so the resulting list might be empty).
+std::vector<CpuArch> getPluginCpuArchitectures(const std::string& path){
+    bool bundle = isDirectory(path);
+    // check the cache
+    double timestamp = 0;
+    bool haveTimestamp = getPluginTimestamp(path, bundle, timestamp);
+    if (haveTimestamp){
+        std::shared_lock lock(gCpuArchMutex);
+        auto it = gCpuArchCache.find(path);
+        if (it != gCpuArchCache.end() && it->second.timestamp == timestamp){
+            return it->second.archs;
+        }
+    }
+    auto archs = doGetPluginCpuArchitectures(path, bundle);
+    if (haveTimestamp){
+        addCpuArchitectureCache({ path, timestamp, archs });
+    }
+    return archs;
+}
+
 std::vector<CpuArch> getFileCpuArchitectures(const std::string &path) {
     return doGetCpuArchitectures(path, false);
 }
@@ -29,10 +29,24 @@ const char * cpuArchToString(CpuArch arch);
 
 CpuArch cpuArchFromString(std::string_view name);
 
+// NB: the results are cached, see getCpuArchitectureCache()
 std::vector<CpuArch> getPluginCpuArchitectures(const std::string& path);
 
 std::vector<CpuArch> getFileCpuArchitectures(const std::string& path);
 
 void printCpuArchitectures(const std::string& path);
 
+// The CPU architectures of plugin files/bundles are cached per path
+// and modification time. The cache can be saved and restored, so that
+// we don't have to open all plugin binaries again in a new session.
+struct CpuArchInfo {
+    std::string path;
+    double timestamp = 0;
+    std::vector<CpuArch> archs;
+};
+
+std::vector<CpuArchInfo> getCpuArchitectureCache();
+
+void addCpuArchitectureCache(const CpuArchInfo& info);
+
 } // vst
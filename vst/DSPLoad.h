@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+namespace vst {
+
+// DSP load of a single plugin instance; all times are in seconds.
+struct DSPLoad {
+    double last = 0;    // last process time
+    double average = 0; // average process time
+    double peak = 0;    // maximum process time since the last reset
+    double load = 0;    // average process time in percent of the block period
+    double wait = 0;    // average time spent waiting for the DSP thread resp. bridge
+};
+
+// Opt-in per-plugin DSP load meter, see IPlugin::setDSPLoadMeter().
+//
+// The process and wait times are recorded by the thread(s) which actually
+// process the plugin (e.g. the DSP thread of a ThreadedPlugin) and can be
+// read from any thread without locks. Averages are exponential moving
+// averages over roughly 32 blocks.
+//
+// NB: reset() may race with an update; the worst case is that a single
+// measurement is lost.
+class DSPLoadMeter {
+ public:
+    using clock = std::chrono::steady_clock;
+
+    static double elapsed(clock::time_point start) {
+        return std::chrono::duration<double>(clock::now() - start).count();
+    }
+
+    void setSampleRate(double sr) {
+        sampleRate_.store(sr, std::memory_order_relaxed);
+    }
+
+    // NB: only called by the processing thread
+    void addProcessTime(double seconds, int numSamples) {
+        auto avg = average_.load(std::memory_order_relaxed);
+        avg += (seconds - avg) * coeff;
+        average_.store(avg, std::memory_order_relaxed);
+        last_.store(seconds, std::memory_order_relaxed);
+        if (seconds > peak_.load(std::memory_order_relaxed)) {
+            peak_.store(seconds, std::memory_order_relaxed);
+        }
+        auto sr = sampleRate_.load(std::memory_order_relaxed);
+        if (sr > 0 && numSamples > 0) {
+            auto load = seconds * sr / numSamples * 100.0;
+            auto avgLoad = load_.load(std::memory_order_relaxed);
+            avgLoad += (load - avgLoad) * coeff;
+            load_.store(avgLoad, std::memory_order_relaxed);
+        }
+    }
+
+    // NB: only called by the thread which waits for the result
+    void addWaitTime(double seconds) {
+        auto avg = wait_.load(std::memory_order_relaxed);
+        avg += (seconds - avg) * coeff;
+        wait_.store(avg, std::memory_order_relaxed);
+    }
+
+    DSPLoad get() const {
+        DSPLoad result;
+        result.last = last_.load(std::memory_order_relaxed);
+        result.average = average_.load(std::memory_order_relaxed);
+        result.peak = peak_.load(std::memory_order_relaxed);
+        result.load = load_.load(std::memory_order_relaxed);
+        result.wait = wait_.load(std::memory_order_relaxed);
+        return result;
+    }
+
+    void reset() {
+        last_.store(0, std::memory_order_relaxed);
+        average_.store(0, std::memory_order_relaxed);
+        peak_.store(0, std::memory_order_relaxed);
+        load_.store(0, std::memory_order_relaxed);
+        wait_.store(0, std::memory_order_relaxed);
+    }
+ private:
+    static constexpr double coeff = 1.0 / 32;
+    std::atomic<double> sampleRate_{0};
+    std::atomic<double> last_{0};
+    std::atomic<double> average_{0};
+    std::atomic<double> peak_{0};
+    std::atomic<double> load_{0};
+    std::atomic<double> wait_{0};
+};
+
+} // vst
@@ -2,27 +2,101 @@
 
 #include "Interface.h"
 #include "PluginCommand.h"
+#include "MemoryPool.h"
 
 #include <cstring>
+#include <vector>
 
 namespace vst {
 
+// Merges repeated parameter changes, see IPlugin::setParameterCoalescing().
+// For every parameter we only keep the first and the last change since
+// the last flush; the first change is only sent if it has a different
+// sample offset, so that ramps keep their start and end point.
+class ParamCoalescer {
+ public:
+    // NB: not realtime safe!
+    void resize(int numParams) {
+        changes_.resize(numParams);
+        dirty_.assign((numParams + 63) / 64, 0);
+        numDirty_ = 0;
+    }
+
+    bool empty() const { return numDirty_ == 0; }
+
+    // returns false if the index is out of range
+    bool add(int index, float value, int offset) {
+        if (index < 0 || index >= (int)changes_.size()) {
+            return false;
+        }
+        auto& change = changes_[index];
+        auto& word = dirty_[index >> 6];
+        uint64_t bit = (uint64_t)1 << (index & 63);
+        if (!(word & bit)) {
+            word |= bit;
+            numDirty_++;
+            change.firstValue = value;
+            change.firstOffset = offset;
+        }
+        change.lastValue = value;
+        change.lastOffset = offset;
+        return true;
+    }
+
+    // call fn(index, value, offset) for all pending changes (in index order)
+    // and clear the dirty set.
+    template<typename Fn>
+    void flush(Fn&& fn) {
+        for (size_t i = 0; i < dirty_.size() && numDirty_ > 0; ++i) {
+            auto bits = dirty_[i];
+            if (!bits) {
+                continue;
+            }
+            for (int j = 0; j < 64; ++j) {
+                if (bits & ((uint64_t)1 << j)) {
+                    int index = (i << 6) + j;
+                    auto& change = changes_[index];
+                    if (change.firstOffset != change.lastOffset) {
+                        fn(index, change.firstValue, change.firstOffset);
+                    }
+                    fn(index, change.lastValue, change.lastOffset);
+                    numDirty_--;
+                }
+            }
+            dirty_[i] = 0;
+        }
+    }
+ private:
+    struct Change {
+        float firstValue;
+        float lastValue;
+        int firstOffset;
+        int lastOffset;
+    };
+    std::vector<Change> changes_;
+    std::vector<uint64_t> dirty_; // bitset
+    int numDirty_ = 0;
+};
+
 class DeferredPlugin : public IPlugin {
  public:
     void setParameter(int index, float value, int sampleOffset) override {
+        if (coalesce_ && coalescer_.add(index, value, sampleOffset)) {
+            return;
+        }
         Command command(Command::SetParamValue);
         auto& param = command.paramValue;
         param.index = index;
         param.value = value;
         param.offset = sampleOffset;
-        pushCommand(command);
+        deferCommand(command);
     }
 
     bool setParameter(int index, std::string_view str, int sampleOffset) override {
         auto size = str.size();
         if (size > Command::maxShortStringSize) {
-            // bummer, we need to allocate on the heap
-            auto buf = new char[size + 1];
+            // allocate from the (realtime safe) payload pool
+            auto buf = allocatePayload(PayloadType::String, size + 1);
             memcpy(buf, str.data(), size + 1);
 
             Command command(Command::SetParamString);
@@ -32,7 +106,7 @@ class DeferredPlugin : public IPlugin {
             param.size = size;
             param.str = buf;
 
-            pushCommand(command);
+            deferCommand(command);
         } else {
             Command command(Command::SetParamStringShort);
             auto& param = command.paramStringShort;
@@ -42,7 +116,7 @@ class DeferredPlugin : public IPlugin {
             param.pstr[0] = (uint8_t)size;
             memcpy(&param.pstr[1], str.data(), size);
 
-            pushCommand(command);
+            deferCommand(command);
         }
 
         return true; // what shall we do?
@@ -51,13 +125,19 @@ class DeferredPlugin : public IPlugin {
     void setBypass(Bypass state) override {
         Command command(Command::SetBypass);
         command.i = static_cast<int32_t>(state);
-        pushCommand(command);
+        deferCommand(command);
+    }
+
+    void setSilenceMode(SilenceMode mode) override {
+        Command command(Command::SetSilenceMode);
+        command.i = static_cast<int32_t>(mode);
+        deferCommand(command);
     }
 
     void setProgram(int program) override {
         Command command(Command::SetProgram);
         command.i = program;
-        pushCommand(command);
+        deferCommand(command);
     }
 
     void sendMidiEvent(const MidiEvent& event) override {
@@ -66,12 +146,12 @@ class DeferredPlugin : public IPlugin {
         memcpy(midi.data, event.data, sizeof(event.data));
         midi.delta = event.delta;
         midi.detune = event.detune;
-        pushCommand(command);
+        deferCommand(command);
     }
 
     void sendSysexEvent(const SysexEvent& event) override {
-        // copy data (LATER improve)
-        auto data = new char[event.size];
+        // copy data
+        auto data = allocatePayload(PayloadType::Sysex, event.size);
         memcpy(data, event.data, event.size);
 
         Command command(Command::SendSysex);
@@ -79,71 +159,101 @@ class DeferredPlugin : public IPlugin {
         sysex.data = data;
         sysex.size = event.size;
         sysex.delta = event.delta;
-        pushCommand(command);
+        deferCommand(command);
     }
 
     void setTempoBPM(double tempo) override {
         Command command(Command::SetTempo);
         command.d = tempo;
-        pushCommand(command);
+        deferCommand(command);
     }
 
     void setTimeSignature(int numerator, int denominator) override {
         Command command(Command::SetTimeSignature);
         command.timeSig.num = numerator;
         command.timeSig.denom = denominator;
-        pushCommand(command);
+        deferCommand(command);
     }
 
     void setTransportPlaying(bool play) override {
         Command command(Command::SetTransportPlaying);
         command.i = play;
-        pushCommand(command);
+        deferCommand(command);
     }
 
     void setTransportRecording(bool record) override {
         Command command(Command::SetTransportRecording);
         command.i = record;
-        pushCommand(command);
+        deferCommand(command);
     }
 
     void setTransportAutomationWriting(bool writing) override {
         Command command(Command::SetTransportAutomationWriting);
         command.i = writing;
-        pushCommand(command);
+        deferCommand(command);
     }
 
     void setTransportAutomationReading(bool reading) override {
         Command command(Command::SetTransportAutomationReading);
         command.i = reading;
-        pushCommand(command);
+        deferCommand(command);
     }
 
     void setTransportCycleActive(bool active) override {
         Command command(Command::SetTransportCycleActive);
         command.i = active;
-        pushCommand(command);
+        deferCommand(command);
     }
 
     void setTransportCycleStart(double beat) override {
         Command command(Command::SetTransportCycleStart);
         command.d = beat;
-        pushCommand(command);
+        deferCommand(command);
     }
 
     void setTransportCycleEnd(double beat) override {
         Command command(Command::SetTransportCycleEnd);
         command.d = beat;
-        pushCommand(command);
+        deferCommand(command);
     }
 
     void setTransportPosition(double beat) override {
         Command command(Command::SetTransportPosition);
         command.d = beat;
-        pushCommand(command);
+        deferCommand(command);
+    }
+    void setParameterCoalescing(bool enable) override {
+        if (!enable) {
+            flushParameters();
+        }
+        coalesce_ = enable;
     }
  protected:
     virtual void pushCommand(const Command& command) = 0;
+
+    // flush pending parameter changes to preserve the command order
+    void deferCommand(const Command& command) {
+        flushParameters();
+        pushCommand(command);
+    }
+
+    // NB: must be called before the command queue is dispatched.
+    void flushParameters() {
+        if (!coalescer_.empty()) {
+            coalescer_.flush([this](int index, float value, int offset) {
+                Command command(Command::SetParamValue);
+                auto& param = command.paramValue;
+                param.index = index;
+                param.value = value;
+                param.offset = offset;
+                pushCommand(command);
+            });
+        }
+    }
+
+    // NB: subclasses must call coalescer_.resize() in the constructor
+    ParamCoalescer coalescer_;
+    bool coalesce_ = false;
 };
 
 } // vst
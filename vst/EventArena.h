@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// max. number of MIDI events per plugin and process block.
+// Additional events are dropped, see EventArena::drop().
+#ifndef MAX_EVENTS_PER_BLOCK
+#define MAX_EVENTS_PER_BLOCK 1024
+#endif
+
+// max. number of SysEx events per plugin and process block
+#ifndef MAX_SYSEX_EVENTS_PER_BLOCK
+#define MAX_SYSEX_EVENTS_PER_BLOCK 64
+#endif
+
+// size (in bytes) of the SysEx data arena per plugin and process block.
+// SysEx messages which don't fit into the arena are dropped.
+#ifndef SYSEX_ARENA_SIZE
+#define SYSEX_ARENA_SIZE 65536
+#endif
+
+namespace vst {
+
+// Preallocated storage for event data (e.g. SysEx dumps), so that
+// we never allocate memory on the audio thread. Memory is handed out
+// linearly and released all at once with clear(), typically after
+// each process block.
+class EventArena {
+ public:
+    EventArena(size_t size = SYSEX_ARENA_SIZE)
+        : data_(new char[size]), size_(size) {}
+
+    // returns nullptr if the arena is full; the caller is
+    // supposed to drop the event and call drop().
+    char * allocate(size_t size) {
+        auto aligned = (size + alignment - 1) & ~(alignment - 1);
+        if (aligned <= size_ - used_) {
+            auto result = data_.get() + used_;
+            used_ += aligned;
+            return result;
+        } else {
+            return nullptr;
+        }
+    }
+
+    void clear() { used_ = 0; }
+
+    // overflow counter
+    void drop() { dropped_++; }
+    uint64_t numDropped() const { return dropped_; }
+    // returns the number of events dropped since the last call;
+    // used for (deferred) reporting.
+    uint64_t checkDropped() {
+        auto result = dropped_ - reported_;
+        reported_ = dropped_;
+        return result;
+    }
+ private:
+    static const size_t alignment = 8;
+
+    std::unique_ptr<char[]> data_;
+    size_t size_;
+    size_t used_ = 0;
+    uint64_t dropped_ = 0;
+    uint64_t reported_ = 0;
+};
+
+} // vst
@@ -1,76 +1,258 @@
-#pragma once
-
-#include "Log.h"
-#include "Interface.h"
-
-#include <mutex>
-
-namespace vst {
-
-class BaseEventLoop {
-public:
-    static constexpr int updateIntervalMillis = 30;
-
-    virtual ~BaseEventLoop() {}
-
-    UIThread::Handle addPollFunction(UIThread::PollFunction fn, void *context) {
-        std::unique_lock lock(pollFunctionMutex_);
-        auto handle = nextPollFunctionHandle_++;
-        pollFunctions_.emplace(handle, [context, fn](){ fn(context); });
-        lock.unlock();
-        // defer to UI thread!
-        UIThread::callAsync([](void *x) {
-            static_cast<BaseEventLoop *>(x)->updatePollFunctions();
-        }, this);
-        return handle;
-    }
-
-    void removePollFunction(UIThread::Handle handle) {
-        {
-            std::lock_guard lock(pollFunctionMutex_);
-            pollFunctions_.erase(handle);
-        }
-        // defer to UI thread!
-        UIThread::callAsync([](void *x) {
-            static_cast<BaseEventLoop *>(x)->updatePollFunctions();
-        }, this);
-    }
-protected:
-    // called by derived classes in poll timer function
-    void doPoll() {
-        std::lock_guard lock(pollFunctionMutex_);
-        for (auto& [_, fn] : pollFunctions_) {
-            fn();
-        }
-    }
-
-    // always called on UI thread!
-    virtual void startPolling() = 0;
-    // always called on UI thread!
-    virtual void stopPolling() = 0;
-private:
-    void updatePollFunctions() {
-        std::unique_lock lock(pollFunctionMutex_);
-        bool empty = pollFunctions_.empty();
-        lock.unlock();
-        // This is called whenever poll functions have been added/removed,
-        // so even if a new poll function is added/removed after we have
-        // unlocked the mutex, it will eventually do the right thing.
-        if (!empty && !isPolling_) {
-            LOG_DEBUG("EventLoop: start polling");
-            startPolling();
-            isPolling_ = true;
-        } else if (empty && isPolling_) {
-            LOG_DEBUG("EventLoop: stop polling");
-            stopPolling();
-            isPolling_ = false;
-        }
-    }
-
-    UIThread::Handle nextPollFunctionHandle_ = 0;
-    bool isPolling_ = false;
-    std::unordered_map<UIThread::Handle, std::function<void()>> pollFunctions_;
-    std::mutex pollFunctionMutex_;
-};
-
-} // namespace vst
+#pragma once
+
+#include "Log.h"
+#include "Interface.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <vector>
+
+namespace vst {
+
+// see BaseEventLoop::setEditorState()
+enum class EditorState {
+    Active, // visible and focused
+    Background, // visible but not focused
+    Hidden // minimized, unmapped or fully occluded
+};
+
+// Poll functions are either called periodically (every 'updateIntervalMillis')
+// or - if they are event-driven - whenever notifyPollFunctions() has been called.
+// Notifications are batched: the first notification schedules a single wakeup
+// after 'coalesceMillis', subsequent notifications are ignored until then.
+// Event-driven poll functions are still polled every 'fallbackIntervalMillis',
+// just in case a producer fails to notify us.
+//
+// Editors are not updated with individual timers per window. Instead, a single
+// editor timer runs at a fixed frame rate (see setEditorFrameRate()) and updates
+// all open editors in one go. Editors of background windows (not focused) are
+// only updated at a lower rate, editors of minimized or hidden windows are not
+// updated at all. The timer only runs while there is at least one editor to update.
+class BaseEventLoop {
+public:
+    static constexpr int updateIntervalMillis = 30;
+    static constexpr int fallbackIntervalMillis = 500;
+    static constexpr int coalesceMillis = 2;
+    static constexpr double defaultBackgroundFrameRate = 10;
+
+    virtual ~BaseEventLoop() {}
+
+    UIThread::Handle addPollFunction(UIThread::PollFunction fn, void *context,
+                                     bool eventDriven = false) {
+        std::unique_lock lock(pollFunctionMutex_);
+        auto handle = nextPollFunctionHandle_++;
+        pollFunctions_.emplace(handle, PollFunction { [context, fn](){ fn(context); }, eventDriven });
+        lock.unlock();
+        // defer to UI thread!
+        UIThread::callAsync([](void *x) {
+            static_cast<BaseEventLoop *>(x)->updatePollFunctions();
+        }, this);
+        return handle;
+    }
+
+    void removePollFunction(UIThread::Handle handle) {
+        {
+            std::lock_guard lock(pollFunctionMutex_);
+            pollFunctions_.erase(handle);
+        }
+        // defer to UI thread!
+        UIThread::callAsync([](void *x) {
+            static_cast<BaseEventLoop *>(x)->updatePollFunctions();
+        }, this);
+    }
+
+    // can be called from any thread
+    void notifyPollFunctions() {
+        if (!wakeupPending_.exchange(true)) {
+            // defer to UI thread!
+            bool ok = UIThread::callAsync([](void *x) {
+                static_cast<BaseEventLoop *>(x)->scheduleWakeup(coalesceMillis);
+            }, this);
+            if (!ok) {
+                wakeupPending_.store(false);
+            }
+        }
+    }
+
+    // can be called from any thread
+    void setEditorFrameRate(double fps, double backgroundFps) {
+        if (fps > 0) {
+            editorFrameRate_.store(fps);
+        }
+        if (backgroundFps > 0) {
+            backgroundFrameRate_.store(backgroundFps);
+        }
+        // defer to UI thread!
+        UIThread::callAsync([](void *x) {
+            static_cast<BaseEventLoop *>(x)->updateEditorTimer();
+        }, this);
+    }
+
+    // add an open editor; always called on UI thread!
+    void addEditor(IPlugin& plugin, EditorState state = EditorState::Active) {
+        editors_.push_back(Editor { &plugin, state });
+        updateEditorTimer();
+    }
+
+    // remove an editor before it is closed; always called on UI thread!
+    void removeEditor(IPlugin& plugin) {
+        for (auto it = editors_.begin(); it != editors_.end(); ++it) {
+            if (it->plugin == &plugin) {
+                editors_.erase(it);
+                updateEditorTimer();
+                return;
+            }
+        }
+    }
+
+    // called when the editor window has been (de)activated, minimized, etc.
+    // always called on UI thread!
+    void setEditorState(IPlugin& plugin, EditorState state) {
+        for (auto& editor : editors_) {
+            if (editor.plugin == &plugin) {
+                if (editor.state != state) {
+                    LOG_DEBUG("EventLoop: editor state " << (int)editor.state
+                              << " -> " << (int)state);
+                    editor.state = state;
+                    updateEditorTimer();
+                }
+                return;
+            }
+        }
+        // ignore unknown editors; windows might send events before
+        // the editor has been added resp. after it has been removed.
+    }
+protected:
+    // called by derived classes in editor timer function
+    void doUpdateEditors() {
+        auto frame = editorFrame_++;
+        // NB: iterate by index because an editor might be removed
+        // from within updateEditor().
+        for (size_t i = 0; i < editors_.size(); ++i) {
+            auto& editor = editors_[i];
+            if (editor.state == EditorState::Active) {
+                editor.plugin->updateEditor();
+            } else if (editor.state == EditorState::Background) {
+                // stagger background updates, so that they don't all
+                // fall on the same frame.
+                if ((frame + i) % backgroundDivider_ == 0) {
+                    editor.plugin->updateEditor();
+                }
+            }
+        }
+    }
+
+    // called by derived classes in poll timer function
+    void doPoll() {
+        std::lock_guard lock(pollFunctionMutex_);
+        for (auto& [_, fn] : pollFunctions_) {
+            fn.fn();
+        }
+    }
+
+    // called by derived classes in wakeup timer function
+    void doWakeup() {
+        // clear *before* polling, so that we don't miss notifications
+        // which are sent while we are polling.
+        wakeupPending_.store(false);
+        doPoll();
+    }
+
+    // the current poll timer interval; see startPolling()
+    int pollInterval() const { return pollInterval_; }
+
+    // start a periodic timer with pollInterval() that calls doPoll()
+    // always called on UI thread!
+    virtual void startPolling() = 0;
+    // always called on UI thread!
+    virtual void stopPolling() = 0;
+    // call doWakeup() once after the given number of milliseconds;
+    // always called on UI thread!
+    virtual void scheduleWakeup(int ms) = 0;
+    // start a periodic timer with the given interval that calls doUpdateEditors();
+    // always called on UI thread!
+    virtual void startEditorTimer(int ms) = 0;
+    // always called on UI thread!
+    virtual void stopEditorTimer() = 0;
+private:
+    void updateEditorTimer() {
+        bool active = false;
+        for (auto& editor : editors_) {
+            if (editor.state != EditorState::Hidden) {
+                active = true;
+                break;
+            }
+        }
+        auto fps = editorFrameRate_.load();
+        int interval = std::max<int>(1, std::lround(1000.0 / fps));
+        backgroundDivider_ = std::max<int>(1, std::lround(fps / backgroundFrameRate_.load()));
+        if (editorInterval_ > 0 && (!active || interval != editorInterval_)) {
+            LOG_DEBUG("EventLoop: stop editor timer");
+            stopEditorTimer();
+            editorInterval_ = 0;
+        }
+        if (active && editorInterval_ == 0) {
+            LOG_DEBUG("EventLoop: start editor timer (" << interval << " ms)");
+            startEditorTimer(interval);
+            editorInterval_ = interval;
+        }
+    }
+
+    void updatePollFunctions() {
+        std::unique_lock lock(pollFunctionMutex_);
+        bool empty = pollFunctions_.empty();
+        bool periodic = false;
+        for (auto& [_, fn] : pollFunctions_) {
+            if (!fn.eventDriven) {
+                periodic = true;
+                break;
+            }
+        }
+        lock.unlock();
+        int interval = periodic ? updateIntervalMillis : fallbackIntervalMillis;
+        // This is called whenever poll functions have been added/removed,
+        // so even if a new poll function is added/removed after we have
+        // unlocked the mutex, it will eventually do the right thing.
+        if (isPolling_ && (empty || interval != pollInterval_)) {
+            LOG_DEBUG("EventLoop: stop polling");
+            stopPolling();
+            isPolling_ = false;
+            // stopPolling() might have cancelled a pending wakeup
+            wakeupPending_.store(false);
+        }
+        if (!empty && !isPolling_) {
+            LOG_DEBUG("EventLoop: start polling (" << interval << " ms)");
+            pollInterval_ = interval;
+            startPolling();
+            isPolling_ = true;
+        }
+    }
+
+    struct PollFunction {
+        std::function<void()> fn;
+        bool eventDriven;
+    };
+
+    UIThread::Handle nextPollFunctionHandle_ = 0;
+    bool isPolling_ = false;
+    int pollInterval_ = updateIntervalMillis;
+    std::atomic<bool> wakeupPending_{false};
+    std::unordered_map<UIThread::Handle, PollFunction> pollFunctions_;
+    std::mutex pollFunctionMutex_;
+
+    struct Editor {
+        IPlugin *plugin;
+        EditorState state;
+    };
+
+    std::vector<Editor> editors_;
+    uint64_t editorFrame_ = 0;
+    int editorInterval_ = 0; // 0: timer not running
+    int backgroundDivider_ = 1;
+    std::atomic<double> editorFrameRate_{1000.0 / updateIntervalMillis};
+    std::atomic<double> backgroundFrameRate_{defaultBackgroundFrameRate};
+};
+
+} // namespace vst
@@ -10,6 +10,9 @@
 # include <windows.h>
 #else
 # include <sys/stat.h>
+# include <sys/mman.h>
+# include <fcntl.h>
+# include <unistd.h>
 #endif
 
 #if USE_STDFS
@@ -293,9 +296,10 @@ std::string fileBaseName(const std::string& path){
 // as a Unix timestamp (number of seconds since Jan 1, 1970).
 #ifdef _WIN32
 double fileTimeLastModified(const std::string &path) {
+    // NB: FILE_FLAG_BACKUP_SEMANTICS is required for directories
     HANDLE hFile = CreateFileW(widen(path).c_str(),
                                GENERIC_READ, FILE_SHARE_READ, NULL,
-                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+                               OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
     if (hFile == INVALID_HANDLE_VALUE) {
         throw Error(Error::SystemError, "CreateFile() failed: " + errorMessage(GetLastError()));
     }
@@ -333,6 +337,33 @@ double fileTimeLastModified(const std::string &path) {
 }
 #endif
 
+#ifdef _WIN32
+int64_t readFileHeader(const std::string& path, char *buffer, size_t size) {
+    HANDLE hFile = CreateFileW(widen(path).c_str(), GENERIC_READ,
+                               FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+    DWORD nbytes = 0;
+    if (!ReadFile(hFile, buffer, size, &nbytes, NULL)) {
+        nbytes = 0;
+    }
+    CloseHandle(hFile);
+    return nbytes;
+}
+#else
+int64_t readFileHeader(const std::string& path, char *buffer, size_t size) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    auto nbytes = pread(fd, buffer, size, 0);
+    close(fd);
+    return nbytes >= 0 ? nbytes : 0;
+}
+#endif
+
 //---------------------------------------------------//
 
 File::File(const std::string& path, Mode mode)
@@ -347,6 +378,76 @@ File::File(const std::string& path, Mode mode)
                    ios_base::binary |
                    (mode == READ ? ios_base::in : (ios_base::out | ios_base::trunc))) {}
 
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) {
+    HANDLE hFile = CreateFileW(widen(path).c_str(), GENERIC_READ,
+                               FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        throw Error(Error::SystemError, "couldn't open file " + path + ": "
+                    + errorMessage(GetLastError()));
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(hFile, &size)) {
+        auto err = GetLastError();
+        CloseHandle(hFile);
+        throw Error(Error::SystemError, "GetFileSizeEx() failed: " + errorMessage(err));
+    }
+    if (size.QuadPart == 0) {
+        CloseHandle(hFile);
+        throw Error(Error::SystemError, "file is empty");
+    }
+    // the mapping keeps the file alive
+    hMapping_ = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hFile);
+    if (!hMapping_) {
+        throw Error(Error::SystemError, "CreateFileMapping() failed: " + errorMessage(GetLastError()));
+    }
+    data_ = (const char *)MapViewOfFile(hMapping_, FILE_MAP_READ, 0, 0, 0);
+    if (!data_) {
+        auto err = GetLastError();
+        CloseHandle(hMapping_);
+        throw Error(Error::SystemError, "MapViewOfFile() failed: " + errorMessage(err));
+    }
+    size_ = size.QuadPart;
+}
+
+MappedFile::~MappedFile() {
+    UnmapViewOfFile(data_);
+    CloseHandle(hMapping_);
+}
+#else
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw Error(Error::SystemError, "couldn't open file " + path + ": "
+                    + errorMessage(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        auto err = errno;
+        close(fd);
+        throw Error(Error::SystemError, "fstat() failed: " + errorMessage(err));
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        throw Error(Error::SystemError, "file is empty");
+    }
+    // the mapping keeps the file alive
+    auto data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw Error(Error::SystemError, "mmap() failed: " + errorMessage(errno));
+    }
+    data_ = (const char *)data;
+    size_ = st.st_size;
+}
+
+MappedFile::~MappedFile() {
+    munmap((void *)data_, size_);
+}
+#endif
+
 TmpFile::TmpFile(const std::string& path, Mode mode)
     : File(path, mode), path_(path) {}
 
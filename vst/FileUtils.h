@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdint.h>
 #include <string>
 #include <fstream>
 
@@ -31,8 +32,13 @@ std::string fileExtension(const std::string& path);
 
 std::string fileBaseName(const std::string& path);
 
+// also works for directories
 double fileTimeLastModified(const std::string& path);
 
+// Read up to 'size' bytes from the beginning of a file with a single read call.
+// Returns the number of bytes read or -1 if the file couldn't be opened.
+int64_t readFileHeader(const std::string& path, char *buffer, size_t size);
+
 // Cross platform fstream, taking UTF-8 file paths.
 // Will become obsolete when we ditch macOS versions below 10.15.
 class File : public std::fstream {
@@ -44,6 +50,25 @@ public:
     File(const std::string& path, Mode mode = READ);
 };
 
+// Read-only memory mapped file, taking UTF-8 file paths.
+// Throws an Error exception on failure!
+class MappedFile {
+public:
+    MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char * data() const { return data_; }
+    size_t size() const { return size_; }
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void *hMapping_ = nullptr;
+#endif
+};
+
 // RAII class for automatic cleanup
 class TmpFile : public File {
 public:
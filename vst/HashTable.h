@@ -4,19 +4,56 @@
 #include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define VST_HASHTABLE_SSE2 1
+# include <emmintrin.h>
+#else
+# define VST_HASHTABLE_SSE2 0
+#endif
+
+#ifdef _MSC_VER
+# include <intrin.h>
+#endif
+
 namespace vst {
 
+namespace detail {
+
+inline int countTrailingZeros(uint32_t x) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return index;
+#else
+    return __builtin_ctz(x);
+#endif
+}
+
+} // detail
+
 // Custom open addressing hashtable that supports custom view types
 // for keys to avoid expensive conversions in find() method.
 // A typical use case would be std::string_view for std::string keys.
 // Key must be constructible from KeyView, KeyView must be convertable
 // to Key and both types must be comparable with each other.
+//
+// In addition to the entry array, we keep one control byte per slot
+// (7 bits of the hash or 'emptyControl'), so that find() can probe
+// a whole group of slots at once (with SSE2) and only has to compare
+// the keys of slots whose control byte matches.
 template<typename Key, typename Value, typename KeyView = Key>
 class HashTable {
 public:
-    HashTable() { array_.resize(initialCapacity); };
+    HashTable() {
+        array_.resize(initialCapacity);
+        resetControl();
+    };
 
     template<typename U>
     bool insert(const KeyView& key, U&& value) {
@@ -41,14 +78,26 @@ public:
         return count_;
     }
 
+    template<typename F>
+    void forEach(F&& fn) const {
+        for (auto& e : array_) {
+            if (!e.empty()) {
+                fn(e.key_, e.value_);
+            }
+        }
+    }
+
     void clear() {
         for (auto& e : array_) {
             e = Entry{};
         }
+        resetControl();
         count_ = 0;
     }
 private:
     static constexpr size_t initialCapacity = 8;
+    static constexpr size_t groupSize = 16;
+    static constexpr uint8_t emptyControl = 0x80;
 
     using HashType = uint32_t;
     static constexpr HashType flag = (HashType)1 << (sizeof(HashType) * CHAR_BIT - 1);
@@ -58,10 +107,28 @@ private:
         return hash & ~flag;
     }
 
+    // the upper 7 bits of the (31-bit) hash; the lower bits select the slot.
+    static uint8_t makeControl(HashType hash) {
+        return (hash >> 24) & 0x7f;
+    }
+
+    // NB: the control array has 'groupSize - 1' extra bytes which mirror
+    // the beginning of the table, so we can always load a full group.
+    void resetControl() {
+        control_.assign(array_.size() + groupSize - 1, emptyControl);
+    }
+
+    void setControl(size_t index, uint8_t value) {
+        for (auto i = index; i < control_.size(); i += array_.size()) {
+            control_[i] = value;
+        }
+    }
+
     void rehash() {
         auto newSize = array_.size() * 2;
         auto oldArray = std::move(array_);
         array_ = std::vector<Entry>(newSize);
+        resetControl();
         for (auto& e : oldArray) {
             if (!e.empty()) {
                 auto success = insert(std::move(e.key_), std::move(e.value_));
@@ -85,6 +152,7 @@ private:
     };
 
     std::vector<Entry> array_;
+    std::vector<uint8_t> control_;
     size_t count_ = 0;
 };
 
@@ -106,6 +174,7 @@ inline bool HashTable<Key, Value, KeyView>::insert(Key&& key, U&& value) {
             array_[index].key_ = std::move(key);
             array_[index].hash_ = hash | flag; // mark as occupied!
             array_[index].value_ = std::forward<U>(value);
+            setControl(index, makeControl(hash));
 
             count_++;
 
@@ -127,19 +196,145 @@ const Value* HashTable<Key, Value, KeyView>::find(const KeyView& key) const {
     const auto hash = makeHash(key);
     // NB: array size is always power of two!
     const auto mask = array_.size() - 1;
+#if VST_HASHTABLE_SSE2
+    const auto ctrl = _mm_set1_epi8((char)makeControl(hash));
+    const auto empty = _mm_set1_epi8((char)emptyControl);
+    for (size_t index = hash & mask;; index = (index + groupSize) & mask) {
+        auto group = _mm_loadu_si128((const __m128i *)&control_[index]);
+        uint32_t matches = _mm_movemask_epi8(_mm_cmpeq_epi8(group, ctrl));
+        uint32_t empties = _mm_movemask_epi8(_mm_cmpeq_epi8(group, empty));
+        if (empties) {
+            // ignore all slots after the first empty slot
+            matches &= (1u << detail::countTrailingZeros(empties)) - 1;
+        }
+        while (matches) {
+            auto i = (index + detail::countTrailingZeros(matches)) & mask;
+            if (hash == array_[i].hash() && key == array_[i].key_) {
+                return &array_[i].value_; // found match!
+            }
+            matches &= matches - 1; // clear lowest bit
+        }
+        if (empties) {
+            return nullptr; // hit empty slot
+        }
+    }
+#else
+    const auto ctrl = makeControl(hash);
     for (size_t index = hash;; ++index) {
         index = index & mask;
-        if (array_[index].empty()) {
+        auto c = control_[index];
+        if (c == emptyControl) {
             return nullptr; // hit empty slot
-        } else {
+        } else if (c == ctrl) {
             if (hash == array_[index].hash() && key == array_[index].key_) {
                 return &array_[index].value_; // found match!
             }
         }
     }
+#endif
     // unreachable (the hashtable should always contain empty slots)
     assert(false);
     return nullptr;
 }
 
+// HashTable for integer keys with a "frozen" mode: freeze() checks if the
+// keys are (mostly) sequential and, if so, builds a dense lookup array.
+// This is typically the case for parameter indices and often for VST3
+// parameter IDs. Inserting new keys after freeze() is allowed, but falls
+// back to the hashtable until freeze() is called again.
+template<typename Key, typename Value>
+class DenseHashTable {
+public:
+    template<typename U>
+    bool insert(Key key, U&& value) {
+        if (table_.insert(key, std::forward<U>(value))) {
+            dense_.clear(); // unfreeze
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    const Value* find(Key key) const {
+        if (!dense_.empty()) {
+            // NB: unsigned arithmetic, so this is also a lower bound check
+            auto index = offset(key, first_);
+            if (index < dense_.size() && dense_[index].valid) {
+                return &dense_[index].value;
+            } else {
+                return nullptr;
+            }
+        } else {
+            return table_.find(key);
+        }
+    }
+
+    template<typename U>
+    Value findOr(Key key, U&& value) const {
+        if (auto result = find(key)) {
+            return *result;
+        } else {
+            return std::forward<U>(value);
+        }
+    }
+
+    size_t size() const {
+        return table_.size();
+    }
+
+    void clear() {
+        table_.clear();
+        dense_.clear();
+    }
+
+    bool frozen() const {
+        return !dense_.empty();
+    }
+
+    // Try to build a dense lookup array; the key range may be at most
+    // 'maxSparseness' times the number of keys (plus some slack).
+    bool freeze() {
+        dense_.clear();
+        if (table_.size() == 0) {
+            return false;
+        }
+        Key min = std::numeric_limits<Key>::max();
+        Key max = std::numeric_limits<Key>::min();
+        table_.forEach([&](const Key& key, const Value&) {
+            min = std::min(min, key);
+            max = std::max(max, key);
+        });
+        auto range = (uint64_t)(offset(max, min)) + 1;
+        if (range > table_.size() * maxSparseness + minDenseSize) {
+            return false;
+        }
+        first_ = min;
+        dense_.resize(range);
+        table_.forEach([&](const Key& key, const Value& value) {
+            auto& e = dense_[offset(key, first_)];
+            e.value = value;
+            e.valid = true;
+        });
+        return true;
+    }
+private:
+    static constexpr size_t maxSparseness = 2;
+    static constexpr size_t minDenseSize = 64;
+
+    using UKey = std::make_unsigned_t<Key>;
+
+    static size_t offset(Key key, Key first) {
+        return (size_t)((UKey)key - (UKey)first);
+    }
+
+    struct Entry {
+        Value value{};
+        bool valid = false;
+    };
+
+    HashTable<Key, Value> table_;
+    std::vector<Entry> dense_;
+    Key first_{};
+};
+
 } // namespace vst
@@ -281,11 +281,10 @@ public:
         return path_;
     }
 
-    ProcessHandle probe(const std::string& path, int id,
-                        const std::string& tmpPath) const override;
-
     ProcessHandle bridge(const std::string& shmPath, intptr_t logPipe) const override;
 
+    ProcessHandle probeWorker(intptr_t cmdPipe, intptr_t replyPipe) const override;
+
     virtual bool test() const {
         return doTest(path_);
     }
@@ -323,27 +322,6 @@ bool HostApp::doTest(const std::string& cmd, const std::string& args) const {
 
 #ifdef _WIN32
 
-ProcessHandle HostApp::probe(const std::string &pluginPath, int id,
-                             const std::string &tmpPath) const {
-    // turn id into hex string
-    char idString[12];
-    if (id >= 0){
-        snprintf(idString, sizeof(idString), "0x%X", id);
-    } else {
-        sprintf(idString, "_");
-    }
-    /// LOG_DEBUG("host path: " << path_);
-    /// LOG_DEBUG("temp path: " << tmpPath);
-    // arguments: host.exe probe <plugin_path> <plugin_id> <file_path>
-    // NOTE: we need to quote string arguments (in case they contain spaces)
-    std::stringstream cmdline;
-    cmdline << fileName(path_) << " probe "
-            << "\"" << pluginPath << "\" " << idString
-            << " \"" << tmpPath + "\"";
-
-    return createProcess(cmdline.str(), PROBE_LOG);
-}
-
 ProcessHandle HostApp::bridge(const std::string &shmPath, intptr_t logPipe) const {
     /// LOG_DEBUG("host path: " << shorten(hostPath));
     // arguments: host.exe bridge <parent_pid> <shm_path> <log_pipe>
@@ -356,6 +334,16 @@ ProcessHandle HostApp::bridge(const std::string &shmPath, intptr_t logPipe) cons
     return createProcess(cmdline.str(), BRIDGE_LOG);
 }
 
+ProcessHandle HostApp::probeWorker(intptr_t cmdPipe, intptr_t replyPipe) const {
+    // arguments: host.exe probe_worker <parent_pid> <cmd_pipe> <reply_pipe>
+    // NOTE: Win32 handles can be safely cast to DWORD!
+    std::stringstream cmdline;
+    cmdline << fileName(path_) << " probe_worker " << getCurrentProcessId()
+            << " " << (DWORD)cmdPipe << " " << (DWORD)replyPipe;
+
+    return createProcess(cmdline.str(), PROBE_LOG);
+}
+
 ProcessHandle HostApp::createProcess(const std::string &cmdline, bool log) const {
     // LOG_DEBUG(path_ << " " << cmdline);
 
@@ -408,20 +396,6 @@ ProcessHandle HostApp::createProcess(const char *cmd, T&&... args) {
     return ProcessHandle(pid);
 }
 
-ProcessHandle HostApp::probe(const std::string &pluginPath, int id,
-                             const std::string &tmpPath) const {
-    // turn id into hex string
-    char idString[12];
-    if (id >= 0){
-        snprintf(idString, sizeof(idString), "0x%X", id);
-    } else {
-        sprintf(idString, "_");
-    }
-    // arguments: host probe <plugin_path> <plugin_id> <file_path>
-    return createProcess<PROBE_LOG>(path_.c_str(), fileName(path_).c_str(), "probe",
-                                    pluginPath.c_str(), idString, tmpPath.c_str());
-}
-
 ProcessHandle HostApp::bridge(const std::string &shmPath, intptr_t logPipe) const {
     auto parent = std::to_string(getpid());
     auto pipe = std::to_string(static_cast<int>(logPipe));
@@ -430,6 +404,15 @@ ProcessHandle HostApp::bridge(const std::string &shmPath, intptr_t logPipe) cons
                                      parent.c_str(), shmPath.c_str(), pipe.c_str());
 }
 
+ProcessHandle HostApp::probeWorker(intptr_t cmdPipe, intptr_t replyPipe) const {
+    auto parent = std::to_string(getpid());
+    auto cmd = std::to_string(static_cast<int>(cmdPipe));
+    auto reply = std::to_string(static_cast<int>(replyPipe));
+    // arguments: host probe_worker <parent_pid> <cmd_pipe> <reply_pipe>
+    return createProcess<PROBE_LOG>(path_.c_str(), fileName(path_).c_str(), "probe_worker",
+                                    parent.c_str(), cmd.c_str(), reply.c_str());
+}
+
 #endif
 
 #ifdef __APPLE__
@@ -451,20 +434,6 @@ class UniversalHostApp : public HostApp {
 public:
     using HostApp::HostApp;
 
-    ProcessHandle probe(const std::string& pluginPath, int id,
-                        const std::string& tmpPath) const override {
-        // turn id into hex string
-        char idString[12];
-        if (id >= 0) {
-            snprintf(idString, sizeof(idString), "0x%X", id);
-        } else {
-            sprintf(idString, "_");
-        }
-        // arguments: arch -<arch> <host_path> probe <plugin_path> <plugin_id> <file_path>
-        return createProcess<PROBE_LOG>("arch", "arch", archOption(arch_), path_.c_str(), "probe",
-                                        pluginPath.c_str(), idString, tmpPath.c_str());
-    }
-
     ProcessHandle bridge(const std::string& shmPath, intptr_t logPipe) const override {
         auto parent = std::to_string(getpid());
         auto pipe = std::to_string(static_cast<int>(logPipe));
@@ -473,6 +442,15 @@ public:
                                          parent.c_str(), shmPath.c_str(), pipe.c_str());
     }
 
+    ProcessHandle probeWorker(intptr_t cmdPipe, intptr_t replyPipe) const override {
+        auto parent = std::to_string(getpid());
+        auto cmd = std::to_string(static_cast<int>(cmdPipe));
+        auto reply = std::to_string(static_cast<int>(replyPipe));
+        // arguments: arch -<arch> <host_path> probe_worker <parent_pid> <cmd_pipe> <reply_pipe>
+        return createProcess<PROBE_LOG>("arch", "arch", archOption(arch_), path_.c_str(), "probe_worker",
+                                        parent.c_str(), cmd.c_str(), reply.c_str());
+    }
+
     bool test() const override {
         std::stringstream ss;
         ss << archOption(arch_) << " \"" << path_ << "\"";
@@ -485,21 +463,6 @@ public:
 class WineHostApp : public HostApp {
     using HostApp::HostApp;
 
-    ProcessHandle probe(const std::string& pluginPath, int id,
-                        const std::string& tmpPath) const override {
-        auto wine = wineCmd();
-        // turn id into hex string
-        char idString[12];
-        if (id >= 0){
-            snprintf(idString, sizeof(idString), "0x%X", id);
-        } else {
-            sprintf(idString, "_");
-        }
-        // arguments: wine <host_path> probe <plugin_path> <plugin_id> <file_path>
-        return createProcess<PROBE_LOG>(wine, wine, path_.c_str(), "probe",
-                                        pluginPath.c_str(), idString, tmpPath.c_str());
-    }
-
     ProcessHandle bridge(const std::string& shmPath, intptr_t logPipe) const override {
         auto wine = wineCmd();
         auto parent = std::to_string(getpid());
@@ -509,6 +472,16 @@ class WineHostApp : public HostApp {
                                          parent.c_str(), shmPath.c_str(), pipe.c_str());
     }
 
+    ProcessHandle probeWorker(intptr_t cmdPipe, intptr_t replyPipe) const override {
+        auto wine = wineCmd();
+        auto parent = std::to_string(getpid());
+        auto cmd = std::to_string(static_cast<int>(cmdPipe));
+        auto reply = std::to_string(static_cast<int>(replyPipe));
+        // arguments: wine <host_path> probe_worker <parent_pid> <cmd_pipe> <reply_pipe>
+        return createProcess<PROBE_LOG>(wine, wine, path_.c_str(), "probe_worker",
+                                        parent.c_str(), cmd.c_str(), reply.c_str());
+    }
+
     bool test() const override {
         std::stringstream ss;
         ss << "\"" << path_ << "\"";
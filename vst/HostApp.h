@@ -23,6 +23,9 @@ public:
     ProcessHandle(const PROCESS_INFORMATION& pi)
         : pi_(pi) {}
 
+    // NB: closed after checkIfRunning() returned false!
+    HANDLE nativeHandle() const { return pi_.hProcess; }
+
     ~ProcessHandle() {
         close();
     }
@@ -91,10 +94,10 @@ public:
 
     virtual const std::string& path() const = 0;
 
-    virtual ProcessHandle probe(const std::string& path, int id,
-                                const std::string& tmpPath) const = 0;
-
     virtual ProcessHandle bridge(const std::string& shmPath, intptr_t logPipe) const = 0;
+
+    // a long-lived probe process which probes plugins on request, see ProbeWorker.
+    virtual ProcessHandle probeWorker(intptr_t cmdPipe, intptr_t replyPipe) const = 0;
 };
 
 } // vst
@@ -141,6 +141,12 @@ enum class Bypass {
     Soft // let tails ring out
 };
 
+enum class SilenceMode {
+    Off,
+    Detect, // detect silent input busses, see Steinberg::Vst::AudioBusBuffers::silenceFlags
+    Sleep // also stop processing while the plugin is idle, i.e. there is no input and no events
+};
+
 enum class PluginType {
     VST2,
     VST3
@@ -161,6 +167,10 @@ class PluginDesc;
 
 class IWindow;
 
+class ParamCache;
+
+class DSPLoadMeter;
+
 struct AudioBus {
     int numChannels;
     union {
@@ -197,9 +207,16 @@ class IPlugin {
     virtual void setupProcessing(double sampleRate, int maxBlockSize,
                                  ProcessPrecision precision, ProcessMode mode) = 0;
     virtual void process(ProcessData& data) = 0;
+    // opt-in DSP load metering (nullptr disables it), see DSPLoadMeter.
+    // Threaded and bridged plugins measure themselves, including the time spent
+    // waiting for the DSP thread resp. the bridge, and return true. Otherwise
+    // the host is expected to measure the process() call.
+    // NB: the meter must outlive the plugin or be unset first.
+    virtual bool setDSPLoadMeter(DSPLoadMeter *meter) { return false; }
     virtual void suspend() = 0;
     virtual void resume() = 0;
     virtual void setBypass(Bypass state) = 0;
+    virtual void setSilenceMode(SilenceMode mode) = 0;
     virtual void setNumSpeakers(int *input, int numInputs, int *output, int numOutputs) = 0;
     virtual int getLatencySamples() = 0;
 
@@ -224,6 +241,25 @@ class IPlugin {
     virtual bool setParameter(int index, std::string_view str, int sampleOffset = 0) = 0;
     virtual float getParameter(int index) const = 0;
     virtual size_t getParameterString(int index, ParamStringBuffer& buffer) const = 0;
+    // get the values (and optionally the display strings) of 'count' parameters,
+    // starting at 'first', in a single call; 'strings' may be nullptr.
+    // Prefer this over getParameter() resp. getParameterString() for parameter dumps.
+    virtual void getParameters(int first, int count, float *values,
+                               ParamStringBuffer *strings = nullptr) const {
+        for (int i = 0; i < count; ++i) {
+            values[i] = getParameter(first + i);
+            if (strings) {
+                getParameterString(first + i, strings[i]);
+            }
+        }
+    }
+    // lock-free parameter cache which can be read from any thread;
+    // returns nullptr if the plugin doesn't have one, see ParamCache.
+    virtual const ParamCache * getParameterCache() const { return nullptr; }
+    // only send the last value (resp. the first and last value of a ramp) for
+    // repeated parameter changes within a process block. This only affects
+    // threaded and bridged plugins, see DeferredPlugin.
+    virtual void setParameterCoalescing(bool enable) {}
 
     virtual void setProgram(int index) = 0;
     virtual void setProgramName(std::string_view name) = 0;
@@ -287,8 +323,12 @@ enum class RunMode {
 
 class IModule {
  public:
+    // Modules are shared process-wide, so loading the same module again
+    // just returns the existing instance; see also setModuleCacheSize().
+    // init() only calls the module's init function the first time and
+    // exit() defers the module's exit function until the module is unloaded.
     // throws an Error exception on failure!
-    static std::unique_ptr<IModule> load(const std::string& path);
+    static std::shared_ptr<IModule> load(const std::string& path);
 
     virtual ~IModule(){}
     virtual bool init() = 0; // VST3 only
@@ -309,7 +349,8 @@ class Error : public std::exception {
         SystemError,
         ModuleError,
         PluginError,
-        UnknownError
+        UnknownError,
+        Timeout // e.g. a probe process hangs
     };
 
     Error(ErrorCode code = NoError)
@@ -381,6 +422,19 @@ using SearchCallback = std::function<void(const std::string&)>;
 void search(const std::string& dir, SearchCallback fn,
             bool filterByExtension = true, const std::vector<std::string>& excludePaths = {});
 
+// returns true if the search should be stopped; must be thread-safe!
+using SearchCancelCallback = std::function<bool()>;
+
+// like search(), but subdirectories are listed concurrently on up to 'maxThreads' threads
+// (0 -> default). This helps a lot with slow file systems, e.g. network drives.
+// The callback function is never called concurrently, but the order of the results
+// is unspecified. 'cancelled' (optional) is polled between directory entries,
+// so the search can be stopped in the middle of the traversal.
+// Directory symlinks which have already been visited are skipped.
+void searchParallel(const std::string& dir, SearchCallback fn, bool filterByExtension = true,
+                    const std::vector<std::string>& excludePaths = {}, int maxThreads = 0,
+                    SearchCancelCallback cancelled = nullptr);
+
 // recursively search 'dir' for a VST plugin. returns empty string on failure
 std::string find(const std::string& dir, const std::string& path);
 
@@ -447,11 +501,109 @@ namespace UIThread {
     using Handle = int32_t;
     constexpr Handle invalidHandle = -1;
 
-    Handle addPollFunction(PollFunction fn, void *context);
+    // Poll functions are called periodically on the UI thread. Event-driven
+    // poll functions are only called (soon) after notifyPollFunctions(),
+    // apart from a slow fallback timer.
+    Handle addPollFunction(PollFunction fn, void *context, bool eventDriven = false);
 
     void removePollFunction(Handle handle);
+
+    // Wake up the UI thread and call all poll functions. Notifications are
+    // coalesced, so this is cheap. Can be called from any (non-realtime) thread.
+    void notifyPollFunctions();
 }
 
 void setNumDSPThreads(int numThreads);
 
+enum class DSPScheduler {
+    Shared, // single task queue for all DSP threads
+    RoundRobin, // per-thread task queues + work stealing; tasks are distributed round-robin
+    Affinity // per-thread task queues + work stealing; each plugin sticks to a thread
+};
+
+// set the DSP thread pool scheduler (default: DSPScheduler::Shared)
+void setDSPScheduler(DSPScheduler scheduler);
+
+struct DSPThreadAffinity {
+    std::vector<int> cpus; // logical CPUs to use (empty = all CPUs)
+    std::vector<int> exclude; // logical CPUs to keep free, e.g. for the main audio thread
+    bool skipSMT = false; // only use a single logical CPU per physical core
+    int numaNode = -1; // only use CPUs of the given NUMA node (-1 = all nodes)
+    bool numaPools = false; // one thread pool per NUMA node (only with work-stealing schedulers)
+
+    bool empty() const {
+        return cpus.empty() && exclude.empty() && !skipSMT && numaNode < 0 && !numaPools;
+    }
+};
+
+// pin the DSP helper threads to a set of CPUs (default: no pinning).
+// If the number of DSP threads has not been set explicitly, we start
+// one DSP helper thread per selected CPU.
+// With 'numaPools', the DSP helper threads are grouped by NUMA node and each
+// plugin is only processed by the threads of a single node (round-robin).
+void setDSPThreadAffinity(const DSPThreadAffinity& affinity);
+
+// Set the wait policy for DSP threads: spin for 'spin', then yield for 'yield'
+// and finally block. This applies to DSP helper threads waiting for new tasks and
+// audio threads waiting for multi-threaded plugins. If 'adaptive' is true, 'spin'
+// and 'yield' are fractions of the measured block period, otherwise they are in seconds.
+// The default is to block immediately.
+void setDSPWaitPolicy(double spin, double yield, bool adaptive);
+
+struct DSPWaitStats {
+    uint64_t spins; // waits that succeeded while spinning
+    uint64_t yields; // waits that succeeded while yielding
+    uint64_t sleeps; // waits that had to block
+};
+
+DSPWaitStats getDSPWaitStats(bool reset = false);
+
+// Set the number of RT channels for new shared plugin bridges (0 = default =
+// number of DSP threads). Each DSP helper thread has its own RT channel, so
+// there should be at least as many channels as DSP threads plus audio threads.
+void setBridgeRTChannels(int numChannels);
+
+struct BridgeLockStats {
+    uint64_t acquired; // RT channel requests
+    uint64_t contended; // requests where the thread's own RT channel was busy
+};
+
+// RT channel lock statistics of all shared plugin bridges
+BridgeLockStats getBridgeLockStats(bool reset = false);
+
+// Lock DSP buffers (ThreadedPlugin, plugin bridge) into physical memory and
+// prefault them when they are allocated, so that the audio thread doesn't run
+// into page faults after idle periods or under memory pressure. 'hugePages'
+// additionally requests transparent huge pages for large buffers and the
+// shared memory of new plugin bridges (Linux only). The setting is forwarded
+// to new plugin bridge processes. (default: off)
+// NB: the amount of locked memory is limited by RLIMIT_MEMLOCK resp. the
+// working set size on Windows; if locking fails, buffers are only prefaulted.
+void setMemoryLocking(bool lock, bool hugePages = false);
+
+// Keep a pool of pre-spawned sandbox processes for each CPU architecture, so
+// that opening a sandboxed plugin doesn't have to wait for the subprocess to
+// start up. The pool is refilled in the background. (default: 0 = no pool)
+void setBridgePoolSize(int size);
+
+// Let bridged and sandboxed plugins poll the shared memory channel up to 'count'
+// times before going to sleep while waiting for the other side. This can reduce
+// the round trip latency considerably, at the cost of CPU time. The setting only
+// affects plugin bridges which are created afterwards, so call it before opening
+// any plugins resp. before setBridgePoolSize(). Spinning is always disabled on
+// single core machines. (default: 0 = no spinning)
+void setBridgeSpinCount(int count);
+
+// Keep the most recently loaded plugin modules resident, even if they are not
+// used anymore, so that reloading a plugin (e.g. after the plugin dictionary has
+// been cleared) doesn't have to load and initialize the module again.
+// Set to 0 to unload modules as soon as possible. (default: 8)
+void setModuleCacheSize(int size);
+
+// Set the update rate (in frames per second) of plugin editors. All open editors
+// are updated together on the UI thread. Editors in background windows are only
+// updated with 'backgroundFps'; editors in minimized or hidden windows are not
+// updated at all. A value <= 0 keeps the current setting. (default: ~33 resp. 10)
+void setEditorFrameRate(double fps, double backgroundFps = 0);
+
 } // vst
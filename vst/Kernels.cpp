@@ -0,0 +1,139 @@
+#include "Kernels.h"
+#include "KernelsImpl.h"
+#include "Log.h"
+
+#if VST_KERNELS_AVX2 && defined(_MSC_VER)
+# include <intrin.h>
+#endif
+
+namespace vst {
+namespace kernels {
+
+// kernels for the instruction set selected at compile time
+#if defined(__AVX2__)
+static constexpr KernelTable gDefaultKernels = makeKernelTable<AVX2Float, AVX2Double>("AVX2");
+#elif VST_KERNELS_SSE2
+static constexpr KernelTable gDefaultKernels = makeKernelTable<SSE2Float, SSE2Double>("SSE2");
+#elif VST_KERNELS_NEON
+static constexpr KernelTable gDefaultKernels = makeKernelTable<NEONFloat, NEONDouble>("NEON");
+#else
+static constexpr KernelTable gDefaultKernels = makeKernelTable<Scalar<float>, Scalar<double>>("scalar");
+#endif
+
+#if VST_KERNELS_AVX2 && !defined(__AVX2__)
+static bool haveAVX2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    bool osxsave = info[2] & (1 << 27);
+    bool avx = info[2] & (1 << 28);
+    if (!osxsave || !avx) {
+        return false;
+    }
+    // check if the OS saves the YMM registers
+    if ((_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+static const KernelTable& selectKernels() {
+#if VST_KERNELS_AVX2 && !defined(__AVX2__)
+    if (haveAVX2()) {
+        LOG_DEBUG("using AVX2 kernels");
+        return getAVX2Kernels();
+    }
+#endif
+    LOG_DEBUG("using " << gDefaultKernels.name << " kernels");
+    return gDefaultKernels;
+}
+
+// NB: the function table is initialized on first use; this avoids
+// problems with the static initialization order.
+static const KernelTable& table() {
+    static const KernelTable& t = selectKernels();
+    return t;
+}
+
+void fill(float *dst, float value, int n) {
+    table().f32.fill(dst, value, n);
+}
+
+void fill(double *dst, double value, int n) {
+    table().f64.fill(dst, value, n);
+}
+
+void copy(double *dst, const float *src, int n) {
+    table().widen(dst, src, n);
+}
+
+void copy(float *dst, const double *src, int n) {
+    table().narrow(dst, src, n);
+}
+
+void add(float *dst, const float *src, int n) {
+    table().f32.add(dst, src, n);
+}
+
+void add(double *dst, const double *src, int n) {
+    table().f64.add(dst, src, n);
+}
+
+void fade(float *dst, const float *src, int n, float gain, float inc) {
+    table().f32.fade(dst, src, n, gain, inc);
+}
+
+void fade(double *dst, const double *src, int n, double gain, double inc) {
+    table().f64.fade(dst, src, n, gain, inc);
+}
+
+void fadeAdd(float *dst, const float *src, int n, float gain, float inc) {
+    table().f32.fadeAdd(dst, src, n, gain, inc);
+}
+
+void fadeAdd(double *dst, const double *src, int n, double gain, double inc) {
+    table().f64.fadeAdd(dst, src, n, gain, inc);
+}
+
+void crossfade(float *dst, const float *a, const float *b,
+               int n, float gain, float inc) {
+    table().f32.crossfade(dst, a, b, n, gain, inc);
+}
+
+void crossfade(double *dst, const double *a, const double *b,
+               int n, double gain, double inc) {
+    table().f64.crossfade(dst, a, b, n, gain, inc);
+}
+
+float sumOfSquares(const float *src, int n) {
+    return table().f32.sumOfSquares(src, n);
+}
+
+double sumOfSquares(const double *src, int n) {
+    return table().f64.sumOfSquares(src, n);
+}
+
+bool isSilent(const float *src, int n, float threshold) {
+    return table().f32.isSilent(src, n, threshold);
+}
+
+bool isSilent(const double *src, int n, double threshold) {
+    return table().f64.isSilent(src, n, threshold);
+}
+
+const char * instructionSet() {
+    return table().name;
+}
+
+} // kernels
+} // vst
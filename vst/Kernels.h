@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+
+namespace vst {
+
+// Vectorized DSP kernels for the (per-channel) inner loops of bypassing,
+// crossfading and buffer conversion.
+//
+// The kernels are compiled for the instruction set selected at compile time
+// (SSE2, NEON or plain C++). On x86, we additionally compile AVX2 versions
+// which are selected at runtime if the CPU supports them.
+// With the NATIVE CMake option, the best instruction set is chosen at
+// compile time and no runtime dispatch is necessary.
+//
+// NB: all kernels accept unaligned buffers. 'dst' may alias the
+// (first) source buffer, but must not partially overlap.
+
+namespace kernels {
+
+// dst[i] = value
+void fill(float *dst, float value, int n);
+void fill(double *dst, double value, int n);
+
+inline void clear(float *dst, int n) { fill(dst, 0.f, n); }
+inline void clear(double *dst, int n) { fill(dst, 0.0, n); }
+
+// dst[i] = src[i], with float <-> double conversion
+inline void copy(float *dst, const float *src, int n) {
+    std::copy(src, src + n, dst);
+}
+inline void copy(double *dst, const double *src, int n) {
+    std::copy(src, src + n, dst);
+}
+void copy(double *dst, const float *src, int n);
+void copy(float *dst, const double *src, int n);
+
+// dst[i] += src[i]
+void add(float *dst, const float *src, int n);
+void add(double *dst, const double *src, int n);
+
+// dst[i] = src[i] * (gain + i * inc)
+void fade(float *dst, const float *src, int n, float gain, float inc);
+void fade(double *dst, const double *src, int n, double gain, double inc);
+
+// dst[i] += src[i] * (gain + i * inc)
+void fadeAdd(float *dst, const float *src, int n, float gain, float inc);
+void fadeAdd(double *dst, const double *src, int n, double gain, double inc);
+
+// g = gain + i * inc; dst[i] = a[i] * g + b[i] * (1 - g)
+void crossfade(float *dst, const float *a, const float *b,
+               int n, float gain, float inc);
+void crossfade(double *dst, const double *a, const double *b,
+               int n, double gain, double inc);
+
+// sum of all squared samples (e.g. for RMS)
+float sumOfSquares(const float *src, int n);
+double sumOfSquares(const double *src, int n);
+
+// check if all samples are below the given threshold (absolute value);
+// returns early on the first loud sample.
+bool isSilent(const float *src, int n, float threshold);
+bool isSilent(const double *src, int n, double threshold);
+
+// name of the selected instruction set, e.g. "AVX2"
+const char * instructionSet();
+
+} // kernels
+
+} // vst
@@ -0,0 +1,19 @@
+// NB: this file must be compiled with AVX2 enabled (-mavx2 resp. /arch:AVX2)
+// and must only be called after checking the CPU features, see Kernels.cpp.
+#include "KernelsImpl.h"
+
+#ifndef __AVX2__
+# error "KernelsAVX2.cpp must be compiled with AVX2 support"
+#endif
+
+namespace vst {
+namespace kernels {
+
+static constexpr KernelTable gAVX2Kernels = makeKernelTable<AVX2Float, AVX2Double>("AVX2");
+
+const KernelTable& getAVX2Kernels() {
+    return gAVX2Kernels;
+}
+
+} // kernels
+} // vst
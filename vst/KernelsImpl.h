@@ -0,0 +1,400 @@
+#pragma once
+
+// Generic kernel implementations, parametrized by a SIMD traits class.
+// This header is included by Kernels.cpp and KernelsAVX2.cpp, which are
+// compiled with different instruction sets. Therefore everything in here
+// must have internal linkage! Otherwise the linker might merge functions
+// compiled for different instruction sets (ODR).
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define VST_KERNELS_SSE2 1
+# include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+# include <immintrin.h>
+#endif
+
+// NB: only use NEON on ARM64 because we also need double precision.
+#if defined(__ARM_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+# define VST_KERNELS_NEON 1
+# include <arm_neon.h>
+#endif
+
+#include <cmath>
+
+namespace vst {
+namespace kernels {
+
+template<typename T>
+struct KernelFuncs {
+    void (*fill)(T *dst, T value, int n);
+    void (*add)(T *dst, const T *src, int n);
+    void (*fade)(T *dst, const T *src, int n, T gain, T inc);
+    void (*fadeAdd)(T *dst, const T *src, int n, T gain, T inc);
+    void (*crossfade)(T *dst, const T *a, const T *b, int n, T gain, T inc);
+    T (*sumOfSquares)(const T *src, int n);
+    bool (*isSilent)(const T *src, int n, T threshold);
+};
+
+struct KernelTable {
+    const char *name;
+    KernelFuncs<float> f32;
+    KernelFuncs<double> f64;
+    void (*widen)(double *dst, const float *src, int n);
+    void (*narrow)(float *dst, const double *src, int n);
+};
+
+#if VST_KERNELS_AVX2
+// defined in KernelsAVX2.cpp
+const KernelTable& getAVX2Kernels();
+#endif
+
+namespace {
+
+//----------------------------- traits -------------------------------//
+
+// Every traits class provides:
+// - value_type and reg (the register type)
+// - width (number of elements per register)
+// - load(), store(), set1(), add(), sub(), mul(), abs(), max()
+// - ramp(start, inc): elements {start, start + inc, start + 2 * inc, ...}
+// - anyGreaterEqual(a, b): true if any element of 'a' is >= 'b'
+// - sum(): horizontal sum
+// The double precision traits also provide
+// - widen(), narrow(): convert 'width' elements from/to float
+
+template<typename T>
+struct Scalar {
+    using value_type = T;
+    using reg = T;
+    static constexpr int width = 1;
+    static reg load(const T *p) { return *p; }
+    static void store(T *p, reg a) { *p = a; }
+    static reg set1(T v) { return v; }
+    static reg add(reg a, reg b) { return a + b; }
+    static reg sub(reg a, reg b) { return a - b; }
+    static reg mul(reg a, reg b) { return a * b; }
+    static reg abs(reg a) { return std::abs(a); }
+    static reg max(reg a, reg b) { return a > b ? a : b; }
+    static reg ramp(T start, T inc) { return start; }
+    static bool anyGreaterEqual(reg a, reg b) { return a >= b; }
+    static T sum(reg a) { return a; }
+    // only for double
+    static reg widen(const float *p) { return *p; }
+    static void narrow(float *p, reg a) { *p = a; }
+};
+
+#if VST_KERNELS_SSE2
+struct SSE2Float {
+    using value_type = float;
+    using reg = __m128;
+    static constexpr int width = 4;
+    static reg load(const float *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, reg a) { _mm_storeu_ps(p, a); }
+    static reg set1(float v) { return _mm_set1_ps(v); }
+    static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+    static reg abs(reg a) {
+        return _mm_and_ps(a, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+    }
+    static reg max(reg a, reg b) { return _mm_max_ps(a, b); }
+    static reg ramp(float start, float inc) {
+        return _mm_setr_ps(start, start + inc, start + 2 * inc, start + 3 * inc);
+    }
+    static bool anyGreaterEqual(reg a, reg b) {
+        return _mm_movemask_ps(_mm_cmpge_ps(a, b)) != 0;
+    }
+    static float sum(reg a) {
+        auto b = _mm_add_ps(a, _mm_movehl_ps(a, a));
+        return _mm_cvtss_f32(_mm_add_ss(b, _mm_shuffle_ps(b, b, 1)));
+    }
+};
+
+struct SSE2Double {
+    using value_type = double;
+    using reg = __m128d;
+    static constexpr int width = 2;
+    static reg load(const double *p) { return _mm_loadu_pd(p); }
+    static void store(double *p, reg a) { _mm_storeu_pd(p, a); }
+    static reg set1(double v) { return _mm_set1_pd(v); }
+    static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+    static reg abs(reg a) {
+        return _mm_and_pd(a, _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL)));
+    }
+    static reg max(reg a, reg b) { return _mm_max_pd(a, b); }
+    static reg ramp(double start, double inc) {
+        return _mm_setr_pd(start, start + inc);
+    }
+    static bool anyGreaterEqual(reg a, reg b) {
+        return _mm_movemask_pd(_mm_cmpge_pd(a, b)) != 0;
+    }
+    static double sum(reg a) {
+        return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a)));
+    }
+    static reg widen(const float *p) {
+        return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)p)));
+    }
+    static void narrow(float *p, reg a) {
+        _mm_storel_epi64((__m128i *)p, _mm_castps_si128(_mm_cvtpd_ps(a)));
+    }
+};
+#endif
+
+#if defined(__AVX2__)
+struct AVX2Float {
+    using value_type = float;
+    using reg = __m256;
+    static constexpr int width = 8;
+    static reg load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, reg a) { _mm256_storeu_ps(p, a); }
+    static reg set1(float v) { return _mm256_set1_ps(v); }
+    static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    static reg abs(reg a) {
+        return _mm256_and_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff)));
+    }
+    static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+    static reg ramp(float start, float inc) {
+        return _mm256_setr_ps(start, start + inc, start + 2 * inc, start + 3 * inc,
+            start + 4 * inc, start + 5 * inc, start + 6 * inc, start + 7 * inc);
+    }
+    static bool anyGreaterEqual(reg a, reg b) {
+        return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ)) != 0;
+    }
+    static float sum(reg a) {
+        auto b = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+        b = _mm_add_ps(b, _mm_movehl_ps(b, b));
+        return _mm_cvtss_f32(_mm_add_ss(b, _mm_shuffle_ps(b, b, 1)));
+    }
+};
+
+struct AVX2Double {
+    using value_type = double;
+    using reg = __m256d;
+    static constexpr int width = 4;
+    static reg load(const double *p) { return _mm256_loadu_pd(p); }
+    static void store(double *p, reg a) { _mm256_storeu_pd(p, a); }
+    static reg set1(double v) { return _mm256_set1_pd(v); }
+    static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+    static reg abs(reg a) {
+        return _mm256_and_pd(a, _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL)));
+    }
+    static reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+    static reg ramp(double start, double inc) {
+        return _mm256_setr_pd(start, start + inc, start + 2 * inc, start + 3 * inc);
+    }
+    static bool anyGreaterEqual(reg a, reg b) {
+        return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GE_OQ)) != 0;
+    }
+    static double sum(reg a) {
+        auto b = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(b, _mm_unpackhi_pd(b, b)));
+    }
+    static reg widen(const float *p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+    static void narrow(float *p, reg a) { _mm_storeu_ps(p, _mm256_cvtpd_ps(a)); }
+};
+#endif
+
+#if VST_KERNELS_NEON
+struct NEONFloat {
+    using value_type = float;
+    using reg = float32x4_t;
+    static constexpr int width = 4;
+    static reg load(const float *p) { return vld1q_f32(p); }
+    static void store(float *p, reg a) { vst1q_f32(p, a); }
+    static reg set1(float v) { return vdupq_n_f32(v); }
+    static reg add(reg a, reg b) { return vaddq_f32(a, b); }
+    static reg sub(reg a, reg b) { return vsubq_f32(a, b); }
+    static reg mul(reg a, reg b) { return vmulq_f32(a, b); }
+    static reg abs(reg a) { return vabsq_f32(a); }
+    static reg max(reg a, reg b) { return vmaxq_f32(a, b); }
+    static reg ramp(float start, float inc) {
+        const float tmp[4] = { start, start + inc, start + 2 * inc, start + 3 * inc };
+        return vld1q_f32(tmp);
+    }
+    static bool anyGreaterEqual(reg a, reg b) {
+        return vmaxvq_u32(vcgeq_f32(a, b)) != 0;
+    }
+    static float sum(reg a) { return vaddvq_f32(a); }
+};
+
+struct NEONDouble {
+    using value_type = double;
+    using reg = float64x2_t;
+    static constexpr int width = 2;
+    static reg load(const double *p) { return vld1q_f64(p); }
+    static void store(double *p, reg a) { vst1q_f64(p, a); }
+    static reg set1(double v) { return vdupq_n_f64(v); }
+    static reg add(reg a, reg b) { return vaddq_f64(a, b); }
+    static reg sub(reg a, reg b) { return vsubq_f64(a, b); }
+    static reg mul(reg a, reg b) { return vmulq_f64(a, b); }
+    static reg abs(reg a) { return vabsq_f64(a); }
+    static reg max(reg a, reg b) { return vmaxq_f64(a, b); }
+    static reg ramp(double start, double inc) {
+        const double tmp[2] = { start, start + inc };
+        return vld1q_f64(tmp);
+    }
+    static bool anyGreaterEqual(reg a, reg b) {
+        return vmaxvq_u32(vreinterpretq_u32_u64(vcgeq_f64(a, b))) != 0;
+    }
+    static double sum(reg a) { return vaddvq_f64(a); }
+    static reg widen(const float *p) { return vcvt_f64_f32(vld1_f32(p)); }
+    static void narrow(float *p, reg a) { vst1_f32(p, vcvt_f32_f64(a)); }
+};
+#endif
+
+//----------------------------- kernels ------------------------------//
+
+template<typename V>
+struct Kernels {
+    using T = typename V::value_type;
+    static constexpr int W = V::width;
+
+    static void fill(T *dst, T value, int n) {
+        auto v = V::set1(value);
+        int i = 0;
+        for (; i + W <= n; i += W) {
+            V::store(dst + i, v);
+        }
+        for (; i < n; ++i) {
+            dst[i] = value;
+        }
+    }
+
+    static void add(T *dst, const T *src, int n) {
+        int i = 0;
+        for (; i + W <= n; i += W) {
+            V::store(dst + i, V::add(V::load(dst + i), V::load(src + i)));
+        }
+        for (; i < n; ++i) {
+            dst[i] += src[i];
+        }
+    }
+
+    static void fade(T *dst, const T *src, int n, T gain, T inc) {
+        auto g = V::ramp(gain, inc);
+        auto step = V::set1(inc * W);
+        int i = 0;
+        for (; i + W <= n; i += W) {
+            V::store(dst + i, V::mul(V::load(src + i), g));
+            g = V::add(g, step);
+        }
+        for (; i < n; ++i) {
+            dst[i] = src[i] * (gain + i * inc);
+        }
+    }
+
+    static void fadeAdd(T *dst, const T *src, int n, T gain, T inc) {
+        auto g = V::ramp(gain, inc);
+        auto step = V::set1(inc * W);
+        int i = 0;
+        for (; i + W <= n; i += W) {
+            auto x = V::mul(V::load(src + i), g);
+            V::store(dst + i, V::add(V::load(dst + i), x));
+            g = V::add(g, step);
+        }
+        for (; i < n; ++i) {
+            dst[i] += src[i] * (gain + i * inc);
+        }
+    }
+
+    static void crossfade(T *dst, const T *a, const T *b, int n, T gain, T inc) {
+        // a * g + b * (1 - g) = b + (a - b) * g
+        auto g = V::ramp(gain, inc);
+        auto step = V::set1(inc * W);
+        int i = 0;
+        for (; i + W <= n; i += W) {
+            auto x = V::load(a + i);
+            auto y = V::load(b + i);
+            V::store(dst + i, V::add(y, V::mul(V::sub(x, y), g)));
+            g = V::add(g, step);
+        }
+        for (; i < n; ++i) {
+            dst[i] = b[i] + (a[i] - b[i]) * (gain + i * inc);
+        }
+    }
+
+    static T sumOfSquares(const T *src, int n) {
+        auto acc = V::set1(0);
+        int i = 0;
+        for (; i + W <= n; i += W) {
+            auto x = V::load(src + i);
+            acc = V::add(acc, V::mul(x, x));
+        }
+        T sum = V::sum(acc);
+        for (; i < n; ++i) {
+            sum += src[i] * src[i];
+        }
+        return sum;
+    }
+
+    static bool isSilent(const T *src, int n, T threshold) {
+        auto thresh = V::set1(threshold);
+        int i = 0;
+        // check 4 registers at once
+        for (; i + 4 * W <= n; i += 4 * W) {
+            auto a = V::abs(V::load(src + i));
+            auto b = V::abs(V::load(src + i + W));
+            auto c = V::abs(V::load(src + i + 2 * W));
+            auto d = V::abs(V::load(src + i + 3 * W));
+            auto peak = V::max(V::max(a, b), V::max(c, d));
+            if (V::anyGreaterEqual(peak, thresh)) {
+                return false;
+            }
+        }
+        for (; i < n; ++i) {
+            if (std::abs(src[i]) >= threshold) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static constexpr KernelFuncs<T> funcs() {
+        return { fill, add, fade, fadeAdd, crossfade, sumOfSquares, isSilent };
+    }
+};
+
+// V: double precision traits
+template<typename V>
+struct ConvertKernels {
+    static constexpr int W = V::width;
+
+    static void widen(double *dst, const float *src, int n) {
+        int i = 0;
+        for (; i + W <= n; i += W) {
+            V::store(dst + i, V::widen(src + i));
+        }
+        for (; i < n; ++i) {
+            dst[i] = src[i];
+        }
+    }
+
+    static void narrow(float *dst, const double *src, int n) {
+        int i = 0;
+        for (; i + W <= n; i += W) {
+            V::narrow(dst + i, V::load(src + i));
+        }
+        for (; i < n; ++i) {
+            dst[i] = src[i];
+        }
+    }
+};
+
+template<typename VF, typename VD>
+constexpr KernelTable makeKernelTable(const char *name) {
+    return { name, Kernels<VF>::funcs(), Kernels<VD>::funcs(),
+             ConvertKernels<VD>::widen, ConvertKernels<VD>::narrow };
+}
+
+} // namespace
+
+} // kernels
+} // vst
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <atomic>
 #include <array>
 #include <memory>
@@ -57,30 +59,186 @@ class LockfreeFifo {
     std::array<T, N> data_;
 };
 
+// Bounded MPMC queue, see http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+// Each slot has its own sequence number, so producers and consumers only contend
+// on their respective head with a single CAS; there are no locks.
+// NB: N must be a power of 2.
+template<typename T, size_t N>
+class LockfreeMPMCQueue {
+    static_assert(N > 1 && (N & (N - 1)) == 0, "N must be a power of 2");
+ public:
+    LockfreeMPMCQueue() {
+        for (size_t i = 0; i < N; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    LockfreeMPMCQueue(const LockfreeMPMCQueue&) = delete;
+
+    LockfreeMPMCQueue& operator=(const LockfreeMPMCQueue&) = delete;
+
+    bool push(const T& data){
+        return emplace(data);
+    }
+    template<typename... TArgs>
+    bool emplace(TArgs&&... args){
+        Cell *cell;
+        auto pos = writeHead_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & (N - 1)];
+            auto seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                // slot is free; try to claim it
+                if (writeHead_.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed)) {
+                    break;
+                } // else: 'pos' has been updated, retry
+            } else if (diff < 0) {
+                return false; // FIFO is full
+            } else {
+                // another producer has claimed the slot
+                pos = writeHead_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = T { std::forward<TArgs>(args)... };
+        cell->sequence.store(pos + 1, std::memory_order_release); // publish
+        return true;
+    }
+    bool pop(T& data){
+        Cell *cell;
+        auto pos = readHead_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & (N - 1)];
+            auto seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                // slot is full; try to claim it
+                if (readHead_.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed)) {
+                    break;
+                } // else: 'pos' has been updated, retry
+            } else if (diff < 0) {
+                return false; // FIFO is empty
+            } else {
+                // another consumer has claimed the slot
+                pos = readHead_.load(std::memory_order_relaxed);
+            }
+        }
+        data = std::move(cell->data);
+        cell->sequence.store(pos + N, std::memory_order_release); // release slot
+        return true;
+    }
+    // NB: only a snapshot!
+    bool empty() const {
+        return readHead_.load(std::memory_order_relaxed)
+                == writeHead_.load(std::memory_order_relaxed);
+    }
+    size_t capacity() const { return N; }
+ private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+    // put the heads on separate cache lines to prevent false sharing
+    alignas(64) std::atomic<size_t> writeHead_{0};
+    alignas(64) std::atomic<size_t> readHead_{0};
+    alignas(64) std::array<Cell, N> cells_;
+};
+
 template<typename T>
 struct Node {
     template<typename... U>
     Node(U&&... args)
         : next_(nullptr), data_(std::forward<U>(args)...) {}
-    Node * next_;
+    std::atomic<Node *> next_;
     T data_;
 };
 
+// Lock-free LIFO stack of free nodes ("Treiber stack"), see UnboundedMPSCQueue.
+// The nodes are linked with their 'next_' member. To prevent the ABA problem,
+// the head contains a tag that is incremented on every pop. On 64-bit platforms
+// the tag is stored in the upper 16 bits of the pointer because user space
+// addresses only use the lower 48 bits (see also boost::lockfree's tagged_ptr);
+// on 32-bit platforms we simply use a 64-bit word.
+template<typename T>
+class NodeStack {
+ public:
+    NodeStack() = default;
+
+    NodeStack(const NodeStack&) = delete;
+
+    NodeStack& operator=(const NodeStack&) = delete;
+
+    void push(Node<T> *node) {
+        auto head = head_.load(std::memory_order_relaxed);
+        do {
+            node->next_.store(pointer(head), std::memory_order_relaxed);
+        } while (!head_.compare_exchange_weak(head, pack(node, tag(head)),
+                    std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    Node<T> * pop() {
+        auto head = head_.load(std::memory_order_acquire);
+        for (;;) {
+            auto node = pointer(head);
+            if (!node) {
+                return nullptr;
+            }
+            // NB: 'node' might have been popped (and modified) by another thread in the
+            // meantime, but nodes are never freed while the queue is in use. In this case,
+            // the tag has changed and the CAS fails.
+            auto next = node->next_.load(std::memory_order_relaxed);
+            if (head_.compare_exchange_weak(head, pack(next, tag(head) + 1),
+                    std::memory_order_acquire, std::memory_order_acquire)) {
+                return node;
+            }
+        }
+    }
+ private:
+#if UINTPTR_MAX > 0xFFFFFFFF
+    static constexpr int tagShift = 48;
+    static constexpr uint64_t pointerMask = (uint64_t(1) << tagShift) - 1;
+#else
+    static constexpr int tagShift = 32;
+    static constexpr uint64_t pointerMask = 0xFFFFFFFF;
+#endif
+
+    static uint64_t pack(Node<T> *node, uint64_t tag) {
+        auto bits = (uint64_t)(uintptr_t)node;
+        assert((bits & ~pointerMask) == 0);
+        return bits | (tag << tagShift);
+    }
+
+    static Node<T> * pointer(uint64_t head) {
+        return (Node<T> *)(uintptr_t)(head & pointerMask);
+    }
+
+    static uint64_t tag(uint64_t head) {
+        return head >> tagShift;
+    }
+
+    std::atomic<uint64_t> head_{0};
+};
+
 // special MPSC queue implementation that can be safely created in a RT context.
 // the required dummy node is a class member and therefore doesn't have to be allocated
 // dynamically in the constructor. As a consequence, we need to be extra careful when
 // freeing the nodes in the destructor (we must not delete the dummy node!)
-// Multiple producers are synchronized with a simple spin lock.
-// NB: the free list *could* be atomic, but we would need to be extra careful to avoid
-// the ABA problem. (During a CAS loop the current node could be popped and pushed again,
-// so that the CAS would succeed even though the object has changed.)
+//
+// Producers push nodes with a single atomic exchange, see
+// http://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+// Popped nodes are recycled by the consumer through an (unbounded) lock-free free list,
+// so that producers only allocate if there are no free nodes (e.g. during bursts).
+// To avoid allocating in a RT context, use reserve().
 template<typename T, typename Alloc = std::allocator<T>>
 class UnboundedMPSCQueue : protected std::allocator_traits<Alloc>::template rebind_alloc<Node<T>> {
     typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Node<T>> Base;
  public:
     UnboundedMPSCQueue(const Alloc& alloc = Alloc {}) : Base(alloc) {
         // add dummy node
-        first_ = devider_ = last_ = &dummy_;
+        devider_ = &dummy_;
+        last_.store(&dummy_, std::memory_order_relaxed);
     }
 
     UnboundedMPSCQueue(const UnboundedMPSCQueue&) = delete;
@@ -93,21 +251,12 @@ class UnboundedMPSCQueue : protected std::allocator_traits<Alloc>::template rebi
         }
     }
 
-    // not thread-safe!
+    // make sure that there are at least 'n' nodes, so that up to 'n'
+    // items can be in flight without allocating; not thread-safe!
     void reserve(size_t n){
-        // check for existing empty nodes
-        auto it = first_;
-        auto end = devider_.load();
-        while (it != end){
-            n--;
-            it = it->next_;
-        }
-        // add empty nodes
-        while (n--){
-            auto node = Base::allocate(1);
-            new (node) Node<T>();
-            node->next_ = first_;
-            first_ = node;
+        auto count = numNodes_.load(std::memory_order_relaxed);
+        while (count++ < n){
+            freeList_.push(allocateNode());
         }
     }
 
@@ -117,98 +266,100 @@ class UnboundedMPSCQueue : protected std::allocator_traits<Alloc>::template rebi
 
     template<typename... TArgs>
     void emplace(TArgs&&... args){
-        Node<T>* node;
-        lock();
         // try to reuse existing node
-        if (first_ != devider_.load(std::memory_order_relaxed)) {
-            node = first_;
-            first_ = first_->next_;
-            node->next_ = nullptr; // !
-        } else {
-            // allocate new node
-            unlock();
-            node = Base::allocate(1);
-            new (node) Node<T>();
-            lock();
+        auto node = freeList_.pop();
+        if (!node) {
+            node = allocateNode();
         }
-        // NB: we could release the lock while calling the constructor,
-        // but in practice we only use this queue with PODs, so we rather
-        // avoid some unnecessary atomic instructions.
+        // NB: in practice we only use this queue with PODs
         node->data_ = T{std::forward<TArgs>(args)...};
+        node->next_.store(nullptr, std::memory_order_relaxed);
         // push node
-        auto last = last_.load(std::memory_order_relaxed);
-        last->next_ = node;
-        last_.store(node, std::memory_order_release); // publish
-        unlock();
+        auto prev = last_.exchange(node, std::memory_order_acq_rel);
+        prev->next_.store(node, std::memory_order_release); // publish
     }
 
     bool pop(T& result){
-        if (!empty()) {
-            // use node *after* devider, because devider is always a dummy!
-            auto next = devider_.load(std::memory_order_relaxed)->next_;
+        // use node *after* devider, because devider is always a dummy!
+        auto next = devider_->next_.load(std::memory_order_acquire);
+        if (next) {
             result = std::move(next->data_);
-            devider_.store(next, std::memory_order_release); // publish
+            // the old devider becomes free
+            freeList_.push(devider_);
+            devider_ = next;
             return true;
         } else {
+            // empty (or a producer is just about to link its node)
             return false;
         }
     }
 
     bool empty() const {
-        return devider_.load(std::memory_order_relaxed)
-                == last_.load(std::memory_order_relaxed);
+        return devider_->next_.load(std::memory_order_relaxed) == nullptr;
     }
 
     void clear(){
-        devider_.store(last_);
+        T dummy;
+        while (pop(dummy)) ;
     }
 
     // not thread-safe!
     template<typename Func>
     void forEach(Func&& fn) {
-        auto it = devider_.load(std::memory_order_relaxed)->next_;
+        auto it = devider_->next_.load(std::memory_order_acquire);
         while (it) {
             fn(it->data_);
-            it = it->next_;
+            it = it->next_.load(std::memory_order_acquire);
         }
     }
 
+    // not thread-safe!
     void release() {
         freeMemory();
-        first_ = devider_ = last_ = &dummy_;
-        dummy_.next_ = nullptr; // !
+        devider_ = &dummy_;
+        last_.store(&dummy_, std::memory_order_relaxed);
+        dummy_.next_.store(nullptr, std::memory_order_relaxed); // !
     }
 
     bool needRelease() const {
-        return first_ != last_.load(std::memory_order_relaxed);
+        return numNodes_.load(std::memory_order_relaxed) > 0;
     }
 
  private:
-    Node<T>* first_;
-    std::atomic<Node<T> *> devider_;
-    std::atomic<Node<T> *> last_;
-    std::atomic<int32_t> lock_{0};
+    Node<T> *devider_; // only accessed by the consumer
+    alignas(64) std::atomic<Node<T> *> last_;
+    std::atomic<size_t> numNodes_{0}; // number of allocated nodes
+    alignas(64) NodeStack<T> freeList_;
     Node<T> dummy_; // optimization
 
+    Node<T> * allocateNode() {
+        auto node = Base::allocate(1);
+        new (node) Node<T>();
+        numNodes_.fetch_add(1, std::memory_order_relaxed);
+        return node;
+    }
+
+    void freeNode(Node<T> *node) {
+        if (node != &dummy_) {
+            node->~Node<T>();
+            Base::deallocate(node, 1);
+        }
+    }
+
     void freeMemory() {
         // only frees memory, doesn't reset pointers!
-        auto it = first_;
+        // queued nodes (including the devider)
+        auto it = devider_;
         while (it){
-            auto next = it->next_;
-            if (it != &dummy_) {
-                it->~Node<T>();
-                Base::deallocate(it, 1);
-            }
+            auto next = it->next_.load(std::memory_order_relaxed);
+            freeNode(it);
             it = next;
         }
-    }
-
-    void lock() {
-        while (lock_.exchange(1, std::memory_order_acquire)) ;
-    }
-
-    void unlock() {
-        lock_.store(0, std::memory_order_release);
+        // free nodes (NB: the dummy node might be on the free list as well)
+        while (auto node = freeList_.pop()) {
+            freeNode(node);
+        }
+        numNodes_.store(0, std::memory_order_relaxed);
     }
 };
 
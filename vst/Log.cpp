@@ -0,0 +1,173 @@
+#include "Log.h"
+
+#include "Lockfree.h"
+#include "Sync.h"
+
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace vst {
+
+/*////////////////////// Log //////////////////////////*/
+
+void Log::write(std::string_view s) {
+    if (overflow_) {
+        overflow_->append(s);
+        return;
+    }
+    // always leave room for the trailing newline and null character
+    int avail = maxSize - 2 - size_;
+    if ((int)s.size() <= avail) {
+        memcpy(buffer_ + size_, s.data(), s.size());
+        size_ += s.size();
+    } else if (realtime_) {
+        // truncate
+        if (avail > 0) {
+            memcpy(buffer_ + size_, s.data(), avail);
+            size_ += avail;
+        }
+        memcpy(buffer_ + size_ - 3, "...", 3);
+    } else {
+        overflow_ = std::make_unique<std::string>(buffer_, size_);
+        overflow_->append(s);
+    }
+}
+
+void logMessageRT(int level, const char *msg, int size);
+
+Log::~Log() {
+    if (overflow_) {
+        overflow_->push_back('\n');
+        flushLog();
+        logMessage(level_, *overflow_);
+        return;
+    }
+    buffer_[size_++] = '\n';
+    buffer_[size_] = '\0';
+    if (realtime_) {
+        logMessageRT(level_, buffer_, size_ + 1);
+    } else {
+        // write pending realtime messages first to keep the order
+        flushLog();
+        logMessage(level_, buffer_);
+    }
+}
+
+/*////////////////////// RTLogger //////////////////////////*/
+
+static thread_local bool gLogThreadRealtime = false;
+
+void setLogThreadRealtime(bool rt) {
+    gLogThreadRealtime = rt;
+}
+
+bool isLogThreadRealtime() {
+    return gLogThreadRealtime;
+}
+
+namespace {
+
+// fixed-size log record, using the same framing as interprocess log messages.
+struct LogRecord {
+    LogMessage::Header header;
+    char data[Log::maxSize];
+};
+
+class RTLogger {
+ public:
+    // NB: intentionally leaked, so that the queue is still available
+    // during static destruction; the thread is started and stopped by
+    // LogThreadGuard.
+    static RTLogger& instance() {
+        static RTLogger *logger = new RTLogger();
+        return *logger;
+    }
+
+    void push(int level, const char *msg, int size) {
+        LogRecord record;
+        record.header.level = level;
+        record.header.size = size;
+        memcpy(record.data, msg, size);
+        if (!queue_.push(record)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        event_.set();
+    }
+
+    void flush() {
+        std::lock_guard lock(flushMutex_); // keep messages in order
+        LogRecord record;
+        while (queue_.pop(record)) {
+            logMessage(record.header.level, record.data);
+        }
+        auto dropped = dropped_.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%d realtime log message(s) dropped\n", dropped);
+            logMessage(1, buf);
+        }
+    }
+
+    void start() {
+        if (!started_.exchange(true)) {
+            running_.store(true);
+            thread_ = std::thread([this]() {
+                while (running_.load()) {
+                    event_.wait();
+                    flush();
+                }
+            });
+        }
+    }
+
+    void stop() {
+        if (started_.load() && thread_.joinable()) {
+        #ifdef _WIN32
+            // we can't join threads in a static object destructor
+            // of a Windows DLL because of the loader lock.
+            thread_.detach();
+        #else
+            running_.store(false);
+            event_.set();
+            thread_.join();
+        #endif
+        }
+    }
+ private:
+    LockfreeMPMCQueue<LogRecord, 256> queue_;
+    std::atomic<int> dropped_{0};
+    Event event_;
+    std::mutex flushMutex_;
+    std::thread thread_;
+    std::atomic<bool> started_{false};
+    std::atomic<bool> running_{false};
+};
+
+struct LogThreadGuard {
+    // Start the background thread eagerly during static initialization.
+    // It must not be started lazily by a realtime thread, and we can't wait
+    // for a non-realtime thread to log something because messages from
+    // realtime threads would pile up (and eventually get dropped) otherwise.
+    LogThreadGuard() {
+        RTLogger::instance().start();
+    }
+
+    ~LogThreadGuard() {
+        RTLogger::instance().stop();
+    }
+};
+
+LogThreadGuard gLogThreadGuard;
+
+} // namespace
+
+void logMessageRT(int level, const char *msg, int size) {
+    RTLogger::instance().push(level, msg, size);
+}
+
+void flushLog() {
+    RTLogger::instance().flush();
+}
+
+} // vst
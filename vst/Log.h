@@ -2,7 +2,14 @@
 
 #include "Interface.h"
 
+#include <algorithm>
+#include <charconv>
+#include <memory>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <stdio.h>
 
 // log level: 0 (error), 1 (warning), 2 (verbose), 3 (debug)
 #ifndef LOGLEVEL
@@ -15,21 +22,76 @@ void logMessage(int level, const char* msg);
 
 void logMessage(int level, std::string_view msg);
 
+// Realtime logging: on threads which have been marked as realtime (see also
+// setThreadPriority()), log messages are written to a lock-free queue and
+// flushed by a background thread, see Log.cpp.
+void setLogThreadRealtime(bool rt);
+
+bool isLogThreadRealtime();
+
+// write pending realtime log messages; NB: not realtime safe!
+void flushLog();
+
+// NB: Log does not allocate memory, unless a message on a non-realtime thread
+// exceeds the internal buffer or the argument type is not supported natively
+// (numbers, strings, pointers and enums are).
 class Log {
 public:
-    Log(int level = LOGLEVEL) : level_(level) {}
-    ~Log() {
-        stream_ << "\n";
-        logMessage(level_, stream_.str());
-    }
+    static const int maxSize = 248;
+
+    Log(int level = LOGLEVEL)
+        : level_(level), realtime_(isLogThreadRealtime()) {}
+    ~Log();
+
+    Log(const Log&) = delete;
+    Log& operator=(const Log&) = delete;
+
     template<typename T>
-    Log& operator<<(T&& t) {
-        stream_ << std::forward<T>(t);
+    Log& operator<<(const T& t) {
+        using U = std::decay_t<T>;
+        if constexpr (std::is_same_v<U, bool>) {
+            write(t ? "1" : "0");
+        } else if constexpr (std::is_same_v<U, char> || std::is_same_v<U, signed char>
+                || std::is_same_v<U, unsigned char>) {
+            char c = t;
+            write(std::string_view(&c, 1));
+        } else if constexpr (std::is_integral_v<U>) {
+            char buf[32];
+            auto result = std::to_chars(buf, buf + sizeof(buf), t);
+            write(std::string_view(buf, result.ptr - buf));
+        } else if constexpr (std::is_floating_point_v<U>) {
+            char buf[32];
+            int n = snprintf(buf, sizeof(buf), "%g", (double)t);
+            write(std::string_view(buf, std::min<int>(n, sizeof(buf) - 1)));
+        } else if constexpr (std::is_enum_v<U>) {
+            *this << static_cast<long long>(t);
+        } else if constexpr (std::is_array_v<T> && std::is_convertible_v<const T&, const char *>) {
+            // string literal or char array; can't be NULL
+            write(std::string_view(t));
+        } else if constexpr (std::is_same_v<U, const char *> || std::is_same_v<U, char *>) {
+            write(t ? std::string_view(t) : std::string_view("(null)"));
+        } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            write(std::string_view(t));
+        } else if constexpr (std::is_pointer_v<U>) {
+            char buf[32];
+            int n = snprintf(buf, sizeof(buf), "%p", (const void *)t);
+            write(std::string_view(buf, std::min<int>(n, sizeof(buf) - 1)));
+        } else {
+            // NB: not realtime safe!
+            std::ostringstream ss;
+            ss << t;
+            write(ss.str());
+        }
         return *this;
     }
 private:
-    std::ostringstream stream_;
+    void write(std::string_view s);
+
     int level_;
+    bool realtime_;
+    int size_ = 0;
+    char buffer_[maxSize];
+    std::unique_ptr<std::string> overflow_; // only on non-realtime threads
 };
 
 // for interprocess logging
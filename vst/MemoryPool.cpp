@@ -0,0 +1,375 @@
+#include "MemoryPool.h"
+
+#include "Log.h"
+#include "MiscUtils.h"
+#include "Sync.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+#ifdef _WIN32
+# ifndef NOMINMAX
+#  define NOMINMAX
+# endif
+# include <windows.h>
+#else
+# include <sys/mman.h>
+# include <unistd.h>
+# include <errno.h>
+#endif
+#ifdef __linux__
+# include <sys/syscall.h>
+#endif
+
+namespace vst {
+
+/*////////////////////// MemoryPool ///////////////////////*/
+
+MemoryPool::MemoryPool(const char *name, size_t blockSize, size_t numBlocks)
+    : name_(name), numBlocks_(numBlocks)
+{
+    assert(numBlocks > 0 && numBlocks < endOfList);
+    // keep blocks aligned to 8 bytes
+    blockSize_ = (blockSize + 7) & ~(size_t)7;
+    memory_ = std::make_unique<char[]>(blockSize_ * numBlocks_);
+    next_ = std::make_unique<std::atomic<uint32_t>[]>(numBlocks_);
+    // link all blocks
+    for (size_t i = 0; i < numBlocks_; ++i) {
+        auto next = (i + 1 < numBlocks_) ? (uint32_t)(i + 1) : endOfList;
+        next_[i].store(next, std::memory_order_relaxed);
+    }
+    head_.store(0, std::memory_order_release);
+}
+
+void * MemoryPool::allocate() {
+    auto head = head_.load(std::memory_order_acquire);
+    for (;;) {
+        auto index = (uint32_t)(head & 0xffffffff);
+        if (index == endOfList) {
+            exhausted_.fetch_add(1, std::memory_order_relaxed);
+            if (!warned_.test_and_set(std::memory_order_relaxed)) {
+                LOG_WARNING("memory pool '" << name_ << "' (" << blockSize_
+                            << " bytes) exhausted");
+            }
+            return nullptr;
+        }
+        // NB: the block might be taken by another thread in the meantime,
+        // so 'next' can be stale, but then the tag prevents the CAS from succeeding.
+        uint64_t next = next_[index].load(std::memory_order_relaxed);
+        uint64_t tag = (head >> 32) + 1;
+        if (head_.compare_exchange_weak(head, (tag << 32) | next,
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_acquire)) {
+            auto used = used_.fetch_add(1, std::memory_order_relaxed) + 1;
+            auto peak = peak_.load(std::memory_order_relaxed);
+            while (used > peak && !peak_.compare_exchange_weak(peak, used,
+                                                               std::memory_order_relaxed)) ;
+            return memory_.get() + index * blockSize_;
+        } // else: 'head' has been updated, retry
+    }
+}
+
+void MemoryPool::deallocate(void *ptr) {
+    assert(owns(ptr));
+    auto offset = static_cast<char *>(ptr) - memory_.get();
+    assert((offset % blockSize_) == 0);
+    auto index = (uint32_t)(offset / blockSize_);
+    auto head = head_.load(std::memory_order_relaxed);
+    for (;;) {
+        next_[index].store((uint32_t)(head & 0xffffffff), std::memory_order_relaxed);
+        uint64_t tag = (head >> 32) + 1;
+        if (head_.compare_exchange_weak(head, (tag << 32) | index,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+            break;
+        } // else: 'head' has been updated, retry
+    }
+    used_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+MemoryPool::Stats MemoryPool::stats() const {
+    Stats s;
+    s.name = name_;
+    s.blockSize = blockSize_;
+    s.numBlocks = numBlocks_;
+    s.used = used_.load(std::memory_order_relaxed);
+    s.peak = peak_.load(std::memory_order_relaxed);
+    s.exhausted = exhausted_.load(std::memory_order_relaxed);
+    return s;
+}
+
+/*////////////////////// Command payloads ///////////////////*/
+
+namespace {
+
+struct PayloadPools {
+    // Long parameter strings and program names. Strings of up to
+    // Command::maxShortStringSize characters are stored in the Command itself.
+    MemoryPool strings { "string", 256, 256 };
+    // SysEx messages are typically either very short or rather large (dumps).
+    MemoryPool sysexSmall { "sysex", 256, 64 };
+    MemoryPool sysexMedium { "sysex", 4096, 16 };
+    MemoryPool sysexLarge { "sysex", 65536, 2 };
+
+    MemoryPool * const stringPools[1] = { &strings };
+    MemoryPool * const sysexPools[3] = { &sysexSmall, &sysexMedium, &sysexLarge };
+    MemoryPool * const allPools[4] = { &strings, &sysexSmall, &sysexMedium, &sysexLarge };
+
+    std::atomic<uint64_t> heapAllocations{0};
+};
+
+// NB: the pools are intentionally leaked, so they outlive any plugin that
+// might be destroyed during static deinitialization.
+PayloadPools& payloadPools() {
+    static PayloadPools *pools = new PayloadPools();
+    return *pools;
+}
+
+// create the pools when the library is loaded, so that the first
+// allocation (possibly on a realtime thread) does not need to.
+struct PayloadPoolsInit {
+    PayloadPoolsInit() { payloadPools(); }
+} gPayloadPoolsInit;
+
+template<size_t N>
+char * allocateFromPools(MemoryPool * const (&pools)[N], size_t size) {
+    for (auto& pool : pools) {
+        if (size <= pool->blockSize()) {
+            // if the pool is exhausted, try the next larger one
+            if (auto data = pool->allocate()) {
+                return static_cast<char *>(data);
+            }
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+char * allocatePayload(PayloadType type, size_t size) {
+    auto& pools = payloadPools();
+    char *data;
+    if (type == PayloadType::String) {
+        data = allocateFromPools(pools.stringPools, size);
+    } else {
+        data = allocateFromPools(pools.sysexPools, size);
+    }
+    if (!data) {
+        // bummer, we need to allocate on the heap
+        pools.heapAllocations.fetch_add(1, std::memory_order_relaxed);
+        data = new char[size];
+    }
+    return data;
+}
+
+void freePayload(const char *data) {
+    if (!data) {
+        return;
+    }
+    for (auto& pool : payloadPools().allPools) {
+        if (pool->owns(data)) {
+            pool->deallocate(const_cast<char *>(data));
+            return;
+        }
+    }
+    delete[] data; // heap allocated
+}
+
+std::vector<MemoryPool::Stats> getPayloadPoolStats() {
+    std::vector<MemoryPool::Stats> result;
+    for (auto& pool : payloadPools().allPools) {
+        result.push_back(pool->stats());
+    }
+    return result;
+}
+
+uint64_t getPayloadHeapAllocations() {
+    return payloadPools().heapAllocations.load(std::memory_order_relaxed);
+}
+
+/*////////////////////// Locked memory ///////////////////*/
+
+static std::atomic<bool> gMemoryLocked{false};
+static std::atomic<bool> gHugePages{false};
+
+void setMemoryLocking(bool lock, bool hugePages) {
+    LOG_DEBUG("setMemoryLocking: " << lock << ", huge pages: " << hugePages);
+    gMemoryLocked.store(lock);
+    gHugePages.store(hugePages);
+}
+
+bool isMemoryLocked() {
+    return gMemoryLocked.load(std::memory_order_relaxed);
+}
+
+bool useHugePages() {
+    return gHugePages.load(std::memory_order_relaxed);
+}
+
+static size_t getPageSize() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    static size_t size = info.dwPageSize;
+#else
+    static size_t size = sysconf(_SC_PAGESIZE);
+#endif
+    return size;
+}
+
+// transparent huge pages are (usually) 2 MB
+static const size_t hugePageSize = 2 * 1024 * 1024;
+
+bool lockMemory(void *data, size_t size) {
+#ifdef _WIN32
+    // first we might have to increase the working set size
+    SIZE_T minSize, maxSize;
+    if (GetProcessWorkingSetSize(GetCurrentProcess(), &minSize, &maxSize)) {
+        if (!SetProcessWorkingSetSize(GetCurrentProcess(), minSize + size,
+                                      std::max<SIZE_T>(maxSize, minSize + size))) {
+            LOG_DEBUG("SetProcessWorkingSetSize() failed: "
+                      << errorMessage(GetLastError()));
+        }
+    }
+    if (!VirtualLock(data, size)) {
+        LOG_DEBUG("VirtualLock() failed: " << errorMessage(GetLastError()));
+        return false;
+    }
+#else
+    if (mlock(data, size) != 0) {
+        LOG_DEBUG("mlock() failed: " << errorMessage(errno));
+        return false;
+    }
+#endif
+    return true;
+}
+
+void adviseHugePages(void *data, size_t size) {
+#ifdef MADV_HUGEPAGE
+    if (madvise(data, size, MADV_HUGEPAGE) != 0) {
+        LOG_DEBUG("madvise() failed: " << errorMessage(errno));
+    }
+#endif
+}
+
+// set the preferred NUMA node of a memory region before it is paged in
+static void bindMemory(void *data, size_t size, int node) {
+#if defined(__linux__) && defined(SYS_mbind)
+    const int MPOL_PREFERRED = 1; // see <linux/mempolicy.h>
+    const size_t bits = sizeof(unsigned long) * 8;
+    std::vector<unsigned long> mask(node / bits + 1, 0);
+    mask[node / bits] |= 1UL << (node % bits);
+    if (syscall(SYS_mbind, data, size, MPOL_PREFERRED, mask.data(),
+                mask.size() * bits + 1, 0) != 0) {
+        LOG_DEBUG("mbind() failed: " << errorMessage(errno));
+    }
+#endif
+}
+
+/*////////////////////// DSPBuffer ///////////////////////*/
+
+// heap memory is allocated in cache lines, see DSPBuffer
+struct alignas(CACHELINE_SIZE) CacheLine : AlignedClass<CacheLine> {
+    char data[CACHELINE_SIZE];
+};
+
+DSPBuffer::~DSPBuffer() {
+    deallocate();
+}
+
+size_t DSPBuffer::padSize(size_t size) {
+    return (size + CACHELINE_SIZE - 1) & ~(CACHELINE_SIZE - 1);
+}
+
+void DSPBuffer::resize(size_t size, int numaNode) {
+    // also reallocate if the memory locking mode or NUMA node has changed
+    bool mapped = isMemoryLocked() || numaNode >= 0;
+    if (size > capacity_ || mapped_ != mapped || numaNode_ != numaNode) {
+        deallocate();
+        if (size > 0) {
+            allocate(size, numaNode);
+        }
+    }
+    size_ = size;
+    clear(); // this also prefaults the memory
+}
+
+void DSPBuffer::clear() {
+    if (data_) {
+        memset(data_, 0, size_);
+    }
+}
+
+void DSPBuffer::allocate(size_t size, int numaNode) {
+    // NB: also try to allocate pages for NUMA binding
+    bool lock = isMemoryLocked();
+    if (lock || numaNode >= 0) {
+        bool huge = useHugePages() && size >= hugePageSize;
+        auto align = huge ? hugePageSize : getPageSize();
+        auto capacity = (size + align - 1) & ~(align - 1);
+    #ifdef _WIN32
+        void *data;
+        if (numaNode >= 0) {
+            data = VirtualAllocExNuma(GetCurrentProcess(), NULL, capacity,
+                                      MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE, numaNode);
+        } else {
+            data = VirtualAlloc(NULL, capacity, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        }
+        if (!data) {
+            LOG_ERROR("VirtualAlloc() failed: " << errorMessage(GetLastError()));
+        }
+    #else
+        auto data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+            LOG_ERROR("mmap() failed: " << errorMessage(errno));
+            data = nullptr;
+        } else if (numaNode >= 0) {
+            bindMemory(data, capacity, numaNode);
+        }
+    #endif
+        if (data) {
+            if (huge) {
+                adviseHugePages(data, capacity);
+            }
+            if (lock && !lockMemory(data, capacity)) {
+                static std::atomic_flag warned = ATOMIC_FLAG_INIT;
+                if (!warned.test_and_set()) {
+                    LOG_WARNING("couldn't lock DSP buffer into memory");
+                }
+            }
+            data_ = (char *)data;
+            capacity_ = capacity;
+            numaNode_ = numaNode;
+            mapped_ = true;
+            return;
+        }
+        // fall back to the heap
+    }
+    auto n = padSize(size) / CACHELINE_SIZE;
+    data_ = reinterpret_cast<char *>(new CacheLine[n]);
+    capacity_ = n * CACHELINE_SIZE;
+    numaNode_ = numaNode;
+    mapped_ = false;
+}
+
+void DSPBuffer::deallocate() {
+    if (data_) {
+        if (mapped_) {
+        #ifdef _WIN32
+            VirtualFree(data_, 0, MEM_RELEASE);
+        #else
+            munmap(data_, capacity_);
+        #endif
+        } else {
+            delete[] reinterpret_cast<CacheLine *>(data_);
+        }
+        data_ = nullptr;
+        capacity_ = 0;
+        numaNode_ = -1;
+        mapped_ = false;
+    }
+}
+
+} // vst
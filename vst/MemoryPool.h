@@ -0,0 +1,138 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace vst {
+
+// Pool of fixed-size memory blocks with a lock-free free list.
+// All blocks are preallocated in the constructor, so allocate() and
+// deallocate() never touch the system allocator and can be safely
+// called from any thread, including realtime threads.
+//
+// The free list is a Treiber stack of block indices; the head contains
+// a tag which is incremented on every update to avoid the ABA problem.
+class MemoryPool {
+ public:
+    MemoryPool(const char *name, size_t blockSize, size_t numBlocks);
+
+    MemoryPool(const MemoryPool&) = delete;
+    MemoryPool& operator=(const MemoryPool&) = delete;
+
+    // returns nullptr if the pool is exhausted
+    void * allocate();
+    // NB: 'ptr' must belong to this pool, see owns()
+    void deallocate(void *ptr);
+
+    bool owns(const void *ptr) const {
+        auto p = static_cast<const char *>(ptr);
+        return p >= memory_.get() && p < (memory_.get() + blockSize_ * numBlocks_);
+    }
+
+    const char * name() const { return name_; }
+    size_t blockSize() const { return blockSize_; }
+    size_t numBlocks() const { return numBlocks_; }
+
+    struct Stats {
+        const char *name;
+        size_t blockSize;
+        size_t numBlocks;
+        size_t used; // blocks currently in use
+        size_t peak; // max. number of blocks in use
+        uint64_t exhausted; // failed allocations
+    };
+
+    Stats stats() const;
+ private:
+    static constexpr uint32_t endOfList = 0xffffffff;
+
+    const char *name_;
+    size_t blockSize_;
+    size_t numBlocks_;
+    std::unique_ptr<char[]> memory_;
+    std::unique_ptr<std::atomic<uint32_t>[]> next_;
+    // lower 32 bits: index of first free block; upper 32 bits: tag
+    std::atomic<uint64_t> head_;
+    std::atomic<size_t> used_{0};
+    std::atomic<size_t> peak_{0};
+    std::atomic<uint64_t> exhausted_{0};
+    std::atomic_flag warned_ = ATOMIC_FLAG_INIT;
+};
+
+/*////////////////////// Command payloads ///////////////////*/
+
+// Variable sized data of deferred plugin commands and events
+// (long parameter strings, program names and SysEx messages)
+// is allocated from process-wide memory pools, so that commands
+// can be created and disposed on realtime threads.
+// Each payload type has its own set of pools. If a payload doesn't
+// fit into any pool (oversized or exhausted), we fall back to the heap;
+// this is recorded in the pool statistics.
+enum class PayloadType {
+    String,
+    Sysex
+};
+
+char * allocatePayload(PayloadType type, size_t size);
+
+// NB: must only be used for memory returned by allocatePayload()
+void freePayload(const char *data);
+
+// NB: not realtime safe!
+std::vector<MemoryPool::Stats> getPayloadPoolStats();
+
+// number of payloads which had to be allocated on the heap
+uint64_t getPayloadHeapAllocations();
+
+/*////////////////////// Locked memory ///////////////////*/
+
+// see setMemoryLocking()
+bool isMemoryLocked();
+bool useHugePages();
+
+// Try to lock a memory region into physical memory; on Windows, this grows
+// the working set size if necessary. Returns false on failure.
+bool lockMemory(void *data, size_t size);
+// request transparent huge pages for a memory region (Linux only)
+void adviseHugePages(void *data, size_t size);
+
+// Zero-initialized buffer for DSP data. The buffer is always cache line aligned
+// and padded, so that it doesn't share cache lines with other data. With memory
+// locking (see setMemoryLocking()), the buffer is page aligned and locked into
+// physical memory; it is always prefaulted.
+// NB: resize() is not realtime safe!
+class DSPBuffer {
+ public:
+    DSPBuffer() = default;
+    ~DSPBuffer();
+
+    DSPBuffer(const DSPBuffer&) = delete;
+    DSPBuffer& operator=(const DSPBuffer&) = delete;
+
+    // resize and clear the buffer. 'numaNode' is the preferred NUMA node
+    // of the memory, typically the node of the processing thread (-1 = any).
+    void resize(size_t size, int numaNode = -1);
+    void clear();
+
+    // round up to a multiple of the cache line size, e.g. for channel strides,
+    // so that every channel starts on a cache line boundary.
+    static size_t padSize(size_t size);
+
+    char * data() { return data_; }
+    const char * data() const { return data_; }
+    size_t size() const { return size_; }
+ private:
+    void allocate(size_t size, int numaNode);
+    void deallocate();
+
+    char *data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+    int numaNode_ = -1;
+    bool mapped_ = false; // page aligned and (possibly) locked
+};
+
+} // vst
@@ -2,6 +2,7 @@
 #include "Log.h"
 #include "FileUtils.h"
 #include "CpuArch.h"
+#include "Kernels.h"
 
 #ifdef _WIN32
 # ifndef NOMINMAX
@@ -22,8 +23,17 @@
 #include <pthread.h>
 #endif
 
+#if VST_HOST_SYSTEM == VST_MACOS
+// thread affinity
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#include <sys/sysctl.h>
+#endif
+
+#include <algorithm>
 #include <mutex>
 #include <sstream>
+#include <stdio.h>
 
 namespace vst {
 
@@ -65,18 +75,16 @@ void doBypass(ProcessData &data){
                 auto out = output[j];
                 if (j < nin){
                     // copy input to output
-                    auto in = input[j];
-                    std::copy(in, in + data.numSamples, out);
+                    kernels::copy(out, input[j], data.numSamples);
                 } else {
                     // zero channel
-                    std::fill(out, out + data.numSamples, 0);
+                    kernels::clear(out, data.numSamples);
                 }
             }
         } else {
             // zero whole bus
             for (int j = 0; j < nout; ++j){
-                auto out = output[j];
-                std::fill(out, out + data.numSamples, 0);
+                kernels::clear(output[j], data.numSamples);
             }
         }
     }
@@ -92,6 +100,70 @@ void bypass(ProcessData &data){
 
 //-----------------------------------------------------------------//
 
+template<typename T>
+static bool isChannelSilent(const T *buf, int n){
+    return kernels::isSilent(buf, n, (T)SILENCE_THRESHOLD);
+}
+
+template<typename T>
+static uint64_t doGetSilenceFlags(const AudioBus& bus, int numSamples){
+    auto channels = (const T **)bus.channelData32;
+    auto n = std::min<int>(bus.numChannels, 64);
+    uint64_t flags = 0;
+    for (int i = 0; i < n; ++i){
+        if (isChannelSilent(channels[i], numSamples)){
+            flags |= (uint64_t)1 << i;
+        }
+    }
+    return flags;
+}
+
+uint64_t getSilenceFlags(const AudioBus& bus, int numSamples, ProcessPrecision precision){
+    if (precision == ProcessPrecision::Double){
+        return doGetSilenceFlags<double>(bus, numSamples);
+    } else {
+        return doGetSilenceFlags<float>(bus, numSamples);
+    }
+}
+
+template<typename T>
+static bool doIsSilent(const AudioBus& bus, int numSamples){
+    auto channels = (const T **)bus.channelData32;
+    for (int i = 0; i < bus.numChannels; ++i){
+        if (!isChannelSilent(channels[i], numSamples)){
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isSilent(const AudioBus& bus, int numSamples, ProcessPrecision precision){
+    if (precision == ProcessPrecision::Double){
+        return doIsSilent<double>(bus, numSamples);
+    } else {
+        return doIsSilent<float>(bus, numSamples);
+    }
+}
+
+void clearOutputs(ProcessData& data){
+    auto size = (data.precision == ProcessPrecision::Double) ? sizeof(double) : sizeof(float);
+    for (int i = 0; i < data.numOutputs; ++i){
+        auto& bus = data.outputs[i];
+        for (int j = 0; j < bus.numChannels; ++j){
+            // all zero bits is 0.0 for both float and double
+            memset(bus.channelData32[j], 0, data.numSamples * size);
+        }
+    }
+}
+
+#if !USE_BRIDGE
+void setBridgePoolSize(int size){}
+
+void setBridgeSpinCount(int count){}
+#endif
+
+//-----------------------------------------------------------------//
+
 #ifdef _WIN32
 std::wstring widen(std::string_view s){
     if (s.empty()){
@@ -134,6 +206,16 @@ std::string getTmpDirectory(){
 #endif
 }
 
+std::string getTransferDirectory(){
+#if defined(__linux__) && !defined(_WIN32)
+    static const bool haveShm = isDirectory("/dev/shm");
+    if (haveShm){
+        return "/dev/shm";
+    }
+#endif
+    return getTmpDirectory();
+}
+
 std::string errorMessage(int err){
     std::stringstream ss;
 #ifdef _WIN32
@@ -445,6 +527,8 @@ bool haveWine64(){
 //-------------------------------------------------------------//
 
 void setThreadPriority(Priority p){
+    // high priority threads must not block on logging
+    setLogThreadRealtime(p == Priority::High);
 #if VST_HOST_SYSTEM == VST_WINDOWS
     auto thread = GetCurrentThread();
     // set the thread priority
@@ -481,4 +565,139 @@ void setThreadPriority(Priority p){
 #endif
 }
 
+#if VST_HOST_SYSTEM == VST_LINUX
+static int readSysfsInt(const char *fmt, int cpu, int fallback) {
+    char path[256];
+    snprintf(path, sizeof(path), fmt, cpu);
+    int result = fallback;
+    auto f = fopen(path, "r");
+    if (f) {
+        if (fscanf(f, "%d", &result) != 1) {
+            result = fallback;
+        }
+        fclose(f);
+    }
+    return result;
+}
+#endif
+
+static std::vector<CpuInfo> doGetCpuTopology() {
+    std::vector<CpuInfo> result;
+#if VST_HOST_SYSTEM == VST_WINDOWS
+    DWORD size = 0;
+    GetLogicalProcessorInformation(nullptr, &size);
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(
+        size / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+    if (!info.empty() && GetLogicalProcessorInformation(info.data(), &size)) {
+        // NB: SetThreadAffinityMask() is limited to 64 CPUs (= one processor group)
+        const int maxCpus = sizeof(ULONG_PTR) * 8;
+        std::vector<int> nodes(maxCpus, 0);
+        for (auto& x : info) {
+            if (x.Relationship == RelationNumaNode) {
+                for (int i = 0; i < maxCpus; ++i) {
+                    if (x.ProcessorMask & ((ULONG_PTR)1 << i)) {
+                        nodes[i] = x.NumaNode.NodeNumber;
+                    }
+                }
+            }
+        }
+        int core = 0;
+        for (auto& x : info) {
+            if (x.Relationship == RelationProcessorCore) {
+                for (int i = 0; i < maxCpus; ++i) {
+                    if (x.ProcessorMask & ((ULONG_PTR)1 << i)) {
+                        result.push_back({ i, core, nodes[i] });
+                    }
+                }
+                core++;
+            }
+        }
+        std::sort(result.begin(), result.end(),
+                  [](auto& a, auto& b) { return a.index < b.index; });
+    }
+#elif VST_HOST_SYSTEM == VST_LINUX
+    int numCpus = sysconf(_SC_NPROCESSORS_CONF);
+    for (int i = 0; i < numCpus; ++i) {
+        // skip offline CPUs (cpu0 usually doesn't have an 'online' file)
+        if (!readSysfsInt("/sys/devices/system/cpu/cpu%d/online", i, 1)) {
+            continue;
+        }
+        // the core ID is only unique per package
+        int package = readSysfsInt(
+            "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", i, 0);
+        int core = readSysfsInt(
+            "/sys/devices/system/cpu/cpu%d/topology/core_id", i, i);
+        // find NUMA node
+        int node = 0;
+        for (int j = 0; j < 64; ++j) {
+            char path[256];
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", i, j);
+            if (pathExists(path)) {
+                node = j;
+                break;
+            }
+        }
+        result.push_back({ i, (package << 16) | core, node });
+    }
+#else
+    // macOS doesn't tell us about SMT siblings, so we assume one core per CPU.
+    int numCpus = 0;
+    size_t size = sizeof(numCpus);
+    if (sysctlbyname("hw.logicalcpu", &numCpus, &size, nullptr, 0) != 0) {
+        numCpus = 0;
+    }
+    for (int i = 0; i < numCpus; ++i) {
+        result.push_back({ i, i, 0 });
+    }
+#endif
+    return result;
+}
+
+const std::vector<CpuInfo>& getCpuTopology() {
+    static auto topology = doGetCpuTopology();
+    return topology;
+}
+
+bool setThreadAffinity(int cpu) {
+#if VST_HOST_SYSTEM == VST_WINDOWS
+    if (cpu < 0 || cpu >= (int)(sizeof(DWORD_PTR) * 8)) {
+        LOG_WARNING("couldn't set thread affinity: CPU " << cpu << " out of range");
+        return false;
+    }
+    if (!SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu)) {
+        LOG_WARNING("couldn't set thread affinity: " << errorMessage(GetLastError()));
+        return false;
+    }
+    return true;
+#elif VST_HOST_SYSTEM == VST_LINUX
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        LOG_WARNING("couldn't set thread affinity: CPU " << cpu << " out of range");
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    auto err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        LOG_WARNING("couldn't set thread affinity: " << errorMessage(err));
+        return false;
+    }
+    return true;
+#else
+    // threads with the same affinity tag are scheduled on the same L2 cache,
+    // so we just use a different tag for each CPU.
+    thread_affinity_policy_data_t policy = { cpu + 1 };
+    // NB: mach_thread_self() returns a new send right which we must release!
+    auto thread = mach_thread_self();
+    auto err = thread_policy_set(thread, THREAD_AFFINITY_POLICY,
+                                 (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT);
+    mach_port_deallocate(mach_task_self(), thread);
+    if (err != KERN_SUCCESS) {
+        LOG_WARNING("couldn't set thread affinity policy");
+        return false;
+    }
+    return true;
+#endif
+}
+
 } // vst
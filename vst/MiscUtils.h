@@ -126,6 +126,64 @@ T alignTo(T v, size_t alignment) {
     return (v + mask) & ~mask;
 }
 
+//------------------- silence detection -------------------------//
+
+// samples below this threshold count as silent; this is below
+// the resolution of 24-bit audio (ca. -140 dB)
+#define SILENCE_THRESHOLD 1e-7
+
+// assumed tail (in seconds) for plugins which don't report their tail size
+#define SILENCE_DEFAULT_TAIL 1.0
+
+// returns a bitset of silent channels, see Steinberg::Vst::AudioBusBuffers::silenceFlags.
+// NB: channels above 64 are never marked as silent.
+uint64_t getSilenceFlags(const AudioBus& bus, int numSamples, ProcessPrecision precision);
+
+inline uint64_t allChannelsSilent(int numChannels) {
+    return numChannels >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << numChannels) - 1;
+}
+
+// check if all channels are silent
+bool isSilent(const AudioBus& bus, int numSamples, ProcessPrecision precision);
+
+// zero all output channels
+void clearOutputs(ProcessData& data);
+
+// State for SilenceMode::Sleep: once the input (and event queue) has been
+// idle for longer than the plugin's tail and the output has become silent,
+// the plugin may stop processing until new input or events arrive.
+class SleepState {
+public:
+    // tail in samples; negative: infinite tail, i.e. never sleep.
+    void setTail(int tail) { tail_ = tail; }
+    // call before processing. Returns true if the plugin is sleeping
+    // and the processing method can be skipped.
+    bool check(bool idle) {
+        if (!idle) {
+            idleSamples_ = 0;
+            sleeping_ = false;
+        }
+        return sleeping_;
+    }
+    // call after processing an idle block. Returns true if the tail
+    // has passed; in this case the caller should check the output
+    // and call sleep() if it is silent.
+    bool advance(int numSamples) {
+        idleSamples_ += numSamples;
+        return tail_ >= 0 && idleSamples_ >= tail_;
+    }
+    void sleep() { sleeping_ = true; }
+    bool sleeping() const { return sleeping_; }
+    void reset() {
+        idleSamples_ = 0;
+        sleeping_ = false;
+    }
+private:
+    int64_t idleSamples_ = 0;
+    int tail_ = 0;
+    bool sleeping_ = false;
+};
+
 //------------------- string utilities --------------------------//
 
 #ifdef _WIN32
@@ -159,6 +217,11 @@ std::string errorMessage(int err);
 
 std::string getTmpDirectory();
 
+// directory for temporary files which are exchanged between processes,
+// e.g. large plugin data of bridged plugins. On Linux we prefer /dev/shm,
+// so the data is transferred through shared memory and never touches the disk.
+std::string getTransferDirectory();
+
 const std::string& getModuleDirectory();
 
 void * getModuleHandle();
@@ -187,4 +250,17 @@ enum class Priority {
 
 void setThreadPriority(Priority p);
 
+struct CpuInfo {
+    int index; // logical CPU index
+    int core; // physical core (SMT siblings share the same core)
+    int node; // NUMA node
+};
+
+// get the logical CPUs of this machine
+const std::vector<CpuInfo>& getCpuTopology();
+
+// pin the current thread to the given logical CPU.
+// NB: on macOS this is only a hint.
+bool setThreadAffinity(int cpu);
+
 } // vst
@@ -2,6 +2,8 @@
 
 #include "Log.h"
 #include "MiscUtils.h"
+#include "FileUtils.h"
+#include "Sync.h"
 
 #ifdef _WIN32
 # ifndef NOMINMAX
@@ -14,7 +16,9 @@
 # include <dlfcn.h>
 #endif
 
+#include <list>
 #include <sstream>
+#include <unordered_map>
 
 /*///////////// IModule //////////////*/
 
@@ -163,7 +167,7 @@ class ModuleSO : public IModule {
 #endif
 
 // exceptions can propogate from the Module's constructor!
-std::unique_ptr<IModule> IModule::load(const std::string& path){
+static std::unique_ptr<IModule> loadModule(const std::string& path){
 #if defined(_WIN32)
     return std::make_unique<ModuleWin32>(path);
 #elif defined __APPLE__
@@ -173,4 +177,133 @@ std::unique_ptr<IModule> IModule::load(const std::string& path){
 #endif
 }
 
+/*///////////// SharedModule //////////////*/
+
+// A module that is shared by several plugin factories. The module's init
+// function is only called once; the exit function is called when the module
+// is released, but only if any of the users has asked for it.
+class SharedModule : public IModule {
+ public:
+    SharedModule(std::unique_ptr<IModule> module)
+        : module_(std::move(module)) {}
+    ~SharedModule(){
+        if (initialized_ && wantExit_){
+            if (!module_->exit()){
+                LOG_ERROR("couldn't exit module");
+            }
+        }
+    }
+    bool init() override {
+        std::lock_guard lock(mutex_);
+        if (!initialized_){
+            initialized_ = module_->init();
+        }
+        return initialized_;
+    }
+    bool exit() override {
+        std::lock_guard lock(mutex_);
+        wantExit_ = true;
+        return true;
+    }
+    void * doGetFnPtr(const char *name) const override {
+        return module_->getFnPtr<void *>(name);
+    }
+ private:
+    std::unique_ptr<IModule> module_;
+    Mutex mutex_;
+    bool initialized_ = false;
+    bool wantExit_ = false;
+};
+
+/*///////////// ModuleCache //////////////*/
+
+class ModuleCache {
+ public:
+    static ModuleCache& instance(){
+        static ModuleCache cache;
+        return cache;
+    }
+
+    std::shared_ptr<IModule> load(const std::string& path);
+    void setSize(int size);
+ private:
+    static constexpr size_t defaultSize = 8;
+
+    void trim(std::list<std::shared_ptr<IModule>>& evicted);
+
+    std::mutex mutex_;
+    // all modules which are currently loaded
+    std::unordered_map<std::string, std::weak_ptr<IModule>> modules_;
+    // recently loaded modules, most recent first
+    std::list<std::pair<std::string, std::shared_ptr<IModule>>> recent_;
+    size_t size_ = defaultSize;
+};
+
+std::shared_ptr<IModule> ModuleCache::load(const std::string& path){
+    auto key = normalizePath(path);
+    std::list<std::shared_ptr<IModule>> evicted; // release outside the lock!
+    std::unique_lock lock(mutex_);
+    auto it = modules_.find(key);
+    if (it != modules_.end()){
+        if (auto module = it->second.lock()){
+            // move to front
+            for (auto it2 = recent_.begin(); it2 != recent_.end(); ++it2){
+                if (it2->first == key){
+                    recent_.splice(recent_.begin(), recent_, it2);
+                    break;
+                }
+            }
+            if (size_ > 0 && (recent_.empty() || recent_.front().first != key)){
+                recent_.emplace_front(key, module);
+                trim(evicted);
+            }
+            LOG_DEBUG("ModuleCache: reuse " << key);
+            return module;
+        }
+    }
+    // Load outside the lock, so we don't block other threads.
+    // NB: if another thread loads the same module concurrently,
+    // the OS will hand out the same library handle anyway.
+    lock.unlock();
+    std::shared_ptr<IModule> module = std::make_shared<SharedModule>(loadModule(path));
+    lock.lock();
+    modules_[key] = module;
+    if (size_ > 0){
+        recent_.emplace_front(key, module);
+    }
+    trim(evicted);
+    return module;
+}
+
+void ModuleCache::setSize(int size){
+    std::list<std::shared_ptr<IModule>> evicted; // release outside the lock!
+    std::lock_guard lock(mutex_);
+    size_ = size;
+    trim(evicted);
+}
+
+// must be called with mutex locked!
+void ModuleCache::trim(std::list<std::shared_ptr<IModule>>& evicted){
+    while (recent_.size() > size_){
+        evicted.push_back(std::move(recent_.back().second));
+        recent_.pop_back();
+    }
+    // remove stale entries
+    for (auto it = modules_.begin(); it != modules_.end();){
+        if (it->second.expired()){
+            it = modules_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void setModuleCacheSize(int size){
+    ModuleCache::instance().setSize(size);
+}
+
+std::shared_ptr<IModule> IModule::load(const std::string& path){
+    return ModuleCache::instance().load(path);
+}
+
 } // vst
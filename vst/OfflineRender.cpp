@@ -0,0 +1,443 @@
+#include "OfflineRender.h"
+
+#include "WavFile.h"
+#include "Log.h"
+#include "MiscUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace vst {
+
+namespace {
+
+template<typename T>
+void defer(const T& fn){
+    // call on UI thread and catch exceptions
+    Error err;
+    bool ok = UIThread::callSync([&](){
+        try {
+            fn();
+        } catch (const Error& e){
+            err = e;
+        } catch (const std::exception& e) {
+            err = Error(e.what());
+        }
+    });
+    if (ok){
+        if (err.code() != Error::NoError) {
+            throw err;
+        }
+    } else {
+        throw Error("UIThread::callSync() failed");
+    }
+}
+
+// reads non-interleaved frames from a WAV file or a RenderBuffer
+class RenderSource {
+ public:
+    RenderSource(const RenderJob& job) {
+        if (!job.inputFile.empty()) {
+            reader_ = std::make_unique<WavReader>(job.inputFile);
+            numChannels_ = reader_->numChannels();
+            sampleRate_ = reader_->sampleRate();
+            numFrames_ = reader_->numFrames();
+        } else if (job.input) {
+            buffer_ = job.input.get();
+            numChannels_ = buffer_->numChannels;
+            sampleRate_ = buffer_->sampleRate;
+            numFrames_ = buffer_->numFrames;
+        } else {
+            throw Error("missing input");
+        }
+        if (sampleRate_ <= 0) {
+            throw Error("bad input sample rate");
+        }
+    }
+
+    int numChannels() const { return numChannels_; }
+    double sampleRate() const { return sampleRate_; }
+    int64_t numFrames() const { return numFrames_; }
+
+    // read up to 'n' frames into (up to) 'count' channels; returns the number
+    // of frames read. NB: the caller has to zero the channels beforehand.
+    template<typename T>
+    int64_t read(T **channels, int count, int n) {
+        int64_t result;
+        count = std::min<int>(count, numChannels_);
+        if (reader_) {
+            interleaved_.resize(n * numChannels_);
+            result = reader_->read(interleaved_.data(), n);
+            for (int i = 0; i < count; ++i) {
+                auto src = interleaved_.data() + i;
+                for (int64_t j = 0; j < result; ++j) {
+                    channels[i][j] = src[j * numChannels_];
+                }
+            }
+        } else {
+            result = std::min<int64_t>(n, numFrames_ - position_);
+            for (int i = 0; i < count; ++i) {
+                auto src = buffer_->channel(i) + position_;
+                std::copy(src, src + result, channels[i]);
+            }
+        }
+        position_ += result;
+        return result;
+    }
+ private:
+    std::unique_ptr<WavReader> reader_;
+    const RenderBuffer *buffer_ = nullptr;
+    std::vector<float> interleaved_;
+    int numChannels_ = 0;
+    double sampleRate_ = 0;
+    int64_t numFrames_ = 0;
+    int64_t position_ = 0;
+};
+
+// streams non-interleaved frames to a WAV file or collects them in a RenderBuffer
+class RenderSink {
+ public:
+    RenderSink(const RenderJob& job, int numChannels,
+               double sampleRate, int64_t numFrames) {
+        if (!job.outputFile.empty()) {
+            writer_ = std::make_unique<WavWriter>(job.outputFile, numChannels, sampleRate);
+        } else {
+            buffer_ = std::make_unique<RenderBuffer>();
+            buffer_->numChannels = numChannels;
+            buffer_->numFrames = numFrames;
+            buffer_->sampleRate = sampleRate;
+            buffer_->data.resize(numChannels * numFrames);
+        }
+        numChannels_ = numChannels;
+    }
+
+    template<typename T>
+    void write(T * const *channels, int offset, int n) {
+        if (writer_) {
+            interleaved_.resize(n * numChannels_);
+            for (int i = 0; i < numChannels_; ++i) {
+                auto src = channels[i] + offset;
+                auto dst = interleaved_.data() + i;
+                for (int j = 0; j < n; ++j) {
+                    dst[j * numChannels_] = src[j];
+                }
+            }
+            writer_->write(interleaved_.data(), n);
+        } else {
+            for (int i = 0; i < numChannels_; ++i) {
+                auto src = channels[i] + offset;
+                std::copy(src, src + n, buffer_->channel(i) + position_);
+            }
+        }
+        position_ += n;
+    }
+
+    std::unique_ptr<RenderBuffer> close() {
+        if (writer_) {
+            writer_->close();
+        }
+        return std::move(buffer_);
+    }
+ private:
+    std::unique_ptr<WavWriter> writer_;
+    std::unique_ptr<RenderBuffer> buffer_;
+    std::vector<float> interleaved_;
+    int numChannels_ = 0;
+    int64_t position_ = 0;
+};
+
+// a plugin in the chain with its own input and output busses
+template<typename T>
+struct RenderStage {
+    IPlugin *plugin;
+    std::vector<int> inputChannels;
+    std::vector<int> outputChannels;
+    std::vector<AudioBus> inputs;
+    std::vector<AudioBus> outputs;
+    std::vector<T *> pointers;
+    std::vector<T> buffer;
+    size_t inputSize = 0;
+
+    void setup(IPlugin& p, int numChannels, int blockSize) {
+        plugin = &p;
+        auto& info = plugin->info();
+        // only use the main busses
+        inputChannels.assign(info.numInputs(), 0);
+        if (!inputChannels.empty()) {
+            inputChannels[0] = numChannels;
+        }
+        outputChannels.assign(info.numOutputs(), 0);
+        if (!outputChannels.empty()) {
+            outputChannels[0] = info.outputs()[0].numChannels;
+        }
+        if (outputChannels.empty() || outputChannels[0] <= 0) {
+            throw Error(Error::PluginError, info.name + ": no audio output");
+        }
+        // NB: returns the actual channel counts
+        plugin->setNumSpeakers(inputChannels.data(), inputChannels.size(),
+                               outputChannels.data(), outputChannels.size());
+
+        int total = 0;
+        for (auto& n : inputChannels) {
+            total += n;
+        }
+        inputSize = total * blockSize;
+        for (auto& n : outputChannels) {
+            total += n;
+        }
+        buffer.resize(total * blockSize);
+        pointers.resize(total);
+        for (int i = 0; i < total; ++i) {
+            pointers[i] = buffer.data() + i * blockSize;
+        }
+        auto setupBusses = [](auto& busses, auto& channels, auto& ptr) {
+            busses.resize(channels.size());
+            for (size_t i = 0; i < channels.size(); ++i) {
+                busses[i].numChannels = channels[i];
+                busses[i].channelData32 = (float **)ptr; // float** and double** have the same size
+                ptr += channels[i];
+            }
+        };
+        auto ptr = pointers.data();
+        setupBusses(inputs, inputChannels, ptr);
+        setupBusses(outputs, outputChannels, ptr);
+    }
+
+    T ** input() { return inputs.empty() ? nullptr : (T **)inputs[0].channelData32; }
+    int numInputChannels() const { return inputs.empty() ? 0 : inputs[0].numChannels; }
+    T ** output() { return (T **)outputs[0].channelData32; }
+    int numOutputChannels() const { return outputs[0].numChannels; }
+
+    void clearInputs() {
+        std::fill(buffer.begin(), buffer.begin() + inputSize, 0);
+    }
+
+    void process(int numSamples, ProcessPrecision precision) {
+        // some plugins don't write silent outputs
+        std::fill(buffer.begin() + inputSize, buffer.end(), 0);
+        ProcessData data;
+        data.inputs = inputs.data();
+        data.numInputs = inputs.size();
+        data.outputs = outputs.data();
+        data.numOutputs = outputs.size();
+        data.numSamples = numSamples;
+        data.precision = precision;
+        data.mode = ProcessMode::Offline;
+        plugin->process(data);
+    }
+};
+
+template<typename T>
+void doRender(const RenderJob& job, int blockSize, const std::atomic<bool> *cancel,
+              std::vector<IPlugin::ptr>& plugins, RenderResult& result) {
+    if (job.chain.empty()) {
+        throw Error("empty plugin chain");
+    }
+    RenderSource source(job);
+    auto sampleRate = source.sampleRate();
+
+    defer([&](){
+        for (auto& p : job.chain) {
+            if (!p.plugin) {
+                throw Error("missing plugin");
+            }
+            if (!p.plugin->hasPrecision(job.precision)) {
+                throw Error(Error::PluginError, p.plugin->name +
+                            ": process precision not supported");
+            }
+            auto plugin = p.plugin->create(false, false, job.runMode);
+            if (!p.preset.empty()) {
+                plugin->readProgramFile(p.preset);
+            }
+            for (auto& param : p.params) {
+                plugin->setParameter(param.first, param.second);
+            }
+            plugins.push_back(std::move(plugin));
+        }
+    });
+
+    std::vector<RenderStage<T>> stages(plugins.size());
+    int numChannels = source.numChannels();
+    int latency = 0;
+    for (size_t i = 0; i < plugins.size(); ++i) {
+        auto& plugin = *plugins[i];
+        stages[i].setup(plugin, numChannels, blockSize);
+        plugin.setupProcessing(sampleRate, blockSize, job.precision, ProcessMode::Offline);
+        plugin.resume();
+        latency += plugin.getLatencySamples();
+        numChannels = stages[i].numOutputChannels();
+    }
+    result.latency = latency;
+
+    int64_t total = source.numFrames() + (int64_t)(job.tail * sampleRate);
+    int64_t skip = job.compensateLatency ? latency : 0;
+    int64_t written = 0;
+
+    RenderSink sink(job, numChannels, sampleRate, total);
+
+    LOG_DEBUG("OfflineRenderer: render " << total << " frames with "
+              << plugins.size() << " plugin(s), latency " << latency);
+
+    while (written < total) {
+        if (cancel && cancel->load(std::memory_order_relaxed)) {
+            throw Error("cancelled");
+        }
+        // after the end of the input, we just feed zeros.
+        auto& first = stages.front();
+        first.clearInputs();
+        source.read(first.input(), first.numInputChannels(), blockSize);
+        for (size_t i = 0; i < stages.size(); ++i) {
+            auto& stage = stages[i];
+            if (i > 0) {
+                stage.clearInputs();
+                // copy main output of the previous stage to main input of this stage
+                auto& prev = stages[i - 1];
+                int n = std::min(prev.numOutputChannels(), stage.numInputChannels());
+                for (int j = 0; j < n; ++j) {
+                    std::copy(prev.output()[j], prev.output()[j] + blockSize,
+                              stage.input()[j]);
+                }
+            }
+            stage.process(blockSize, job.precision);
+        }
+        // skip latency
+        int offset = std::min<int64_t>(skip, blockSize);
+        skip -= offset;
+        int n = std::min<int64_t>(blockSize - offset, total - written);
+        sink.write(stages.back().output(), offset, n);
+        written += n;
+    }
+
+    for (auto& plugin : plugins) {
+        plugin->suspend();
+    }
+
+    result.output = sink.close();
+    result.numFrames = written;
+}
+
+} // namespace
+
+/*//////////////////// OfflineRenderer ///////////////////*/
+
+OfflineRenderer::OfflineRenderer(int numThreads, int blockSize)
+    : blockSize_(blockSize > 0 ? blockSize : defaultBlockSize)
+{
+    if (numThreads <= 0) {
+        numThreads = std::max<int>(std::thread::hardware_concurrency(), 1);
+    }
+    LOG_DEBUG("OfflineRenderer: start " << numThreads << " threads");
+    for (int i = 0; i < numThreads; ++i) {
+        threads_.emplace_back(&OfflineRenderer::run, this);
+    }
+}
+
+OfflineRenderer::~OfflineRenderer() {
+    cancel();
+    {
+        std::lock_guard lock(mutex_);
+        quit_ = true;
+    }
+    condition_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+    LOG_DEBUG("OfflineRenderer: stopped");
+}
+
+int OfflineRenderer::push(RenderJob job, Callback callback) {
+    int id;
+    {
+        std::lock_guard lock(mutex_);
+        id = nextID_++;
+        tasks_.push_back(Task { id, std::move(job), std::move(callback) });
+    }
+    condition_.notify_one();
+    return id;
+}
+
+void OfflineRenderer::cancel() {
+    std::unique_lock lock(mutex_);
+    auto pending = std::move(tasks_);
+    tasks_.clear();
+    cancel_.store(true);
+    // wait for running jobs
+    finished_.wait(lock, [&]() { return numRunning_ == 0; });
+    cancel_.store(false);
+    lock.unlock();
+
+    for (auto& task : pending) {
+        if (task.callback) {
+            RenderResult result;
+            result.error = Error("cancelled");
+            task.callback(task.id, result);
+        }
+    }
+}
+
+void OfflineRenderer::wait() {
+    std::unique_lock lock(mutex_);
+    finished_.wait(lock, [&]() { return tasks_.empty() && numRunning_ == 0; });
+}
+
+void OfflineRenderer::run() {
+    setThreadPriority(Priority::Low);
+
+    std::unique_lock lock(mutex_);
+    for (;;) {
+        condition_.wait(lock, [&]() { return quit_ || !tasks_.empty(); });
+        if (quit_) {
+            break;
+        }
+        auto task = std::move(tasks_.front());
+        tasks_.pop_front();
+        numRunning_++;
+        lock.unlock();
+
+        LOG_DEBUG("OfflineRenderer: start job " << task.id);
+        auto result = render(task.job, blockSize_, &cancel_);
+        if (result.ok()) {
+            LOG_DEBUG("OfflineRenderer: job " << task.id << " finished ("
+                      << result.numFrames << " frames in " << result.elapsed << " s)");
+        } else {
+            LOG_ERROR("OfflineRenderer: job " << task.id << " failed: "
+                      << result.error.what());
+        }
+        if (task.callback) {
+            task.callback(task.id, result);
+        }
+
+        lock.lock();
+        numRunning_--;
+        finished_.notify_all();
+    }
+}
+
+RenderResult OfflineRenderer::render(const RenderJob& job, int blockSize,
+                                     const std::atomic<bool> *cancel) {
+    RenderResult result;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<IPlugin::ptr> plugins;
+    try {
+        if (job.precision == ProcessPrecision::Double) {
+            doRender<double>(job, blockSize, cancel, plugins, result);
+        } else {
+            doRender<float>(job, blockSize, cancel, plugins, result);
+        }
+    } catch (const Error& e) {
+        result.error = e;
+    } catch (const std::exception& e) {
+        result.error = Error(e.what());
+    }
+    // release plugins on the UI thread
+    if (!plugins.empty()) {
+        UIThread::callSync([&]() { plugins.clear(); });
+        plugins.clear(); // in case callSync() failed
+    }
+    auto end = std::chrono::steady_clock::now();
+    result.elapsed = std::chrono::duration<double>(end - start).count();
+    return result;
+}
+
+} // vst
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Interface.h"
+#include "PluginDesc.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace vst {
+
+// Faster-than-realtime offline rendering.
+//
+// A RenderJob runs an audio file or buffer through a chain of plugins as fast
+// as possible (ProcessMode::Offline, large blocks) and streams the result to a
+// WAV file or collects it in a buffer. The OfflineRenderer runs independent jobs
+// in parallel on its own worker threads, so batch jobs (stems, loudness
+// normalization, etc.) can use all CPU cores. Every job creates its own plugin
+// instances; with RunMode::Bridge or RunMode::Sandbox they live in subprocesses.
+//
+// NB: we deliberately don't use the DSPThreadPool because render jobs would
+// block the realtime DSP threads for seconds or minutes.
+//
+// Plugins are created and destroyed on the UI thread, so the UI event loop
+// must be running, see UIThread.
+
+// non-interleaved audio data
+struct RenderBuffer {
+    int numChannels = 0;
+    int64_t numFrames = 0;
+    double sampleRate = 0;
+    std::vector<float> data; // numChannels * numFrames
+
+    float * channel(int index) { return data.data() + index * numFrames; }
+    const float * channel(int index) const { return data.data() + index * numFrames; }
+};
+
+struct RenderPlugin {
+    PluginDesc::const_ptr plugin;
+    std::string preset; // optional program file (.fxp or .vstpreset)
+    std::vector<std::pair<int, float>> params; // applied after the preset
+};
+
+struct RenderJob {
+    std::vector<RenderPlugin> chain;
+    // input: either a WAV file or a buffer
+    std::string inputFile;
+    std::shared_ptr<const RenderBuffer> input;
+    // output: WAV file (32-bit float); if empty, see RenderResult::output
+    std::string outputFile;
+    // additional time in seconds after the end of the input, e.g. for reverb tails
+    double tail = 0;
+    // remove the total latency of the plugin chain from the output
+    bool compensateLatency = true;
+    RunMode runMode = RunMode::Auto;
+    ProcessPrecision precision = ProcessPrecision::Single;
+};
+
+struct RenderResult {
+    Error error;
+    int64_t numFrames = 0; // number of output frames
+    int latency = 0; // total latency of the plugin chain
+    double elapsed = 0; // wall clock time in seconds
+    std::unique_ptr<RenderBuffer> output; // only if RenderJob::outputFile is empty
+
+    bool ok() const { return error.code() == Error::NoError; }
+};
+
+class OfflineRenderer {
+ public:
+    static const int defaultBlockSize = 4096;
+
+    // 'numThreads': number of worker threads (0 = number of logical CPUs)
+    OfflineRenderer(int numThreads = 0, int blockSize = defaultBlockSize);
+    // cancels all jobs and waits for the worker threads
+    ~OfflineRenderer();
+
+    OfflineRenderer(const OfflineRenderer&) = delete;
+    OfflineRenderer& operator=(const OfflineRenderer&) = delete;
+
+    using Callback = std::function<void(int id, RenderResult& result)>;
+
+    // Queue a job and return its ID. The callback is called on a worker thread
+    // when the job has finished or failed, or in cancel() for pending jobs.
+    int push(RenderJob job, Callback callback);
+    // cancel all pending and running jobs
+    void cancel();
+    // wait until all jobs have finished
+    void wait();
+
+    int numThreads() const { return threads_.size(); }
+    int blockSize() const { return blockSize_; }
+
+    // render a single job on the calling thread. 'cancel' (optional) is polled
+    // between blocks. Errors are returned in RenderResult::error.
+    static RenderResult render(const RenderJob& job, int blockSize = defaultBlockSize,
+                               const std::atomic<bool> *cancel = nullptr);
+ private:
+    struct Task {
+        int id;
+        RenderJob job;
+        Callback callback;
+    };
+
+    void run();
+
+    std::vector<std::thread> threads_;
+    int blockSize_;
+    std::deque<Task> tasks_;
+    int nextID_ = 0;
+    int numRunning_ = 0;
+    bool quit_ = false;
+    std::atomic<bool> cancel_{false};
+    std::mutex mutex_;
+    std::condition_variable condition_; // new tasks
+    std::condition_variable finished_; // finished tasks
+};
+
+} // vst
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "PluginCommand.h"
+
+#include <cstring>
+#include <cassert>
+
+namespace vst {
+
+// Compact encoding for high-frequency RT commands and replies, i.e. parameter
+// changes, MIDI events and parameter replies, see Command::PackedEvents.
+//
+// A PackedEvents message consists of the usual ShmCommand header, followed by
+// the 'packed' header (version, kind, count) and 'count' events of the same kind.
+// Integers are encoded as LEB128 varints; floats are copied as is because both
+// sides always run on the same machine. The version must match exactly.
+//
+// ParamValue: varint index | varint offset | float value
+// Midi:       varint (delta << 1 | hasDetune) | status | data1 | data2 [| float detune]
+// ParamState: varint (index << 1 | automated) | float value | uint8 size | chars
+//
+// Compared to individual messages, this saves the message header,
+// the command header and the 8 byte alignment for every event.
+
+struct PackedEvents {
+    static const uint8_t version = 1;
+
+    enum Kind : uint8_t {
+        ParamValue,
+        Midi,
+        ParamState
+    };
+
+    // max. size of a single PackedEvents message
+    static const size_t maxMessageSize = 4096;
+    // max. size of a single encoded event (ParamState with a full display string)
+    static const size_t maxEventSize = 5 + 4 + 1 + 255;
+};
+
+class PackedEventWriter {
+ public:
+    PackedEventWriter() {
+        reset(PackedEvents::ParamValue);
+    }
+
+    void reset(PackedEvents::Kind kind) {
+        auto cmd = new (buffer_) ShmCommand(Command::PackedEvents);
+        cmd->packed.version = PackedEvents::version;
+        cmd->packed.kind = kind;
+        cmd->packed.count = 0;
+        size_ = dataOffset;
+    }
+
+    PackedEvents::Kind kind() const {
+        return (PackedEvents::Kind)header().packed.kind;
+    }
+
+    int count() const { return header().packed.count; }
+
+    bool empty() const { return count() == 0; }
+
+    // returns false if the message is full
+    bool full() const {
+        return (size_ + PackedEvents::maxEventSize) > PackedEvents::maxMessageSize
+            || count() == UINT16_MAX;
+    }
+
+    // the complete ShmCommand message
+    const ShmCommand * data() const { return &header(); }
+
+    size_t size() const { return size_; }
+
+    void addParamValue(int index, float value, int offset) {
+        assert(kind() == PackedEvents::ParamValue && !full());
+        writeVarint(index);
+        writeVarint(offset);
+        writeFloat(value);
+        header().packed.count++;
+    }
+
+    void addMidi(const MidiEvent& event) {
+        assert(kind() == PackedEvents::Midi && !full());
+        bool hasDetune = event.detune != 0;
+        writeVarint(((uint32_t)event.delta << 1) | hasDetune);
+        write(event.data, 3);
+        if (hasDetune) {
+            writeFloat(event.detune);
+        }
+        header().packed.count++;
+    }
+
+    void addParamState(int index, float value, const char *display,
+                       size_t size, bool automated) {
+        assert(kind() == PackedEvents::ParamState && !full());
+        if (size > 255) {
+            size = 255;
+        }
+        writeVarint(((uint32_t)index << 1) | automated);
+        writeFloat(value);
+        uint8_t len = size;
+        write(&len, 1);
+        write(display, size);
+        header().packed.count++;
+    }
+ private:
+    static constexpr size_t dataOffset = offsetof(ShmCommand, packed.data);
+
+    ShmCommand& header() { return *reinterpret_cast<ShmCommand *>(buffer_); }
+    const ShmCommand& header() const { return *reinterpret_cast<const ShmCommand *>(buffer_); }
+
+    void write(const void *data, size_t size) {
+        memcpy(buffer_ + size_, data, size);
+        size_ += size;
+    }
+
+    void writeFloat(float f) {
+        write(&f, sizeof(f));
+    }
+
+    void writeVarint(uint32_t value) {
+        while (value >= 0x80) {
+            buffer_[size_++] = (char)((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        buffer_[size_++] = (char)value;
+    }
+
+    alignas(8) char buffer_[PackedEvents::maxMessageSize];
+    size_t size_ = 0;
+};
+
+class PackedEventReader {
+ public:
+    // NB: the caller must check the version!
+    PackedEventReader(const ShmCommand& cmd)
+        : pos_((const uint8_t *)cmd.packed.data), count_(cmd.packed.count) {}
+
+    bool next() {
+        return count_-- > 0;
+    }
+
+    void readParamValue(int& index, float& value, int& offset) {
+        index = readVarint();
+        offset = readVarint();
+        value = readFloat();
+    }
+
+    MidiEvent readMidi() {
+        auto x = readVarint();
+        MidiEvent event(pos_[0], pos_[1], pos_[2], x >> 1);
+        pos_ += 3;
+        if (x & 1) {
+            event.detune = readFloat();
+        }
+        return event;
+    }
+
+    // 'display' is a pascal string!
+    void readParamState(int& index, float& value,
+                        const uint8_t *& display, bool& automated) {
+        auto x = readVarint();
+        index = x >> 1;
+        automated = x & 1;
+        value = readFloat();
+        display = pos_;
+        pos_ += pos_[0] + 1;
+    }
+ private:
+    float readFloat() {
+        float f;
+        memcpy(&f, pos_, sizeof(f));
+        pos_ += sizeof(f);
+        return f;
+    }
+
+    uint32_t readVarint() {
+        uint32_t value = 0;
+        int shift = 0;
+        uint8_t byte;
+        do {
+            byte = *pos_++;
+            value |= (uint32_t)(byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        return value;
+    }
+
+    const uint8_t *pos_;
+    int count_;
+};
+
+} // vst
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Sync.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+
+namespace vst {
+
+// Lock-free cache of (normalized) parameter values.
+//
+// The cache is updated by the thread(s) which actually change the plugin
+// state and can be read from any thread (UI, OSC replies, editor) without
+// locks or IPC. Every change stamps the parameter with a new version number,
+// so readers can cheaply find all parameters which have changed since
+// a given version, see changedSince().
+//
+// NB: an entry only takes 8 bytes, so a cache line holds 8 parameters.
+class ParamCache {
+ public:
+    ParamCache() = default;
+
+    ParamCache(const ParamCache&) = delete;
+    ParamCache& operator=(const ParamCache&) = delete;
+
+    // NB: neither realtime safe nor thread safe!
+    void resize(int numParams) {
+        entries_.reset(numParams > 0 ? new Entry[numParams] : nullptr);
+        size_ = numParams;
+        version_.store(0, std::memory_order_relaxed);
+    }
+
+    int size() const { return size_; }
+
+    float get(int index) const {
+        return entries_[index].value.load(std::memory_order_relaxed);
+    }
+
+    // NB: only bumps the version if the value has actually changed.
+    void set(int index, float value) {
+        auto& entry = entries_[index];
+        if (entry.value.load(std::memory_order_relaxed) != value) {
+            auto version = version_.fetch_add(1, std::memory_order_relaxed) + 1;
+            entry.value.store(value, std::memory_order_relaxed);
+            entry.version.store(version, std::memory_order_release);
+        }
+    }
+
+    // the current version; pass it to changedSince() later.
+    uint32_t version() const {
+        return version_.load(std::memory_order_acquire);
+    }
+
+    // call fn(index, value) for every parameter which has changed after the
+    // given version and return the current version. A change which happens
+    // concurrently might be reported again on the next call.
+    // NB: version numbers wrap around, but this is only a problem if there
+    // are more than 2^31 changes between two calls.
+    template<typename Fn>
+    uint32_t changedSince(uint32_t since, Fn&& fn) const {
+        auto current = version();
+        if (current != since) {
+            for (int i = 0; i < size_; ++i) {
+                auto& entry = entries_[i];
+                auto version = entry.version.load(std::memory_order_acquire);
+                if ((int32_t)(version - since) > 0) {
+                    fn(i, entry.value.load(std::memory_order_relaxed));
+                }
+            }
+        }
+        return current;
+    }
+ private:
+    struct Entry {
+        std::atomic<float> value{0};
+        std::atomic<uint32_t> version{0};
+    };
+    std::unique_ptr<Entry[]> entries_;
+    int size_ = 0;
+    // on a separate cache line, because it is written on every change
+    alignas(CACHELINE_SIZE) std::atomic<uint32_t> version_{0};
+};
+
+} // vst
@@ -4,9 +4,17 @@
 #include "Log.h"
 #include "CpuArch.h"
 #include "MiscUtils.h"
+#include "MemoryPool.h"
 
+#include <algorithm>
 #include <cassert>
 
+#if defined(__APPLE__)
+# include <sys/event.h>
+#elif defined(__linux__)
+# include <sys/syscall.h>
+#endif
+
 namespace vst {
 
 /*///////////////////// Channel /////////////////////*/
@@ -28,6 +36,13 @@ static std::mutex gPluginBridgeMutex;
 // use std::weak_ptr, so the bridge is automatically closed if it is not used
 static std::unordered_map<CpuArch, std::weak_ptr<PluginBridge>> gPluginBridgeMap;
 
+// see setBridgeSpinCount()
+static std::atomic<uint32_t> gBridgeSpinCount{0};
+
+void setBridgeSpinCount(int count){
+    gBridgeSpinCount.store(count > 0 ? count : 0, std::memory_order_relaxed);
+}
+
 PluginBridge::ptr PluginBridge::getShared(CpuArch arch){
     PluginBridge::ptr bridge;
 
@@ -53,8 +68,15 @@ PluginBridge::ptr PluginBridge::getShared(CpuArch arch){
     return bridge;
 }
 
-PluginBridge::ptr PluginBridge::create(CpuArch arch){
-    auto bridge = std::make_shared<PluginBridge>(arch, false);
+PluginBridge::ptr PluginBridge::create(CpuArch arch, bool pipelined){
+    // first try to get a pre-spawned sandbox
+    auto bridge = BridgePool::instance().take(arch, pipelined);
+    if (bridge){
+        LOG_DEBUG("PluginBridge: got sandbox from pool");
+        return bridge;
+    }
+
+    bridge = std::make_shared<PluginBridge>(arch, false, pipelined);
 
     WatchDog::instance().registerProcess(bridge);
 
@@ -62,9 +84,30 @@ PluginBridge::ptr PluginBridge::create(CpuArch arch){
 }
 
 int getNumDSPThreads();
+int getCurrentDSPThreadIndex();
+
+static std::atomic<int> gBridgeRTChannels{0};
+
+void setBridgeRTChannels(int numChannels){
+    LOG_DEBUG("setBridgeRTChannels: " << numChannels);
+    gBridgeRTChannels.store(std::max<int>(numChannels, 0));
+}
 
-PluginBridge::PluginBridge(CpuArch arch, bool shared)
-    : shared_(shared)
+BridgeLockStats getBridgeLockStats(bool reset){
+    BridgeLockStats result { 0, 0 };
+    std::lock_guard lock(gPluginBridgeMutex);
+    for (auto& [_, weak] : gPluginBridgeMap) {
+        if (auto bridge = weak.lock()) {
+            auto stats = bridge->lockStats(reset);
+            result.acquired += stats.acquired;
+            result.contended += stats.contended;
+        }
+    }
+    return result;
+}
+
+PluginBridge::PluginBridge(CpuArch arch, bool shared, bool pipelined)
+    : shared_(shared), pipelined_(!shared && pipelined)
 {
     LOG_DEBUG("PluginBridge: created shared memory interface");
     // setup shared memory interface
@@ -83,22 +126,43 @@ PluginBridge::PluginBridge(CpuArch arch, bool shared)
         // NB: getNumDSPThreads() defaults to the number of logical CPUs,
         // unless explicitly overriden by the user (which implies that they
         // really want to use *our* multithreading implemention).
-        numThreads_ = getNumDSPThreads();
+        // The number of channels can also be set explicitly with
+        // setBridgeRTChannels(), e.g. for hosts with many audio threads.
+        numThreads_ = gBridgeRTChannels.load();
+        if (numThreads_ <= 0) {
+            numThreads_ = getNumDSPThreads();
+        }
         LOG_DEBUG("PluginBridge: using " << numThreads_ << " RT threads");
         shm_.addChannel(ShmChannel::Request, nrtRequestSize, "nrt");
         for (int i = 0; i < numThreads_; ++i){
             char buf[16];
             snprintf(buf, sizeof(buf), "rt%d", i+1);
-            shm_.addChannel(ShmChannel::Request, rtRequestSize, buf);
+            shm_.addChannel(ShmChannel::Request, rtRequestSize, buf, rtAudioSize);
         }
 
-        locks_ = std::make_unique<PaddedSpinLock[]>(numThreads_);
+        locks_ = std::make_unique<RTSlot[]>(numThreads_);
+    } else if (pipelined_) {
+        // --- pipelined sandboxed plugin ---
+        // The RT channel must be separate because a process request
+        // can still be pending when we make NRT requests.
+        shm_.addChannel(ShmChannel::Request, nrtRequestSize, "nrt");
+        shm_.addChannel(ShmChannel::Request, rtRequestSize, "rt", rtAudioSize);
     } else {
         // --- sandboxed plugin ---
         // a single rt channel which also doubles as the nrt channel
-        shm_.addChannel(ShmChannel::Request, rtRequestSize, "rt");
+        shm_.addChannel(ShmChannel::Request, rtRequestSize, "rt", rtAudioSize);
+    }
+    // forward memory locking mode to the subprocess
+    uint8_t flags = 0;
+    if (isMemoryLocked()){
+        flags |= ShmInterface::LockMemory;
+        if (useHugePages()){
+            flags |= ShmInterface::HugePages;
+        }
     }
-    shm_.create();
+    shm_.create(gBridgeSpinCount.load(std::memory_order_relaxed), flags);
+    // all RT channels have the same audio bus size
+    audioCapacity_.store(shm_.getChannel(shm_.numChannels() - 1).audioCapacity());
 
     LOG_DEBUG("PluginBridge: created channels");
 
@@ -150,16 +214,26 @@ PluginBridge::PluginBridge(CpuArch arch, bool shared)
     LOG_DEBUG("PluginBridge: spawned subprocess (child: " << process_.pid()
               << ", parent: " << getCurrentProcessId() << ")");
 
+    // the poll function is event-driven, see runUIWakeThread()
     pollFunction_ = UIThread::addPollFunction([](void *x){
         static_cast<PluginBridge *>(x)->pollUIThread();
-    }, this);
+    }, this, true);
     LOG_DEBUG("PluginBridge: added poll function");
+
+    uiWakeRunning_ = true;
+    uiWakeThread_ = std::thread(&PluginBridge::runUIWakeThread, this);
 }
 
 PluginBridge::~PluginBridge(){
     LOG_DEBUG("PluginBridge: remove poll function");
     UIThread::removePollFunction(pollFunction_);
 
+    if (uiWakeThread_.joinable()) {
+        uiWakeRunning_ = false;
+        shm_.getChannel(Channel::UIReceive).post();
+        uiWakeThread_.join();
+    }
+
     // send quit message
     if (alive()){
         LOG_DEBUG("PluginBridge: send quit message");
@@ -375,15 +449,29 @@ void PluginBridge::removeUIClient(uint32_t id){
     clients_.erase(id);
 }
 
-void PluginBridge::postUIThread(const ShmUICommand& cmd) {
+bool PluginBridge::postUIThread(const ShmUICommand& cmd) {
     // sizeof(cmd) is a bit lazy, but we don't care too much about space here
     auto& channel = shm_.getChannel(Channel::UISend);
     if (channel.writeMessage(&cmd, sizeof(cmd))){
-        // other side polls regularly
-        // channel.post();
+        // wake up the other side, see PluginServer::runUIWakeThread()
+        channel.post();
+        return true;
     } else {
-        // TODO: loop + sleep for 1 second, see PluginServer
-        LOG_ERROR("PluginBridge: couldn't post to UI thread");
+        return false;
+    }
+}
+
+void PluginBridge::runUIWakeThread(){
+    setThreadPriority(Priority::Low);
+
+    auto& channel = shm_.getChannel(Channel::UIReceive);
+    for (;;) {
+        channel.wait();
+        if (!uiWakeRunning_.load()) {
+            break;
+        }
+        // NB: notifications are coalesced by the event loop
+        UIThread::notifyPollFunctions();
     }
 }
 
@@ -444,40 +532,48 @@ RTChannel PluginBridge::getRTChannel(){
     if (locks_){
         // shared plugin bridge, see the comments in PluginBridge::PluginBridge().
 
-        // we map audio threads to successive indices, so that each audio thread
-        // is automatically associated with a dedicated thread in the subprocess.
+        // We map audio threads to successive indices (from the bottom), so that
+        // each audio thread is automatically associated with a dedicated thread
+        // in the subprocess. Each DSP helper thread owns the channel with the
+        // same index from the top, so with the default number of channels
+        // the main audio thread and the DSP helper threads never collide.
         static std::atomic<uint32_t> counter{0};
 
-        thread_local uint32_t threadIndex = counter.fetch_add(1) % numThreads_;
-        uint32_t index = threadIndex;
-        if (!locks_[index].try_lock()){
+        thread_local int dspIndex = getCurrentDSPThreadIndex();
+        thread_local uint32_t audioIndex = dspIndex < 0 ? counter.fetch_add(1) : 0;
+        uint32_t index = dspIndex >= 0 ? numThreads_ - 1 - (dspIndex % numThreads_)
+                                       : audioIndex % numThreads_;
+        if (!locks_[index].lock.try_lock()){
             // if two threads end up on the same spinlock, e.g. because there are
             // more audio threads than in the subprocess, try to find a free spinlock.
             // LOG_DEBUG("PluginBridge: index " << index << " taken");
+            locks_[index].contended.fetch_add(1, std::memory_order_relaxed);
             do {
                 if (++index == numThreads_) {
                     index = 0;
                 }
-            #if 0
-                // pause CPU everytime we cycle through all spinlocks
-                if (index == threadIndex) {
-                    int spinCount = 1000;
-                    while (spinCount--) {
-                        pauseCpu();
-                    }
-                }
-            #endif
-            } while (!locks_[index].try_lock());
+            } while (!locks_[index].lock.try_lock());
             // LOG_DEBUG("PluginBridge: found free index " << index);
         }
+        auto& acquired = locks_[index].acquired;
+        acquired.store(acquired.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
         return RTChannel(shm_.getChannel(Channel::NRT + 1 + index),
-                         std::unique_lock(locks_[index], std::adopt_lock));
+                         std::unique_lock(locks_[index].lock, std::adopt_lock));
+    } else if (pipelined_) {
+        // plugin sandbox with dedicated RT channel
+        return RTChannel(shm_.getChannel(Channel::NRT + 1));
     } else {
         // plugin sandbox: RT channel = NRT channel
         return RTChannel(shm_.getChannel(Channel::NRT));
     }
 }
 
+RTChannel PluginBridge::getPipelineChannel(){
+    assert(pipelined_);
+    return RTChannel(shm_.getChannel(Channel::NRT + 1), false);
+}
+
 NRTChannel PluginBridge::getNRTChannel(){
     if (locks_){
         return NRTChannel(shm_.getChannel(Channel::NRT),
@@ -488,11 +584,195 @@ NRTChannel PluginBridge::getNRTChannel(){
     }
 }
 
+void PluginBridge::reserveAudioBus(size_t size){
+    if (size <= (size_t)audioCapacity()){
+        return;
+    }
+    // all RT channels should have the same audio bus size,
+    // but we only publish the minimum.
+    int32_t capacity = INT32_MAX;
+    auto reserve = [&](ShmChannel& channel){
+        if (channel.reserve(channel.capacity(), size)){
+            // Let the subprocess map the new segment right away, so that
+            // it doesn't have to do it in the next process request.
+            channel.clear();
+            ShmCommand cmd(Command::MapChannel);
+            channel.addMessage(&cmd, Command::headerSize);
+            channel.post();
+            channel.waitReply();
+            channel.clear();
+        }
+        capacity = std::min(capacity, channel.audioCapacity());
+    };
+    if (locks_){
+        // shared plugin bridge: wait until the RT channel is free
+        for (int i = 0; i < numThreads_; ++i){
+            std::lock_guard lock(locks_[i].lock);
+            reserve(shm_.getChannel(Channel::NRT + 1 + i));
+        }
+    } else {
+        // plugin sandbox: there is only a single client, so the
+        // RT channel is never in use while we are called.
+        // (With pipelining, the pipeline has already been flushed.)
+        reserve(shm_.getChannel(shm_.numChannels() - 1));
+    }
+    audioCapacity_.store(capacity, std::memory_order_release);
+}
+
+BridgeLockStats PluginBridge::lockStats(bool reset){
+    BridgeLockStats result { 0, 0 };
+    for (int i = 0; locks_ && i < numThreads_; ++i) {
+        auto& slot = locks_[i];
+        // NB: resetting is not atomic, but we only need rough numbers
+        result.acquired += reset ? slot.acquired.exchange(0, std::memory_order_relaxed)
+                                 : slot.acquired.load(std::memory_order_relaxed);
+        result.contended += reset ? slot.contended.exchange(0, std::memory_order_relaxed)
+                                  : slot.contended.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+/*/////////////////// BridgePool //////////////////////*/
+
+void setBridgePoolSize(int size){
+    BridgePool::instance().setSize(size);
+}
+
+BridgePool& BridgePool::instance(){
+    static BridgePool pool;
+    return pool;
+}
+
+BridgePool::BridgePool(){
+    LOG_DEBUG("start BridgePool");
+    running_ = true;
+    thread_ = std::thread(&BridgePool::run, this);
+}
+
+BridgePool::~BridgePool(){
+#ifdef _WIN32
+    // see WatchDog::~WatchDog(). NB: we also leak the remaining sandboxes;
+    // they will quit as soon as they notice that the parent has gone.
+    thread_.detach();
+    for (auto& pool : pools_){
+        for (auto& bridge : pool.bridges){
+            new PluginBridge::ptr(std::move(bridge));
+        }
+    }
+#else
+    {
+        std::lock_guard lock(mutex_);
+        running_ = false;
+        condition_.notify_one();
+    }
+    thread_.join();
+#endif
+    LOG_DEBUG("free BridgePool");
+}
+
+void BridgePool::setSize(int size){
+    LOG_DEBUG("BridgePool: set size to " << size);
+    std::vector<PluginBridge::ptr> garbage;
+    std::lock_guard lock(mutex_);
+    size_ = std::max<int>(size, 0);
+    // remove superfluous sandboxes
+    for (auto& pool : pools_){
+        while ((int)pool.bridges.size() > size_){
+            garbage.push_back(std::move(pool.bridges.back()));
+            pool.bridges.pop_back();
+        }
+        pool.failed = false; // try again
+    }
+    condition_.notify_one();
+    // NB: 'garbage' is released *after* unlocking the mutex
+}
+
+PluginBridge::ptr BridgePool::take(CpuArch arch, bool pipelined){
+    std::lock_guard lock(mutex_);
+    if (size_ == 0){
+        return nullptr;
+    }
+    auto it = std::find_if(pools_.begin(), pools_.end(), [&](auto& pool){
+        return pool.arch == arch && pool.pipelined == pipelined;
+    });
+    if (it == pools_.end()){
+        // start filling a new pool
+        pools_.push_back(Pool { arch, pipelined, false, {} });
+        condition_.notify_one();
+        return nullptr;
+    }
+    PluginBridge::ptr result;
+    while (!it->bridges.empty() && !result){
+        auto bridge = std::move(it->bridges.back());
+        it->bridges.pop_back();
+        // the sandbox might have crashed or quit in the meantime
+        if (bridge->alive()){
+            result = std::move(bridge);
+        }
+    }
+    condition_.notify_one(); // refill
+    return result;
+}
+
+void BridgePool::run(){
+    vst::setThreadPriority(Priority::Low);
+
+    std::unique_lock lock(mutex_);
+    while (running_){
+        // find a pool that needs to be refilled
+        auto it = std::find_if(pools_.begin(), pools_.end(), [&](auto& pool){
+            return !pool.failed && (int)pool.bridges.size() < size_;
+        });
+        if (it == pools_.end()){
+            condition_.wait(lock);
+            continue;
+        }
+        auto arch = it->arch;
+        auto pipelined = it->pipelined;
+        // spawn the subprocess without holding the lock
+        lock.unlock();
+        PluginBridge::ptr bridge;
+        try {
+            LOG_DEBUG("BridgePool: spawn sandbox for " << cpuArchToString(arch));
+            bridge = std::make_shared<PluginBridge>(arch, false, pipelined);
+            WatchDog::instance().registerProcess(bridge);
+        } catch (const Error& e){
+            LOG_ERROR("BridgePool: couldn't create sandbox: " << e.what());
+        }
+        lock.lock();
+        // NB: the pool might have been changed in the meantime
+        for (auto& pool : pools_){
+            if (pool.arch == arch && pool.pipelined == pipelined){
+                if (!bridge){
+                    pool.failed = true;
+                } else if ((int)pool.bridges.size() < size_){
+                    pool.bridges.push_back(std::move(bridge));
+                }
+                break;
+            }
+        }
+        if (bridge){
+            // pool is already full; release without holding the lock
+            lock.unlock();
+            bridge = nullptr;
+            lock.lock();
+        }
+    }
+    LOG_DEBUG("BridgePool: thread finished");
+}
+
 /*/////////////////// WatchDog //////////////////////*/
 
-// poll interval in milliseconds
+// Fallback poll interval in milliseconds, in case we can't get
+// process exit notifications from the OS (e.g. Linux < 5.3).
 #define WATCHDOG_POLL_INTERVAL 5
 
+#ifdef _WIN32
+// We can't wait on anonymous pipes, so we have to poll
+// the log pipes while there are any running processes.
+#define WATCHDOG_LOG_INTERVAL 20
+#endif
+
 WatchDog& WatchDog::instance(){
     static WatchDog watchDog;
     return watchDog;
@@ -500,6 +780,34 @@ WatchDog& WatchDog::instance(){
 
 WatchDog::WatchDog(){
     LOG_DEBUG("start WatchDog");
+#if defined(_WIN32)
+    event_ = CreateEventA(NULL, FALSE, FALSE, NULL);
+    if (!event_) {
+        throw Error(Error::SystemError, "CreateEvent() failed: "
+                    + errorMessage(GetLastError()));
+    }
+#elif defined(__APPLE__)
+    kqueue_ = kqueue();
+    if (kqueue_ < 0) {
+        throw Error(Error::SystemError, "kqueue() failed: "
+                    + errorMessage(errno));
+    }
+    struct kevent ev;
+    EV_SET(&ev, 0, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+    if (kevent(kqueue_, &ev, 1, nullptr, 0, nullptr) < 0) {
+        LOG_ERROR("WatchDog: kevent() failed: " << errorMessage(errno));
+    }
+#else
+    // self-pipe for waking up poll()
+    if (pipe(wakeupPipe_) != 0) {
+        throw Error(Error::SystemError, "pipe() failed: "
+                    + errorMessage(errno));
+    }
+    for (auto fd : wakeupPipe_) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+#endif
     running_ = true;
     thread_ = std::thread(&WatchDog::run, this);
 }
@@ -509,24 +817,183 @@ WatchDog::~WatchDog(){
     // You can't synchronize threads in a global/static object
     // destructor in a Windows DLL because of the loader lock.
     // See https://docs.microsoft.com/en-us/windows/win32/dlls/dynamic-link-library-best-practices
+    // NB: we also leak the event and the process handles.
     thread_.detach();
 #else
     {
         std::lock_guard lock(mutex_);
+        for (auto& process : processes_) {
+            closeProcess(process);
+        }
         processes_.clear(); // !
         running_ = false;
-        condition_.notify_one();
+        wakeup();
     }
     thread_.join();
+  #ifdef __APPLE__
+    close(kqueue_);
+  #else
+    close(wakeupPipe_[0]);
+    close(wakeupPipe_[1]);
+  #endif
 #endif
     LOG_DEBUG("free WatchDog");
 }
 
-void WatchDog::registerProcess(PluginBridge::ptr process){
+void WatchDog::registerProcess(PluginBridge::ptr bridge){
     LOG_DEBUG("WatchDog: register process");
+    Process process;
+    process.bridge = bridge;
+#if defined(_WIN32)
+    // Duplicate the process handle because ProcessHandle closes it as soon
+    // as it has noticed that the process is not running anymore.
+    if (!DuplicateHandle(GetCurrentProcess(), bridge->process().nativeHandle(),
+                         GetCurrentProcess(), &process.handle,
+                         SYNCHRONIZE, FALSE, 0)) {
+        LOG_ERROR("WatchDog: DuplicateHandle() failed: "
+                  << errorMessage(GetLastError()));
+        process.handle = NULL;
+    }
+#elif defined(__APPLE__)
+    // NB: the event is removed automatically after the process has exited
+    struct kevent ev[2];
+    int count = 0;
+    EV_SET(&ev[count++], bridge->process().pid(), EVFILT_PROC,
+           EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, nullptr);
+    // also wake up on incoming log messages; the event is removed
+    // automatically when the pipe is closed.
+    if (bridge->logPipe() >= 0) {
+        EV_SET(&ev[count++], bridge->logPipe(), EVFILT_READ,
+               EV_ADD, 0, 0, nullptr);
+    }
+    if (kevent(kqueue_, ev, count, nullptr, 0, nullptr) < 0) {
+        // we still receive a wakeup on every log message,
+        // but a crash might not be detected immediately.
+        LOG_ERROR("WatchDog: kevent() failed: " << errorMessage(errno));
+    }
+#elif defined(__linux__) && defined(SYS_pidfd_open)
+    // NB: requires Linux 5.3; the pidfd becomes readable when the process exits
+    process.pidfd = syscall(SYS_pidfd_open, bridge->process().pid(), 0);
+    if (process.pidfd < 0) {
+        LOG_DEBUG("WatchDog: pidfd_open() failed: " << errorMessage(errno)
+                  << ", fall back to polling");
+    }
+#endif
     std::lock_guard lock(mutex_);
     processes_.push_back(process);
-    condition_.notify_one();
+    wakeup();
+}
+
+void WatchDog::closeProcess(Process& process){
+#if defined(_WIN32)
+    if (process.handle) {
+        CloseHandle(process.handle);
+        process.handle = NULL;
+    }
+#elif defined(__linux__)
+    if (process.pidfd >= 0) {
+        close(process.pidfd);
+        process.pidfd = -1;
+    }
+#endif
+}
+
+void WatchDog::wakeup(){
+#if defined(_WIN32)
+    SetEvent(event_);
+#elif defined(__APPLE__)
+    struct kevent ev;
+    EV_SET(&ev, 0, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+    kevent(kqueue_, &ev, 1, nullptr, 0, nullptr);
+#else
+    char c = 0;
+    // ignore EAGAIN (the pipe is full, so we will wake up anyway)
+    (void)!write(wakeupPipe_[1], &c, 1);
+#endif
+}
+
+// wait until a process has been added/removed, a process has exited
+// or a log message has arrived; must be called with the mutex locked.
+void WatchDog::wait(std::unique_lock<std::mutex>& lock){
+#if defined(_WIN32)
+    HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+    DWORD count = 0;
+    handles[count++] = event_;
+    bool poll = false;
+    bool running = false;
+    for (auto& process : processes_) {
+        auto bridge = process.bridge.lock();
+        if (!bridge || !bridge->alive()) {
+            continue;
+        }
+        if (process.handle && count < MAXIMUM_WAIT_OBJECTS) {
+            handles[count++] = process.handle;
+        } else {
+            poll = true;
+        }
+        running = true;
+    }
+    DWORD timeout = poll ? WATCHDOG_POLL_INTERVAL
+        : (running ? WATCHDOG_LOG_INTERVAL : INFINITE);
+
+    lock.unlock();
+    auto res = WaitForMultipleObjects(count, handles, FALSE, timeout);
+    if (res == WAIT_FAILED) {
+        LOG_ERROR("WatchDog: WaitForMultipleObjects() failed: "
+                  << errorMessage(GetLastError()));
+        Sleep(WATCHDOG_POLL_INTERVAL);
+    }
+    lock.lock();
+#elif defined(__APPLE__)
+    lock.unlock();
+    struct kevent ev[8];
+    // NB: we can't tell if an EVFILT_PROC event couldn't be added,
+    // but in this case we still wake up on the closed log pipe.
+    auto ret = kevent(kqueue_, nullptr, 0, ev, 8, nullptr);
+    if (ret < 0 && errno != EINTR) {
+        LOG_ERROR("WatchDog: kevent() failed: " << errorMessage(errno));
+        usleep(WATCHDOG_POLL_INTERVAL * 1000);
+    }
+    lock.lock();
+#else
+    std::vector<struct pollfd> fds;
+    fds.reserve(processes_.size() * 2 + 1);
+    fds.push_back({ wakeupPipe_[0], POLLIN, 0 });
+    bool poll = false;
+    for (auto& p : processes_) {
+        auto bridge = p.bridge.lock();
+        if (!bridge) {
+            continue;
+        }
+        if (bridge->alive()) {
+        #ifdef __linux__
+            if (p.pidfd >= 0) {
+                fds.push_back({ p.pidfd, POLLIN, 0 });
+            } else
+        #endif
+            {
+                poll = true;
+            }
+        }
+        if (bridge->logPipe() >= 0) {
+            fds.push_back({ bridge->logPipe(), POLLIN, 0 });
+        }
+    }
+    int timeout = poll ? WATCHDOG_POLL_INTERVAL : -1;
+
+    lock.unlock();
+    auto ret = ::poll(fds.data(), fds.size(), timeout);
+    if (ret < 0 && errno != EINTR) {
+        LOG_ERROR("WatchDog: poll() failed: " << errorMessage(errno));
+        usleep(WATCHDOG_POLL_INTERVAL * 1000);
+    }
+    if (fds[0].revents & POLLIN) {
+        // drain the pipe
+        char buf[64];
+        while (read(wakeupPipe_[0], buf, sizeof(buf)) > 0) {}
+    }
+    lock.lock();
+#endif
 }
 
 void WatchDog::run(){
@@ -534,28 +1001,25 @@ void WatchDog::run(){
 
     std::unique_lock lock(mutex_);
     while (running_) {
-        LOG_DEBUG("WatchDog: waiting...");
-        // wait until a process has been added or we should quit
-        condition_.wait(lock, [&]() { return !processes_.empty() || !running_; });
-        LOG_DEBUG("WatchDog: woke up");
-
-        // periodically check all running processes
-        while (!processes_.empty()){
-            for (auto it = processes_.begin(); it != processes_.end();){
-                auto process = it->lock();
-                if (process){
-                    process->readLog();
-                    process->checkStatus();
-                    ++it;
-                } else {
-                    // remove stale process
-                    it = processes_.erase(it);
+        // check all running processes
+        for (auto it = processes_.begin(); it != processes_.end();){
+            auto bridge = it->bridge.lock();
+            if (bridge){
+                bridge->readLog();
+                bridge->checkStatus();
+                if (!bridge->alive()) {
+                    // the exit notification stays signalled!
+                    closeProcess(*it);
                 }
+                ++it;
+            } else {
+                // remove stale process
+                closeProcess(*it);
+                it = processes_.erase(it);
             }
-
-            lock.unlock();
-            std::this_thread::sleep_for(std::chrono::milliseconds(WATCHDOG_POLL_INTERVAL));
-            lock.lock();
+        }
+        if (running_) {
+            wait(lock);
         }
     }
     LOG_DEBUG("WatchDog: thread finished");
@@ -12,6 +12,7 @@
 #include <mutex>
 #include <condition_variable>
 #include <thread>
+#include <type_traits>
 
 #ifdef _WIN32
 # ifndef NOMINMAX
@@ -38,19 +39,50 @@ enum class CpuArch;
 // Don't add an unlock() method (the internal lock might be already unlocked)!
 template<typename Mutex>
 struct _Channel {
+    static constexpr bool growable = !std::is_same_v<Mutex, SpinLock>;
+
     _Channel(ShmChannel& channel)
         : channel_(&channel)
         { channel.clear(); }
     _Channel(ShmChannel& channel, std::unique_lock<Mutex> lock)
         : channel_(&channel), lock_(std::move(lock))
         { channel.clear(); }
+    // don't clear, e.g. because the channel still contains a pending reply
+    _Channel(ShmChannel& channel, bool clear)
+        : channel_(&channel)
+        { if (clear) channel.clear(); }
     _Channel(_Channel&& other) noexcept
         : channel_(other.channel_), lock_(std::move(other.lock_)) {}
 
     int32_t capacity() const { return channel_->capacity(); }
 
+    void * audioBuffer() { return channel_->audioBuffer(); }
+
+    int32_t audioCapacity() const { return channel_->audioCapacity(); }
+
+    // number of bytes used by commands
+    int32_t used() const { return channel_->used(); }
+
     bool addCommand(const void* cmd, size_t size){
-        return channel_->addMessage(cmd, size);
+        if (channel_->addMessage(cmd, size)){
+            return true;
+        }
+        // grow NRT channels on demand, see ShmChannel::reserve().
+        // RT channels are used on the audio thread and must never grow;
+        // instead they are pre-sized, see PluginBridge::reserveAudioBus().
+        if constexpr (growable){
+            return channel_->reserveMessage(size) && channel_->addMessage(cmd, size);
+        } else {
+            return false;
+        }
+    }
+
+    bool reserve(size_t bufferSize, size_t audioSize = 0){
+        if constexpr (growable){
+            return channel_->reserve(bufferSize, audioSize);
+        } else {
+            return false;
+        }
     }
 
     void send(){
@@ -58,6 +90,19 @@ struct _Channel {
         channel_->waitReply();
     }
 
+    // for pipelined processing, see PluginClient
+    void post(){
+        channel_->post();
+    }
+
+    void waitReply(){
+        channel_->waitReply();
+    }
+
+    void clear(){
+        channel_->clear();
+    }
+
     template<typename T>
     bool getReply(const T *& reply, size_t& size){
         return channel_->getMessage(reinterpret_cast<const void *&>(reply), size);
@@ -77,7 +122,7 @@ struct _Channel {
 
 #define AddCommand(cmd, field) addCommand(&(cmd), (cmd).headerSize + sizeof((cmd).field))
 
-using RTChannel = _Channel<PaddedSpinLock>;
+using RTChannel = _Channel<SpinLock>;
 using NRTChannel = _Channel<Mutex>;
 
 /*//////////////////////////// PluginBridge ///////////////////////////*/
@@ -90,9 +135,11 @@ class PluginBridge final
     using ptr = std::shared_ptr<PluginBridge>;
 
     static PluginBridge::ptr getShared(CpuArch arch);
-    static PluginBridge::ptr create(CpuArch arch);
+    // 'pipelined': use a dedicated RT channel, so that a process request
+    // can be pending while the NRT channel is in use, see getPipelineChannel().
+    static PluginBridge::ptr create(CpuArch arch, bool pipelined = false);
 
-    PluginBridge(CpuArch arch, bool shared);
+    PluginBridge(CpuArch arch, bool shared, bool pipelined = false);
     ~PluginBridge();
 
     PluginBridge(const PluginBridge&) = delete;
@@ -108,21 +155,57 @@ class PluginBridge final
 
     void readLog(bool loud = true);
 
+    const ProcessHandle& process() const {
+        return process_;
+    }
+#ifndef _WIN32
+    // NB: only valid on the WatchDog thread, see readLog()
+    int logPipe() const {
+        return logRead_;
+    }
+#endif
+
     void checkStatus();
 
     void addUIClient(uint32_t id, IPluginListener* client);
 
     void removeUIClient(uint32_t id);
 
-    void postUIThread(const ShmUICommand& cmd);
+    // returns false if the UI queue is full
+    bool postUIThread(const ShmUICommand& cmd);
 
     RTChannel getRTChannel();
 
     NRTChannel getNRTChannel();
+
+    // get the dedicated RT channel of a pipelined plugin sandbox.
+    // NB: the channel is not cleared because it might contain a pending reply!
+    RTChannel getPipelineChannel();
+
+    bool pipelined() const {
+        return pipelined_;
+    }
+
+    // (minimum) size of the audio bus of each RT channel
+    int32_t audioCapacity() const {
+        return audioCapacity_.load(std::memory_order_acquire);
+    }
+
+    // Make sure that the audio bus of all RT channels can hold at least
+    // 'size' bytes, see ShmChannel::reserve(). Called from the NRT thread,
+    // e.g. in PluginClient::setupProcessing().
+    void reserveAudioBus(size_t size);
+
+    // RT channel lock statistics (shared bridge only)
+    BridgeLockStats lockStats(bool reset);
  private:
     static const size_t queueSize = 1024;
     static const size_t nrtRequestSize = 65536;
     static const size_t rtRequestSize = 65536;
+    // size of the audio bus for each RT channel; large enough for
+    // 32 channels of 1024 single precision samples (or 512 double
+    // precision samples). Bigger blocks fall back to the message buffer.
+    static const size_t rtAudioSize = 131072;
 
     // NOTE: UI thread order is the opposite of PluginServer!
     struct Channel {
@@ -135,7 +218,9 @@ class PluginBridge final
 
     ShmInterface shm_;
     bool shared_;
+    bool pipelined_;
     std::atomic_bool alive_{false};
+    std::atomic<int32_t> audioCapacity_{0};
     ProcessHandle process_;
 #ifdef _WIN32
     HANDLE hLogRead_ = NULL;
@@ -143,24 +228,72 @@ class PluginBridge final
 #else
     int logRead_ = -1;
 #endif
+    // RT channels of a shared bridge; padded and aligned to prevent false sharing.
+    struct alignas(CACHELINE_SIZE) RTSlot : AlignedClass<RTSlot> {
+        SpinLock lock;
+        std::atomic<uint64_t> acquired{0}; // only modified with the lock held
+        std::atomic<uint64_t> contended{0};
+    };
     int numThreads_ = 0;
-    std::unique_ptr<PaddedSpinLock[]> locks_;
+    std::unique_ptr<RTSlot[]> locks_;
     std::unordered_map<uint32_t, IPluginListener*> clients_;
     Mutex clientMutex_;
     Mutex nrtMutex_;
     // unnecessary, as all IWindow methods should be called form the same thread
     // Mutex uiMutex_;
     UIThread::Handle pollFunction_;
+    // waits for UI messages from the subprocess and wakes up the UI thread
+    std::thread uiWakeThread_;
+    std::atomic<bool> uiWakeRunning_{false};
 
     void pollUIThread();
+    void runUIWakeThread();
 
     IPluginListener* findClient(uint32_t id);
 
     void getStatus(bool wait);
 };
 
+/*/////////////////////////// BridgePool /////////////////////////////*/
+
+// A pool of pre-spawned plugin sandboxes, see setBridgePoolSize().
+class BridgePool {
+ public:
+    static BridgePool& instance();
+
+    ~BridgePool();
+
+    void setSize(int size);
+
+    // take a sandbox from the pool (or nullptr if empty) and refill in the background
+    PluginBridge::ptr take(CpuArch arch, bool pipelined);
+ private:
+    BridgePool();
+
+    void run();
+
+    struct Pool {
+        CpuArch arch;
+        bool pipelined;
+        bool failed = false; // stop refilling after an error
+        std::vector<PluginBridge::ptr> bridges;
+    };
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool running_;
+    int size_ = 0;
+    std::vector<Pool> pools_;
+};
+
 /*/////////////////////////// WatchDog //////////////////////////////*/
 
+// The WatchDog waits for process exit notifications from the OS
+// (pidfd on Linux, kqueue on macOS, process handles on Windows)
+// and for incoming log messages, so that crashed subprocesses are
+// detected immediately and idle hosts don't have to wake up.
+// If the OS doesn't support exit notifications, we fall back to polling.
 class WatchDog {
  public:
     static WatchDog& instance();
@@ -172,12 +305,30 @@ class WatchDog {
     WatchDog();
 
     void run();
+    void wakeup();
+    void wait(std::unique_lock<std::mutex>& lock);
+
+    struct Process {
+        std::weak_ptr<PluginBridge> bridge;
+    #if defined(_WIN32)
+        HANDLE handle = NULL; // duplicated process handle
+    #elif defined(__linux__)
+        int pidfd = -1;
+    #endif
+    };
+    void closeProcess(Process& process);
 
     std::thread thread_;
     std::mutex mutex_;
-    std::condition_variable condition_;
     bool running_;
-    std::vector<std::weak_ptr<PluginBridge>> processes_;
+    std::vector<Process> processes_;
+#if defined(_WIN32)
+    HANDLE event_ = NULL;
+#elif defined(__APPLE__)
+    int kqueue_ = -1;
+#else
+    int wakeupPipe_[2] = { -1, -1 };
+#endif
 };
 
 } // vst
@@ -0,0 +1,230 @@
+#include "PluginCache.h"
+
+#include "Log.h"
+
+#include <cstring>
+
+namespace vst {
+
+/*/////////////////////////// CacheWriter ///////////////////////////*/
+
+cache::StrRef CacheWriter::addString(std::string_view s) {
+    auto it = stringMap_.find(std::string{s});
+    if (it != stringMap_.end()) {
+        return it->second;
+    }
+    cache::StrRef ref;
+    ref.offset = chars_.size();
+    ref.size = s.size();
+    chars_.append(s);
+    stringMap_.emplace(s, ref);
+    return ref;
+}
+
+cache::Range CacheWriter::addStrings(const std::vector<std::string>& list) {
+    cache::Range range;
+    range.first = stringRefs_.size();
+    range.count = list.size();
+    for (auto& s : list) {
+        stringRefs_.push_back(addString(s));
+    }
+    return range;
+}
+
+cache::Range CacheWriter::addBusses(const std::vector<PluginDesc::Bus>& busses) {
+    cache::Range range;
+    range.first = busses_.size();
+    range.count = busses.size();
+    for (auto& bus : busses) {
+        cache::BusRecord record;
+        record.label = addString(bus.label);
+        record.numChannels = bus.numChannels;
+        record.type = bus.type;
+        busses_.push_back(record);
+    }
+    return range;
+}
+
+cache::Range CacheWriter::addParameters(const std::vector<PluginDesc::Param>& params) {
+    cache::Range range;
+    range.first = params_.size();
+    range.count = params.size();
+    for (auto& param : params) {
+        cache::ParamRecord record;
+        record.name = addString(param.name);
+        record.label = addString(param.label);
+        record.id = param.id;
+        record.flags = param.automatable;
+        params_.push_back(record);
+    }
+    return range;
+}
+
+void CacheWriter::addPlugin(const cache::PluginRecord& record) {
+    plugins_.push_back(record);
+}
+
+template<typename T>
+static cache::Table writeTable(File& file, uint32_t& offset, const std::vector<T>& vec) {
+    cache::Table table;
+    table.offset = offset;
+    table.count = vec.size();
+    auto size = vec.size() * sizeof(T);
+    file.write((const char *)vec.data(), size);
+    offset += size;
+    return table;
+}
+
+void CacheWriter::write(const std::string& path, const std::vector<std::string>& exceptions) {
+    cache::Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, cache::magic, sizeof(header.magic));
+    header.byteOrder = cache::byteOrderMark;
+    header.headerSize = sizeof(header);
+    header.version[0] = VERSION_MAJOR;
+    header.version[1] = VERSION_MINOR;
+    header.version[2] = VERSION_PATCH;
+    header.exceptions = addStrings(exceptions);
+
+    // all offsets are 32-bit
+    uint64_t totalSize = sizeof(header) + plugins_.size() * sizeof(cache::PluginRecord)
+            + params_.size() * sizeof(cache::ParamRecord)
+            + busses_.size() * sizeof(cache::BusRecord)
+            + stringRefs_.size() * sizeof(cache::StrRef) + chars_.size();
+    if (totalSize > 0xffffffff) {
+        throw Error("cache file too large");
+    }
+
+    File file(path, File::WRITE);
+    if (!file.is_open()){
+        throw Error("couldn't create file " + path);
+    }
+    // reserve space for the header
+    file.write((const char *)&header, sizeof(header));
+    uint32_t offset = sizeof(header);
+    header.plugins = writeTable(file, offset, plugins_);
+    header.params = writeTable(file, offset, params_);
+    header.busses = writeTable(file, offset, busses_);
+    header.stringRefs = writeTable(file, offset, stringRefs_);
+    header.chars.offset = offset;
+    header.chars.count = chars_.size();
+    file.write(chars_.data(), chars_.size());
+    // now write the actual header
+    file.seekp(0);
+    file.write((const char *)&header, sizeof(header));
+    if (!file.good()) {
+        throw Error("couldn't write cache file " + path);
+    }
+}
+
+/*/////////////////////////// CacheReader ///////////////////////////*/
+
+bool CacheReader::match(const std::string& path) {
+    File file(path);
+    char buf[sizeof(cache::magic)];
+    return file.read(buf, sizeof(buf)) && !memcmp(buf, cache::magic, sizeof(buf));
+}
+
+CacheReader::CacheReader(const std::string& path, bool validate)
+    : path_(path), file_(path) {
+    auto data = file_.data();
+    auto size = file_.size();
+    if (size < sizeof(cache::Header)
+            || memcmp(data, cache::magic, sizeof(cache::magic)) != 0) {
+        throw Error("not a binary cache file");
+    }
+    header_ = (const cache::Header *)data;
+    if (header_->byteOrder != cache::byteOrderMark) {
+        throw Error("cache file has wrong byte order");
+    }
+    if (header_->headerSize < sizeof(cache::Header) || header_->headerSize > size) {
+        throw Error("bad cache file header");
+    }
+    // check tables
+    auto getTable = [&](const cache::Table& table, size_t elemSize) {
+        if ((table.offset % alignof(uint32_t)) != 0
+                || table.offset > size
+                || (uint64_t)table.count * elemSize > size - table.offset) {
+            throw Error("bad cache file table");
+        }
+        return data + table.offset;
+    };
+    plugins_ = (const cache::PluginRecord *)getTable(header_->plugins, sizeof(cache::PluginRecord));
+    params_ = (const cache::ParamRecord *)getTable(header_->params, sizeof(cache::ParamRecord));
+    busses_ = (const cache::BusRecord *)getTable(header_->busses, sizeof(cache::BusRecord));
+    stringRefs_ = (const cache::StrRef *)getTable(header_->stringRefs, sizeof(cache::StrRef));
+    chars_ = getTable(header_->chars, 1);
+    checkRange(header_->exceptions, header_->stringRefs);
+
+    if (validate) {
+        this->validate();
+    }
+}
+
+void CacheReader::checkString(const cache::StrRef& ref) const {
+    if (ref.offset > header_->chars.count
+            || ref.size > header_->chars.count - ref.offset) {
+        throw Error("bad string in cache file");
+    }
+}
+
+void CacheReader::checkRange(const cache::Range& range, const cache::Table& table) const {
+    if (range.first > table.count || range.count > table.count - range.first) {
+        throw Error("bad range in cache file");
+    }
+}
+
+void CacheReader::validate() const {
+    for (uint32_t i = 0; i < header_->stringRefs.count; ++i) {
+        checkString(stringRefs_[i]);
+    }
+    for (uint32_t i = 0; i < header_->params.count; ++i) {
+        checkString(params_[i].name);
+        checkString(params_[i].label);
+    }
+    for (uint32_t i = 0; i < header_->busses.count; ++i) {
+        checkString(busses_[i].label);
+    }
+    for (uint32_t i = 0; i < header_->plugins.count; ++i) {
+        auto& plugin = plugins_[i];
+        for (auto& s : { plugin.path, plugin.uniqueID, plugin.name, plugin.vendor,
+                         plugin.category, plugin.version, plugin.sdkVersion }) {
+            checkString(s);
+        }
+        checkRange(plugin.inputs, header_->busses);
+        checkRange(plugin.outputs, header_->busses);
+        checkRange(plugin.params, header_->params);
+        checkRange(plugin.programs, header_->stringRefs);
+        checkRange(plugin.keys, header_->stringRefs);
+    }
+}
+
+void CacheReader::validatePlugin(int index) const {
+    if (index < 0 || index >= numPlugins()) {
+        throw Error("bad plugin index");
+    }
+    auto& plugin = plugins_[index];
+    for (auto& s : { plugin.path, plugin.uniqueID, plugin.name, plugin.vendor,
+                     plugin.category, plugin.version, plugin.sdkVersion }) {
+        checkString(s);
+    }
+    for (auto& range : { plugin.inputs, plugin.outputs }) {
+        checkRange(range, header_->busses);
+        for (uint32_t i = 0; i < range.count; ++i) {
+            checkString(busses_[range.first + i].label);
+        }
+    }
+    checkRange(plugin.params, header_->params);
+    for (uint32_t i = 0; i < plugin.params.count; ++i) {
+        checkString(params_[plugin.params.first + i].name);
+        checkString(params_[plugin.params.first + i].label);
+    }
+    for (auto& range : { plugin.programs, plugin.keys }) {
+        checkRange(range, header_->stringRefs);
+        for (uint32_t i = 0; i < range.count; ++i) {
+            checkString(stringRefs_[range.first + i]);
+        }
+    }
+}
+
+} // vst
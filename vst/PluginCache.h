@@ -0,0 +1,171 @@
+#pragma once
+
+#include "Interface.h"
+#include "PluginDesc.h"
+#include "FileUtils.h"
+
+#include <array>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace vst {
+
+// Binary plugin cache format
+//
+// The file starts with a header, followed by several tables of fixed-size
+// records and a string table. Records refer to strings with (offset, size)
+// pairs and to other records with (first, count) ranges, so the whole file
+// can be memory mapped and used without any parsing. All fields are 32-bit
+// integers in native byte order; the header contains a byte order mark.
+//
+// The reader validates all offsets and ranges before the records are accessed,
+// so reading a corrupted cache file is always safe.
+
+namespace cache {
+
+const char magic[8] = { 'V', 'S', 'T', 'C', 'A', 'C', 'H', 'E' };
+const uint32_t byteOrderMark = 0x01020304;
+
+struct StrRef {
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct Range {
+    uint32_t first;
+    uint32_t count;
+};
+
+struct Table {
+    uint32_t offset; // in bytes
+    uint32_t count; // number of records (or bytes in case of the string table)
+};
+
+struct Header {
+    char magic[8];
+    uint32_t byteOrder;
+    uint32_t headerSize;
+    uint32_t version[3];
+    uint32_t flags; // reserved
+    Table plugins; // PluginRecord
+    Table params; // ParamRecord
+    Table busses; // BusRecord
+    Table stringRefs; // StrRef, for string lists (programs, keys, exceptions)
+    Table chars; // string data
+    Range exceptions; // string refs
+};
+
+struct PluginRecord {
+    StrRef path;
+    StrRef uniqueID;
+    StrRef name;
+    StrRef vendor;
+    StrRef category;
+    StrRef version;
+    StrRef sdkVersion;
+    uint32_t flags;
+    uint32_t programChange;
+    uint32_t bypass;
+    uint32_t reserved;
+    Range inputs; // busses
+    Range outputs; // busses
+    Range params; // params
+    Range programs; // string refs
+    Range keys; // string refs
+};
+
+struct ParamRecord {
+    StrRef name;
+    StrRef label;
+    uint32_t id;
+    uint32_t flags;
+};
+
+struct BusRecord {
+    StrRef label;
+    int32_t numChannels;
+    int32_t type;
+};
+
+} // cache
+
+// collect plugin descriptions and write them to a binary cache file
+class CacheWriter {
+ public:
+    cache::StrRef addString(std::string_view s);
+    cache::Range addStrings(const std::vector<std::string>& list);
+    cache::Range addBusses(const std::vector<PluginDesc::Bus>& busses);
+    cache::Range addParameters(const std::vector<PluginDesc::Param>& params);
+    void addPlugin(const cache::PluginRecord& record);
+    // throws an Error on failure!
+    void write(const std::string& path, const std::vector<std::string>& exceptions);
+ private:
+    std::vector<cache::PluginRecord> plugins_;
+    std::vector<cache::ParamRecord> params_;
+    std::vector<cache::BusRecord> busses_;
+    std::vector<cache::StrRef> stringRefs_;
+    std::string chars_;
+    // deduplicate strings, e.g. vendor names, paths and parameter labels
+    std::unordered_map<std::string, cache::StrRef> stringMap_;
+};
+
+// map a binary cache file into memory
+class CacheReader {
+ public:
+    // check if the file is a binary cache file
+    static bool match(const std::string& path);
+    // Throws an Error if the file can't be opened or is malformed!
+    // If 'validate' is false, only the header is checked and you must
+    // call validatePlugin() before accessing a plugin record.
+    CacheReader(const std::string& path, bool validate = true);
+
+    const std::string& path() const { return path_; }
+
+    std::array<int, 3> version() const {
+        return { (int)header_->version[0], (int)header_->version[1], (int)header_->version[2] };
+    }
+
+    int numPlugins() const { return header_->plugins.count; }
+
+    const cache::PluginRecord& plugin(int index) const {
+        return plugins_[index];
+    }
+
+    const cache::ParamRecord& param(uint32_t index) const {
+        return params_[index];
+    }
+
+    const cache::BusRecord& bus(uint32_t index) const {
+        return busses_[index];
+    }
+
+    std::string_view string(const cache::StrRef& ref) const {
+        return std::string_view(chars_ + ref.offset, ref.size);
+    }
+    // get string from a string list, see PluginRecord::programs
+    std::string_view string(uint32_t index) const {
+        return string(stringRefs_[index]);
+    }
+
+    cache::Range exceptions() const { return header_->exceptions; }
+
+    // check a single plugin record, including all referenced records and strings.
+    // Throws an Error if the record is malformed.
+    void validatePlugin(int index) const;
+ private:
+    void validate() const;
+    void checkString(const cache::StrRef& ref) const;
+    void checkRange(const cache::Range& range, const cache::Table& table) const;
+
+    std::string path_;
+    MappedFile file_;
+    const cache::Header *header_;
+    const cache::PluginRecord *plugins_;
+    const cache::ParamRecord *params_;
+    const cache::BusRecord *busses_;
+    const cache::StrRef *stringRefs_;
+    const char *chars_;
+};
+
+} // vst
@@ -3,6 +3,9 @@
 #include "Log.h"
 #include "MiscUtils.h"
 #include "FileUtils.h"
+#include "DSPLoad.h"
+#include "Trace.h"
+#include "PackedEvents.h"
 
 #include <algorithm>
 #include <sstream>
@@ -23,18 +26,18 @@ namespace vst {
 #define UNSUPPORTED_METHOD(name) LOG_WARNING(name "() not supported with bit bridging/sandboxing");
 
 IPlugin::ptr createBridgedPlugin(IFactory::const_ptr factory, const std::string& name,
-                                 bool editor, bool sandbox)
+                                 bool editor, bool sandbox, bool pipelined)
 {
     auto info = factory->findPlugin(name); // should never fail
     if (!info){
         throw Error(Error::PluginError, "couldn't find subplugin");
     }
-    return std::make_unique<PluginClient>(factory, info, sandbox, editor);
+    return std::make_unique<PluginClient>(factory, info, sandbox, editor, pipelined);
 }
 
 PluginClient::PluginClient(IFactory::const_ptr f, PluginDesc::const_ptr desc,
-                           bool sandbox, bool editor)
-    : factory_(std::move(f)), info_(std::move(desc))
+                           bool sandbox, bool editor, bool pipelined)
+    : factory_(std::move(f)), info_(std::move(desc)), pipelined_(sandbox && pipelined)
 {
     if ((reinterpret_cast<uintptr_t>(this) & (CACHELINE_SIZE-1)) != 0){
         LOG_WARNING("PluginClient is not properly aligned!");
@@ -45,8 +48,9 @@ PluginClient::PluginClient(IFactory::const_ptr f, PluginDesc::const_ptr desc,
 
     int numParams = info_->numParameters();
     if (info_->numParameters() > 0){
-        paramValueCache_.reset(new std::atomic<float>[numParams]{}); // !
+        paramValueCache_.resize(numParams);
         paramDisplayCache_ = std::make_unique<ParamDisplay[]>(numParams);
+        coalescer_.resize(numParams);
     }
     int numPrograms = info_->numPrograms();
     if (info_->numPrograms() > 0){
@@ -54,7 +58,7 @@ PluginClient::PluginClient(IFactory::const_ptr f, PluginDesc::const_ptr desc,
     }
     if (sandbox){
         LOG_DEBUG("PluginClient (" << id_ << "): create sandbox");
-        bridge_ = PluginBridge::create(factory_->arch());
+        bridge_ = PluginBridge::create(factory_->arch(), pipelined_);
     } else {
         LOG_DEBUG("PluginClient (" << id_ << "): get plugin bridge");
         bridge_ = PluginBridge::getShared(factory_->arch());
@@ -81,7 +85,7 @@ PluginClient::PluginClient(IFactory::const_ptr f, PluginDesc::const_ptr desc,
         // info too large, try to transmit via tmp file
         LOG_DEBUG("PluginClient (" << id_ << "): send info via tmp file (" << info.size() << " bytes)");
         std::stringstream ss;
-        ss << getTmpDirectory() << "/vst_" << (void *)this;
+        ss << getTransferDirectory() << "/vst_" << (void *)this;
         std::string path = ss.str();
         TmpFile file(path, File::WRITE);
         if (!file){
@@ -128,6 +132,7 @@ PluginClient::PluginClient(IFactory::const_ptr f, PluginDesc::const_ptr desc,
 }
 
 PluginClient::~PluginClient(){
+    finishPipeline();
     if (listener_){
         bridge_->removeUIClient(id_);
     }
@@ -145,11 +150,7 @@ PluginClient::~PluginClient(){
 
     // avoid memleak with param string and sysex command
     for (auto& cmd : commands_){
-        if (cmd.type == Command::SetParamString){
-            delete[] cmd.paramString.str;
-        } else if (cmd.type == Command::SendSysex){
-            delete[] cmd.sysex.data;
-        }
+        freeCommand(cmd);
     }
     LOG_DEBUG("PluginClient (" << id_ << "): free");
 }
@@ -165,6 +166,8 @@ void PluginClient::setupProcessing(double sampleRate, int maxBlockSize,
     }
     LOG_DEBUG("PluginClient (" << id_ << "): setupProcessing");
 
+    finishPipeline();
+
     ShmCommand cmd(Command::SetupProcessing);
     cmd.id = id();
     cmd.setup.sampleRate = sampleRate;
@@ -172,11 +175,28 @@ void PluginClient::setupProcessing(double sampleRate, int maxBlockSize,
     cmd.setup.precision = static_cast<uint8_t>(precision);
     cmd.setup.mode = static_cast<uint8_t>(mode);
 
-    auto chn = bridge().getNRTChannel();
-    chn.AddCommand(cmd, setup);
-    chn.send();
+    {
+        auto chn = bridge().getNRTChannel();
+        chn.AddCommand(cmd, setup);
+        chn.send();
 
-    chn.checkError();
+        chn.checkError();
+    }
+
+    maxBlockSize_ = maxBlockSize;
+    sampleSize_ = (precision == ProcessPrecision::Double) ? sizeof(double) : sizeof(float);
+    reserveAudioBus();
+}
+
+void PluginClient::reserveAudioBus(){
+    // Make sure that a full block fits into the audio bus, so that we can
+    // always process in a single round trip without copying the audio data
+    // into the message buffer. NB: we need to know both the block size
+    // and the actual bus arrangement, see setNumSpeakers().
+    if (maxBlockSize_ > 0 && numChannels_ > 0){
+        auto size = ShmCommand::audioBusStride(maxBlockSize_, sampleSize_) * numChannels_;
+        bridge().reserveAudioBus(size);
+    }
 }
 
 template<typename T>
@@ -186,10 +206,169 @@ void PluginClient::doProcess(ProcessData& data){
         commands_.clear(); // avoid commands piling up!
         return;
     }
+    if (pipelined_){
+        doProcessPipelined<T>(data);
+        return;
+    }
     LOG_PROCESS("PluginClient (" << id_ << "): start processing");
 
     auto channel = bridge().getRTChannel();
 
+    // check if the audio data fits into the audio bus of the channel
+    bool useAudioBus = audioBusSize<T>(data) <= (size_t)channel.audioCapacity();
+    uint32_t flags = useAudioBus ? ShmCommand::ProcessAudioBus : 0;
+
+    sendProcess<T>(channel, data, flags);
+
+    // send and wait for reply
+    LOG_PROCESS("PluginClient (" << id_ << "): wait");
+    TRACE_BEGIN(BridgeWait, id_);
+    auto meter = dspLoad_.load(std::memory_order_acquire);
+    if (meter){
+        auto start = DSPLoadMeter::clock::now();
+        channel.send();
+        meter->addWaitTime(DSPLoadMeter::elapsed(start));
+    } else {
+        channel.send();
+    }
+    TRACE_END(BridgeWait, id_);
+
+    // check if host is still alive
+    if (!check()){
+        bypass(data);
+        commands_.clear(); // avoid commands piling up!
+        return;
+    }
+
+    receiveProcess<T>(channel, data, flags);
+
+    // get replies (parameter changes, MIDI messages, etc.)
+    LOG_PROCESS("PluginClient (" << id_ << "): read replies");
+    const ShmCommand* reply;
+    while (channel.getReply(reply)){
+        dispatchReply(*reply);
+    }
+    LOG_PROCESS("PluginClient (" << id_ << "): finished processing");
+}
+
+// Send block N and return the output of block N-1, so the subprocess
+// can process in parallel to the host. This adds one block of latency,
+// just like ThreadedPlugin.
+template<typename T>
+void PluginClient::doProcessPipelined(ProcessData& data){
+    std::lock_guard lock(pipelineLock_);
+
+    auto channel = bridge().getPipelineChannel();
+
+    // get the result of the previous block
+    if (pending_){
+        LOG_PROCESS("PluginClient (" << id_ << "): wait for previous block");
+        TRACE_BEGIN(BridgeWait, id_);
+        auto meter = dspLoad_.load(std::memory_order_acquire);
+        if (meter){
+            auto start = DSPLoadMeter::clock::now();
+            channel.waitReply();
+            meter->addWaitTime(DSPLoadMeter::elapsed(start));
+        } else {
+            channel.waitReply();
+        }
+        TRACE_END(BridgeWait, id_);
+        pending_ = false;
+
+        // check if host is still alive
+        if (!check()){
+            bypass(data);
+            commands_.clear(); // avoid commands piling up!
+            return;
+        }
+
+        const ShmCommand* reply;
+        if (pendingSamples_ == data.numSamples){
+            receiveProcess<T>(channel, data, pendingFlags_);
+        } else {
+            // the block size has changed (shouldn't happen without setupProcessing())
+            LOG_ERROR("PluginClient (" << id_ << "): block size mismatch");
+            bypass(data);
+            for (int i = 0; i < pendingChannels_; ++i){
+                channel.getReply(reply);
+            }
+        }
+
+        while (channel.getReply(reply)){
+            dispatchReply(*reply);
+        }
+    } else {
+        // first block: output silence
+        for (int i = 0; i < data.numOutputs; ++i){
+            auto& bus = data.outputs[i];
+            for (int j = 0; j < bus.numChannels; ++j){
+                auto chn = (T *)bus.channelData32[j];
+                std::fill(chn, chn + data.numSamples, 0);
+            }
+        }
+    }
+
+    // send the current block, but don't wait for the reply.
+    // NB: the input data is written to the channel, so it is
+    // safe to overwrite the input busses afterwards.
+    channel.clear();
+
+    bool useAudioBus = audioBusSize<T>(data) <= (size_t)channel.audioCapacity();
+    pendingFlags_ = useAudioBus ? ShmCommand::ProcessAudioBus : 0;
+    pendingSamples_ = data.numSamples;
+    pendingChannels_ = 0;
+    if (!useAudioBus){
+        // output channels are sent as messages
+        for (int i = 0; i < data.numOutputs; ++i){
+            pendingChannels_ += data.outputs[i].numChannels;
+        }
+    }
+
+    sendProcess<T>(channel, data, pendingFlags_);
+
+    LOG_PROCESS("PluginClient (" << id_ << "): post block");
+    channel.post();
+    pending_ = true;
+}
+
+void PluginClient::finishPipeline(){
+    if (!pipelined_){
+        return;
+    }
+    std::lock_guard lock(pipelineLock_);
+    if (pending_){
+        LOG_DEBUG("PluginClient (" << id_ << "): finish pipeline");
+        if (check()){
+            auto channel = bridge().getPipelineChannel();
+            channel.waitReply();
+            // skip audio output, but dispatch replies
+            const ShmCommand* reply;
+            for (int i = 0; i < pendingChannels_; ++i){
+                channel.getReply(reply);
+            }
+            while (channel.getReply(reply)){
+                dispatchReply(*reply);
+            }
+        }
+        pending_ = false;
+    }
+}
+
+template<typename T>
+size_t PluginClient::audioBusSize(const ProcessData& data){
+    int numChannels = 0;
+    for (int i = 0; i < data.numInputs; ++i){
+        numChannels += data.inputs[i].numChannels;
+    }
+    for (int i = 0; i < data.numOutputs; ++i){
+        numChannels += data.outputs[i].numChannels;
+    }
+    return ShmCommand::audioBusStride(data.numSamples, sizeof(T)) * numChannels;
+}
+
+template<typename T>
+void PluginClient::sendProcess(RTChannel& channel, const ProcessData& data,
+                               uint32_t flags){
     LOG_PROCESS("PluginClient (" << id_ << "): send process command");
     // send process command
     ShmCommand cmd(Command::Process);
@@ -199,35 +378,45 @@ void PluginClient::doProcess(ProcessData& data){
     cmd.process.mode = (uint8_t)data.mode;
     cmd.process.numInputs = data.numInputs;
     cmd.process.numOutputs = data.numOutputs;
+    cmd.process.flags = flags;
 
+    auto start = channel.used();
     channel.AddCommand(cmd, process);
 
     // send input busses
+    auto stride = ShmCommand::audioBusStride(data.numSamples, sizeof(T));
+    auto audioBus = (char *)channel.audioBuffer();
     for (int i = 0; i < data.numInputs; ++i){
         auto& bus = data.inputs[i];
-        // write all channels sequentially to avoid additional copying.
         LOG_PROCESS("PluginClient (" << id_ << "): write input bus " << i << " with "
                     << bus.numChannels << " channels");
         for (int j = 0; j < bus.numChannels; ++j){
-            channel.addCommand((const T *)bus.channelData32[j], sizeof(T) * data.numSamples);
+            auto chn = (const T *)bus.channelData32[j];
+            if (flags & ShmCommand::ProcessAudioBus){
+                // write directly into the audio bus
+                std::copy(chn, chn + data.numSamples, (T *)audioBus);
+                audioBus += stride;
+            } else {
+                // write all channels sequentially to avoid additional copying.
+                channel.addCommand(chn, sizeof(T) * data.numSamples);
+            }
         }
     }
 
     // add commands (parameter changes, MIDI messages, etc.)
     LOG_PROCESS("PluginClient (" << id_ << "): send commands");
-    sendCommands(channel);
-
-    // send and wait for reply
-    LOG_PROCESS("PluginClient (" << id_ << "): wait");
-    channel.send();
+    sendCommands(channel, start);
+}
 
-    // check if host is still alive
-    if (!check()){
-        bypass(data);
-        commands_.clear(); // avoid commands piling up!
-        return;
+template<typename T>
+void PluginClient::receiveProcess(RTChannel& channel, ProcessData& data,
+                                  uint32_t flags){
+    // output channels follow the input channels
+    auto stride = ShmCommand::audioBusStride(data.numSamples, sizeof(T));
+    auto audioBus = (char *)channel.audioBuffer();
+    for (int i = 0; i < data.numInputs; ++i){
+        audioBus += stride * data.inputs[i].numChannels;
     }
-
     // read output busses
     for (int i = 0; i < data.numOutputs; ++i){
         auto& bus = data.outputs[i];
@@ -236,6 +425,12 @@ void PluginClient::doProcess(ProcessData& data){
         // read channels
         for (int j = 0; j < bus.numChannels; ++j){
             auto chn = (T *)bus.channelData32[j];
+            if (flags & ShmCommand::ProcessAudioBus){
+                auto src = (const T *)audioBus;
+                std::copy(src, src + data.numSamples, chn);
+                audioBus += stride;
+                continue;
+            }
             const T* reply;
             size_t size;
             if (channel.getReply(reply, size)){
@@ -250,24 +445,93 @@ void PluginClient::doProcess(ProcessData& data){
             }
         }
     }
-
-    // get replies (parameter changes, MIDI messages, etc.)
-    LOG_PROCESS("PluginClient (" << id_ << "): read replies");
-    const ShmCommand* reply;
-    while (channel.getReply(reply)){
-        dispatchReply(*reply);
-    }
-    LOG_PROCESS("PluginClient (" << id_ << "): finished processing");
 }
 
-void PluginClient::sendCommands(RTChannel& channel){
-    for (auto& cmd : commands_){
+// NB: RT channels can't grow (see _Channel::addCommand()), so if the channel is full,
+// we keep the remaining commands and send them with the next block(s).
+// 'start' is the channel position before our process command.
+void PluginClient::sendCommands(RTChannel& channel, int32_t start){
+    flushParameters();
+
+    size_t failedSize = 0; // size of the command that didn't fit
+    auto addCommand = [&](const void *cmd, size_t size) {
+        if (channel.addCommand(cmd, size)){
+            return true;
+        } else {
+            failedSize = size;
+            return false;
+        }
+    };
+
+    // pack successive commands of the same type into a single message,
+    // see PackedEvents.h. Returns the number of commands that have been sent.
+    // 'count' is set to the number of successive commands.
+    auto sendPacked = [&](size_t i, Command::Type type, size_t& count) -> size_t {
+        count = 1;
+        while ((i + count) < commands_.size() && commands_[i + count].type == type){
+            count++;
+        }
+        if (count == 1){
+            return 0;
+        }
+        PackedEventWriter writer;
+        writer.reset(type == Command::SendMidi ? PackedEvents::Midi
+                                               : PackedEvents::ParamValue);
+        size_t sent = 0;
+        for (size_t j = 0; j < count; ++j){
+            if (writer.full()){
+                if (!addCommand(writer.data(), writer.size())){
+                    return sent;
+                }
+                sent = j;
+                writer.reset(writer.kind());
+            }
+            auto& cmd = commands_[i + j];
+            if (type == Command::SendMidi){
+                writer.addMidi(cmd.midi);
+            } else {
+                writer.addParamValue(cmd.paramValue.index, cmd.paramValue.value,
+                                     cmd.paramValue.offset);
+            }
+        }
+        if (!addCommand(writer.data(), writer.size())){
+            return sent;
+        }
+        return count;
+    };
+
+    size_t i = 0;
+    for (; i < commands_.size(); ++i){
+        auto& cmd = commands_[i];
         // We have to handle some commands specially because their
         // struct layout differs from the corresponding ShmCommand.
+        bool ok = true;
         switch (cmd.type){
         case Command::SetParamValue:
-            channel.AddCommand(cmd, paramValue); // optimize for space!
+        case Command::SendMidi:
+        {
+            size_t count;
+            auto sent = sendPacked(i, (Command::Type)cmd.type, count);
+            if (count > 1){
+                if (sent < count){
+                    i += sent;
+                    ok = false;
+                } else {
+                    i += count - 1;
+                }
+            } else if (cmd.type == Command::SetParamValue){
+                ok = channel.AddCommand(cmd, paramValue); // optimize for space!
+                if (!ok){
+                    failedSize = cmd.headerSize + sizeof(cmd.paramValue);
+                }
+            } else {
+                ok = channel.AddCommand(cmd, midi);
+                if (!ok){
+                    failedSize = cmd.headerSize + sizeof(cmd.midi);
+                }
+            }
             break;
+        }
         case Command::SetParamString:
         {
             auto& param = cmd.paramString;
@@ -281,10 +545,7 @@ void PluginClient::sendCommands(RTChannel& channel){
             shmCmd->paramString.pstr[0] = param.size;
             memcpy(&shmCmd->paramString.pstr[1], param.str, param.size);
 
-            channel.addCommand(shmCmd, cmdSize);
-
-            delete[] cmd.paramString.str; // free!
-
+            ok = addCommand(shmCmd, cmdSize);
             break;
         }
         case Command::SetParamStringShort:
@@ -301,8 +562,7 @@ void PluginClient::sendCommands(RTChannel& channel){
             shmCmd->paramString.pstr[0] = psize;
             memcpy(&shmCmd->paramString.pstr[1], &param.pstr[1], psize);
 
-            channel.addCommand(shmCmd, cmdSize);
-
+            ok = addCommand(shmCmd, cmdSize);
             break;
         }
         case Command::SetProgramName:
@@ -313,14 +573,9 @@ void PluginClient::sendCommands(RTChannel& channel){
             new (shmCmd) ShmCommand(Command::SetProgramName);
             memcpy(shmCmd->s, cmd.s, len);
 
-            delete[] cmd.s; // free!
-
-            channel.addCommand(shmCmd, cmdSize);
+            ok = addCommand(shmCmd, cmdSize);
             break;
         }
-        case Command::SendMidi:
-            channel.AddCommand(cmd, midi);
-            break;
         case Command::SendSysex:
         {
             auto cmdSize = CommandSize(ShmCommand, sysex, cmd.sysex.size);
@@ -330,21 +585,55 @@ void PluginClient::sendCommands(RTChannel& channel){
             shmCmd->sysex.size = cmd.sysex.size;
             memcpy(shmCmd->sysex.data, cmd.sysex.data, cmd.sysex.size);
 
-            delete[] cmd.sysex.data; // free!
-
-            channel.addCommand(shmCmd, cmdSize);
+            ok = addCommand(shmCmd, cmdSize);
             break;
         }
         // All other commands are layout compatible with ShmCommand.
         // They all take max. 12 bytes and are rare enough that we
         // don't have to optimize for space
         default:
-            channel.AddCommand(cmd, d);
+            ok = channel.AddCommand(cmd, d);
+            if (!ok){
+                failedSize = cmd.headerSize + sizeof(cmd.d);
+            }
+            break;
+        }
+        if (!ok){
             break;
         }
+        freeCommand(cmd); // free payload!
+    }
+
+    if (i < commands_.size()){
+        // The channel is full. If the command doesn't even fit together with
+        // our process command and audio data, we have to drop it; otherwise
+        // it would block all subsequent commands forever.
+        auto fixedSize = channel.used() - start;
+        if (i == 0 && (fixedSize + ShmChannel::messageSize(failedSize)) > (size_t)channel.capacity()){
+            LOG_ERROR("PluginClient (" << id_ << "): command " << commands_[0].type
+                      << " (" << failedSize << " bytes) too large for RT channel - dropped");
+            freeCommand(commands_[0]);
+            i = 1;
+        } else {
+            LOG_DEBUG("PluginClient (" << id_ << "): RT channel full, defer "
+                      << (commands_.size() - i) << " commands");
+        }
+        // keep the remaining commands for the next block
+        // NB: this doesn't reallocate
+        commands_.erase(commands_.begin(), commands_.begin() + i);
+    } else {
+        commands_.clear(); // !
     }
+}
 
-    commands_.clear(); // !
+void PluginClient::freeCommand(Command& cmd){
+    if (cmd.type == Command::SetParamString){
+        freePayload(cmd.paramString.str);
+    } else if (cmd.type == Command::SetProgramName){
+        freePayload(cmd.s);
+    } else if (cmd.type == Command::SendSysex){
+        freePayload(cmd.sysex.data);
+    }
 }
 
 void PluginClient::dispatchReply(const ShmCommand& reply){
@@ -352,31 +641,36 @@ void PluginClient::dispatchReply(const ShmCommand& reply){
     switch (reply.type){
     case Command::ParamAutomated:
     case Command::ParameterUpdate:
+        updateParamState(reply.paramState.index, reply.paramState.value,
+                         reply.paramState.pstr,
+                         reply.type == Command::ParamAutomated);
+        break;
+    case Command::PackedEvents:
     {
-        auto index = reply.paramState.index;
-        auto value = reply.paramState.value;
-        auto pstr = reply.paramState.pstr;
-
-        paramValueCache_[index].store(value, std::memory_order_relaxed);
-        {
-            auto& cache = paramDisplayCache_[index];
-            auto size = std::min<size_t>(pstr[0], cache.size() - 1);
-            // must be thread-safe!
-            std::lock_guard lock(cacheLock_);
-            cache[0] = size; // pascal string!
-            memcpy(&cache[1], &pstr[1], size);
+        if (reply.packed.version != PackedEvents::version){
+            LOG_ERROR("PluginClient (" << id_ << "): PackedEvents version mismatch");
+            break;
         }
-
-        if (reply.type == Command::ParamAutomated){
-            if (listener_){
-                listener_->parameterAutomated(index, value);
+        PackedEventReader reader(reply);
+        if (reply.packed.kind == PackedEvents::ParamState){
+            while (reader.next()){
+                int index;
+                float value;
+                const uint8_t *pstr;
+                bool automated;
+                reader.readParamState(index, value, pstr, automated);
+                updateParamState(index, value, pstr, automated);
+            }
+        } else if (reply.packed.kind == PackedEvents::Midi){
+            while (reader.next()){
+                auto event = reader.readMidi();
+                if (listener_){
+                    listener_->midiEvent(event);
+                }
             }
-            LOG_DEBUG("PluginClient (" << id_ << "): parameter " << index
-                      << " automated ");
         } else {
-            LOG_DEBUG("PluginClient (" << id_ << "): parameter " << index
-                      << " updated to " << value << " "
-                      << std::string((char *)&pstr[1], pstr[0]));
+            LOG_ERROR("PluginClient (" << id_ << "): unexpected PackedEvents kind "
+                      << (int)reply.packed.kind);
         }
         break;
     }
@@ -430,12 +724,45 @@ void PluginClient::dispatchReply(const ShmCommand& reply){
     }
 }
 
+void PluginClient::updateParamState(int index, float value,
+                                    const uint8_t *pstr, bool automated){
+    paramValueCache_.set(index, value);
+    {
+        auto& cache = paramDisplayCache_[index];
+        auto size = std::min<size_t>(pstr[0], cache.size() - 1);
+        // must be thread-safe!
+        std::lock_guard lock(cacheLock_);
+        cache[0] = size; // pascal string!
+        memcpy(&cache[1], &pstr[1], size);
+    }
+
+    if (automated){
+        if (listener_){
+            listener_->parameterAutomated(index, value);
+        }
+        LOG_DEBUG("PluginClient (" << id_ << "): parameter " << index
+                  << " automated ");
+    } else {
+        LOG_DEBUG("PluginClient (" << id_ << "): parameter " << index
+                  << " updated to " << value << " "
+                  << std::string((char *)&pstr[1], pstr[0]));
+    }
+}
+
 void PluginClient::process(ProcessData& data){
+    TRACE_SCOPE(ClientProcess, id_);
+    auto meter = dspLoad_.load(std::memory_order_acquire);
+    auto start = meter ? DSPLoadMeter::clock::now() : DSPLoadMeter::clock::time_point{};
+
     if (data.precision == ProcessPrecision::Double){
         doProcess<double>(data);
     } else {
         doProcess<float>(data);
     }
+
+    if (meter){
+        meter->addProcessTime(DSPLoadMeter::elapsed(start), data.numSamples);
+    }
 }
 
 void PluginClient::suspend(){
@@ -443,6 +770,9 @@ void PluginClient::suspend(){
         return;
     }
     LOG_DEBUG("PluginClient (" << id_ << "): suspend");
+
+    finishPipeline();
+
     ShmCommand cmd(Command::Suspend, id());
 
     auto chn = bridge().getNRTChannel();
@@ -473,6 +803,8 @@ void PluginClient::setNumSpeakers(int *input, int numInputs,
         return;
     }
 
+    finishPipeline();
+
     LOG_DEBUG("requested bus arrangement:");
     for (int i = 0; i < numInputs; ++i){
         LOG_DEBUG("input bus " << i << ": " << input[i] << "ch");
@@ -527,12 +859,22 @@ void PluginClient::setNumSpeakers(int *input, int numInputs,
     }
 
     LOG_DEBUG("actual bus arrangement:");
+    int numChannels = 0;
     for (int i = 0; i < numInputs; ++i){
         LOG_DEBUG("input bus " << i << ": " << input[i] << "ch");
+        numChannels += input[i];
     }
     for (int i = 0; i < numOutputs; ++i){
         LOG_DEBUG("output bus " << i << ": " << output[i] << "ch");
+        numChannels += output[i];
     }
+
+    // avoid dead lock in reserveAudioBus()
+    {
+        auto dummy = std::move(chn);
+    }
+    numChannels_ = numChannels;
+    reserveAudioBus();
 }
 
 int PluginClient::getLatencySamples(){
@@ -562,7 +904,7 @@ double PluginClient::getTransportPosition() const {
 void PluginClient::setParameter(int index, float value, int sampleOffset){
     // don't cache immediately, so that value and display stay in sync.
 #if 0
-    paramValueCache_[index].store(value, std::memory_order_relaxed); // cache value
+    paramValueCache_.set(index, value); // cache value
 #endif
     DeferredPlugin::setParameter(index, value, sampleOffset);
 }
@@ -583,7 +925,7 @@ bool PluginClient::setParameter(int index, std::string_view str, int sampleOffse
 }
 
 float PluginClient::getParameter(int index) const {
-    return paramValueCache_[index].load(std::memory_order_relaxed);
+    return paramValueCache_.get(index);
 }
 
 size_t PluginClient::getParameterString(int index, ParamStringBuffer& buffer) const {
@@ -598,6 +940,25 @@ size_t PluginClient::getParameterString(int index, ParamStringBuffer& buffer) co
     return size;
 }
 
+// NB: values and strings are served from the local cache, so we only
+// need to lock once and don't need any IPC.
+void PluginClient::getParameters(int first, int count, float *values,
+                                 ParamStringBuffer *strings) const {
+    for (int i = 0; i < count; ++i) {
+        values[i] = paramValueCache_.get(first + i);
+    }
+    if (strings) {
+        std::lock_guard lock(cacheLock_);
+        for (int i = 0; i < count; ++i) {
+            auto& param = paramDisplayCache_[first + i];
+            auto size = param[0];
+            assert(size < param.size());
+            memcpy(strings[i].data(), &param[1], size);
+            strings[i][size] = 0;
+        }
+    }
+}
+
 void PluginClient::setProgram(int index) {
     // let's cache immediately
 #if 1
@@ -624,10 +985,10 @@ void PluginClient::setProgramName(std::string_view name) {
 #endif
 
     Command cmd(Command::SetProgramName);
-    cmd.s = new char[name.size() + 1];
+    cmd.s = allocatePayload(PayloadType::String, name.size() + 1);
     memcpy(cmd.s, name.data(), name.size() + 1);
 
-    commands_.push_back(cmd);
+    deferCommand(cmd);
 }
 
 std::string PluginClient::getProgramName() const {
@@ -720,12 +1081,13 @@ void PluginClient::sendData(Command::Type type, const char *data, size_t size){
 
     auto totalSize = sizeof(ShmCommand) + size;
     auto chn = bridge().getNRTChannel();
-    if (totalSize > chn.capacity()) {
+    // try to grow the channel, so we can send the data in a single request
+    if (totalSize > chn.capacity() && !chn.reserve(totalSize + 64)) {
         // plugin data too large, try to transmit via tmp file
         LOG_DEBUG("PluginClient (" << id_ << "): send plugin data via tmp file (size: "
                   << size << ", capacity: " << chn.capacity() << ")");
         std::stringstream ss;
-        ss << getTmpDirectory() << "/vst_" << (void *)this;
+        ss << getTransferDirectory() << "/vst_" << (void *)this;
         std::string path = ss.str();
         TmpFile file(path, File::WRITE);
         if (!file){
@@ -803,15 +1165,14 @@ void PluginClient::receiveData(Command::Type type, std::string &buffer){
         } else if (reply->type == Command::PluginDataFile) {
             // data is transmitted in a tmp file
             auto path = reply->buffer.data;
-            File file(path, File::READ);
-            if (!file){
-                throw Error(Error::SystemError, "PluginClient: couldn't read tmp file");
+            try {
+                MappedFile file(path);
+                buffer.assign(file.data(), file.size());
+            } catch (const Error& e) {
+                removeFile(path);
+                throw Error(Error::SystemError, "PluginClient: couldn't read tmp file: "
+                            + std::string(e.what()));
             }
-            file.seekg(0, std::ios_base::end);
-            buffer.resize(file.tellg());
-            file.seekg(0, std::ios_base::beg);
-            file.read(&buffer[0], buffer.size());
-            file.close();
 
             // we have to remove the tmp file!
             if (!removeFile(path)) {
@@ -872,16 +1233,22 @@ WindowClient::WindowClient(PluginClient& plugin)
 
 WindowClient::~WindowClient(){}
 
+void WindowClient::post(const ShmUICommand& cmd){
+    if (!plugin_->bridge().postUIThread(cmd)){
+        LOG_ERROR("WindowClient: couldn't post to UI thread");
+    }
+}
+
 void WindowClient::open(){
     LOG_DEBUG("WindowOpen");
     ShmUICommand cmd(Command::WindowOpen, plugin_->id());
-    plugin_->bridge().postUIThread(cmd);
+    post(cmd);
 }
 
 void WindowClient::close(){
     LOG_DEBUG("WindowClose");
     ShmUICommand cmd(Command::WindowClose, plugin_->id());
-    plugin_->bridge().postUIThread(cmd);
+    post(cmd);
 }
 
 void WindowClient::setPos(int x, int y){
@@ -889,7 +1256,7 @@ void WindowClient::setPos(int x, int y){
     ShmUICommand cmd(Command::WindowSetPos, plugin_->id());
     cmd.windowPos.x = x;
     cmd.windowPos.y = y;
-    plugin_->bridge().postUIThread(cmd);
+    post(cmd);
 }
 
 void WindowClient::setSize(int w, int h){
@@ -897,7 +1264,7 @@ void WindowClient::setSize(int w, int h){
     ShmUICommand cmd(Command::WindowSetSize, plugin_->id());
     cmd.windowSize.width = w;
     cmd.windowSize.height = h;
-    plugin_->bridge().postUIThread(cmd);
+    post(cmd);
 }
 
 } // vst
@@ -5,6 +5,7 @@
 #include "DeferredPlugin.h"
 #include "MiscUtils.h"
 #include "PluginBridge.h"
+#include "ParamCache.h"
 
 #include <array>
 
@@ -18,7 +19,7 @@ class alignas(CACHELINE_SIZE) PluginClient final
     : public DeferredPlugin, public AlignedClass<PluginClient> {
 public:
     PluginClient(IFactory::const_ptr f, PluginDesc::const_ptr desc,
-                 bool sandbox, bool editor);
+                 bool sandbox, bool editor, bool pipelined = false);
 
     virtual ~PluginClient();
 
@@ -26,6 +27,8 @@ public:
         return *info_;
     }
 
+    // a pipelined plugin has one block of latency, just like ThreadedPlugin
+    bool isThreaded() const override { return pipelined_; }
     bool isBridged() const override { return true; }
 
     PluginBridge& bridge() {
@@ -39,6 +42,10 @@ public:
     void setupProcessing(double sampleRate, int maxBlockSize,
                          ProcessPrecision precision, ProcessMode mode) override;
     void process(ProcessData& data) override;
+    bool setDSPLoadMeter(DSPLoadMeter *meter) override {
+        dspLoad_.store(meter, std::memory_order_release);
+        return true;
+    }
     void suspend() override;
     void resume() override;
     void setNumSpeakers(int *input, int numInputs, int *output, int numOutputs) override;
@@ -52,6 +59,11 @@ public:
     bool setParameter(int index, std::string_view str, int sampleOffset) override;
     float getParameter(int index) const override;
     size_t getParameterString(int index, ParamStringBuffer& buffer) const override;
+    void getParameters(int first, int count, float *values,
+                       ParamStringBuffer *strings) const override;
+    const ParamCache * getParameterCache() const override {
+        return &paramValueCache_;
+    }
 
     void setProgram(int index) override;
     int getProgram() const override;
@@ -90,6 +102,9 @@ public:
     // VST2 only
     int canDo(const char *what) const override;
     intptr_t vendorSpecific(int index, intptr_t value, void *p, float opt) override;
+
+    template<typename T>
+    static size_t audioBusSize(const ProcessData& data);
 protected:
     void pushCommand(const Command& cmd) override {
         commands_.push_back(cmd);
@@ -102,11 +117,23 @@ protected:
     void sendData(Command::Type type, const char *data, size_t size);
 
     void receiveData(Command::Type type, std::string& buffer);
-    template<typename T>
 
+    template<typename T>
     void doProcess(ProcessData& data);
-    void sendCommands(RTChannel& channel);
+    template<typename T>
+    void doProcessPipelined(ProcessData& data);
+    void finishPipeline();
+    template<typename T>
+    void sendProcess(RTChannel& channel, const ProcessData& data, uint32_t flags);
+    template<typename T>
+    void receiveProcess(RTChannel& channel, ProcessData& data, uint32_t flags);
+    void sendCommands(RTChannel& channel, int32_t start);
+    void freeCommand(Command& cmd);
+    // size the audio bus for the current bus layout and block size
+    void reserveAudioBus();
     void dispatchReply(const ShmCommand &reply);
+    void updateParamState(int index, float value,
+                          const uint8_t *pstr, bool automated);
 
     IFactory::const_ptr factory_; // keep alive!
     PluginDesc::const_ptr info_;
@@ -117,9 +144,21 @@ protected:
     std::vector<Command> commands_;
     int program_ = 0;
     int latency_ = 0;
+    // for reserveAudioBus()
+    int maxBlockSize_ = 0;
+    size_t sampleSize_ = sizeof(float);
+    int numChannels_ = 0;
+    // pipelined processing
+    bool pipelined_ = false;
+    bool pending_ = false;
+    uint32_t pendingFlags_ = 0;
+    int pendingSamples_ = 0;
+    int pendingChannels_ = 0;
+    SpinLock pipelineLock_;
+    std::atomic<DSPLoadMeter *> dspLoad_{nullptr}; // see setDSPLoadMeter()
     double transport_;
     // cache
-    std::unique_ptr<std::atomic<float>[]> paramValueCache_;
+    ParamCache paramValueCache_;
     // use fixed sized arrays to avoid potential heap allocations with std::string
     // After all, parameter displays are typically rather short. If the string
     // happens to be larger than the array, we just truncate it.
@@ -149,6 +188,8 @@ class WindowClient : public IWindow {
         // ignore
     }
  private:
+    void post(const ShmUICommand& cmd);
+
     PluginClient *plugin_;
 };
 
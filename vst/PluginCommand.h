@@ -29,14 +29,15 @@ struct Command {
         SendSysex,
         SetProgram,
         SetProgramName,
+        SetSilenceMode,
         // NRT commands
-        CreatePlugin, // 18
+        CreatePlugin, // 19
         DestroyPlugin,
         Suspend,
         Resume,
         SetNumSpeakers,
         SetupProcessing,
-        ReadProgramFile, // 24
+        ReadProgramFile, // 25
         ReadProgramData,
         ReadBankFile,
         ReadBankData,
@@ -45,27 +46,29 @@ struct Command {
         WriteBankFile,
         WriteBankData,
         // window
-        WindowOpen, // 32
+        WindowOpen, // 33
         WindowClose,
         WindowSetPos,
         WindowSetSize,
         // events/replies
-        PluginData, // 36
+        PluginData, // 37
         PluginDataFile,
         SpeakerArrangement,
         ProgramChange,
         ProgramNumber,
         ProgramName,
         ProgramNameIndexed,
-        ParameterUpdate, // 43
+        ParameterUpdate, // 44
         ParamAutomated,
         LatencyChanged,
         UpdateDisplay,
         MidiReceived,
         SysexReceived,
         // for plugin bridge
-        Error, // 49
+        Error, // 50
         Process,
+        PackedEvents, // see PackedEvents.h
+        MapChannel, // see PluginBridge::reserveAudioBus()
         Quit
     };
     Command(){}
@@ -167,6 +170,13 @@ struct ShmCommand {
             uint16_t index;
             float value;
         } paramValue;
+        // packed events, see PackedEvents.h
+        struct {
+            uint8_t version;
+            uint8_t kind;
+            uint16_t count;
+            char data[1];
+        } packed;
         // flat param string, for setParameterString()
         struct {
             uint16_t offset;
@@ -209,6 +219,7 @@ struct ShmCommand {
             uint8_t mode;
             uint16_t numInputs;
             uint16_t numOutputs;
+            uint32_t flags; // see ProcessFlags
         } process;
         // setup processing
         struct {
@@ -233,6 +244,18 @@ struct ShmCommand {
     void throwError() const {
         throw Error(static_cast<Error::ErrorCode>(error.code), error.msg);
     }
+
+    // flags for the 'process' command
+    enum ProcessFlags {
+        // audio data lives in the audio bus of the channel
+        ProcessAudioBus = 1
+    };
+
+    // distance between successive channels in the audio bus;
+    // each channel starts on a cache line.
+    static size_t audioBusStride(int numSamples, size_t sampleSize){
+        return (numSamples * sampleSize + 63) & ~(size_t)63;
+    }
 };
 
 // additional commands/replies (for IPC over shared memory)
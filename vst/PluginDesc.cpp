@@ -3,12 +3,14 @@
 #include "CpuArch.h"
 #include "MiscUtils.h"
 #include "FileUtils.h"
+#include "PluginCache.h"
 #include "Log.h"
 #include "Sync.h"
 
 #include <algorithm>
 #include <sstream>
 #include <cstring>
+#include <mutex>
 
 namespace vst {
 
@@ -107,7 +109,8 @@ static std::string getPresetLocation(PresetType presetType, PluginType pluginTyp
 
 /*///////////////////// PluginDesc /////////////////////*/
 
-PluginDesc::PluginDesc(std::shared_ptr<const IFactory> f){
+PluginDesc::PluginDesc(std::shared_ptr<const IFactory> f)
+    : tables_(std::make_unique<Tables>()) {
     if (f){
         setFactory(std::move(f));
     }
@@ -136,7 +139,7 @@ IPlugin::ptr createThreadedPlugin(IPlugin::ptr plugin);
 #if USE_BRIDGE
 // PluginClient.cpp
 IPlugin::ptr createBridgedPlugin(IFactory::const_ptr factory, const std::string& name,
-                                 bool editor, bool sandbox);
+                                 bool editor, bool sandbox, bool pipelined);
 #endif
 
 IPlugin::ptr PluginDesc::create(bool editor, bool threaded, RunMode mode) const {
@@ -148,7 +151,15 @@ IPlugin::ptr PluginDesc::create(bool editor, bool threaded, RunMode mode) const
 #if USE_BRIDGE
     if ((mode == RunMode::Bridge) || (mode == RunMode::Sandbox) ||
             ((mode == RunMode::Auto) && bridged())){
-        plugin = createBridgedPlugin(factory, name, editor, mode == RunMode::Sandbox);
+        // A threaded plugin in a sandbox doesn't need a ThreadedPlugin wrapper;
+        // instead, the plugin client is pipelined and the subprocess runs
+        // in parallel with the host, see PluginClient::doProcessPipelined()
+        bool sandbox = mode == RunMode::Sandbox;
+        bool pipelined = sandbox && threaded;
+        plugin = createBridgedPlugin(factory, name, editor, sandbox, pipelined);
+        if (pipelined){
+            threaded = false;
+        }
     }
     else
 #endif
@@ -197,21 +208,151 @@ static void conformPath(std::string& path){
 }
 
 void PluginDesc::addParameter(Param param){
-    auto index = parameters.size();
+    doAddParameter(tables(), std::move(param));
+}
+
+void PluginDesc::doAddParameter(Tables& tables, Param param){
+    auto index = tables.parameters.size();
     // name -> index mapping
-    paramMap_.insert(param.name, index);
+    tables.paramMap.insert(param.name, index);
 #if USE_VST3
     // index -> ID mapping
-    indexToIdMap_.insert(index, param.id);
+    tables.indexToIdMap.insert(index, param.id);
     // ID -> index mapping
-    idToIndexMap_.insert(param.id, index);
+    tables.idToIndexMap.insert(param.id, index);
 #endif
     // finally add parameter
-    parameters.push_back(std::move(param));
+    tables.parameters.push_back(std::move(param));
 }
 
 void PluginDesc::addParamAlias(int index, std::string_view key) {
-    paramMap_.insert(key, index);
+    tables().paramMap.insert(key, index);
+}
+
+void PluginDesc::freezeParameters() {
+    doFreezeParameters(tables());
+}
+
+void PluginDesc::doFreezeParameters(Tables& tables) {
+#if USE_VST3
+    // parameter indices are always sequential; many plugins
+    // also use sequential (or at least dense) parameter IDs.
+    tables.indexToIdMap.freeze();
+    tables.idToIndexMap.freeze();
+#endif
+}
+
+/*//////////////////////// lazy tables ////////////////////////*/
+
+// protects the lazy tables and summaries of *all* plugin descriptions;
+// tables are only loaded once per plugin, so contention is not an issue.
+static std::mutex gTableMutex;
+
+void PluginDesc::loadTables() const {
+    if (tablesLoaded_.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::lock_guard lock(gTableMutex);
+    if (tablesLoaded_.load(std::memory_order_relaxed)) {
+        return; // already loaded by another thread
+    }
+    // NB: don't try to probe the plugin again. It would block the calling
+    // thread - and all other threads which need to load their tables -
+    // until the subprocess has finished. Instead, the host should tell the
+    // user to search again; the tables are loaded as soon as the cache file
+    // contains the plugin again, see updateCacheSource().
+    try {
+        tables_ = readTables(*summary_);
+    } catch (const Error& e) {
+        throw Error(Error::PluginError, "couldn't load plugin info for '" + name
+                    + "' from cache file (" + e.what() + "); please search again");
+    }
+    tablesLoaded_.store(true, std::memory_order_release);
+    LOG_DEBUG("loaded plugin info tables for '" << name << "'");
+}
+
+const PluginDesc::Tables& PluginDesc::peekTables(std::unique_ptr<Tables>& temp) const {
+    if (!tablesLoaded_.load(std::memory_order_acquire)) {
+        std::lock_guard lock(gTableMutex);
+        if (!tablesLoaded_.load(std::memory_order_relaxed)) {
+            // read the tables without keeping them in memory
+            try {
+                temp = readTables(*summary_);
+            } catch (const Error& e) {
+                throw Error(Error::PluginError, "couldn't load plugin info for '" + name
+                            + "' from cache file (" + e.what() + ")");
+            }
+            return *temp;
+        }
+    }
+    return *tables_;
+}
+
+std::unique_ptr<PluginDesc::Tables> PluginDesc::readTables(const Summary& summary) const {
+    CacheReader reader(summary.cachePath, false); // throws on failure
+    // The index is only a hint because the cache file might have been
+    // rewritten in the meantime, so we have to check the record.
+    auto match = [&](int index) {
+        reader.validatePlugin(index);
+        auto& record = reader.plugin(index);
+        return reader.string(record.path) == path_
+                && reader.string(record.name) == name
+                && reader.string(record.uniqueID) == uniqueID;
+    };
+    int index = summary.index;
+    if (index >= reader.numPlugins() || !match(index)) {
+        index = -1;
+        for (int i = 0; i < reader.numPlugins(); ++i) {
+            if (match(i)) {
+                index = i;
+                break;
+            }
+        }
+        if (index < 0) {
+            throw Error("plugin not found in cache file " + summary.cachePath);
+        }
+    }
+    auto& record = reader.plugin(index);
+    auto tables = std::make_unique<Tables>();
+    auto getBusses = [&](const cache::Range& range) {
+        std::vector<Bus> result;
+        result.reserve(range.count);
+        for (uint32_t i = 0; i < range.count; ++i) {
+            auto& b = reader.bus(range.first + i);
+            Bus bus;
+            bus.numChannels = b.numChannels;
+            bus.type = (Bus::Type)b.type;
+            bus.label = reader.string(b.label);
+            result.push_back(std::move(bus));
+        }
+        return result;
+    };
+    tables->inputs = getBusses(record.inputs);
+    tables->outputs = getBusses(record.outputs);
+    tables->parameters.reserve(record.params.count);
+    for (uint32_t i = 0; i < record.params.count; ++i) {
+        auto& p = reader.param(record.params.first + i);
+        Param param;
+        param.name = reader.string(p.name);
+        param.label = reader.string(p.label);
+        param.id = p.id;
+        param.automatable = p.flags & 1;
+        doAddParameter(*tables, std::move(param));
+    }
+    tables->programs.reserve(record.programs.count);
+    for (uint32_t i = 0; i < record.programs.count; ++i) {
+        tables->programs.emplace_back(reader.string(record.programs.first + i));
+    }
+    doFreezeParameters(*tables);
+    return tables;
+}
+
+void PluginDesc::updateCacheSource(const std::string& path, int index) const {
+    std::lock_guard lock(gTableMutex);
+    if (summary_) {
+        summary_->cachePath = path;
+        summary_->index = index;
+    }
 }
 
 void PluginDesc::scanPresets(){
@@ -445,6 +586,10 @@ void PluginDesc::serialize(std::ostream& file) const {
         }
         return;
     }
+    // don't keep the tables in memory if they haven't been loaded yet.
+    // NB: do this first, so we don't write a partial record on failure.
+    std::unique_ptr<Tables> temp;
+    auto& tables = peekTables(temp);
     file << "[plugin]\n";
     file << "path=" << path() << "\n";
     file << "id=" << uniqueID << "\n";
@@ -464,14 +609,14 @@ void PluginDesc::serialize(std::ostream& file) const {
 #endif
     // inputs
     file << "[inputs]\n";
-    writeBusses(file, inputs);
+    writeBusses(file, tables.inputs);
     // outputs
     file << "[outputs]\n";
-    writeBusses(file, outputs);
+    writeBusses(file, tables.outputs);
     // parameters
     file << "[parameters]\n";
-    file << "n=" << parameters.size() << "\n";
-    for (auto& param : parameters) {
+    file << "n=" << tables.parameters.size() << "\n";
+    for (auto& param : tables.parameters) {
         uint32_t flags = param.automatable;
         file << bashString(param.name) << ","
              << bashString(param.label) << ","
@@ -480,8 +625,8 @@ void PluginDesc::serialize(std::ostream& file) const {
     }
     // programs
     file << "[programs]\n";
-    file << "n=" << programs.size() << "\n";
-    for (auto& pgm : programs) {
+    file << "n=" << tables.programs.size() << "\n";
+    for (auto& pgm : tables.programs) {
         file << pgm << "\n";
     }
 }
@@ -552,6 +697,31 @@ void parseArg(std::string& lh, const std::string& rh){
 
 } // namespace
 
+#if WARN_VST3_PARAMETERS
+// check if VST3 plugin has any non-automatable parameters
+// *before* automatable parameters. See WARN_VST3_PARAMETERS.
+template<typename F>
+static bool checkParameterOrder(const std::string& name, int numParams, F&& isAutomatable) {
+    int lastAutomatable = -1;
+    int firstNonAutomatable = -1;
+    for (int i = 0; i < numParams; ++i) {
+        if (isAutomatable(i)) {
+            lastAutomatable = i;
+        } else if (firstNonAutomatable < 0) {
+            firstNonAutomatable = i;
+        }
+    }
+    if (firstNonAutomatable >= 0 && firstNonAutomatable < lastAutomatable) {
+    #if DEBUG_PARAMETERS
+        LOG_DEBUG("'" << name << "': automatable and non-automatable parameters intersect!");
+    #endif
+        return true;
+    } else {
+        return false;
+    }
+}
+#endif // WARN_VST3_PARAMETERS
+
 bool getLine(std::istream& stream, std::string& line){
     std::string temp;
     while (std::getline(stream, temp)){
@@ -605,11 +775,11 @@ void PluginDesc::deserialize(std::istream& file, int versionMajor,
         if (line == "[plugin]"){
             start = true;
         } else if (line == "[inputs]"){
-            inputs = readBusses(file);
+            inputs() = readBusses(file);
         } else if (line == "[outputs]"){
-            outputs = readBusses(file);
+            outputs() = readBusses(file);
         } else if (line == "[parameters]"){
-            parameters.clear();
+            tables().parameters.clear();
             std::getline(file, line);
             int n = getCount(line);
             while (n-- && std::getline(file, line)){
@@ -637,11 +807,11 @@ void PluginDesc::deserialize(std::istream& file, int versionMajor,
                 addParameter(std::move(param));
             }
         } else if (line == "[programs]"){
-            programs.clear();
+            programs().clear();
             std::getline(file, line);
             int n = getCount(line);
             while (n-- && std::getline(file, line)){
-                programs.push_back(line);
+                programs().push_back(line);
             }
             break; // done
         } else if (line == "[subplugins]"){
@@ -665,20 +835,7 @@ void PluginDesc::deserialize(std::istream& file, int versionMajor,
         #define IGNORE(name) else if (name == key) {}
             try {
                 if (key == "id"){
-                    if (value.size() == 8){
-                        type_ = PluginType::VST2;
-                        sscanf(&value[0], "%08X", &id_.id);
-                    } else if (value.size() == 32){
-                        type_ = PluginType::VST3;
-                        for (int i = 0; i < 16; ++i){
-                            unsigned int temp;
-                            sscanf(&value[i * 2], "%02X", &temp);
-                            id_.uid[i] = temp;
-                        }
-                    } else {
-                        throw Error("bad id!");
-                    }
-                    uniqueID = value;
+                    parseUniqueID(value);
                 }
                 MATCH("path", path_)
                 MATCH("name", name)
@@ -718,41 +875,112 @@ void PluginDesc::deserialize(std::istream& file, int versionMajor,
             }
         }
     }
+    finishDeserialize();
+#if WARN_VST3_PARAMETERS
+    if (type() == PluginType::VST3) {
+        auto& params = tables().parameters;
+        warnParameters = checkParameterOrder(name, params.size(),
+            [&](int i) { return params[i].automatable; });
+    }
+#endif
+}
+
+void PluginDesc::parseUniqueID(const std::string& id) {
+    if (id.size() == 8){
+        type_ = PluginType::VST2;
+        sscanf(&id[0], "%08X", &id_.id);
+    } else if (id.size() == 32){
+        type_ = PluginType::VST3;
+        for (int i = 0; i < 16; ++i){
+            unsigned int temp;
+            sscanf(&id[i * 2], "%02X", &temp);
+            id_.uid[i] = temp;
+        }
+    } else {
+        throw Error("bad id!");
+    }
+    uniqueID = id;
+}
+
+void PluginDesc::finishDeserialize() {
     // restore "Bridge" flag
     auto factory = factory_.lock();
     if (factory && factory->arch() != getHostCpuArchitecture()){
         flags |= Bridged;
     }
+    if (tablesLoaded_.load(std::memory_order_relaxed)) {
+        doFreezeParameters(*tables_);
+    }
+}
+
+void PluginDesc::serialize(CacheWriter& writer, const std::vector<std::string>& keys) const {
+    // don't keep the tables in memory if they haven't been loaded yet.
+    // NB: do this first, so we don't add any data to the writer on failure.
+    std::unique_ptr<Tables> temp;
+    auto& tables = peekTables(temp);
+    cache::PluginRecord record;
+    record.path = writer.addString(path());
+    record.uniqueID = writer.addString(uniqueID);
+    record.name = writer.addString(name);
+    record.vendor = writer.addString(vendor);
+    record.category = writer.addString(category);
+    record.version = writer.addString(version);
+    record.sdkVersion = writer.addString(sdkVersion);
+    record.flags = flags;
+#if USE_VST3
+    record.programChange = programChange;
+    record.bypass = bypass;
+#else
+    record.programChange = NoParamID;
+    record.bypass = NoParamID;
+#endif
+    record.reserved = 0;
+    record.inputs = writer.addBusses(tables.inputs);
+    record.outputs = writer.addBusses(tables.outputs);
+    record.params = writer.addParameters(tables.parameters);
+    record.programs = writer.addStrings(tables.programs);
+    record.keys = writer.addStrings(keys);
+    writer.addPlugin(record);
+}
+
+void PluginDesc::deserialize(const CacheReader& reader, int index) {
+    auto& record = reader.plugin(index);
+    auto getString = [&](const cache::StrRef& ref) {
+        return std::string{reader.string(ref)};
+    };
+    path_ = getString(record.path);
+    parseUniqueID(getString(record.uniqueID));
+    name = getString(record.name);
+    vendor = getString(record.vendor);
+    category = getString(record.category);
+    version = getString(record.version);
+    sdkVersion = getString(record.sdkVersion);
+    flags = record.flags;
+#if USE_VST3
+    programChange = record.programChange;
+    bypass = record.bypass;
+#endif
+    // only keep a summary; the tables are loaded on demand.
+    auto summary = std::make_unique<Summary>();
+    summary->cachePath = reader.path();
+    summary->index = index;
+    summary->numInputs = record.inputs.count;
+    summary->numOutputs = record.outputs.count;
+    summary->numParameters = record.params.count;
+    summary->numPrograms = record.programs.count;
+    {
+        std::lock_guard lock(gTableMutex);
+        summary_ = std::move(summary);
+        tables_ = nullptr;
+        tablesLoaded_.store(false, std::memory_order_release);
+    }
+    finishDeserialize();
 #if WARN_VST3_PARAMETERS
-    // warn if VST3 plugin has any non-automatable parameters
-    // *before* automatable parameters. See WARN_VST3_PARAMETERS.
     if (type() == PluginType::VST3) {
-        int lastAutomatable = -1;
-        int firstNonAutomatable = -1;
-        for (int i = 0; i < parameters.size(); ++i) {
-            auto& param =  parameters[i];
-            if (param.automatable) {
-                lastAutomatable = i;
-            } else {
-                if (firstNonAutomatable < 0) {
-                    firstNonAutomatable = i;
-                #if DEBUG_PARAMETERS
-                    LOG_DEBUG("non-automatable parameters in '" << name << "':");
-                #endif
-                }
-            #if DEBUG_PARAMETERS
-                LOG_DEBUG(param.name);
-            #endif
-            }
-        }
-        if (firstNonAutomatable >= 0 && firstNonAutomatable < lastAutomatable) {
-            warnParameters = true;
-        #if DEBUG_PARAMETERS
-            LOG_DEBUG("automatable and non-automatable parameters intersect!");
-        #endif
-        }
+        warnParameters = checkParameterOrder(name, record.params.count,
+            [&](int i) { return reader.param(record.params.first + i).flags & 1; });
     }
-#endif // WARN_VST3_PARAMETERS
+#endif
 }
 
 } // vst
@@ -4,9 +4,14 @@
 #include "HashTable.h"
 
 #include <assert.h>
+#include <atomic>
+#include <memory>
 
 namespace vst {
 
+class CacheWriter;
+class CacheReader;
+
 class PluginDesc final {
 public:
     static const uint32_t NoParamID = 0xffffffff;
@@ -29,6 +34,17 @@ public:
     void serialize(std::ostream& file) const;
     void deserialize(std::istream& file, int versionMajor = VERSION_MAJOR,
                      int versionMinor = VERSION_MINOR, int versionPatch = VERSION_PATCH);
+    // binary cache file, see PluginCache.h
+    void serialize(CacheWriter& writer, const std::vector<std::string>& keys) const;
+    void deserialize(const CacheReader& reader, int index);
+    // called after the plugin description has been written to a binary cache file
+    void updateCacheSource(const std::string& path, int index) const;
+    // Load the lazy tables from the binary cache file (if necessary).
+    // Throws an Error if the tables can't be read, e.g. because the plugin
+    // has been removed from the cache file in the meantime. The accessors
+    // below call this method implicitly, so hosts should call it whenever
+    // they look up a plugin description, where they can handle the error.
+    void loadTables() const;
 #if USE_VST2
     void setUniqueID(int _id); // VST2
     int getUniqueID() const {
@@ -77,14 +93,31 @@ public:
         std::string label;
     };
 
-    std::vector<Bus> inputs;
+    // NB: busses, parameters and programs are stored in separate tables.
+    // If the plugin description has been read from a binary cache file,
+    // these tables are only loaded on first access, so that a large plugin
+    // dictionary doesn't take up much memory. See loadTables().
+    // NB: the accessors throw an Error if the tables can't be loaded!
+    const std::vector<Bus>& inputs() const {
+        return tables().inputs;
+    }
+    std::vector<Bus>& inputs() {
+        return tables().inputs;
+    }
     int numInputs() const {
-        return inputs.size();
+        return tablesLoaded_.load(std::memory_order_acquire) ?
+            tables_->inputs.size() : summary_->numInputs;
     }
 
-    std::vector<Bus> outputs;
+    const std::vector<Bus>& outputs() const {
+        return tables().outputs;
+    }
+    std::vector<Bus>& outputs() {
+        return tables().outputs;
+    }
     int numOutputs() const {
-        return outputs.size();
+        return tablesLoaded_.load(std::memory_order_acquire) ?
+            tables_->outputs.size() : summary_->numOutputs;
     }
 
 #if USE_VST3
@@ -98,29 +131,34 @@ public:
         uint32_t id = 0;
         bool automatable = true;
     };
-    std::vector<Param> parameters;
+    const std::vector<Param>& parameters() const {
+        return tables().parameters;
+    }
 
     void addParameter(Param param);
     void addParamAlias(int index, std::string_view key);
+    // build fast lookup tables; call after all parameters have been added
+    void freezeParameters();
 
     // returns -1 if the parameter is not found
     int findParam(std::string_view key) const {
-        return paramMap_.findOr(key, -1);
+        return tables().paramMap.findOr(key, -1);
     }
     int numParameters() const {
-        return parameters.size();
+        return tablesLoaded_.load(std::memory_order_acquire) ?
+            tables_->parameters.size() : summary_->numParameters;
     }
 #if USE_VST3
     // get VST3 parameter ID from index
     uint32_t getParamID(int index) const {
-        auto result = indexToIdMap_.find(index);
+        auto result = tables().indexToIdMap.find(index);
         assert(result); // throw?
         return *result;
     }
     // get index from VST3 parameter ID
     // returns -1 if the parameter is not found (not automatable)
     int getParamIndex(uint32_t id) const {
-        return idToIndexMap_.findOr(id, -1);
+        return tables().idToIndexMap.findOr(id, -1);
     }
 #endif
     // presets
@@ -134,9 +172,15 @@ public:
     std::string getPresetFolder(PresetType type, bool create = false) const;
     PresetList presets;
     // default programs
-    std::vector<std::string> programs;
+    const std::vector<std::string>& programs() const {
+        return tables().programs;
+    }
+    std::vector<std::string>& programs() {
+        return tables().programs;
+    }
     int numPrograms() const {
-        return programs.size();
+        return tablesLoaded_.load(std::memory_order_acquire) ?
+            tables_->programs.size() : summary_->numPrograms;
     }
     // flags
     enum Flags {
@@ -196,14 +240,43 @@ public:
  private:
     std::weak_ptr<const IFactory> factory_;
     std::string path_;
-    // param name -> param index mapping
-    HashTable<std::string, int, std::string_view> paramMap_;
-#if USE_VST3
-    // param index to ID (VST3 only)
-    HashTable<int, uint32_t> indexToIdMap_;
-    // param ID to index (VST3 only)
-    HashTable<uint32_t, int> idToIndexMap_;
-#endif
+    struct Tables {
+        std::vector<Bus> inputs;
+        std::vector<Bus> outputs;
+        std::vector<Param> parameters;
+        // param name -> param index mapping
+        HashTable<std::string, int, std::string_view> paramMap;
+    #if USE_VST3
+        // param index to ID (VST3 only)
+        DenseHashTable<int, uint32_t> indexToIdMap;
+        // param ID to index (VST3 only)
+        DenseHashTable<uint32_t, int> idToIndexMap;
+    #endif
+        std::vector<std::string> programs;
+    };
+    // Where to load the tables from if the plugin description
+    // has been read from a binary cache file.
+    struct Summary {
+        std::string cachePath;
+        int index; // record index (only a hint)
+        int numInputs;
+        int numOutputs;
+        int numParameters;
+        int numPrograms;
+    };
+    Tables& tables() const {
+        if (!tablesLoaded_.load(std::memory_order_acquire)) {
+            loadTables();
+        }
+        return *tables_;
+    }
+    const Tables& peekTables(std::unique_ptr<Tables>& temp) const;
+    std::unique_ptr<Tables> readTables(const Summary& summary) const;
+    static void doAddParameter(Tables& tables, Param param);
+    static void doFreezeParameters(Tables& tables);
+    mutable std::unique_ptr<Tables> tables_;
+    mutable std::unique_ptr<Summary> summary_;
+    mutable std::atomic<bool> tablesLoaded_{true};
     PluginType type_;
     union ID {
         char uid[16];
@@ -211,6 +284,9 @@ public:
     };
     ID id_;
     // helper methods
+    void parseUniqueID(const std::string& id);
+    void finishDeserialize();
+
     void sortPresets(bool userOnly = true);
     mutable bool didCreatePresetFolder = false;
 };
@@ -1,41 +1,397 @@
 #include "PluginDictionary.h"
 
 #include "FileUtils.h"
+#include "MiscUtils.h"
+#include "PluginCache.h"
 #include "Log.h"
-#if USE_WINE
-# include "CpuArch.h"
-#endif
+#include "CpuArch.h"
 
 #include <fstream>
 #include <cstdlib>
 #include <sstream>
 #include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cassert>
+#include <vector>
 
 namespace vst {
 
+/*/////////////////////////// Snapshot ////////////////////////////*/
+
+IFactory::const_ptr PluginDictionary::Snapshot::findFactory(const std::string& path) const {
+    auto factory = factories_.find(path);
+    if (factory != factories_.end()){
+        return factory->second;
+    } else {
+        return nullptr;
+    }
+}
+
+bool PluginDictionary::Snapshot::isException(const std::string& path) const {
+    return exceptions_.count(path) != 0;
+}
+
+const PluginDictionary::ExceptionInfo *
+PluginDictionary::Snapshot::findException(const std::string& path) const {
+    auto it = exceptions_.find(path);
+    if (it != exceptions_.end()){
+        return &it->second;
+    } else {
+        return nullptr;
+    }
+}
+
+PluginDesc::const_ptr PluginDictionary::Snapshot::findPlugin(const std::string& key) const {
+    return doFindPlugin(plugins_, key);
+}
+
+// All queries are case-insensitive. The name index is sorted by the
+// lower case plugin name, so prefix and exact queries only need a range
+// lookup. The vendor, category and type indexes contain iterators into the
+// name index which are kept in the same order, so all query results are
+// sorted by name, no matter which index has been used.
+
+static std::string toLower(std::string_view s) {
+    std::string result(s);
+    for (auto& c : result) {
+        c = std::tolower((unsigned char)c);
+    }
+    return result;
+}
+
+// split VST3 categories, e.g. "Fx|Delay" -> "fx", "delay"
+template<typename Fn>
+static void forEachCategory(const std::string& category, Fn&& fn) {
+    size_t pos = 0;
+    while (pos <= category.size()) {
+        auto end = category.find('|', pos);
+        if (end == std::string::npos) {
+            end = category.size();
+        }
+        if (end > pos) {
+            fn(toLower(std::string_view(category).substr(pos, end - pos)));
+        }
+        pos = end + 1;
+    }
+}
+
+static int typeIndex(PluginType type) {
+    return type == PluginType::VST3 ? 1 : 0;
+}
+
+// check if all characters of 'pattern' appear in 'name' in the same order
+static bool fuzzyMatch(std::string_view name, std::string_view pattern) {
+    size_t pos = 0;
+    for (auto c : pattern) {
+        pos = name.find(c, pos);
+        if (pos == std::string_view::npos) {
+            return false;
+        }
+        pos++;
+    }
+    return true;
+}
+
+void PluginDictionary::Snapshot::buildIndex() {
+    // every unique plugin is indexed once, no matter how many keys it has.
+    std::unordered_set<PluginDesc::const_ptr> pluginSet;
+    for (auto& plugins : plugins_){
+        for (auto& [_, desc] : plugins){
+            pluginSet.insert(desc);
+        }
+    }
+    pluginList_.assign(pluginSet.begin(), pluginSet.end());
+
+    for (auto& plugin : pluginList_) {
+        nameIndex_.emplace(toLower(plugin->name), plugin);
+    }
+    // iterate in name order, so that all buckets are sorted by name
+    for (auto it = nameIndex_.begin(); it != nameIndex_.end(); ++it) {
+        auto& plugin = *it->second;
+        if (!plugin.vendor.empty()) {
+            vendorIndex_[toLower(plugin.vendor)].push_back(it);
+        }
+        forEachCategory(plugin.category, [&](const std::string& category) {
+            categoryIndex_[category].push_back(it);
+        });
+        typeIndex_[typeIndex(plugin.type())].push_back(it);
+    }
+}
+
+void PluginDictionary::Snapshot::query(const PluginQuery& q, const QueryCallback& fn) const {
+    auto name = toLower(q.name);
+    auto vendor = toLower(q.vendor);
+    auto category = toLower(q.category);
+
+    auto matches = [&](NameIndex::const_iterator it) {
+        auto& plugin = *it->second;
+        if (!name.empty()) {
+            switch (q.match) {
+            case PluginQuery::Exact:
+                if (it->first != name) return false;
+                break;
+            case PluginQuery::Prefix:
+                if (!startsWith(it->first, name)) return false;
+                break;
+            case PluginQuery::Fuzzy:
+                if (!fuzzyMatch(it->first, name)) return false;
+                break;
+            }
+        }
+        if (!vendor.empty() && toLower(plugin.vendor) != vendor) {
+            return false;
+        }
+        if (!category.empty()) {
+            bool found = false;
+            forEachCategory(plugin.category, [&](const std::string& c) {
+                if (c == category) found = true;
+            });
+            if (!found) return false;
+        }
+        if (q.type && plugin.type() != *q.type) {
+            return false;
+        }
+        return true;
+    };
+
+    // 1. name prefix or exact name: range lookup in the name index
+    if (!name.empty() && q.match != PluginQuery::Fuzzy) {
+        auto it = nameIndex_.lower_bound(name);
+        for (; it != nameIndex_.end() && startsWith(it->first, name); ++it) {
+            if (matches(it) && !fn(it->second)) {
+                return;
+            }
+        }
+        return;
+    }
+    // 2. the smallest matching bucket
+    const IndexBucket *bucket = nullptr;
+    auto select = [&](const auto& map, const std::string& key) {
+        auto it = map.find(key);
+        static const IndexBucket empty;
+        auto& b = (it != map.end()) ? it->second : empty;
+        if (!bucket || b.size() < bucket->size()) {
+            bucket = &b;
+        }
+    };
+    if (!vendor.empty()) {
+        select(vendorIndex_, vendor);
+    }
+    if (!category.empty()) {
+        select(categoryIndex_, category);
+    }
+    if (q.type) {
+        auto& b = typeIndex_[typeIndex(*q.type)];
+        if (!bucket || b.size() < bucket->size()) {
+            bucket = &b;
+        }
+    }
+    if (bucket) {
+        for (auto& it : *bucket) {
+            if (matches(it) && !fn(it->second)) {
+                return;
+            }
+        }
+        return;
+    }
+    // 3. full scan, e.g. for fuzzy queries
+    for (auto it = nameIndex_.begin(); it != nameIndex_.end(); ++it) {
+        if (matches(it) && !fn(it->second)) {
+            return;
+        }
+    }
+}
+
+std::vector<PluginDesc::const_ptr> PluginDictionary::Snapshot::query(const PluginQuery& q,
+                                                                     int limit) const {
+    std::vector<PluginDesc::const_ptr> result;
+    query(q, [&](const PluginDesc::const_ptr& plugin) {
+        result.push_back(plugin);
+        return limit <= 0 || (int)result.size() < limit;
+    });
+    return result;
+}
+
+/*//////////////////////// PluginDictionary ////////////////////////*/
+
+// Readers use the current snapshot, which is only replaced as a whole
+// (read-copy-update), so they never take the lock and never rebuild the
+// snapshot. Writers modify the dictionary under the (exclusive) lock and
+// publish a new snapshot before they return - unless a batch is open, in which
+// case the snapshot is published when the batch is committed. While there are
+// unpublished updates, the lookup methods read the dictionary itself (with the
+// shared lock), so that writers always see their own updates.
+
+PluginDictionary::PluginDictionary()
+    : snapshot_(std::make_shared<Snapshot>()) {}
+
+PluginDictionary::Snapshot::ptr PluginDictionary::snapshot() const {
+    return std::atomic_load_explicit(&snapshot_, std::memory_order_acquire);
+}
+
+void PluginDictionary::beginUpdate() {
+    std::lock_guard lock(mutex_);
+    updateDepth_++;
+}
+
+void PluginDictionary::commitUpdate() {
+    std::lock_guard lock(mutex_);
+    assert(updateDepth_ > 0);
+    if (--updateDepth_ == 0) {
+        doPublish();
+    }
+}
+
+void PluginDictionary::didUpdate() {
+    dirty_.store(true, std::memory_order_release);
+    if (updateDepth_ == 0) {
+        doPublish();
+    }
+}
+
+void PluginDictionary::doPublish() {
+    if (!dirty_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->factories_ = factories_;
+    snapshot->plugins_ = plugins_;
+    snapshot->exceptions_ = exceptions_;
+    snapshot->buildIndex();
+    std::atomic_store_explicit(&snapshot_, Snapshot::ptr(std::move(snapshot)),
+                               std::memory_order_release);
+    dirty_.store(false, std::memory_order_release);
+}
+
 void PluginDictionary::addFactory(const std::string& path, IFactory::ptr factory) {
+    // update the probe index; do the file I/O before locking
+    std::unique_ptr<IndexEntry> entry;
+    if (factory->valid()) {
+        FileInfo oldInfo;
+        bool haveOld = false;
+        {
+            std::shared_lock lock(mutex_);
+            auto it = index_.find(factory->path());
+            if (it != index_.end()) {
+                oldInfo = it->second.info;
+                haveOld = true;
+            }
+        }
+        entry = makeIndexEntry(*factory, haveOld ? &oldInfo : nullptr);
+    }
     std::lock_guard lock(mutex_);
+    if (entry) {
+        index_[factory->path()] = std::move(*entry);
+    }
     factories_[path] = std::move(factory);
+    didUpdate();
 }
 
 IFactory::const_ptr PluginDictionary::findFactory(const std::string& path) const {
-    std::shared_lock lock(mutex_);
-    auto factory = factories_.find(path);
-    if (factory != factories_.end()){
-        return factory->second;
+    if (dirty_.load(std::memory_order_acquire)) {
+        // unpublished updates
+        std::shared_lock lock(mutex_);
+        auto factory = factories_.find(path);
+        return factory != factories_.end() ? factory->second : nullptr;
+    }
+    return snapshot()->findFactory(path);
+}
+
+// PluginDesc.cpp
+bool getLine(std::istream& stream, std::string& line);
+int getCount(const std::string& line);
+
+static double getPluginTimestamp(const std::string& path) {
+    // LOG_DEBUG("getPluginTimestamp: " << path);
+    if (isFile(path)) {
+        return fileTimeLastModified(path);
     } else {
-        return nullptr;
+        // bundle: find newest timestamp of all contained binaries
+        double timestamp = 0;
+        vst::search(path + "/Contents", [&](auto& path){
+            double t = fileTimeLastModified(path);
+            if (t > timestamp) {
+                timestamp = t;
+            }
+        }, false); // don't filter by extensions (because of macOS)!
+        return timestamp;
     }
 }
 
-void PluginDictionary::addException(const std::string &path){
+void PluginDictionary::addException(const std::string &path, Error::ErrorCode code){
+    // do the file I/O before locking
+    ExceptionInfo info;
+    info.code = code;
+    using seconds = std::chrono::duration<double>;
+    info.time = std::chrono::duration_cast<seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    try {
+        info.mtime = getPluginTimestamp(path);
+    } catch (const Error& e) {
+        LOG_DEBUG("could not get timestamp for " << path << ": " << e.what());
+    }
     std::lock_guard lock(mutex_);
-    exceptions_.insert(path);
+    auto it = exceptions_.find(path);
+    if (it != exceptions_.end() && it->second.code == Error::Timeout
+            && code == Error::Timeout && it->second.mtime == info.mtime) {
+        // timed out again
+        info.retries = it->second.retries + 1;
+    }
+    exceptions_[path] = info;
+    didUpdate();
 }
 
 bool PluginDictionary::isException(const std::string& path) const {
-    std::shared_lock lock(mutex_);
-    return exceptions_.count(path) != 0;
+    if (dirty_.load(std::memory_order_acquire)) {
+        // unpublished updates
+        std::shared_lock lock(mutex_);
+        return exceptions_.count(path) != 0;
+    }
+    return snapshot()->isException(path);
+}
+
+std::optional<PluginDictionary::ExceptionInfo>
+PluginDictionary::findException(const std::string& path) const {
+    if (dirty_.load(std::memory_order_acquire)) {
+        // unpublished updates
+        std::shared_lock lock(mutex_);
+        auto it = exceptions_.find(path);
+        if (it != exceptions_.end()) {
+            return it->second;
+        } else {
+            return std::nullopt;
+        }
+    }
+    // keep the snapshot alive while we copy the info
+    auto snapshot = this->snapshot();
+    if (auto info = snapshot->findException(path)) {
+        return *info;
+    } else {
+        return std::nullopt;
+    }
+}
+
+PluginDictionary::Retry PluginDictionary::retryException(const std::string& path) const {
+    auto info = findException(path);
+    if (!info) {
+        return Retry::Now; // not black-listed
+    }
+    try {
+        if (getPluginTimestamp(path) != info->mtime) {
+            LOG_VERBOSE("black-listed plugin " << path << " has changed");
+            return Retry::Now;
+        }
+    } catch (const Error& e) {
+        LOG_DEBUG("could not get timestamp for " << path << ": " << e.what());
+        return Retry::Skip;
+    }
+    if (info->code == Error::Timeout && info->retries < PROBE_MAX_RETRIES) {
+        return Retry::Later;
+    } else {
+        return Retry::Skip;
+    }
 }
 
 void PluginDictionary::addPlugin(const std::string& key, PluginDesc::const_ptr plugin) {
@@ -56,38 +412,43 @@ void PluginDictionary::addPlugin(const std::string& key, PluginDesc::const_ptr p
 #endif
     // LOG_DEBUG("add plugin " << key << ((index == BRIDGED) ? " [bridged]" : ""));
     plugins_[index][key] = std::move(plugin);
+    didUpdate();
 }
 
-PluginDesc::const_ptr PluginDictionary::findPlugin(const std::string& key) const {
-    std::shared_lock lock(mutex_);
+PluginDesc::const_ptr PluginDictionary::doFindPlugin(const PluginMap& plugins,
+                                                     const std::string& key) {
     // first try to find native plugin
-    auto it = plugins_[NATIVE].find(key);
-    if (it != plugins_[NATIVE].end()){
+    auto it = plugins[NATIVE].find(key);
+    if (it != plugins[NATIVE].end()){
         return it->second;
     }
     // then try to find bridged plugin
-    it = plugins_[BRIDGED].find(key);
-    if (it != plugins_[BRIDGED].end()){
+    it = plugins[BRIDGED].find(key);
+    if (it != plugins[BRIDGED].end()){
         return it->second;
     }
     return nullptr;
 }
 
-std::vector<PluginDesc::const_ptr> PluginDictionary::pluginList() const {
-    std::shared_lock lock(mutex_);
-    // inverse mapping (plugin -> keys)
-    std::unordered_set<PluginDesc::const_ptr> pluginSet;
-    for (auto& plugins : plugins_){
-        for (auto& [_, desc] : plugins){
-            pluginSet.insert(desc);
-        }
-    }
-    std::vector<PluginDesc::const_ptr> plugins;
-    plugins.reserve(pluginSet.size());
-    for (auto& plugin : pluginSet){
-        plugins.push_back(plugin);
+PluginDesc::const_ptr PluginDictionary::findPlugin(const std::string& key) const {
+    if (dirty_.load(std::memory_order_acquire)) {
+        // unpublished updates
+        std::shared_lock lock(mutex_);
+        return doFindPlugin(plugins_, key);
     }
-    return plugins;
+    return snapshot()->findPlugin(key);
+}
+
+std::vector<PluginDesc::const_ptr> PluginDictionary::pluginList() const {
+    return snapshot()->pluginList();
+}
+
+void PluginDictionary::query(const PluginQuery& q, const QueryCallback& fn) const {
+    snapshot()->query(q, fn);
+}
+
+std::vector<PluginDesc::const_ptr> PluginDictionary::query(const PluginQuery& q, int limit) const {
+    return snapshot()->query(q, limit);
 }
 
 void PluginDictionary::clear() {
@@ -97,37 +458,59 @@ void PluginDictionary::clear() {
         plugins.clear();
     }
     exceptions_.clear();
+    didUpdate();
 }
 
-// PluginDesc.cpp
-bool getLine(std::istream& stream, std::string& line);
-int getCount(const std::string& line);
-
-static double getPluginTimestamp(const std::string& path) {
-    // LOG_DEBUG("getPluginTimestamp: " << path);
-    if (isFile(path)) {
-        return fileTimeLastModified(path);
-    } else {
-        // bundle: find newest timestamp of all contained binaries
-        double timestamp = 0;
-        vst::search(path + "/Contents", [&](auto& path){
-            double t = fileTimeLastModified(path);
-            if (t > timestamp) {
-                timestamp = t;
-            }
-        }, false); // don't filter by extensions (because of macOS)!
-        return timestamp;
-    }
+// there was a breaking change between 0.4 and 0.5
+// (introduction of audio input/output busses)
+static bool isCompatibleVersion(const std::array<int, 3>& version) {
+    return version[0] == VERSION_MAJOR && !(version[0] == 0 && version[1] < 5);
 }
 
 void PluginDictionary::read(const std::string& path, bool update){
-    std::shared_lock lock(mutex_);
-    int versionMajor = 0, versionMinor = 0, versionBugfix = 0;
-    bool outdated = false;
+    std::lock_guard lock(mutex_);
+    // publish all plugins at once; NB: also if we throw halfway through
+    ScopeGuard guard([this](){ didUpdate(); });
+    std::array<int, 3> version = { 0, 0, 0 };
+
+    doReadIndex(path);
 
     double timestamp = fileTimeLastModified(path);
     // LOG_DEBUG("cache file timestamp: " << timestamp);
 
+    bool binary = CacheReader::match(path);
+    bool outdated = binary ? doReadBinary(path, timestamp, version)
+                           : doReadText(path, timestamp, version);
+
+    // make sure that all plugins in the cache file also end up in the probe index
+    for (auto& [_, factory] : factories_) {
+        auto it = index_.find(factory->path());
+        if (it == index_.end() || factory->numPlugins() != it->second.numPlugins) {
+            if (auto entry = makeIndexEntry(*factory, nullptr)) {
+                index_[factory->path()] = std::move(*entry);
+                outdated = true;
+            }
+        }
+    }
+    if (update && outdated){
+        // overwrite file
+        try {
+            doWrite(path, binary ? CacheFormat::Binary : CacheFormat::Text, false);
+        } catch (const Error& e){
+            throw Error("couldn't update cache file: " + std::string(e.what()));
+        }
+        LOG_VERBOSE("updated cache file");
+    }
+    LOG_DEBUG("cache file version: v" << version[0]
+              << "." << version[1] << "." << version[2]);
+    // the exception infos are only needed for reading the cache file;
+    // from now on they are stored in the black-list itself.
+    exceptionIndex_.clear();
+}
+
+bool PluginDictionary::doReadText(const std::string& path, double timestamp,
+                                  std::array<int, 3>& version) {
+    bool outdated = false;
     File file(path);
     std::string line;
     while (getLine(file, line)){
@@ -135,17 +518,14 @@ void PluginDictionary::read(const std::string& path, bool update){
             std::getline(file, line);
             char *pos = (char *)line.c_str();
             if (*pos){
-                versionMajor = std::strtol(pos, &pos, 10);
+                version[0] = std::strtol(pos, &pos, 10);
                 if (*pos++ == '.'){
-                    versionMinor = std::strtol(pos, &pos, 10);
+                    version[1] = std::strtol(pos, &pos, 10);
                     if (*pos++ == '.'){
-                        versionBugfix = std::strtol(pos, &pos, 10);
+                        version[2] = std::strtol(pos, &pos, 10);
                     }
                 }
-                // there was a breaking change between 0.4 and 0.5
-                // (introduction of audio input/output busses)
-                if ((versionMajor != VERSION_MAJOR)
-                        || (versionMajor == 0 && versionMinor < 5)){
+                if (!isCompatibleVersion(version)){
                     throw Error(Error::PluginError,
                                 "The plugin cache file is incompatible with this version. "
                                 "Please perform a new search!");
@@ -156,8 +536,8 @@ void PluginDictionary::read(const std::string& path, bool update){
             int numPlugins = getCount(line);
             while (numPlugins--){
                 // read a single plugin description
-                auto plugin = doReadPlugin(file, timestamp, versionMajor,
-                                           versionMinor, versionBugfix);
+                auto plugin = doReadPlugin(file, timestamp, version[0],
+                                           version[1], version[2]);
                 // always collect keys, otherwise reading the cache file
                 // would throw an error if a plugin had been removed
                 std::vector<std::string> keys;
@@ -190,22 +570,7 @@ void PluginDictionary::read(const std::string& path, bool update){
             std::getline(file, line);
             int numExceptions = getCount(line);
             while (numExceptions-- && std::getline(file, line)){
-                // check if plugin has been changed or removed
-                if (pathExists(line)) {
-                    try {
-                        auto t = getPluginTimestamp(line);
-                        if (t < timestamp) {
-                            exceptions_.insert(line);
-                        } else {
-                            LOG_VERBOSE("black-listed plugin " << line << " has changed");
-                            outdated = true;
-                        }
-                    } catch (const Error& e) {
-                        LOG_ERROR("could not get timestamp for " << line << ": " << e.what());
-                        outdated = true;
-                    }
-                } else {
-                    LOG_VERBOSE("black-listed plugin " << line << " has been removed");
+                if (!doAddException(line, timestamp)) {
                     outdated = true;
                 }
             }
@@ -213,22 +578,85 @@ void PluginDictionary::read(const std::string& path, bool update){
             throw Error("bad data: " + line);
         }
     }
-    if (update && outdated){
-        // overwrite file
-        file.close();
+    return outdated;
+}
+
+bool PluginDictionary::doReadBinary(const std::string& path, double timestamp,
+                                    std::array<int, 3>& version) {
+    bool outdated = false;
+    CacheReader reader(path); // throws on failure
+    version = reader.version();
+    if (!isCompatibleVersion(version)){
+        throw Error(Error::PluginError,
+                    "The plugin cache file is incompatible with this version. "
+                    "Please perform a new search!");
+    }
+    // exceptions
+    auto exceptions = reader.exceptions();
+    for (uint32_t i = 0; i < exceptions.count; ++i) {
+        if (!doAddException(std::string{reader.string(exceptions.first + i)}, timestamp)) {
+            outdated = true;
+        }
+    }
+    // plugins
+    for (int i = 0; i < reader.numPlugins(); ++i) {
+        auto desc = std::make_shared<PluginDesc>(nullptr);
         try {
-            doWrite(path);
+            desc->deserialize(reader, i);
         } catch (const Error& e){
-            throw Error("couldn't update cache file: " + std::string(e.what()));
+            LOG_ERROR("couldn't deserialize plugin info for '" << desc->name << "': " << e.what());
+            outdated = true;
+            continue;
+        }
+        if (auto plugin = doAddPlugin(std::move(desc), timestamp)) {
+            LOG_DEBUG("read plugin " << plugin->key());
+            // store plugin at keys
+            auto& keys = reader.plugin(i).keys;
+            int index = plugin->bridged() ? BRIDGED : NATIVE;
+            for (uint32_t j = 0; j < keys.count; ++j) {
+                plugins_[index][std::string{reader.string(keys.first + j)}] = plugin;
+            }
+        } else {
+            // plugin has been changed or removed - update the cache
+            outdated = true;
         }
-        LOG_VERBOSE("updated cache file");
     }
-    LOG_DEBUG("cache file version: v" << versionMajor
-              << "." << versionMinor << "." << versionBugfix);
+    return outdated;
+}
+
+bool PluginDictionary::doAddException(const std::string& path, double timestamp) {
+    // check if plugin has been changed or removed
+    if (pathExists(path)) {
+        try {
+            auto t = getPluginTimestamp(path);
+            auto it = exceptionIndex_.find(path);
+            if (it != exceptionIndex_.end()) {
+                // compare with the modification time at the time of failure
+                if (t == it->second.mtime) {
+                    exceptions_[path] = it->second;
+                    return true;
+                }
+            } else if (t < timestamp) {
+                // no exception info (e.g. older probe index)
+                ExceptionInfo info;
+                info.time = timestamp;
+                info.mtime = t;
+                exceptions_[path] = info;
+                return true;
+            }
+            LOG_VERBOSE("black-listed plugin " << path << " has changed");
+        } catch (const Error& e) {
+            LOG_ERROR("could not get timestamp for " << path << ": " << e.what());
+        }
+    } else {
+        LOG_VERBOSE("black-listed plugin " << path << " has been removed");
+    }
+    return false;
 }
 
 PluginDesc::const_ptr PluginDictionary::readPlugin(std::istream& stream){
     std::lock_guard lock(mutex_);
+    ScopeGuard guard([this](){ didUpdate(); });
     return doReadPlugin(stream, -1, VERSION_MAJOR,
                         VERSION_MINOR, VERSION_PATCH);
 }
@@ -243,7 +671,10 @@ PluginDesc::const_ptr PluginDictionary::doReadPlugin(std::istream& stream, doubl
         LOG_ERROR("couldn't deserialize plugin info for '" << desc->name << "': " << e.what());
         return nullptr;
     }
+    return doAddPlugin(std::move(desc), timestamp);
+}
 
+PluginDesc::const_ptr PluginDictionary::doAddPlugin(PluginDesc::ptr desc, double timestamp) {
     // check if the plugin has been removed or changed since the last cache file update
     if (!pathExists(desc->path())) {
         LOG_WARNING("plugin " << desc->path() << " has been removed");
@@ -288,16 +719,13 @@ PluginDesc::const_ptr PluginDictionary::doReadPlugin(std::istream& stream, doubl
     return desc;
 }
 
-void PluginDictionary::write(const std::string &path) const {
+void PluginDictionary::write(const std::string &path, CacheFormat format) const {
     std::lock_guard lock(mutex_);
-    doWrite(path);
+    doWrite(path, format, true);
 }
 
-void PluginDictionary::doWrite(const std::string& path) const {
-    File file(path, File::WRITE);
-    if (!file.is_open()){
-        throw Error("couldn't create file " + path);
-    }
+std::unordered_map<PluginDesc::const_ptr, std::vector<std::string>>
+PluginDictionary::getPluginKeys() const {
     // inverse mapping (plugin -> keys)
     std::unordered_map<PluginDesc::const_ptr, std::vector<std::string>> pluginMap;
     for (auto& plugins : plugins_) {
@@ -305,6 +733,31 @@ void PluginDictionary::doWrite(const std::string& path) const {
             pluginMap[value].push_back(key);
         }
     }
+    for (auto& [_, keys] : pluginMap) {
+        // sort by length, so that the short key comes first
+        std::sort(keys.begin(), keys.end(),
+                  [](auto& a, auto& b) { return a.size() < b.size(); });
+    }
+    return pluginMap;
+}
+
+void PluginDictionary::doWrite(const std::string& path, CacheFormat format, bool prune) const {
+    if (format == CacheFormat::Binary) {
+        doWriteBinary(path);
+    } else {
+        doWriteText(path);
+    }
+    LOG_DEBUG("wrote cache file: " << path);
+
+    doWriteIndex(path, prune);
+}
+
+void PluginDictionary::doWriteText(const std::string& path) const {
+    File file(path, File::WRITE);
+    if (!file.is_open()){
+        throw Error("couldn't create file " + path);
+    }
+    auto pluginMap = getPluginKeys();
     // write version number
     file << "[version]\n";
     file << VERSION_MAJOR << "." << VERSION_MINOR << "." << VERSION_PATCH << "\n";
@@ -313,26 +766,462 @@ void PluginDictionary::doWrite(const std::string& path) const {
     // otherwise we might get swallowed if a plugin desc is broken.
     file << "[ignore]\n";
     file << "n=" << exceptions_.size() << "\n";
-    for (auto& e : exceptions_){
-        file << e << "\n";
+    for (auto& [path, _] : exceptions_){
+        file << path << "\n";
     }
     // serialize plugins
-    file << "[plugins]\n";
-    file << "n=" << pluginMap.size() << "\n";
+    std::stringstream ss;
+    int numPlugins = 0;
     for (auto& [desc, keys] : pluginMap){
         // serialize plugin info
-        desc->serialize(file);
+        try {
+            desc->serialize(ss);
+        } catch (const Error& e) {
+            // the plugin has been removed from the old cache file
+            LOG_WARNING(e.what());
+            continue;
+        }
         // serialize keys
-        file << "[keys]\n";
-        file << "n=" << keys.size() << "\n";
-        // sort by length, so that the short key comes first
-        std::sort(keys.begin(), keys.end(),
-                  [](auto& a, auto& b) { return a.size() < b.size(); });
+        ss << "[keys]\n";
+        ss << "n=" << keys.size() << "\n";
         for (auto& key : keys){
-            file << key << "\n";
+            ss << key << "\n";
         }
+        numPlugins++;
+    }
+    file << "[plugins]\n";
+    file << "n=" << numPlugins << "\n";
+    file << ss.rdbuf();
+}
+
+void PluginDictionary::doWriteBinary(const std::string& path) const {
+    CacheWriter writer;
+    auto pluginMap = getPluginKeys();
+    std::vector<PluginDesc::const_ptr> written;
+    written.reserve(pluginMap.size());
+    for (auto& [desc, keys] : pluginMap) {
+        try {
+            desc->serialize(writer, keys);
+            written.push_back(desc);
+        } catch (const Error& e) {
+            // the plugin has been removed from the old cache file
+            LOG_WARNING(e.what());
+        }
+    }
+    std::vector<std::string> exceptions;
+    exceptions.reserve(exceptions_.size());
+    for (auto& [path, _] : exceptions_) {
+        exceptions.push_back(path);
+    }
+    // Write to a temporary file and then replace the actual cache file,
+    // so that other processes never see a partially written cache file.
+    auto tmpPath = path + ".tmp";
+    writer.write(tmpPath, exceptions);
+    if (!renameFile(tmpPath, path)) {
+        removeFile(tmpPath);
+        throw Error("couldn't replace cache file " + path);
+    }
+    // plugins without tables must load them from the new cache file
+    int index = 0;
+    for (auto& desc : written) {
+        desc->updateCacheSource(path, index++);
+    }
+}
+
+/*////////////////////////// probe index ///////////////////////////*/
+
+// The probe index maps plugin binaries to their plugin descriptions.
+// Unlike the cache file, it identifies binaries by size, timestamp and
+// content hash, so we can also find plugins which have been moved or renamed.
+// It is not cleared by clear(), so an incremental search can skip probing for
+// all unchanged plugins even after the cache file has been removed.
+
+static std::string getIndexPath(const std::string& cachePath) {
+    auto ext = fileExtension(cachePath);
+    return cachePath.substr(0, cachePath.size() - ext.size()) + ".index";
+}
+
+// only hash the beginning and the end of each binary.
+// This is cheap and good enough to tell if a binary has been replaced.
+#define INDEX_HASH_CHUNK_SIZE 65536
+
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+    // FNV-1a
+    auto bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static bool hashFile(const std::string& path, uint64_t& hash, uint64_t& size) {
+    File file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.seekg(0, std::ios_base::end);
+    size = file.tellg();
+    hash = hashBytes(hash, &size, sizeof(size));
+    std::vector<char> buffer(INDEX_HASH_CHUNK_SIZE);
+    auto hashChunk = [&](uint64_t offset) {
+        auto n = std::min<uint64_t>(size - offset, buffer.size());
+        file.seekg(offset);
+        file.read(buffer.data(), n);
+        hash = hashBytes(hash, buffer.data(), file.gcount());
+    };
+    hashChunk(0);
+    if (size > buffer.size()) {
+        hashChunk(std::max<uint64_t>(size - buffer.size(), buffer.size()));
+    }
+    return true;
+}
+
+bool PluginDictionary::getFileInfo(const std::string& path, FileInfo& info, bool hash) {
+    try {
+        if (isFile(path)) {
+            info.timestamp = fileTimeLastModified(path);
+            info.hash = 0xcbf29ce484222325ull;
+            if (hash) {
+                return hashFile(path, info.hash, info.size);
+            } else {
+                File file(path);
+                file.seekg(0, std::ios_base::end);
+                info.size = file.tellg();
+                return file.good();
+            }
+        } else {
+            // bundle: hash all contained binaries in a deterministic order
+            std::vector<std::string> files;
+            vst::search(path + "/Contents", [&](auto& path){
+                files.push_back(path);
+            }, false); // don't filter by extensions (because of macOS)!
+            std::sort(files.begin(), files.end());
+            info = FileInfo{};
+            info.hash = 0xcbf29ce484222325ull;
+            for (auto& f : files) {
+                info.timestamp = std::max<double>(info.timestamp, fileTimeLastModified(f));
+                uint64_t size = 0;
+                if (hash) {
+                    // include the path relative to the bundle
+                    auto relPath = f.substr(path.size());
+                    info.hash = hashBytes(info.hash, relPath.data(), relPath.size());
+                    if (!hashFile(f, info.hash, size)) {
+                        return false;
+                    }
+                } else {
+                    File file(f);
+                    file.seekg(0, std::ios_base::end);
+                    size = file.tellg();
+                }
+                info.size += size;
+            }
+            return !files.empty();
+        }
+    } catch (const Error& e) {
+        LOG_DEBUG("couldn't get file info for " << path << ": " << e.what());
+        return false;
+    }
+}
+
+std::unique_ptr<PluginDictionary::IndexEntry> PluginDictionary::makeIndexEntry(
+        const IFactory& factory, const FileInfo* oldInfo) {
+    auto entry = std::make_unique<IndexEntry>();
+    // only compute the hash if the binary has changed
+    if (!getFileInfo(factory.path(), entry->info, false)) {
+        return nullptr;
+    }
+    if (oldInfo && oldInfo->size == entry->info.size
+            && oldInfo->timestamp == entry->info.timestamp) {
+        entry->info.hash = oldInfo->hash;
+    } else if (!getFileInfo(factory.path(), entry->info, true)) {
+        return nullptr;
+    }
+    std::stringstream ss;
+    for (int i = 0; i < factory.numPlugins(); ++i) {
+        factory.getPlugin(i)->serialize(ss);
+    }
+    entry->data = ss.str();
+    entry->numPlugins = factory.numPlugins();
+    entry->version = { VERSION_MAJOR, VERSION_MINOR, VERSION_PATCH };
+    return entry;
+}
+
+static bool parseVersion(const std::string& s, std::array<int, 3>& version) {
+    return sscanf(s.c_str(), "%d.%d.%d", &version[0], &version[1], &version[2]) == 3;
+}
+
+void PluginDictionary::readIndex(const std::string& cachePath) {
+    std::lock_guard lock(mutex_);
+    doReadIndex(cachePath);
+    exceptionIndex_.clear(); // see read()
+}
+
+void PluginDictionary::doReadIndex(const std::string& cachePath) {
+    exceptionIndex_.clear();
+    auto path = getIndexPath(cachePath);
+    if (!pathExists(path)) {
+        return;
+    }
+    File file(path);
+    std::string line;
+    try {
+        // version
+        std::array<int, 3> version;
+        if (!getLine(file, line) || line != "[version]" || !std::getline(file, line)
+                || !parseVersion(line, version)) {
+            throw Error("bad format");
+        }
+        if (!isCompatibleVersion(version)) {
+            LOG_VERBOSE("ignoring probe index of incompatible version " << line);
+            return;
+        }
+        if (!getLine(file, line) || line != "[files]" || !std::getline(file, line)) {
+            throw Error("bad format");
+        }
+        int numFiles = getCount(line);
+        while (numFiles--) {
+            std::string key;
+            IndexEntry entry;
+            int numLines = 0;
+            for (int i = 0; i < 7; ++i) {
+                if (!std::getline(file, line)) {
+                    throw Error("premature end of file");
+                }
+                auto pos = line.find('=');
+                if (pos == std::string::npos) {
+                    throw Error("bad data: " + line);
+                }
+                auto name = line.substr(0, pos);
+                auto value = line.substr(pos + 1);
+                if (name == "path") {
+                    key = value;
+                } else if (name == "size") {
+                    entry.info.size = std::stoull(value);
+                } else if (name == "time") {
+                    entry.info.timestamp = std::stod(value);
+                } else if (name == "hash") {
+                    entry.info.hash = std::stoull(value, nullptr, 16);
+                } else if (name == "version") {
+                    if (!parseVersion(value, entry.version)) {
+                        throw Error("bad version: " + value);
+                    }
+                } else if (name == "plugins") {
+                    entry.numPlugins = std::stol(value);
+                } else if (name == "lines") {
+                    numLines = std::stol(value);
+                } else {
+                    throw Error("unknown key: " + name);
+                }
+            }
+            while (numLines-- && std::getline(file, line)) {
+                entry.data += line;
+                entry.data += "\n";
+            }
+            if (isCompatibleVersion(entry.version)) {
+                index_[key] = std::move(entry);
+            }
+        }
+        // exception infos (optional)
+        if (getLine(file, line) && line == "[ignore]" && std::getline(file, line)) {
+            int numExceptions = getCount(line);
+            while (numExceptions--) {
+                std::string key;
+                ExceptionInfo info;
+                for (int i = 0; i < 5; ++i) {
+                    if (!std::getline(file, line)) {
+                        throw Error("premature end of file");
+                    }
+                    auto pos = line.find('=');
+                    if (pos == std::string::npos) {
+                        throw Error("bad data: " + line);
+                    }
+                    auto name = line.substr(0, pos);
+                    auto value = line.substr(pos + 1);
+                    if (name == "path") {
+                        key = value;
+                    } else if (name == "code") {
+                        info.code = (Error::ErrorCode)std::stol(value);
+                    } else if (name == "time") {
+                        info.time = std::stod(value);
+                    } else if (name == "mtime") {
+                        info.mtime = std::stod(value);
+                    } else if (name == "retries") {
+                        info.retries = std::stol(value);
+                    } else {
+                        throw Error("unknown key: " + name);
+                    }
+                }
+                exceptionIndex_[key] = info;
+            }
+        }
+        // CPU architectures (optional), see getPluginCpuArchitectures()
+        if (getLine(file, line) && line == "[archs]" && std::getline(file, line)) {
+            int numArchs = getCount(line);
+            while (numArchs--) {
+                CpuArchInfo info;
+                for (int i = 0; i < 3; ++i) {
+                    if (!std::getline(file, line)) {
+                        throw Error("premature end of file");
+                    }
+                    auto pos = line.find('=');
+                    if (pos == std::string::npos) {
+                        throw Error("bad data: " + line);
+                    }
+                    auto name = line.substr(0, pos);
+                    auto value = line.substr(pos + 1);
+                    if (name == "path") {
+                        info.path = value;
+                    } else if (name == "time") {
+                        info.timestamp = std::stod(value);
+                    } else if (name == "archs") {
+                        std::stringstream ss(value);
+                        std::string arch;
+                        while (ss >> arch) {
+                            info.archs.push_back(cpuArchFromString(arch));
+                        }
+                    } else {
+                        throw Error("unknown key: " + name);
+                    }
+                }
+                addCpuArchitectureCache(info);
+            }
+        }
+        LOG_DEBUG("read probe index: " << path);
+    } catch (const std::exception& e) {
+        // the index is only an optimization, so we don't throw
+        LOG_ERROR("couldn't read probe index " << path << ": " << e.what());
+    }
+}
+
+void PluginDictionary::doWriteIndex(const std::string& cachePath, bool prune) const {
+    auto path = getIndexPath(cachePath);
+    File file(path, File::WRITE);
+    if (!file.is_open()){
+        LOG_ERROR("couldn't create file " << path);
+        return;
+    }
+    std::vector<const std::pair<const std::string, IndexEntry> *> entries;
+    for (auto& entry : index_) {
+        // skip plugins which have been removed, unless we are only updating
+        // the cache file in read(); the plugin might have just been moved.
+        if (!prune || pathExists(entry.first)) {
+            entries.push_back(&entry);
+        }
+    }
+    file << "[version]\n";
+    file << VERSION_MAJOR << "." << VERSION_MINOR << "." << VERSION_PATCH << "\n";
+    file << "[files]\n";
+    file << "n=" << entries.size() << "\n";
+    file.precision(17); // timestamps must round-trip!
+    for (auto& e : entries) {
+        auto& [key, entry] = *e;
+        file << "path=" << key << "\n";
+        file << "size=" << entry.info.size << "\n";
+        file << "time=" << entry.info.timestamp << "\n";
+        file << "hash=" << std::hex << entry.info.hash << std::dec << "\n";
+        file << "version=" << entry.version[0] << "." << entry.version[1]
+             << "." << entry.version[2] << "\n";
+        file << "plugins=" << entry.numPlugins << "\n";
+        file << "lines=" << std::count(entry.data.begin(), entry.data.end(), '\n') << "\n";
+        file << entry.data;
+    }
+    // The cache file only contains the paths of black-listed modules,
+    // so we store the remaining information here.
+    file << "[ignore]\n";
+    file << "n=" << exceptions_.size() << "\n";
+    for (auto& [key, info] : exceptions_) {
+        file << "path=" << key << "\n";
+        file << "code=" << (int)info.code << "\n";
+        file << "time=" << info.time << "\n";
+        file << "mtime=" << info.mtime << "\n";
+        file << "retries=" << info.retries << "\n";
+    }
+    // Also store the CPU architectures of all plugin binaries we have seen,
+    // so PluginFactory doesn't have to open them again in the next session.
+    std::vector<CpuArchInfo> archs;
+    for (auto& info : getCpuArchitectureCache()) {
+        if (!prune || pathExists(info.path)) {
+            archs.push_back(std::move(info));
+        }
+    }
+    file << "[archs]\n";
+    file << "n=" << archs.size() << "\n";
+    for (auto& info : archs) {
+        file << "path=" << info.path << "\n";
+        file << "time=" << info.timestamp << "\n";
+        file << "archs=";
+        for (size_t i = 0; i < info.archs.size(); ++i) {
+            if (i > 0) {
+                file << " ";
+            }
+            file << cpuArchToString(info.archs[i]);
+        }
+        file << "\n";
+    }
+    LOG_DEBUG("wrote probe index: " << path);
+}
+
+IFactory::ptr PluginDictionary::restoreFactory(const std::string& path) {
+    FileInfo info;
+    if (!getFileInfo(path, info, false)) {
+        return nullptr;
+    }
+    std::string oldPath;
+    IndexEntry entry;
+    {
+        std::shared_lock lock(mutex_);
+        auto it = index_.find(path);
+        if (it != index_.end() && it->second.info.size == info.size
+                && it->second.info.timestamp == info.timestamp) {
+            oldPath = it->first;
+            entry = it->second;
+        }
+    }
+    if (oldPath.empty()) {
+        // the binary has been changed, moved or renamed; compare the content hash.
+        if (!getFileInfo(path, info, true)) {
+            return nullptr;
+        }
+        std::shared_lock lock(mutex_);
+        for (auto& [key, value] : index_) {
+            if (value.info.size == info.size && value.info.hash == info.hash) {
+                LOG_DEBUG("found " << path << " in probe index as " << key);
+                oldPath = key;
+                entry = value;
+                break;
+            }
+        }
+        if (oldPath.empty()) {
+            return nullptr;
+        }
+    }
+    if (entry.numPlugins <= 0) {
+        return nullptr;
+    }
+    try {
+        // fix plugin paths if the binary has been moved
+        if (oldPath != path) {
+            std::string from = "path=" + oldPath + "\n";
+            std::string to = "path=" + path + "\n";
+            for (auto pos = entry.data.find(from); pos != std::string::npos;
+                 pos = entry.data.find(from, pos + to.size())) {
+                entry.data.replace(pos, from.size(), to);
+            }
+        }
+        auto factory = IFactory::load(path);
+        std::stringstream ss(entry.data);
+        for (int i = 0; i < entry.numPlugins; ++i) {
+            auto desc = std::make_shared<PluginDesc>(nullptr);
+            desc->deserialize(ss, entry.version[0], entry.version[1], entry.version[2]);
+            desc->setFactory(factory);
+            factory->addPlugin(desc);
+        }
+        return factory;
+    } catch (const Error& e) {
+        LOG_DEBUG("couldn't restore " << path << " from probe index: " << e.what());
+        return nullptr;
     }
-    LOG_DEBUG("wrote cache file: " << path);
 }
 
 } // vst
@@ -5,49 +5,221 @@
 #include "Sync.h"
 
 #include <array>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
 #include <unordered_map>
 #include <unordered_set>
 
+// Black-listed modules which have timed out are probed again
+// (with a longer timeout) up to this many times.
+#ifndef PROBE_MAX_RETRIES
+#define PROBE_MAX_RETRIES 2
+#endif
+
+// the timeout multiplier for retries, see PluginDictionary::retryException()
+#ifndef PROBE_RETRY_TIMEOUT_FACTOR
+#define PROBE_RETRY_TIMEOUT_FACTOR 4
+#endif
+
 namespace vst {
 
+// query for PluginDictionary::query(); all fields are optional
+// and all string comparisons are case-insensitive.
+struct PluginQuery {
+    enum Match {
+        Prefix, // the plugin name starts with 'name'
+        Fuzzy, // the plugin name contains all characters of 'name' in order
+        Exact
+    };
+    std::string name;
+    Match match = Prefix;
+    std::string vendor;
+    std::string category; // a single (sub)category, e.g. "Delay" matches "Fx|Delay"
+    std::optional<PluginType> type;
+};
+
 // thread-safe dictionary for VST plugins (factories and descriptions)
 
 class PluginDictionary {
  public:
-    PluginDictionary() = default;
+    enum class CacheFormat {
+        Text, // human readable, see PluginDesc::serialize()
+        Binary // memory mapped, see PluginCache.h
+    };
+
+    using QueryCallback = std::function<bool(const PluginDesc::const_ptr&)>;
+
+    // a black-listed module, see addException()
+    struct ExceptionInfo {
+        Error::ErrorCode code = Error::UnknownError;
+        double time = 0; // when the module has been black-listed (seconds since the epoch)
+        double mtime = 0; // the (newest) modification time of the module binary at that point
+        int retries = 0; // number of consecutive timeouts - 1
+    };
+
+    // What to do with a black-listed module on a rescan
+    enum class Retry {
+        Skip, // the module has failed and hasn't changed since
+        Now, // the module has changed; probe it again
+        Later // the module has timed out; probe it again after the search (with a longer timeout)
+    };
+
+    // An immutable view of the dictionary. Holding a snapshot keeps all of its
+    // factories and plugin descriptions alive, but it doesn't see any later updates.
+    class Snapshot {
+     public:
+        using ptr = std::shared_ptr<const Snapshot>;
+
+        IFactory::const_ptr findFactory(const std::string& path) const;
+        bool isException(const std::string& path) const;
+        // returns nullptr if the module is not black-listed
+        const ExceptionInfo * findException(const std::string& path) const;
+        PluginDesc::const_ptr findPlugin(const std::string& key) const;
+        // all unique plugins (in no particular order)
+        const std::vector<PluginDesc::const_ptr>& pluginList() const { return pluginList_; }
+        // Call 'fn' for every unique plugin which matches the query, sorted by name.
+        // Return false to stop early, e.g. after a certain number of results.
+        void query(const PluginQuery& q, const QueryCallback& fn) const;
+        // limit = 0 -> all results
+        std::vector<PluginDesc::const_ptr> query(const PluginQuery& q, int limit = 0) const;
+     private:
+        friend class PluginDictionary;
+        void buildIndex();
+
+        std::unordered_map<std::string, IFactory::ptr> factories_;
+        std::array<std::unordered_map<std::string, PluginDesc::const_ptr>, 2> plugins_;
+        std::unordered_map<std::string, ExceptionInfo> exceptions_;
+        std::vector<PluginDesc::const_ptr> pluginList_;
+        // query indexes
+        using NameIndex = std::multimap<std::string, PluginDesc::const_ptr>; // lower case name
+        using IndexBucket = std::vector<NameIndex::const_iterator>; // sorted by name
+        NameIndex nameIndex_;
+        std::unordered_map<std::string, IndexBucket> vendorIndex_; // lower case vendor
+        std::unordered_map<std::string, IndexBucket> categoryIndex_; // lower case (sub)category
+        std::array<IndexBucket, 2> typeIndex_; // VST2, VST3
+    };
+
+    PluginDictionary();
     PluginDictionary(const PluginDictionary&) = delete;
     PluginDictionary(PluginDictionary&&) = delete;
 
+    // Get the current snapshot. This never blocks, but it doesn't contain
+    // updates of an unfinished batch, see beginUpdate().
+    Snapshot::ptr snapshot() const;
+    // Every write method publishes a new snapshot before it returns. To avoid
+    // rebuilding the snapshot for every single update, e.g. during a plugin
+    // search, group the updates into a batch. The snapshot is then published
+    // once the (outermost) batch is committed. Batches may be nested and may
+    // be used from several threads at the same time.
+    // While a batch is open, findFactory(), isException(), findException() and
+    // findPlugin() take the (shared) lock and see all updates immediately;
+    // pluginList() and query() only see the latest snapshot.
+    void beginUpdate();
+    void commitUpdate();
+    // RAII helper for beginUpdate()/commitUpdate()
+    class UpdateScope {
+     public:
+        UpdateScope(PluginDictionary& dict)
+            : dict_(dict) { dict_.beginUpdate(); }
+        ~UpdateScope() { dict_.commitUpdate(); }
+        UpdateScope(const UpdateScope&) = delete;
+        UpdateScope& operator=(const UpdateScope&) = delete;
+     private:
+        PluginDictionary& dict_;
+    };
     // factories
     void addFactory(const std::string& path, IFactory::ptr factory);
     IFactory::const_ptr findFactory(const std::string& path) const;
     // black-listed modules
-    void addException(const std::string& path);
+    // 'code' is the reason why the module has failed, typically the error code
+    // of the (last) probe result. Does file I/O, so don't call this on the RT thread.
+    void addException(const std::string& path, Error::ErrorCode code = Error::UnknownError);
     bool isException(const std::string& path) const;
+    std::optional<ExceptionInfo> findException(const std::string& path) const;
+    // The retry policy for black-listed modules. Modules which have failed are
+    // skipped until they change. Modules which have timed out are probed again
+    // after the search with a timeout multiplied by PROBE_RETRY_TIMEOUT_FACTOR,
+    // at most PROBE_MAX_RETRIES times. Does file I/O (to check if the module has changed).
+    Retry retryException(const std::string& path) const;
     // plugin descriptions
     void addPlugin(const std::string& key, PluginDesc::const_ptr plugin);
     PluginDesc::const_ptr findPlugin(const std::string& key) const;
     std::vector<PluginDesc::const_ptr> pluginList() const;
+    // see Snapshot::query()
+    void query(const PluginQuery& q, const QueryCallback& fn) const;
+    std::vector<PluginDesc::const_ptr> query(const PluginQuery& q, int limit = 0) const;
     // remove factories and plugin descriptions
+    // NB: this does not clear the probe index, see restoreFactory().
     void clear();
     // (de)serialize
     // throws an Error exception on failure!
+    // read() detects the format automatically; if the cache file is updated,
+    // it keeps its original format.
     void read(const std::string& path, bool update = true);
-    void write(const std::string& path) const;
+    void write(const std::string& path, CacheFormat format = CacheFormat::Binary) const;
     // read a single plugin description
     PluginDesc::const_ptr readPlugin(std::istream& stream);
+    // For incremental searches: if the plugin binary is in the probe index and
+    // hasn't changed - or has only been moved or renamed - return a new factory
+    // with the indexed plugin descriptions, so we don't have to probe it again.
+    // Returns nullptr otherwise.
+    IFactory::ptr restoreFactory(const std::string& path);
+    // The probe index is stored next to the cache file and read/written
+    // together with it. Use this method to read the index if the cache file
+    // itself does not exist, e.g. because it has been deleted.
+    void readIndex(const std::string& cachePath);
  private:
-    PluginDesc::const_ptr doReadPlugin(std::istream& stream, double timestamp,
-                                       int versionMajor, int versionMinor, int versionPatch);
-    void doWrite(const std::string& path) const;
-    std::unordered_map<std::string, IFactory::ptr> factories_;
     enum {
         NATIVE = 0,
         BRIDGED = 1
     };
-    std::array<std::unordered_map<std::string, PluginDesc::const_ptr>, 2> plugins_;
-    std::unordered_set<std::string> exceptions_;
+    bool doReadText(const std::string& path, double timestamp, std::array<int, 3>& version);
+    bool doReadBinary(const std::string& path, double timestamp, std::array<int, 3>& version);
+    PluginDesc::const_ptr doReadPlugin(std::istream& stream, double timestamp,
+                                       int versionMajor, int versionMinor, int versionPatch);
+    PluginDesc::const_ptr doAddPlugin(PluginDesc::ptr desc, double timestamp);
+    bool doAddException(const std::string& path, double timestamp);
+    // call after every update (with the exclusive lock)
+    void didUpdate();
+    void doPublish();
+    using PluginMap = std::array<std::unordered_map<std::string, PluginDesc::const_ptr>, 2>;
+    static PluginDesc::const_ptr doFindPlugin(const PluginMap& plugins, const std::string& key);
+    void doWrite(const std::string& path, CacheFormat format, bool prune) const;
+    void doWriteText(const std::string& path) const;
+    void doWriteBinary(const std::string& path) const;
+    std::unordered_map<PluginDesc::const_ptr, std::vector<std::string>> getPluginKeys() const;
+    // probe index
+    struct FileInfo {
+        uint64_t size = 0;
+        double timestamp = 0;
+        uint64_t hash = 0; // content hash
+    };
+    struct IndexEntry {
+        FileInfo info;
+        std::string data; // serialized plugin descriptions
+        int numPlugins = 0;
+        std::array<int, 3> version; // version of the serialized data
+    };
+    static bool getFileInfo(const std::string& path, FileInfo& info, bool hash);
+    static std::unique_ptr<IndexEntry> makeIndexEntry(const IFactory& factory,
+                                                      const FileInfo* oldInfo);
+    void doReadIndex(const std::string& path);
+    void doWriteIndex(const std::string& path, bool prune) const;
+    std::unordered_map<std::string, IFactory::ptr> factories_;
+    PluginMap plugins_;
+    std::unordered_map<std::string, ExceptionInfo> exceptions_;
+    std::unordered_map<std::string, IndexEntry> index_;
+    // exception infos from the probe index; only used while reading the cache file
+    std::unordered_map<std::string, ExceptionInfo> exceptionIndex_;
     mutable SharedMutex mutex_;
+    // the current snapshot; only accessed with std::atomic_load/atomic_store
+    Snapshot::ptr snapshot_;
+    // there are updates which haven't been published yet
+    std::atomic<bool> dirty_{false};
+    int updateDepth_ = 0; // see beginUpdate()
 };
 
 } // vst
@@ -1,4 +1,5 @@
 #include "PluginFactory.h"
+#include "ProbeWorker.h"
 
 #include "Log.h"
 #include "FileUtils.h"
@@ -27,9 +28,14 @@
 #include <thread>
 #include <algorithm>
 #include <sstream>
+#include <iterator>
+#include <tuple>
 
 namespace vst {
 
+// PluginDesc.cpp
+bool getLine(std::istream& stream, std::string& line);
+
 /*///////////////////// IFactory ////////////////////////*/
 
 IFactory::ptr IFactory::load(const std::string& path, bool probe){
@@ -108,6 +114,9 @@ PluginFactory::PluginFactory(const std::string &path)
 ProbeFuture PluginFactory::probeAsync(float timeout, bool nonblocking) {
     plugins_.clear();
     pluginMap_.clear();
+#if PROBE_SINGLE_PASS
+    return doProbeAll(timeout, nonblocking);
+#else
     return [this, self = shared_from_this(), timeout,
             f = doProbePlugin(timeout, nonblocking)]
             (ProbeCallback callback) {
@@ -135,6 +144,7 @@ ProbeFuture PluginFactory::probeAsync(float timeout, bool nonblocking) {
             return false;
         }
     };
+#endif
 }
 
 void PluginFactory::addPlugin(PluginDesc::ptr desc){
@@ -165,85 +175,102 @@ int PluginFactory::numPlugins() const {
     return plugins_.size();
 }
 
+// get the error message of a failed probe process (exit code EXIT_FAILURE),
+// see ProbeWorker::probeError()
+static Error readProbeError(const std::string& data) {
+    if (!data.empty()) {
+        std::stringstream ss(data);
+        int err;
+        std::string msg;
+        ss >> err;
+        if (ss){
+            std::getline(ss, msg); // skip newline
+            std::getline(ss, msg); // read message
+        } else {
+            err = (int)Error::UnknownError;
+            msg = "(uncaught exception)";
+        }
+        LOG_DEBUG("code: " << err << ", msg: " << msg);
+        return Error((Error::ErrorCode)err, msg);
+    } else {
+        // happens in certain cases, e.g. the plugin destructor
+        // terminates the probe process with exit code 1.
+        return Error(Error::UnknownError, "(uncaught exception)");
+    }
+}
+
 PluginFactory::ProbeResultFuture PluginFactory::doProbePlugin(float timeout, bool nonblocking){
     return doProbePlugin(PluginDesc::SubPlugin { "", -1 }, timeout, nonblocking);
 }
 
-// probe a plugin in a seperate process and return the info in a file
+// probe a plugin in a seperate process; the info is sent back through the reply pipe
 PluginFactory::ProbeResultFuture PluginFactory::doProbePlugin(
         const PluginDesc::SubPlugin& sub, float timeout, bool nonblocking)
 {
     auto desc = std::make_shared<PluginDesc>(shared_from_this());
     desc->name = sub.name; // necessary for error reporting, will be overriden later
-    // create temp file path
-    std::stringstream ss;
-    // desc address should be unique as long as PluginDesc instances are retained.
-    ss << getTmpDirectory() << "/vst_" << desc.get();
-    std::string tmpPath = ss.str();
 
-    auto app = IHostApp::get(arch_);
-    if (!app) {
-        // shouldn't happen
-        throw Error(Error::SystemError, "couldn't get host app");
-    }
-    auto process = app->probe(path_, sub.id, tmpPath);
-    // NB: std::function doesn't allow move-only types in a lambda capture,
-    // so we have to wrap ProcessHandle in a std::shared_ptr...
+    // reuse a probe process if possible
+    auto worker = ProbeWorkerPool::instance().acquire(arch_);
+    worker->request(path_, sub.id);
     return [desc=std::move(desc),
-            tmpPath=std::move(tmpPath),
-            process=std::make_shared<ProcessHandle>(std::move(process)),
+            worker=std::move(worker),
             timeout, nonblocking,
             start=std::chrono::system_clock::now()]
             (ProbeResult& result) {
         result.plugin = desc;
         result.total = 1;
-        // wait for process to finish
+        // wait for probe result
         int exitCode = -1;
         try {
             if (nonblocking) {
-                auto [done, code] = process->tryWait(0);
+                auto [done, code] = worker->tryWait(0);
                 if (!done) {
                     if (timeout > 0) {
                         using seconds = std::chrono::duration<double>;
                         auto now = std::chrono::system_clock::now();
                         auto elapsed = std::chrono::duration_cast<seconds>(now - start).count();
                         if (elapsed > timeout) {
-                            if (process->terminate()) {
+                            if (worker->terminate()) {
                                 LOG_DEBUG("terminated hanging subprocess");
                             }
                             std::stringstream msg;
                             msg << "subprocess timed out after " << timeout << " seconds!";
-                            throw Error(Error::SystemError, msg.str());
+                            throw Error(Error::Timeout, msg.str());
                         }
                     }
                     return false;
                 }
                 exitCode = code;
             } else if (timeout > 0) {
-                auto [done, code] = process->tryWait(timeout);
+                auto [done, code] = worker->tryWait(timeout);
                 if (!done) {
-                    if (process->terminate()) {
+                    if (worker->terminate()) {
                         LOG_DEBUG("terminated hanging subprocess");
                     }
                     std::stringstream msg;
                     msg << "subprocess timed out after " << timeout << " seconds!";
-                    throw Error(Error::SystemError, msg.str());
+                    throw Error(Error::Timeout, msg.str());
                 }
                 exitCode = code;
             } else {
-                exitCode = process->wait();
+                exitCode = worker->tryWait(-1).second;
             }
         } catch (const Error& e){
             result.error = e;
             return true;
         }
+        auto data = worker->takeData();
+        auto error = worker->probeError();
+        // the worker can probe the next plugin (unless it has died)
+        ProbeWorkerPool::instance().recycle(worker);
         /// LOG_DEBUG("return code: " << ret);
-        TmpFile file(tmpPath); // removes the file on destruction
         if (exitCode == EXIT_SUCCESS) {
-            // get info from temp file
-            if (file.is_open()) {
+            // get info
+            if (!data.empty()) {
                 try {
-                    desc->deserialize(file);
+                    std::stringstream ss(data);
+                    desc->deserialize(ss);
                 } catch (const Error& e) {
                     result.error = e;
                 }
@@ -251,42 +278,24 @@ PluginFactory::ProbeResultFuture PluginFactory::doProbePlugin(
             #if USE_WINE
                 // On Wine, the child process (wine) might exit with 0
                 // even though the grandchild (= host) has crashed.
-                // The missing temp file is the only indicator we have...
+                // The missing probe data is the only indicator we have...
                 if (desc->arch() == CpuArch::pe_amd64 || desc->arch() == CpuArch::pe_i386){
                 #if 1
                     result.error = Error(Error::SystemError,
-                                         "couldn't read temp file (plugin crashed?)");
+                                         "no probe data (plugin crashed?)");
                 #else
                     result.error = Error(Error::Crash);
                 #endif
                 } else
             #endif
                 {
-                    result.error = Error(Error::SystemError, "couldn't read temp file!");
+                    result.error = Error(Error::SystemError, "no probe data!");
                 }
             }
         } else if (exitCode == EXIT_FAILURE) {
-            // get error from temp file
-            if (file.is_open()) {
-                int err;
-                std::string msg;
-                file >> err;
-                if (file){
-                    std::getline(file, msg); // skip newline
-                    std::getline(file, msg); // read message
-                } else {
-                    // happens in certain cases, e.g. the plugin destructor
-                    // terminates the probe process with exit code 1.
-                    err = (int)Error::UnknownError;
-                    msg = "(uncaught exception)";
-                }
-                LOG_DEBUG("code: " << err << ", msg: " << msg);
-                result.error = Error((Error::ErrorCode)err, msg);
-            } else {
-                result.error = Error(Error::UnknownError, "(uncaught exception)");
-            }
+            result.error = readProbeError(error);
         } else {
-            // ignore temp file
+            // ignore probe data
             result.error = Error(Error::Crash);
         }
         return true;
@@ -344,4 +353,225 @@ std::vector<PluginDesc::ptr> PluginFactory::doProbePlugins(
     return results;
 }
 
+// Probe the factory and all its sub-plugins in a single subprocess.
+// The subprocess sends the results one after another, see probeSubPlugins()
+// in host.cpp, so we can report them while it is still running. Each record
+// is terminated by an "[end]" line; the first record contains the factory
+// (or the plugin itself), the following records contain the result of a
+// single sub-plugin.
+// If the subprocess crashes or hangs (the timeout applies to every single
+// plugin), the offending sub-plugin is reported as an error and the
+// remaining sub-plugins are probed one by one, see doProbePlugins().
+ProbeFuture PluginFactory::doProbeAll(float timeout, bool nonblocking) {
+    auto desc = std::make_shared<PluginDesc>(shared_from_this());
+
+    // reuse a probe process if possible
+    auto worker = ProbeWorkerPool::instance().acquire(arch_);
+    worker->request(path_, PROBE_ALL_SUBPLUGINS);
+
+    return [this, self = shared_from_this(),
+            desc = std::move(desc),
+            worker = std::move(worker),
+            timeout, nonblocking,
+            pending = std::string{}, // incomplete records
+            haveFactory = false,
+            next = 0, // next sub-plugin
+            last = std::chrono::steady_clock::now()]
+            (ProbeCallback callback) mutable {
+        int numPlugins = desc->subPlugins.size();
+
+        auto report = [&](ProbeResult& result) {
+            if (result.valid()) {
+                plugins_.push_back(result.plugin);
+                pluginMap_[result.plugin->name] = result.plugin;
+            }
+            if (callback) {
+                callback(result);
+            }
+        };
+
+        auto readRecord = [&](std::istream& record) {
+            if (!haveFactory) {
+                desc->deserialize(record);
+                haveFactory = true;
+                numPlugins = desc->subPlugins.size();
+                return;
+            }
+            std::string line;
+            int index = -1;
+            int err = 0;
+            std::string msg;
+            while (getLine(record, line)) {
+                if (line == "[result]") {
+                    continue;
+                }
+                auto pos = line.find('=');
+                if (pos == std::string::npos) {
+                    throw Error(Error::SystemError, "bad probe result");
+                }
+                auto key = line.substr(0, pos);
+                auto value = line.substr(pos + 1);
+                try {
+                    if (key == "index") {
+                        index = std::stol(value);
+                    } else if (key == "error") {
+                        err = std::stol(value);
+                    } else if (key == "msg") {
+                        msg = value;
+                    }
+                } catch (const std::exception&) {
+                    throw Error(Error::SystemError, "bad probe result");
+                }
+                if (key == "msg" || (key == "error" && err == 0)) {
+                    break; // the plugin description follows
+                }
+            }
+            if (index < 0 || index >= numPlugins) {
+                throw Error(Error::SystemError, "bad sub-plugin index");
+            }
+            ProbeResult result;
+            result.plugin = std::make_shared<PluginDesc>(self);
+            result.plugin->name = desc->subPlugins[index].name; // for error reporting
+            result.index = index;
+            result.total = numPlugins;
+            if (err == 0) {
+                try {
+                    result.plugin->deserialize(record);
+                } catch (const Error& e) {
+                    result.error = e;
+                }
+            } else {
+                result.error = Error((Error::ErrorCode)err, msg);
+            }
+            next = index + 1;
+            report(result);
+        };
+
+        // read all complete records which have been received so far
+        auto readRecords = [&]() {
+            pending += worker->takeData();
+            size_t pos = 0;
+            size_t end = 0;
+            while ((end = pending.find("[end]\n", end)) != std::string::npos) {
+                // must be at the start of a line!
+                if (end != pos && pending[end - 1] != '\n') {
+                    end++;
+                    continue;
+                }
+                std::stringstream record(pending.substr(pos, end - pos));
+                pos = end = end + 6;
+                readRecord(record);
+            }
+            pending.erase(0, pos);
+            return pos > 0;
+        };
+
+        // wait for results
+        int exitCode = -1;
+        Error error;
+        for (;;) {
+            bool done = false;
+            try {
+                std::tie(done, exitCode) = worker->tryWait(0);
+            } catch (const Error& e) {
+                done = true;
+                error = e;
+            }
+            auto now = std::chrono::steady_clock::now();
+            try {
+                if (readRecords()) {
+                    last = now;
+                }
+            } catch (const Error& e) {
+                LOG_ERROR("couldn't read probe results: " << e.what());
+                if (!done) {
+                    worker->terminate();
+                }
+                done = true;
+                error = e;
+            }
+            if (done) {
+                break;
+            }
+            if (timeout > 0) {
+                using seconds = std::chrono::duration<double>;
+                auto elapsed = std::chrono::duration_cast<seconds>(now - last).count();
+                if (elapsed > timeout) {
+                    if (worker->terminate()) {
+                        LOG_DEBUG("terminated hanging subprocess");
+                    }
+                    std::stringstream msg;
+                    msg << "subprocess timed out after " << timeout << " seconds!";
+                    error = Error(Error::Timeout, msg.str());
+                    break;
+                }
+            }
+            if (nonblocking) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(PROBE_SLEEP_MS));
+        }
+        auto errorMsg = worker->probeError();
+        if (error.code() == Error::NoError) {
+            // the worker can probe the next plugin (unless it has died)
+            ProbeWorkerPool::instance().recycle(worker);
+        } else if (exitCode == -1) {
+            exitCode = EXIT_FAILURE + 1; // don't read the error message
+        }
+
+        if (!haveFactory || numPlugins == 0) {
+            // a single plugin or a broken factory
+            ProbeResult result;
+            result.plugin = desc;
+            result.total = 1;
+            if (error.code() != Error::NoError) {
+                result.error = error;
+            } else if (exitCode == EXIT_FAILURE) {
+                result.error = readProbeError(errorMsg);
+            } else if (exitCode != EXIT_SUCCESS) {
+                result.error = Error(Error::Crash);
+            } else if (!haveFactory) {
+                result.error = Error(Error::SystemError, "no probe data!");
+            }
+            report(result);
+        } else if (next < numPlugins) {
+            // the subprocess has crashed or timed out while probing this sub-plugin
+            ProbeResult result;
+            result.plugin = std::make_shared<PluginDesc>(self);
+            result.plugin->name = desc->subPlugins[next].name;
+            result.index = next;
+            result.total = numPlugins;
+            if (error.code() != Error::NoError) {
+                result.error = error;
+            } else if (exitCode != EXIT_SUCCESS) {
+                result.error = Error(Error::Crash);
+            } else {
+                result.error = Error(Error::SystemError, "missing probe result");
+            }
+            report(result);
+            // probe the remaining sub-plugins one by one
+            PluginDesc::SubPluginList remaining(desc->subPlugins.begin() + next + 1,
+                                                desc->subPlugins.end());
+            if (!remaining.empty()) {
+                LOG_DEBUG("probe remaining " << remaining.size() << " sub-plugins");
+                int first = next + 1;
+                auto plugins = doProbePlugins(remaining, timeout,
+                    [&](const ProbeResult& result) {
+                        auto copy = result;
+                        copy.index += first;
+                        copy.total = numPlugins;
+                        if (callback) {
+                            callback(copy);
+                        }
+                    });
+                for (auto& plugin : plugins) {
+                    plugins_.push_back(plugin);
+                    pluginMap_[plugin->name] = plugin;
+                }
+            }
+        }
+        return true;
+    };
+}
+
 } // vst
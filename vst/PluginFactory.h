@@ -15,6 +15,14 @@
 // The sleep interval when probing several plugins in a factory asynchronously
 #define PROBE_SLEEP_MS 2
 
+// Probe factories with several sub-plugins (e.g. VST2 shell plugins) in a single
+// subprocess which describes all sub-plugins one after another. If the subprocess
+// crashes or hangs, the remaining sub-plugins are probed one by one.
+// Set to 0 to always probe sub-plugins in separate processes.
+#ifndef PROBE_SINGLE_PASS
+#define PROBE_SINGLE_PASS 1
+#endif
+
 namespace vst {
 
 class PluginFactory :
@@ -45,10 +53,11 @@ class PluginFactory :
     std::vector<PluginDesc::ptr> doProbePlugins(
             const PluginDesc::SubPluginList& pluginList,
             float timeout, ProbeCallback callback);
+    ProbeFuture doProbeAll(float timeout, bool nonblocking);
     // data
     std::string path_;
     CpuArch arch_;
-    std::unique_ptr<IModule> module_;
+    std::shared_ptr<IModule> module_;
     std::vector<PluginDesc::ptr> plugins_;
     std::unordered_map<std::string, PluginDesc::ptr> pluginMap_;
 };
@@ -4,7 +4,11 @@
 #include "Log.h"
 #include "FileUtils.h"
 #include "MiscUtils.h"
+#include "MemoryPool.h"
+#include "Trace.h"
+#include "PackedEvents.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <sstream>
@@ -12,6 +16,12 @@
 #if VST_HOST_SYSTEM != VST_WINDOWS
 #include <signal.h>
 #endif
+#if VST_HOST_SYSTEM == VST_MACOS
+#include <sys/event.h>
+#elif VST_HOST_SYSTEM == VST_LINUX
+#include <sys/syscall.h>
+#include <poll.h>
+#endif
 
 #if DEBUG_SERVER_PROCESS
 # define LOG_PROCESS(x) LOG_DEBUG(x)
@@ -51,6 +61,7 @@ PluginHandle::PluginHandle(PluginServer& server, IPlugin::ptr plugin,
     : server_(&server), plugin_(std::move(plugin)), id_(id)
 {
     LOG_DEBUG("PluginHandle::PluginHandle (" << id_ << ")");
+    packedReplies_ = std::make_unique<PackedEventWriter>();
     // cache param state and send to client
     channel.clear(); // !
 
@@ -63,12 +74,19 @@ PluginHandle::PluginHandle(PluginServer& server, IPlugin::ptr plugin,
         paramState_[i] = value;
         sendParam(channel, i, value, false);
     }
+    flushReplies(channel);
 
     plugin_->setListener(this);
 }
 
 PluginHandle::~PluginHandle() {
     LOG_DEBUG("PluginHandle::~PluginHandle (" << id_ << ")");
+    if (uiStats_.deferred > 0) {
+        LOG_DEBUG("PluginHandle (" << id_ << "): UI param automation: "
+                  << uiStats_.posted << " posted, " << uiStats_.deferred
+                  << " deferred, " << uiStats_.coalesced << " coalesced, "
+                  << uiStats_.flushed << " flushed");
+    }
 }
 
 void PluginHandle::handleRequest(const ShmCommand &cmd,
@@ -273,7 +291,7 @@ void PluginHandle::handleRequest(const ShmCommand &cmd,
             LOG_DEBUG("PluginHandle (" << id_ << "): send plugin data via tmp file (size: "
                       << buffer.size() << ", capacity: " << channel.capacity() << ")");
             std::stringstream ss;
-            ss << getTmpDirectory() << "/vst_" << (void *)this;
+            ss << getTransferDirectory() << "/vst_" << (void *)this;
             std::string path = ss.str();
             // NOTE: the file must be deleted by the client!
             File file(path, File::WRITE);
@@ -361,19 +379,21 @@ void PluginHandle::parameterAutomated(int index, float value) {
         } else {
             LOG_DEBUG("PluginHandle: parameter " << index << " automated on UI thread");
 
-            // UI queue is bounded! For now, just sleep until the other side has drained the queue.
-            ShmUICommand cmd(Command::ParamAutomated, id_);
-            cmd.paramAutomated.index = index;
-            cmd.paramAutomated.value = value;
-
-            int counter = 0;
-            while (!server_->postUIThread(cmd)){
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                counter++;
-                if (counter > 1000) {
-                    LOG_WARNING("PluginHandle (" << id_ << "): postUIThread() blocked for over 1 second");
-                    break;
+            // UI queue is bounded! If it is full, we store the value in the
+            // overflow table and try again in the next UI poll. NB: as long
+            // as there are pending values, new values must go to the table
+            // as well, otherwise we might send them out of order.
+            if (!uiParamList_.empty() && !flushUIParams()) {
+                deferParamAutomated(index, value);
+            } else if (postParamAutomated(index, value)) {
+                uiStats_.posted++;
+            } else {
+                if (uiStats_.deferred == 0) {
+                    LOG_WARNING("PluginHandle (" << id_ << "): UI queue is full, "
+                                "coalescing parameter automation");
                 }
+                deferParamAutomated(index, value);
+                server_->deferUIParams(id_);
             }
             paramAutomated_.emplace(index, value);
         }
@@ -388,6 +408,45 @@ void PluginHandle::parameterAutomated(int index, float value) {
     }
 }
 
+bool PluginHandle::postParamAutomated(int index, float value) {
+    ShmUICommand cmd(Command::ParamAutomated, id_);
+    cmd.paramAutomated.index = index;
+    cmd.paramAutomated.value = value;
+    return server_->postUIThread(cmd);
+}
+
+void PluginHandle::deferParamAutomated(int index, float value) {
+    if (!uiParamValues_) {
+        // allocate lazily, most plugins never need this
+        auto nparams = plugin_->info().numParameters();
+        uiParamValues_ = std::make_unique<float[]>(nparams);
+        uiParamPending_ = std::make_unique<bool[]>(nparams); // zero-initialized
+        uiParamList_.reserve(nparams);
+    }
+    if (uiParamPending_[index]) {
+        uiStats_.coalesced++;
+    } else {
+        uiParamPending_[index] = true;
+        uiParamList_.push_back(index);
+    }
+    uiParamValues_[index] = value;
+    uiStats_.deferred++;
+}
+
+bool PluginHandle::flushUIParams() {
+    size_t count = 0;
+    for (auto index : uiParamList_) {
+        if (!postParamAutomated(index, uiParamValues_[index])) {
+            break;
+        }
+        uiParamPending_[index] = false;
+        count++;
+    }
+    uiParamList_.erase(uiParamList_.begin(), uiParamList_.begin() + count);
+    uiStats_.flushed += count;
+    return uiParamList_.empty();
+}
+
 void PluginHandle::latencyChanged(int nsamples) {
     if (UIThread::isCurrentThread()){
         LOG_DEBUG("UI thread: LatencyChanged");
@@ -428,7 +487,7 @@ void PluginHandle::sysexEvent(const SysexEvent& event) {
         // ignore for now
     } else {
         // deep copy!
-        auto data = new char[event.size];
+        auto data = allocatePayload(PayloadType::Sysex, event.size);
         memcpy(data, event.data, event.size);
 
         Command cmd(Command::SysexReceived);
@@ -448,13 +507,16 @@ void PluginHandle::updateBuffer(){
     for (int i = 0; i < numOutputs_; ++i){
         total += outputs_[i].numChannels;
     }
-    const int incr = maxBlockSize_ *
-        (precision_ == ProcessPrecision::Double ? sizeof(double) : sizeof(float));
-    buffer_.clear(); // force zero initialization
-    buffer_.resize(total * incr);
-    // set buffer vectors
-    auto buf = buffer_.data();
-    auto setBuffers = [](auto& busses, int count, auto& bufptr, int incr){
+    // every channel starts on a cache line, see DSPBuffer::padSize()
+    const int incr = DSPBuffer::padSize(maxBlockSize_ *
+        (precision_ == ProcessPrecision::Double ? sizeof(double) : sizeof(float)));
+    buffer_.resize(total * incr); // zero initialized
+    setBuffers(buffer_.data(), incr);
+    audioBus_ = false;
+}
+
+void PluginHandle::setBuffers(char *buf, size_t incr){
+    auto setBusBuffers = [](auto& busses, int count, auto& bufptr, size_t incr){
         for (int i = 0; i < count; ++i){
             auto& bus = busses[i];
             for (int j = 0; j < bus.numChannels; ++j){
@@ -463,10 +525,8 @@ void PluginHandle::updateBuffer(){
             }
         }
     };
-    setBuffers(inputs_, numInputs_, buf, incr);
-    setBuffers(outputs_, numOutputs_, buf, incr);
-
-    assert((buf - buffer_.data()) == buffer_.size());
+    setBusBuffers(inputs_, numInputs_, buf, incr);
+    setBusBuffers(outputs_, numOutputs_, buf, incr);
 }
 
 void PluginHandle::process(const ShmCommand &cmd, ShmChannel &channel){
@@ -480,6 +540,7 @@ void PluginHandle::process(const ShmCommand &cmd, ShmChannel &channel){
 
 template<typename T>
 void PluginHandle::doProcess(const ShmCommand& cmd, ShmChannel& channel){
+    TRACE_SCOPE(ServerProcess, id_);
     LOG_PROCESS("PluginHandle (" << id_ << "): start processing");
 
     assert(cmd.process.numInputs == numInputs_);
@@ -494,26 +555,41 @@ void PluginHandle::doProcess(const ShmCommand& cmd, ShmChannel& channel){
     data.numOutputs = numOutputs_;
     data.outputs = outputs_.get();
 
-    // read audio input data
-    for (int i = 0; i < data.numInputs; ++i){
-        auto& bus = data.inputs[i];
-        LOG_PROCESS("PluginHandle (" << id_ << "): read input bus " << i << " with "
-                     << bus.numChannels << " channels");
-        // read channels
-        for (int j = 0; j < bus.numChannels; ++j){
-            auto chn = (T *)bus.channelData32[j];
-            const void* msg;
-            size_t size;
-            if (channel.getMessage(msg, size)){
-                // size can be larger because of message
-                // alignment - don't use in std::copy!
-                assert(size >= data.numSamples * sizeof(T));
-                auto buf = (const float *)msg;
-                std::copy(buf, buf + data.numSamples, chn);
-            } else {
-                std::fill(chn, chn + data.numSamples, 0);
-                LOG_ERROR("PluginClient: missing channel " << j
-                          << " for audio input bus " << i);
+    if (cmd.process.flags & ShmCommand::ProcessAudioBus){
+        // process directly in the audio bus of the channel.
+        // NB: the channel might be different for every process call
+        // (shared plugin bridge), so we always have to update the buffers.
+        auto stride = ShmCommand::audioBusStride(data.numSamples, sizeof(T));
+        setBuffers((char *)channel.audioBuffer(), stride);
+        audioBus_ = true;
+    } else {
+        if (audioBus_){
+            // restore our own buffers
+            auto incr = DSPBuffer::padSize(maxBlockSize_ * sizeof(T));
+            setBuffers(buffer_.data(), incr);
+            audioBus_ = false;
+        }
+        // read audio input data
+        for (int i = 0; i < data.numInputs; ++i){
+            auto& bus = data.inputs[i];
+            LOG_PROCESS("PluginHandle (" << id_ << "): read input bus " << i << " with "
+                         << bus.numChannels << " channels");
+            // read channels
+            for (int j = 0; j < bus.numChannels; ++j){
+                auto chn = (T *)bus.channelData32[j];
+                const void* msg;
+                size_t size;
+                if (channel.getMessage(msg, size)){
+                    // size can be larger because of message
+                    // alignment - don't use in std::copy!
+                    assert(size >= data.numSamples * sizeof(T));
+                    auto buf = (const T *)msg;
+                    std::copy(buf, buf + data.numSamples, chn);
+                } else {
+                    std::fill(chn, chn + data.numSamples, 0);
+                    LOG_ERROR("PluginClient: missing channel " << j
+                              << " for audio input bus " << i);
+                }
             }
         }
     }
@@ -524,19 +600,24 @@ void PluginHandle::doProcess(const ShmCommand& cmd, ShmChannel& channel){
 
     // process audio
     LOG_PROCESS("PluginHandle (" << id_ << "): process");
+    TRACE_BEGIN(PluginProcess, id_);
     plugin_->process(data);
+    TRACE_END(PluginProcess, id_);
 
     // send audio output data
     channel.clear(); // !
 
-    // send output busses
-    for (int i = 0; i < data.numOutputs; ++i){
-        auto& bus = data.outputs[i];
-        LOG_PROCESS("PluginHandle (" << id_ << "): write output bus " << i << " with "
-                     << bus.numChannels << " channels");
-        // write all channels sequentially to avoid additional copying.
-        for (int j = 0; j < bus.numChannels; ++j){
-            channel.addMessage(bus.channelData32[j], sizeof(T) * data.numSamples);
+    // send output busses (unless the plugin has already written
+    // its output to the audio bus)
+    if (!audioBus_){
+        for (int i = 0; i < data.numOutputs; ++i){
+            auto& bus = data.outputs[i];
+            LOG_PROCESS("PluginHandle (" << id_ << "): write output bus " << i << " with "
+                         << bus.numChannels << " channels");
+            // write all channels sequentially to avoid additional copying.
+            for (int j = 0; j < bus.numChannels; ++j){
+                channel.addMessage(bus.channelData32[j], sizeof(T) * data.numSamples);
+            }
         }
     }
 
@@ -572,6 +653,35 @@ void PluginHandle::dispatchCommands(ShmChannel& channel){
                 events_.push_back(event);
             }
             break;
+        case Command::PackedEvents:
+        {
+            if (cmd->packed.version != PackedEvents::version){
+                LOG_ERROR("PluginHandle (" << id_ << "): PackedEvents version mismatch");
+                break;
+            }
+            PackedEventReader reader(*cmd);
+            if (cmd->packed.kind == PackedEvents::ParamValue){
+                while (reader.next()){
+                    int index, offset;
+                    float value;
+                    reader.readParamValue(index, value, offset);
+                    plugin_->setParameter(index, value, offset);
+                    // parameter update event
+                    Command event(Command::ParameterUpdate);
+                    event.paramAutomated.index = index;
+                    event.paramAutomated.value = value;
+                    events_.push_back(event);
+                }
+            } else if (cmd->packed.kind == PackedEvents::Midi){
+                while (reader.next()){
+                    plugin_->sendMidiEvent(reader.readMidi());
+                }
+            } else {
+                LOG_ERROR("PluginHandle (" << id_ << "): unexpected PackedEvents kind "
+                          << (int)cmd->packed.kind);
+            }
+            break;
+        }
         case Command::SetParamString:
         {
             auto& param = cmd->paramString;
@@ -601,6 +711,9 @@ void PluginHandle::dispatchCommands(ShmChannel& channel){
         case Command::SetBypass:
             plugin_->setBypass(static_cast<Bypass>(cmd->i));
             break;
+        case Command::SetSilenceMode:
+            plugin_->setSilenceMode(static_cast<SilenceMode>(cmd->i));
+            break;
         case Command::SetTempo:
             plugin_->setTempoBPM(cmd->d);
             break;
@@ -665,16 +778,20 @@ void PluginHandle::sendEvents(ShmChannel& channel){
             break;
         }
         case Command::LatencyChanged:
+            flushReplies(channel);
             addReply(channel, &event, sizeof(ShmCommand));
             break;
         case Command::UpdateDisplay:
+            flushReplies(channel);
             addReply(channel, &event, sizeof(ShmCommand));
             break;
         case Command::MidiReceived:
-            addReply(channel, &event, sizeof(ShmCommand));
+            addPackedReply(channel, PackedEvents::Midi);
+            packedReplies_->addMidi(event.midi);
             break;
         case Command::SysexReceived:
         {
+            flushReplies(channel);
             auto size = CommandSize(ShmCommand, sysex, event.sysex.size);
             auto reply = (ShmCommand *)alloca(size);
             reply->type = event.type;
@@ -683,6 +800,8 @@ void PluginHandle::sendEvents(ShmChannel& channel){
             memcpy(reply->sysex.data, event.sysex.data, event.sysex.size);
 
             addReply(channel, reply, size);
+
+            freePayload(event.sysex.data); // free!
             break;
         }
         case Command::ProgramChange:
@@ -717,6 +836,8 @@ void PluginHandle::sendEvents(ShmChannel& channel){
 
         count++;
     }
+
+    flushReplies(channel);
 }
 
 void PluginHandle::sendParameterUpdate(ShmChannel& channel){
@@ -730,6 +851,7 @@ void PluginHandle::sendParameterUpdate(ShmChannel& channel){
             paramState_[i] = value;
         }
     }
+    flushReplies(channel);
 }
 
 void PluginHandle::sendPresetParamChanges(ShmChannel& channel) {
@@ -741,6 +863,7 @@ void PluginHandle::sendPresetParamChanges(ShmChannel& channel) {
         sendParam(channel, p.index, p.value, true);
     }
     presetParamChanges_.clear();
+    flushReplies(channel);
 }
 
 void PluginHandle::sendProgramUpdate(ShmChannel &channel, bool bank){
@@ -779,17 +902,26 @@ void PluginHandle::sendParam(ShmChannel &channel, int index,
 {
     ParamStringBuffer display;
     auto displaySize = plugin_->getParameterString(index, display);
-    // NB: use extra byte from pstr[1] for pascal string size!
-    auto cmdSize  = CommandSize(ShmCommand, paramState, displaySize);
-    auto reply = (ShmCommand *)alloca(cmdSize);
-    new (reply) ShmCommand(automated ? Command::ParamAutomated
-                                     : Command::ParameterUpdate);
-    reply->paramState.index = index;
-    reply->paramState.value = value;
-    reply->paramState.pstr[0] = displaySize;
-    memcpy(&reply->paramState.pstr[1], display.data(), displaySize);
-
-    addReply(channel, reply, cmdSize);
+    // NB: the reply is only sent in flushReplies()!
+    addPackedReply(channel, PackedEvents::ParamState);
+    packedReplies_->addParamState(index, value, display.data(),
+                                  displaySize, automated);
+}
+
+void PluginHandle::addPackedReply(ShmChannel& channel, PackedEvents::Kind kind){
+    auto& writer = *packedReplies_;
+    if (writer.kind() != kind || writer.full()){
+        flushReplies(channel);
+        writer.reset(kind);
+    }
+}
+
+void PluginHandle::flushReplies(ShmChannel& channel){
+    auto& writer = *packedReplies_;
+    if (!writer.empty()){
+        addReply(channel, writer.data(), writer.size());
+        writer.reset(writer.kind());
+    }
 }
 
 bool PluginHandle::addReply(ShmChannel& channel, const void *cmd, size_t size){
@@ -824,18 +956,30 @@ PluginServer::PluginServer(int pid, const std::string& shmPath)
     } else {
        throw Error(Error::PluginError, "host app version mismatch");
     }
+    // apply memory locking mode of the client
+    auto flags = shm_->flags();
+    if (flags & ShmInterface::LockMemory){
+        setMemoryLocking(true, flags & ShmInterface::HugePages);
+    }
     // setup UI event loop
     LOG_DEBUG("PluginServer: setup event loop");
     UIThread::setup();
     // install UI poll function
     LOG_DEBUG("PluginServer: add UI poll function");
+    // the poll function is event-driven, see runUIWakeThread()
     pollFunction_ = UIThread::addPollFunction([](void *x){
         static_cast<PluginServer *>(x)->pollUIThread();
-    }, this);
+    }, this, true);
 
     // create threads for NRT + RT channels
     LOG_DEBUG("PluginServer: create threads");
     running_ = true;
+    threads_.emplace_back(&PluginServer::runUIWakeThread, this);
+    // get notified when the parent exits; otherwise we only notice
+    // on the next (fallback) UI poll, see pollUIThread()
+    if (initParentWatch()) {
+        threads_.emplace_back(&PluginServer::runParentWatchThread, this);
+    }
     for (int i = Channel::NRT; i < shm_->numChannels(); ++i){
         auto thread = std::thread(&PluginServer::runThread,
                                   this, &shm_->getChannel(i));
@@ -854,6 +998,22 @@ PluginServer::~PluginServer(){
         thread.join();
     }
 
+#if VST_HOST_SYSTEM == VST_WINDOWS
+    if (parentWatchEvent_) {
+        CloseHandle(parentWatchEvent_);
+    }
+#elif VST_HOST_SYSTEM == VST_MACOS
+    if (parentWatchQueue_ >= 0) {
+        close(parentWatchQueue_);
+    }
+#else
+    if (parentWatchFd_ >= 0) {
+        close(parentWatchFd_);
+        close(parentWatchPipe_[0]);
+        close(parentWatchPipe_[1]);
+    }
+#endif
+
     // properly destruct all remaining plugins
     // on the UI thread (in case the parent crashed)
     if (!plugins_.empty()){
@@ -877,7 +1037,34 @@ void PluginServer::run(){
 bool PluginServer::postUIThread(const ShmUICommand& cmd){
     // sizeof(cmd) is a bit lazy, but we don't care about size here
     auto& channel = shm_->getChannel(Channel::UISend);
-    return channel.writeMessage(&cmd, sizeof(cmd));
+    if (channel.writeMessage(&cmd, sizeof(cmd))) {
+        // wake up the other side, see PluginBridge::runUIWakeThread()
+        channel.post();
+        return true;
+    } else {
+        return false;
+    }
+}
+
+void PluginServer::deferUIParams(uint32_t id){
+    if (std::find(uiParamPlugins_.begin(), uiParamPlugins_.end(), id)
+            == uiParamPlugins_.end()) {
+        uiParamPlugins_.push_back(id);
+    }
+}
+
+void PluginServer::runUIWakeThread(){
+    setThreadPriority(Priority::Low);
+
+    auto& channel = shm_->getChannel(Channel::UIReceive);
+    for (;;) {
+        channel.wait();
+        if (!running_.load()) {
+            break;
+        }
+        // NB: notifications are coalesced by the event loop
+        UIThread::notifyPollFunctions();
+    }
 }
 
 void PluginServer::pollUIThread(){
@@ -909,6 +1096,22 @@ void PluginServer::pollUIThread(){
         size = sizeof(buffer); // reset size!
     }
 
+    // try to send pending parameter automation
+    if (!uiParamPlugins_.empty()) {
+        for (auto it = uiParamPlugins_.begin(); it != uiParamPlugins_.end();) {
+            auto plugin = findPlugin(*it);
+            if (!plugin || plugin->flushUIParams()) {
+                it = uiParamPlugins_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (!uiParamPlugins_.empty()) {
+            // the UI poll function is event-driven; make sure we try again soon.
+            UIThread::notifyPollFunctions();
+        }
+    }
+
     checkIfParentAlive();
 }
 
@@ -934,11 +1137,117 @@ void PluginServer::checkIfParentAlive(){
     }
 }
 
+bool PluginServer::initParentWatch(){
+#if VST_HOST_SYSTEM == VST_WINDOWS
+    parentWatchEvent_ = CreateEventA(NULL, FALSE, FALSE, NULL);
+    if (!parentWatchEvent_) {
+        LOG_ERROR("PluginServer: CreateEvent() failed: "
+                  << errorMessage(GetLastError()));
+        return false;
+    }
+    return true;
+#elif VST_HOST_SYSTEM == VST_MACOS
+    parentWatchQueue_ = kqueue();
+    if (parentWatchQueue_ < 0) {
+        LOG_ERROR("PluginServer: kqueue() failed: " << errorMessage(errno));
+        return false;
+    }
+    struct kevent ev[2];
+    EV_SET(&ev[0], parent_, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, nullptr);
+    EV_SET(&ev[1], 0, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+    if (kevent(parentWatchQueue_, ev, 2, nullptr, 0, nullptr) < 0) {
+        LOG_ERROR("PluginServer: kevent() failed: " << errorMessage(errno));
+        close(parentWatchQueue_);
+        parentWatchQueue_ = -1;
+        return false;
+    }
+    return true;
+#elif defined(SYS_pidfd_open)
+    // NB: requires Linux 5.3
+    parentWatchFd_ = syscall(SYS_pidfd_open, parent_, 0);
+    if (parentWatchFd_ < 0) {
+        LOG_DEBUG("PluginServer: pidfd_open() failed: " << errorMessage(errno));
+        return false;
+    }
+    if (pipe(parentWatchPipe_) != 0) {
+        LOG_ERROR("PluginServer: pipe() failed: " << errorMessage(errno));
+        close(parentWatchFd_);
+        parentWatchFd_ = -1;
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void PluginServer::runParentWatchThread(){
+    setThreadPriority(Priority::Low);
+
+    bool exited = false;
+#if VST_HOST_SYSTEM == VST_WINDOWS
+    HANDLE handles[] = { parent_, parentWatchEvent_ };
+    exited = WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0;
+#elif VST_HOST_SYSTEM == VST_MACOS
+    struct kevent ev;
+    for (;;) {
+        auto ret = kevent(parentWatchQueue_, nullptr, 0, &ev, 1, nullptr);
+        if (ret > 0) {
+            exited = ev.filter == EVFILT_PROC;
+            break;
+        } else if (ret < 0 && errno != EINTR) {
+            LOG_ERROR("PluginServer: kevent() failed: " << errorMessage(errno));
+            break;
+        }
+    }
+#elif defined(SYS_pidfd_open)
+    struct pollfd fds[2] = {
+        { parentWatchFd_, POLLIN, 0 },
+        { parentWatchPipe_[0], POLLIN, 0 }
+    };
+    for (;;) {
+        auto ret = poll(fds, 2, -1);
+        if (ret > 0) {
+            exited = fds[0].revents & POLLIN;
+            break;
+        } else if (ret < 0 && errno != EINTR) {
+            LOG_ERROR("PluginServer: poll() failed: " << errorMessage(errno));
+            break;
+        }
+    }
+#endif
+    if (exited && running_.load()) {
+        LOG_DEBUG("PluginServer: parent exited");
+        // quit on the UI thread, see checkIfParentAlive()
+        UIThread::notifyPollFunctions();
+    }
+}
+
+void PluginServer::stopParentWatch(){
+#if VST_HOST_SYSTEM == VST_WINDOWS
+    if (parentWatchEvent_) {
+        SetEvent(parentWatchEvent_);
+    }
+#elif VST_HOST_SYSTEM == VST_MACOS
+    if (parentWatchQueue_ >= 0) {
+        struct kevent ev;
+        EV_SET(&ev, 0, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+        kevent(parentWatchQueue_, &ev, 1, nullptr, 0, nullptr);
+    }
+#else
+    if (parentWatchFd_ >= 0) {
+        char c = 0;
+        (void)!write(parentWatchPipe_[1], &c, 1);
+    }
+#endif
+}
+
 void PluginServer::runThread(ShmChannel *channel){
     // raise thread priority for RT threads, but not for dedicated NRT thread!
     if (channel->name() != "nrt") {
         setThreadPriority(Priority::High);
     }
+    TRACE_THREAD_NAME(channel->name().c_str());
 
     // while running, wait for requests and dispatch to plugin
     // Quit command -> quit()
@@ -947,6 +1256,19 @@ void PluginServer::runThread(ShmChannel *channel){
         channel->wait();
         // LOG_DEBUG(channel->name() << ": wake up");
 
+        // map the new channel segment (if any), see ShmChannel::reserve().
+        // RT channels are only grown by the client between requests, followed
+        // by a Command::MapChannel request, so we never do this while processing.
+        if (!channel->updateSegment()) {
+            // We can't communicate over this channel anymore because the
+            // client has already switched to the new segment.
+            LOG_ERROR("PluginServer: '" << channel->name()
+                      << "': lost channel - quit");
+            quit();
+            channel->postReply();
+            break;
+        }
+
         channel->reset();
 
         const void *msg;
@@ -979,6 +1301,9 @@ void PluginServer::handleCommand(ShmChannel& channel,
         case Command::Quit:
             quit();
             break;
+        case Command::MapChannel:
+            // nothing to do, see runThread()
+            break;
         default:
             plugin = findPlugin(cmd.id);
             if (plugin){
@@ -1078,6 +1403,8 @@ void PluginServer::quit(){
 
     running_.store(false);
     // wake up all threads
+    shm_->getChannel(Channel::UIReceive).post();
+    stopParentWatch();
     for (int i = Channel::NRT; i < shm_->numChannels(); ++i){
         shm_->getChannel(i).post();
     }
@@ -2,9 +2,11 @@
 
 #include "Interface.h"
 #include "PluginCommand.h"
+#include "PackedEvents.h"
 #include "PluginDictionary.h"
 #include "Sync.h"
 #include "Bus.h"
+#include "MemoryPool.h"
 #include "Lockfree.h"
 
 #include <thread>
@@ -46,6 +48,9 @@ public:
 
     void handleRequest(const ShmCommand& cmd, ShmChannel& channel);
     void handleUICommand(const ShmUICommand& cmd);
+    // try to send pending UI parameter automation (UI thread only).
+    // Returns false if the UI queue is still full.
+    bool flushUIParams();
 
     void parameterAutomated(int index, float value) override;
     void latencyChanged(int nsamples) override;
@@ -58,6 +63,8 @@ private:
 
     void updateBuffer();
 
+    void setBuffers(char *buf, size_t incr);
+
     void process(const ShmCommand& cmd, ShmChannel& channel);
 
     template<typename T>
@@ -83,7 +90,8 @@ private:
     int numInputs_ = 0;
     std::unique_ptr<Bus[]> outputs_;
     int numOutputs_ = 0;
-    std::vector<char> buffer_;
+    DSPBuffer buffer_;
+    bool audioBus_ = false; // busses point into the audio bus of the channel
     std::vector<Command> events_;
 
     // parameter automation from GUI, see parameterAutomated()
@@ -99,11 +107,33 @@ private:
 
     static const int paramAutomationRateLimit = 64;
 
+    // UI parameter automation that didn't fit into the UI queue.
+    // We only keep the latest value per parameter; the table is drained
+    // in PluginServer::pollUIThread(). UI thread only!
+    std::unique_ptr<float[]> uiParamValues_;
+    std::unique_ptr<bool[]> uiParamPending_;
+    std::vector<int32_t> uiParamList_; // pending indices in order
+    struct UIStats {
+        uint64_t posted = 0; // sent directly
+        uint64_t deferred = 0; // went into the overflow table
+        uint64_t coalesced = 0; // overwrote a pending value
+        uint64_t flushed = 0; // sent from the overflow table
+    };
+    UIStats uiStats_;
+
+    bool postParamAutomated(int index, float value);
+    void deferParamAutomated(int index, float value);
+
     // cached parameter state
     std::unique_ptr<float[]> paramState_;
 
+    // parameter and MIDI replies are packed, see PackedEvents.h.
+    // Call flushReplies() before adding any other reply!
     void sendParam(ShmChannel& channel, int index,
                    float value, bool automated);
+    void addPackedReply(ShmChannel& channel, PackedEvents::Kind kind);
+    void flushReplies(ShmChannel& channel);
+    std::unique_ptr<PackedEventWriter> packedReplies_;
 };
 
 #define AddReply(cmd, field) addReply(&(cmd), (cmd).headerSize + sizeof((cmd).field))
@@ -121,9 +151,15 @@ class PluginServer {
     void run();
 
     bool postUIThread(const ShmUICommand& cmd);
+    // schedule a PluginHandle::flushUIParams() call (UI thread only)
+    void deferUIParams(uint32_t id);
  private:
     void pollUIThread();
+    void runUIWakeThread();
     void checkIfParentAlive();
+    bool initParentWatch();
+    void runParentWatchThread();
+    void stopParentWatch();
     void runThread(ShmChannel* channel);
     void handleCommand(ShmChannel& channel,
                        const ShmCommand &cmd);
@@ -147,13 +183,22 @@ class PluginServer {
 
 #if VST_HOST_SYSTEM == VST_WINDOWS
     HANDLE parent_ = NULL;
+    HANDLE parentWatchEvent_ = NULL;
 #else
     int parent_ = -1;
+  #if VST_HOST_SYSTEM == VST_MACOS
+    int parentWatchQueue_ = -1;
+  #else
+    int parentWatchFd_ = -1; // pidfd
+    int parentWatchPipe_[2] = { -1, -1 };
+  #endif
 #endif
     std::unique_ptr<ShmInterface> shm_;
     std::vector<std::thread> threads_;
     std::atomic<bool> running_;
     UIThread::Handle pollFunction_;
+    // plugins with pending UI parameter automation (UI thread only)
+    std::vector<uint32_t> uiParamPlugins_;
 
     std::unordered_map<uint32_t, std::unique_ptr<PluginHandle>> plugins_;
     SharedMutex pluginMutex_;
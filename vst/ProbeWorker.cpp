@@ -0,0 +1,354 @@
+#include "ProbeWorker.h"
+
+#include "CpuArch.h"
+#include "MiscUtils.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#ifndef _WIN32
+# include <unistd.h>
+# include <poll.h>
+# include <fcntl.h>
+# include <sys/types.h>
+# include <sys/socket.h>
+#endif
+
+// max. number of idle workers; we might need more than one worker per core
+// because factories with several sub-plugins probe them in parallel.
+#define PROBE_WORKER_MAX_IDLE 8
+
+namespace vst {
+
+/*///////////////////////// ProbeWorker ///////////////////////////*/
+
+ProbeWorker::ProbeWorker(CpuArch arch)
+    : arch_(arch)
+{
+    auto app = IHostApp::get(arch);
+    if (!app) {
+        // shouldn't happen
+        throw Error(Error::SystemError, "couldn't get host app");
+    }
+#ifdef _WIN32
+    // NB: the child process duplicates its pipe ends, see host.cpp
+    if (!CreatePipe(&hCmdRead_, &hCmdWrite_, NULL, 0)) {
+        throw Error(Error::SystemError,
+                    "CreatePipe() failed: " + errorMessage(GetLastError()));
+    }
+    if (!CreatePipe(&hReplyRead_, &hReplyWrite_, NULL, 0)) {
+        auto err = GetLastError();
+        closePipes();
+        throw Error(Error::SystemError,
+                    "CreatePipe() failed: " + errorMessage(err));
+    }
+    auto cmdPipe = reinterpret_cast<intptr_t>(hCmdRead_);
+    auto replyPipe = reinterpret_cast<intptr_t>(hReplyWrite_);
+#else
+    // We use a socket pair instead of two pipes because it allows us
+    // to suppress SIGPIPE if the worker has died.
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        throw Error(Error::SystemError,
+                    "socketpair() failed: " + errorMessage(errno));
+    }
+    // don't leak our end into other subprocesses!
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+ #ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fds[0], SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+ #endif
+    socket_ = fds[0];
+    auto cmdPipe = fds[1];
+    auto replyPipe = fds[1];
+#endif
+    try {
+        process_ = app->probeWorker(cmdPipe, replyPipe);
+    } catch (const Error& e) {
+    #ifndef _WIN32
+        close(fds[1]);
+    #endif
+        closePipes();
+        throw Error(Error::SystemError, "couldn't create probe process '"
+                    + app->path() + "': " + e.what());
+    }
+#ifndef _WIN32
+    // close the child end *after* creating the subprocess!
+    close(fds[1]);
+#endif
+    alive_ = true;
+    LOG_DEBUG("ProbeWorker: spawned subprocess (child: " << process_.pid()
+              << ", parent: " << getCurrentProcessId() << ")");
+}
+
+ProbeWorker::~ProbeWorker() {
+    // closing the command pipe tells the worker to quit
+    closePipes();
+    if (alive_) {
+        try {
+            auto [done, code] = process_.tryWait(1.0);
+            if (!done) {
+                LOG_DEBUG("ProbeWorker: terminate subprocess");
+                process_.terminate();
+            }
+        } catch (const Error& e) {
+            LOG_WARNING("ProbeWorker: " << e.what());
+        }
+    }
+}
+
+void ProbeWorker::closePipes() {
+#ifdef _WIN32
+    for (auto h : { &hCmdRead_, &hCmdWrite_, &hReplyRead_, &hReplyWrite_ }) {
+        if (*h) {
+            CloseHandle(*h);
+            *h = NULL;
+        }
+    }
+#else
+    if (socket_ >= 0) {
+        close(socket_);
+        socket_ = -1;
+    }
+#endif
+}
+
+void ProbeWorker::request(const std::string& path, int id) {
+    if (!alive_) {
+        throw Error(Error::SystemError, "probe process is not running");
+    }
+    data_.clear();
+    error_.clear();
+
+    ProbeRequest header;
+    header.id = id;
+    header.pathSize = path.size();
+    std::string msg;
+    msg.reserve(sizeof(header) + path.size());
+    msg.append((const char *)&header, sizeof(header));
+    msg.append(path);
+
+    size_t count = 0;
+    while (count < msg.size()) {
+    #ifdef _WIN32
+        DWORD bytesWritten = 0;
+        if (!WriteFile(hCmdWrite_, msg.data() + count, msg.size() - count,
+                       &bytesWritten, NULL)) {
+            throw Error(Error::SystemError,
+                        "WriteFile() failed: " + errorMessage(GetLastError()));
+        }
+    #else
+     #ifdef MSG_NOSIGNAL
+        auto bytesWritten = send(socket_, msg.data() + count, msg.size() - count, MSG_NOSIGNAL);
+     #else
+        auto bytesWritten = send(socket_, msg.data() + count, msg.size() - count, 0);
+     #endif
+        if (bytesWritten < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw Error(Error::SystemError, "send() failed: " + errorMessage(errno));
+        }
+    #endif
+        count += bytesWritten;
+    }
+}
+
+// read a single reply message (after we know that there is data available).
+// The worker always sends the message header together with its data, so we can
+// simply block until we have received the whole message.
+// Returns false if the connection has been closed.
+bool ProbeWorker::readReply(ProbeReply& reply) {
+    auto readAll = [this](void *data, size_t size) {
+        auto buf = static_cast<char *>(data);
+        while (size > 0) {
+        #ifdef _WIN32
+            DWORD bytesRead = 0;
+            if (!ReadFile(hReplyRead_, buf, size, &bytesRead, NULL) || bytesRead == 0) {
+                return false;
+            }
+        #else
+            auto bytesRead = recv(socket_, buf, size, MSG_WAITALL);
+            if (bytesRead < 0 && errno == EINTR) {
+                continue;
+            } else if (bytesRead <= 0) {
+                return false;
+            }
+        #endif
+            buf += bytesRead;
+            size -= bytesRead;
+        }
+        return true;
+    };
+    if (!readAll(&reply, sizeof(reply))) {
+        return false;
+    }
+    if (reply.size > 0) {
+        auto& buf = (reply.type == ProbeReply::Failure) ? error_ : data_;
+        auto offset = buf.size();
+        buf.resize(offset + reply.size);
+        if (!readAll(&buf[offset], reply.size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::pair<bool, int> ProbeWorker::tryWait(double timeout) {
+    if (!alive_) {
+        throw Error(Error::SystemError, "probe process is not running");
+    }
+    using seconds = std::chrono::duration<double>;
+    auto start = std::chrono::steady_clock::now();
+    auto remaining = [&]() {
+        auto elapsed = std::chrono::duration_cast<seconds>(
+            std::chrono::steady_clock::now() - start).count();
+        return std::max<double>(0, timeout - elapsed);
+    };
+    // read messages until we get the exit code
+    for (;;) {
+        bool ready = false;
+    #ifdef _WIN32
+        DWORD bytesAvailable = 0;
+        if (!PeekNamedPipe(hReplyRead_, NULL, 0, NULL, &bytesAvailable, NULL)) {
+            throw Error(Error::SystemError,
+                        "PeekNamedPipe() failed: " + errorMessage(GetLastError()));
+        }
+        if (bytesAvailable >= sizeof(ProbeReply)) {
+            ready = true;
+        } else if (auto [done, exitCode] = process_.tryWait(0); done) {
+            // We keep the child ends of the pipes open (see constructor),
+            // so we have to check the process itself.
+            alive_ = false;
+            return { true, exitCode };
+        } else if (timeout >= 0 && remaining() <= 0) {
+            return { false, -1 };
+        } else {
+            Sleep(1);
+            continue;
+        }
+    #else
+        pollfd fds;
+        fds.fd = socket_;
+        fds.events = POLLIN;
+        fds.revents = 0;
+        int ms = timeout >= 0 ? (int)(remaining() * 1000.0) : -1;
+        auto ret = poll(&fds, 1, ms);
+        if (ret == 0 || (ret < 0 && errno == EINTR)) {
+            return { false, -1 }; // not ready
+        } else if (ret < 0) {
+            throw Error(Error::SystemError, "poll() failed: " + errorMessage(errno));
+        }
+        ready = true;
+    #endif
+        if (ready) {
+            ProbeReply reply;
+            if (!readReply(reply)) {
+                // connection closed: the process has died. Get the exit code resp.
+                // throw an Error if it has been terminated by a signal.
+                alive_ = false;
+                return { true, process_.wait() };
+            }
+            if (reply.type == ProbeReply::Done) {
+                numProbes_++;
+                return { true, reply.code };
+            }
+            // got some data; try to read more (or wait for the rest of the timeout)
+        }
+    }
+}
+
+bool ProbeWorker::terminate() {
+    alive_ = false;
+    closePipes();
+    return process_.terminate();
+}
+
+bool ProbeWorker::checkIfRunning() {
+    if (!alive_) {
+        return false;
+    }
+    try {
+    #ifdef _WIN32
+        if (!process_.tryWait(0).first) {
+            return true;
+        }
+    #else
+        pollfd fds;
+        fds.fd = socket_;
+        fds.events = POLLIN;
+        fds.revents = 0;
+        if (poll(&fds, 1, 0) == 0) {
+            return true;
+        }
+        // an idle worker doesn't send anything, so the connection must have been closed.
+        process_.wait();
+    #endif
+    } catch (const Error& e) {
+        LOG_DEBUG("ProbeWorker: " << e.what());
+    }
+    LOG_DEBUG("ProbeWorker: idle subprocess has quit");
+    alive_ = false;
+    return false;
+}
+
+/*/////////////////////// ProbeWorkerPool /////////////////////////*/
+
+ProbeWorkerPool& ProbeWorkerPool::instance() {
+    static ProbeWorkerPool pool;
+    return pool;
+}
+
+ProbeWorker::ptr ProbeWorkerPool::acquire(CpuArch arch) {
+    {
+        std::lock_guard lock(mutex_);
+        for (auto it = idle_.begin(); it != idle_.end(); ) {
+            if ((*it)->arch() == arch) {
+                auto worker = std::move(*it);
+                it = idle_.erase(it);
+                if (worker->checkIfRunning()) {
+                    return worker;
+                }
+            } else {
+                ++it;
+            }
+        }
+    }
+    return std::make_shared<ProbeWorker>(arch); // throws on failure
+}
+
+void ProbeWorkerPool::recycle(ProbeWorker::ptr worker) {
+    if (!worker->alive() || worker->numProbes() >= PROBE_WORKER_MAX_PROBES) {
+        return;
+    }
+    {
+        std::lock_guard lock(mutex_);
+        int maxIdle = std::max<int>(std::thread::hardware_concurrency(),
+                                    PROBE_WORKER_MAX_IDLE);
+        if (numSessions_ > 0 && (int)idle_.size() < maxIdle) {
+            idle_.push_back(std::move(worker));
+        }
+    }
+    // otherwise the worker is released here (outside the lock)
+}
+
+void ProbeWorkerPool::retain() {
+    std::lock_guard lock(mutex_);
+    numSessions_++;
+}
+
+void ProbeWorkerPool::release() {
+    std::vector<ProbeWorker::ptr> workers;
+    {
+        std::lock_guard lock(mutex_);
+        if (--numSessions_ == 0) {
+            workers = std::move(idle_);
+            idle_.clear();
+        }
+    }
+    // the workers quit when their command pipes are closed
+}
+
+} // vst
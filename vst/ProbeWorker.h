@@ -0,0 +1,143 @@
+#pragma once
+
+#include "Interface.h"
+#include "HostApp.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Recycle a probe worker after it has probed this many plugins.
+// This limits the damage done by plugins which leak memory or
+// leave global state behind after the module has been unloaded.
+#define PROBE_WORKER_MAX_PROBES 64
+
+namespace vst {
+
+enum class CpuArch;
+
+// Probe a factory together with all its sub-plugins in a single pass.
+// Used as the ID in probe requests resp. on the command line;
+// -1 means the factory itself and anything else is a sub-plugin ID.
+#define PROBE_ALL_SUBPLUGINS -2
+
+// Sent from the host to the probe worker, followed by the plugin path
+// (without null terminator).
+struct ProbeRequest {
+    int32_t id;
+    uint32_t pathSize;
+};
+
+// Sent from the probe worker to the host, followed by 'size' bytes of data.
+// The worker sends any number of 'Data' messages with the (serialized) probe
+// results, optionally a 'Failure' message with the error code and message,
+// and finally a 'Done' message with the exit code of probe().
+struct ProbeReply {
+    enum Type {
+        Data,
+        Failure,
+        Done
+    };
+    int32_t type;
+    int32_t code; // only for 'Done'
+    uint32_t size;
+};
+
+// A long-lived probe process which probes plugins one after another,
+// so we don't have to spawn a new process for every single plugin.
+// The plugin info (or error message) is passed back through the reply
+// pipe, so probing never touches the file system.
+class ProbeWorker {
+ public:
+    using ptr = std::shared_ptr<ProbeWorker>;
+
+    // throws an Error on failure!
+    ProbeWorker(CpuArch arch);
+    ~ProbeWorker();
+
+    ProbeWorker(const ProbeWorker&) = delete;
+    ProbeWorker& operator=(const ProbeWorker&) = delete;
+
+    CpuArch arch() const { return arch_; }
+
+    // send a probe request; throws an Error on failure
+    void request(const std::string& path, int id);
+
+    // wait for the result of the current request.
+    // 'timeout' has the same meaning as in ProcessHandle::tryWait().
+    // If the worker process has died, it returns its exit code resp.
+    // throws an Error if it has been terminated by a signal.
+    // The data received so far can be obtained with takeData().
+    std::pair<bool, int> tryWait(double timeout);
+
+    // get (and consume) the probe data received so far
+    std::string takeData() {
+        return std::move(data_);
+    }
+
+    // the error message of a failed probe ("<code>\n<message>")
+    const std::string& probeError() const { return error_; }
+
+    bool terminate();
+
+    // check if an idle worker is still running
+    bool checkIfRunning();
+
+    // is the process still running and ready for the next request?
+    bool alive() const { return alive_; }
+
+    int numProbes() const { return numProbes_; }
+ private:
+    void closePipes();
+    bool readReply(ProbeReply& reply);
+
+    CpuArch arch_;
+    ProcessHandle process_;
+    bool alive_ = false;
+    int numProbes_ = 0;
+    std::string data_;
+    std::string error_;
+#ifdef _WIN32
+    HANDLE hCmdRead_ = NULL;
+    HANDLE hCmdWrite_ = NULL;
+    HANDLE hReplyRead_ = NULL;
+    HANDLE hReplyWrite_ = NULL;
+#else
+    int socket_ = -1;
+#endif
+};
+
+// A pool of idle probe workers.
+// Idle workers are only kept as long as there is at least one active Session
+// (e.g. during a plugin search), so we don't leave processes lying around.
+class ProbeWorkerPool {
+ public:
+    static ProbeWorkerPool& instance();
+
+    class Session {
+     public:
+        Session() { ProbeWorkerPool::instance().retain(); }
+        ~Session() { ProbeWorkerPool::instance().release(); }
+
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
+    };
+
+    // get an idle worker for the given CPU architecture or spawn a new one.
+    // throws an Error on failure!
+    ProbeWorker::ptr acquire(CpuArch arch);
+
+    // return a worker after it has finished a request
+    void recycle(ProbeWorker::ptr worker);
+ private:
+    ProbeWorkerPool() = default;
+
+    void retain();
+    void release();
+
+    std::mutex mutex_;
+    std::vector<ProbeWorker::ptr> idle_;
+    int numSessions_ = 0;
+};
+
+} // vst
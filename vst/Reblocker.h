@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+
+namespace vst {
+
+// Runs a plugin at a fixed block size which differs from the host block size.
+//
+// The caller owns the input and output FIFOs (one plugin block per channel);
+// the Reblocker only keeps track of the current FIFO position and calls back
+// into the caller. The plugin is processed whenever the input FIFO is full,
+// so arbitrary block sizes are supported, possibly with several plugin blocks
+// per host block.
+//
+// If the block sizes are multiples of each other, the output is read right after
+// processing, which gives the minimal latency of max(0, blockSize - hostBlockSize).
+// Otherwise, the output is read before processing and the latency is one full
+// plugin block.
+class Reblocker {
+ public:
+    void init(int blockSize, int hostBlockSize) {
+        blockSize_ = std::max(1, blockSize);
+        hostBlockSize_ = std::max(1, hostBlockSize);
+        aligned_ = (blockSize_ % hostBlockSize_) == 0
+                || (hostBlockSize_ % blockSize_) == 0;
+        reset();
+    }
+
+    void reset() {
+        // start one host block before the end, so that the first
+        // perform() call triggers plugin processing.
+        phase_ = aligned_ ? std::max(0, blockSize_ - hostBlockSize_) : 0;
+    }
+
+    int blockSize() const { return blockSize_; }
+
+    // position inside the current plugin block
+    int phase() const { return phase_; }
+
+    int latency() const {
+        return aligned_ ? std::max(0, blockSize_ - hostBlockSize_) : blockSize_;
+    }
+
+    // write(fifoOffset, hostOffset, n): copy host input to the input FIFO
+    // read(fifoOffset, hostOffset, n): copy the output FIFO to the host output
+    // process(): process the input FIFO into the output FIFO
+    template<typename Write, typename Read, typename Process>
+    void perform(int numSamples, Write&& write, Read&& read, Process&& process) {
+        int offset = 0;
+        while (offset < numSamples) {
+            int n = std::min(numSamples - offset, blockSize_ - phase_);
+            // NB: always write the input before reading the output
+            // because host inputs and outputs might alias!
+            write(phase_, offset, n);
+            if (!aligned_) {
+                read(phase_, offset, n);
+            }
+            phase_ += n;
+            if (phase_ == blockSize_) {
+                process();
+                phase_ = 0;
+            }
+            if (aligned_) {
+                read(phase_, offset, n);
+            }
+            offset += n;
+        }
+    }
+ private:
+    int blockSize_ = 1;
+    int hostBlockSize_ = 1;
+    int phase_ = 0;
+    bool aligned_ = true;
+};
+
+} // vst
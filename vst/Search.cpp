@@ -20,9 +20,22 @@ namespace fs = std::filesystem;
 #  include <sys/utsname.h>
 # endif
 
+#ifndef _WIN32
+# include <sys/stat.h> // for searchParallel()
+#endif
+
 #include <unordered_set>
 #include <cstring>
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// default number of threads for searchParallel(). Directory traversal is
+// mostly I/O bound (especially on network drives), so this is independent
+// of the number of CPUs.
+#define SEARCH_MAX_THREADS 8
 
 namespace vst {
 
@@ -345,6 +358,112 @@ private:
 
 #endif
 
+#if USE_STDFS
+using DirPath = fs::path;
+#else
+using DirPath = std::string;
+#endif
+
+using DirCallback = std::function<void(DirPath)>;
+
+#if LOGLEVEL > 2
+// for LOG_DEBUG
+static std::string toUtf8(const DirPath& path) {
+#if USE_STDFS
+    return path.u8string();
+#else
+    return path;
+#endif
+}
+#endif
+
+// search a single directory. plugin paths are passed to 'fn', subdirectories to 'dirFn'.
+// 'cancelled' (optional) is checked between directory entries.
+static void searchDirectory(const DirPath& dirname, const PathList& excludeList,
+                            bool filterByExtension, const SearchCallback& fn,
+                            const DirCallback& dirFn, const SearchCancelCallback& cancelled) {
+#if USE_STDFS
+    try {
+        // LOG_DEBUG("searching in " << shorten(dirname));
+        auto options = fs::directory_options::follow_directory_symlink;
+        fs::directory_iterator iter(dirname, options);
+        for (auto& entry : iter) {
+            if (cancelled && cancelled()) {
+                return;
+            }
+            auto& path = entry.path();
+
+            if (excludeList.contains(path)){
+                LOG_DEBUG("search: ignore '" << path.u8string() << "'");
+                continue;
+            }
+
+            // check the extension
+            if (hasPluginExtension(path.u8string())){
+                // found a VST plugin file or bundle
+                fn(path.u8string());
+            } else if (fs::is_directory(path)){
+                // otherwise search it if it's a directory
+                dirFn(path);
+            } else if (!filterByExtension && fs::is_regular_file(path)){
+                fn(path.u8string());
+            }
+        }
+    } catch (const fs::filesystem_error& e) {
+        LOG_WARNING(e.what());
+    };
+#else // USE_STDFS
+    // LOG_DEBUG("searching in " << dirname);
+    // search alphabetically (ignoring case)
+    struct dirent **dirlist;
+    auto sortnocase = [](const struct dirent** a, const struct dirent **b) -> int {
+        return strcasecmp((*a)->d_name, (*b)->d_name);
+    };
+    int n = scandir(dirname.c_str(), &dirlist, NULL, sortnocase);
+    if (n >= 0) {
+        int i = 0;
+        for (; i < n; ++i) {
+            if (cancelled && cancelled()) {
+                break;
+            }
+            auto entry = dirlist[i];
+            std::string path = dirname + "/" + entry->d_name;
+
+            if (excludeList.contains(entry)){
+                LOG_DEBUG("search: ignore '" << path << "'");
+            } else if (hasPluginExtension(path)){
+                // found a VST2 plugin (file or bundle)
+                fn(path);
+            } else if (isDirectory(path, entry)){
+                // otherwise search it if it's a directory
+                dirFn(path);
+            } else if (!filterByExtension && isFile(path)){
+                fn(path);
+            }
+            free(entry);
+        }
+        // free remaining entries after cancellation
+        for (; i < n; ++i) {
+            free(dirlist[i]);
+        }
+        free(dirlist);
+    }
+#endif // USE_STDFS
+}
+
+static DirPath searchRoot(const std::string& dir) {
+#if USE_STDFS
+    return widen(dir);
+#else
+    auto root = dir;
+    // removing trailing slashes
+    while (!root.empty() && root.back() == '/') {
+        root.pop_back();
+    }
+    return root;
+#endif
+}
+
 // recursively search a directory for VST plugins. for every plugin, 'fn' is called with the full absolute path.
 void search(const std::string &dir, SearchCallback fn,
             bool filterByExtension, const std::vector<std::string>& excludePaths) {
@@ -359,85 +478,133 @@ void search(const std::string &dir, SearchCallback fn,
         return;
     }
 
-#if USE_STDFS
-  #ifdef _WIN32
-    std::function<void(const std::wstring&)>
-  #else
-    std::function<void(const std::string&)>
-  #endif
-    searchDir = [&](const auto& dirname){
-        try {
-            // LOG_DEBUG("searching in " << shorten(dirname));
-            auto options = fs::directory_options::follow_directory_symlink;
-            fs::directory_iterator iter(dirname, options);
-            for (auto& entry : iter) {
-                auto& path = entry.path();
-
-                if (excludeList.contains(path)){
-                    LOG_DEBUG("search: ignore '" << path.u8string() << "'");
-                    continue;
-                }
+    DirCallback searchDir = [&](DirPath dirname) {
+        searchDirectory(dirname, excludeList, filterByExtension, fn, searchDir, nullptr);
+    };
 
-                // check the extension
-                if (hasPluginExtension(path.u8string())){
-                    // found a VST plugin file or bundle
-                    fn(path.u8string());
-                } else if (fs::is_directory(path)){
-                    // otherwise search it if it's a directory
-                    searchDir(path);
-                } else if (!filterByExtension && fs::is_regular_file(path)){
-                    fn(path.u8string());
-                }
-            }
-        } catch (const fs::filesystem_error& e) {
-            LOG_WARNING(e.what());
-        };
+    searchDir(searchRoot(dir));
+}
+
+// Directories which have already been visited by searchParallel().
+// Since we follow directory symlinks, a symlink pointing to one of its
+// parent directories would otherwise send us into an infinite loop.
+class VisitedDirectories {
+public:
+    // returns false if the directory has already been visited
+    bool insert(const DirPath& path) {
+    #ifdef _WIN32
+        std::error_code e;
+        auto key = fs::canonical(path, e).wstring();
+        if (e) {
+            key = path.wstring();
+        }
+    #else
+        struct stat buf;
+        if (stat(path.c_str(), &buf) != 0) {
+            return true; // let searchDirectory() handle the error
+        }
+        auto key = std::make_pair((uint64_t)buf.st_dev, (uint64_t)buf.st_ino);
+    #endif
+        std::lock_guard lock(mutex_);
+        return set_.insert(key).second;
+    }
+private:
+#ifdef _WIN32
+    using Key = std::wstring;
+    using Hash = std::hash<std::wstring>;
+#else
+    using Key = std::pair<uint64_t, uint64_t>;
+    struct Hash {
+        size_t operator()(const Key& key) const {
+            return std::hash<uint64_t>{}(key.first) ^ (std::hash<uint64_t>{}(key.second) * 31);
+        }
     };
+#endif
+    std::mutex mutex_;
+    std::unordered_set<Key, Hash> set_;
+};
 
-    searchDir(widen(dir));
-#else // USE_STDFS
-    std::function<void(const std::string&)> searchDir = [&](const std::string& dirname) {
-        // LOG_DEBUG("searching in " << dirname);
-        // search alphabetically (ignoring case)
-        struct dirent **dirlist;
-        auto sortnocase = [](const struct dirent** a, const struct dirent **b) -> int {
-            return strcasecmp((*a)->d_name, (*b)->d_name);
-        };
-        int n = scandir(dirname.c_str(), &dirlist, NULL, sortnocase);
-        if (n >= 0) {
-            for (int i = 0; i < n; ++i) {
-                auto entry = dirlist[i];
-                std::string path = dirname + "/" + entry->d_name;
-
-                if (excludeList.contains(entry)){
-                    LOG_DEBUG("search: ignore '" << path << "'");
-                    continue;
-                }
+void searchParallel(const std::string& dir, SearchCallback fn, bool filterByExtension,
+                    const std::vector<std::string>& excludePaths, int maxThreads,
+                    SearchCancelCallback cancelled) {
+    if (!pathExists(dir)){
+        // LOG_DEBUG("search: '" << dir << "' doesn't exist");
+        return;
+    }
 
-                // check the extension
-                if (hasPluginExtension(path)){
-                    // found a VST2 plugin (file or bundle)
-                    fn(path);
-                } else if (isDirectory(path, entry)){
-                    // otherwise search it if it's a directory
-                    searchDir(path);
-                } else if (!filterByExtension && isFile(path)){
-                    fn(path);
-                }
-                free(entry);
+    PathList excludeList(excludePaths);
+    if (excludeList.contains(dir)){
+        LOG_DEBUG("search: ignore '" << dir << "'");
+        return;
+    }
+
+    if (maxThreads <= 0) {
+        maxThreads = SEARCH_MAX_THREADS;
+    }
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<DirPath> queue;
+    int busy = 0; // number of threads which are currently listing a directory
+    VisitedDirectories visited;
+    std::mutex fnMutex;
+
+    // serialize calls to the user callback
+    SearchCallback callback = [&](const std::string& path) {
+        std::lock_guard lock(fnMutex);
+        fn(path);
+    };
+
+    DirCallback push = [&](DirPath path) {
+        if (visited.insert(path)) {
+            std::lock_guard lock(mutex);
+            queue.push_back(std::move(path));
+            cond.notify_one();
+        } else {
+            LOG_DEBUG("search: skip '" << toUtf8(path) << "' (already visited)");
+        }
+    };
+
+    auto worker = [&]() {
+        std::unique_lock lock(mutex);
+        for (;;) {
+            // wait for more directories; if the queue is empty and no other
+            // thread is busy, the traversal has finished.
+            cond.wait(lock, [&]() { return !queue.empty() || busy == 0; });
+            if (queue.empty() || (cancelled && cancelled())) {
+                queue.clear();
+                break;
+            }
+            auto dirname = std::move(queue.front());
+            queue.pop_front();
+            busy++;
+            lock.unlock();
+
+            try {
+                searchDirectory(dirname, excludeList, filterByExtension,
+                                callback, push, cancelled);
+            } catch (const std::exception& e) {
+                LOG_ERROR("search: " << e.what());
             }
-            free(dirlist);
+
+            lock.lock();
+            busy--;
+            // wake up idle threads so they can check for termination
+            cond.notify_all();
         }
     };
 
-    auto root = dir;
-    // removing trailing slashes
-    while (!root.empty() && root.back() == '/') {
-        root.pop_back();
-    }
+    push(searchRoot(dir));
 
-    searchDir(root);
-#endif // USE_STDFS
+    std::vector<std::thread> threads;
+    threads.reserve(maxThreads - 1);
+    for (int i = 1; i < maxThreads; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker(); // also work on the calling thread
+    for (auto& thread : threads) {
+        thread.join();
+    }
 }
 
 } // vst
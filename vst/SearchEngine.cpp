@@ -0,0 +1,136 @@
+#include "SearchEngine.h"
+
+#include "ProbeWorker.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// the sleep interval when polling probe jobs
+#define SEARCH_SLEEP_MS 2
+
+// post 'waiting' messages if no job has finished after this many seconds
+#define SEARCH_WAIT_TIME 4.0
+
+namespace vst {
+
+SearchEngine::SearchEngine(int maxJobs) {
+    if (maxJobs <= 0) {
+        maxJobs = std::thread::hardware_concurrency();
+    }
+    maxJobs_ = std::max<int>(1, maxJobs);
+}
+
+void SearchEngine::search(const std::string& dir, PathCallback fn,
+                          bool filterByExtension, const std::vector<std::string>& excludePaths)
+{
+    // keep idle probe processes alive until the search has finished
+    ProbeWorkerPool::Session session;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<std::string> paths;
+    bool finished = false;
+    int total = 0;
+    int done = 0;
+
+    // traverse the directory on a background thread
+    std::thread thread([&]() {
+        try {
+            // list subdirectories in parallel and stop in the middle
+            // of the traversal when the search has been cancelled.
+            vst::searchParallel(dir, [&](const std::string& path) {
+                std::lock_guard lock(mutex);
+                paths.push_back(path);
+                total++;
+                cond.notify_one();
+            }, filterByExtension, excludePaths, 0, [this]() { return cancelled(); });
+        } catch (const std::exception& e) {
+            LOG_ERROR("SearchEngine: " << e.what());
+        }
+        std::lock_guard lock(mutex);
+        finished = true;
+        cond.notify_one();
+    });
+
+    std::vector<std::pair<Job, std::string>> jobs;
+    jobs.reserve(maxJobs_);
+
+    auto progress = [&]() {
+        done++;
+        if (progressCallback_) {
+            int n;
+            {
+                std::lock_guard lock(mutex);
+                n = total;
+            }
+            progressCallback_(done, n);
+        }
+    };
+
+    auto last = std::chrono::steady_clock::now();
+
+    for (;;) {
+        // fill up job slots
+        while ((int)jobs.size() < maxJobs_) {
+            std::unique_lock lock(mutex);
+            if (paths.empty()) {
+                if (!jobs.empty() || finished) {
+                    break;
+                }
+                // nothing to do; wait for the next path
+                cond.wait(lock, [&]() { return !paths.empty() || finished; });
+                continue;
+            }
+            auto path = std::move(paths.front());
+            paths.pop_front();
+            lock.unlock();
+
+            if (!cancelled()) {
+                if (auto job = fn(path)) {
+                    jobs.emplace_back(std::move(job), std::move(path));
+                    continue;
+                }
+            }
+            progress();
+        }
+        if (jobs.empty()) {
+            break; // done
+        }
+        // poll jobs
+        bool didSomething = false;
+        for (auto it = jobs.begin(); it != jobs.end(); ) {
+            if (it->first()) {
+                it = jobs.erase(it);
+                progress();
+                didSomething = true;
+            } else {
+                ++it;
+            }
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (didSomething) {
+            last = now;
+        } else {
+            using seconds = std::chrono::duration<double>;
+            auto elapsed = std::chrono::duration_cast<seconds>(now - last).count();
+            if (elapsed > SEARCH_WAIT_TIME) {
+                if (waitCallback_) {
+                    for (auto& job : jobs) {
+                        waitCallback_(job.second);
+                    }
+                }
+                last = now;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(SEARCH_SLEEP_MS));
+        }
+    }
+
+    thread.join();
+}
+
+} // vst
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Interface.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace vst {
+
+// The SearchEngine walks the search directory on a background thread
+// (see vst::searchParallel()) while the plugins found so far are being probed, with up to 'maxJobs'
+// probe jobs in flight. Together with the ProbeWorkerPool, this means that
+// a full rescan is mostly bound by the plugins themselves.
+//
+// All callbacks - except for the cancel callback - are called on the thread
+// which runs search(), so the host doesn't need any additional synchronization.
+class SearchEngine {
+ public:
+    // A probe job is polled until it returns true.
+    using Job = std::function<bool()>;
+    // Called for every plugin path found in the search directory.
+    // Returns a probe job, or an empty function if the path has already
+    // been handled, e.g. because the plugin is in the cache.
+    using PathCallback = std::function<Job(const std::string& path)>;
+    // Called whenever a plugin path has been handled. 'total' is the number
+    // of paths found so far; it can grow until the search has finished.
+    using ProgressCallback = std::function<void(int done, int total)>;
+    // Called for every pending job if no job has finished for a few seconds.
+    using WaitCallback = std::function<void(const std::string& path)>;
+
+    // maxJobs = 0 -> number of logical CPUs
+    SearchEngine(int maxJobs = 0);
+
+    SearchEngine(const SearchEngine&) = delete;
+    SearchEngine& operator=(const SearchEngine&) = delete;
+
+    void setProgressCallback(ProgressCallback fn) {
+        progressCallback_ = std::move(fn);
+    }
+
+    void setWaitCallback(WaitCallback fn) {
+        waitCallback_ = std::move(fn);
+    }
+
+    // Set an additional cancellation predicate, e.g. a flag set by the host
+    // when the user stops the search. It is polled during the directory
+    // traversal, i.e. also before any plugin has been found, so it must be
+    // thread-safe!
+    void setCancelCallback(SearchCancelCallback fn) {
+        cancelCallback_ = std::move(fn);
+    }
+
+    int maxJobs() const { return maxJobs_; }
+
+    // recursively search 'dir' for plugins and probe them; blocks until finished.
+    // See vst::search() for the remaining arguments.
+    void search(const std::string& dir, PathCallback fn, bool filterByExtension = true,
+                const std::vector<std::string>& excludePaths = {});
+
+    // Stop the current search. Pending jobs are still finished, but new
+    // paths are ignored. Can be called from any thread.
+    void cancel() {
+        cancelled_.store(true);
+    }
+
+    bool cancelled() const {
+        return cancelled_.load() || (cancelCallback_ && cancelCallback_());
+    }
+ private:
+    int maxJobs_;
+    ProgressCallback progressCallback_;
+    WaitCallback waitCallback_;
+    SearchCancelCallback cancelCallback_;
+    std::atomic<bool> cancelled_{false};
+};
+
+} // vst
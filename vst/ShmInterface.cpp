@@ -1,9 +1,13 @@
 #include "ShmInterface.h"
 
 #include "Log.h"
+#include "MemoryPool.h"
 #include "MiscUtils.h"
+#include "Sync.h"
 
 #include <cstring>
+#include <thread>
+#include <algorithm>
 
 #if VST_HOST_SYSTEM == VST_WINDOWS
 # ifndef NOMINMAX
@@ -46,8 +50,22 @@ int futex(std::atomic<uint32_t>* uaddr, int futex_op, uint32_t val,
     return syscall(SYS_futex, uaddr, futex_op, val, timeout, uaddr2, val3);
 }
 
-void futex_wait(std::atomic<uint32_t>* futexp)
+// The futex word has three states:
+// 0: not signaled, 1: signaled, 2: not signaled + waiter is (about to go) sleeping.
+// This allows the poster to skip the FUTEX_WAKE system call if the waiter
+// is still spinning, see ShmInterface::create().
+void futex_wait(std::atomic<uint32_t>* futexp, uint32_t spinCount)
 {
+    // try to get the futex without sleeping
+    for (uint32_t i = 0; i < spinCount; ++i) {
+        if (futexp->load(std::memory_order_relaxed) == 1) {
+            uint32_t expected = 1;
+            if (futexp->compare_exchange_strong(expected, 0)){
+                return;
+            }
+        }
+        pauseCpu();
+    }
     for (;;) {
         // is futex available?
         uint32_t expected = 1;
@@ -55,9 +73,13 @@ void futex_wait(std::atomic<uint32_t>* futexp)
             // success
             break;
         }
-        // not available - wait
-        auto ret = futex(futexp, FUTEX_WAIT, 0, nullptr, nullptr, 0);
-        if (ret < 0 && errno != EAGAIN){
+        // not available - announce that we are going to sleep and wait.
+        // NB: if 'expected' is 2, we already did so in the last iteration.
+        if (expected == 0 && !futexp->compare_exchange_strong(expected, 2)) {
+            continue; // state has changed, try again
+        }
+        auto ret = futex(futexp, FUTEX_WAIT, 2, nullptr, nullptr, 0);
+        if (ret < 0 && errno != EAGAIN && errno != EINTR){
             throw Error(Error::SystemError,
                         "futex_wait() failed: " + errorMessage(errno));
         }
@@ -66,9 +88,8 @@ void futex_wait(std::atomic<uint32_t>* futexp)
 
 void futex_post(std::atomic<uint32_t>* futexp)
 {
-    uint32_t expected = 0;
-    if (futexp->compare_exchange_strong(expected, 1)) {
-       // wake one waiter
+    if (futexp->exchange(1) == 2) {
+       // wake the sleeping waiter
        if (futex(futexp, FUTEX_WAKE, 1, nullptr, nullptr, 0) < 0) {
            throw Error(Error::SystemError,
                        "futex_post() failed: " + errorMessage(errno));
@@ -85,7 +106,8 @@ constexpr size_t align_to(size_t s, size_t alignment){
 /*/////////////// ShmChannel ////////////*/
 
 
-ShmChannel::ShmChannel(Type type, int32_t size, std::string_view name)
+ShmChannel::ShmChannel(Type type, int32_t size, std::string_view name,
+                       int32_t audioSize)
     : owner_(true), type_(type), bufferSize_(size), name_(name)
 {
 #if SHM_FUTEX || SHM_EVENT
@@ -95,6 +117,11 @@ ShmChannel::ShmChannel(Type type, int32_t size, std::string_view name)
 #endif
     auto total = sizeof(Header) + sizeof(Data) + size;
     totalSize_ = align_to(total, alignment);
+    // the audio bus follows the message buffer
+    if (audioSize > 0 && type == Request){
+        audioSize_ = align_to(audioSize, alignment);
+        totalSize_ += audioSize_;
+    }
 }
 
 void ShmChannel::HandleDeleter::operator ()(void *handle){
@@ -271,10 +298,13 @@ void ShmChannel::waitReply(){
 
 void ShmChannel::init(ShmInterface& shm, char *data, int num){
     LOG_SHM("init channel " << num);
+    shmPath_ = shm.path();
+    num_ = num;
     header_ = reinterpret_cast<Header *>(data);
     if (owner_){
         // placement new
-        new (header_) Header(type_, name_.c_str(), totalSize_);
+        new (header_) Header(type_, name_.c_str(), totalSize_,
+                             totalSize_ - audioSize_, audioSize_);
     #if SHM_SEMAPHORE
         // POSIX expects leading slash
         snprintf(header_->data1, sizeof(header_->data1),
@@ -291,10 +321,15 @@ void ShmChannel::init(ShmInterface& shm, char *data, int num){
             throw Error(Error::SystemError, "shared memory interface not compatible (wrong header size)!");
         }
         totalSize_ = header_->size;
+        audioSize_ = header_->audioSize;
         type_ = (Type)header_->type;
         name_ = header_->name;
     }
 
+    if (audioSize_ > 0){
+        audio_ = data + header_->audioOffset;
+    }
+
     initEvent(shm, eventA_, &header_->data1);
     if (type_ == Request){
         initEvent(shm, eventB_, &header_->data2);
@@ -310,10 +345,208 @@ void ShmChannel::init(ShmInterface& shm, char *data, int num){
 
     LOG_SHM("init ShmChannel " << num << " (" << name_
               << "): buffer size = " << data_->capacity
+              << ", audio size = " << audioSize_
               << ", total size = " << totalSize_
               << ", start address = " << (void *)data);
 }
 
+std::string ShmChannel::segmentPath(uint32_t generation) const {
+    // NB: keep it short; macOS only allows 31 characters.
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s_%d_%u", shmPath_.c_str(), num_, generation);
+    return buf;
+}
+
+// layout: Data + message buffer, followed by the (aligned) audio bus
+static size_t segmentAudioOffset(size_t bufferSize){
+    return align_to(sizeof(ShmChannel::Data) + bufferSize, ShmChannel::alignment);
+}
+
+bool ShmChannel::reserve(size_t bufferSize, size_t audioSize){
+    if (!owner_ || type_ != Request){
+        LOG_ERROR("ShmChannel: only the owner can grow Request channels");
+        return false;
+    }
+    auto capacity = data_->capacity;
+    if (bufferSize <= capacity && audioSize <= (size_t)audioSize_){
+        return true; // nothing to do
+    }
+    if (bufferSize > maxSegmentSize || audioSize > maxSegmentSize){
+        LOG_WARNING("ShmChannel (" << name_ << "): requested size too large");
+        return false;
+    }
+    // grow exponentially to avoid frequent reallocations
+    auto grow = [](size_t oldSize, size_t newSize) -> size_t {
+        if (newSize <= oldSize){
+            return oldSize;
+        }
+        size_t result = std::max<size_t>(oldSize, 1024);
+        while (result < newSize){
+            result *= 2;
+        }
+        return std::min(result, maxSegmentSize);
+    };
+    auto newBufferSize = grow(capacity, bufferSize);
+    auto newAudioSize = align_to(grow(audioSize_, audioSize), alignment);
+    auto audioOffset = segmentAudioOffset(newBufferSize);
+
+    Segment segment;
+    auto generation = generation_ + 1;
+    if (!segment.open(segmentPath(generation),
+                      audioOffset + newAudioSize, true)){
+        return false;
+    }
+    LOG_DEBUG("ShmChannel (" << name_ << "): grow buffer from "
+              << capacity << " to " << newBufferSize << " bytes, audio bus from "
+              << audioSize_ << " to " << newAudioSize << " bytes");
+    // copy existing messages and audio data
+    auto data = new (segment.data) Data();
+    data->capacity = newBufferSize;
+    memcpy(data->data, data_->data, wrhead_);
+    data->size.store(data_->size.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+    auto audio = segment.data + audioOffset;
+    if (audioSize_ > 0){
+        memcpy(audio, audio_, audioSize_);
+    }
+    // publish; the other side picks up the new segment in wait().
+    header_->segmentBufferSize = newBufferSize;
+    header_->segmentAudioSize = newAudioSize;
+    header_->generation.store(generation, std::memory_order_release);
+    // NB: the previous segment (if any) is unlinked and unmapped here;
+    // the other side keeps its own mapping until it switches.
+    segment_ = std::move(segment);
+    generation_ = generation;
+    data_ = data;
+    audio_ = audio;
+    audioSize_ = newAudioSize;
+
+    return true;
+}
+
+size_t ShmChannel::messageSize(size_t size){
+    return align_to(size + sizeof(Message::size), Message::alignment);
+}
+
+bool ShmChannel::reserveMessage(size_t size){
+    return reserve(data_->size.load(std::memory_order_relaxed) + messageSize(size));
+}
+
+bool ShmChannel::updateSegment(){
+    if (owner_ || type_ != Request){
+        return true;
+    }
+    auto generation = header_->generation.load(std::memory_order_acquire);
+    if (generation == generation_){
+        return true;
+    }
+    auto bufferSize = header_->segmentBufferSize;
+    auto audioSize = header_->segmentAudioSize;
+    auto audioOffset = segmentAudioOffset(bufferSize);
+    Segment segment;
+    if (!segment.open(segmentPath(generation), audioOffset + audioSize, false)){
+        LOG_ERROR("ShmChannel (" << name_ << "): couldn't map new segment");
+        return false;
+    }
+    LOG_DEBUG("ShmChannel (" << name_ << "): switch to segment " << generation
+              << " (buffer size: " << bufferSize << ", audio size: " << audioSize << ")");
+    segment_ = std::move(segment);
+    generation_ = generation;
+    data_ = reinterpret_cast<Data *>(segment_.data);
+    audio_ = audioSize > 0 ? segment_.data + audioOffset : nullptr;
+    audioSize_ = audioSize;
+    return true;
+}
+
+bool ShmChannel::Segment::open(const std::string& _path, size_t _size, bool create){
+#if VST_HOST_SYSTEM == VST_WINDOWS
+    HANDLE hMapFile;
+    if (create){
+        hMapFile = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                      0, _size, _path.c_str());
+    } else {
+        hMapFile = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, _path.c_str());
+    }
+    if (!hMapFile){
+        LOG_ERROR("ShmChannel: couldn't open segment " << _path << ": "
+                  << errorMessage(GetLastError()));
+        return false;
+    }
+    auto ptr = MapViewOfFile(hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, _size);
+    if (!ptr){
+        LOG_ERROR("ShmChannel: MapViewOfFile() failed: "
+                  << errorMessage(GetLastError()));
+        CloseHandle(hMapFile);
+        return false;
+    }
+    // try to lock into physical memory (see ShmInterface::openShm())
+    VirtualLock(ptr, _size);
+    handle = hMapFile;
+#else
+    int fd = create ? shm_open(_path.c_str(), O_CREAT | O_RDWR | O_EXCL, 0666)
+                    : shm_open(_path.c_str(), O_RDWR, 0666);
+    if (fd < 0){
+        LOG_ERROR("ShmChannel: couldn't open segment " << _path << ": "
+                  << errorMessage(errno));
+        return false;
+    }
+    if (create && ftruncate(fd, _size) != 0){
+        LOG_ERROR("ShmChannel: ftruncate() failed: " << errorMessage(errno));
+        ::close(fd);
+        shm_unlink(_path.c_str());
+        return false;
+    }
+    auto ptr = mmap(0, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED){
+        LOG_ERROR("ShmChannel: mmap() failed: " << errorMessage(errno));
+        if (create){
+            shm_unlink(_path.c_str());
+        }
+        return false;
+    }
+    // try to lock into physical memory (see ShmInterface::openShm())
+    if (mlock(ptr, _size) != 0){
+        LOG_SHM("ShmChannel: mlock() failed: " << strerror(errno));
+    }
+#endif
+    if (create){
+        memset(ptr, 0, _size); // page in
+    }
+    path = _path;
+    data = (char *)ptr;
+    size = _size;
+    owner = create;
+    return true;
+}
+
+void ShmChannel::Segment::close(){
+    if (!data){
+        return;
+    }
+#if VST_HOST_SYSTEM == VST_WINDOWS
+    UnmapViewOfFile(data);
+    CloseHandle((HANDLE)handle);
+#else
+    munmap(data, size);
+    if (owner){
+        // NB: the other side might still have it mapped
+        shm_unlink(path.c_str());
+    }
+#endif
+    data = nullptr;
+    size = 0;
+    handle = nullptr;
+}
+
+void ShmChannel::Segment::swap(Segment& other) noexcept {
+    std::swap(path, other.path);
+    std::swap(data, other.data);
+    std::swap(size, other.size);
+    std::swap(handle, other.handle);
+    std::swap(owner, other.owner);
+}
+
 void ShmChannel::initEvent(ShmInterface& shm, Handle& event, void *data){
     // LOG_SHM("ShmChannel: init event " << which);
 #if SHM_EVENT
@@ -383,6 +616,13 @@ void ShmChannel::postEvent(void *event){
 
 void ShmChannel::waitEvent(void *event){
 #if SHM_EVENT
+    // try to get the event without blocking
+    for (uint32_t i = 0; i < spinCount_; ++i){
+        if (WaitForSingleObject(event, 0) == WAIT_OBJECT_0){
+            return;
+        }
+        pauseCpu();
+    }
     auto result = WaitForSingleObject(event, INFINITE);
     if (result != WAIT_OBJECT_0){
         if (result == WAIT_ABANDONED){
@@ -393,29 +633,45 @@ void ShmChannel::waitEvent(void *event){
         }
     }
 #elif SHM_SEMAPHORE
+    // try to get the semaphore without blocking
+    for (uint32_t i = 0; i < spinCount_; ++i){
+        if (sem_trywait((sem_t *)event) == 0){
+            return;
+        }
+        pauseCpu();
+    }
     if (sem_wait((sem_t *)event) != 0){
         throw Error(Error::SystemError, "sem_wait() failed: "
                     + errorMessage(errno));
     }
 #elif SHM_FUTEX
-    futex_wait(static_cast<std::atomic<uint32_t>*>(event));
+    futex_wait(static_cast<std::atomic<uint32_t>*>(event), spinCount_);
 #endif
 }
 
 /*//////////////// ShmInterface //////////////////*/
 
-ShmInterface::Header::Header(uint32_t _size, uint32_t _numChannels) {
+ShmInterface::Header::Header(uint32_t _size, uint32_t _numChannels,
+                             uint32_t _spinCount, uint8_t _flags) {
     size = _size;
     versionMajor = VERSION_MAJOR;
     versionMinor = VERSION_MINOR;
     versionPatch = VERSION_PATCH;
+    flags = _flags;
 #if SHM_EVENT
     processID = GetCurrentProcessId();
 #endif
     numChannels = _numChannels;
+    spinCount = _spinCount;
     memset(channelOffset, 0, sizeof(channelOffset));
 }
 
+// spinning is pointless (and harmful) on single core systems
+// because the other side can't make progress while we spin.
+static uint32_t effectiveSpinCount(uint32_t spinCount){
+    return std::thread::hardware_concurrency() > 1 ? spinCount : 0;
+}
+
 ShmInterface::ShmInterface(){}
 
 ShmInterface::~ShmInterface(){
@@ -439,6 +695,12 @@ void ShmInterface::connect(const std::string &path){
     LOG_SHM("ShmInterface: connected to " << path);
     auto header = reinterpret_cast<Header *>(data_);
     LOG_SHM("total size: " << header->size);
+    flags_ = header->flags;
+    if (flags_ & HugePages){
+        // NB: the memory has already been paged in by the owner,
+        // so this only takes effect once the pages are collapsed.
+        adviseHugePages(data_, size_);
+    }
 
 #if SHM_EVENT
     // needed for channel events
@@ -453,6 +715,7 @@ void ShmInterface::connect(const std::string &path){
     for (size_t i = 0; i < header->numChannels; ++i){
         channels_.emplace_back();
         channels_[i].init(*this, data_ + header->channelOffset[i], i);
+        channels_[i].setSpinCount(effectiveSpinCount(header->spinCount));
     }
 }
 
@@ -469,7 +732,8 @@ void ShmInterface::disconnect(){
 }
 
 void ShmInterface::addChannel(ShmChannel::Type type,
-                              size_t size, std::string_view name)
+                              size_t size, std::string_view name,
+                              size_t audioSize)
 {
     if (data_){
         throw Error(Error::SystemError,
@@ -480,13 +744,14 @@ void ShmInterface::addChannel(ShmChannel::Type type,
         throw Error(Error::SystemError,
                     "ShmInterface: max. number of channels reached!");
     }
-    channels_.emplace_back(type, size, name);
+    channels_.emplace_back(type, size, name, audioSize);
 }
 
-void ShmInterface::create(){
+void ShmInterface::create(uint32_t spinCount, uint8_t flags){
     if (data_){
         throw Error(Error::SystemError, "ShmInterface: already created()!");
     }
+    flags_ = flags; // see openShm()
 
     char path[64];
     // POSIX expects leading slash
@@ -497,11 +762,12 @@ void ShmInterface::create(){
     LOG_SHM("total size: " << size_);
 
     // placement new
-    auto header = new (data_) Header(size_, channels_.size());
+    auto header = new (data_) Header(size_, channels_.size(), spinCount, flags);
     char *ptr = data_ + sizeof(Header);
 
     for (size_t i = 0; i < channels_.size(); ++i){
         channels_[i].init(*this, ptr, i);
+        channels_[i].setSpinCount(effectiveSpinCount(spinCount));
         header->channelOffset[i] = ptr - data_;
         ptr += channels_[i].size();
     }
@@ -622,8 +888,9 @@ void ShmInterface::openShm(const std::string &path, bool create){
     // memory map the shared memory object
     int err = 0;
     void *data = mmap(0, totalSize, PROT_WRITE, MAP_SHARED, fd, 0);
-    if (!data) {
+    if (data == MAP_FAILED) {
         err = errno; // cache errno
+        data = nullptr;
     } else if (!create) {
         // get actual total size
         auto oldSize = totalSize;
@@ -631,8 +898,9 @@ void ShmInterface::openShm(const std::string &path, bool create){
         munmap(data, oldSize);
         // map again with correct size
         data = mmap(0, totalSize, PROT_WRITE, MAP_SHARED, fd, 0);
-        if (!data) {
+        if (data == MAP_FAILED) {
             err = errno; // cache errno
+            data = nullptr;
         }
     }
     // we can close the fd after calling mmap()!
@@ -665,6 +933,10 @@ void ShmInterface::openShm(const std::string &path, bool create){
     size_ = totalSize;
 
     if (create){
+        if (flags_ & HugePages){
+            // must be called before the memory is paged in
+            adviseHugePages(data, totalSize);
+        }
         // zero the memory region. this also ensures
         // that everything will be paged in.
         memset(data, 0, totalSize);
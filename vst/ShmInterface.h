@@ -51,30 +51,39 @@ class ShmChannel {
     };
     // immutable data
     struct Header {
-        Header(Type _type, const char *_name, uint32_t _size)
-            : size(_size), offset(sizeof(Header)), type(_type) {
+        Header(Type _type, const char *_name, uint32_t _size,
+               uint32_t _audioOffset, uint32_t _audioSize)
+            : size(_size), offset(sizeof(Header)), type(_type),
+              audioOffset(_audioOffset), audioSize(_audioSize) {
             snprintf(name, sizeof(name), "%s", _name);
         }
         uint32_t size;
         uint32_t offset; // = sizeof(Header) = 128 resp. 64
         uint32_t type;
         char name[20];
+        // optional audio bus (relative to the channel start)
+        uint32_t audioOffset;
+        uint32_t audioSize;
     #if SHM_FUTEX
         // atomic integers for Futex
         std::atomic<uint32_t> data1{0};
         std::atomic<uint32_t> data2{0};
-        char padding[24];
     #elif SHM_EVENT
         // Event handles
         uint32_t data1{0};
         uint32_t data2{0};
-        char padding[24];
     #elif SHM_SEMAPHORE
         // semaphore names
         char data1[32];
         char data2[32];
-        char padding[32];
+        char padding[8];
     #endif
+        // The message buffer and audio bus can be moved to a larger,
+        // separate segment, see ShmChannel::reserve(). 0 = initial segment.
+        std::atomic<uint32_t> generation{0};
+        uint32_t segmentBufferSize = 0;
+        uint32_t segmentAudioSize = 0;
+        uint32_t reserved = 0;
     };
     // mutable data
     struct Data {
@@ -94,7 +103,8 @@ class ShmChannel {
     static const size_t alignment = 64;
 
     ShmChannel() = default;
-    ShmChannel(Type type, int32_t size, std::string_view name);
+    ShmChannel(Type type, int32_t size, std::string_view name,
+               int32_t audioSize = 0);
     ShmChannel(const ShmChannel&) = delete;
     ShmChannel(ShmChannel&&) = default;
     ~ShmChannel();
@@ -104,8 +114,18 @@ class ShmChannel {
     Type type() const { return type_; }
     int32_t size() const { return totalSize_; }
     int32_t capacity() const { return data_->capacity; }
+    // number of bytes used by request messages
+    int32_t used() const { return data_->size.load(std::memory_order_relaxed); }
+    // size of a request message (incl. header and alignment)
+    static size_t messageSize(size_t size);
     const std::string& name() const { return name_; }
 
+    // The audio bus is a fixed memory region that both sides can address
+    // directly, so audio data doesn't have to be copied into (and out of)
+    // the message buffer. Only available for Request channels.
+    void * audioBuffer() { return audio_; }
+    int32_t audioCapacity() const { return audioSize_; }
+
     size_t peekMessage() const;
     // read queue message (thread-safe, copy)
     bool readMessage(void * buffer, size_t& size);
@@ -126,21 +146,68 @@ class ShmChannel {
     void waitReply();
 
     void init(ShmInterface& shm, char *data, int num);
+
+    void setSpinCount(uint32_t count) { spinCount_ = count; }
+
+    // Make sure that the message buffer and the audio bus have (at least)
+    // the given sizes by moving them to a larger shared memory segment.
+    // Existing messages and audio data are preserved. The other side maps
+    // the new segment when it receives the next request, see updateSegment().
+    // Only the owner may call this on Request channels, and only while
+    // the other side is not using the channel, i.e. between requests.
+    // Returns false if the new segment couldn't be created.
+    // NB: this is not realtime safe!
+    bool reserve(size_t bufferSize, size_t audioSize = 0);
+    // grow the message buffer so that a message of the given size fits in.
+    bool reserveMessage(size_t size);
+    // Map the new segment after reserve() has been called on the other side.
+    // Call after wait() and before reading the request. Returns false if the
+    // segment couldn't be mapped; in this case the channel can't be used anymore.
+    // NB: this is not realtime safe if there is a new segment!
+    bool updateSegment();
+    // max. size of the message buffer resp. the audio bus
+    static const size_t maxSegmentSize = 64 * 1024 * 1024;
  private:
     struct HandleDeleter { void operator()(void *); };
     using Handle = std::unique_ptr<void, HandleDeleter>;
 
+    struct Segment {
+        Segment() = default;
+        Segment(Segment&& other) noexcept { swap(other); }
+        Segment& operator=(Segment&& other) noexcept { swap(other); return *this; }
+        ~Segment() { close(); }
+
+        bool open(const std::string& path, size_t size, bool create);
+        void close();
+        void swap(Segment& other) noexcept;
+
+        std::string path;
+        char *data = nullptr;
+        size_t size = 0;
+        void *handle = nullptr;
+        bool owner = false;
+    };
+    std::string segmentPath(uint32_t generation) const;
+
     bool owner_ = false;
     Type type_ = Queue;
     int32_t totalSize_ = 0;
     int32_t bufferSize_ = 0;
+    int32_t audioSize_ = 0;
     std::string name_;
     Handle eventA_;
     Handle eventB_;
     Header *header_ = nullptr;
     Data *data_ = nullptr;
+    char *audio_ = nullptr;
     uint32_t rdhead_ = 0;
     uint32_t wrhead_ = 0;
+    uint32_t spinCount_ = 0;
+    // additional segment, see reserve()
+    Segment segment_;
+    uint32_t generation_ = 0;
+    std::string shmPath_;
+    int num_ = 0;
     // helper methods
     void initEvent(ShmInterface& shm, Handle& event, void *data);
     void postEvent(void *event);
@@ -151,20 +218,27 @@ class ShmInterface {
  public:
     static const int32_t maxNumChannels = 60;
 
+    enum Flags : uint8_t {
+        LockMemory = 1, // see setMemoryLocking()
+        HugePages = 2
+    };
+
     struct Header {
-        Header(uint32_t _size, uint32_t _numChannels);
+        Header(uint32_t _size, uint32_t _numChannels,
+               uint32_t _spinCount, uint8_t _flags);
 
         uint32_t size;
         uint8_t versionMajor;
         uint8_t versionMinor;
         uint8_t versionPatch;
-        uint8_t unused;
+        uint8_t flags;
     #if SHM_EVENT
         int32_t processID;
     #else
         uint32_t reserved;
     #endif
         uint32_t numChannels;
+        uint32_t spinCount;
         uint32_t channelOffset[maxNumChannels];
     };
 
@@ -181,8 +255,14 @@ class ShmInterface {
 
     // create shared memory interface
     void addChannel(ShmChannel::Type type,
-                    size_t size, std::string_view name);
-    void create();
+                    size_t size, std::string_view name,
+                    size_t audioSize = 0);
+    // 'spinCount' is the number of times a channel polls for an event before
+    // it goes to sleep (0 = sleep immediately). Spinning can considerably reduce
+    // the round trip latency for short requests, at the cost of CPU time.
+    // The setting is stored in the shared memory, so it applies to both sides.
+    // The same goes for 'flags', see ShmInterface::Flags.
+    void create(uint32_t spinCount = 0, uint8_t flags = 0);
     void close();
 
     const std::string& path() const { return path_; }
@@ -205,6 +285,8 @@ class ShmInterface {
 
     void getVersion(int& major, int& minor, int& patch) const;
 
+    uint8_t flags() const { return flags_; }
+
 #if SHM_EVENT
     void * getParentProcessHandle() const { return hParentProcess_; }
 #endif
@@ -221,6 +303,7 @@ class ShmInterface {
 #endif
     size_t size_ = 0;
     char *data_ = nullptr;
+    uint8_t flags_ = 0;
 
     void openShm(const std::string& path, bool create);
     void closeShm();
@@ -0,0 +1,40 @@
+#include "Snapshot.h"
+
+namespace vst {
+
+bool SnapshotStore::save(int slot, const IPlugin& plugin, std::string chunk) {
+    if (slot < 0 || slot >= maxNumSlots) {
+        return false;
+    }
+    int numParams = plugin.info().numParameters();
+    // get the parameters before taking the lock
+    std::vector<float> params(numParams);
+    plugin.getParameters(0, numParams, params.data());
+
+    std::lock_guard lock(lock_);
+    auto& s = slots_[slot];
+    s.params.swap(params);
+    s.chunk.swap(chunk);
+    s.valid = true;
+    // preallocate scratch buffer for recall()
+    if ((int)current_.size() < numParams) {
+        current_.resize(numParams);
+    }
+    return true;
+}
+
+void SnapshotStore::clear(int slot) {
+    if (slot >= 0 && slot < maxNumSlots) {
+        std::lock_guard lock(lock_);
+        slots_[slot] = Slot{};
+    }
+}
+
+void SnapshotStore::clearAll() {
+    std::lock_guard lock(lock_);
+    for (auto& s : slots_) {
+        s = Slot{};
+    }
+}
+
+} // vst
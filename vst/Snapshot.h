@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Interface.h"
+#include "PluginDesc.h"
+#include "Sync.h"
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vst {
+
+// In-memory plugin state snapshots, e.g. for A/B comparison and morphing.
+//
+// A snapshot contains the parameter vector and (optionally) the plugin
+// state chunk. On recall, we only send the parameters which differ from
+// the current state; the chunk is only needed if the plugin has state
+// which is not covered by its parameters.
+//
+// save() and chunk() are not realtime safe; recall() and morph() are
+// realtime safe and can run concurrently with save(). If the store is
+// being modified, they simply fail.
+class SnapshotStore {
+ public:
+    static const int maxNumSlots = 16;
+
+    // store the current parameter values and the given state chunk
+    // (may be empty) in a slot. Returns false if the slot is out of range.
+    // NB: not realtime safe!
+    bool save(int slot, const IPlugin& plugin, std::string chunk);
+
+    void clear(int slot);
+    void clearAll();
+
+    bool valid(int slot) const {
+        return slot >= 0 && slot < maxNumSlots && slots_[slot].valid;
+    }
+
+    // NB: must not be called concurrently with save()!
+    std::string_view chunk(int slot) const {
+        return valid(slot) ? slots_[slot].chunk : std::string_view{};
+    }
+
+    // Recall the parameters of a snapshot, calling fn(index, value) for every
+    // parameter which differs from the current state. Returns the number of
+    // parameter changes or -1 on failure.
+    template<typename Fn>
+    int recall(int slot, const IPlugin& plugin, Fn&& fn) {
+        return morph(slot, slot, 0.f, plugin, std::forward<Fn>(fn));
+    }
+
+    // Interpolate linearly between two snapshots; 'x' is clipped to [0, 1].
+    // Otherwise the same as recall().
+    template<typename Fn>
+    int morph(int slotA, int slotB, float x, const IPlugin& plugin, Fn&& fn);
+ private:
+    bool check(int slot, int numParams) const {
+        return valid(slot) && (int)slots_[slot].params.size() == numParams;
+    }
+
+    struct Slot {
+        std::vector<float> params;
+        std::string chunk;
+        bool valid = false;
+    };
+    Slot slots_[maxNumSlots];
+    std::vector<float> current_; // preallocated, see save()
+    SpinLock lock_;
+};
+
+template<typename Fn>
+int SnapshotStore::morph(int slotA, int slotB, float x, const IPlugin& plugin, Fn&& fn) {
+    if (!lock_.try_lock()) {
+        return -1; // the store is being modified
+    }
+    std::lock_guard lock(lock_, std::adopt_lock);
+
+    int numParams = plugin.info().numParameters();
+    if (!check(slotA, numParams) || !check(slotB, numParams) ||
+            (int)current_.size() < numParams) {
+        return -1;
+    }
+    x = std::max(0.f, std::min(1.f, x));
+    auto& a = slots_[slotA].params;
+    auto& b = slots_[slotB].params;
+
+    plugin.getParameters(0, numParams, current_.data());
+
+    int count = 0;
+    for (int i = 0; i < numParams; ++i) {
+        float value = a[i] + (b[i] - a[i]) * x;
+        if (value != current_[i]) {
+            fn(i, value);
+            count++;
+        }
+    }
+    return count;
+}
+
+} // vst
@@ -34,6 +34,7 @@
 #endif
 
 #include <atomic>
+#include <chrono>
 #include <mutex>
 #include <shared_mutex>
 #include <thread>
@@ -226,6 +227,77 @@ class alignas(CACHELINE_SIZE) PaddedSpinLock
     char pad_[CACHELINE_SIZE - sizeof(locked_)];
 };
 
+/*///////////////////// WaitPolicy /////////////////////*/
+
+// spin-then-yield-then-block policy for waiting on a LightSemaphore or Event.
+// Spinning and yielding reduce the wake-up latency at the cost of CPU time.
+struct WaitPolicy {
+    double spinTime = 0; // max. time to spin (in seconds)
+    double yieldTime = 0; // max. time to yield (in seconds) after spinning
+};
+
+struct WaitStats {
+    std::atomic<uint64_t> spins{0}; // number of waits that succeeded while spinning
+    std::atomic<uint64_t> yields{0}; // number of waits that succeeded while yielding
+    std::atomic<uint64_t> sleeps{0}; // number of waits that had to block
+
+    void clear() {
+        spins.store(0, std::memory_order_relaxed);
+        yields.store(0, std::memory_order_relaxed);
+        sleeps.store(0, std::memory_order_relaxed);
+    }
+};
+
+// wait on a LightSemaphore or Event according to the given policy.
+// 'stats' is optional; NB: the counters are updated with relaxed atomic
+// RMW operations because several threads may share the same WaitStats.
+template<typename T>
+void waitWithPolicy(T& sync, const WaitPolicy& policy, WaitStats *stats = nullptr) {
+    auto count = [stats](std::atomic<uint64_t> WaitStats::*counter) {
+        if (stats) {
+            (stats->*counter).fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+    if (policy.spinTime > 0 || policy.yieldTime > 0) {
+        using clock = std::chrono::steady_clock;
+        auto start = clock::now();
+        auto elapsed = [&]() {
+            return std::chrono::duration<double>(clock::now() - start).count();
+        };
+        // spin
+        if (policy.spinTime > 0) {
+            for (int i = 0;; ++i) {
+                if (sync.try_wait()) {
+                    count(&WaitStats::spins);
+                    return;
+                }
+                pauseCpu();
+                // only check the time occasionally
+                if ((i & 15) == 15 && elapsed() >= policy.spinTime) {
+                    break;
+                }
+            }
+        }
+        // yield
+        if (policy.yieldTime > 0) {
+            auto end = policy.spinTime + policy.yieldTime;
+            for (;;) {
+                if (sync.try_wait()) {
+                    count(&WaitStats::yields);
+                    return;
+                }
+                std::this_thread::yield();
+                if (elapsed() >= end) {
+                    break;
+                }
+            }
+        }
+    }
+    // block
+    count(&WaitStats::sleeps);
+    sync.wait();
+}
+
 /*//////////////////////// SharedMutex //////////////////////////*/
 
 // The std::mutex implementation on Windows is bad on both MSVC and MinGW:
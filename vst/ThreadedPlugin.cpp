@@ -2,8 +2,14 @@
 
 #include "Log.h"
 #include "MiscUtils.h"
+#include "PluginDesc.h"
+#include "ParamCache.h"
+#include "DSPLoad.h"
+#include "Trace.h"
+#include "FileUtils.h"
 
 #include <string.h>
+#include <algorithm>
 #include <fstream>
 #include <assert.h>
 
@@ -43,7 +49,92 @@ int getNumDSPThreads() {
     }
 }
 
+static std::atomic<DSPScheduler> gDSPScheduler{DSPScheduler::Shared};
+
+// set the DSP thread pool scheduler
+void setDSPScheduler(DSPScheduler scheduler) {
+    LOG_DEBUG("setDSPScheduler: " << (int)scheduler);
+    gDSPScheduler.store(scheduler);
+}
+
+DSPScheduler getDSPScheduler() {
+    return gDSPScheduler.load();
+}
+
+static std::mutex gDSPThreadAffinityMutex;
+static DSPThreadAffinity gDSPThreadAffinity;
+
+// pin DSP threads to CPUs
+void setDSPThreadAffinity(const DSPThreadAffinity& affinity) {
+    std::lock_guard lock(gDSPThreadAffinityMutex);
+    gDSPThreadAffinity = affinity;
+}
+
+// get the list of CPUs for the DSP helper threads; empty = no pinning.
+static std::vector<int> getDSPThreadCpus() {
+    std::lock_guard lock(gDSPThreadAffinityMutex);
+    auto& affinity = gDSPThreadAffinity;
+    std::vector<int> result;
+    if (affinity.empty()) {
+        return result;
+    }
+    auto contains = [](auto& vec, const auto& value) {
+        return std::find(vec.begin(), vec.end(), value) != vec.end();
+    };
+    std::vector<std::pair<int, int>> usedCores; // (node, core)
+    for (auto& cpu : getCpuTopology()) {
+        if (!affinity.cpus.empty() && !contains(affinity.cpus, cpu.index)) {
+            continue;
+        }
+        if (contains(affinity.exclude, cpu.index)) {
+            continue;
+        }
+        if (affinity.numaNode >= 0 && cpu.node != affinity.numaNode) {
+            continue;
+        }
+        if (affinity.skipSMT) {
+            std::pair<int, int> core(cpu.node, cpu.core);
+            if (contains(usedCores, core)) {
+                continue; // SMT sibling
+            }
+            usedCores.push_back(core);
+        }
+        result.push_back(cpu.index);
+    }
+    if (result.empty()) {
+        LOG_WARNING("DSP thread affinity: no matching CPUs - ignoring");
+    }
+    return result;
+}
+
+static std::atomic<double> gDSPWaitSpin{0};
+static std::atomic<double> gDSPWaitYield{0};
+static std::atomic<bool> gDSPWaitAdaptive{false};
+
+void setDSPWaitPolicy(double spin, double yield, bool adaptive) {
+    LOG_DEBUG("setDSPWaitPolicy: spin = " << spin << ", yield = "
+              << yield << ", adaptive = " << adaptive);
+    gDSPWaitSpin.store(std::max<double>(spin, 0));
+    gDSPWaitYield.store(std::max<double>(yield, 0));
+    gDSPWaitAdaptive.store(adaptive);
+}
+
+static bool isDSPWaitPolicyAdaptive() {
+    return gDSPWaitAdaptive.load(std::memory_order_relaxed);
+}
+
+DSPWaitStats getDSPWaitStats(bool reset) {
+    return DSPThreadPool::instance().getWaitStats(reset);
+}
+
 static thread_local bool gCurrentThreadDSP;
+static thread_local int gCurrentDSPThreadIndex = -1;
+
+// index of the current DSP helper thread, or -1 for any other thread.
+// PluginBridge uses this to give each DSP helper thread its own RT channel.
+int getCurrentDSPThreadIndex() {
+    return gCurrentDSPThreadIndex;
+}
 
 // some callbacks in IPluginListener need to know whether they are
 // called from a DSP (helper) thread, so that they would push to
@@ -63,21 +154,90 @@ DSPThreadPool::DSPThreadPool() {
 #if 0
     THREAD_DEBUG("Align of DSPThreadPool: " << alignof(*this));
     THREAD_DEBUG("DSPThreadPool address: " << this);
-    THREAD_DEBUG("pushLock address: " << &pushLock_);
-    THREAD_DEBUG("popLock address: " << &popLock_);
+    THREAD_DEBUG("queue address: " << &queue_);
 #endif
 
     running_.store(true);
 
     //  number of available hardware threads minus one (= the main audio thread)
     int numThreads = std::max<int>(getNumDSPThreads() - 1, 1);
+
+    auto cpus = getDSPThreadCpus();
+    if (!cpus.empty() && gNumDSPThreads.load() == 0) {
+        // one thread per selected CPU; NB: the main audio thread
+        // should be kept off these CPUs with the 'exclude' list.
+        numThreads = cpus.size();
+    }
     THREAD_DEBUG("number of DSP helper threads: " << numThreads);
 
+    threadStats_ = std::make_unique<WaitStats[]>(numThreads);
+
+    scheduler_ = getDSPScheduler();
+    if (scheduler_ != DSPScheduler::Shared) {
+        THREAD_DEBUG("use work stealing scheduler");
+        workers_ = std::make_unique<Worker[]>(numThreads);
+        numWorkers_ = numThreads;
+    }
+
+    // the CPU of each DSP helper thread (if pinned)
+    std::vector<int> threadCpus;
+    for (int i = 0; i < numThreads && !cpus.empty(); ++i) {
+        threadCpus.push_back(cpus[i % cpus.size()]);
+    }
+
+    if (!threadCpus.empty()) {
+        auto& topology = getCpuTopology();
+        bool multiNode = std::any_of(topology.begin(), topology.end(),
+            [&](auto& cpu) { return cpu.node != topology[0].node; });
+        auto getNode = [&](int cpu) {
+            auto it = std::find_if(topology.begin(), topology.end(),
+                [&](auto& info) { return info.index == cpu; });
+            return it != topology.end() ? it->node : -1;
+        };
+        bool numaPools;
+        {
+            std::lock_guard lock(gDSPThreadAffinityMutex);
+            numaPools = gDSPThreadAffinity.numaPools;
+        }
+        if (numaPools && scheduler_ == DSPScheduler::Shared) {
+            LOG_WARNING("per-node DSP thread pools require a work-stealing scheduler - ignoring");
+        } else if (numaPools && multiNode) {
+            // group the workers by NUMA node
+            std::stable_sort(threadCpus.begin(), threadCpus.end(),
+                [&](int a, int b) { return getNode(a) < getNode(b); });
+            for (int i = 0; i < numThreads; ++i) {
+                int node = getNode(threadCpus[i]);
+                if (pools_.empty() || pools_.back().node != node) {
+                    pools_.push_back(Pool { i, 0, node });
+                }
+                pools_.back().count++;
+                workerNodes_.push_back(node);
+            }
+            THREAD_DEBUG("number of DSP thread pools: " << pools_.size());
+        } else if (scheduler_ == DSPScheduler::Affinity && multiNode) {
+            // get the NUMA node of each worker, see numaNode()
+            for (int i = 0; i < numThreads; ++i) {
+                workerNodes_.push_back(getNode(threadCpus[i]));
+            }
+        }
+    }
+
     for (int i = 0; i < numThreads; ++i){
-        std::thread thread([this, i](){
+        int cpu = !threadCpus.empty() ? threadCpus[i] : -1;
+        std::thread thread([this, i, cpu](){
             setThreadPriority(Priority::High);
+            TRACE_THREAD_NAME("dsp");
+            if (cpu >= 0) {
+                THREAD_DEBUG("pin DSP helper thread " << i << " to CPU " << cpu);
+                setThreadAffinity(cpu);
+            }
             setCurrentThreadDSP();
-            run(i);
+            gCurrentDSPThreadIndex = i;
+            if (scheduler_ != DSPScheduler::Shared) {
+                runWorkStealing(i);
+            } else {
+                run(i);
+            }
         });
         threads_.push_back(std::move(thread));
     }
@@ -95,7 +255,13 @@ DSPThreadPool::~DSPThreadPool(){
     running_.store(false);
 
     // wake up all threads!
-    semaphore_.post(threads_.size());
+    if (workers_) {
+        for (int i = 0; i < numWorkers_; ++i) {
+            workers_[i].event.set();
+        }
+    } else {
+        semaphore_.post(threads_.size());
+    }
     // join threads
     for (auto& thread : threads_){
         if (thread.joinable()){
@@ -106,10 +272,22 @@ DSPThreadPool::~DSPThreadPool(){
     LOG_DEBUG("free DSPThreadPool");
 }
 
-bool DSPThreadPool::push(Callback cb, ThreadedPlugin *plugin, int numSamples){
-    pushLock_.lock();
+int DSPThreadPool::numaNode(int hint) const {
+    if (!pools_.empty()) {
+        return pools_[(uint32_t)hint % (uint32_t)pools_.size()].node;
+    } else if (!workerNodes_.empty()) {
+        return workerNodes_[(uint32_t)hint % (uint32_t)workerNodes_.size()];
+    } else {
+        return -1;
+    }
+}
+
+bool DSPThreadPool::push(Callback cb, ThreadedPlugin *plugin, int numSamples, int hint){
+    if (workers_) {
+        return pushWorkStealing({ cb, plugin, numSamples }, hint);
+    }
+    TRACE_INSTANT(TaskPush, numSamples);
     bool result = queue_.push({ cb, plugin, numSamples });
-    pushLock_.unlock();
     THREAD_DEBUG("DSPThreadPool: push task");
     semaphore_.post();
     return result;
@@ -117,9 +295,19 @@ bool DSPThreadPool::push(Callback cb, ThreadedPlugin *plugin, int numSamples){
 
 bool DSPThreadPool::processTask(){
     Task task;
-    popLock_.lock();
+    if (workers_) {
+        // NB: each audio thread starts at a different (random) position
+        // to reduce contention between several waiting threads.
+        static thread_local int start = std::hash<std::thread::id>{}(
+            std::this_thread::get_id()) % numWorkers_;
+        if (popWorkStealing(task, start, 0, numWorkers_)) {
+            task.cb(task.plugin, task.numSamples);
+            return true;
+        } else {
+            return false;
+        }
+    }
     bool result = queue_.pop(task);
-    popLock_.unlock();
     if (result) {
         // call DSP routine
         task.cb(task.plugin, task.numSamples);
@@ -131,17 +319,139 @@ void DSPThreadPool::run(int index) {
     // the loop
     while (running_.load()) {
         Task task;
-        popLock_.lock();
         while (queue_.pop(task)){
-            popLock_.unlock();
             // call DSP routine
             task.cb(task.plugin, task.numSamples);
-            popLock_.lock();
         }
-        popLock_.unlock();
 
         // wait for more
-        semaphore_.wait();
+        waitWithPolicy(semaphore_, waitPolicy(), &threadStats_[index]);
+
+        THREAD_DEBUG("DSP helper thread " << index << " woke up");
+    }
+}
+
+WaitPolicy DSPThreadPool::waitPolicy() const {
+    WaitPolicy policy;
+    policy.spinTime = gDSPWaitSpin.load(std::memory_order_relaxed);
+    policy.yieldTime = gDSPWaitYield.load(std::memory_order_relaxed);
+    if (gDSPWaitAdaptive.load(std::memory_order_relaxed)) {
+        // relative to the block period
+        auto period = blockPeriod_.load(std::memory_order_relaxed);
+        policy.spinTime *= period;
+        policy.yieldTime *= period;
+    }
+    return policy;
+}
+
+DSPWaitStats DSPThreadPool::getWaitStats(bool reset) {
+    DSPWaitStats result { 0, 0, 0 };
+    auto add = [&](WaitStats& stats) {
+        result.spins += stats.spins.load(std::memory_order_relaxed);
+        result.yields += stats.yields.load(std::memory_order_relaxed);
+        result.sleeps += stats.sleeps.load(std::memory_order_relaxed);
+        if (reset) {
+            stats.clear();
+        }
+    };
+    for (size_t i = 0; i < threads_.size(); ++i) {
+        add(threadStats_[i]);
+    }
+    add(waitStats_);
+    return result;
+}
+
+bool DSPThreadPool::pushWorkStealing(const Task& task, int hint) {
+    TRACE_INSTANT(TaskPush, task.numSamples);
+    // all workers resp. the pool of a single NUMA node
+    int first = 0;
+    int count = numWorkers_;
+    uint32_t slot = hint;
+    if (!pools_.empty()) {
+        // each plugin sticks to the same pool
+        auto& pool = pools_[(uint32_t)hint % (uint32_t)pools_.size()];
+        first = pool.first;
+        count = pool.count;
+        slot = (uint32_t)hint / (uint32_t)pools_.size();
+    }
+    int offset;
+    if (scheduler_ == DSPScheduler::Affinity) {
+        offset = slot % (uint32_t)count;
+    } else {
+        // round-robin; NB: the counter is thread-local to avoid
+        // contention between several audio threads.
+        static thread_local uint32_t counter = 0;
+        offset = counter++ % (uint32_t)count;
+    }
+    auto getWorker = [&](int i) -> Worker& {
+        return workers_[first + (offset + i) % count];
+    };
+    auto& worker = getWorker(0);
+    bool result = worker.queue.push(task);
+    if (!result) {
+        // try the other queues
+        for (int i = 1; i < count && !result; ++i) {
+            result = getWorker(i).queue.push(task);
+        }
+        if (!result) {
+            return false;
+        }
+    }
+    THREAD_DEBUG("DSPThreadPool: push task to worker " << (first + offset));
+    // Only wake up the target worker - unless it is busy, in which case
+    // we rather wake up an idle worker who can steal the task.
+    if (worker.sleeping.load(std::memory_order_relaxed)) {
+        worker.event.set();
+    } else {
+        for (int i = 1; i < count; ++i) {
+            auto& other = getWorker(i);
+            if (other.sleeping.load(std::memory_order_relaxed)) {
+                other.event.set();
+                return true;
+            }
+        }
+        // all workers are busy; the target worker will get to it.
+        // NB: we still need to set the event because the worker might
+        // be just about to go to sleep!
+        worker.event.set();
+    }
+    return true;
+}
+
+bool DSPThreadPool::popWorkStealing(Task& task, int start, int first, int count) {
+    // first try the given queue, then try to steal from the others.
+    for (int i = 0; i < count; ++i) {
+        if (workers_[first + (start + i) % count].pop(task)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void DSPThreadPool::runWorkStealing(int index) {
+    auto& worker = workers_[index];
+    // only steal from the workers of our own pool (if any)
+    int first = 0;
+    int count = numWorkers_;
+    for (auto& pool : pools_) {
+        if (index >= pool.first && index < pool.first + pool.count) {
+            first = pool.first;
+            count = pool.count;
+            break;
+        }
+    }
+    // the loop
+    while (running_.load()) {
+        Task task;
+        // NB: popWorkStealing() starts with our own queue.
+        while (popWorkStealing(task, index - first, first, count)) {
+            // call DSP routine
+            task.cb(task.plugin, task.numSamples);
+        }
+        // wait for more
+        worker.sleeping.store(true, std::memory_order_relaxed);
+        waitWithPolicy(worker.event, waitPolicy(), &threadStats_[index]);
+        worker.sleeping.store(false, std::memory_order_relaxed);
 
         THREAD_DEBUG("DSP helper thread " << index << " woke up");
     }
@@ -156,6 +466,9 @@ IPlugin::ptr createThreadedPlugin(IPlugin::ptr plugin){
 ThreadedPlugin::ThreadedPlugin(IPlugin::ptr plugin)
     : plugin_(std::move(plugin)) {
     threadPool_ = &DSPThreadPool::instance(); // cache for performance
+    affinity_ = threadPool_->nextAffinity();
+    coalescer_.resize(plugin_->info().numParameters());
+    paramCache_ = plugin_->getParameterCache();
     event_.set(); // so that the process routine doesn't wait the very first time
     LOG_DEBUG("ThreadedPlugin");
 }
@@ -169,9 +482,14 @@ ThreadedPlugin::~ThreadedPlugin() {
     for (int i = 0; i < 2; ++i){
         for (auto& cmd : commands_[i]){
             if (cmd.type == Command::SetParamString){
-                delete[] cmd.paramString.str;
+                freePayload(cmd.paramString.str);
             } else if (cmd.type == Command::SendSysex){
-                delete[] cmd.sysex.data;
+                freePayload(cmd.sysex.data);
+            }
+        }
+        for (auto& event : events_[i]){
+            if (event.type == Command::SysexReceived){
+                freePayload(event.sysex.data);
             }
         }
     }
@@ -208,10 +526,12 @@ void ThreadedPlugin::updateBuffer(){
     for (int i = 0; i < numOutputs_; ++i){
         total += outputs_[i].numChannels;
     }
-    const int incr = blockSize_ *
-        ((precision_ == ProcessPrecision::Double) ? sizeof(double) : sizeof(float));
-    buffer_.clear(); // force zero initialization
-    buffer_.resize(total * incr);
+    // every channel starts on a cache line, so plugins can use aligned SIMD loads
+    // and parallel plugins don't have to share cache lines.
+    const int incr = DSPBuffer::padSize(blockSize_ *
+        ((precision_ == ProcessPrecision::Double) ? sizeof(double) : sizeof(float)));
+    // allocate on the NUMA node of our worker thread (if known)
+    buffer_.resize(total * incr, threadPool_->numaNode(affinity_)); // zero initialized
     // set buffer vectors
     auto setChannels = [](auto& bus, auto& buffer, int incr){
         for (int i = 0; i < bus.numChannels; ++i){
@@ -240,7 +560,7 @@ void ThreadedPlugin::dispatchCommands() {
         case Command::SetParamString:
             plugin_->setParameter(command.paramString.index, command.paramString.str,
                                   command.paramString.offset);
-            delete[] command.paramString.str; // !
+            freePayload(command.paramString.str); // !
             break;
         case Command::SetParamStringShort:
         {
@@ -253,6 +573,9 @@ void ThreadedPlugin::dispatchCommands() {
         case Command::SetBypass:
             plugin_->setBypass(static_cast<Bypass>(command.i));
             break;
+        case Command::SetSilenceMode:
+            plugin_->setSilenceMode(static_cast<SilenceMode>(command.i));
+            break;
         case Command::SetTempo:
             plugin_->setTempoBPM(command.d);
             break;
@@ -288,7 +611,7 @@ void ThreadedPlugin::dispatchCommands() {
             break;
         case Command::SendSysex:
             plugin_->sendSysexEvent(command.sysex);
-            delete[] command.sysex.data; // !
+            freePayload(command.sysex.data); // !
             break;
         case Command::SetProgram:
             plugin_->setProgram(command.i);
@@ -304,6 +627,7 @@ void ThreadedPlugin::dispatchCommands() {
 
 template<typename T>
 void ThreadedPlugin::threadFunction(int numSamples){
+    TRACE_SCOPE(TaskRun, numSamples);
     ProcessData data;
     data.precision = precision_;
     data.mode = mode_;
@@ -319,7 +643,16 @@ void ThreadedPlugin::threadFunction(int numSamples){
 
         dispatchCommands();
 
-        plugin_->process(data);
+        TRACE_BEGIN(PluginProcess, numSamples);
+        auto meter = dspLoad_.load(std::memory_order_acquire);
+        if (meter){
+            auto start = DSPLoadMeter::clock::now();
+            plugin_->process(data);
+            meter->addProcessTime(DSPLoadMeter::elapsed(start), numSamples);
+        } else {
+            plugin_->process(data);
+        }
+        TRACE_END(PluginProcess, numSamples);
 
         mutex_.unlock();
     } else {
@@ -334,6 +667,23 @@ template<typename T>
 void ThreadedPlugin::doProcess(ProcessData& data){
     // LATER do *hard* bypass here and not in the thread function
 
+    if (isDSPWaitPolicyAdaptive()) {
+        // measure the block period with a simple moving average filter
+        auto now = std::chrono::steady_clock::now();
+        auto delta = std::chrono::duration<double>(now - lastProcessTime_).count();
+        lastProcessTime_ = now;
+        if (delta < 1.0) { // ignore long pauses
+            const double coeff = 0.1;
+            blockPeriod_ += (delta - blockPeriod_) * coeff;
+            threadPool_->updateBlockPeriod(blockPeriod_);
+        }
+    }
+
+    // measure the queue wait time
+    auto meter = dspLoad_.load(std::memory_order_acquire);
+    auto waitStart = meter ? DSPLoadMeter::clock::now() : DSPLoadMeter::clock::time_point{};
+
+    TRACE_BEGIN(QueueWait, data.numSamples);
     // check event without blocking.
     // LOG_DEBUG("try to wait for task");
     while (!event_.try_wait()){
@@ -345,13 +695,19 @@ void ThreadedPlugin::doProcess(ProcessData& data){
         if (!threadPool_->processTask()){
             // no tasks left -> wait
             // LOG_DEBUG("wait for task");
-            event_.wait();
+            waitWithPolicy(event_, threadPool_->waitPolicy(),
+                           &threadPool_->waitStats());
             break;
         } else {
             // LOG_DEBUG("process task");
         }
     }
 
+    TRACE_END(QueueWait, data.numSamples);
+    if (meter){
+        meter->addWaitTime(DSPLoadMeter::elapsed(waitStart));
+    }
+
     auto copyChannels = [](auto& from, auto& to, int nsamples){
         assert(from.numChannels == to.numChannels);
         for (int i = 0; i < from.numChannels; ++i){
@@ -371,11 +727,12 @@ void ThreadedPlugin::doProcess(ProcessData& data){
         copyChannels(outputs_[i], data.outputs[i], data.numSamples);
     }
     // swap queues and notify DSP thread pool
+    flushParameters();
     current_ = !current_;
     auto cb = [](ThreadedPlugin *plugin, int numSamples){
         plugin->threadFunction<T>(numSamples);
     };
-    if (!threadPool_->push(cb, this, data.numSamples)){
+    if (!threadPool_->push(cb, this, data.numSamples, affinity_)){
         LOG_WARNING("couldn't push DSP task!");
         // skip processing and clear outputs
         for (int i = 0; i < numOutputs_; ++i){
@@ -408,7 +765,7 @@ void ThreadedPlugin::sendEvents(){
                 break;
             case Command::SysexReceived:
                 listener_->sysexEvent(event.sysex);
-                delete[] event.sysex.data; // delete data!
+                freePayload(event.sysex.data); // free data!
                 break;
             default:
                 break;
@@ -456,10 +813,14 @@ void ThreadedPlugin::setNumSpeakers(int *input, int numInputs,
 }
 
 float ThreadedPlugin::getParameter(int index) const {
-    // This should be threadsafe, but we might read an old value.
-    // We can't set a parameter and immediately retrieve it,
-    // instead we need one block of delay.
-    return plugin_->getParameter(index);
+    // We might read an old value: we can't set a parameter and
+    // immediately retrieve it, instead we need one block of delay.
+    if (paramCache_){
+        // lock-free, doesn't touch the plugin
+        return paramCache_->get(index);
+    } else {
+        return plugin_->getParameter(index);
+    }
 }
 
 size_t ThreadedPlugin::getParameterString(int index, ParamStringBuffer& buffer) const {
@@ -498,16 +859,9 @@ std::string ThreadedPlugin::getProgramNameIndexed(int index) const {
 }
 
 void ThreadedPlugin::readProgramFile(const std::string& path) {
-    std::ifstream file(path, std::ios_base::binary);
-    if (!file.is_open()){
-        throw Error("couldn't open file " + path);
-    }
-    file.seekg(0, std::ios_base::end);
-    std::string buffer;
-    buffer.resize(file.tellg());
-    file.seekg(0, std::ios_base::beg);
-    file.read(&buffer[0], buffer.size());
-    readProgramData(buffer.data(), buffer.size());
+    // map the file instead of copying it into a buffer
+    MappedFile file(path); // throws on failure
+    readProgramData(file.data(), file.size());
 }
 
 void ThreadedPlugin::readProgramData(const char *data, size_t size) {
@@ -531,16 +885,9 @@ void ThreadedPlugin::writeProgramData(std::string& buffer) {
 }
 
 void ThreadedPlugin::readBankFile(const std::string& path) {
-    std::ifstream file(path, std::ios_base::binary);
-    if (!file.is_open()){
-        throw Error("couldn't open file " + path);
-    }
-    file.seekg(0, std::ios_base::end);
-    std::string buffer;
-    buffer.resize(file.tellg());
-    file.seekg(0, std::ios_base::beg);
-    file.read(&buffer[0], buffer.size());
-    readBankData(buffer.data(), buffer.size());
+    // map the file instead of copying it into a buffer
+    MappedFile file(path); // throws on failure
+    readBankData(file.data(), file.size());
 }
 
 void ThreadedPlugin::readBankData(const char *data, size_t size) {
@@ -630,7 +977,7 @@ void ThreadedPlugin::midiEvent(const MidiEvent& event) {
 void ThreadedPlugin::sysexEvent(const SysexEvent& event) {
     if (isCurrentThreadDSP()) {
         // deep copy!
-        auto data = new char[event.size];
+        auto data = allocatePayload(PayloadType::Sysex, event.size);
         memcpy(data, event.data, event.size);
 
         Command e(Command::SysexReceived);
@@ -23,16 +23,63 @@ class DSPThreadPool {
     ~DSPThreadPool();
 
     using Callback = void (*)(ThreadedPlugin *, int);
-    bool push(Callback cb, ThreadedPlugin *plugin, int numSamples);
+    // 'hint' is the preferred worker (only used with DSPScheduler::Affinity)
+    bool push(Callback cb, ThreadedPlugin *plugin, int numSamples, int hint = 0);
 
     bool processTask();
+
+    DSPScheduler scheduler() const { return scheduler_; }
+
+    WaitPolicy waitPolicy() const;
+    void updateBlockPeriod(double period) {
+        blockPeriod_.store(period, std::memory_order_relaxed);
+    }
+    // for waiting audio threads
+    WaitStats& waitStats() { return waitStats_; }
+    DSPWaitStats getWaitStats(bool reset);
+    // get a (sticky) worker index for a new plugin
+    int nextAffinity() {
+        return nextAffinity_.fetch_add(1, std::memory_order_relaxed);
+    }
+    // NUMA node of the worker (or pool) which processes the tasks for the given
+    // hint, or -1 if unknown. Only available with DSPScheduler::Affinity resp.
+    // per-node pools and pinned DSP threads on machines with several NUMA nodes.
+    int numaNode(int hint) const;
  private:
     struct Task {
         Callback cb;
         ThreadedPlugin *plugin;
         int numSamples;
     };
+    // per-worker task queue for the work-stealing schedulers.
+    // Tasks are pushed by the audio thread(s) and popped by the owner,
+    // idle worker threads ("stealing") and waiting audio threads.
+    struct alignas(CACHELINE_SIZE) Worker : AlignedClass<Worker> {
+        LockfreeMPMCQueue<Task, 256> queue;
+        Event event;
+        std::atomic<bool> sleeping{false};
+
+        bool pop(Task& task) {
+            if (queue.empty()) {
+                return false; // don't touch the shared state
+            }
+            return queue.pop(task);
+        }
+    };
     std::vector<std::thread> threads_;
+    DSPScheduler scheduler_;
+    std::unique_ptr<Worker[]> workers_;
+    int numWorkers_ = 0;
+    std::atomic<int> nextAffinity_{0};
+    std::vector<int> workerNodes_; // see numaNode()
+    // per-node worker pools, see DSPThreadAffinity::numaPools.
+    // The workers of each pool are contiguous.
+    struct Pool {
+        int first;
+        int count;
+        int node;
+    };
+    std::vector<Pool> pools_;
     // NOTE: Semaphore is the right tool to notify one or more threads in a thread pool.
     // With Event there are certain edge cases where it would fail to notify the correct
     // number of threads. For example, if several worker threads are about to call wait()
@@ -43,11 +90,15 @@ class DSPThreadPool {
     // threads spin a few times, but I think this negligible. Also, the post() call is a bit faster.
     LightSemaphore semaphore_;
     std::atomic<bool> running_;
-    LockfreeFifo<Task, 1024> queue_;
-    PaddedSpinLock pushLock_;
-    PaddedSpinLock popLock_;
+    std::atomic<double> blockPeriod_{0};
+    std::unique_ptr<WaitStats[]> threadStats_;
+    WaitStats waitStats_;
+    LockfreeMPMCQueue<Task, 1024> queue_;
 
     void run(int index);
+    void runWorkStealing(int index);
+    bool pushWorkStealing(const Task& task, int hint);
+    bool popWorkStealing(Task& task, int start, int first, int count);
 };
 
 /*//////////////////// ThreadedPlugin ////////////////*/
@@ -69,6 +120,10 @@ class ThreadedPlugin final : public DeferredPlugin, public IPluginListener
     void setupProcessing(double sampleRate, int maxBlockSize,
                          ProcessPrecision precision, ProcessMode mode) override;
     void process(ProcessData& data) override;
+    bool setDSPLoadMeter(DSPLoadMeter *meter) override {
+        dspLoad_.store(meter, std::memory_order_release);
+        return true;
+    }
     void suspend() override;
     void resume() override;
     void setNumSpeakers(int *input, int numInputs, int *output, int numOutputs) override;
@@ -84,6 +139,13 @@ class ThreadedPlugin final : public DeferredPlugin, public IPluginListener
 
     float getParameter(int index) const override;
     size_t getParameterString(int index, ParamStringBuffer& buffer) const override;
+    void getParameters(int first, int count, float *values,
+                       ParamStringBuffer *strings) const override {
+        plugin_->getParameters(first, count, values, strings);
+    }
+    const ParamCache * getParameterCache() const override {
+        return paramCache_;
+    }
 
     void setProgram(int index) override;
     int getProgram() const override;
@@ -146,7 +208,14 @@ private:
     void threadFunction(int numSamples);
     // data
     DSPThreadPool *threadPool_;
+    int affinity_ = 0;
+    // for measuring the block period
+    std::chrono::steady_clock::time_point lastProcessTime_;
+    double blockPeriod_ = 0;
+    // see setDSPLoadMeter()
+    std::atomic<DSPLoadMeter *> dspLoad_{nullptr};
     IPlugin::ptr plugin_;
+    const ParamCache *paramCache_ = nullptr; // cached from plugin_
     IPluginListener* listener_ = nullptr;
     mutable Mutex mutex_; // use spinlock instead?
     Event event_;
@@ -169,7 +238,7 @@ private:
     int numInputs_ = 0;
     std::unique_ptr<Bus[]> outputs_;
     int numOutputs_ = 0;
-    std::vector<char> buffer_;
+    DSPBuffer buffer_;
 };
 
 } // vst
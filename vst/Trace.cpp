@@ -0,0 +1,213 @@
+#include "Trace.h"
+
+#include "FileUtils.h"
+#include "Log.h"
+#include "MiscUtils.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <stdlib.h>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <unistd.h>
+#endif
+
+namespace vst {
+
+namespace {
+
+const char *gTraceEventNames[] = {
+    "plugin_process",
+    "client_process",
+    "bridge_wait",
+    "server_process",
+    "task_push",
+    "task_run",
+    "queue_wait"
+};
+
+static_assert(sizeof(gTraceEventNames) / sizeof(const char *)
+              == (size_t)TraceEvent::NumEvents);
+
+struct TraceRecord {
+    uint64_t time; // nanoseconds
+    uint32_t arg;
+    uint16_t event;
+    uint8_t phase;
+};
+
+static_assert(sizeof(TraceRecord) == 16);
+
+// single writer (the owning thread), any number of readers
+class TraceBuffer {
+ public:
+    static const size_t capacity = 16384; // must be a power of 2
+
+    TraceBuffer(int id)
+        : records_(std::make_unique<TraceRecord[]>(capacity)), id_(id) {}
+
+    void write(const TraceRecord& record) {
+        auto pos = head_.load(std::memory_order_relaxed);
+        records_[pos & (capacity - 1)] = record;
+        head_.store(pos + 1, std::memory_order_release);
+    }
+
+    template<typename Fn>
+    void read(Fn&& fn) const {
+        auto head = head_.load(std::memory_order_acquire);
+        auto start = head > capacity ? head - capacity : 0;
+        for (auto i = start; i < head; ++i) {
+            fn(records_[i & (capacity - 1)]);
+        }
+    }
+
+    int id() const { return id_; }
+
+    const char *name() const { return name_; }
+
+    void setName(const char *name) {
+        snprintf(name_, sizeof(name_), "%s", name);
+    }
+ private:
+    std::atomic<uint64_t> head_{0};
+    std::unique_ptr<TraceRecord[]> records_;
+    int id_;
+    char name_[32] = { 0 };
+};
+
+std::atomic<bool> gTraceEnabled{false};
+
+// NB: intentionally leaked, so that the buffers are still
+// available during static destruction, see TraceFileWriter.
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<TraceBuffer *> buffers;
+
+    static TraceRegistry& instance() {
+        static TraceRegistry *registry = new TraceRegistry();
+        return *registry;
+    }
+};
+
+thread_local TraceBuffer *gTraceBuffer = nullptr;
+
+TraceBuffer& getTraceBuffer() {
+    if (!gTraceBuffer) {
+        auto& registry = TraceRegistry::instance();
+        std::lock_guard lock(registry.mutex);
+        // NB: the buffers of finished threads are kept for writeTraceFile().
+        gTraceBuffer = new TraceBuffer(registry.buffers.size() + 1);
+        registry.buffers.push_back(gTraceBuffer);
+    }
+    return *gTraceBuffer;
+}
+
+int getProcessId() {
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return getpid();
+#endif
+}
+
+// write the trace file on exit if VSTPLUGIN_TRACE is set
+struct TraceFileWriter {
+    TraceFileWriter() {
+        auto prefix = getenv("VSTPLUGIN_TRACE");
+        if (prefix && *prefix) {
+            path_ = std::string(prefix) + "_" + std::to_string(getProcessId()) + ".json";
+            setTraceEnabled(true);
+        }
+    }
+    ~TraceFileWriter() {
+        if (!path_.empty()) {
+            setTraceEnabled(false);
+            writeTraceFile(path_);
+        }
+    }
+    std::string path_;
+};
+
+TraceFileWriter gTraceFileWriter;
+
+} // namespace
+
+void setTraceEnabled(bool enable) {
+    gTraceEnabled.store(enable, std::memory_order_relaxed);
+}
+
+bool isTraceEnabled() {
+    return gTraceEnabled.load(std::memory_order_relaxed);
+}
+
+void traceEvent(TraceEvent event, TracePhase phase, uint32_t arg) {
+    if (gTraceEnabled.load(std::memory_order_relaxed)) {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        TraceRecord record;
+        record.time = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+        record.arg = arg;
+        record.event = static_cast<uint16_t>(event);
+        record.phase = static_cast<uint8_t>(phase);
+        getTraceBuffer().write(record);
+    }
+}
+
+void setTraceThreadName(const char *name) {
+    getTraceBuffer().setName(name);
+}
+
+bool writeTraceFile(const std::string& path) {
+    File file(path, File::WRITE);
+    if (!file.is_open()) {
+        LOG_ERROR("couldn't create trace file " << path);
+        return false;
+    }
+    auto pid = getProcessId();
+    auto& registry = TraceRegistry::instance();
+    std::lock_guard lock(registry.mutex);
+
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    auto sep = [&]() -> const char * {
+        return std::exchange(first, false) ? "\n" : ",\n";
+    };
+    char buf[256];
+    for (auto buffer : registry.buffers) {
+        if (*buffer->name()) {
+            snprintf(buf, sizeof(buf), "{\"name\":\"thread_name\",\"ph\":\"M\","
+                     "\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                     pid, buffer->id(), buffer->name());
+            file << sep() << buf;
+        }
+        buffer->read([&](const TraceRecord& r) {
+            if (r.event >= (uint16_t)TraceEvent::NumEvents) {
+                return; // garbled
+            }
+            const char *phase = (r.phase == (uint8_t)TracePhase::Begin) ? "B" :
+                (r.phase == (uint8_t)TracePhase::End) ? "E" : "i";
+            // timestamps are in microseconds
+            snprintf(buf, sizeof(buf), "{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,"
+                     "\"pid\":%d,\"tid\":%d,\"args\":{\"id\":%u}%s}",
+                     gTraceEventNames[r.event], phase, (double)r.time * 0.001,
+                     pid, buffer->id(), r.arg, *phase == 'i' ? ",\"s\":\"t\"" : "");
+            file << sep() << buf;
+        });
+    }
+    file << "\n]}\n";
+
+    if (!file) {
+        LOG_ERROR("couldn't write trace file " << path);
+        return false;
+    }
+    LOG_VERBOSE("wrote trace file " << path);
+    return true;
+}
+
+} // vst
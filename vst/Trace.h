@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// Enable trace points at compile time (see TRACE option in CMakeLists.txt).
+// If disabled, the TRACE_* macros compile to nothing.
+#ifndef USE_TRACE
+#define USE_TRACE 0
+#endif
+
+namespace vst {
+
+// NB: keep in sync with the names in Trace.cpp!
+enum class TraceEvent : uint16_t {
+    PluginProcess, // IPlugin::process() of the actual plugin
+    ClientProcess, // PluginClient::process()
+    BridgeWait, // waiting for the bridge process
+    ServerProcess, // PluginHandle::doProcess() in the bridge process
+    TaskPush, // push a task to the DSP thread pool
+    TaskRun, // run a DSP task
+    QueueWait, // waiting for the DSP thread pool
+    NumEvents
+};
+
+enum class TracePhase : uint8_t {
+    Begin,
+    End,
+    Instant
+};
+
+// Trace points are recorded together with a timestamp into a per-thread
+// ring buffer; the oldest events are overwritten. Recording is lock-free and
+// only allocates memory the first time a thread writes a trace point.
+// Tracing must be enabled at runtime with setTraceEnabled() or by setting the
+// VSTPLUGIN_TRACE environment variable to a file path prefix; in the latter
+// case, each process writes "<prefix>_<pid>.json" when it exits.
+void setTraceEnabled(bool enable);
+
+bool isTraceEnabled();
+
+void traceEvent(TraceEvent event, TracePhase phase, uint32_t arg);
+
+// name the current thread in the trace output
+void setTraceThreadName(const char *name);
+
+// Write all recorded events in the Chrome trace event format, which can be
+// viewed in Perfetto (ui.perfetto.dev) or chrome://tracing. Timestamps use the
+// system-wide monotonic clock (on Linux and macOS), so traces of the host and
+// bridge processes can be merged. Returns false if the file couldn't be written.
+// NB: not realtime safe; events which are written concurrently might be garbled.
+bool writeTraceFile(const std::string& path);
+
+class TraceScope {
+ public:
+    TraceScope(TraceEvent event, uint32_t arg)
+        : event_(event), arg_(arg) {
+        traceEvent(event_, TracePhase::Begin, arg_);
+    }
+    ~TraceScope() {
+        traceEvent(event_, TracePhase::End, arg_);
+    }
+ private:
+    TraceEvent event_;
+    uint32_t arg_;
+};
+
+} // vst
+
+#if USE_TRACE
+# define TRACE_BEGIN(event, arg) vst::traceEvent(vst::TraceEvent::event, vst::TracePhase::Begin, arg)
+# define TRACE_END(event, arg) vst::traceEvent(vst::TraceEvent::event, vst::TracePhase::End, arg)
+# define TRACE_INSTANT(event, arg) vst::traceEvent(vst::TraceEvent::event, vst::TracePhase::Instant, arg)
+# define TRACE_SCOPE(event, arg) vst::TraceScope trace_scope_##event(vst::TraceEvent::event, arg)
+# define TRACE_THREAD_NAME(name) vst::setTraceThreadName(name)
+#else
+# define TRACE_BEGIN(event, arg)
+# define TRACE_END(event, arg)
+# define TRACE_INSTANT(event, arg)
+# define TRACE_SCOPE(event, arg)
+# define TRACE_THREAD_NAME(name)
+#endif
@@ -1,5 +1,7 @@
 #include "VST2Plugin.h"
 
+#include "FileUtils.h"
+#include "Kernels.h"
 #include "Log.h"
 #include "MiscUtils.h"
 #include "Sync.h"
@@ -186,7 +188,7 @@ std::unique_ptr<VST2Plugin> VST2Factory::doCreate(PluginDesc::const_ptr desc, bo
 /*/////////////////////// VST2Plugin /////////////////////////////*/
 
 // initial size of VstEvents queue (can grow later as needed)
-#define DEFAULT_EVENT_QUEUE_SIZE 64
+#define DEFAULT_PARAM_QUEUE_SIZE 256
 
 VST2Plugin::VST2Plugin(AEffect *plugin, IFactory::const_ptr f, PluginDesc::const_ptr desc, bool editor)
     : plugin_(plugin), info_(std::move(desc)), factory_(std::move(f))
@@ -205,11 +207,14 @@ VST2Plugin::VST2Plugin(AEffect *plugin, IFactory::const_ptr f, PluginDesc::const
             | kVstClockValid | kVstSmpteValid | kVstTransportChanged;
 
     // create VstEvents structure holding VstEvent pointers
-    vstEvents_ = (VstEvents *)malloc(sizeof(VstEvents) + DEFAULT_EVENT_QUEUE_SIZE * sizeof(VstEvent *));
+    const int maxNumEvents = MAX_EVENTS_PER_BLOCK + MAX_SYSEX_EVENTS_PER_BLOCK;
+    vstEvents_ = (VstEvents *)malloc(sizeof(VstEvents) + maxNumEvents * sizeof(VstEvent *));
     memset(vstEvents_, 0, sizeof(VstEvents)); // zeroing class fields is enough
-    vstEventBufferSize_ = DEFAULT_EVENT_QUEUE_SIZE;
-    // pre-allocate midi queue
-    midiQueue_.reserve(DEFAULT_EVENT_QUEUE_SIZE);
+    // pre-allocate event queues; we never grow them on the audio thread!
+    midiQueue_.reserve(MAX_EVENTS_PER_BLOCK);
+    sysexQueue_.reserve(MAX_SYSEX_EVENTS_PER_BLOCK);
+    // pre-allocate parameter queue (for sub-block automation)
+    paramQueue_.reserve(DEFAULT_PARAM_QUEUE_SIZE);
 
     dispatch(effOpen);
 
@@ -238,10 +243,10 @@ VST2Plugin::VST2Plugin(AEffect *plugin, IFactory::const_ptr f, PluginDesc::const
         newInfo->sdkVersion = getSDKVersion();
         PluginDesc::Bus input;
         input.numChannels = getNumInputs();
-        newInfo->inputs.emplace_back(std::move(input));
+        newInfo->inputs().emplace_back(std::move(input));
         PluginDesc::Bus output;
         output.numChannels = getNumOutputs();
-        newInfo->outputs.emplace_back(std::move(output));
+        newInfo->outputs().emplace_back(std::move(output));
         // flags
         uint32_t flags = 0;
         flags |= hasEditor() * PluginDesc::HasEditor;
@@ -264,7 +269,7 @@ VST2Plugin::VST2Plugin(AEffect *plugin, IFactory::const_ptr f, PluginDesc::const
         // programs
         int numPrograms = getNumPrograms();
         for (int i = 0; i < numPrograms; ++i){
-            newInfo->programs.push_back(getProgramNameIndexed(i));
+            newInfo->programs().push_back(getProgramNameIndexed(i));
         }
         // VST2 shell plugins only: get sub plugins
         if (dispatch(effGetPlugCategory) == kPlugCategShell){
@@ -292,10 +297,6 @@ VST2Plugin::~VST2Plugin(){
 
     dispatch(effClose);
 
-        // clear sysex events
-    for (auto& sysex : sysexQueue_){
-        free(sysex.sysexDump);
-    }
     free(vstEvents_);
     LOG_DEBUG("destroyed VST2 plugin");
 }
@@ -345,37 +346,43 @@ void VST2Plugin::doProcess(ProcessData& data, TProc processRoutine){
         return; // should never happen!
     }
 
-    // check bypass state
-    auto bypassState = bypass_;
-    bool bypassRamp = (bypass_ != lastBypass_);
-    if (bypassRamp){
+    // process
+    if (blockBypass_ == Bypass::Off){
+        // ordinary processing
+        processRoutine(plugin_, (T **)data.inputs->channelData32,
+                       (T **)data.outputs->channelData32, data.numSamples);
+    } else {
+        bypassProcess<T>(data, processRoutine, blockBypass_, bypassRamp_);
+    }
+}
+
+// check the bypass state once per block, so that a bypass ramp
+// spans the whole block even if it is split into sub-blocks.
+void VST2Plugin::updateBypass(int nsamples){
+    blockBypass_ = bypass_;
+    bypassRamp_ = (bypass_ != lastBypass_);
+    if (bypassRamp_){
         if ((bypass_ == Bypass::Hard || lastBypass_ == Bypass::Hard)){
             // hard bypass: just crossfade to unprocessed input - but keep processing
             // till the *plugin output* is silent (this will clear delay lines, for example).
-            bypassState = Bypass::Hard;
+            blockBypass_ = Bypass::Hard;
         } else if (bypass_ == Bypass::Soft || lastBypass_ == Bypass::Soft){
             // soft bypass: we pass an empty input to the plugin until the output is silent
             // and mix it with the original input. This means that a reverb tail will decay
             // instead of being cut off!
-            bypassState = Bypass::Soft;
+            blockBypass_ = Bypass::Soft;
         }
     }
-    if ((bypassState == Bypass::Hard) && haveBypass_){
+    if ((blockBypass_ == Bypass::Hard) && haveBypass_){
         // if we request a hard bypass from a plugin which has its own bypass method,
         // we use that instead (by just calling the processing method)
-        bypassState = Bypass::Off;
-        bypassRamp = false;
+        blockBypass_ = Bypass::Off;
+        bypassRamp_ = false;
     }
     lastBypass_ = bypass_;
-
-    // process
-    if (bypassState == Bypass::Off){
-        // ordinary processing
-        processRoutine(plugin_, (T **)data.inputs->channelData32,
-                       (T **)data.outputs->channelData32, data.numSamples);
-    } else {
-        bypassProcess<T>(data, processRoutine, bypassState, bypassRamp);
-    }
+    rampDir_ = bypass_ != Bypass::Off;
+    rampPos_ = 0;
+    rampLength_ = nsamples;
 }
 
 template<typename T, typename TProc>
@@ -398,13 +405,17 @@ void VST2Plugin::bypassProcess(ProcessData& data, TProc processRoutine,
 
     // dummy input buffer
     auto dummy = (T *)alloca(sizeof(T) * data.numSamples);
-    std::fill(dummy, dummy + data.numSamples, 0); // zero!
+    kernels::clear(dummy, data.numSamples); // zero!
 
+    // the ramp spans the whole block, see updateBypass(); with sub-blocks,
+    // we continue where the previous sub-block has stopped.
     int dir;
-    T advance;
+    T advance, start;
     if (ramp){
-        dir = bypass_ != Bypass::Off;
-        advance = (1.f / data.numSamples) * (1 - 2 * dir);
+        dir = rampDir_;
+        advance = (1.f / rampLength_) * (1 - 2 * dir);
+        start = (T)dir + advance * rampPos_;
+        rampPos_ += data.numSamples;
     }
 
     // prepare bypassing
@@ -414,12 +425,7 @@ void VST2Plugin::bypassProcess(ProcessData& data, TProc processRoutine,
             if (ramp && i < nout){
                 // write fade in/fade out to *output buffer* and use it as an input.
                 // this works because VST plugins actually work in "replacing" mode.
-                auto in = realInput[i];
-                auto out = output[i];
-                T mix = dir;
-                for (int j = 0; j < data.numSamples; ++j, mix += advance){
-                    out[j] = in[j] * mix;
-                }
+                kernels::fade(output[i], realInput[i], data.numSamples, start, advance);
                 input[i] = output[i];
             } else {
                 input[i] = dummy; // silence
@@ -441,19 +447,13 @@ void VST2Plugin::bypassProcess(ProcessData& data, TProc processRoutine,
         if (state == Bypass::Soft){
             // soft bypass
             for (int i = 0; i < nout; ++i){
-                T mix = dir;
                 auto out = output[i];
                 if (i < nin){
                     // fade in/out unprocessed (original) input
-                    auto in = realInput[i];
-                    for (int j = 0; j < data.numSamples; ++j, mix += advance){
-                        out[j] += in[j] * (1.f - mix);
-                    }
+                    kernels::fadeAdd(out, realInput[i], data.numSamples, (T)1 - start, -advance);
                 } else {
                     // just fade in/out
-                    for (int j = 0; j < data.numSamples; ++j, mix += advance){
-                        out[j] *= mix;
-                    }
+                    kernels::fade(out, out, data.numSamples, start, advance);
                 }
             }
             if (dir){
@@ -464,19 +464,13 @@ void VST2Plugin::bypassProcess(ProcessData& data, TProc processRoutine,
         } else {
             // hard bypass
             for (int i = 0; i < nout; ++i){
-               T mix = dir;
                auto out = output[i];
                if (i < nin){
                    // cross fade between plugin output and unprocessed (original) input
-                   auto in = realInput[i];
-                   for (int j = 0; j < data.numSamples; ++j, mix += advance){
-                       out[j] = out[j] * mix + in[j] * (1.f - mix);
-                   }
+                   kernels::crossfade(out, out, realInput[i], data.numSamples, start, advance);
                } else {
                    // just fade in/out
-                   for (int j = 0; j < data.numSamples; ++j, mix += advance){
-                       out[j] *= mix;
-                   }
+                   kernels::fade(out, out, data.numSamples, start, advance);
                }
             }
             if (dir){
@@ -492,11 +486,7 @@ void VST2Plugin::bypassProcess(ProcessData& data, TProc processRoutine,
         // check for silence (RMS < ca. -80dB)
         auto isSilent = [](auto buf, auto n){
             const T threshold = 0.0001;
-            T sum = 0;
-            for (int i = 0; i < n; ++i){
-                T f = buf[i];
-                sum += f * f;
-            }
+            T sum = kernels::sumOfSquares(buf, n);
             return (sum / n) < (threshold * threshold); // sqrt(sum/n) < threshold
         };
 
@@ -517,11 +507,7 @@ void VST2Plugin::bypassProcess(ProcessData& data, TProc processRoutine,
         if (state == Bypass::Soft){
             // mix output with unprocessed (cached) input
             for (int i = 0; i < nin && i < nout; ++i){
-                auto in = realInput[i];
-                auto out = output[i];
-                for (int j = 0; j < data.numSamples; ++j){
-                    out[j] += in[j];
-                }
+                kernels::add(output[i], realInput[i], data.numSamples);
             }
         } else {
             // hard bypass: overwrite output - the processing
@@ -532,13 +518,144 @@ void VST2Plugin::bypassProcess(ProcessData& data, TProc processRoutine,
 }
 
 void VST2Plugin::process(ProcessData& data){
-    preProcess(data.numSamples);
+    // VST2 plugins don't know about silence flags, so we can only
+    // skip processing altogether (SilenceMode::Sleep).
+    bool idle = false;
+    if (silenceMode_ == SilenceMode::Sleep && bypass_ == Bypass::Off
+            && lastBypass_ == Bypass::Off) {
+        idle = vstEvents_->numEvents == 0 && !paramChanged_;
+        for (int i = 0; idle && i < data.numInputs; ++i) {
+            idle = isSilent(data.inputs[i], data.numSamples, data.precision);
+        }
+        if (sleep_.check(idle)) {
+            clearOutputs(data);
+            postProcess(data.numSamples);
+            return;
+        }
+    } else {
+        sleep_.reset();
+    }
+
+    updateBypass(data.numSamples);
+
+    if (paramQueue_.empty()){
+        preProcess(0, data.numSamples, true);
+        processBlock(data);
+    } else {
+        processSubBlocks(data);
+    }
+
+    if (idle && sleep_.advance(data.numSamples)) {
+        bool silent = true;
+        for (int i = 0; silent && i < data.numOutputs; ++i) {
+            silent = isSilent(data.outputs[i], data.numSamples, data.precision);
+        }
+        if (silent) {
+            LOG_DEBUG("VST2Plugin: go to sleep");
+            sleep_.sleep();
+        }
+    }
+    paramChanged_ = false;
+
+    postProcess(data.numSamples);
+}
+
+void VST2Plugin::processBlock(ProcessData& data){
     if (data.precision == ProcessPrecision::Double){
         doProcess<double>(data, plugin_->processDoubleReplacing);
     } else {
         doProcess<float>(data, plugin_->processReplacing);
     }
-    postProcess(data.numSamples);
+}
+
+// Split the block at the sample offsets of the queued parameter changes.
+// NB: the host is supposed to limit the number of parameter changes per block,
+// e.g. by decimating audio rate automation.
+void VST2Plugin::processSubBlocks(ProcessData& data){
+    auto sampleSize = (data.precision == ProcessPrecision::Double) ?
+        sizeof(double) : sizeof(float);
+    // make sub-block busses (NB: alloca() must not be called in a lambda!)
+    auto inputs = (AudioBus *)alloca(sizeof(AudioBus) * data.numInputs);
+    for (int i = 0; i < data.numInputs; ++i){
+        inputs[i].numChannels = data.inputs[i].numChannels;
+        inputs[i].channelData32 = (float **)alloca(sizeof(void *) * inputs[i].numChannels);
+    }
+    auto outputs = (AudioBus *)alloca(sizeof(AudioBus) * data.numOutputs);
+    for (int i = 0; i < data.numOutputs; ++i){
+        outputs[i].numChannels = data.outputs[i].numChannels;
+        outputs[i].channelData32 = (float **)alloca(sizeof(void *) * outputs[i].numChannels);
+    }
+    auto setOnset = [sampleSize](AudioBus *dest, const AudioBus *src, int count, int onset){
+        for (int i = 0; i < count; ++i){
+            for (int j = 0; j < src[i].numChannels; ++j){
+                auto chn = (char *)src[i].channelData32[j] + onset * sampleSize;
+                dest[i].channelData32[j] = (float *)chn;
+            }
+        }
+    };
+    ProcessData sub = data;
+    sub.inputs = inputs;
+    sub.outputs = outputs;
+
+    // temporarily advance the time info for each sub-block
+    auto samplePos = timeInfo_.samplePos;
+    auto ppqPos = timeInfo_.ppqPos;
+    bool playing = timeInfo_.flags & kVstTransportPlaying;
+
+    size_t k = 0;
+    int onset = 0;
+    while (onset < data.numSamples){
+        // apply all parameter changes up to the current onset
+        for (; k < paramQueue_.size() && paramQueue_[k].offset <= onset; ++k){
+            plugin_->setParameter(plugin_, paramQueue_[k].index, paramQueue_[k].value);
+        }
+        int end = (k < paramQueue_.size()) ?
+            std::min<int>(paramQueue_[k].offset, data.numSamples) : data.numSamples;
+
+        setOnset(inputs, data.inputs, data.numInputs, onset);
+        setOnset(outputs, data.outputs, data.numOutputs, onset);
+        sub.numSamples = end - onset;
+        if (playing){
+            double delta = (double)onset / timeInfo_.sampleRate;
+            timeInfo_.samplePos = samplePos + onset;
+            timeInfo_.ppqPos = ppqPos + delta * timeInfo_.tempo / 60.0;
+        }
+
+        preProcess(onset, sub.numSamples, end == data.numSamples);
+        processBlock(sub);
+
+        onset = end;
+    }
+    // changes beyond the block size
+    for (; k < paramQueue_.size(); ++k){
+        plugin_->setParameter(plugin_, paramQueue_[k].index, paramQueue_[k].value);
+    }
+    paramQueue_.clear();
+
+    timeInfo_.samplePos = samplePos;
+    timeInfo_.ppqPos = ppqPos;
+}
+
+void VST2Plugin::setSilenceMode(SilenceMode mode){
+    silenceMode_ = mode;
+    updateTail();
+    sleep_.reset();
+}
+
+void VST2Plugin::updateTail(){
+    if (!hasTail()){
+        sleep_.setTail(0);
+    } else {
+        auto tail = getTailSize();
+        if (tail == 1){
+            // 1 means "no tail" (0 means "default tail")
+            sleep_.setTail(0);
+        } else if (tail > 1){
+            sleep_.setTail(tail);
+        } else {
+            sleep_.setTail((int)(SILENCE_DEFAULT_TAIL * timeInfo_.sampleRate));
+        }
+    }
 }
 
 bool VST2Plugin::hasPrecision(ProcessPrecision precision) const {
@@ -555,6 +672,9 @@ void VST2Plugin::suspend(){
 
 void VST2Plugin::resume(){
     dispatch(effMainsChanged, 0, 1);
+    // the tail size might depend on the current state
+    updateTail();
+    sleep_.reset();
 }
 
 int VST2Plugin::getNumInputs() const {
@@ -780,6 +900,10 @@ bool VST2Plugin::hasMidiOutput() const {
 }
 
 void VST2Plugin::sendMidiEvent(const MidiEvent &event){
+    if (midiQueue_.size() >= midiQueue_.capacity()){
+        eventArena_.drop(); // don't allocate!
+        return;
+    }
     VstMidiEvent midievent;
     memset(&midievent, 0, sizeof(VstMidiEvent));
     midievent.type = kVstMidiType;
@@ -794,15 +918,25 @@ void VST2Plugin::sendMidiEvent(const MidiEvent &event){
 }
 
 void VST2Plugin::sendSysexEvent(const SysexEvent &event){
+    // copy the sysex data into the event arena; drop the event
+    // if the arena or the queue is full.
+    char *data = nullptr;
+    if (sysexQueue_.size() < sysexQueue_.capacity()){
+        data = eventArena_.allocate(event.size);
+    }
+    if (!data){
+        eventArena_.drop();
+        return;
+    }
+    memcpy(data, event.data, event.size);
+
     VstMidiSysexEvent sysexevent;
     memset(&sysexevent, 0, sizeof(VstMidiSysexEvent));
     sysexevent.type = kVstSysExType;
     sysexevent.byteSize = sizeof(VstMidiSysexEvent);
     sysexevent.deltaFrames = event.delta;
     sysexevent.dumpBytes = event.size;
-    sysexevent.sysexDump = (char *)malloc(sysexevent.dumpBytes);
-        // copy the sysex data (LATER figure out how to avoid this)
-    memcpy(sysexevent.sysexDump, event.data, sysexevent.dumpBytes);
+    sysexevent.sysexDump = data;
 
     sysexQueue_.push_back(std::move(sysexevent));
 
@@ -810,16 +944,35 @@ void VST2Plugin::sendSysexEvent(const SysexEvent &event){
 }
 
 void VST2Plugin::setParameter(int index, float value, int sampleOffset){
-    // VST2 can't do sample accurate automation
-    plugin_->setParameter(plugin_, index, value);
+    paramChanged_ = true;
+    // VST2 can't do sample accurate automation, so we do sub-block processing.
+    // NB: don't allocate memory! If the queue is full, set the parameter immediately.
+    if (sampleOffset > 0 && paramQueue_.size() < paramQueue_.capacity()){
+        // insert sorted by sample offset; iterate in reverse because
+        // we likely add values in "chronological" order.
+        auto it = paramQueue_.end();
+        while (it != paramQueue_.begin() && (it - 1)->offset > sampleOffset){
+            --it;
+        }
+        paramQueue_.insert(it, ParamChange { index, value, sampleOffset });
+    } else {
+        plugin_->setParameter(plugin_, index, value);
+    }
 }
 
 bool VST2Plugin::setParameter(int index, std::string_view str, int sampleOffset) {
     // VST2 can't do sample accurate automation
+    paramChanged_ = true;
     return dispatch(effString2Parameter, index, 0, (void *)str.data());
 }
 
 float VST2Plugin::getParameter(int index) const {
+    // check for pending parameter changes (see setParameter())
+    for (auto it = paramQueue_.rbegin(); it != paramQueue_.rend(); ++it){
+        if (it->index == index){
+            return it->value;
+        }
+    }
     return (plugin_->getParameter)(plugin_, index);
 }
 
@@ -829,6 +982,21 @@ size_t VST2Plugin::getParameterString(int index, ParamStringBuffer& buffer) cons
     return strlen(buffer.data());
 }
 
+void VST2Plugin::getParameters(int first, int count, float *values,
+                               ParamStringBuffer *strings) const {
+    // only check for pending parameter changes if necessary
+    bool pending = !paramQueue_.empty();
+    for (int i = 0; i < count; ++i){
+        int index = first + i;
+        values[i] = pending ? getParameter(index)
+                            : (plugin_->getParameter)(plugin_, index);
+        if (strings){
+            strings[i][0] = 0;
+            dispatch(effGetParamDisplay, index, 0, strings[i].data());
+        }
+    }
+}
+
 int VST2Plugin::getNumParameters() const {
     return plugin_->numParams;
 }
@@ -838,6 +1006,7 @@ void VST2Plugin::setProgram(int program){
         dispatch(effBeginSetProgram);
         dispatch(effSetProgram, 0, program);
         dispatch(effEndSetProgram);
+        paramChanged_ = true;
         // update();
     } else {
         LOG_WARNING("program number out of range!");
@@ -889,16 +1058,9 @@ void VST2Plugin::getBankChunkData(void **data, size_t *size) const {
 }
 
 void VST2Plugin::readProgramFile(const std::string& path){
-    std::ifstream file(path, std::ios_base::binary);
-    if (!file.is_open()){
-        throw Error("couldn't open file " + path);
-    }
-    file.seekg(0, std::ios_base::end);
-    std::string buffer;
-    buffer.resize(file.tellg());
-    file.seekg(0, std::ios_base::beg);
-    file.read(&buffer[0], buffer.size());
-    readProgramData(buffer.data(), buffer.size());
+    // map the file instead of copying it into a buffer
+    MappedFile file(path); // throws on failure
+    readProgramData(file.data(), file.size());
 }
 
 void VST2Plugin::readProgramData(const char *data, size_t size){
@@ -1023,16 +1185,9 @@ void VST2Plugin::writeProgramData(std::string& buffer){
 }
 
 void VST2Plugin::readBankFile(const std::string& path){
-    std::ifstream file(path, std::ios_base::binary);
-    if (!file.is_open()){
-        throw Error("couldn't open file " + path);
-    }
-    file.seekg(0, std::ios_base::end);
-    std::string buffer;
-    buffer.resize(file.tellg());
-    file.seekg(0, std::ios_base::beg);
-    file.read(&buffer[0], buffer.size());
-    readBankData(buffer.data(), buffer.size());
+    // map the file instead of copying it into a buffer
+    MappedFile file(path); // throws on failure
+    readBankData(file.data(), file.size());
 }
 
 void VST2Plugin::readBankData(const char *data, size_t size){
@@ -1365,31 +1520,39 @@ VstTimeInfo * VST2Plugin::getTimeInfo(VstInt32 flags){
     return &timeInfo_;
 }
 
-void VST2Plugin::preProcess(int nsamples){
-    // send MIDI events:
-    int numEvents = vstEvents_->numEvents;
-    // resize buffer if needed
-    while (numEvents > vstEventBufferSize_){
-        LOG_DEBUG("vstEvents: grow (numEvents " << numEvents << ", old size " << vstEventBufferSize_<< ")");
-        // always grow (doubling the memory), never shrink
-        int newSize = vstEventBufferSize_ * 2;
-        vstEvents_ = (VstEvents *)realloc(vstEvents_, sizeof(VstEvents) + newSize * sizeof(VstEvent *));
-        vstEventBufferSize_ = newSize;
-        memset(vstEvents_, 0, sizeof(VstEvents)); // zeroing class fields is enough
-        vstEvents_->numEvents = numEvents;
-    }
-    // set VstEvent pointers (do it right here to ensure they are all valid)
+// send MIDI events in the range [onset, onset + nsamples] (relative to the start of the block).
+// 'last' means that this is the last sub-block, see processSubBlocks().
+void VST2Plugin::preProcess(int onset, int nsamples, bool last){
+    // NB: vstEvents_ is large enough to hold all queued events, see constructor.
+    int numEvents = midiQueue_.size() + sysexQueue_.size();
+    // set VstEvent pointers (do it right here to ensure they are all valid).
+    // NB: events from previous sub-blocks have already been made relative
+    // to their onset, so they are always smaller than the current onset.
+    auto inRange = [&](VstEvent& e){
+        if ((onset == 0 || e.deltaFrames >= onset) &&
+                (last || e.deltaFrames < onset + nsamples)){
+            e.deltaFrames -= onset;
+            return true;
+        } else {
+            return false;
+        }
+    };
     int n = 0;
     for (auto& midi : midiQueue_){
-        vstEvents_->events[n++] = (VstEvent *)&midi;
+        if (inRange((VstEvent&)midi)){
+            vstEvents_->events[n++] = (VstEvent *)&midi;
+        }
     }
     for (auto& sysex : sysexQueue_){
-        vstEvents_->events[n++] = (VstEvent *)&sysex;
+        if (inRange((VstEvent&)sysex)){
+            vstEvents_->events[n++] = (VstEvent *)&sysex;
+        }
     }
-    if (n != numEvents){
+    vstEvents_->numEvents = n;
+    if (onset == 0 && last && n != numEvents){
         LOG_ERROR("preProcess bug: wrong number of events!");
     } else {
-            // always call this, even if there are no events. some plugins depend on this...
+        // always call this, even if there are no events. some plugins depend on this...
         dispatch(effProcessEvents, 0, 0, vstEvents_);
     }
 }
@@ -1398,10 +1561,12 @@ void VST2Plugin::postProcess(int nsamples){
     // clear midi events
     midiQueue_.clear();
     // clear sysex events
-    for (auto& sysex : sysexQueue_){
-        free(sysex.sysexDump);
-    }
     sysexQueue_.clear();
+    eventArena_.clear();
+    // report dropped events
+    if (auto n = eventArena_.checkDropped()){
+        LOG_WARNING("VST2Plugin: event queue overflow - dropped " << n << " events!");
+    }
     // 'clear' VstEvents array
     vstEvents_->numEvents = 0;
 
@@ -3,6 +3,8 @@
 
 #include "Interface.h"
 #include "PluginFactory.h"
+#include "MiscUtils.h"
+#include "EventArena.h"
 
 #define VST_FORCE_DEPRECATED 0
 #include "aeffectx.h"
@@ -57,6 +59,7 @@ class VST2Plugin final : public IPlugin {
     void suspend() override;
     void resume() override;
     void setBypass(Bypass state) override;
+    void setSilenceMode(SilenceMode mode) override;
     void setNumSpeakers(int *input, int numInputs,
                         int *output, int numOutputs) override;
     int getLatencySamples() override;
@@ -85,6 +88,8 @@ class VST2Plugin final : public IPlugin {
     bool setParameter(int index, std::string_view str, int sampleOffset = 0) override;
     float getParameter(int index) const override;
     size_t getParameterString(int index, ParamStringBuffer& buffer) const override;
+    void getParameters(int first, int count, float *values,
+                       ParamStringBuffer *strings) const override;
 
     void setProgram(int program) override;
     void setProgramName(std::string_view name) override;
@@ -144,7 +149,10 @@ class VST2Plugin final : public IPlugin {
     void setBankChunkData(const void *data, size_t size);
     void getBankChunkData(void **data, size_t *size) const;
     // processing
-    void preProcess(int nsamples);
+    void preProcess(int onset, int nsamples, bool last);
+    void processSubBlocks(ProcessData& data);
+    void processBlock(ProcessData& data);
+    void updateBypass(int nsamples);
     template<typename T, typename TProc>
     void doProcess(ProcessData& data, TProc processRoutine);
     template<typename T, typename TProc>
@@ -170,11 +178,30 @@ class VST2Plugin final : public IPlugin {
     Bypass lastBypass_ = Bypass::Off;
     bool haveBypass_ = false;
     bool bypassSilent_ = false; // check if we can stop processing
+    // bypass state of the current block, see updateBypass()
+    Bypass blockBypass_ = Bypass::Off;
+    bool bypassRamp_ = false;
+    bool rampDir_ = false; // true: process -> bypass
+    int rampPos_ = 0; // for sub-blocks
+    int rampLength_ = 0;
+    // silence detection
+    void updateTail();
+    SilenceMode silenceMode_ = SilenceMode::Off;
+    SleepState sleep_;
+    bool paramChanged_ = false; // parameter or program change since the last block
+    // VST2 doesn't support sample accurate automation, so we queue
+    // parameter changes and split the next block into sub-blocks.
+    struct ParamChange {
+        int32_t index;
+        float value;
+        int32_t offset;
+    };
+    std::vector<ParamChange> paramQueue_;
     // buffers for incoming MIDI and SysEx events
     std::vector<VstMidiEvent> midiQueue_;
     std::vector<VstMidiSysexEvent> sysexQueue_;
     VstEvents *vstEvents_; // VstEvents is basically an array of VstEvent pointers
-    int vstEventBufferSize_ = 0;
+    EventArena eventArena_; // SysEx data
     bool editor_ = false;
     // UI
     IWindow::ptr window_;
@@ -2,6 +2,7 @@
 
 #include "Log.h"
 #include "FileUtils.h"
+#include "Kernels.h"
 #include "MiscUtils.h"
 #include "Sync.h"
 
@@ -309,6 +310,16 @@ void VST3Factory::doLoad(){
             throw Error(Error::ModuleError, "Couldn't get plugin factory");
         }
         /// LOG_DEBUG("VST3Factory: loaded " << path_);
+        // NB: sub-plugins are only enumerated when needed, see doEnumerate()
+        // done
+        module_ = std::move(module);
+    }
+}
+
+void VST3Factory::doEnumerate(){
+    std::lock_guard lock(gLoaderLock);
+
+    if (!enumerated_.load(std::memory_order_relaxed)){
         // map plugin names to indices
         auto numPlugins = factory_->countClasses();
         /// LOG_DEBUG("module contains " << numPlugins << " classes");
@@ -326,11 +337,30 @@ void VST3Factory::doLoad(){
                 throw Error(Error::ModuleError, "Couldn't get class info!");
             }
         }
-        // done
-        module_ = std::move(module);
+        enumerated_.store(true, std::memory_order_release);
     }
 }
 
+// find the class index without enumerating all sub-plugins
+int VST3Factory::findClass(const std::string& name) const {
+    if (enumerated_.load(std::memory_order_acquire)){
+        auto it = subPluginMap_.find(name);
+        return it != subPluginMap_.end() ? it->second : -1;
+    }
+    auto numPlugins = factory_->countClasses();
+    for (int i = 0; i < numPlugins; ++i){
+        PClassInfo ci;
+        if (factory_->getClassInfo(i, &ci) == kResultTrue){
+            if (!strcmp(ci.category, kVstAudioEffectClass) && name == ci.name){
+                return i;
+            }
+        } else {
+            throw Error(Error::ModuleError, "Couldn't get class info!");
+        }
+    }
+    return -1;
+}
+
 std::unique_ptr<IPlugin> VST3Factory::create(const std::string& name, bool editor) const {
     const_cast<VST3Factory *>(this)->doLoad(); // lazy loading
 
@@ -344,17 +374,17 @@ std::unique_ptr<IPlugin> VST3Factory::create(const std::string& name, bool edito
     }
     auto desc = it->second;
     // find plugin index
-    auto it2 = subPluginMap_.find(name);
-    if (it2 == subPluginMap_.end()){
+    auto index = findClass(name);
+    if (index < 0){
         throw Error(Error::ModuleError, "Can't find index for (sub)plugin '" + name + "'");
     }
-    auto index = it2->second;
 
     return std::make_unique<VST3Plugin>(factory_, index, shared_from_this(), desc, editor);
 }
 
 PluginDesc::const_ptr VST3Factory::probePlugin(int id) const {
     const_cast<VST3Factory *>(this)->doLoad(); // lazy loading
+    const_cast<VST3Factory *>(this)->doEnumerate();
 
     if (subPlugins_.empty()){
         throw Error(Error::ModuleError, "Factory doesn't have any plugin(s)");
@@ -391,56 +421,41 @@ PluginDesc::const_ptr VST3Factory::probePlugin(int id) const {
 
 #if USE_MULTI_POINT_AUTOMATION
 
-ParamValueQueue::ParamValueQueue() {
-    values_.reserve(maxNumPoints);
-}
-
-void ParamValueQueue::setParameterId(Vst::ParamID id){
-    values_.clear();
-    id_ = id;
-}
-
 tresult PLUGIN_API ParamValueQueue::getPoint(int32 index, int32& sampleOffset, Vst::ParamValue& value) {
-    if (index >= 0 && index < (int32)values_.size()){
-        auto& v = values_[index];
-        value = v.value;
-        sampleOffset = v.sampleOffset;
+    if (index >= 0 && index < numPoints_){
+        auto& p = points_[index];
+        value = p.value;
+        sampleOffset = p.sampleOffset;
         return kResultTrue;
     }
     return kResultFalse;
 }
+
 tresult PLUGIN_API ParamValueQueue::addPoint (int32 sampleOffset, Vst::ParamValue value, int32& index) {
     // iterate in reverse because we likely add values in "chronological" order
-    for (auto it = values_.end(); it != values_.begin(); ){
-        --it; // decrement here (instead of inside the loop condition) to avoid MSVC debug assertion
-        if (sampleOffset > it->sampleOffset){
-            // higher sample offset -> insert *after* this point (might actually append)
-            if (values_.size() < maxNumPoints){
-                // insert
-                it = values_.emplace(it + 1, value, sampleOffset);
-                index = it - values_.begin();
-            } else {
-                // replace
-                values_.back() = Value(value, sampleOffset);
-                index = values_.size() - 1;
-            }
-            return kResultOk;
-        } else if (sampleOffset == it->sampleOffset){
-            // equal sample offset -> replace point
-            it->value = value;
-            index = it - values_.begin();
-            return kResultOk;
-        }
+    int32 i = numPoints_;
+    while (i > 0 && sampleOffset < points_[i - 1].sampleOffset){
+        --i;
+    }
+    if (i > 0 && sampleOffset == points_[i - 1].sampleOffset){
+        // equal sample offset -> replace point
+        points_[i - 1].value = value;
+        index = i - 1;
+        return kResultOk;
     }
-    // empty queue or smallest sample offset:
-    if (values_.size() < maxNumPoints){
-        // prepend point
-        values_.emplace(values_.begin(), value, sampleOffset);
+    if (numPoints_ < maxNumPoints){
+        // insert point at position i (might actually append)
+        std::copy_backward(points_ + i, points_ + numPoints_, points_ + numPoints_ + 1);
+        numPoints_++;
+    } else if (i == numPoints_){
+        // full and higher than all other points -> replace last point
+        i = numPoints_ - 1;
     } else {
-        // replace first point
-        values_.front() = Value(value, sampleOffset);
+        // full -> drop last point and insert
+        std::copy_backward(points_ + i, points_ + numPoints_ - 1, points_ + numPoints_);
     }
-    index = 0;
+    points_[i] = Point { value, sampleOffset };
+    index = i;
     return kResultOk;
 }
 
@@ -476,7 +491,8 @@ Vst::IParamValueQueue* PLUGIN_API ParameterChanges::addParameterData(const Vst::
 
 /*///////////////////// EventList /////////////////////*/
 
-EventList::EventList(){
+EventList::EventList(size_t sysexArenaSize)
+    : sysexArena_(sysexArenaSize) {
     events_.reserve(maxNumEvents);
 }
 
@@ -496,28 +512,39 @@ tresult PLUGIN_API EventList::getEvent(int32 index, Vst::Event& e) {
 }
 
 tresult PLUGIN_API EventList::addEvent (Vst::Event& e) {
-    // let's grow the queue beyond the limit...
-    // LATER use a realtime allocator
-    events_.push_back(e);
-    return kResultOk;
+    // don't grow the queue beyond the limit!
+    if (events_.size() < events_.capacity()){
+        events_.push_back(e);
+        return kResultOk;
+    } else {
+        sysexArena_.drop();
+        return kOutOfMemory;
+    }
 }
 
 void EventList::addSysexEvent(const SysexEvent& event){
-    // this will allocate memory anyway...
-    sysexEvents_.emplace_back(event.data, event.size);
-    auto& last = sysexEvents_.back();
+    // copy sysex data into the arena
+    char *data = nullptr;
+    if (events_.size() < events_.capacity()){
+        data = sysexArena_.allocate(event.size);
+    }
+    if (!data){
+        sysexArena_.drop();
+        return;
+    }
+    memcpy(data, event.data, event.size);
     Vst::Event e;
     memset(&e, 0, sizeof(Vst::Event));
     e.type = Vst::Event::kDataEvent;
     e.data.type = Vst::DataEvent::kMidiSysEx;
-    e.data.bytes = (const uint8 *)last.data();
-    e.data.size = last.size();
+    e.data.bytes = (const uint8 *)data;
+    e.data.size = event.size;
     addEvent(e);
 }
 
 void EventList::clear(){
     events_.clear();
-    sysexEvents_.clear();
+    sysexArena_.clear();
 }
 
 /*/////////////////////// VST3Plugin ///////////////////////*/
@@ -671,8 +698,8 @@ VST3Plugin::VST3Plugin(IPtr<IPluginFactory> factory, int which, IFactory::const_
             return result;
         };
 
-        newInfo->inputs = collectBusses(Vst::kInput);
-        newInfo->outputs = collectBusses(Vst::kOutput);
+        newInfo->inputs() = collectBusses(Vst::kInput);
+        newInfo->outputs() = collectBusses(Vst::kOutput);
 
         auto countMidiChannels = [this](Vst::BusDirection dir) -> int {
             auto count = component_->getBusCount(Vst::kEvent, dir);
@@ -766,10 +793,10 @@ VST3Plugin::VST3Plugin(IPtr<IPluginFactory> factory, int which, IFactory::const_
                     for (int i = 0; i < pli.programCount; ++i){
                         Vst::String128 name;
                         if (ui->getProgramName(pli.id, i, name) == kResultTrue){
-                            newInfo->programs.push_back(convertString(name));
+                            newInfo->programs().push_back(convertString(name));
                         } else {
                             LOG_ERROR("couldn't get program name!");
-                            newInfo->programs.push_back("");
+                            newInfo->programs().push_back("");
                         }
                     }
                     LOG_DEBUG("num programs: " << pli.programCount);
@@ -782,6 +809,7 @@ VST3Plugin::VST3Plugin(IPtr<IPluginFactory> factory, int which, IFactory::const_
         } else {
             LOG_DEBUG("no unit info");
         }
+        newInfo->freezeParameters();
         info_ = newInfo;
     }
 #if 0
@@ -798,7 +826,7 @@ VST3Plugin::VST3Plugin(IPtr<IPluginFactory> factory, int which, IFactory::const_
     // cache for automatable parameters
     int numAutoParams = getNumParameters();
     if (numAutoParams > 0) {
-        paramCache_.reset(new std::atomic<float>[numAutoParams]{}); // !
+        paramCache_.resize(numAutoParams);
         int numBins = alignTo(numAutoParams, paramCacheBits) / paramCacheBits;
         paramCacheBins_.reset(new std::atomic<size_t>[numBins]{}); // !
         numParamCacheBins_ = numBins;
@@ -876,7 +904,7 @@ tresult VST3Plugin::performEdit(Vst::ParamID id, Vst::ParamValue value){
                   << id << ", value = " << value);
         // update param cache!
         if (index >= 0) {
-            paramCache_[index].store(value, std::memory_order_relaxed);
+            paramCache_.set(index, value);
         }
     }
     return kResultOk;
@@ -909,7 +937,7 @@ tresult VST3Plugin::restartComponent(int32 flags){
 
     // update parameter cache and send notification to listeners
     // NOTE: restartComponent might be called before paramCache_ is allocated
-    if ((flags & Vst::kParamValuesChanged) && paramCache_) {
+    if ((flags & Vst::kParamValuesChanged) && paramCache_.size() > 0) {
         updateParameterCache();
 
         if (listener_){
@@ -1043,7 +1071,8 @@ void VST3Plugin::doProcess(ProcessData& inData){
     data.inputs = (vst3::AudioBusBuffers *)alloca(sizeof(vst3::AudioBusBuffers) * inData.numInputs);
     for (int i = 0; i < data.numInputs; ++i){
         auto& bus = data.inputs[i];
-        bus.silenceFlags = 0;
+        bus.silenceFlags = (silenceMode_ != SilenceMode::Off) ?
+            getSilenceFlags(inData.inputs[i], inData.numSamples, inData.precision) : 0;
         bus.numChannels = inData.inputs[i].numChannels;
         bus.channelBuffers32 = (Vst::Sample32 **)inData.inputs[i].channelData32;
     }
@@ -1098,10 +1127,55 @@ void VST3Plugin::doProcess(ProcessData& inData){
     }
     lastBypass_ = bypass_;
 
+    // check if the plugin is idle, i.e. all inputs are silent
+    // and there are no events or parameter changes.
+    bool idle = false;
+    if (silenceMode_ == SilenceMode::Sleep && bypassState == Bypass::Off && !bypassRamp){
+        idle = inputEvents_.getEventCount() == 0 &&
+            inputParamChanges_.getParameterCount() == 0;
+        for (int i = 0; idle && i < data.numInputs; ++i){
+            idle = data.inputs[i].silenceFlags == allChannelsSilent(data.inputs[i].numChannels);
+        }
+    } else {
+        sleep_.reset();
+    }
+
     // process
-    if (bypassState == Bypass::Off){
+    if (sleep_.check(idle)){
+        // sleeping: skip processing
+        clearOutputs(inData);
+    } else if (bypassState == Bypass::Off){
         // ordinary processing
         processor_->process(reinterpret_cast<Vst::ProcessData&>(data));
+        if (silenceMode_ != SilenceMode::Off){
+            // plugins may mark output channels as silent without
+            // actually clearing them.
+            bool silent = true;
+            for (int i = 0; i < data.numOutputs; ++i){
+                auto& bus = data.outputs[i];
+                for (int j = 0; j < bus.numChannels && j < 64; ++j){
+                    if (bus.silenceFlags & ((uint64_t)1 << j)){
+                        kernels::clear((T *)bus.channelBuffers32[j], data.numSamples);
+                    }
+                }
+                if (bus.silenceFlags != allChannelsSilent(bus.numChannels)){
+                    silent = false;
+                }
+            }
+            if (idle && sleep_.advance(data.numSamples)){
+                // silence flags are optional, so we have to check the actual output
+                if (!silent){
+                    silent = true;
+                    for (int i = 0; silent && i < inData.numOutputs; ++i){
+                        silent = isSilent(inData.outputs[i], inData.numSamples, inData.precision);
+                    }
+                }
+                if (silent){
+                    LOG_DEBUG("VST3Plugin: go to sleep");
+                    sleep_.sleep();
+                }
+            }
+        }
     } else {
         bypassProcess<T>(inData, data, bypassState, bypassRamp);
     }
@@ -1109,6 +1183,10 @@ void VST3Plugin::doProcess(ProcessData& inData){
     // clear input queues
     inputEvents_.clear();
     inputParamChanges_.clear();
+    // report dropped events
+    if (auto n = inputEvents_.checkDropped()){
+        LOG_WARNING("VST3Plugin: event queue overflow - dropped " << n << " events!");
+    }
 
     // handle outgoing events
     handleEvents();
@@ -1171,7 +1249,7 @@ void VST3Plugin::bypassProcess(ProcessData& inData, vst3::ProcessData& data,
 
     // dummy input buffer
     auto dummy = (T *)alloca(sizeof(T) * data.numSamples);
-    std::fill(dummy, dummy + data.numSamples, 0); // zero!
+    kernels::clear(dummy, data.numSamples); // zero!
 
     int dir;
     T advance;
@@ -1195,11 +1273,7 @@ void VST3Plugin::bypassProcess(ProcessData& inData, vst3::ProcessData& data,
                         // write fade in/fade out to *output buffer* and use it as the plugin input.
                         // this works because VST plugins actually work in "replacing" mode.
                         auto in = (const T *)inData.inputs[i].channelData32[j];
-                        auto out = output[j];
-                        T mix = dir;
-                        for (int k = 0; k < data.numSamples; ++k, mix += advance){
-                            out[k] = in[k] * mix;
-                        }
+                        kernels::fade(output[j], in, data.numSamples, (T)dir, advance);
                         input[j] = output[j];
                     } else {
                         input[j] = dummy; // silence
@@ -1233,19 +1307,14 @@ void VST3Plugin::bypassProcess(ProcessData& inData, vst3::ProcessData& data,
                 auto nin = i < data.numInputs ? data.inputs[i].numChannels : 0;
 
                 for (int j = 0; j < nout; ++j){
-                    T mix = dir;
                     auto out = output[j];
                     if (j < nin){
                         // fade in/out unprocessed (original) input
                         auto in = (const T *)inData.inputs[i].channelData32[j];
-                        for (int k = 0; k < data.numSamples; ++k, mix += advance){
-                            out[k] += in[k] * (1.f - mix);
-                        }
+                        kernels::fadeAdd(out, in, data.numSamples, (T)(1 - dir), -advance);
                     } else {
                         // just fade in/out
-                        for (int k = 0; k < data.numSamples; ++k, mix += advance){
-                            out[k] *= mix;
-                        }
+                        kernels::fade(out, out, data.numSamples, (T)dir, advance);
                     }
                 }
             }
@@ -1262,19 +1331,14 @@ void VST3Plugin::bypassProcess(ProcessData& inData, vst3::ProcessData& data,
                 auto nin = i < data.numInputs ? data.inputs[i].numChannels : 0;
 
                 for (int j = 0; j < nout; ++j){
-                    T mix = dir;
                     auto out = output[j];
                     if (j < nin){
                        // cross fade between plugin output and unprocessed (original) input
                        auto in = (const T *)inData.inputs[i].channelData32[j];
-                       for (int k = 0; k < data.numSamples; ++k, mix += advance){
-                           out[k] = out[k] * mix + in[k] * (1.f - mix);
-                       }
+                       kernels::crossfade(out, out, in, data.numSamples, (T)dir, advance);
                    } else {
                        // just fade in/out
-                       for (int k = 0; k < data.numSamples; ++k, mix += advance){
-                           out[k] *= mix;
-                       }
+                       kernels::fade(out, out, data.numSamples, (T)dir, advance);
                    }
                 }
             }
@@ -1292,12 +1356,7 @@ void VST3Plugin::bypassProcess(ProcessData& inData, vst3::ProcessData& data,
         auto isBusSilent = [](auto bus, auto nchannels, auto nsamples){
             const T threshold = 0.0001;
             for (int i = 0; i < nchannels; ++i){
-                auto buf = bus[i];
-                T sum = 0;
-                for (int j = 0; j < nsamples; ++j){
-                    T f = buf[j];
-                    sum += f * f;
-                }
+                T sum = kernels::sumOfSquares(bus[i], nsamples);
                 if ((sum / nsamples) > (threshold * threshold)){
                     return false;
                 }
@@ -1330,11 +1389,7 @@ void VST3Plugin::bypassProcess(ProcessData& inData, vst3::ProcessData& data,
                 auto nout = data.outputs[i].numChannels;
 
                 for (int j = 0; j < nin && j < nout; ++j){
-                    auto in = input[j];
-                    auto out = output[j];
-                    for (int k = 0; k < data.numSamples; ++k){
-                        out[k] += in[k];
-                    }
+                    kernels::add(output[j], input[j], data.numSamples);
                 }
             }
         } else {
@@ -1501,6 +1556,20 @@ void VST3Plugin::suspend(){
 void VST3Plugin::resume(){
     component_->setActive(true);
     processor_->setProcessing(true);
+    // the tail size might depend on the current state
+    updateTail();
+    sleep_.reset();
+}
+
+void VST3Plugin::setSilenceMode(SilenceMode mode){
+    silenceMode_ = mode;
+    updateTail();
+    sleep_.reset();
+}
+
+void VST3Plugin::updateTail(){
+    // NB: Vst::kInfiniteTail becomes -1
+    sleep_.setTail(getTailSize());
 }
 
 bool VST3Plugin::hasTail() const {
@@ -1893,7 +1962,7 @@ void VST3Plugin::doSetParameter(Vst::ParamID id, float value, int32 sampleOffset
 }
 
 float VST3Plugin::getParameter(int index) const {
-    return paramCache_[index].load(std::memory_order_relaxed);
+    return paramCache_.get(index);
 }
 
 size_t VST3Plugin::getParameterString(int index, ParamStringBuffer& buffer) const {
@@ -1924,12 +1993,25 @@ size_t VST3Plugin::getParameterString(int index, ParamStringBuffer& buffer) cons
     }
 }
 
+void VST3Plugin::getParameters(int first, int count, float *values,
+                               ParamStringBuffer *strings) const {
+    // values come straight from the parameter cache
+    for (int i = 0; i < count; ++i) {
+        values[i] = paramCache_.get(first + i);
+    }
+    if (strings) {
+        for (int i = 0; i < count; ++i) {
+            getParameterString(first + i, strings[i]);
+        }
+    }
+}
+
 int VST3Plugin::getNumParameters() const {
     return info().numParameters();
 }
 
 void VST3Plugin::setCacheParameter(int index, float value, bool notify) {
-    paramCache_[index].store(value, std::memory_order_relaxed);
+    paramCache_.set(index, value);
     if (notify) {
         int binIndex = index / paramCacheBits;
         int bitIndex = index & (paramCacheBits - 1);
@@ -1946,7 +2028,7 @@ void VST3Plugin::updateParameterCache(){
     for (int i = 0; i < numParams; ++i){
         auto id = info().getParamID(i);
         auto value = controller_->getParamNormalized(id);
-        paramCache_[i].store(value, std::memory_order_relaxed);
+        paramCache_.set(i, value);
     }
 }
 
@@ -2001,7 +2083,7 @@ std::string VST3Plugin::getProgramName() const {
 
 std::string VST3Plugin::getProgramNameIndexed(int index) const {
     if (index >= 0 && index < info().numPrograms()){
-        return info().programs[index];
+        return info().programs()[index];
     } else {
         return "";
     }
@@ -2012,16 +2094,9 @@ int VST3Plugin::getNumPrograms() const {
 }
 
 void VST3Plugin::readProgramFile(const std::string& path){
-    std::ifstream file(path, std::ios_base::binary);
-    if (!file.is_open()){
-        throw Error("couldn't open file " + path);
-    }
-    std::string buffer;
-    file.seekg(0, std::ios_base::end);
-    buffer.resize(file.tellg());
-    file.seekg(0, std::ios_base::beg);
-    file.read(&buffer[0], buffer.size());
-    readProgramData(buffer.data(), buffer.size());
+    // map the file instead of copying it into a buffer
+    MappedFile file(path); // throws on failure
+    readProgramData(file.data(), file.size());
 }
 
 struct ChunkListEntry {
@@ -2331,7 +2406,7 @@ void VST3Plugin::updateEditor() {
                 if (bits & ((size_t)1 << j)) {
                     int index = i * paramCacheBits + j;
                     auto id = info().getParamID(index);
-                    auto value = paramCache_[index].load(std::memory_order_relaxed);
+                    auto value = paramCache_.get(index);
                 #if DEBUG_VST3_PARAM_CHANGES
                     LOG_DEBUG("update parameter (index: " << index << ", value: " << value << ")");
                 #endif
@@ -3,6 +3,9 @@
 #include "Interface.h"
 #include "PluginFactory.h"
 #include "Lockfree.h"
+#include "MiscUtils.h"
+#include "EventArena.h"
+#include "ParamCache.h"
 
 #include "pluginterfaces/base/funknown.h"
 #include "pluginterfaces/base/ipluginbase.h"
@@ -250,41 +253,48 @@ class VST3Factory final : public PluginFactory {
     IPlugin::ptr create(const std::string& name, bool editor) const override;
  private:
     void doLoad();
+    void doEnumerate();
+    int findClass(const std::string& name) const;
     IPtr<IPluginFactory> factory_;
     // TODO dllExit
-    // subplugins
+    // subplugins (enumerated lazily)
     PluginDesc::SubPluginList subPlugins_;
     std::unordered_map<std::string, int> subPluginMap_;
+    std::atomic<bool> enumerated_{false};
 };
 
 //----------------------------------------------------------------------
 
 #ifndef USE_MULTI_POINT_AUTOMATION
-#define USE_MULTI_POINT_AUTOMATION 0
+#define USE_MULTI_POINT_AUTOMATION 1
 #endif
 
 #if USE_MULTI_POINT_AUTOMATION
+// Fixed-capacity parameter queue, so that we can pass (decimated) automation
+// ramps to the plugin without allocating memory on the audio thread.
+// If the queue is full, the last point is replaced.
 class ParamValueQueue: public Vst::IParamValueQueue {
  public:
     static const int maxNumPoints = 64;
 
-    ParamValueQueue();
-
     MY_IMPLEMENT_QUERYINTERFACE(Vst::IParamValueQueue)
     DUMMY_REFCOUNT_METHODS
 
-    void setParameterId(Vst::ParamID id);
+    void setParameterId(Vst::ParamID id){
+        numPoints_ = 0;
+        id_ = id;
+    }
     Vst::ParamID PLUGIN_API getParameterId() override { return id_; }
-    int32 PLUGIN_API getPointCount() override { return values_.size(); }
+    int32 PLUGIN_API getPointCount() override { return numPoints_; }
     tresult PLUGIN_API getPoint(int32 index, int32& sampleOffset, Vst::ParamValue& value) override;
     tresult PLUGIN_API addPoint (int32 sampleOffset, Vst::ParamValue value, int32& index) override;
  protected:
-    struct Value {
-        Value(Vst::ParamValue v, int32 offset) : value(v), sampleOffset(offset) {}
+    struct Point {
         Vst::ParamValue value;
         int32 sampleOffset;
     };
-    std::vector<Value> values_;
+    Point points_[maxNumPoints];
+    int32 numPoints_ = 0;
     Vst::ParamID id_ = Vst::kNoParamId;
 };
 #else
@@ -340,11 +350,14 @@ class ParameterChanges: public Vst::IParameterChanges {
 
 //--------------------------------------------------------------------------------
 
+// Fixed-capacity event list; events beyond the capacity are dropped,
+// so that we never allocate on the audio thread. SysEx data is copied
+// into a preallocated arena.
 class EventList : public Vst::IEventList {
  public:
-    static const int maxNumEvents = 64;
+    static const int maxNumEvents = MAX_EVENTS_PER_BLOCK;
 
-    EventList();
+    EventList(size_t sysexArenaSize = SYSEX_ARENA_SIZE);
     ~EventList();
 
     MY_IMPLEMENT_QUERYINTERFACE(Vst::IEventList)
@@ -355,9 +368,11 @@ class EventList : public Vst::IEventList {
     tresult PLUGIN_API addEvent (Vst::Event& e) override;
     void addSysexEvent(const SysexEvent& event);
     void clear();
+    // number of dropped events since the last call
+    uint64_t checkDropped() { return sysexArena_.checkDropped(); }
  protected:
     std::vector<Vst::Event> events_;
-    std::vector<std::string> sysexEvents_;
+    EventArena sysexArena_;
 };
 
 //--------------------------------------------------------------------------------------------------------
@@ -431,6 +446,7 @@ class VST3Plugin final :
     void suspend() override;
     void resume() override;
     void setBypass(Bypass state) override;
+    void setSilenceMode(SilenceMode mode) override;
     void setNumSpeakers(int *input, int numInputs, int *output, int numOutputs) override;
     int getLatencySamples() override;
 
@@ -457,6 +473,11 @@ class VST3Plugin final :
     bool setParameter(int index, std::string_view str, int sampleOffset = 0) override;
     float getParameter(int index) const override;
     size_t getParameterString(int index, ParamStringBuffer& buffer) const override;
+    void getParameters(int first, int count, float *values,
+                       ParamStringBuffer *strings) const override;
+    const ParamCache * getParameterCache() const override {
+        return &paramCache_;
+    }
 
     void setProgram(int program) override;
     void setProgramName(std::string_view name) override;
@@ -525,10 +546,14 @@ class VST3Plugin final :
     Bypass bypass_ = Bypass::Off;
     Bypass lastBypass_ = Bypass::Off;
     bool bypassSilent_ = false; // check if we can stop processing
+    // silence detection
+    void updateTail();
+    SilenceMode silenceMode_ = SilenceMode::Off;
+    SleepState sleep_;
     ProcessMode mode_ = ProcessMode::Realtime;
     // midi
     EventList inputEvents_;
-    EventList outputEvents_;
+    EventList outputEvents_{0}; // the plugin owns the SysEx data
     // parameters
     ParameterChanges inputParamChanges_;
     ParameterChanges outputParamChanges_;
@@ -540,7 +565,7 @@ class VST3Plugin final :
     // paramChangesToGui for this purpose, this would be tricky regarding
     // memory management, because we do not know in advance how large
     // the queue should be.
-    std::unique_ptr<std::atomic<float>[]> paramCache_;
+    ParamCache paramCache_;
     // This is an atomic bitset vector which is used to tell the UI thread
     // which parameters have changed. We do not need another atomic variable
     // to indicate whether *any* parameter has changed; instead, we can simply
@@ -0,0 +1,221 @@
+#include "WavFile.h"
+
+#include "Interface.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+// NB: WAV files are little endian, just like all our target platforms.
+
+namespace vst {
+
+namespace {
+
+const uint16_t WAVE_FORMAT_PCM = 1;
+const uint16_t WAVE_FORMAT_IEEE_FLOAT = 3;
+const uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+struct ChunkHeader {
+    char id[4];
+    uint32_t size;
+};
+
+struct FormatChunk {
+    uint16_t format;
+    uint16_t numChannels;
+    uint32_t sampleRate;
+    uint32_t byteRate;
+    uint16_t blockAlign;
+    uint16_t bitsPerSample;
+};
+
+static_assert(sizeof(ChunkHeader) == 8 && sizeof(FormatChunk) == 16,
+              "unexpected struct padding");
+
+// size of RIFF + fmt + data chunk headers
+const size_t headerSize = 12 + 8 + sizeof(FormatChunk) + 8;
+
+} // namespace
+
+/*/////////////////// WavReader ////////////////////*/
+
+WavReader::WavReader(const std::string& path)
+    : file_(path), path_(path)
+{
+    if (!file_.is_open()) {
+        throw Error(Error::SystemError, "couldn't open file " + path);
+    }
+    char riff[12];
+    if (!file_.read(riff, sizeof(riff)) || memcmp(riff, "RIFF", 4) != 0
+            || memcmp(riff + 8, "WAVE", 4) != 0) {
+        throw Error(Error::UnknownError, path + ": not a WAV file");
+    }
+    bool haveFormat = false;
+    uint16_t format = 0;
+    uint16_t bitsPerSample = 0;
+    ChunkHeader chunk;
+    while (file_.read((char *)&chunk, sizeof(chunk))) {
+        if (!memcmp(chunk.id, "fmt ", 4)) {
+            if (chunk.size < sizeof(FormatChunk)) {
+                break;
+            }
+            std::vector<char> data(chunk.size);
+            if (!file_.read(data.data(), data.size())) {
+                break;
+            }
+            FormatChunk fmt;
+            memcpy(&fmt, data.data(), sizeof(fmt));
+            format = fmt.format;
+            if (format == WAVE_FORMAT_EXTENSIBLE && chunk.size >= 40) {
+                // the first two bytes of the subformat GUID contain the actual format
+                memcpy(&format, data.data() + 24, sizeof(format));
+            }
+            numChannels_ = fmt.numChannels;
+            sampleRate_ = fmt.sampleRate;
+            bitsPerSample = fmt.bitsPerSample;
+            haveFormat = true;
+        } else if (!memcmp(chunk.id, "data", 4)) {
+            if (!haveFormat) {
+                break;
+            }
+            bytesPerSample_ = bitsPerSample / 8;
+            if (format == WAVE_FORMAT_PCM && bitsPerSample >= 8 && bitsPerSample <= 32
+                    && (bitsPerSample % 8) == 0) {
+                isFloat_ = false;
+            } else if (format == WAVE_FORMAT_IEEE_FLOAT && (bitsPerSample == 32
+                                                            || bitsPerSample == 64)) {
+                isFloat_ = true;
+            } else {
+                throw Error(Error::UnknownError, path + ": unsupported sample format ("
+                            + std::to_string(format) + ", "
+                            + std::to_string(bitsPerSample) + " bits)");
+            }
+            if (numChannels_ <= 0) {
+                break;
+            }
+            numFrames_ = chunk.size / (bytesPerSample_ * numChannels_);
+            return; // the file is now positioned at the start of the sample data
+        } else {
+            // skip chunk; chunks are padded to an even size
+            file_.seekg(chunk.size + (chunk.size & 1), std::ios_base::cur);
+        }
+    }
+    throw Error(Error::UnknownError, path + ": bad or missing WAV header");
+}
+
+int64_t WavReader::read(float *data, int64_t numFrames) {
+    numFrames = std::min<int64_t>(numFrames, numFrames_ - position_);
+    if (numFrames <= 0) {
+        return 0;
+    }
+    auto numSamples = numFrames * numChannels_;
+    buffer_.resize(numSamples * bytesPerSample_);
+    if (!file_.read(buffer_.data(), buffer_.size())) {
+        // truncated file
+        numFrames = file_.gcount() / (bytesPerSample_ * numChannels_);
+        numSamples = numFrames * numChannels_;
+        numFrames_ = position_ + numFrames;
+    }
+    auto src = (const unsigned char *)buffer_.data();
+    if (isFloat_) {
+        if (bytesPerSample_ == 4) {
+            memcpy(data, src, numSamples * sizeof(float));
+        } else {
+            for (int64_t i = 0; i < numSamples; ++i) {
+                double d;
+                memcpy(&d, src + i * 8, sizeof(d));
+                data[i] = d;
+            }
+        }
+    } else if (bytesPerSample_ == 1) {
+        // 8-bit PCM is unsigned
+        for (int64_t i = 0; i < numSamples; ++i) {
+            data[i] = ((int)src[i] - 128) * (1.f / 128.f);
+        }
+    } else {
+        // left-align to 32 bit, so we can use the same scale for all bit depths
+        const int shift = 32 - bytesPerSample_ * 8;
+        const float scale = 1.f / 2147483648.f;
+        for (int64_t i = 0; i < numSamples; ++i) {
+            uint32_t u = 0;
+            for (int j = 0; j < bytesPerSample_; ++j) {
+                u |= (uint32_t)src[i * bytesPerSample_ + j] << (j * 8);
+            }
+            data[i] = (int32_t)(u << shift) * scale;
+        }
+    }
+    position_ += numFrames;
+    return numFrames;
+}
+
+/*/////////////////// WavWriter ////////////////////*/
+
+WavWriter::WavWriter(const std::string& path, int numChannels, double sampleRate)
+    : file_(path, File::WRITE), path_(path),
+      numChannels_(numChannels), sampleRate_(sampleRate)
+{
+    if (!file_.is_open()) {
+        throw Error(Error::SystemError, "couldn't create file " + path);
+    }
+    if (numChannels <= 0) {
+        throw Error(Error::UnknownError, path + ": bad channel count");
+    }
+    // write preliminary header; the sizes are updated in close()
+    writeHeader();
+}
+
+WavWriter::~WavWriter() {
+    try {
+        close();
+    } catch (const Error&) {}
+}
+
+void WavWriter::write(const float *data, int64_t numFrames) {
+    const int64_t maxFrames = (std::numeric_limits<uint32_t>::max() - headerSize)
+        / (numChannels_ * sizeof(float));
+    if (numFrames_ + numFrames > maxFrames) {
+        throw Error(Error::UnknownError, path_ + ": WAV file too large");
+    }
+    if (!file_.write((const char *)data, numFrames * numChannels_ * sizeof(float))) {
+        throw Error(Error::SystemError, "couldn't write file " + path_);
+    }
+    numFrames_ += numFrames;
+}
+
+void WavWriter::close() {
+    if (file_.is_open()) {
+        file_.seekp(0);
+        writeHeader();
+        file_.close();
+        if (file_.fail()) {
+            throw Error(Error::SystemError, "couldn't write file " + path_);
+        }
+    }
+}
+
+void WavWriter::writeHeader() {
+    uint32_t dataSize = numFrames_ * numChannels_ * sizeof(float);
+    uint32_t riffSize = headerSize - 8 + dataSize;
+    FormatChunk fmt;
+    fmt.format = WAVE_FORMAT_IEEE_FLOAT;
+    fmt.numChannels = numChannels_;
+    fmt.sampleRate = sampleRate_;
+    fmt.blockAlign = numChannels_ * sizeof(float);
+    fmt.byteRate = fmt.sampleRate * fmt.blockAlign;
+    fmt.bitsPerSample = 32;
+
+    file_.write("RIFF", 4);
+    file_.write((const char *)&riffSize, 4);
+    file_.write("WAVE", 4);
+    ChunkHeader chunk;
+    memcpy(chunk.id, "fmt ", 4);
+    chunk.size = sizeof(fmt);
+    file_.write((const char *)&chunk, sizeof(chunk));
+    file_.write((const char *)&fmt, sizeof(fmt));
+    memcpy(chunk.id, "data", 4);
+    chunk.size = dataSize;
+    file_.write((const char *)&chunk, sizeof(chunk));
+}
+
+} // vst
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "FileUtils.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vst {
+
+// Minimal streaming WAV file reader and writer for offline rendering, see OfflineRender.h.
+// All sample data is converted from/to interleaved 32-bit float.
+// The constructors and methods throw an Error exception on failure!
+
+// reads 8/16/24/32-bit integer and 32/64-bit float PCM (incl. WAVE_FORMAT_EXTENSIBLE)
+class WavReader {
+ public:
+    WavReader(const std::string& path);
+
+    int numChannels() const { return numChannels_; }
+    double sampleRate() const { return sampleRate_; }
+    int64_t numFrames() const { return numFrames_; }
+
+    // read up to 'numFrames' interleaved frames; returns the number of frames read.
+    int64_t read(float *data, int64_t numFrames);
+ private:
+    File file_;
+    std::string path_;
+    int numChannels_ = 0;
+    double sampleRate_ = 0;
+    int64_t numFrames_ = 0;
+    int64_t position_ = 0;
+    int bytesPerSample_ = 0;
+    bool isFloat_ = false;
+    std::vector<char> buffer_;
+};
+
+// writes 32-bit float PCM
+class WavWriter {
+ public:
+    WavWriter(const std::string& path, int numChannels, double sampleRate);
+    ~WavWriter();
+
+    int numChannels() const { return numChannels_; }
+    int64_t numFrames() const { return numFrames_; }
+
+    // write 'numFrames' interleaved frames
+    void write(const float *data, int64_t numFrames);
+    // update the header and close the file; called by the destructor.
+    void close();
+ private:
+    void writeHeader();
+
+    File file_;
+    std::string path_;
+    int numChannels_ = 0;
+    double sampleRate_ = 0;
+    int64_t numFrames_ = 0;
+};
+
+} // vst
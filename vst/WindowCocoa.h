@@ -15,9 +15,9 @@
 - (void)windowDidResize:(NSNotification *)notification;
 - (void)windowDidMiniaturize:(NSNotification *)notification;
 - (void)windowDidDeminiaturize:(NSNotification *)notification;
+- (void)windowDidChangeState:(NSNotification *)notification;
 - (void)windowDidMove:(NSNotification *)notification;
 - (BOOL)performKeyEquivalent:(NSEvent *)event;
-- (void)updateEditor;
 
 @end
 
@@ -33,6 +33,7 @@ class EventLoop;
 
 - (id)initWithOwner:(vst::Cocoa::EventLoop*)owner;
 - (void)poll;
+- (void)updateEditors;
 
 @end
 
@@ -55,13 +56,18 @@ public:
     }
 
     using BaseEventLoop::doPoll; // make public
+    using BaseEventLoop::doUpdateEditors; // make public
 private:
     void startPolling() override;
     void stopPolling() override;
+    void scheduleWakeup(int ms) override;
+    void startEditorTimer(int ms) override;
+    void stopEditorTimer() override;
 
     bool haveNSApp_ = false;
     EventLoopProxy *proxy_ = nil;
     NSTimer *timer_ = nil;
+    NSTimer *editorTimer_ = nil;
 };
 
 class Window : public IWindow {
@@ -79,7 +85,7 @@ class Window : public IWindow {
     void doOpen();
     void onClose();
     void onResize(int w, int h);
-    void updateEditor();
+    void updateEditorState();
  private:
     void *getHandle();
     void updateFrame();
@@ -87,7 +93,6 @@ class Window : public IWindow {
 
     CocoaEditorWindow * window_ = nullptr;
     IPlugin *plugin_;
-    NSTimer *timer_;
     Rect rect_{ 100, 100, 0, 0 }; // empty rect!
     bool adjustSize_ = false;
     bool adjustPos_ = false;
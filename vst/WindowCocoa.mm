@@ -42,16 +42,19 @@
 
 - (void)windowDidMiniaturize:(NSNotification *)notification {
     LOG_DEBUG("Cocoa: window miniaturized");
+    static_cast<vst::Cocoa::Window *>(owner_)->updateEditorState();
 }
 - (void)windowDidDeminiaturize:(NSNotification *)notification {
     LOG_DEBUG("Cocoa: window deminiaturized");
+    static_cast<vst::Cocoa::Window *>(owner_)->updateEditorState();
+}
+// key window and occlusion state changes
+- (void)windowDidChangeState:(NSNotification *)notification {
+    static_cast<vst::Cocoa::Window *>(owner_)->updateEditorState();
 }
 - (void)windowDidMove:(NSNotification *)notification {
     LOG_DEBUG("Cocoa: window did move");
 }
-- (void)updateEditor {
-    static_cast<vst::Cocoa::Window *>(owner_)->updateEditor();
-}
 - (BOOL)performKeyEquivalent:(NSEvent *)event {
     if (event.type == NSKeyDown){
         if (event.modifierFlags & NSCommandKeyMask){
@@ -82,6 +85,10 @@
 - (void)poll {
     owner_->doPoll();
 }
+
+- (void)updateEditors {
+    owner_->doUpdateEditors();
+}
 @end
 
 namespace vst {
@@ -178,16 +185,24 @@ bool callAsync(Callback cb, void *user){
     return Cocoa::EventLoop::instance().callAsync(cb, user);
 }
 
-int32_t addPollFunction(PollFunction fn, void *context){
-    return Cocoa::EventLoop::instance().addPollFunction(fn, context);
+int32_t addPollFunction(PollFunction fn, void *context, bool eventDriven){
+    return Cocoa::EventLoop::instance().addPollFunction(fn, context, eventDriven);
 }
 
 void removePollFunction(int32_t handle){
     return Cocoa::EventLoop::instance().removePollFunction(handle);
 }
 
+void notifyPollFunctions(){
+    Cocoa::EventLoop::instance().notifyPollFunctions();
+}
+
 } // UIThread
 
+void setEditorFrameRate(double fps, double backgroundFps){
+    Cocoa::EventLoop::instance().setEditorFrameRate(fps, backgroundFps);
+}
+
 namespace Cocoa {
 
 /*////////////////////// EventLoop ////////////////////*/
@@ -233,6 +248,10 @@ EventLoop::~EventLoop(){
             [timer_ invalidate];
             timer_ = nil;
         }
+        if (editorTimer_) {
+            [editorTimer_ invalidate];
+            editorTimer_ = nil;
+        }
         [proxy_ release];
     }
 }
@@ -272,7 +291,7 @@ void EventLoop::startPolling() {
         LOG_ERROR("EventLoop: poll function timer already installed!");
         return;
     }
-    timer_ = [NSTimer scheduledTimerWithTimeInterval:(updateIntervalMillis * 0.001)
+    timer_ = [NSTimer scheduledTimerWithTimeInterval:(pollInterval() * 0.001)
                 target:proxy_
                 selector:@selector(poll)
                 userInfo:nil
@@ -286,6 +305,28 @@ void EventLoop::stopPolling() {
     }
 }
 
+void EventLoop::scheduleWakeup(int ms) {
+    auto time = dispatch_time(DISPATCH_TIME_NOW, (int64_t)ms * NSEC_PER_MSEC);
+    dispatch_after_f(time, dispatch_get_main_queue(), this, [](void *x) {
+        static_cast<EventLoop *>(x)->doWakeup();
+    });
+}
+
+void EventLoop::startEditorTimer(int ms) {
+    editorTimer_ = [NSTimer scheduledTimerWithTimeInterval:(ms * 0.001)
+                target:proxy_
+                selector:@selector(updateEditors)
+                userInfo:nil
+                repeats:YES];
+}
+
+void EventLoop::stopEditorTimer() {
+    if (editorTimer_) {
+        [editorTimer_ invalidate];
+        editorTimer_ = nil;
+    }
+}
+
 /*///////////////// Window ///////////////////////*/
 
 std::atomic<int> Window::numWindows_{0};
@@ -340,8 +381,20 @@ void Window::doOpen(){
                 defer:NO];
     if (window_){
         [window_ setOwner:this];
-        [[NSNotificationCenter defaultCenter] addObserver:window_ selector:@selector(windowDidResize:)
+        auto center = [NSNotificationCenter defaultCenter];
+        [center addObserver:window_ selector:@selector(windowDidResize:)
                 name:NSWindowDidResizeNotification object:window_];
+        // track the window state for editor updates, see updateEditorState()
+        [center addObserver:window_ selector:@selector(windowDidMiniaturize:)
+                name:NSWindowDidMiniaturizeNotification object:window_];
+        [center addObserver:window_ selector:@selector(windowDidDeminiaturize:)
+                name:NSWindowDidDeminiaturizeNotification object:window_];
+        [center addObserver:window_ selector:@selector(windowDidChangeState:)
+                name:NSWindowDidBecomeKeyNotification object:window_];
+        [center addObserver:window_ selector:@selector(windowDidChangeState:)
+                name:NSWindowDidResignKeyNotification object:window_];
+        [center addObserver:window_ selector:@selector(windowDidChangeState:)
+                name:NSWindowDidChangeOcclusionStateNotification object:window_];
         
         // set window title
         NSString *title = @(plugin_->info().name.c_str());
@@ -381,11 +434,7 @@ void Window::doOpen(){
             plugin_->openEditor(getHandle());
         }
 
-        timer_ = [NSTimer scheduledTimerWithTimeInterval:(EventLoop::updateIntervalMillis * 0.001)
-                    target:window_
-                    selector:@selector(updateEditor)
-                    userInfo:nil
-                    repeats:YES];
+        EventLoop::instance().addEditor(*plugin_, EditorState::Active);
 
         if (numWindows_.fetch_add(1) == 0){
             // first Window: transform process into foreground application.
@@ -415,10 +464,10 @@ void Window::close(){
 // to be called on the main thread
 void Window::onClose(){
     if (window_){
-        [[NSNotificationCenter defaultCenter] removeObserver:window_ name:NSWindowDidResizeNotification object:window_];
+        // remove all observers, see doOpen()
+        [[NSNotificationCenter defaultCenter] removeObserver:window_ name:nil object:window_];
 
-        [timer_ invalidate];
-        timer_ = nil;
+        EventLoop::instance().removeEditor(*plugin_);
 
         plugin_->closeEditor();
 
@@ -447,8 +496,23 @@ void Window::onClose(){
     }
 }
 
-void Window::updateEditor(){
-    plugin_->updateEditor();
+void Window::updateEditorState(){
+    if (window_){
+        EditorState state;
+        bool visible = true;
+        if ([window_ respondsToSelector:@selector(occlusionState)]){
+            // macOS 10.9+
+            visible = ([window_ occlusionState] & NSWindowOcclusionStateVisible) != 0;
+        }
+        if ([window_ isMiniaturized] || !visible){
+            state = EditorState::Hidden;
+        } else if ([window_ isKeyWindow]){
+            state = EditorState::Active;
+        } else {
+            state = EditorState::Background;
+        }
+        EventLoop::instance().setEditorState(*plugin_, state);
+    }
 }
 
 void * Window::getHandle(){
@@ -55,16 +55,24 @@ bool callAsync(Callback cb, void *user){
     return Win32::EventLoop::instance().callAsync(cb, user);
 }
 
-int32_t addPollFunction(PollFunction fn, void *context){
-    return Win32::EventLoop::instance().addPollFunction(fn, context);
+int32_t addPollFunction(PollFunction fn, void *context, bool eventDriven){
+    return Win32::EventLoop::instance().addPollFunction(fn, context, eventDriven);
 }
 
 void removePollFunction(int32_t handle){
     return Win32::EventLoop::instance().removePollFunction(handle);
 }
 
+void notifyPollFunctions(){
+    Win32::EventLoop::instance().notifyPollFunctions();
+}
+
 } // UIThread
 
+void setEditorFrameRate(double fps, double backgroundFps){
+    Win32::EventLoop::instance().setEditorFrameRate(fps, backgroundFps);
+}
+
 namespace Win32 {
 
 /*/////////////////// EventLoop //////////////////////*/
@@ -286,19 +294,36 @@ bool EventLoop::sync(){
 void EventLoop::handleTimer(UINT_PTR id) {
     if (id == pollTimerID) {
         doPoll(); // call poll functions
+    } else if (id == wakeupTimerID) {
+        KillTimer(hwnd_, wakeupTimerID); // one-shot
+        doWakeup(); // call poll functions
+    } else if (id == editorTimerID) {
+        doUpdateEditors();
     } else {
         LOG_DEBUG("Win32: unknown timer " << id);
     }
 }
 
 void EventLoop::startPolling() {
-    SetTimer(hwnd_, pollTimerID, updateIntervalMillis, NULL);
+    SetTimer(hwnd_, pollTimerID, pollInterval(), NULL);
 }
 
 void EventLoop::stopPolling() {
     KillTimer(hwnd_, pollTimerID);
 }
 
+void EventLoop::scheduleWakeup(int ms) {
+    SetTimer(hwnd_, wakeupTimerID, ms, NULL);
+}
+
+void EventLoop::startEditorTimer(int ms) {
+    SetTimer(hwnd_, editorTimerID, ms, NULL);
+}
+
+void EventLoop::stopEditorTimer() {
+    KillTimer(hwnd_, editorTimerID);
+}
+
 HICON EventLoop::getIcon() {
 #ifndef __WINE__
     // On Wine, for some reason, QueryFullProcessImageName() would silently truncate
@@ -415,25 +440,28 @@ LRESULT WINAPI Window::procedure(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPar
         LOG_DEBUG("Win32: WM_SIZE");
         if (wParam == SIZE_MAXIMIZED || wParam == SIZE_RESTORED){
             if (window){
+                window->onMinimize(false);
                 window->onSize(LOWORD(lParam), HIWORD(lParam));
             } else {
                 LOG_ERROR("Win32: bug GetWindowLongPtr");
             }
+        } else if (wParam == SIZE_MINIMIZED){
+            if (window){
+                window->onMinimize(true);
+            }
         }
         return true;
     }
-    default:
+    case WM_ACTIVATE:
+    {
+        if (window){
+            window->onActivate(LOWORD(wParam) != WA_INACTIVE);
+        }
+        // let the default procedure set the keyboard focus
         return DefWindowProcW(hWnd, msg, wParam, lParam);
     }
-}
-
-void CALLBACK Window::updateEditor(HWND hwnd, UINT msg, UINT_PTR id, DWORD time){
-    auto window = (Window *)GetWindowLongPtr(hwnd, GWLP_USERDATA);
-    if (window){
-        window->plugin_->updateEditor();
-        // LOG_DEBUG("update editor");
-    } else {
-        LOG_ERROR("Win32: bug GetWindowLongPtr");
+    default:
+        return DefWindowProcW(hWnd, msg, wParam, lParam);
     }
 }
 
@@ -514,7 +542,11 @@ void Window::doOpen(){
     ShowWindow(hwnd_, SW_RESTORE);
 #endif
 
-    SetTimer(hwnd_, timerID, EventLoop::updateIntervalMillis, &updateEditor);
+    // the window has just been restored and activated;
+    // the state is updated in the window procedure.
+    active_ = true;
+    minimized_ = false;
+    EventLoop::instance().addEditor(*plugin_, EditorState::Active);
 
     LOG_DEBUG("Win32: setup Window done");
 }
@@ -538,7 +570,7 @@ void Window::doClose(){
             adjustSize_ = false; // !
         }
 
-        KillTimer(hwnd_, timerID);
+        EventLoop::instance().removeEditor(*plugin_);
 
         plugin_->closeEditor();
 
@@ -655,6 +687,28 @@ void Window::onSize(int w, int h){
     LOG_DEBUG("Win32: size changed: " << w << ", " << h);
 }
 
+void Window::onActivate(bool active){
+    active_ = active;
+    updateEditorState();
+}
+
+void Window::onMinimize(bool minimized){
+    minimized_ = minimized;
+    updateEditorState();
+}
+
+void Window::updateEditorState(){
+    EditorState state;
+    if (minimized_) {
+        state = EditorState::Hidden;
+    } else if (active_) {
+        state = EditorState::Active;
+    } else {
+        state = EditorState::Background;
+    }
+    EventLoop::instance().setEditorState(*plugin_, state);
+}
+
 } // Win32
 
 IWindow::ptr IWindow::create(IPlugin &plugin){
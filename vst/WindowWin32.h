@@ -33,6 +33,8 @@ enum Message {
 class EventLoop : public BaseEventLoop {
 public:
     static const UINT_PTR pollTimerID = 1;
+    static const UINT_PTR wakeupTimerID = 2;
+    static const UINT_PTR editorTimerID = 3;
 
     static EventLoop& instance();
 
@@ -53,6 +55,9 @@ private:
     void initUIThread();
     void startPolling() override;
     void stopPolling() override;
+    void scheduleWakeup(int ms) override;
+    void startEditorTimer(int ms) override;
+    void stopEditorTimer() override;
 
     std::thread thread_;
     HWND hwnd_ = NULL;
@@ -81,14 +86,18 @@ private:
     void updateFrame();
     void onSizing(RECT& newRect);
     void onSize(int w, int h);
+    void onActivate(bool active);
+    void onMinimize(bool minimized);
+    void updateEditorState();
     bool canResize() const;
 
-    static const UINT_PTR timerID = 0x375067f6;
-    static void CALLBACK updateEditor(HWND hwnd, UINT msg, UINT_PTR id, DWORD time);
     HWND hwnd_ = nullptr;
     IPlugin* plugin_ = nullptr;
     Rect rect_{ 100, 100, 0, 0 }; // empty rect!
     bool adjustSize_ = false;
+    // window state for EditorState
+    bool active_ = false;
+    bool minimized_ = false;
 
     struct Command {
         Window *owner;
@@ -54,16 +54,24 @@ bool callAsync(Callback cb, void *user){
     return X11::EventLoop::instance().callAsync(cb, user);
 }
 
-int32_t addPollFunction(PollFunction fn, void *context){
-    return X11::EventLoop::instance().addPollFunction(fn, context);
+int32_t addPollFunction(PollFunction fn, void *context, bool eventDriven){
+    return X11::EventLoop::instance().addPollFunction(fn, context, eventDriven);
 }
 
 void removePollFunction(int32_t handle){
     return X11::EventLoop::instance().removePollFunction(handle);
 }
 
+void notifyPollFunctions(){
+    X11::EventLoop::instance().notifyPollFunctions();
+}
+
 } // UIThread
 
+void setEditorFrameRate(double fps, double backgroundFps){
+    X11::EventLoop::instance().setEditorFrameRate(fps, backgroundFps);
+}
+
 namespace X11 {
 
 namespace  {
@@ -192,17 +200,19 @@ int EventLoop::updateTimers() {
         Timer timer = timerQueue_.front();
         std::pop_heap(timerQueue_.begin(), timerQueue_.end(), Timer::Compare{});
         timerQueue_.pop_back();
-        // NB: reschedule *before* calling the function, so the timer can
-        // be found and removed from within the timer function!
-        timer.sequence = timerSequence_++;
-        if (timer.deadline == TimePoint{}) {
-            // first update
-            timer.deadline = now + Milliseconds(timer.interval);
-        } else {
-            timer.deadline += Milliseconds(timer.interval);
+        if (timer.interval > 0) {
+            // NB: reschedule *before* calling the function, so the timer can
+            // be found and removed from within the timer function!
+            timer.sequence = timerSequence_++;
+            if (timer.deadline == TimePoint{}) {
+                // first update
+                timer.deadline = now + Milliseconds(timer.interval);
+            } else {
+                timer.deadline += Milliseconds(timer.interval);
+            }
+            timerQueue_.push_back(timer);
+            std::push_heap(timerQueue_.begin(), timerQueue_.end(), Timer::Compare{});
         }
-        timerQueue_.push_back(timer);
-        std::push_heap(timerQueue_.begin(), timerQueue_.end(), Timer::Compare{});
         // finally call the function
         timer.cb(timer.obj);
     }
@@ -213,19 +223,14 @@ int EventLoop::updateTimers() {
         auto next = timerQueue_.front().deadline;
         now = std::chrono::time_point_cast<Milliseconds>(Clock::now());
         if (next > now) {
+            // NB: we don't need to poll for X11 events because
+            // pollFileDescriptors() also waits on the X11 connection.
             auto wait = (next - now).count();
-            // if we have (open) windows, limit wait time to pollGrain to keep the UI responsive!
-            // TODO: each Window already adds its own timer, do we really need to poll at lower intervals?
-            if (!windows_.empty()) {
-                wait = std::min<int>(wait, pollGrain);
-            }
             // LOG_DEBUG("X11: wait for " << wait << " ms");
             return wait;
         } else {
             return 0; // don't wait
         }
-    } else if (!windows_.empty()) {
-        return pollGrain; // poll for X11 events
     } else {
         // NB: currently this won't ever happen because we've installed
         // a timer that periodically calls callPollFunctions().
@@ -237,8 +242,8 @@ void EventLoop::pollFileDescriptors(int timeout){
     // NB: we copy the fd array to prevent it from being modified
     // from within event handlers!
     int count = eventHandlers_.size();
-    // allocate extra fd for eventfd_
-    auto fds = (pollfd *)alloca(sizeof(pollfd) * (count + 1));
+    // allocate extra fds for eventfd_ and the X11 connection
+    auto fds = (pollfd *)alloca(sizeof(pollfd) * (count + 2));
     auto it = eventHandlers_.begin();
     for (int i = 0; i < count; ++i, ++it){
         fds[i].fd = it->first;
@@ -248,12 +253,23 @@ void EventLoop::pollFileDescriptors(int timeout){
     fds[count].fd = eventfd_;
     fds[count].events = POLLIN;
     fds[count].revents = 0;
+    // wake up on incoming X11 events
+    fds[count + 1].fd = ConnectionNumber(display_);
+    fds[count + 1].events = POLLIN;
+    fds[count + 1].revents = 0;
+
+    // Xlib might have already read pending events from the connection,
+    // e.g. in a timer callback, so we must not wait in this case.
+    if (XEventsQueued(display_, QueuedAlready) > 0) {
+        timeout = 0;
+    }
 
     if (timeout < 0) {
         LOG_DEBUG("X11: waiting...");
     }
 
-    auto result = poll(fds, count + 1, timeout);
+    // NB: X11 events are handled in pollX11Events()
+    auto result = poll(fds, count + 2, timeout);
     if (result > 0){
         // check registered event handler fds
         for (int i = 0; i < count; ++i){
@@ -322,6 +338,27 @@ void EventLoop::pollX11Events(){
             } else {
                 LOG_ERROR("X11: ConfigureNotify: couldn't find Window " << xce.window);
             }
+        } else if (event.type == MapNotify || event.type == UnmapNotify) {
+            // NB: minimized windows are unmapped
+            auto w = findWindow(event.xany.window);
+            if (w) {
+                w->onMap(event.type == MapNotify);
+            }
+        } else if (event.type == FocusIn || event.type == FocusOut) {
+            XFocusChangeEvent& xfe = event.xfocus;
+            // ignore focus changes between our window and the editor (child) window
+            if (xfe.detail != NotifyInferior && xfe.detail != NotifyPointer) {
+                auto w = findWindow(xfe.window);
+                if (w) {
+                    w->onFocus(event.type == FocusIn);
+                }
+            }
+        } else if (event.type == VisibilityNotify) {
+            XVisibilityEvent& xve = event.xvisibility;
+            auto w = findWindow(xve.window);
+            if (w) {
+                w->onVisibility(xve.state == VisibilityFullyObscured);
+            }
         } else {
             // LOG_DEBUG("got event: " << event.type);
         }
@@ -411,16 +448,12 @@ void EventLoop::registerWindow(Window *w) {
         }
     }
     windows_.push_back(w);
-    doRegisterTimer(updateIntervalMillis, [](void *x){
-        static_cast<Window *>(x)->onUpdate();
-    }, w);
 }
 
 void EventLoop::unregisterWindow(Window *w) {
     assert(UIThread::isCurrentThread());
     auto it = std::find(windows_.begin(), windows_.end(), w);
     if (it != windows_.end()) {
-        doUnregisterTimer(w);
         windows_.erase(it);
         return;
     }
@@ -498,19 +531,45 @@ void EventLoop::doUnregisterTimer(void *obj){
 
 void EventLoop::startPolling() {
     if (std::find_if(timerQueue_.begin(), timerQueue_.end(),
-                     [&](auto& x) { return x.obj == this; }) != timerQueue_.end()) {
+                     [&](auto& x) { return x.obj == this && x.interval > 0; }) != timerQueue_.end()) {
         LOG_ERROR("EventLoop: poll function timer already installed!");
         return;
     }
-    doRegisterTimer(updateIntervalMillis, [](void *x) {
+    doRegisterTimer(pollInterval(), [](void *x) {
         static_cast<EventLoop *>(x)->doPoll();
     }, this);
 }
 
 void EventLoop::stopPolling() {
+    // NB: also removes a pending wakeup timer
     doUnregisterTimer(this);
 }
 
+void EventLoop::scheduleWakeup(int ms) {
+    auto now = std::chrono::time_point_cast<Milliseconds>(Clock::now());
+    Timer timer;
+    timer.cb = [](void *x) {
+        static_cast<EventLoop *>(x)->doWakeup();
+    };
+    timer.obj = this;
+    timer.interval = 0; // one-shot
+    timer.sequence = timerSequence_++;
+    timer.deadline = now + Milliseconds(ms);
+    timerQueue_.push_back(timer);
+    std::push_heap(timerQueue_.begin(), timerQueue_.end(), Timer::Compare{});
+}
+
+void EventLoop::startEditorTimer(int ms) {
+    // NB: use a separate key, so that stopPolling() won't remove the editor timer
+    doRegisterTimer(ms, [](void *x) {
+        EventLoop::instance().doUpdateEditors();
+    }, &editorTimerKey_);
+}
+
+void EventLoop::stopEditorTimer() {
+    doUnregisterTimer(&editorTimerKey_);
+}
+
 /*///////////////// Window ////////////////////*/
 
 Window::Window(Display& display, IPlugin& plugin)
@@ -553,8 +612,9 @@ void Window::doOpen(){
     window_ = XCreateSimpleWindow(display_, RootWindow(display_, s),
                 0, 0, 300, 300, 1,
                 BlackPixel(display_, s), WhitePixel(display_, s));
-    // receive configure events
-    XSelectInput(display_, window_, StructureNotifyMask);
+    // receive configure, map/unmap, focus and visibility events
+    XSelectInput(display_, window_, StructureNotifyMask
+                 | FocusChangeMask | VisibilityChangeMask);
     // Intercept request to delete window when being closed
     XSetWMProtocols(display_, window_, &wmDelete, 1);
     // set window class hint
@@ -617,6 +677,12 @@ void Window::doOpen(){
 
     LOG_DEBUG("X11: register Window");
     EventLoop::instance().registerWindow(this);
+    // we have just mapped the window and the window manager
+    // will typically focus it; the state is updated by events.
+    mapped_ = true;
+    focused_ = true;
+    obscured_ = false;
+    EventLoop::instance().addEditor(*plugin_, EditorState::Active);
 }
 
 void Window::close(){
@@ -630,6 +696,7 @@ void Window::doClose(){
         savePosition();
 
         LOG_DEBUG("X11: unregister Window");
+        EventLoop::instance().removeEditor(*plugin_);
         EventLoop::instance().unregisterWindow(this);
 
         LOG_DEBUG("X11: close editor");
@@ -727,8 +794,32 @@ void Window::onClose(){
     doClose();
 }
 
-void Window::onUpdate(){
-    plugin_->updateEditor();
+void Window::onMap(bool mapped){
+    LOG_DEBUG("X11: " << (mapped ? "mapped" : "unmapped"));
+    mapped_ = mapped;
+    updateEditorState();
+}
+
+void Window::onFocus(bool focused){
+    focused_ = focused;
+    updateEditorState();
+}
+
+void Window::onVisibility(bool obscured){
+    obscured_ = obscured;
+    updateEditorState();
+}
+
+void Window::updateEditorState(){
+    EditorState state;
+    if (!mapped_ || obscured_) {
+        state = EditorState::Hidden;
+    } else if (focused_) {
+        state = EditorState::Active;
+    } else {
+        state = EditorState::Background;
+    }
+    EventLoop::instance().setEditorState(*plugin_, state);
 }
 
 void Window::onConfigure(int x, int y, int width, int height){
@@ -22,9 +22,6 @@ class Window;
 
 class EventLoop : public BaseEventLoop {
 public:
-    // TODO: is pollGrain really necessary?
-    static constexpr int pollGrain = 10;
-
     static EventLoop& instance();
 
     EventLoop();
@@ -56,6 +53,9 @@ public:
 private:
     void startPolling() override;
     void stopPolling() override;
+    void scheduleWakeup(int ms) override;
+    void startEditorTimer(int ms) override;
+    void stopEditorTimer() override;
 
     void initUIThread();
     void pushCommand(UIThread::Callback cb, void *obj);
@@ -109,12 +109,13 @@ private:
 
         TimerCallback cb = nullptr;
         void *obj = nullptr;
-        int64_t interval;
+        int64_t interval; // 0: one-shot timer
         uint64_t sequence; // keep insertion order
         TimePoint deadline;
     };
     std::vector<Timer> timerQueue_;
     uint64_t timerSequence_ = 0;
+    char editorTimerKey_ = 0; // see startEditorTimer()
 };
 
 class Window : public IWindow {
@@ -131,7 +132,9 @@ class Window : public IWindow {
 
     void onClose();
     void onConfigure(int x, int y, int width, int height);
-    void onUpdate();
+    void onMap(bool mapped);
+    void onFocus(bool focused);
+    void onVisibility(bool obscured);
 
     void *getHandle() { return (void *)window_; }
  private:
@@ -148,6 +151,12 @@ class Window : public IWindow {
     void doClose();
     void setFixedSize(int w, int h);
     void savePosition();
+    void updateEditorState();
+
+    // window state for EditorState
+    bool mapped_ = false;
+    bool focused_ = false;
+    bool obscured_ = false;
 
     struct Command {
         Window *owner;
@@ -3,13 +3,25 @@
 #include "Log.h"
 #include "FileUtils.h"
 #include "MiscUtils.h"
+#include "ProbeWorker.h"
+#include "OfflineRender.h"
 #if USE_BRIDGE
 #include "PluginServer.h"
 #endif
 
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <memory>
 #include <mutex>
+#include <sstream>
+#include <thread>
+#if VST_HOST_SYSTEM != VST_WINDOWS
+#include <unistd.h>
+#endif
 
 // a) probe on main thread without event loop
 #define PROBE_WITHOUT_UI_THREAD 0
@@ -36,39 +48,82 @@ using namespace vst;
 # define shorten(x) x
 #endif
 
-void writeErrorMsg(Error::ErrorCode code, std::string_view msg, const std::string& path){
-    if (!path.empty()){
-        // this part should be async signal safe
-        vst::File file(path, File::WRITE);
-        if (file.is_open()) {
-            file << static_cast<int>(code) << "\n";
-            file << msg << "\n";
-        } else {
-            LOG_ERROR("ERROR: couldn't write error message");
+// Receives the probe results resp. error message and writes them
+// to the reply pipe of the probe worker, see ProbeReply.
+using ProbeSink = std::function<void(ProbeReply::Type type, std::string_view data)>;
+
+static void writeErrorMsg(Error::ErrorCode code, std::string_view msg, const ProbeSink& sink){
+    std::stringstream ss;
+    ss << static_cast<int>(code) << "\n";
+    ss << msg << "\n";
+    sink(ProbeReply::Failure, ss.str());
+}
+
+// Probe all sub-plugins of a factory in a single pass.
+// Every result is sent as a separate record as soon as it is available,
+// so the host can already collect the results while we're still probing.
+// If a sub-plugin crashes the process, the host knows exactly which
+// sub-plugins are still missing. See PluginFactory::doProbeAll().
+static void probeSubPlugins(const IFactory& factory, const PluginDesc& desc,
+                            const ProbeSink& sink) {
+    int numPlugins = desc.subPlugins.size();
+    for (int i = 0; i < numPlugins; ++i) {
+        std::stringstream ss;
+        ss << "[result]\n";
+        ss << "index=" << i << "\n";
+        try {
+            auto sub = factory.probePlugin(desc.subPlugins[i].id);
+            ss << "error=0\n";
+            sub->serialize(ss);
+        } catch (const Error& e) {
+            LOG_DEBUG("couldn't probe '" << desc.subPlugins[i].name << "': " << e.what());
+            ss << "error=" << static_cast<int>(e.code()) << "\n";
+            std::string msg = e.what();
+            std::replace(msg.begin(), msg.end(), '\n', ' ');
+            ss << "msg=" << msg << "\n";
         }
+        ss << "[end]\n";
+        sink(ProbeReply::Data, ss.str());
     }
 }
 
-// probe a plugin and write info to file
+// probe a plugin and pass the info to the sink
 // returns EXIT_SUCCESS on success, EXIT_FAILURE on fail and anything else on error/crash :-)
-int probe(const std::string& pluginPath, int pluginIndex, const std::string& filePath)
+int probe(const std::string& pluginPath, int pluginIndex, const ProbeSink& sink)
 {
     setThreadPriority(Priority::Low);
 
     LOG_DEBUG("probing " << pluginPath << " " << pluginIndex);
+
+    bool singlePass = pluginIndex == PROBE_ALL_SUBPLUGINS;
+
+    // throws an Error on failure
+    auto doProbe = [&]() {
+        auto factory = vst::IFactory::load(pluginPath, true);
+        auto desc = factory->probePlugin(singlePass ? -1 : pluginIndex);
+
+        std::stringstream ss;
+        desc->serialize(ss);
+        if (singlePass) {
+            ss << "[end]\n";
+        }
+        sink(ProbeReply::Data, ss.str());
+        if (singlePass && !desc->subPlugins.empty()) {
+            probeSubPlugins(*factory, *desc, sink);
+        }
+    };
+
     try {
 #if PROBE_MODE != PROBE_WITHOUT_UI_THREAD
         // setup UI event loop
         LOG_DEBUG("setup event loop");
         UIThread::setup();
 
-        vst::PluginDesc::const_ptr desc;
         Error error;
 
         auto fn = [&]() {
             try {
-                auto factory = vst::IFactory::load(pluginPath, true);
-                desc = factory->probePlugin(pluginIndex);
+                doProbe();
             } catch (const Error& e) {
                 error = e;
             }
@@ -104,34 +159,140 @@ int probe(const std::string& pluginPath, int pluginIndex, const std::string& fil
 
 #else // PROBE_WITHOUT_UI_THREAD
 
-        auto factory = vst::IFactory::load(pluginPath, true);
-        auto desc = factory->probePlugin(pluginIndex);
+        doProbe();
 
 #endif // PROBE_MODE
 
-        if (!filePath.empty()) {
-            vst::File file(filePath, File::WRITE);
-            if (file.is_open()) {
-                desc->serialize(file);
-            } else {
-                LOG_ERROR("ERROR: couldn't write info file " << filePath);
-            }
-        }
         LOG_VERBOSE("probe succeeded");
         return EXIT_SUCCESS;
     } catch (const Error& e){
-        writeErrorMsg(e.code(), e.what(), filePath);
+        writeErrorMsg(e.code(), e.what(), sink);
         LOG_ERROR("probe failed: " << e.what());
     } catch (const std::exception& e) {
-        writeErrorMsg(Error::UnknownError, e.what(), filePath);
+        writeErrorMsg(Error::UnknownError, e.what(), sink);
         LOG_ERROR("probe failed: " << e.what());
     } catch (...) {
-        writeErrorMsg(Error::UnknownError, "unknown exception", filePath);
+        writeErrorMsg(Error::UnknownError, "unknown exception", sink);
         LOG_ERROR("probe failed: unknown exception");
     }
     return EXIT_FAILURE;
 }
 
+#if VST_HOST_SYSTEM == VST_WINDOWS
+using PipeHandle = HANDLE;
+#else
+using PipeHandle = int;
+#endif
+
+static bool readPipe(PipeHandle pipe, void *data, size_t size) {
+    auto buf = static_cast<char *>(data);
+    while (size > 0) {
+#if VST_HOST_SYSTEM == VST_WINDOWS
+        DWORD bytesRead = 0;
+        if (!ReadFile(pipe, buf, size, &bytesRead, NULL) || bytesRead == 0) {
+            return false;
+        }
+#else
+        auto bytesRead = read(pipe, buf, size);
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        } else if (bytesRead <= 0) {
+            return false;
+        }
+#endif
+        buf += bytesRead;
+        size -= bytesRead;
+    }
+    return true;
+}
+
+static bool writePipe(PipeHandle pipe, const void *data, size_t size) {
+    auto buf = static_cast<const char *>(data);
+    while (size > 0) {
+#if VST_HOST_SYSTEM == VST_WINDOWS
+        DWORD bytesWritten = 0;
+        if (!WriteFile(pipe, buf, size, &bytesWritten, NULL)) {
+            return false;
+        }
+#else
+        auto bytesWritten = write(pipe, buf, size);
+        if (bytesWritten < 0 && errno == EINTR) {
+            continue;
+        } else if (bytesWritten <= 0) {
+            return false;
+        }
+#endif
+        buf += bytesWritten;
+        size -= bytesWritten;
+    }
+    return true;
+}
+
+// probe plugins on request until the host closes the command pipe, see ProbeWorker
+int probeWorker(int pid, intptr_t cmdPipe, intptr_t replyPipe) {
+#if VST_HOST_SYSTEM == VST_WINDOWS
+    // duplicate pipe handles
+    HANDLE hCmd = NULL, hReply = NULL;
+    auto hParent = OpenProcess(PROCESS_DUP_HANDLE, FALSE, pid);
+    if (!hParent) {
+        LOG_ERROR("OpenProcess() failed: " << errorMessage(GetLastError()));
+        return EXIT_FAILURE;
+    }
+    bool ok = DuplicateHandle(hParent, (HANDLE)cmdPipe, GetCurrentProcess(), &hCmd,
+                              0, FALSE, DUPLICATE_SAME_ACCESS)
+           && DuplicateHandle(hParent, (HANDLE)replyPipe, GetCurrentProcess(), &hReply,
+                              0, FALSE, DUPLICATE_SAME_ACCESS);
+    CloseHandle(hParent);
+    if (!ok) {
+        LOG_ERROR("DuplicateHandle() failed: " << errorMessage(GetLastError()));
+        return EXIT_FAILURE;
+    }
+#else
+    int hCmd = cmdPipe;
+    int hReply = replyPipe;
+#endif
+    LOG_DEBUG("probe worker begin");
+    bool ok = true;
+    auto sink = [&](ProbeReply::Type type, std::string_view data) {
+        // send header and data in one go, see ProbeWorker::readReply()
+        ProbeReply reply;
+        reply.type = type;
+        reply.code = 0;
+        reply.size = data.size();
+        std::string msg;
+        msg.reserve(sizeof(reply) + data.size());
+        msg.append((const char *)&reply, sizeof(reply));
+        msg.append(data);
+        if (ok && !writePipe(hReply, msg.data(), msg.size())) {
+            LOG_ERROR("probe worker: couldn't write reply");
+            ok = false;
+        }
+    };
+    while (ok) {
+        ProbeRequest request;
+        if (!readPipe(hCmd, &request, sizeof(request))) {
+            break; // pipe closed by host
+        }
+        std::string path(request.pathSize, '\0');
+        if (!readPipe(hCmd, path.data(), path.size())) {
+            break;
+        }
+        ProbeReply reply;
+        reply.type = ProbeReply::Done;
+        reply.code = probe(path, request.id, sink);
+        reply.size = 0;
+        if (!ok || !writePipe(hReply, &reply, sizeof(reply))) {
+            break;
+        }
+    }
+    LOG_DEBUG("probe worker end");
+#if VST_HOST_SYSTEM == VST_WINDOWS
+    CloseHandle(hCmd);
+    CloseHandle(hReply);
+#endif
+    return EXIT_SUCCESS;
+}
+
 #if USE_BRIDGE
 
 #if VST_HOST_SYSTEM == VST_WINDOWS
@@ -216,6 +377,134 @@ int bridge(int pid, const std::string& path, int logChannel){
 
 #endif // USE_BRIDGE
 
+// render one or more audio files with a plugin chain, see OfflineRender.h
+int render(const std::vector<std::string>& args){
+    int numThreads = 0;
+    int blockSize = OfflineRenderer::defaultBlockSize;
+    RenderJob options;
+    std::vector<std::pair<std::string, std::string>> plugins; // path + preset
+    std::vector<std::string> files;
+
+    try {
+        for (size_t i = 0; i < args.size(); ++i) {
+            auto& arg = args[i];
+            if (arg.size() == 2 && arg[0] == '-') {
+                if (i + 1 >= args.size()) {
+                    throw Error("missing value for " + arg);
+                }
+                auto& value = args[++i];
+                switch (arg[1]) {
+                case 'j':
+                    numThreads = std::stol(value);
+                    break;
+                case 'b':
+                    blockSize = std::stol(value);
+                    break;
+                case 't':
+                    options.tail = std::stod(value);
+                    break;
+                case 'd':
+                    if (std::stol(value)) {
+                        options.precision = ProcessPrecision::Double;
+                    }
+                    break;
+                case 'm':
+                    if (value == "native") {
+                        options.runMode = RunMode::Native;
+                    } else if (value == "bridge") {
+                        options.runMode = RunMode::Bridge;
+                    } else if (value == "sandbox") {
+                        options.runMode = RunMode::Sandbox;
+                    } else {
+                        throw Error("bad run mode " + value);
+                    }
+                    break;
+                case 'p':
+                    plugins.emplace_back(value, "");
+                    break;
+                case 'P':
+                    if (plugins.empty()) {
+                        throw Error("preset without plugin");
+                    }
+                    plugins.back().second = value;
+                    break;
+                default:
+                    throw Error("unknown option " + arg);
+                }
+            } else {
+                files.push_back(arg);
+            }
+        }
+        if (plugins.empty()) {
+            throw Error("missing plugin");
+        }
+        if (files.empty() || (files.size() % 2) != 0) {
+            throw Error("expecting pairs of input and output files");
+        }
+    } catch (const Error& e) {
+        LOG_ERROR("render: " << e.what());
+        return EXIT_FAILURE;
+    } catch (const std::exception& e) {
+        LOG_ERROR("render: bad arguments");
+        return EXIT_FAILURE;
+    }
+
+    // plugins are created on the UI thread
+    UIThread::setup();
+
+    Error error;
+    std::atomic<int> numFailed{0};
+
+    std::thread thread([&]() {
+        try {
+            // keep the factories alive while rendering!
+            std::vector<IFactory::ptr> factories;
+            for (auto& [path, preset] : plugins) {
+                auto factory = IFactory::load(path);
+                factory->probe([&](const ProbeResult& result) {
+                    if (!result.valid()) {
+                        LOG_ERROR(path << ": probe failed: " << result.error.what());
+                    }
+                }, 30.0);
+                if (!factory->valid()) {
+                    throw Error("couldn't probe " + path);
+                }
+                options.chain.push_back(RenderPlugin { factory->getPlugin(0), preset, {} });
+                factories.push_back(std::move(factory));
+            }
+
+            OfflineRenderer renderer(numThreads, blockSize);
+            for (size_t i = 0; i < files.size(); i += 2) {
+                auto job = options;
+                job.inputFile = files[i];
+                job.outputFile = files[i + 1];
+                renderer.push(std::move(job), [&, i](int id, RenderResult& result) {
+                    if (result.ok()) {
+                        LOG_VERBOSE(files[i + 1] << ": " << result.numFrames << " frames in "
+                                    << result.elapsed << " s");
+                    } else {
+                        LOG_ERROR(files[i + 1] << ": " << result.error.what());
+                        numFailed++;
+                    }
+                });
+            }
+            renderer.wait();
+        } catch (const Error& e) {
+            error = e;
+        }
+        UIThread::quit();
+    });
+
+    UIThread::run();
+    thread.join();
+
+    if (error.code() != Error::NoError) {
+        LOG_ERROR("render failed: " << error.what());
+        return EXIT_FAILURE;
+    }
+    return numFailed.load() > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 #if USE_WMAIN
 int wmain(int argc, const wchar_t *argv[]){
 #else
@@ -225,18 +514,18 @@ int main(int argc, const char *argv[]) {
         std::string verb = shorten(argv[1]);
         argc -= 2;
         argv += 2;
-        if (verb == "probe" && argc > 0){
-            // args: <plugin_path> [<id>] [<file_path>] [<timeout>]
-            std::string path = shorten(argv[0]);
-            int index = -1;
-            if (argc > 1) {
-                try {
-                    index = std::stol(argv[1], 0, 0);
-                } catch (...) {} // non-numeric argument, e.g. '_'
+        if (verb == "probe_worker" && argc >= 3) {
+            // args: <pid> <cmd_pipe> <reply_pipe>
+            int pid, cmdPipe, replyPipe;
+            try {
+                pid = std::stol(argv[0], 0, 0);
+                cmdPipe = std::stol(argv[1], 0, 0);
+                replyPipe = std::stol(argv[2], 0, 0);
+            } catch (...) {
+                LOG_ERROR("bad arguments for 'probe_worker'");
+                return EXIT_FAILURE;
             }
-            std::string file = argc > 2 ? shorten(argv[2]) : "";
-
-            return probe(path, index, file);
+            return probeWorker(pid, cmdPipe, replyPipe);
         }
     #if USE_BRIDGE
         else if (verb == "bridge" && argc >= 3){
@@ -258,7 +547,14 @@ int main(int argc, const char *argv[]) {
             return bridge(pid, shmPath, logChannel);
         }
     #endif
-        else if (verb == "test" && argc > 0){
+        else if (verb == "render" && argc > 0){
+            // args: [<options>] -p <plugin_path> [-P <preset>] ... <input_file> <output_file> ...
+            std::vector<std::string> args;
+            for (int i = 0; i < argc; ++i) {
+                args.push_back(shorten(argv[i]));
+            }
+            return render(args);
+        } else if (verb == "test" && argc > 0){
             std::string version = shorten(argv[0]);
             // version must match exactly
             if (version == getVersionString()) {
@@ -273,10 +569,13 @@ int main(int argc, const char *argv[]) {
         }
     }
     std::cout << "usage:\n"
-              << "  probe <plugin_path> [<id>] [<file_path>]\n"
+              << "  probe_worker <pid> <cmd_pipe> <reply_pipe>\n"
 #if USE_BRIDGE
               << "  bridge <pid> <shared_mem_path> <log_pipe>\n"
 #endif
+              << "  render [-j <threads>] [-b <blocksize>] [-t <tail>] [-d 0|1]\n"
+              << "         [-m native|bridge|sandbox] -p <plugin_path> [-P <preset>] ...\n"
+              << "         <input_file> <output_file> ...\n"
               << "  test <version>\n"
               << "  --version" << std::endl;
     return EXIT_FAILURE;